@@ -14,24 +14,177 @@
  *                Basic I/O primitives                                  *
  ************************************************************************/
 
+/* Data that is queued beyond this limit makes the output congested */
+#define CONGESTION_LIMIT (256 * 1024)
+
+#define MAX_VECTORS 64
+
 struct BroadwayOutput {
   GOutputStream *out;
   GString *buf;
+  GPtrArray *chunks; /* GBytes of the current message that come before buf */
+  GQueue queue;      /* GBytes of complete frames that still need writing */
+  gsize queue_offset; /* bytes of the queue head that have been written */
+  gsize queued;
+  GSource *source;
+  BroadwayOutputDrainedFunc drained_func;
+  gpointer drained_data;
   int error;
   guint32 serial;
 };
 
+static void
+broadway_output_clear_queue (BroadwayOutput *output)
+{
+  g_queue_clear_full (&output->queue, (GDestroyNotify) g_bytes_unref);
+  output->queue_offset = 0;
+  output->queued = 0;
+}
+
+static void
+broadway_output_consume (BroadwayOutput *output,
+                         gsize           written)
+{
+  output->queued -= written;
+
+  while (written > 0)
+    {
+      GBytes *bytes = g_queue_peek_head (&output->queue);
+      gsize left = g_bytes_get_size (bytes) - output->queue_offset;
+
+      if (written < left)
+        {
+          output->queue_offset += written;
+          return;
+        }
+
+      written -= left;
+      output->queue_offset = 0;
+      g_bytes_unref (g_queue_pop_head (&output->queue));
+    }
+}
+
+static gboolean broadway_output_writable_cb (GObject  *stream,
+                                             gpointer  data);
+
+/* Writes as much of the queue as the stream takes without blocking */
+static void
+broadway_output_write_queue (BroadwayOutput *output)
+{
+  GOutputVector vectors[MAX_VECTORS];
+  GError *error = NULL;
+
+  while (output->queued > 0)
+    {
+      gsize n, written;
+      GList *l;
+
+      n = 0;
+      for (l = output->queue.head; l != NULL && n < MAX_VECTORS; l = l->next)
+        {
+          gsize offset = n == 0 ? output->queue_offset : 0;
+          gsize size;
+          const guchar *data = g_bytes_get_data (l->data, &size);
+
+          vectors[n].buffer = data + offset;
+          vectors[n].size = size - offset;
+          n++;
+        }
+
+      if (G_IS_POLLABLE_OUTPUT_STREAM (output->out) &&
+          g_pollable_output_stream_can_poll (G_POLLABLE_OUTPUT_STREAM (output->out)))
+        {
+          GPollableReturn res;
+
+          res = g_pollable_output_stream_writev_nonblocking (G_POLLABLE_OUTPUT_STREAM (output->out),
+                                                             vectors, n, &written,
+                                                             NULL, &error);
+          if (res == G_POLLABLE_RETURN_WOULD_BLOCK)
+            {
+              if (output->source == NULL)
+                {
+                  output->source = g_pollable_output_stream_create_source (G_POLLABLE_OUTPUT_STREAM (output->out), NULL);
+                  g_source_set_callback (output->source, (GSourceFunc) broadway_output_writable_cb, output, NULL);
+                  g_source_set_static_name (output->source, "[gtk] broadway output");
+                  g_source_attach (output->source, NULL);
+                }
+              return;
+            }
+          else if (res == G_POLLABLE_RETURN_FAILED)
+            break;
+        }
+      else if (!g_output_stream_writev_all (output->out, vectors, n, &written, NULL, &error))
+        break;
+
+      broadway_output_consume (output, written);
+    }
+
+  if (error)
+    {
+      g_debug ("Broadway output error: %s", error->message);
+      g_error_free (error);
+      output->error = TRUE;
+      broadway_output_clear_queue (output);
+    }
+}
+
+static gboolean
+broadway_output_writable_cb (GObject  *stream,
+                             gpointer  data)
+{
+  BroadwayOutput *output = data;
+
+  /* Returning G_SOURCE_REMOVE destroys the source */
+  g_clear_pointer (&output->source, g_source_unref);
+
+  broadway_output_write_queue (output);
+
+  /* This may free the output */
+  if (output->queued == 0 && output->drained_func)
+    output->drained_func (output->drained_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Moves the small data written so far into the chunk list */
+static void
+broadway_output_end_chunk (BroadwayOutput *output)
+{
+  if (output->buf->len == 0)
+    return;
+
+  g_ptr_array_add (output->chunks, g_string_free_to_bytes (output->buf));
+  output->buf = g_string_new ("");
+}
+
+static void
+broadway_output_append_bytes (BroadwayOutput *output,
+                              GBytes         *bytes)
+{
+  broadway_output_end_chunk (output);
+  g_ptr_array_add (output->chunks, g_bytes_ref (bytes));
+}
+
+/* Queues a frame with the given chunks as payload and tries to send it,
+ * the chunks are cleared. Pass NULL to send a frame without payload.
+ */
 static void
 broadway_output_send_cmd (BroadwayOutput *output,
                           gboolean fin, BroadwayWSOpCode code,
-                          const void *buf, gsize count)
+                          GPtrArray *chunks)
 {
   gboolean mask = FALSE;
   guchar header[16];
   size_t p;
+  gsize i, count;
+  gboolean mid_header, long_header;
 
-  gboolean mid_header = count > 125 && count <= 65535;
-  gboolean long_header = count > 65535;
+  count = 0;
+  for (i = 0; chunks && i < chunks->len; i++)
+    count += g_bytes_get_size (g_ptr_array_index (chunks, i));
+
+  mid_header = count > 125 && count <= 65535;
+  long_header = count > 65535;
 
   /* NB. big-endian spec => bit 0 == MSB */
   header[0] = ( (fin ? 0x80 : 0) | (code & 0x0f) );
@@ -49,29 +202,73 @@ broadway_output_send_cmd (BroadwayOutput *output,
       p += 8;
     }
   // FIXME: if we are paranoid we should 'mask' the data
-  // FIXME: we should really emit these as a single write
-  g_output_stream_write_all (output->out, header, p, NULL, NULL, NULL);
-  g_output_stream_write_all (output->out, buf, count, NULL, NULL, NULL);
+
+  if (output->error)
+    {
+      if (chunks)
+        g_ptr_array_set_size (chunks, 0);
+      return;
+    }
+
+  g_queue_push_tail (&output->queue, g_bytes_new (header, p));
+  for (i = 0; chunks && i < chunks->len; i++)
+    g_queue_push_tail (&output->queue, g_bytes_ref (g_ptr_array_index (chunks, i)));
+  if (chunks)
+    g_ptr_array_set_size (chunks, 0);
+  output->queued += p + count;
+
+  /* If we're waiting for the stream, the source will write it */
+  if (output->source == NULL)
+    broadway_output_write_queue (output);
 }
 
+/* Doesn't touch the message that is being built, the pong
+ * is queued as its own frame.
+ */
 void broadway_output_pong (BroadwayOutput *output)
 {
-  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_CNX_PONG, NULL, 0);
+  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_CNX_PONG, NULL);
 }
 
 int
 broadway_output_flush (BroadwayOutput *output)
 {
-  if (output->buf->len == 0)
-    return TRUE;
+  broadway_output_end_chunk (output);
 
-  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY,
-                            output->buf->str, output->buf->len);
+  if (output->chunks->len == 0)
+    return !output->error;
 
-  g_string_set_size (output->buf, 0);
+  broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY, output->chunks);
 
   return !output->error;
+}
 
+/*
+ * broadway_output_is_congested:
+ *
+ * Returns whether the client is not keeping up with what we send.
+ * Frames sent while the output is congested will only pile up in
+ * the queue, so they should be skipped until the output drained.
+ */
+gboolean
+broadway_output_is_congested (BroadwayOutput *output)
+{
+  return output->queued > CONGESTION_LIMIT;
+}
+
+/*
+ * broadway_output_set_drained_func:
+ *
+ * Sets a function that gets called when the queue has been written
+ * after the output was blocked. It is safe to free the output from it.
+ */
+void
+broadway_output_set_drained_func (BroadwayOutput            *output,
+                                  BroadwayOutputDrainedFunc  func,
+                                  gpointer                   data)
+{
+  output->drained_func = func;
+  output->drained_data = data;
 }
 
 BroadwayOutput *
@@ -83,6 +280,8 @@ broadway_output_new (GOutputStream *out, guint32 serial)
 
   output->out = g_object_ref (out);
   output->buf = g_string_new ("");
+  output->chunks = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+  g_queue_init (&output->queue);
   output->serial = serial;
 
   return output;
@@ -91,6 +290,14 @@ broadway_output_new (GOutputStream *out, guint32 serial)
 void
 broadway_output_free (BroadwayOutput *output)
 {
+  if (output->source)
+    {
+      g_source_destroy (output->source);
+      g_source_unref (output->source);
+    }
+  broadway_output_clear_queue (output);
+  g_ptr_array_unref (output->chunks);
+  g_string_free (output->buf, TRUE);
   g_object_unref (output->out);
   free (output);
 }
@@ -602,13 +809,15 @@ broadway_output_surface_set_nodes (BroadwayOutput *output,
 void
 broadway_output_upload_texture (BroadwayOutput *output,
                                 guint32 id,
+                                guint32 base_id,
                                 GBytes *texture)
 {
   gsize len = g_bytes_get_size (texture);
   write_header (output, BROADWAY_OP_UPLOAD_TEXTURE);
   append_uint32 (output, id);
+  append_uint32 (output, base_id);
   append_uint32 (output, (guint32)len);
-  g_string_append_len (output->buf, g_bytes_get_data (texture, NULL), len);
+  broadway_output_append_bytes (output, texture);
 }
 
 void
@@ -16,11 +16,17 @@ typedef enum {
   BROADWAY_WS_CNX_PONG = 0xa
 } BroadwayWSOpCode;
 
+typedef void (* BroadwayOutputDrainedFunc) (gpointer data);
+
 BroadwayOutput *broadway_output_new                 (GOutputStream  *out,
                                                      guint32         serial);
 void            broadway_output_free                (BroadwayOutput *output);
 int             broadway_output_flush               (BroadwayOutput *output);
 int             broadway_output_has_error           (BroadwayOutput *output);
+gboolean        broadway_output_is_congested        (BroadwayOutput *output);
+void            broadway_output_set_drained_func    (BroadwayOutput *output,
+                                                     BroadwayOutputDrainedFunc func,
+                                                     gpointer        data);
 void            broadway_output_set_next_serial     (BroadwayOutput *output,
                                                      guint32         serial);
 guint32         broadway_output_get_next_serial     (BroadwayOutput *output);
@@ -62,6 +68,7 @@ void            broadway_output_surface_set_nodes   (BroadwayOutput *output,
                                                      GHashTable     *old_node_lookup);
 void            broadway_output_upload_texture      (BroadwayOutput *output,
                                                      guint32         id,
+                                                     guint32         base_id,
                                                      GBytes         *texture);
 void            broadway_output_release_texture     (BroadwayOutput *output,
                                                      guint32         id);
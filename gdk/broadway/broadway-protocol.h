@@ -32,6 +32,25 @@ typedef enum { /* Sync changes with broadway.js */
   BROADWAY_NODE_OP_PATCH_TRANSFORM = 4,
 } BroadwayNodeOpType;
 
+typedef enum { /* Sync changes with broadway.js */
+  BROADWAY_TEXTURE_FORMAT_PNG = 0,
+  BROADWAY_TEXTURE_FORMAT_QOI = 1,
+} BroadwayTextureFormat;
+
+/* Uploaded textures are a list of independently encoded rectangles,
+ * all numbers are little-endian uint32:
+ *
+ *   format, width, height, n_rects,
+ *   n_rects * { x, y, width, height, size },
+ *   n_rects * size bytes of encoded data
+ *
+ * For deltas, the pixels outside of the rectangles are taken from
+ * the base texture.
+ *
+ * The QOI format is the QOI chunk stream without header and end marker,
+ * with straight alpha RGBA pixels.
+ */
+
 static const char *broadway_node_type_names[] G_GNUC_UNUSED =  {
   "TEXTURE",
   "CONTAINER",
@@ -241,6 +260,7 @@ typedef struct {
 typedef struct {
   BroadwayRequestBase base;
   guint32 id;
+  guint32 base_id; /* 0 if this is not a delta */
   guint32 offset;
   guint32 size;
 } BroadwayRequestUploadTexture;
@@ -127,15 +127,21 @@ struct BroadwaySurface {
   gboolean modal_hint;
   BroadwayNode *nodes;
   GHashTable *node_lookup;
+  /* What the output has, differs from nodes while the output is congested */
+  BroadwayNode *sent_nodes;
+  GHashTable *sent_node_lookup;
 };
 
 struct _BroadwayTexture {
   grefcount refcount;
   guint32 id;
+  guint32 base_id; /* we hold a ref on the base of deltas */
   GBytes *bytes;
 };
 
 static void broadway_server_resync_surfaces (BroadwayServer *server);
+static void broadway_server_send_pending_nodes (BroadwayServer *server);
+static void broadway_server_output_drained (gpointer data);
 static void send_outstanding_roundtrips (BroadwayServer *server);
 
 static void broadway_server_ref_texture (BroadwayServer   *server,
@@ -307,7 +313,10 @@ broadway_surface_free (BroadwayServer *server,
 {
   if (surface->nodes)
     broadway_node_unref (server, surface->nodes);
+  if (surface->sent_nodes)
+    broadway_node_unref (server, surface->sent_nodes);
   g_hash_table_unref (surface->node_lookup);
+  g_hash_table_unref (surface->sent_node_lookup);
   g_free (surface);
 }
 
@@ -998,6 +1007,8 @@ broadway_server_fake_roundtrip_reply (BroadwayServer *server,
 void
 broadway_server_flush (BroadwayServer *server)
 {
+  broadway_server_send_pending_nodes (server);
+
   if (server->output &&
       !broadway_output_flush (server->output))
     {
@@ -1211,6 +1222,30 @@ send_outstanding_roundtrips (BroadwayServer *server)
   server->outstanding_roundtrips = NULL;
 }
 
+/*
+ * broadway_server_set_output:
+ *
+ * Makes the server send to @output, which it takes ownership of,
+ * and sends the current state of all surfaces.
+ */
+void
+broadway_server_set_output (BroadwayServer *server,
+                            BroadwayOutput *output)
+{
+  if (server->output)
+    {
+      server->saved_serial = broadway_output_get_next_serial (server->output);
+      broadway_output_free (server->output);
+    }
+  server->output = output;
+  broadway_output_set_drained_func (server->output, broadway_server_output_drained, server);
+
+  broadway_output_set_next_serial (server->output, server->saved_serial);
+  broadway_output_flush (server->output);
+
+  broadway_server_resync_surfaces (server);
+}
+
 static void
 start (BroadwayInput *input)
 {
@@ -1236,17 +1271,7 @@ start (BroadwayInput *input)
 
   server->input = input;
 
-  if (server->output)
-    {
-      server->saved_serial = broadway_output_get_next_serial (server->output);
-      broadway_output_free (server->output);
-    }
-  server->output = input->output;
-
-  broadway_output_set_next_serial (server->output, server->saved_serial);
-  broadway_output_flush (server->output);
-
-  broadway_server_resync_surfaces (server);
+  broadway_server_set_output (server, input->output);
 
   if (server->pointer_grab_surface_id != -1)
     broadway_output_grab_pointer (server->output,
@@ -1898,6 +1923,74 @@ decode_nodes (BroadwayServer *server,
   return node;
 }
 
+/* passes ownership of root */
+static void
+broadway_surface_replace_nodes (BroadwayServer  *server,
+                                BroadwaySurface *surface,
+                                BroadwayNode    *root)
+{
+  if (surface->nodes)
+    broadway_node_unref (server, surface->nodes);
+
+  surface->nodes = root;
+
+  g_hash_table_remove_all (surface->node_lookup);
+  broadway_node_add_to_lookup (root, surface->node_lookup);
+}
+
+static void
+broadway_surface_mark_sent (BroadwayServer  *server,
+                            BroadwaySurface *surface)
+{
+  if (surface->sent_nodes)
+    broadway_node_unref (server, surface->sent_nodes);
+
+  surface->sent_nodes = broadway_node_ref (surface->nodes);
+
+  g_hash_table_remove_all (surface->sent_node_lookup);
+  broadway_node_add_to_lookup (surface->sent_nodes, surface->sent_node_lookup);
+}
+
+/* Sends the changes since the last nodes that were sent */
+static void
+broadway_surface_send_nodes (BroadwayServer  *server,
+                             BroadwaySurface *surface)
+{
+  if (server->output == NULL ||
+      surface->nodes == NULL ||
+      surface->nodes == surface->sent_nodes)
+    return;
+
+  broadway_output_surface_set_nodes (server->output, surface->id,
+                                     surface->nodes,
+                                     surface->sent_nodes,
+                                     surface->sent_node_lookup);
+
+  broadway_surface_mark_sent (server, surface);
+}
+
+static void
+broadway_server_send_pending_nodes (BroadwayServer *server)
+{
+  GList *l;
+
+  if (server->output == NULL ||
+      broadway_output_is_congested (server->output))
+    return;
+
+  for (l = server->surfaces; l != NULL; l = l->next)
+    broadway_surface_send_nodes (server, l->data);
+}
+
+static void
+broadway_server_output_drained (gpointer data)
+{
+  BroadwayServer *server = data;
+
+  /* Sends the frames we skipped */
+  broadway_server_flush (server);
+}
+
 /* passes ownership of nodes */
 void
 broadway_server_surface_update_nodes (BroadwayServer   *server,
@@ -1916,23 +2009,23 @@ broadway_server_surface_update_nodes (BroadwayServer   *server,
 
   root = decode_nodes (server, surface, len, data, client_texture_map, &pos);
 
-  if (server->output != NULL)
-    broadway_output_surface_set_nodes (server->output, surface->id,
-                                       root,
-                                       surface->nodes,
-                                       surface->node_lookup);
+  /* The client reuses nodes of this tree in the next update,
+   * so it must be looked up even if it isn't sent yet */
+  broadway_surface_replace_nodes (server, surface, root);
 
-  if (surface->nodes)
-    broadway_node_unref (server, surface->nodes);
-
-  surface->nodes = root;
+  /* If the client can't keep up, don't queue up more frames
+   * but only send the latest one once it caught up.
+   */
+  if (server->output != NULL &&
+      broadway_output_is_congested (server->output))
+    return;
 
-  g_hash_table_remove_all (surface->node_lookup);
-  broadway_node_add_to_lookup (root, surface->node_lookup);
+  broadway_surface_send_nodes (server, surface);
 }
 
 guint32
 broadway_server_upload_texture (BroadwayServer   *server,
+                                guint32           base_id,
                                 GBytes           *bytes)
 {
   BroadwayTexture *texture;
@@ -1942,12 +2035,23 @@ broadway_server_upload_texture (BroadwayServer   *server,
   texture->id = ++server->next_texture_id;
   texture->bytes = g_bytes_ref (bytes);
 
+  if (base_id)
+    {
+      if (g_hash_table_contains (server->textures, GINT_TO_POINTER (base_id)))
+        {
+          broadway_server_ref_texture (server, base_id);
+          texture->base_id = base_id;
+        }
+      else
+        g_warning ("Base texture %u of texture upload not found", base_id);
+    }
+
   g_hash_table_replace (server->textures,
                         GINT_TO_POINTER (texture->id),
                         texture);
 
   if (server->output)
-    broadway_output_upload_texture (server->output, texture->id, texture->bytes);
+    broadway_output_upload_texture (server->output, texture->id, texture->base_id, texture->bytes);
 
   return texture->id;
 }
@@ -1973,10 +2077,15 @@ broadway_server_release_texture (BroadwayServer   *server,
 
   if (texture && g_ref_count_dec (&texture->refcount))
     {
+      guint32 base_id = texture->base_id;
+
       g_hash_table_remove (server->textures, GINT_TO_POINTER (id));
 
       if (server->output)
         broadway_output_release_texture (server->output, id);
+
+      if (base_id)
+        broadway_server_release_texture (server, base_id);
     }
 }
 
@@ -2122,6 +2231,7 @@ broadway_server_new_surface (BroadwayServer *server,
   surface->width = width;
   surface->height = height;
   surface->node_lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
+  surface->sent_node_lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
 
   g_hash_table_insert (server->surface_id_hash,
                        GINT_TO_POINTER (surface->id),
@@ -2142,25 +2252,43 @@ broadway_server_new_surface (BroadwayServer *server,
   return surface->id;
 }
 
+/* Deltas need their base texture to be uploaded first */
+static void
+broadway_server_resync_texture (BroadwayServer  *server,
+                                BroadwayTexture *texture,
+                                GHashTable      *uploaded)
+{
+  if (!g_hash_table_add (uploaded, GINT_TO_POINTER (texture->id)))
+    return;
+
+  if (texture->base_id)
+    broadway_server_resync_texture (server,
+                                    g_hash_table_lookup (server->textures, GINT_TO_POINTER (texture->base_id)),
+                                    uploaded);
+
+  broadway_output_upload_texture (server->output,
+                                  texture->id,
+                                  texture->base_id,
+                                  texture->bytes);
+}
+
 static void
 broadway_server_resync_surfaces (BroadwayServer *server)
 {
   GHashTableIter iter;
-  gpointer key, value;
+  GHashTable *uploaded;
+  gpointer value;
   GList *l;
 
   if (server->output == NULL)
     return;
 
   /* First upload all textures */
+  uploaded = g_hash_table_new (NULL, NULL);
   g_hash_table_iter_init (&iter, server->textures);
-  while (g_hash_table_iter_next (&iter, &key, &value))
-    {
-      BroadwayTexture *texture = value;
-      broadway_output_upload_texture (server->output,
-                                      GPOINTER_TO_INT (key),
-                                      texture->bytes);
-    }
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    broadway_server_resync_texture (server, value, uploaded);
+  g_hash_table_unref (uploaded);
 
   /* Then create all surfaces */
   for (l = server->surfaces; l != NULL; l = l->next)
@@ -2191,9 +2319,12 @@ broadway_server_resync_surfaces (BroadwayServer *server)
                                            surface->transient_for);
 
       if (surface->nodes)
-        broadway_output_surface_set_nodes (server->output, surface->id,
-                                           surface->nodes,
-                                           NULL, NULL);
+        {
+          broadway_output_surface_set_nodes (server->output, surface->id,
+                                             surface->nodes,
+                                             NULL, NULL);
+          broadway_surface_mark_sent (server, surface);
+        }
 
       if (surface->visible)
         broadway_output_show_surface (server->output, surface->id);
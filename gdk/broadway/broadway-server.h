@@ -57,6 +57,8 @@ BroadwayServer     *broadway_server_on_unix_socket_new        (char            *
                                                                GError         **error);
 gboolean            broadway_server_has_client                (BroadwayServer  *server);
 void                broadway_server_flush                     (BroadwayServer  *server);
+void                broadway_server_set_output                (BroadwayServer  *server,
+                                                               struct BroadwayOutput *output);
 void                broadway_server_sync                      (BroadwayServer  *server);
 void                broadway_server_roundtrip                 (BroadwayServer  *server,
                                                                int              id,
@@ -111,6 +113,7 @@ gboolean            broadway_server_surface_translate         (BroadwayServer  *
                                                                int              dx,
                                                                int              dy);
 guint32             broadway_server_upload_texture            (BroadwayServer  *server,
+                                                               guint32          base_id,
                                                                GBytes          *bytes);
 void                broadway_server_release_texture           (BroadwayServer  *server,
                                                                guint32          id);
@@ -39,6 +39,9 @@ const BROADWAY_OP_RELEASE_TEXTURE = 14;
 const BROADWAY_OP_SET_NODES = 15;
 const BROADWAY_OP_ROUNDTRIP = 16;
 
+const BROADWAY_TEXTURE_FORMAT_PNG = 0;
+const BROADWAY_TEXTURE_FORMAT_QOI = 1;
+
 const BROADWAY_EVENT_ENTER = 0;
 const BROADWAY_EVENT_LEAVE = 1;
 const BROADWAY_EVENT_POINTER_MOVE = 2;
@@ -299,24 +302,184 @@ function getButtonMask (button) {
     return 0;
 }
 
-function Texture(id, data) {
-    var url;
-    if (useDataUrls) {
-        url = bytesToDataUri(data);
-    } else {
-        var blob = new Blob([data],{type: "image/png"});
-        url = window.URL.createObjectURL(blob);
+const QOI_OP_INDEX = 0x00;
+const QOI_OP_DIFF = 0x40;
+const QOI_OP_LUMA = 0x80;
+const QOI_OP_RUN = 0xc0;
+const QOI_OP_RGB = 0xfe;
+const QOI_OP_RGBA = 0xff;
+
+// Decodes a QOI chunk stream without header and end marker into ImageData pixels
+function decodeQoi(data, pixels) {
+    var index = new Uint8Array(64 * 4);
+    var r = 0, g = 0, b = 0, a = 255;
+    var pos = 0, run = 0;
+
+    for (var o = 0; o < pixels.length; o += 4) {
+        if (run > 0) {
+            run--;
+        } else if (pos < data.length) {
+            var b1 = data[pos++];
+
+            if (b1 == QOI_OP_RGB) {
+                r = data[pos++];
+                g = data[pos++];
+                b = data[pos++];
+            } else if (b1 == QOI_OP_RGBA) {
+                r = data[pos++];
+                g = data[pos++];
+                b = data[pos++];
+                a = data[pos++];
+            } else if ((b1 & 0xc0) == QOI_OP_INDEX) {
+                var i = b1 * 4;
+                r = index[i];
+                g = index[i + 1];
+                b = index[i + 2];
+                a = index[i + 3];
+            } else if ((b1 & 0xc0) == QOI_OP_DIFF) {
+                r = (r + ((b1 >> 4) & 0x03) - 2) & 0xff;
+                g = (g + ((b1 >> 2) & 0x03) - 2) & 0xff;
+                b = (b + (b1 & 0x03) - 2) & 0xff;
+            } else if ((b1 & 0xc0) == QOI_OP_LUMA) {
+                var b2 = data[pos++];
+                var vg = (b1 & 0x3f) - 32;
+                r = (r + vg - 8 + ((b2 >> 4) & 0x0f)) & 0xff;
+                g = (g + vg) & 0xff;
+                b = (b + vg - 8 + (b2 & 0x0f)) & 0xff;
+            } else if ((b1 & 0xc0) == QOI_OP_RUN) {
+                run = b1 & 0x3f;
+            }
+
+            var hash = ((r * 3 + g * 5 + b * 7 + a * 11) % 64) * 4;
+            index[hash] = r;
+            index[hash + 1] = g;
+            index[hash + 2] = b;
+            index[hash + 3] = a;
+        }
+
+        pixels[o] = r;
+        pixels[o + 1] = g;
+        pixels[o + 2] = b;
+        pixels[o + 3] = a;
     }
+}
 
-    this.url = url;
+function pngToUrl(data) {
+    if (useDataUrls)
+        return bytesToDataUri(data);
+
+    var blob = new Blob([data],{type: "image/png"});
+    return window.URL.createObjectURL(blob);
+}
+
+function canvasToUrl(canvas) {
+    if (useDataUrls)
+        return Promise.resolve(canvas.toDataURL());
+
+    return new Promise((resolve, reject) => {
+        canvas.toBlob(blob => {
+            if (blob)
+                resolve(window.URL.createObjectURL(blob));
+            else
+                reject(new Error("Failed to encode texture"));
+        });
+    });
+}
+
+// See broadway-protocol.h for the format of data
+function Texture(id, base, data) {
+    var view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+    var format = view.getUint32(0, true);
+    var width = view.getUint32(4, true);
+    var height = view.getUint32(8, true);
+    var n_rects = view.getUint32(12, true);
+    var rects = [];
+    var pos = 16 + 20 * n_rects;
+
+    for (var i = 0; i < n_rects; i++) {
+        var size = view.getUint32(16 + 20 * i + 16, true);
+        rects.push({
+            x: view.getUint32(16 + 20 * i, true),
+            y: view.getUint32(16 + 20 * i + 4, true),
+            width: view.getUint32(16 + 20 * i + 8, true),
+            height: view.getUint32(16 + 20 * i + 12, true),
+            data: data.subarray(pos, pos + size)
+        });
+        pos += size;
+    }
+
+    this.url = null;
     this.refcount = 1;
     this.id = id;
+    this.pendingImages = [];
+    textures[id] = this;
+
+    if (base == 0 && format == BROADWAY_TEXTURE_FORMAT_PNG && n_rects == 1 &&
+        rects[0].width == width && rects[0].height == height) {
+        // The common case, the data is a complete png
+        this.setUrl(pngToUrl(rects[0].data));
+        this.decoded = this.image.decode();
+    } else {
+        // Take the ref on the base now, it may be released before we get to it
+        var baseTexture = base != 0 ? textures[base].ref() : null;
+        this.decoded = this.decode(format, width, height, baseTexture, rects);
+    }
+}
+
+Texture.prototype.decode = async function(format, width, height, base, rects) {
+    var canvas = document.createElement("canvas");
+    canvas.width = width;
+    canvas.height = height;
+    var context = canvas.getContext("2d");
+
+    if (base) {
+        try {
+            await base.decoded;
+            context.drawImage(base.image, 0, 0);
+        } finally {
+            base.unref();
+        }
+    }
+
+    for (var i = 0; i < rects.length; i++) {
+        var rect = rects[i];
+        if (format == BROADWAY_TEXTURE_FORMAT_QOI) {
+            var imageData = context.createImageData(rect.width, rect.height);
+            decodeQoi(rect.data, imageData.data);
+            context.putImageData(imageData, rect.x, rect.y);
+        } else {
+            var bitmap = await createImageBitmap(new Blob([rect.data],{type: "image/png"}));
+            context.clearRect(rect.x, rect.y, rect.width, rect.height);
+            context.drawImage(bitmap, rect.x, rect.y);
+            bitmap.close();
+        }
+    }
+
+    this.setUrl(await canvasToUrl(canvas));
+    await this.image.decode();
+}
+
+Texture.prototype.setUrl = function(url) {
+    this.url = url;
 
     var image = new Image();
-    image.src = this.url;
+    image.src = url;
     this.image = image;
-    this.decoded = image.decode();
-    textures[id] = this;
+
+    for (var i = 0; i < this.pendingImages.length; i++)
+        this.pendingImages[i].src = url;
+    this.pendingImages = [];
+}
+
+// Shows the texture in image, the ref held by the caller is dropped once it is loaded
+Texture.prototype.attach = function(image) {
+    var texture = this;
+    // Unref blob url when loaded
+    image.onload = function() { texture.unref(); };
+    if (this.url)
+        image.src = this.url;
+    else
+        this.pendingImages.push(image);
 }
 
 Texture.prototype.ref = function() {
@@ -327,7 +490,7 @@ Texture.prototype.ref = function() {
 Texture.prototype.unref = function() {
     this.refcount -= 1;
     if (this.refcount == 0) {
-        if (this.url.startsWith("blob")) {
+        if (this.url && this.url.startsWith("blob")) {
             window.URL.revokeObjectURL(this.url);
         }
         delete textures[this.id];
@@ -651,10 +814,7 @@ TransformNodes.prototype.insertNode = function(parent, previousSibling, is_tople
             image.height = rect.height;
             image.style["position"] = "absolute";
             set_rect_style(image, rect);
-            var texture = textures[texture_id].ref();
-            image.src = texture.url;
-            // Unref blob url when loaded
-            image.onload = function() { texture.unref(); };
+            textures[texture_id].ref().attach(image);
             newNode = image;
         }
         break;
@@ -1045,13 +1205,7 @@ function handleDisplayCommands(display_commands)
         case DISPLAY_OP_CHANGE_TEXTURE:
             var image = cmd[1];
             var texture = cmd[2];
-            // We need a new closure here to have a separate copy of "texture" for each iteration in the onload callback...
-            var block = function(t) {
-                image.src = t.url;
-                // Unref blob url when loaded
-                image.onload = function() { t.unref(); };
-            };
-            block(texture);
+            texture.attach(image);
             break;
         case DISPLAY_OP_CHANGE_TRANSFORM:
             var div = cmd[1];
@@ -1182,8 +1336,9 @@ function handleCommands(cmd, display_commands, new_textures, modified_trees)
 
         case BROADWAY_OP_UPLOAD_TEXTURE:
             id = cmd.get_32();
+            var base = cmd.get_32();
             var data = cmd.get_data();
-            var texture = new Texture (id, data); // Stores a ref in global textures array
+            var texture = new Texture (id, base, data); // Stores a ref in global textures array
             new_textures.push(texture);
             break;
 
@@ -220,7 +220,7 @@ client_handle_request (BroadwayClient *client,
 {
   BroadwayReply reply;
   guint32 before_serial, now_serial;
-  guint32 global_id;
+  guint32 global_id, base_id;
   int fd;
 
   before_serial = broadway_server_get_next_serial (server);
@@ -329,7 +329,9 @@ client_handle_request (BroadwayClient *client,
           close (fd);
 
           texture = g_bytes_new_take (data, request->upload_texture.size);
-          global_id = broadway_server_upload_texture (server, texture);
+          base_id = GPOINTER_TO_INT (g_hash_table_lookup (client->textures,
+                                                          GINT_TO_POINTER (request->upload_texture.base_id)));
+          global_id = broadway_server_upload_texture (server, base_id, texture);
           g_bytes_unref (texture);
 
           g_hash_table_replace (client->textures,
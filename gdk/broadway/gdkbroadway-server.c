@@ -13,6 +13,7 @@
 #include "gdkbroadway-server.h"
 
 #include "gdkprivate-broadway.h"
+#include "gdktexture-broadway.h"
 #include "gdkprivate.h"
 
 #include <gdk/gdktextureprivate.h>
@@ -44,6 +45,7 @@ struct _GdkBroadwayServer {
 
   guint32 next_serial;
   guint32 next_texture_id;
+  BroadwayTextureFormat texture_format;
   GSocketConnection *connection;
 
   guint32 recv_buffer_size;
@@ -69,6 +71,7 @@ gdk_broadway_server_init (GdkBroadwayServer *server)
 {
   server->next_serial = 1;
   server->next_texture_id = 1;
+  server->texture_format = gdk_broadway_texture_format_from_env ();
 }
 
 static void
@@ -621,9 +624,23 @@ open_shared_memory (void)
   return ret;
 }
 
+/*
+ * gdk_broadway_server_upload_texture:
+ * @server: the server
+ * @texture: the texture to upload
+ * @base_id: the id of a previous version of the texture or 0
+ * @region: (nullable): the region that changed compared to @base_id
+ *
+ * Uploads the texture, if @base_id is given, only the pixels in
+ * @region are sent.
+ *
+ * Returns: the id of the new texture
+ */
 guint32
-gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
-                                    GdkTexture        *texture)
+gdk_broadway_server_upload_texture (GdkBroadwayServer    *server,
+                                    GdkTexture           *texture,
+                                    guint32               base_id,
+                                    const cairo_region_t *region)
 {
   guint32 id;
   BroadwayRequestUploadTexture msg;
@@ -632,13 +649,16 @@ gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
   gsize size;
   int fd;
 
-  bytes = gdk_texture_save_to_png_bytes (texture);
+  g_return_val_if_fail (base_id == 0 || region != NULL, 0);
+
+  bytes = gdk_broadway_texture_encode (texture, server->texture_format, base_id ? region : NULL);
   fd = open_shared_memory ();
   data = g_bytes_get_data (bytes, &size);
 
   id = server->next_texture_id++;
 
   msg.id = id;
+  msg.base_id = base_id;
   msg.offset = 0;
   msg.size = 0;
 
@@ -400,8 +400,14 @@ gdk_broadway_display_get_setting (GdkDisplay *display,
   return FALSE;
 }
 
+/* Deltas keep their base texture alive in the daemon, so limit
+ * how many textures a chain of deltas can keep alive.
+ */
+#define MAX_DELTA_DEPTH 4
+
 typedef struct {
   int id;
+  guint delta_depth;
   GdkDisplay *display;
   GList *textures;
 } BroadwayTextureData;
@@ -416,20 +422,82 @@ broadway_texture_data_free (BroadwayTextureData *data)
   g_free (data);
 }
 
+typedef struct {
+  GdkDisplay *display;
+  BroadwayTextureData *base;
+} FindDeltaBase;
+
+static gboolean
+find_delta_base (GdkTexture *texture,
+                 gpointer    user_data)
+{
+  FindDeltaBase *find = user_data;
+  BroadwayTextureData *data;
+
+  data = g_object_get_data (G_OBJECT (texture), "broadway-data");
+  if (data == NULL || data->delta_depth >= MAX_DELTA_DEPTH)
+    return FALSE;
+
+  /* Texture ids are only valid for the display they were uploaded to */
+  if (data->display == NULL || data->display != find->display)
+    return FALSE;
+
+  find->base = data;
+  return TRUE;
+}
+
+/* Only send deltas if they save a good amount of data */
+static gboolean
+is_worth_delta (const cairo_region_t *region,
+                GdkTexture           *texture)
+{
+  cairo_rectangle_int_t rect;
+  gsize i, area;
+
+  area = 0;
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+    {
+      cairo_region_get_rectangle (region, i, &rect);
+      area += (gsize) rect.width * rect.height;
+    }
+
+  return area * 2 < (gsize) gdk_texture_get_width (texture) * gdk_texture_get_height (texture);
+}
+
 guint32
 gdk_broadway_display_ensure_texture (GdkDisplay *display,
                                      GdkTexture *texture)
 {
   GdkBroadwayDisplay *broadway_display = GDK_BROADWAY_DISPLAY (display);
   BroadwayTextureData *data;
+  cairo_region_t *region;
 
   data = g_object_get_data (G_OBJECT (texture), "broadway-data");
   if (data == NULL)
     {
-      guint32 id = gdk_broadway_server_upload_texture (broadway_display->server, texture);
+      FindDeltaBase find = { display, NULL };
+      guint32 id;
+      guint delta_depth;
+
+      region = cairo_region_create ();
+
+      if (gdk_texture_find_ancestor (texture, find_delta_base, &find, region) &&
+          is_worth_delta (region, texture))
+        {
+          id = gdk_broadway_server_upload_texture (broadway_display->server, texture, find.base->id, region);
+          delta_depth = find.base->delta_depth + 1;
+        }
+      else
+        {
+          id = gdk_broadway_server_upload_texture (broadway_display->server, texture, 0, NULL);
+          delta_depth = 0;
+        }
+
+      cairo_region_destroy (region);
 
       data = g_new0 (BroadwayTextureData, 1);
       data->id = id;
+      data->delta_depth = delta_depth;
       data->display = g_object_ref (display);
      g_object_set_data_full (G_OBJECT (texture), "broadway-data", data, (GDestroyNotify)broadway_texture_data_free);
     }
@@ -0,0 +1,347 @@
+/* GDK - The GIMP Drawing Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdktexture-broadway.h"
+
+#include "gdk/gdkparalleltaskprivate.h"
+
+#include <string.h>
+
+/* Rectangles are split into bands that are encoded independently,
+ * so that they can be encoded in parallel.
+ */
+#define PIXELS_PER_BAND (64 * 1024)
+
+typedef struct _Band Band;
+typedef struct _EncodeJob EncodeJob;
+
+struct _Band
+{
+  cairo_rectangle_int_t area;
+  guchar *data;
+  gsize size;
+};
+
+struct _EncodeJob
+{
+  BroadwayTextureFormat format;
+  GBytes *bytes;
+  const guchar *pixels;
+  gsize stride;
+  Band *bands;
+};
+
+BroadwayTextureFormat
+gdk_broadway_texture_format_from_env (void)
+{
+  const char *str;
+
+  str = g_getenv ("BROADWAY_TEXTURE_CODEC");
+  if (str == NULL || g_str_equal (str, "qoi"))
+    return BROADWAY_TEXTURE_FORMAT_QOI;
+  else if (g_str_equal (str, "png"))
+    return BROADWAY_TEXTURE_FORMAT_PNG;
+
+  g_warning ("Unknown texture codec \"%s\", using \"qoi\"", str);
+  return BROADWAY_TEXTURE_FORMAT_QOI;
+}
+
+/* {{{ QOI */
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+
+#define QOI_MAX_RUN 62
+#define QOI_MAX_SIZE_PER_PIXEL 5
+
+#define QOI_HASH(p) (((p)[0] * 3 + (p)[1] * 5 + (p)[2] * 7 + (p)[3] * 11) % 64)
+
+/* This is the encoder from https://qoiformat.org without header
+ * and end marker, the sizes are in the rectangle list.
+ */
+static gsize
+qoi_encode (guchar       *out,
+            const guchar *data,
+            gsize         stride,
+            gsize         width,
+            gsize         height)
+{
+  guchar index[64][4] = { { 0, } };
+  guchar prev[4] = { 0, 0, 0, 255 };
+  guchar *o = out;
+  gsize x, y, run;
+
+  run = 0;
+  for (y = 0; y < height; y++)
+    {
+      const guchar *px = data + y * stride;
+
+      for (x = 0; x < width; x++, px += 4)
+        {
+          guint hash;
+
+          if (memcmp (px, prev, 4) == 0)
+            {
+              run++;
+              if (run == QOI_MAX_RUN)
+                {
+                  *o++ = QOI_OP_RUN | (run - 1);
+                  run = 0;
+                }
+              continue;
+            }
+
+          if (run > 0)
+            {
+              *o++ = QOI_OP_RUN | (run - 1);
+              run = 0;
+            }
+
+          hash = QOI_HASH (px);
+          if (memcmp (index[hash], px, 4) == 0)
+            {
+              *o++ = QOI_OP_INDEX | hash;
+            }
+          else if (px[3] == prev[3])
+            {
+              signed char vr = px[0] - prev[0];
+              signed char vg = px[1] - prev[1];
+              signed char vb = px[2] - prev[2];
+              signed char vg_r = vr - vg;
+              signed char vg_b = vb - vg;
+
+              memcpy (index[hash], px, 4);
+
+              if (vr > -3 && vr < 2 &&
+                  vg > -3 && vg < 2 &&
+                  vb > -3 && vb < 2)
+                {
+                  *o++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                }
+              else if (vg_r > -9 && vg_r < 8 &&
+                       vg > -33 && vg < 32 &&
+                       vg_b > -9 && vg_b < 8)
+                {
+                  *o++ = QOI_OP_LUMA | (vg + 32);
+                  *o++ = (vg_r + 8) << 4 | (vg_b + 8);
+                }
+              else
+                {
+                  *o++ = QOI_OP_RGB;
+                  *o++ = px[0];
+                  *o++ = px[1];
+                  *o++ = px[2];
+                }
+            }
+          else
+            {
+              memcpy (index[hash], px, 4);
+
+              *o++ = QOI_OP_RGBA;
+              *o++ = px[0];
+              *o++ = px[1];
+              *o++ = px[2];
+              *o++ = px[3];
+            }
+
+          memcpy (prev, px, 4);
+        }
+    }
+
+  if (run > 0)
+    *o++ = QOI_OP_RUN | (run - 1);
+
+  return o - out;
+}
+
+/* }}} */
+/* {{{ Encoding */
+
+static void
+encode_band (EncodeJob *job,
+             Band      *band)
+{
+  const cairo_rectangle_int_t *area = &band->area;
+  gsize offset = area->y * job->stride + area->x * 4;
+
+  switch (job->format)
+    {
+    case BROADWAY_TEXTURE_FORMAT_QOI:
+      band->data = g_malloc ((gsize) area->width * area->height * QOI_MAX_SIZE_PER_PIXEL);
+      band->size = qoi_encode (band->data,
+                               job->pixels + offset,
+                               job->stride,
+                               area->width,
+                               area->height);
+      break;
+
+    case BROADWAY_TEXTURE_FORMAT_PNG:
+      {
+        GBytes *bytes, *png;
+        GdkTexture *texture;
+
+        bytes = g_bytes_new_from_bytes (job->bytes,
+                                        offset,
+                                        (area->height - 1) * job->stride + area->width * 4);
+        texture = gdk_memory_texture_new (area->width, area->height,
+                                          GDK_MEMORY_R8G8B8A8,
+                                          bytes,
+                                          job->stride);
+        png = gdk_texture_save_to_png_bytes (texture);
+        band->data = g_bytes_unref_to_data (png, &band->size);
+
+        g_object_unref (texture);
+        g_bytes_unref (bytes);
+      }
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+encode_bands (gsize    start,
+              gsize    end,
+              gpointer data)
+{
+  EncodeJob *job = data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    encode_band (job, &job->bands[i]);
+}
+
+static void
+append_uint32 (GByteArray *array,
+               guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (array, (guchar *) &value, sizeof (value));
+}
+
+static void
+add_bands (GArray                      *bands,
+           const cairo_rectangle_int_t *rect,
+           int                          width,
+           int                          height)
+{
+  cairo_rectangle_int_t area;
+  int y, rows;
+
+  if (!gdk_rectangle_intersect (rect, &(cairo_rectangle_int_t) { 0, 0, width, height }, &area))
+    return;
+
+  rows = MAX (1, PIXELS_PER_BAND / area.width);
+  for (y = area.y; y < area.y + area.height; y += rows)
+    {
+      Band band = {
+        .area = { area.x, y, area.width, MIN (rows, area.y + area.height - y) },
+      };
+
+      g_array_append_val (bands, band);
+    }
+}
+
+/*
+ * gdk_broadway_texture_encode:
+ * @texture: the texture to encode
+ * @format: the format to use
+ * @region: (nullable): the region to encode if this is a delta
+ *   against a previous version of the texture
+ *
+ * Encodes the texture in the format described in broadway-protocol.h.
+ *
+ * Returns: (transfer full): the encoded texture
+ */
+GBytes *
+gdk_broadway_texture_encode (GdkTexture             *texture,
+                             BroadwayTextureFormat   format,
+                             const cairo_region_t   *region)
+{
+  GdkTextureDownloader *downloader;
+  GByteArray *result;
+  GArray *bands;
+  EncodeJob job;
+  int width, height;
+  gsize i, size;
+
+  width = gdk_texture_get_width (texture);
+  height = gdk_texture_get_height (texture);
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R8G8B8A8);
+  job.format = format;
+  job.bytes = gdk_texture_downloader_download_bytes (downloader, &job.stride);
+  job.pixels = g_bytes_get_data (job.bytes, NULL);
+  gdk_texture_downloader_free (downloader);
+
+  bands = g_array_new (FALSE, FALSE, sizeof (Band));
+  if (region)
+    {
+      for (i = 0; i < cairo_region_num_rectangles (region); i++)
+        {
+          cairo_rectangle_int_t rect;
+
+          cairo_region_get_rectangle (region, i, &rect);
+          add_bands (bands, &rect, width, height);
+        }
+    }
+  else
+    {
+      add_bands (bands, &(cairo_rectangle_int_t) { 0, 0, width, height }, width, height);
+    }
+
+  job.bands = (Band *) bands->data;
+  gdk_parallel_task_run (encode_bands, &job, bands->len, 1);
+
+  size = 16 + 20 * bands->len;
+  for (i = 0; i < bands->len; i++)
+    size += job.bands[i].size;
+
+  result = g_byte_array_sized_new (size);
+  append_uint32 (result, format);
+  append_uint32 (result, width);
+  append_uint32 (result, height);
+  append_uint32 (result, bands->len);
+  for (i = 0; i < bands->len; i++)
+    {
+      append_uint32 (result, job.bands[i].area.x);
+      append_uint32 (result, job.bands[i].area.y);
+      append_uint32 (result, job.bands[i].area.width);
+      append_uint32 (result, job.bands[i].area.height);
+      append_uint32 (result, job.bands[i].size);
+    }
+  for (i = 0; i < bands->len; i++)
+    {
+      g_byte_array_append (result, job.bands[i].data, job.bands[i].size);
+      g_free (job.bands[i].data);
+    }
+
+  g_array_unref (bands);
+  g_bytes_unref (job.bytes);
+
+  return g_byte_array_free_to_bytes (result);
+}
+
+/* }}} */
+/* vim:set foldmethod=marker: */
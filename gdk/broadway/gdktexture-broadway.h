@@ -0,0 +1,31 @@
+/* GDK - The GIMP Drawing Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gdk/gdk.h>
+
+#include "broadway-protocol.h"
+
+G_BEGIN_DECLS
+
+BroadwayTextureFormat   gdk_broadway_texture_format_from_env    (void);
+
+GBytes *                gdk_broadway_texture_encode             (GdkTexture             *texture,
+                                                                 BroadwayTextureFormat   format,
+                                                                 const cairo_region_t   *region);
+
+G_END_DECLS
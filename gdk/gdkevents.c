@@ -414,6 +414,7 @@ gdk_event_alloc (GdkEventType event_type,
   event->surface = surface != NULL ? g_object_ref (surface) : NULL;
   event->device = device != NULL ? g_object_ref (device) : NULL;
   event->time = time_;
+  event->receive_time = g_get_monotonic_time ();
 
   if (device != NULL && time_ != GDK_CURRENT_TIME)
     gdk_device_set_timestamp (device, time_);
@@ -832,6 +833,10 @@ _gdk_event_queue_handle_motion_compression (GdkDisplay *display)
                 GDK_BUTTON4_MASK | GDK_BUTTON5_MASK)) ||
                gdk_event_get_device_tool (last_motion) != NULL)
             gdk_motion_event_push_history (last_motion, pending_motions->data);
+
+          /* The latency of the motion starts with the oldest one */
+          last_motion->receive_time = MIN (last_motion->receive_time,
+                                           ((GdkEvent *) pending_motions->data)->receive_time);
         }
 
       gdk_event_unref (pending_motions->data);
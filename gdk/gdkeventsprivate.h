@@ -64,6 +64,9 @@ struct _GdkEvent
 
   guint32 time;
   guint16 flags;
+
+  /* When GDK created the event, for input latency tracking */
+  gint64 receive_time;
 };
 
 /*< private >
@@ -26,6 +26,11 @@
 
 #include "gdkframeclockprivate.h"
 
+#include "gdkenumtypes.h"
+#include "gdkeventsprivate.h"
+
+#include <math.h>
+
 /**
  * GdkFrameClock:
  *
@@ -78,6 +83,7 @@ enum {
 static guint signals[LAST_SIGNAL];
 
 static guint fps_counter;
+static guint input_latency_counter;
 
 /* 60Hz plus some extra for monotonic time inaccuracy */
 #define FRAME_HISTORY_DEFAULT_LENGTH 64
@@ -91,12 +97,37 @@ static guint fps_counter;
 #define GDK_ARRAY_FREE_FUNC frame_timings_unref
 #include "gdk/gdkarrayimpl.c"
 
+/* Input events that we wait to be presented are dropped
+ * when there are more than this */
+#define MAX_PENDING_INPUTS 256
+
+typedef struct _GdkPendingInput GdkPendingInput;
+
+struct _GdkPendingInput
+{
+  guint64 id;
+  GdkEventType event_type;
+  gint64 receive_time;
+  gint64 dispatch_time;
+  /* the frame showing the result, or -1 if not painted yet */
+  gint64 frame_counter;
+};
+
 struct _GdkFrameClockPrivate
 {
   gint64 frame_counter;
   int current;
   Timings timings;
   int n_freeze_inhibitors;
+
+  /* Input latency tracking */
+  GQueue pending_inputs;
+  guint64 last_input_id;
+  guint input_depth;
+  GdkEventType input_event_type;
+  gint64 input_receive_time;
+  gboolean input_caused_update;
+  GdkInputLatency *input_latency[GDK_EVENT_LAST];
 };
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (GdkFrameClock, gdk_frame_clock, G_TYPE_OBJECT)
@@ -104,6 +135,9 @@ G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (GdkFrameClock, gdk_frame_clock, G_TYPE_OBJE
 static void
 _gdk_frame_clock_freeze (GdkFrameClock *clock);
 
+static void
+gdk_frame_clock_collect_inputs (GdkFrameClock *clock);
+
 static void
 gdk_frame_clock_finalize (GObject *object)
 {
@@ -111,6 +145,10 @@ gdk_frame_clock_finalize (GObject *object)
 
   timings_clear (&priv->timings);
 
+  g_queue_clear_full (&priv->pending_inputs, g_free);
+  for (gsize i = 0; i < G_N_ELEMENTS (priv->input_latency); i++)
+    g_free (priv->input_latency[i]);
+
   G_OBJECT_CLASS (gdk_frame_clock_parent_class)->finalize (object);
 }
 
@@ -268,6 +306,8 @@ gdk_frame_clock_init (GdkFrameClock *clock)
 
   if (fps_counter == 0)
     fps_counter = gdk_profiler_define_counter ("fps", "Frames per Second");
+  if (input_latency_counter == 0)
+    input_latency_counter = gdk_profiler_define_counter ("input-latency", "Milliseconds from input to presentation");
 }
 
 /**
@@ -316,6 +356,8 @@ gdk_frame_clock_request_phase (GdkFrameClock      *frame_clock,
 {
   g_return_if_fail (GDK_IS_FRAME_CLOCK (frame_clock));
 
+  _gdk_frame_clock_note_update (frame_clock);
+
   GDK_FRAME_CLOCK_GET_CLASS (frame_clock)->request_phase (frame_clock, phase);
 }
 
@@ -336,6 +378,8 @@ gdk_frame_clock_begin_updating (GdkFrameClock *frame_clock)
 {
   g_return_if_fail (GDK_IS_FRAME_CLOCK (frame_clock));
 
+  _gdk_frame_clock_note_update (frame_clock);
+
   GDK_FRAME_CLOCK_GET_CLASS (frame_clock)->begin_updating (frame_clock);
 }
 
@@ -460,6 +504,10 @@ _gdk_frame_clock_begin_frame (GdkFrameClock *frame_clock,
 
   priv = frame_clock->priv;
 
+  /* Collect the latency of inputs in frames that completed since,
+   * before their timings might get reused */
+  gdk_frame_clock_collect_inputs (frame_clock);
+
   priv->frame_counter++;
 
   if (G_UNLIKELY (timings_get_size (&priv->timings) == 0))
@@ -729,7 +777,21 @@ _gdk_frame_clock_emit_layout (GdkFrameClock *frame_clock)
 void
 _gdk_frame_clock_emit_paint (GdkFrameClock *frame_clock)
 {
+  GdkFrameClockPrivate *priv = frame_clock->priv;
   gint64 before G_GNUC_UNUSED;
+  GList *l;
+
+  /* Everything that was dispatched until now will be shown
+   * by this frame */
+  for (l = priv->pending_inputs.tail; l; l = l->prev)
+    {
+      GdkPendingInput *input = l->data;
+
+      if (input->frame_counter >= 0)
+        break;
+
+      input->frame_counter = priv->frame_counter;
+    }
 
   before = GDK_PROFILER_CURRENT_TIME;
 
@@ -848,3 +910,353 @@ _gdk_frame_clock_add_timings_to_profiler (GdkFrameClock   *clock,
 
   gdk_profiler_set_counter (fps_counter, gdk_frame_clock_get_fps (clock));
 }
+
+/* Input latency */
+
+void
+_gdk_input_latency_add_sample (GdkInputLatency *self,
+                               gint64           latency)
+{
+  gint64 bucket;
+
+  bucket = MIN (latency / 1000, GDK_INPUT_LATENCY_N_BUCKETS - 1);
+
+  self->buckets[bucket]++;
+  self->n_events++;
+  self->max = MAX (self->max, latency);
+}
+
+void
+_gdk_input_latency_add (GdkInputLatency       *self,
+                        const GdkInputLatency *other)
+{
+  gsize i;
+
+  for (i = 0; i < GDK_INPUT_LATENCY_N_BUCKETS; i++)
+    self->buckets[i] += other->buckets[i];
+
+  self->n_events += other->n_events;
+  self->max = MAX (self->max, other->max);
+}
+
+/*< private >
+ * _gdk_input_latency_get_percentile:
+ * @self: the latencies
+ * @percentile: the percentile to compute, from 0 to 100
+ *
+ * Computes the latency that the given percentage of events
+ * did not exceed. The result is rounded up to the next millisecond,
+ * but never larger than the largest latency.
+ *
+ * Returns: the latency in microseconds or 0 if there are no events
+ */
+gint64
+_gdk_input_latency_get_percentile (const GdkInputLatency *self,
+                                   double                 percentile)
+{
+  guint target, sum;
+  gsize i;
+
+  if (self->n_events == 0)
+    return 0;
+
+  target = MAX (1, ceil (CLAMP (percentile, 0, 100) * self->n_events / 100));
+
+  sum = 0;
+  for (i = 0; i < GDK_INPUT_LATENCY_N_BUCKETS - 1; i++)
+    {
+      sum += self->buckets[i];
+      if (sum >= target)
+        return MIN ((i + 1) * 1000, self->max);
+    }
+
+  return self->max;
+}
+
+static gboolean
+is_input_event (GdkEventType event_type)
+{
+  switch (event_type)
+    {
+    case GDK_MOTION_NOTIFY:
+    case GDK_BUTTON_PRESS:
+    case GDK_BUTTON_RELEASE:
+    case GDK_KEY_PRESS:
+    case GDK_KEY_RELEASE:
+    case GDK_SCROLL:
+    case GDK_TOUCH_BEGIN:
+    case GDK_TOUCH_UPDATE:
+    case GDK_TOUCH_END:
+    case GDK_TOUCHPAD_SWIPE:
+    case GDK_TOUCHPAD_PINCH:
+    case GDK_TOUCHPAD_HOLD:
+    case GDK_PAD_BUTTON_PRESS:
+    case GDK_PAD_BUTTON_RELEASE:
+    case GDK_PAD_RING:
+    case GDK_PAD_STRIP:
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+/*< private >
+ * _gdk_frame_clock_begin_input:
+ * @frame_clock: the frame clock of the surface of @event
+ * @event: the event that is about to be dispatched
+ *
+ * Starts tracking the latency of @event. If handling the event
+ * causes a new frame, the time from receiving the event until
+ * that frame is presented will be recorded.
+ *
+ * Must be paired with _gdk_frame_clock_end_input().
+ */
+void
+_gdk_frame_clock_begin_input (GdkFrameClock *frame_clock,
+                              GdkEvent      *event)
+{
+  GdkFrameClockPrivate *priv = frame_clock->priv;
+
+  priv->input_depth++;
+  if (priv->input_depth > 1)
+    return;
+
+  if (!is_input_event (event->event_type))
+    {
+      priv->input_event_type = GDK_EVENT_LAST;
+      return;
+    }
+
+  priv->input_event_type = event->event_type;
+  priv->input_receive_time = event->receive_time;
+  priv->input_caused_update = FALSE;
+}
+
+void
+_gdk_frame_clock_end_input (GdkFrameClock *frame_clock)
+{
+  GdkFrameClockPrivate *priv = frame_clock->priv;
+  GdkPendingInput *input;
+
+  g_assert (priv->input_depth > 0);
+
+  priv->input_depth--;
+  if (priv->input_depth > 0)
+    return;
+
+  if (priv->input_event_type == GDK_EVENT_LAST ||
+      !priv->input_caused_update)
+    return;
+
+  if (priv->pending_inputs.length >= MAX_PENDING_INPUTS)
+    g_free (g_queue_pop_head (&priv->pending_inputs));
+
+  input = g_new (GdkPendingInput, 1);
+  input->id = ++priv->last_input_id;
+  input->event_type = priv->input_event_type;
+  input->receive_time = priv->input_receive_time;
+  input->dispatch_time = g_get_monotonic_time ();
+  input->frame_counter = -1;
+  g_queue_push_tail (&priv->pending_inputs, input);
+}
+
+/* Called when something requests a new frame, so we know
+ * that the input that is currently being handled will be
+ * visible in the next frame.
+ */
+void
+_gdk_frame_clock_note_update (GdkFrameClock *frame_clock)
+{
+  GdkFrameClockPrivate *priv = frame_clock->priv;
+
+  if (priv->input_depth > 0)
+    priv->input_caused_update = TRUE;
+}
+
+/* Frame clocks only record the start of the layout and paint
+ * phases when somebody is interested */
+gboolean
+_gdk_frame_clock_is_tracking_input (GdkFrameClock *frame_clock)
+{
+  return frame_clock->priv->pending_inputs.length > 0;
+}
+
+static void
+gdk_frame_clock_add_input_to_profiler (GdkPendingInput *input,
+                                       GdkFrameTimings *timings,
+                                       gint64           end_time)
+{
+  GString *string;
+  char *name;
+
+  name = g_enum_to_string (GDK_TYPE_EVENT_TYPE, input->event_type);
+  string = g_string_new (NULL);
+  g_string_append_printf (string, "%s %" G_GUINT64_FORMAT ": dispatched %.1fms",
+                          name, input->id,
+                          (input->dispatch_time - input->receive_time) / 1000.);
+  if (timings->layout_start_time)
+    g_string_append_printf (string, ", layout %.1fms", (timings->layout_start_time - input->receive_time) / 1000.);
+  if (timings->paint_start_time)
+    g_string_append_printf (string, ", paint %.1fms", (timings->paint_start_time - input->receive_time) / 1000.);
+  if (timings->frame_end_time)
+    g_string_append_printf (string, ", rendered %.1fms", (timings->frame_end_time - input->receive_time) / 1000.);
+  if (timings->drawn_time)
+    g_string_append_printf (string, ", drawn %.1fms", (timings->drawn_time - input->receive_time) / 1000.);
+  if (timings->presentation_time)
+    g_string_append_printf (string, ", presented %.1fms", (timings->presentation_time - input->receive_time) / 1000.);
+
+  gdk_profiler_add_mark (1000 * input->receive_time,
+                         1000 * (end_time - input->receive_time),
+                         "Input latency",
+                         string->str);
+  gdk_profiler_set_counter (input_latency_counter, (end_time - input->receive_time) / 1000.);
+
+  g_string_free (string, TRUE);
+  g_free (name);
+}
+
+/* Moves the inputs whose frames have completed into the histograms */
+static void
+gdk_frame_clock_collect_inputs (GdkFrameClock *clock)
+{
+  GdkFrameClockPrivate *priv = clock->priv;
+  GdkPendingInput *input;
+
+  while ((input = g_queue_peek_head (&priv->pending_inputs)))
+    {
+      GdkFrameTimings *timings;
+      gint64 end_time;
+
+      if (input->frame_counter < 0)
+        break;
+
+      timings = _gdk_frame_clock_get_timings (clock, input->frame_counter);
+      if (timings && !timings->complete)
+        break;
+
+      g_queue_pop_head (&priv->pending_inputs);
+
+      /* Not all backends know when the frame was shown */
+      if (timings == NULL)
+        end_time = 0;
+      else if (timings->presentation_time)
+        end_time = timings->presentation_time;
+      else if (timings->drawn_time)
+        end_time = timings->drawn_time;
+      else
+        end_time = timings->frame_end_time;
+
+      if (end_time >= input->receive_time)
+        {
+          if (priv->input_latency[input->event_type] == NULL)
+            priv->input_latency[input->event_type] = g_new0 (GdkInputLatency, 1);
+
+          _gdk_input_latency_add_sample (priv->input_latency[input->event_type],
+                                         end_time - input->receive_time);
+
+          if (GDK_PROFILER_IS_RUNNING)
+            gdk_frame_clock_add_input_to_profiler (input, timings, end_time);
+        }
+
+      g_free (input);
+    }
+}
+
+/*< private >
+ * _gdk_frame_clock_get_input_latency:
+ * @frame_clock: a `GdkFrameClock`
+ * @event_type: the type of input event
+ *
+ * Gets the latencies of events of the given type, for
+ * combining them with the latencies of other frame clocks.
+ *
+ * Returns: (nullable): the latencies or %NULL if no such
+ *   events were presented yet
+ */
+const GdkInputLatency *
+_gdk_frame_clock_get_input_latency (GdkFrameClock *frame_clock,
+                                    GdkEventType   event_type)
+{
+  g_return_val_if_fail (event_type < GDK_EVENT_LAST, NULL);
+
+  gdk_frame_clock_collect_inputs (frame_clock);
+
+  return frame_clock->priv->input_latency[event_type];
+}
+
+/**
+ * gdk_frame_clock_get_input_latency:
+ * @frame_clock: a `GdkFrameClock`
+ * @event_type: the type of input event, like %GDK_KEY_PRESS
+ * @percentile: the percentile to query, from 0 to 100
+ * @n_events: (out) (optional): return location for the number
+ *   of events the latency was measured for
+ *
+ * Gets the input latency of events of the given type.
+ *
+ * The input latency is the time from GDK receiving an event
+ * until the frame that shows its effects is presented. Only
+ * events that caused a new frame are taken into account. If
+ * the windowing system does not report presentation times, the
+ * time the frame was drawn is used instead.
+ *
+ * Querying the 50th percentile gives the median latency,
+ * 100 gives the largest latency. Latencies are measured
+ * with a resolution of 1 millisecond.
+ *
+ * Returns: the latency in microseconds or 0 if no events of
+ *   that type were measured
+ *
+ * Since: 4.18
+ */
+gint64
+gdk_frame_clock_get_input_latency (GdkFrameClock *frame_clock,
+                                   GdkEventType   event_type,
+                                   double         percentile,
+                                   guint         *n_events)
+{
+  const GdkInputLatency *latency;
+
+  g_return_val_if_fail (GDK_IS_FRAME_CLOCK (frame_clock), 0);
+  g_return_val_if_fail (event_type < GDK_EVENT_LAST, 0);
+
+  latency = _gdk_frame_clock_get_input_latency (frame_clock, event_type);
+
+  if (latency == NULL)
+    {
+      if (n_events)
+        *n_events = 0;
+      return 0;
+    }
+
+  if (n_events)
+    *n_events = latency->n_events;
+
+  return _gdk_input_latency_get_percentile (latency, percentile);
+}
+
+/**
+ * gdk_frame_clock_reset_input_latency:
+ * @frame_clock: a `GdkFrameClock`
+ *
+ * Forgets all input latencies measured so far, so that
+ * [method@Gdk.FrameClock.get_input_latency] only takes
+ * future events into account.
+ *
+ * Since: 4.18
+ */
+void
+gdk_frame_clock_reset_input_latency (GdkFrameClock *frame_clock)
+{
+  GdkFrameClockPrivate *priv;
+  gsize i;
+
+  g_return_if_fail (GDK_IS_FRAME_CLOCK (frame_clock));
+
+  priv = frame_clock->priv;
+
+  for (i = 0; i < G_N_ELEMENTS (priv->input_latency); i++)
+    g_clear_pointer (&priv->input_latency[i], g_free);
+}
+
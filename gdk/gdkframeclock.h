@@ -28,6 +28,7 @@
 #error "Only <gdk/gdk.h> can be included directly."
 #endif
 
+#include <gdk/gdkevents.h>
 #include <gdk/gdkframetimings.h>
 
 G_BEGIN_DECLS
@@ -105,6 +106,14 @@ void gdk_frame_clock_get_refresh_info (GdkFrameClock *frame_clock,
 GDK_AVAILABLE_IN_ALL
 double gdk_frame_clock_get_fps (GdkFrameClock *frame_clock);
 
+GDK_AVAILABLE_IN_4_18
+gint64 gdk_frame_clock_get_input_latency   (GdkFrameClock *frame_clock,
+                                            GdkEventType   event_type,
+                                            double         percentile,
+                                            guint         *n_events);
+GDK_AVAILABLE_IN_4_18
+void   gdk_frame_clock_reset_input_latency (GdkFrameClock *frame_clock);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GdkFrameClock, g_object_unref)
 
 G_END_DECLS
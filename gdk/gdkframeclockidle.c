@@ -585,7 +585,7 @@ gdk_frame_clock_paint_idle (void *data)
           if (!gdk_frame_clock_idle_is_frozen (clock_idle))
             {
 	      int iter;
-              if (GDK_DEBUG_CHECK (FRAMES))
+              if (GDK_DEBUG_CHECK (FRAMES) || _gdk_frame_clock_is_tracking_input (clock))
                 {
                   if (priv->phase != GDK_FRAME_CLOCK_PHASE_LAYOUT &&
                       (priv->requested & GDK_FRAME_CLOCK_PHASE_LAYOUT))
@@ -617,7 +617,7 @@ gdk_frame_clock_paint_idle (void *data)
         case GDK_FRAME_CLOCK_PHASE_PAINT:
           if (!gdk_frame_clock_idle_is_frozen (clock_idle))
             {
-              if (GDK_DEBUG_CHECK (FRAMES))
+              if (GDK_DEBUG_CHECK (FRAMES) || _gdk_frame_clock_is_tracking_input (clock))
                 {
                   if (priv->phase != GDK_FRAME_CLOCK_PHASE_PAINT &&
                       (priv->requested & GDK_FRAME_CLOCK_PHASE_PAINT))
@@ -645,7 +645,7 @@ gdk_frame_clock_paint_idle (void *data)
                */
               priv->phase = GDK_FRAME_CLOCK_PHASE_NONE;
             }
-          if (GDK_DEBUG_CHECK (FRAMES))
+          if (GDK_DEBUG_CHECK (FRAMES) || _gdk_frame_clock_is_tracking_input (clock))
             {
               if (timings)
                 timings->frame_end_time = g_get_monotonic_time ();
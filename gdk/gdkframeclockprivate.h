@@ -125,5 +125,33 @@ void _gdk_frame_clock_emit_paint         (GdkFrameClock *frame_clock);
 void _gdk_frame_clock_emit_after_paint   (GdkFrameClock *frame_clock);
 void _gdk_frame_clock_emit_resume_events (GdkFrameClock *frame_clock);
 
+/* Input latency is collected in 1ms buckets,
+ * the last bucket collects everything slower */
+#define GDK_INPUT_LATENCY_N_BUCKETS 128
+
+typedef struct _GdkInputLatency GdkInputLatency;
+
+struct _GdkInputLatency
+{
+  guint n_events;
+  gint64 max;
+  guint buckets[GDK_INPUT_LATENCY_N_BUCKETS];
+};
+
+void   _gdk_input_latency_add_sample     (GdkInputLatency       *self,
+                                          gint64                 latency);
+void   _gdk_input_latency_add            (GdkInputLatency       *self,
+                                          const GdkInputLatency *other);
+gint64 _gdk_input_latency_get_percentile (const GdkInputLatency *self,
+                                          double                 percentile);
+
+void                    _gdk_frame_clock_begin_input       (GdkFrameClock *frame_clock,
+                                                            GdkEvent      *event);
+void                    _gdk_frame_clock_end_input         (GdkFrameClock *frame_clock);
+void                    _gdk_frame_clock_note_update       (GdkFrameClock *frame_clock);
+gboolean                _gdk_frame_clock_is_tracking_input (GdkFrameClock *frame_clock);
+const GdkInputLatency * _gdk_frame_clock_get_input_latency (GdkFrameClock *frame_clock,
+                                                            GdkEventType   event_type);
+
 G_END_DECLS
 
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "gdkmemoryformatprivate.h"
+#include "gdkmemoryformatsimdprivate.h"
 
 #include "gdkdmabuffourccprivate.h"
 #include "gdkcolorstateprivate.h"
@@ -343,7 +344,6 @@ name (guchar *dest, \
 }
 
 SWAP_FUNC(r8g8b8a8_to_b8g8r8a8, 2, 1, 0, 3)
-SWAP_FUNC(b8g8r8a8_to_r8g8b8a8, 2, 1, 0, 3)
 
 #define MIPMAP_FUNC(SumType, DataType, n_units) \
 static void \
@@ -2032,58 +2032,93 @@ unpremultiply (float (*rgba)[4],
     }
 }
 
-typedef void (* FastConversionFunc) (guchar       *dest,
-                                     const guchar *src,
-                                     gsize         n);
+static const GdkMemoryFastConversionFunc fast_conversions[GDK_MEMORY_N_FAST_CONVERSIONS] = {
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED] = r8g8b8a8_to_r8g8b8a8_premultiplied,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED] = r8g8b8a8_to_b8g8r8a8_premultiplied,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8R8G8B8_PREMULTIPLIED] = r8g8b8a8_to_a8r8g8b8_premultiplied,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8B8G8R8_PREMULTIPLIED] = r8g8b8a8_to_a8b8g8r8_premultiplied,
+  [GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8] = r8g8b8_to_r8g8b8a8,
+  [GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8] = r8g8b8_to_b8g8r8a8,
+  [GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8] = r8g8b8_to_a8r8g8b8,
+  [GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8] = r8g8b8_to_a8b8g8r8,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8] = r8g8b8a8_to_b8g8r8a8,
+};
 
-static FastConversionFunc
+/*<private>
+ * gdk_memory_fast_conversion_get_func:
+ * @conversion: the conversion
+ * @simd: the instruction sets that may be used
+ *
+ * Gets the function to use for @conversion. If none of the allowed
+ * instruction sets has a kernel for it, the scalar version is returned.
+ *
+ * Returns: the function
+ **/
+GdkMemoryFastConversionFunc
+gdk_memory_fast_conversion_get_func (GdkMemoryFastConversion conversion,
+                                     GdkMemorySimd           simd)
+{
+  GdkMemoryFastConversionFunc func;
+
+  func = gdk_memory_simd_get_fast_conversion (conversion, simd);
+  if (func)
+    return func;
+
+  return fast_conversions[conversion];
+}
+
+static GdkMemoryFastConversionFunc
 get_fast_conversion_func (GdkMemoryFormat dest_format,
                           GdkMemoryFormat src_format)
 {
+  GdkMemoryFastConversion conversion;
+
   if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    return r8g8b8a8_to_r8g8b8a8_premultiplied;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED;
   else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    return r8g8b8a8_to_b8g8r8a8_premultiplied;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED;
   else if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    return r8g8b8a8_to_b8g8r8a8_premultiplied;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED;
   else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    return r8g8b8a8_to_r8g8b8a8_premultiplied;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED;
   else if (src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    return r8g8b8a8_to_a8r8g8b8_premultiplied;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_A8R8G8B8_PREMULTIPLIED;
   else if (src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    return r8g8b8a8_to_a8b8g8r8_premultiplied;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_A8B8G8R8_PREMULTIPLIED;
   else if ((src_format == GDK_MEMORY_B8G8R8A8 && dest_format == GDK_MEMORY_R8G8B8A8) ||
            (src_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED))
-    return b8g8r8a8_to_r8g8b8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8;
   else if ((src_format == GDK_MEMORY_R8G8B8A8 && dest_format == GDK_MEMORY_B8G8R8A8) ||
            (src_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED))
-    return r8g8b8a8_to_b8g8r8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8;
   else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    return r8g8b8_to_r8g8b8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_R8G8B8A8_PREMULTIPLIED)
-    return r8g8b8_to_b8g8r8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8;
   else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    return r8g8b8_to_b8g8r8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED)
-    return r8g8b8_to_r8g8b8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8;
   else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    return r8g8b8_to_a8r8g8b8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_A8R8G8B8_PREMULTIPLIED)
-    return r8g8b8_to_a8b8g8r8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8;
   else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_R8G8B8A8)
-    return r8g8b8_to_r8g8b8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_R8G8B8A8)
-    return r8g8b8_to_b8g8r8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8;
   else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_B8G8R8A8)
-    return r8g8b8_to_b8g8r8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_B8G8R8A8)
-    return r8g8b8_to_r8g8b8a8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8;
   else if (src_format == GDK_MEMORY_R8G8B8 && dest_format == GDK_MEMORY_A8R8G8B8)
-    return r8g8b8_to_a8r8g8b8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8;
   else if (src_format == GDK_MEMORY_B8G8R8 && dest_format == GDK_MEMORY_A8R8G8B8)
-    return r8g8b8_to_a8b8g8r8;
+    conversion = GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8;
+  else
+    return NULL;
 
-  return NULL;
+  return gdk_memory_fast_conversion_get_func (conversion, gdk_memory_simd_get_supported ());
 }
 
 typedef struct _MemoryConvert MemoryConvert;
@@ -2100,12 +2135,21 @@ struct _MemoryConvert
   GdkColorState       *src_cs;
   gsize                width;
   gsize                height;
-
-  /* atomic */ int     rows_done;
 };
 
+/* The number of pixels worth handing to another thread */
+#define PIXELS_PER_CHUNK 16384
+
+static inline gsize
+rows_per_chunk (gsize width)
+{
+  return MAX (1, PIXELS_PER_CHUNK / MAX (width, 1));
+}
+
 static void
-gdk_memory_convert_generic (gpointer data)
+gdk_memory_convert_generic (gsize    start,
+                            gsize    end,
+                            gpointer data)
 {
   MemoryConvert *mc = data;
   const GdkMemoryFormatDescription *dest_desc = &memory_formats[mc->dest_format];
@@ -2114,23 +2158,18 @@ gdk_memory_convert_generic (gpointer data)
   GdkFloatColorConvert convert_func = NULL;
   GdkFloatColorConvert convert_func2 = NULL;
   gboolean needs_premultiply, needs_unpremultiply;
-  gsize y, n;
+  gsize y;
   gint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   if (gdk_color_state_equal (mc->src_cs, mc->dest_cs))
     {
-      FastConversionFunc func;
+      GdkMemoryFastConversionFunc func;
 
       func = get_fast_conversion_func (mc->dest_format, mc->src_format);
 
       if (func != NULL)
         {
-          n = 1;
-
-          for (y = g_atomic_int_add (&mc->rows_done, n);
-               y < mc->height;
-               y = g_atomic_int_add (&mc->rows_done, n))
+          for (y = start; y < end; y++)
             {
               const guchar *src_data = mc->src_data + y * mc->src_stride;
               guchar *dest_data = mc->dest_data + y * mc->dest_stride;
@@ -2167,11 +2206,8 @@ gdk_memory_convert_generic (gpointer data)
     }
 
   tmp = g_malloc (sizeof (*tmp) * mc->width);
-  n = 1;
 
-  for (y = g_atomic_int_add (&mc->rows_done, n), rows = 0;
-       y < mc->height;
-       y = g_atomic_int_add (&mc->rows_done, n), rows++)
+  for (y = start; y < end; y++)
     {
       const guchar *src_data = mc->src_data + y * mc->src_stride;
       guchar *dest_data = mc->dest_data + y * mc->dest_stride;
@@ -2197,7 +2233,7 @@ gdk_memory_convert_generic (gpointer data)
 
   ADD_MARK (before,
             "Memory convert (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
+            mc->width, mc->height, end - start);
 }
 
 void
@@ -2256,7 +2292,7 @@ gdk_memory_convert (guchar              *dest_data,
       return;
     }
 
-  gdk_parallel_task_run (gdk_memory_convert_generic, &mc);
+  gdk_parallel_task_run (gdk_memory_convert_generic, &mc, height, rows_per_chunk (width));
 }
 
 typedef struct _MemoryConvertColorState MemoryConvertColorState;
@@ -2270,8 +2306,6 @@ struct _MemoryConvertColorState
   GdkColorState *dest_cs;
   gsize width;
   gsize height;
-
-  /* atomic */ int rows_done;
 };
 
 static const guchar srgb_lookup[] = {
@@ -2378,56 +2412,55 @@ convert_srgb_linear_to_srgb (guchar *data,
 }
 
 static void
-gdk_memory_convert_color_state_srgb_to_srgb_linear (gpointer data)
+gdk_memory_convert_color_state_srgb_to_srgb_linear (gsize    start,
+                                                    gsize    end,
+                                                    gpointer data)
 {
   MemoryConvertColorState *mc = data;
-  int y;
+  gsize y;
   guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
-  for (y = g_atomic_int_add (&mc->rows_done, 1), rows = 0;
-       y < mc->height;
-       y = g_atomic_int_add (&mc->rows_done, 1), rows++)
+  for (y = start; y < end; y++)
     {
       convert_srgb_to_srgb_linear (mc->data + y * mc->stride, mc->width);
     }
 
   ADD_MARK (before,
             "Color state convert srgb->srgb-linear (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
+            mc->width, mc->height, end - start);
 }
 
 static void
-gdk_memory_convert_color_state_srgb_linear_to_srgb (gpointer data)
+gdk_memory_convert_color_state_srgb_linear_to_srgb (gsize    start,
+                                                    gsize    end,
+                                                    gpointer data)
 {
   MemoryConvertColorState *mc = data;
-  int y;
+  gsize y;
   guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
-  for (y = g_atomic_int_add (&mc->rows_done, 1), rows = 0;
-       y < mc->height;
-       y = g_atomic_int_add (&mc->rows_done, 1), rows++)
+  for (y = start; y < end; y++)
     {
       convert_srgb_linear_to_srgb (mc->data + y * mc->stride, mc->width);
     }
 
   ADD_MARK (before,
             "Color state convert srgb-linear->srgb (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
+            mc->width, mc->height, end - start);
 }
 
 static void
-gdk_memory_convert_color_state_generic (gpointer user_data)
+gdk_memory_convert_color_state_generic (gsize    start,
+                                        gsize    end,
+                                        gpointer user_data)
 {
   MemoryConvertColorState *mc = user_data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mc->format];
   GdkFloatColorConvert convert_func = NULL;
   GdkFloatColorConvert convert_func2 = NULL;
   float (*tmp)[4];
-  int y;
+  gsize y;
   guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   convert_func = gdk_color_state_get_convert_to (mc->src_cs, mc->dest_cs);
 
@@ -2445,9 +2478,7 @@ gdk_memory_convert_color_state_generic (gpointer user_data)
 
   tmp = g_malloc (sizeof (*tmp) * mc->width);
 
-  for (y = g_atomic_int_add (&mc->rows_done, 1), rows = 0;
-       y < mc->height;
-       y = g_atomic_int_add (&mc->rows_done, 1), rows++)
+  for (y = start; y < end; y++)
     {
       guchar *data = mc->data + y * mc->stride;
 
@@ -2472,7 +2503,7 @@ gdk_memory_convert_color_state_generic (gpointer user_data)
 
   ADD_MARK (before,
             "Color state convert (thread)", "size %lux%lu, %lu rows",
-            mc->width, mc->height, rows);
+            mc->width, mc->height, end - start);
 }
 
 void
@@ -2501,17 +2532,17 @@ gdk_memory_convert_color_state (guchar          *data,
       src_color_state == GDK_COLOR_STATE_SRGB &&
       dest_color_state == GDK_COLOR_STATE_SRGB_LINEAR)
     {
-      gdk_parallel_task_run (gdk_memory_convert_color_state_srgb_to_srgb_linear, &mc);
+      gdk_parallel_task_run (gdk_memory_convert_color_state_srgb_to_srgb_linear, &mc, height, rows_per_chunk (width));
     }
   else if (format == GDK_MEMORY_B8G8R8A8_PREMULTIPLIED &&
            src_color_state == GDK_COLOR_STATE_SRGB_LINEAR &&
            dest_color_state == GDK_COLOR_STATE_SRGB)
     {
-      gdk_parallel_task_run (gdk_memory_convert_color_state_srgb_linear_to_srgb, &mc);
+      gdk_parallel_task_run (gdk_memory_convert_color_state_srgb_linear_to_srgb, &mc, height, rows_per_chunk (width));
     }
   else
     {
-      gdk_parallel_task_run (gdk_memory_convert_color_state_generic, &mc);
+      gdk_parallel_task_run (gdk_memory_convert_color_state_generic, &mc, height, rows_per_chunk (width));
     }
 }
 
@@ -2529,24 +2560,21 @@ struct _MipmapData
   gsize            src_height;
   guint            lod_level;
   gboolean         linear;
-
-  gint             rows_done;
 };
 
 static void
-gdk_memory_mipmap_same_format_nearest (gpointer data)
+gdk_memory_mipmap_same_format_nearest (gsize    start,
+                                       gsize    end,
+                                       gpointer data)
 {
   MipmapData *mipmap = data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mipmap->src_format];
   gsize n, y;
   guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   n = 1 << mipmap->lod_level;
 
-  for (y = g_atomic_int_add (&mipmap->rows_done, n), rows = 0;
-       y < mipmap->src_height;
-       y = g_atomic_int_add (&mipmap->rows_done, n), rows++)
+  for (y = start * n; y < MIN (end * n, mipmap->src_height); y += n)
     {
       guchar *dest = mipmap->dest + (y >> mipmap->lod_level) * mipmap->dest_stride;
       const guchar *src = mipmap->src + y * mipmap->src_stride;
@@ -2559,23 +2587,22 @@ gdk_memory_mipmap_same_format_nearest (gpointer data)
 
   ADD_MARK (before,
             "Mipmap nearest (thread)", "size %lux%lu, lod %u, %lu rows",
-            mipmap->src_width, mipmap->src_height, mipmap->lod_level, rows);
+            mipmap->src_width, mipmap->src_height, mipmap->lod_level, end - start);
 }
 
 static void
-gdk_memory_mipmap_same_format_linear (gpointer data)
+gdk_memory_mipmap_same_format_linear (gsize    start,
+                                      gsize    end,
+                                      gpointer data)
 {
   MipmapData *mipmap = data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mipmap->src_format];
   gsize n, y;
   guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   n = 1 << mipmap->lod_level;
 
-  for (y = g_atomic_int_add (&mipmap->rows_done, n), rows = 0;
-       y < mipmap->src_height;
-       y = g_atomic_int_add (&mipmap->rows_done, n), rows++)
+  for (y = start * n; y < MIN (end * n, mipmap->src_height); y += n)
     {
       guchar *dest = mipmap->dest + (y >> mipmap->lod_level) * mipmap->dest_stride;
       const guchar *src = mipmap->src + y * mipmap->src_stride;
@@ -2588,21 +2615,22 @@ gdk_memory_mipmap_same_format_linear (gpointer data)
 
   ADD_MARK (before,
             "Mipmap linear (thread)", "size %lux%lu, lod %u, %lu rows",
-            mipmap->src_width, mipmap->src_height, mipmap->lod_level, rows);
+            mipmap->src_width, mipmap->src_height, mipmap->lod_level, end - start);
 }
 
 static void
-gdk_memory_mipmap_generic (gpointer data)
+gdk_memory_mipmap_generic (gsize    start,
+                           gsize    end,
+                           gpointer data)
 {
   MipmapData *mipmap = data;
   const GdkMemoryFormatDescription *desc = &memory_formats[mipmap->src_format];
-  FastConversionFunc func;
+  GdkMemoryFastConversionFunc func;
   gsize dest_width;
   gsize size;
   guchar *tmp;
   gsize n, y;
   guint64 before = GDK_PROFILER_CURRENT_TIME;
-  gsize rows;
 
   n = 1 << mipmap->lod_level;
   dest_width = (mipmap->src_width + n - 1) >> mipmap->lod_level;
@@ -2610,9 +2638,7 @@ gdk_memory_mipmap_generic (gpointer data)
   tmp = g_malloc (size);
   func = get_fast_conversion_func (mipmap->dest_format, mipmap->src_format);
 
-  for (y = g_atomic_int_add (&mipmap->rows_done, n), rows = 0;
-       y < mipmap->src_height;
-       y = g_atomic_int_add (&mipmap->rows_done, n), rows++)
+  for (y = start * n; y < MIN (end * n, mipmap->src_height); y += n)
     {
       guchar *dest = mipmap->dest + (y >> mipmap->lod_level) * mipmap->dest_stride;
       const guchar *src = mipmap->src + y * mipmap->src_stride;
@@ -2639,7 +2665,7 @@ gdk_memory_mipmap_generic (gpointer data)
 
   ADD_MARK (before,
             "Mipmap generic (thread)", "size %lux%lu, lod %u, %lu rows",
-            mipmap->src_width, mipmap->src_height, mipmap->lod_level, rows);
+            mipmap->src_width, mipmap->src_height, mipmap->lod_level, end - start);
 }
 
 void
@@ -2665,21 +2691,25 @@ gdk_memory_mipmap (guchar          *dest,
     .src_height = src_height,
     .lod_level = lod_level,
     .linear = linear,
-    .rows_done = 0,
   };
+  gsize n_rows, chunk_size;
 
   g_assert (lod_level > 0);
 
+  /* Each item is one row of the destination */
+  n_rows = (src_height + (1 << lod_level) - 1) >> lod_level;
+  chunk_size = MAX (1, rows_per_chunk (src_width) >> lod_level);
+
   if (dest_format == src_format)
     {
       if (linear)
-        gdk_parallel_task_run (gdk_memory_mipmap_same_format_linear, &mipmap);
+        gdk_parallel_task_run (gdk_memory_mipmap_same_format_linear, &mipmap, n_rows, chunk_size);
       else
-        gdk_parallel_task_run (gdk_memory_mipmap_same_format_nearest, &mipmap);
+        gdk_parallel_task_run (gdk_memory_mipmap_same_format_nearest, &mipmap, n_rows, chunk_size);
     }
   else
     {
-      gdk_parallel_task_run (gdk_memory_mipmap_generic, &mipmap);
+      gdk_parallel_task_run (gdk_memory_mipmap_generic, &mipmap, n_rows, chunk_size);
     }
 }
 
@@ -0,0 +1,179 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemoryformatsimdprivate.h"
+
+#ifdef HAVE_AVX2
+
+#include <immintrin.h>
+#include <string.h>
+
+/* Creates a mask for _mm256_shuffle_epi8() that moves the channels
+ * of each pixel into the given order. Pixels are src_bpp bytes apart
+ * in the source and source channel 3 becomes zero if there's no alpha.
+ */
+static inline __m256i
+make_shuffle_mask (const guchar order[4],
+                   gsize        src_bpp)
+{
+  guchar mask[32];
+
+  for (gsize p = 0; p < 8; p++)
+    for (gsize i = 0; i < 4; i++)
+      {
+        if (order[i] >= src_bpp)
+          mask[4 * p + i] = 0x80;
+        else
+          mask[4 * p + i] = src_bpp * (p % 4) + order[i];
+      }
+
+  return _mm256_loadu_si256 ((const __m256i *) mask);
+}
+
+static inline __m256i
+premultiply_u16 (__m256i x)
+{
+  const __m256i alpha_mask = _mm256_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0,
+                                               -1, 0, 0, 0, -1, 0, 0, 0);
+  __m256i a;
+
+  a = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (x, _MM_SHUFFLE (3, 3, 3, 3)), _MM_SHUFFLE (3, 3, 3, 3));
+  /* multiply alpha with 255, which the division below turns into a no-op */
+  a = _mm256_blendv_epi8 (a, _mm256_set1_epi16 (255), alpha_mask);
+
+  /* c * a + 127 <= 65152, so all of this fits into 16 bits */
+  x = _mm256_add_epi16 (_mm256_mullo_epi16 (x, a), _mm256_set1_epi16 (127));
+  x = _mm256_add_epi16 (x, _mm256_srli_epi16 (x, 8));
+  x = _mm256_add_epi16 (x, _mm256_set1_epi16 (1));
+
+  return _mm256_srli_epi16 (x, 8);
+}
+
+static inline void
+premultiply_avx2 (guchar       *dest,
+                  const guchar *src,
+                  gsize         n,
+                  const guchar  order[4])
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i mask = make_shuffle_mask (order, 4);
+
+  for (; n >= 8; n -= 8)
+    {
+      __m256i pixels = _mm256_loadu_si256 ((const __m256i *) src);
+      /* unpack and pack work per 128bit lane, so the pixel order is preserved */
+      __m256i lo = premultiply_u16 (_mm256_unpacklo_epi8 (pixels, zero));
+      __m256i hi = premultiply_u16 (_mm256_unpackhi_epi8 (pixels, zero));
+
+      pixels = _mm256_shuffle_epi8 (_mm256_packus_epi16 (lo, hi), mask);
+      _mm256_storeu_si256 ((__m256i *) dest, pixels);
+
+      dest += 32;
+      src += 32;
+    }
+
+  gdk_memory_simd_premultiply_tail (dest, src, n, order);
+}
+
+static inline void
+add_alpha_avx2 (guchar       *dest,
+                const guchar *src,
+                gsize         n,
+                const guchar  order[4])
+{
+  const __m256i mask = make_shuffle_mask (order, 3);
+  const __m256i alpha = _mm256_shuffle_epi8 (_mm256_set1_epi32 ((int) 0xFF000000u), make_shuffle_mask (order, 4));
+
+  for (; n >= 8; n -= 8)
+    {
+      __m128i lo, hi;
+      guint32 tmp[2];
+      __m256i pixels;
+
+      /* load exactly 12 bytes per lane so we never read past the end */
+      memcpy (tmp, src + 8, 4);
+      memcpy (tmp + 1, src + 20, 4);
+      lo = _mm_unpacklo_epi64 (_mm_loadl_epi64 ((const __m128i *) src), _mm_cvtsi32_si128 (tmp[0]));
+      hi = _mm_unpacklo_epi64 (_mm_loadl_epi64 ((const __m128i *) (src + 12)), _mm_cvtsi32_si128 (tmp[1]));
+      pixels = _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+
+      pixels = _mm256_or_si256 (_mm256_shuffle_epi8 (pixels, mask), alpha);
+      _mm256_storeu_si256 ((__m256i *) dest, pixels);
+
+      dest += 32;
+      src += 24;
+    }
+
+  gdk_memory_simd_add_alpha_tail (dest, src, n, order);
+}
+
+static inline void
+swizzle_avx2 (guchar       *dest,
+              const guchar *src,
+              gsize         n,
+              const guchar  order[4])
+{
+  const __m256i mask = make_shuffle_mask (order, 4);
+
+  for (; n >= 8; n -= 8)
+    {
+      __m256i pixels = _mm256_loadu_si256 ((const __m256i *) src);
+
+      _mm256_storeu_si256 ((__m256i *) dest, _mm256_shuffle_epi8 (pixels, mask));
+
+      dest += 32;
+      src += 32;
+    }
+
+  gdk_memory_simd_swizzle_tail (dest, src, n, order);
+}
+
+#define CONVERT_FUNC(name, kernel, O0, O1, O2, O3) \
+static void \
+name ## _avx2 (guchar       *dest, \
+               const guchar *src, \
+               gsize         n) \
+{ \
+  static const guchar order[4] = { O0, O1, O2, O3 }; \
+\
+  kernel ## _avx2 (dest, src, n, order); \
+}
+
+CONVERT_FUNC (r8g8b8a8_to_r8g8b8a8_premultiplied, premultiply, 0, 1, 2, 3)
+CONVERT_FUNC (r8g8b8a8_to_b8g8r8a8_premultiplied, premultiply, 2, 1, 0, 3)
+CONVERT_FUNC (r8g8b8a8_to_a8r8g8b8_premultiplied, premultiply, 3, 0, 1, 2)
+CONVERT_FUNC (r8g8b8a8_to_a8b8g8r8_premultiplied, premultiply, 3, 2, 1, 0)
+CONVERT_FUNC (r8g8b8_to_r8g8b8a8, add_alpha, 0, 1, 2, 3)
+CONVERT_FUNC (r8g8b8_to_b8g8r8a8, add_alpha, 2, 1, 0, 3)
+CONVERT_FUNC (r8g8b8_to_a8r8g8b8, add_alpha, 3, 0, 1, 2)
+CONVERT_FUNC (r8g8b8_to_a8b8g8r8, add_alpha, 3, 2, 1, 0)
+CONVERT_FUNC (r8g8b8a8_to_b8g8r8a8, swizzle, 2, 1, 0, 3)
+
+const GdkMemoryFastConversionFunc gdk_memory_fast_conversions_avx2[GDK_MEMORY_N_FAST_CONVERSIONS] = {
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED] = r8g8b8a8_to_r8g8b8a8_premultiplied_avx2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED] = r8g8b8a8_to_b8g8r8a8_premultiplied_avx2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8R8G8B8_PREMULTIPLIED] = r8g8b8a8_to_a8r8g8b8_premultiplied_avx2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8B8G8R8_PREMULTIPLIED] = r8g8b8a8_to_a8b8g8r8_premultiplied_avx2,
+  [GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8] = r8g8b8_to_r8g8b8a8_avx2,
+  [GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8] = r8g8b8_to_b8g8r8a8_avx2,
+  [GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8] = r8g8b8_to_a8r8g8b8_avx2,
+  [GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8] = r8g8b8_to_a8b8g8r8_avx2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8] = r8g8b8a8_to_b8g8r8a8_avx2,
+};
+
+#endif /* HAVE_AVX2 */
+
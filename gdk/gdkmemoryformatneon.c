@@ -0,0 +1,162 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemoryformatsimdprivate.h"
+
+#ifdef HAVE_NEON
+
+#include <arm_neon.h>
+
+/* vld4/vst4 deinterleave the channels for us, so reordering is
+ * just a matter of picking the right register.
+ */
+
+static inline uint8x8_t
+premultiply_half (uint8x8_t c,
+                  uint8x8_t a)
+{
+  /* c * a + 127 <= 65152, so all of this fits into 16 bits */
+  uint16x8_t x = vmlal_u8 (vdupq_n_u16 (127), c, a);
+
+  x = vsraq_n_u16 (x, x, 8);
+  x = vaddq_u16 (x, vdupq_n_u16 (1));
+
+  return vshrn_n_u16 (x, 8);
+}
+
+static inline uint8x16_t
+premultiply_channel (uint8x16_t c,
+                     uint8x16_t a)
+{
+  return vcombine_u8 (premultiply_half (vget_low_u8 (c), vget_low_u8 (a)),
+                      premultiply_half (vget_high_u8 (c), vget_high_u8 (a)));
+}
+
+static inline void
+premultiply_neon (guchar       *dest,
+                  const guchar *src,
+                  gsize         n,
+                  const guchar  order[4])
+{
+  for (; n >= 16; n -= 16)
+    {
+      uint8x16x4_t in = vld4q_u8 (src);
+      uint8x16x4_t out;
+      uint8x16_t pixel[4];
+
+      pixel[0] = premultiply_channel (in.val[0], in.val[3]);
+      pixel[1] = premultiply_channel (in.val[1], in.val[3]);
+      pixel[2] = premultiply_channel (in.val[2], in.val[3]);
+      pixel[3] = in.val[3];
+
+      out.val[0] = pixel[order[0]];
+      out.val[1] = pixel[order[1]];
+      out.val[2] = pixel[order[2]];
+      out.val[3] = pixel[order[3]];
+      vst4q_u8 (dest, out);
+
+      dest += 64;
+      src += 64;
+    }
+
+  gdk_memory_simd_premultiply_tail (dest, src, n, order);
+}
+
+static inline void
+add_alpha_neon (guchar       *dest,
+                const guchar *src,
+                gsize         n,
+                const guchar  order[4])
+{
+  for (; n >= 16; n -= 16)
+    {
+      uint8x16x3_t in = vld3q_u8 (src);
+      uint8x16x4_t out;
+      uint8x16_t pixel[4] = { in.val[0], in.val[1], in.val[2], vdupq_n_u8 (255) };
+
+      out.val[0] = pixel[order[0]];
+      out.val[1] = pixel[order[1]];
+      out.val[2] = pixel[order[2]];
+      out.val[3] = pixel[order[3]];
+      vst4q_u8 (dest, out);
+
+      dest += 64;
+      src += 48;
+    }
+
+  gdk_memory_simd_add_alpha_tail (dest, src, n, order);
+}
+
+static inline void
+swizzle_neon (guchar       *dest,
+              const guchar *src,
+              gsize         n,
+              const guchar  order[4])
+{
+  for (; n >= 16; n -= 16)
+    {
+      uint8x16x4_t in = vld4q_u8 (src);
+      uint8x16x4_t out;
+
+      out.val[0] = in.val[order[0]];
+      out.val[1] = in.val[order[1]];
+      out.val[2] = in.val[order[2]];
+      out.val[3] = in.val[order[3]];
+      vst4q_u8 (dest, out);
+
+      dest += 64;
+      src += 64;
+    }
+
+  gdk_memory_simd_swizzle_tail (dest, src, n, order);
+}
+
+#define CONVERT_FUNC(name, kernel, O0, O1, O2, O3) \
+static void \
+name ## _neon (guchar       *dest, \
+               const guchar *src, \
+               gsize         n) \
+{ \
+  static const guchar order[4] = { O0, O1, O2, O3 }; \
+\
+  kernel ## _neon (dest, src, n, order); \
+}
+
+CONVERT_FUNC (r8g8b8a8_to_r8g8b8a8_premultiplied, premultiply, 0, 1, 2, 3)
+CONVERT_FUNC (r8g8b8a8_to_b8g8r8a8_premultiplied, premultiply, 2, 1, 0, 3)
+CONVERT_FUNC (r8g8b8a8_to_a8r8g8b8_premultiplied, premultiply, 3, 0, 1, 2)
+CONVERT_FUNC (r8g8b8a8_to_a8b8g8r8_premultiplied, premultiply, 3, 2, 1, 0)
+CONVERT_FUNC (r8g8b8_to_r8g8b8a8, add_alpha, 0, 1, 2, 3)
+CONVERT_FUNC (r8g8b8_to_b8g8r8a8, add_alpha, 2, 1, 0, 3)
+CONVERT_FUNC (r8g8b8_to_a8r8g8b8, add_alpha, 3, 0, 1, 2)
+CONVERT_FUNC (r8g8b8_to_a8b8g8r8, add_alpha, 3, 2, 1, 0)
+CONVERT_FUNC (r8g8b8a8_to_b8g8r8a8, swizzle, 2, 1, 0, 3)
+
+const GdkMemoryFastConversionFunc gdk_memory_fast_conversions_neon[GDK_MEMORY_N_FAST_CONVERSIONS] = {
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED] = r8g8b8a8_to_r8g8b8a8_premultiplied_neon,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED] = r8g8b8a8_to_b8g8r8a8_premultiplied_neon,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8R8G8B8_PREMULTIPLIED] = r8g8b8a8_to_a8r8g8b8_premultiplied_neon,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8B8G8R8_PREMULTIPLIED] = r8g8b8a8_to_a8b8g8r8_premultiplied_neon,
+  [GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8] = r8g8b8_to_r8g8b8a8_neon,
+  [GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8] = r8g8b8_to_b8g8r8a8_neon,
+  [GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8] = r8g8b8_to_a8r8g8b8_neon,
+  [GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8] = r8g8b8_to_a8b8g8r8_neon,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8] = r8g8b8a8_to_b8g8r8a8_neon,
+};
+
+#endif /* HAVE_NEON */
+
@@ -0,0 +1,155 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemoryformatsimdprivate.h"
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(HAVE_SSE2) || defined(HAVE_AVX2))
+#include <intrin.h>
+#include <immintrin.h>
+
+/* based on info from https://walbourn.github.io/directxmath-f16c-and-fma/ */
+static GdkMemorySimd
+detect_simd_msvc (void)
+{
+  GdkMemorySimd result = 0;
+  int cpuinfo[4] = { -1 };
+  int n_ids;
+
+  __cpuid (cpuinfo, 0);
+  n_ids = cpuinfo[0];
+  if (n_ids < 1)
+    return 0;
+
+  __cpuid (cpuinfo, 1);
+#ifdef HAVE_SSE2
+  if (cpuinfo[3] & (1 << 26))
+    result |= GDK_MEMORY_SIMD_SSE2;
+#endif
+#ifdef HAVE_AVX2
+  /* The OS must save the YMM registers */
+  if ((cpuinfo[2] & (1 << 27)) && (_xgetbv (0) & 6) == 6 && n_ids >= 7)
+    {
+      __cpuidex (cpuinfo, 7, 0);
+      if (cpuinfo[1] & (1 << 5))
+        result |= GDK_MEMORY_SIMD_AVX2;
+    }
+#endif
+
+  return result;
+}
+#endif
+
+static GdkMemorySimd
+detect_simd (void)
+{
+  GdkMemorySimd result = 0;
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(HAVE_SSE2) || defined(HAVE_AVX2))
+  result = detect_simd_msvc ();
+#elif defined(HAVE_SSE2) || defined(HAVE_AVX2)
+  __builtin_cpu_init ();
+#ifdef HAVE_SSE2
+  if (__builtin_cpu_supports ("sse2"))
+    result |= GDK_MEMORY_SIMD_SSE2;
+#endif
+#ifdef HAVE_AVX2
+  if (__builtin_cpu_supports ("avx2"))
+    result |= GDK_MEMORY_SIMD_AVX2;
+#endif
+#endif
+
+#ifdef HAVE_NEON
+  /* NEON is mandatory on aarch64 */
+  result |= GDK_MEMORY_SIMD_NEON;
+#endif
+
+  return result;
+}
+
+/*<private>
+ * gdk_memory_simd_get_supported:
+ *
+ * Gets the instruction sets that the kernels were compiled for
+ * and that the CPU we are running on supports.
+ *
+ * Returns: the supported instruction sets
+ **/
+GdkMemorySimd
+gdk_memory_simd_get_supported (void)
+{
+  static gsize supported = 0;
+
+  if (g_once_init_enter (&supported))
+    g_once_init_leave (&supported, detect_simd () | (1u << 31));
+
+  return supported & GDK_MEMORY_SIMD_ALL;
+}
+
+const char *
+gdk_memory_simd_get_name (GdkMemorySimd simd)
+{
+  switch (simd)
+    {
+    case GDK_MEMORY_SIMD_NONE:
+      return "none";
+    case GDK_MEMORY_SIMD_SSE2:
+      return "sse2";
+    case GDK_MEMORY_SIMD_AVX2:
+      return "avx2";
+    case GDK_MEMORY_SIMD_NEON:
+      return "neon";
+    default:
+      g_return_val_if_reached ("");
+    }
+}
+
+/*<private>
+ * gdk_memory_simd_get_fast_conversion:
+ * @conversion: the conversion to look up
+ * @simd: the instruction sets that may be used
+ *
+ * Finds the best SIMD kernel for the given conversion that only
+ * uses the given instruction sets.
+ *
+ * It is the caller's responsibility to only pass instruction sets
+ * that are supported, see gdk_memory_simd_get_supported().
+ *
+ * Returns: (nullable): the kernel or %NULL if there is none
+ **/
+GdkMemoryFastConversionFunc
+gdk_memory_simd_get_fast_conversion (GdkMemoryFastConversion conversion,
+                                     GdkMemorySimd           simd)
+{
+  g_assert (conversion < GDK_MEMORY_N_FAST_CONVERSIONS);
+  g_assert ((simd & ~gdk_memory_simd_get_supported ()) == 0);
+
+#ifdef HAVE_AVX2
+  if ((simd & GDK_MEMORY_SIMD_AVX2) && gdk_memory_fast_conversions_avx2[conversion])
+    return gdk_memory_fast_conversions_avx2[conversion];
+#endif
+#ifdef HAVE_SSE2
+  if ((simd & GDK_MEMORY_SIMD_SSE2) && gdk_memory_fast_conversions_sse2[conversion])
+    return gdk_memory_fast_conversions_sse2[conversion];
+#endif
+#ifdef HAVE_NEON
+  if ((simd & GDK_MEMORY_SIMD_NEON) && gdk_memory_fast_conversions_neon[conversion])
+    return gdk_memory_fast_conversions_neon[conversion];
+#endif
+
+  return NULL;
+}
+
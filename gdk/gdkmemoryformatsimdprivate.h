@@ -0,0 +1,136 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  GDK_MEMORY_SIMD_NONE = 0,
+  GDK_MEMORY_SIMD_SSE2 = 1 << 0,
+  GDK_MEMORY_SIMD_AVX2 = 1 << 1,
+  GDK_MEMORY_SIMD_NEON = 1 << 2,
+} GdkMemorySimd;
+
+#define GDK_MEMORY_SIMD_ALL (GDK_MEMORY_SIMD_SSE2 | GDK_MEMORY_SIMD_AVX2 | GDK_MEMORY_SIMD_NEON)
+
+/* The 8bit conversions that get_fast_conversion_func() can pick.
+ * Keep in sync with the kernel tables in gdkmemoryformat*.c
+ */
+typedef enum {
+  GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED,
+  GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED,
+  GDK_MEMORY_FAST_R8G8B8A8_TO_A8R8G8B8_PREMULTIPLIED,
+  GDK_MEMORY_FAST_R8G8B8A8_TO_A8B8G8R8_PREMULTIPLIED,
+  GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8,
+  GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8,
+  GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8,
+  GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8,
+  GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8,
+
+  GDK_MEMORY_N_FAST_CONVERSIONS
+} GdkMemoryFastConversion;
+
+typedef void (* GdkMemoryFastConversionFunc) (guchar       *dest,
+                                              const guchar *src,
+                                              gsize         n);
+
+GdkMemorySimd           gdk_memory_simd_get_supported           (void) G_GNUC_CONST;
+const char *            gdk_memory_simd_get_name                (GdkMemorySimd                simd);
+
+GdkMemoryFastConversionFunc
+                        gdk_memory_simd_get_fast_conversion     (GdkMemoryFastConversion      conversion,
+                                                                 GdkMemorySimd                simd);
+GdkMemoryFastConversionFunc
+                        gdk_memory_fast_conversion_get_func     (GdkMemoryFastConversion      conversion,
+                                                                 GdkMemorySimd                simd);
+
+/* Entries may be NULL if the instruction set has no fast path for a conversion */
+extern const GdkMemoryFastConversionFunc gdk_memory_fast_conversions_sse2[GDK_MEMORY_N_FAST_CONVERSIONS];
+extern const GdkMemoryFastConversionFunc gdk_memory_fast_conversions_avx2[GDK_MEMORY_N_FAST_CONVERSIONS];
+extern const GdkMemoryFastConversionFunc gdk_memory_fast_conversions_neon[GDK_MEMORY_N_FAST_CONVERSIONS];
+
+/* Scalar versions for the leftover pixels of the SIMD kernels.
+ * These must produce the same results as the functions in gdkmemoryformat.c.
+ *
+ * @order says which source channel goes into each dest channel, with the
+ * source always being RGB(A) and 3 in add_alpha meaning opaque alpha.
+ */
+static inline void
+gdk_memory_simd_premultiply_tail (guchar       *dest,
+                                  const guchar *src,
+                                  gsize         n,
+                                  const guchar  order[4])
+{
+  for (; n > 0; n--)
+    {
+      guchar pixel[4];
+      guchar a = src[3];
+
+      for (gsize i = 0; i < 3; i++)
+        {
+          guint16 c = (guint16) src[i] * a + 127;
+          pixel[i] = (c + (c >> 8) + 1) >> 8;
+        }
+      pixel[3] = a;
+
+      for (gsize i = 0; i < 4; i++)
+        dest[i] = pixel[order[i]];
+
+      dest += 4;
+      src += 4;
+    }
+}
+
+static inline void
+gdk_memory_simd_add_alpha_tail (guchar       *dest,
+                                const guchar *src,
+                                gsize         n,
+                                const guchar  order[4])
+{
+  for (; n > 0; n--)
+    {
+      guchar pixel[4] = { src[0], src[1], src[2], 255 };
+
+      for (gsize i = 0; i < 4; i++)
+        dest[i] = pixel[order[i]];
+
+      dest += 4;
+      src += 3;
+    }
+}
+
+static inline void
+gdk_memory_simd_swizzle_tail (guchar       *dest,
+                              const guchar *src,
+                              gsize         n,
+                              const guchar  order[4])
+{
+  for (; n > 0; n--)
+    {
+      guchar pixel[4] = { src[0], src[1], src[2], src[3] };
+
+      for (gsize i = 0; i < 4; i++)
+        dest[i] = pixel[order[i]];
+
+      dest += 4;
+      src += 4;
+    }
+}
+
+G_END_DECLS
+
@@ -0,0 +1,116 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkmemoryformatsimdprivate.h"
+
+#ifdef HAVE_SSE2
+
+#include <emmintrin.h>
+
+/* SSE2 has no byte shuffle, so we work on 16bit channels and use
+ * shufflelo/shufflehi, which need the order as an immediate.
+ */
+
+static inline __m128i
+premultiply_u16 (__m128i x)
+{
+  const __m128i alpha_mask = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+  __m128i a;
+
+  a = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (x, _MM_SHUFFLE (3, 3, 3, 3)), _MM_SHUFFLE (3, 3, 3, 3));
+  /* multiply alpha with 255, which the division below turns into a no-op */
+  a = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, a), _mm_and_si128 (alpha_mask, _mm_set1_epi16 (255)));
+
+  /* c * a + 127 <= 65152, so all of this fits into 16 bits */
+  x = _mm_add_epi16 (_mm_mullo_epi16 (x, a), _mm_set1_epi16 (127));
+  x = _mm_add_epi16 (x, _mm_srli_epi16 (x, 8));
+  x = _mm_add_epi16 (x, _mm_set1_epi16 (1));
+
+  return _mm_srli_epi16 (x, 8);
+}
+
+#define SHUFFLE_U16(x, O0, O1, O2, O3) \
+  _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (x, _MM_SHUFFLE (O3, O2, O1, O0)), _MM_SHUFFLE (O3, O2, O1, O0))
+
+#define PREMULTIPLY_FUNC(name, O0, O1, O2, O3) \
+static void \
+name ## _sse2 (guchar       *dest, \
+               const guchar *src, \
+               gsize         n) \
+{ \
+  static const guchar order[4] = { O0, O1, O2, O3 }; \
+  const __m128i zero = _mm_setzero_si128 (); \
+\
+  for (; n >= 4; n -= 4) \
+    { \
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) src); \
+      __m128i lo = premultiply_u16 (_mm_unpacklo_epi8 (pixels, zero)); \
+      __m128i hi = premultiply_u16 (_mm_unpackhi_epi8 (pixels, zero)); \
+\
+      lo = SHUFFLE_U16 (lo, O0, O1, O2, O3); \
+      hi = SHUFFLE_U16 (hi, O0, O1, O2, O3); \
+      _mm_storeu_si128 ((__m128i *) dest, _mm_packus_epi16 (lo, hi)); \
+\
+      dest += 16; \
+      src += 16; \
+    } \
+\
+  gdk_memory_simd_premultiply_tail (dest, src, n, order); \
+}
+
+PREMULTIPLY_FUNC (r8g8b8a8_to_r8g8b8a8_premultiplied, 0, 1, 2, 3)
+PREMULTIPLY_FUNC (r8g8b8a8_to_b8g8r8a8_premultiplied, 2, 1, 0, 3)
+PREMULTIPLY_FUNC (r8g8b8a8_to_a8r8g8b8_premultiplied, 3, 0, 1, 2)
+PREMULTIPLY_FUNC (r8g8b8a8_to_a8b8g8r8_premultiplied, 3, 2, 1, 0)
+
+#define SWIZZLE_FUNC(name, O0, O1, O2, O3) \
+static void \
+name ## _sse2 (guchar       *dest, \
+               const guchar *src, \
+               gsize         n) \
+{ \
+  static const guchar order[4] = { O0, O1, O2, O3 }; \
+  const __m128i zero = _mm_setzero_si128 (); \
+\
+  for (; n >= 4; n -= 4) \
+    { \
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) src); \
+      __m128i lo = SHUFFLE_U16 (_mm_unpacklo_epi8 (pixels, zero), O0, O1, O2, O3); \
+      __m128i hi = SHUFFLE_U16 (_mm_unpackhi_epi8 (pixels, zero), O0, O1, O2, O3); \
+\
+      _mm_storeu_si128 ((__m128i *) dest, _mm_packus_epi16 (lo, hi)); \
+\
+      dest += 16; \
+      src += 16; \
+    } \
+\
+  gdk_memory_simd_swizzle_tail (dest, src, n, order); \
+}
+
+SWIZZLE_FUNC (r8g8b8a8_to_b8g8r8a8, 2, 1, 0, 3)
+
+/* Adding alpha needs byte shuffles to be fast, leave it to the scalar code */
+const GdkMemoryFastConversionFunc gdk_memory_fast_conversions_sse2[GDK_MEMORY_N_FAST_CONVERSIONS] = {
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_R8G8B8A8_PREMULTIPLIED] = r8g8b8a8_to_r8g8b8a8_premultiplied_sse2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8_PREMULTIPLIED] = r8g8b8a8_to_b8g8r8a8_premultiplied_sse2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8R8G8B8_PREMULTIPLIED] = r8g8b8a8_to_a8r8g8b8_premultiplied_sse2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_A8B8G8R8_PREMULTIPLIED] = r8g8b8a8_to_a8b8g8r8_premultiplied_sse2,
+  [GDK_MEMORY_FAST_R8G8B8A8_TO_B8G8R8A8] = r8g8b8a8_to_b8g8r8a8_sse2,
+};
+
+#endif /* HAVE_SSE2 */
+
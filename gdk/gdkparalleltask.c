@@ -21,66 +21,299 @@
 
 #include "gdkparalleltaskprivate.h"
 
-typedef struct _TaskData TaskData;
+#include "gdkprofilerprivate.h"
 
-struct _TaskData
+/* The items of a task get split into one contiguous range per
+ * participating thread. Threads take chunks from the front of
+ * their own range and when that is empty, steal the back half
+ * of somebody else's range.
+ *
+ * The caller participates, too, and only waits for chunks that
+ * are currently being worked on. So it never waits for a thread
+ * in the pool to pick up the task, which makes it safe to call
+ * gdk_parallel_task_run() from inside a task function.
+ */
+
+typedef struct _TaskRange TaskRange;
+typedef struct _Task Task;
+
+struct _TaskRange
+{
+  GMutex lock;
+  gsize start;
+  gsize end;
+};
+
+struct _Task
 {
+  gatomicrefcount ref_count;
+
   GdkTaskFunc task_func;
   gpointer task_data;
-  int n_running_tasks;
+  gsize n_items;
+  gsize chunk_size;
+
+  /* atomic */ guint next_participant;
+  guint n_participants;
+  TaskRange *ranges;
+
+  GMutex done_lock;
+  GCond done_cond;
+  gsize n_done;
+
+  /* atomic, the most threads that were busy at once */
+  int max_busy;
 };
 
+static GThreadPool *pool;
+static guint n_threads;
+/* the number of threads participating in tasks */
+static /* atomic */ int n_busy;
+static guint utilization_counter;
+
+/* how many tasks the current thread participates in, tasks can
+ * be run from inside task functions but the thread only counts
+ * as busy once */
+static GPrivate participation_depth;
+
+static void
+gdk_parallel_task_unref (Task *task)
+{
+  guint i;
+
+  if (!g_atomic_ref_count_dec (&task->ref_count))
+    return;
+
+  for (i = 0; i < task->n_participants; i++)
+    g_mutex_clear (&task->ranges[i].lock);
+  g_free (task->ranges);
+  g_mutex_clear (&task->done_lock);
+  g_cond_clear (&task->done_cond);
+  g_free (task);
+}
+
+static void
+gdk_parallel_task_update_max_busy (Task *task,
+                                   int   busy)
+{
+  int max_busy;
+
+  do
+    {
+      max_busy = g_atomic_int_get (&task->max_busy);
+      if (busy <= max_busy)
+        return;
+    }
+  while (!g_atomic_int_compare_and_exchange (&task->max_busy, max_busy, busy));
+}
+
+static gboolean
+gdk_parallel_task_pop (Task  *task,
+                       guint  self,
+                       gsize *start,
+                       gsize *end)
+{
+  TaskRange *range = &task->ranges[self];
+  gboolean result;
+
+  g_mutex_lock (&range->lock);
+  result = range->start < range->end;
+  if (result)
+    {
+      *start = range->start;
+      *end = MIN (range->start + task->chunk_size, range->end);
+      range->start = *end;
+    }
+  g_mutex_unlock (&range->lock);
+
+  return result;
+}
+
+/* Moves the back half of another thread's range into our own,
+ * which must be empty. Returns FALSE if there's nothing left.
+ */
+static gboolean
+gdk_parallel_task_steal (Task  *task,
+                         guint  self)
+{
+  guint i;
+
+  for (i = 1; i < task->n_participants; i++)
+    {
+      TaskRange *victim = &task->ranges[(self + i) % task->n_participants];
+      gsize start, end, n_chunks;
+
+      g_mutex_lock (&victim->lock);
+      end = victim->end;
+      if (victim->start >= end)
+        {
+          g_mutex_unlock (&victim->lock);
+          continue;
+        }
+      /* The owner might not have started yet, so take everything if
+       * there's not enough left to share.
+       */
+      n_chunks = (end - victim->start + task->chunk_size - 1) / task->chunk_size;
+      start = victim->start + n_chunks / 2 * task->chunk_size;
+      victim->end = start;
+      g_mutex_unlock (&victim->lock);
+
+      g_mutex_lock (&task->ranges[self].lock);
+      task->ranges[self].start = start;
+      task->ranges[self].end = end;
+      g_mutex_unlock (&task->ranges[self].lock);
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gdk_parallel_task_participate (Task  *task,
+                               guint  self)
+{
+  gsize start, end;
+  guint depth;
+
+  depth = GPOINTER_TO_UINT (g_private_get (&participation_depth));
+  g_private_set (&participation_depth, GUINT_TO_POINTER (depth + 1));
+
+  if (depth == 0)
+    gdk_parallel_task_update_max_busy (task, g_atomic_int_add (&n_busy, 1) + 1);
+  else
+    gdk_parallel_task_update_max_busy (task, g_atomic_int_get (&n_busy));
+
+  do
+    {
+      while (gdk_parallel_task_pop (task, self, &start, &end))
+        {
+          task->task_func (start, end, task->task_data);
+
+          g_mutex_lock (&task->done_lock);
+          task->n_done += end - start;
+          if (task->n_done == task->n_items)
+            g_cond_signal (&task->done_cond);
+          g_mutex_unlock (&task->done_lock);
+        }
+    }
+  while (gdk_parallel_task_steal (task, self));
+
+  if (depth == 0)
+    g_atomic_int_add (&n_busy, -1);
+
+  g_private_set (&participation_depth, GUINT_TO_POINTER (depth));
+}
+
 static void
 gdk_parallel_task_thread_func (gpointer data,
                                gpointer unused)
 {
-  TaskData *task = data;
+  Task *task = data;
 
-  task->task_func (task->task_data);
+  gdk_parallel_task_participate (task, g_atomic_int_add (&task->next_participant, 1));
 
-  g_atomic_int_add (&task->n_running_tasks, -1);
+  gdk_parallel_task_unref (task);
 }
 
 /**
  * gdk_parallel_task_run:
  * @task_func: the function to spawn
  * @task_data: data to pass to the function
+ * @n_items: number of items to process
+ * @chunk_size: the number of items to hand out at once
  *
- * Spawns the given function in many threads.
- * Once all functions have exited, this function returns.
+ * Calls @task_func for consecutive ranges of items from 0 to
+ * @n_items in as many threads as useful. Every item is part of
+ * exactly one range and ranges are at most @chunk_size items long.
+ * Once all items have been processed, this function returns.
+ *
+ * Choose @chunk_size so that processing a chunk is worth waking
+ * up a thread. Jobs that fit into a single chunk are run in the
+ * calling thread without involving the thread pool.
+ *
+ * It is fine to call this function from inside a task function.
  **/
 void
 gdk_parallel_task_run (GdkTaskFunc task_func,
-                       gpointer    task_data)
+                       gpointer    task_data,
+                       gsize       n_items,
+                       gsize       chunk_size)
 {
-  static GThreadPool *pool;
-  TaskData task = {
-    .task_func = task_func,
-    .task_data = task_data,
-  };
-  int i, n_tasks;
+  Task *task;
+  gsize n_chunks;
+  guint i;
+
+  if (n_items == 0)
+    return;
+
+  chunk_size = MAX (chunk_size, 1);
+  n_chunks = (n_items - 1) / chunk_size + 1;
 
   if (g_once_init_enter (&pool))
     {
-      GThreadPool *the_pool = g_thread_pool_new (gdk_parallel_task_thread_func,
-                              NULL,
-                              MAX (2, g_get_num_processors ()) - 1,
-                              FALSE,
-                              NULL);
+      GThreadPool *the_pool;
+
+      n_threads = MAX (2, g_get_num_processors ());
+      the_pool = g_thread_pool_new (gdk_parallel_task_thread_func,
+                                    NULL,
+                                    n_threads - 1,
+                                    FALSE,
+                                    NULL);
+      utilization_counter = gdk_profiler_define_counter ("parallel-tasks", "Percentage of threads busy with parallel tasks while running a task");
       g_once_init_leave (&pool, the_pool);
     }
 
-  n_tasks = g_get_num_processors ();
-  task.n_running_tasks = n_tasks;
-  /* Start with 1 because we run 1 task ourselves */
-  for (i = 1; i < n_tasks; i++)
+  if (n_chunks == 1)
     {
-      g_thread_pool_push (pool, &task, NULL);
+      task_func (0, n_items, task_data);
+      return;
     }
 
-  gdk_parallel_task_thread_func (&task, NULL);
+  task = g_new0 (Task, 1);
+  g_atomic_ref_count_init (&task->ref_count);
+  task->task_func = task_func;
+  task->task_data = task_data;
+  task->n_items = n_items;
+  task->chunk_size = chunk_size;
+  task->n_participants = MIN (n_threads, n_chunks);
+  task->next_participant = 1;
+  task->ranges = g_new (TaskRange, task->n_participants);
+  g_mutex_init (&task->done_lock);
+  g_cond_init (&task->done_cond);
 
-  while (g_atomic_int_get (&task.n_running_tasks) > 0)
-    g_thread_yield ();
-}
+  for (i = 0; i < task->n_participants; i++)
+    {
+      g_mutex_init (&task->ranges[i].lock);
+      task->ranges[i].start = MIN (n_items, n_chunks * i / task->n_participants * chunk_size);
+      task->ranges[i].end = MIN (n_items, n_chunks * (i + 1) / task->n_participants * chunk_size);
+    }
+
+  /* Start with 1 because we participate ourselves */
+  for (i = 1; i < task->n_participants; i++)
+    {
+      g_atomic_ref_count_inc (&task->ref_count);
+      g_thread_pool_push (pool, task, NULL);
+    }
+
+  gdk_parallel_task_participate (task, 0);
 
+  /* All ranges are empty now, threads that are late to the party
+   * won't touch task_data anymore.
+   */
+  g_mutex_lock (&task->done_lock);
+  while (task->n_done < task->n_items)
+    g_cond_wait (&task->done_cond, &task->done_lock);
+  g_mutex_unlock (&task->done_lock);
+
+  /* Nested tasks are part of the outer task's sample */
+  if (GDK_PROFILER_IS_RUNNING &&
+      g_private_get (&participation_depth) == NULL)
+    {
+      int busy = MIN (g_atomic_int_get (&task->max_busy), (int) n_threads);
+
+      gdk_profiler_set_counter (utilization_counter, 100.0 * busy / n_threads);
+    }
+
+  gdk_parallel_task_unref (task);
+}
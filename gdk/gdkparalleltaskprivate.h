@@ -23,10 +23,14 @@
 
 G_BEGIN_DECLS
 
-typedef void (* GdkTaskFunc) (gpointer user_data);
+typedef void (* GdkTaskFunc) (gsize    start,
+                              gsize    end,
+                              gpointer user_data);
 
 void                    gdk_parallel_task_run               (GdkTaskFunc                 task_func,
-                                                             gpointer                    task_data);
+                                                             gpointer                    task_data,
+                                                             gsize                       n_items,
+                                                             gsize                       chunk_size);
 
 G_END_DECLS
 
@@ -1349,14 +1349,21 @@ gdk_surface_schedule_update (GdkSurface *surface)
 
   surface->pending_phases |= GDK_FRAME_CLOCK_PHASE_PAINT;
 
-  if (surface->update_freeze_count ||
-      gdk_surface_is_toplevel_frozen (surface))
-    return;
-
   /* If there's no frame clock (a foreign surface), then the invalid
    * region will just stick around unless gdk_surface_process_updates()
    * is called. */
   frame_clock = gdk_surface_get_frame_clock (surface);
+
+  if (surface->update_freeze_count ||
+      gdk_surface_is_toplevel_frozen (surface))
+    {
+      /* The frame will be requested when thawing, but
+       * the input that caused it should still be tracked */
+      if (frame_clock)
+        _gdk_frame_clock_note_update (frame_clock);
+      return;
+    }
+
   if (frame_clock)
     gdk_frame_clock_request_phase (gdk_surface_get_frame_clock (surface),
                                    GDK_FRAME_CLOCK_PHASE_PAINT);
@@ -3072,6 +3079,7 @@ gdk_surface_handle_event (GdkEvent *event)
 {
   GdkSurface *surface = gdk_event_get_surface (event);
   gint64 begin_time = GDK_PROFILER_CURRENT_TIME;
+  GdkFrameClock *frame_clock;
   gboolean handled = FALSE;
 
   if (check_autohide (event))
@@ -3081,8 +3089,21 @@ gdk_surface_handle_event (GdkEvent *event)
   if (gdk_event_get_event_type (event) == GDK_MOTION_NOTIFY)
     surface->request_motion = FALSE;
 
+  frame_clock = gdk_surface_get_frame_clock (surface);
+  if (frame_clock)
+    {
+      g_object_ref (frame_clock);
+      _gdk_frame_clock_begin_input (frame_clock, event);
+    }
+
   g_signal_emit (surface, signals[EVENT], 0, event, &handled);
 
+  if (frame_clock)
+    {
+      _gdk_frame_clock_end_input (frame_clock);
+      g_object_unref (frame_clock);
+    }
+
   if (GDK_PROFILER_IS_RUNNING)
     add_event_mark (event, begin_time, GDK_PROFILER_CURRENT_TIME);
 
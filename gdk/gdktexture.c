@@ -900,6 +900,52 @@ gdk_texture_diff (GdkTexture     *self,
   g_mutex_unlock (&chain->lock);
 }
 
+/*
+ * gdk_texture_find_ancestor:
+ * @self: a texture
+ * @func: function called for the previous versions of @self
+ * @data: user data for @func
+ * @region: region to add the changes since the found ancestor to
+ *
+ * Looks through the previous versions of @self, starting with the
+ * most recent one, for the first one that @func returns %TRUE for.
+ *
+ * Note that @func is called with the lock of the chain held, so it
+ * must not call other texture diffing functions.
+ *
+ * Returns: %TRUE if an ancestor was found
+ */
+gboolean
+gdk_texture_find_ancestor (GdkTexture             *self,
+                           GdkTextureAncestorFunc  func,
+                           gpointer                data,
+                           cairo_region_t         *region)
+{
+  GdkTextureChain *chain;
+  GdkTexture *texture;
+  gboolean result = FALSE;
+
+  chain = g_atomic_pointer_get (&self->chain);
+  if (chain == NULL)
+    return FALSE;
+
+  g_mutex_lock (&chain->lock);
+  for (texture = self->previous_texture;
+       texture != NULL;
+       texture = texture->previous_texture)
+    {
+      if (func (texture, data))
+        {
+          gdk_texture_diff_from_known_ancestor (self, texture, region);
+          result = TRUE;
+          break;
+        }
+    }
+  g_mutex_unlock (&chain->lock);
+
+  return result;
+}
+
 void
 gdk_texture_set_diff (GdkTexture     *self,
                       GdkTexture     *previous,
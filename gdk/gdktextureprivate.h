@@ -70,6 +70,13 @@ void                    gdk_texture_diff                (GdkTexture
                                                          GdkTexture             *other,
                                                          cairo_region_t         *region);
 
+typedef gboolean (* GdkTextureAncestorFunc) (GdkTexture *texture,
+                                             gpointer    data);
+
+gboolean                gdk_texture_find_ancestor       (GdkTexture             *self,
+                                                         GdkTextureAncestorFunc  func,
+                                                         gpointer                data,
+                                                         cairo_region_t         *region);
 void                    gdk_texture_set_diff            (GdkTexture             *self,
                                                          GdkTexture             *previous,
                                                          cairo_region_t         *diff);
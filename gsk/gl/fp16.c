@@ -175,7 +175,41 @@ resolve_half_to_float (void)
 
 #endif
 
-#else /* ! HAVE_F16C */
+#elif defined(HAVE_NEON)
+
+/* NEON is always available on aarch64, so there's nothing to resolve */
+
+void
+float_to_half4 (const float f[4],
+                guint16     h[4])
+{
+  float_to_half4_neon (f, h);
+}
+
+void
+half_to_float4 (const guint16 h[4],
+                float         f[4])
+{
+  half_to_float4_neon (h, f);
+}
+
+void
+float_to_half (const float *f,
+               guint16     *h,
+               int          n)
+{
+  float_to_half_neon (f, h, n);
+}
+
+void
+half_to_float (const guint16 *h,
+               float         *f,
+               int            n)
+{
+  half_to_float_neon (h, f, n);
+}
+
+#else /* ! HAVE_F16C && ! HAVE_NEON */
 
 #if defined(__APPLE__) || (defined(_MSC_VER) && !defined(__clang__))
 // turns out aliases don't work on Darwin nor Visual Studio
@@ -219,4 +253,4 @@ void half_to_float (const guint16 *h, float *f, int n) __attribute__((alias ("ha
 
 #endif
 
-#endif  /* HAVE_F16C */
+#endif  /* HAVE_F16C || HAVE_NEON */
@@ -120,3 +120,55 @@ half_to_float_f16c (const guint16 *h,
 
 #endif  /* HAVE_F16C */
 
+
+#ifdef HAVE_NEON
+#include <arm_neon.h>
+
+void
+float_to_half4_neon (const float f[4],
+                     guint16     h[4])
+{
+  float16x4_t s = vcvt_f16_f32 (vld1q_f32 (f));
+
+  vst1_u16 (h, vreinterpret_u16_f16 (s));
+}
+
+void
+half_to_float4_neon (const guint16 h[4],
+                     float         f[4])
+{
+  float16x4_t s = vreinterpret_f16_u16 (vld1_u16 (h));
+
+  vst1q_f32 (f, vcvt_f32_f16 (s));
+}
+
+void
+float_to_half_neon (const float *f,
+                    guint16     *h,
+                    int          n)
+{
+  int j;
+
+  /* NEON loads don't need alignment */
+  for (j = 0; j + 4 <= n; j += 4)
+    float_to_half4_neon (f + j, h + j);
+
+  if (j < n)
+    float_to_half_c (f + j, h + j, n - j);
+}
+
+void
+half_to_float_neon (const guint16 *h,
+                    float         *f,
+                    int            n)
+{
+  int j;
+
+  for (j = 0; j + 4 <= n; j += 4)
+    half_to_float4_neon (h + j, f + j);
+
+  if (j < n)
+    half_to_float_c (h + j, f + j, n - j);
+}
+
+#endif  /* HAVE_NEON */
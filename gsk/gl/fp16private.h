@@ -107,6 +107,20 @@ void half_to_float_f16c (const guint16 *h,
                          float         *f,
                          int            n);
 
+void float_to_half4_neon (const float f[4],
+                          guint16     h[4]);
+
+void half_to_float4_neon (const guint16 h[4],
+                          float         f[4]);
+
+void float_to_half_neon (const float *f,
+                         guint16     *h,
+                         int          n);
+
+void half_to_float_neon (const guint16 *h,
+                         float         *f,
+                         int            n);
+
 void float_to_half4_c (const float f[4],
                        guint16     h[4]);
 
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <gsk/gskdebugprivate.h>
+#include <gsk/gskglprogramcacheprivate.h>
 #include <gio/gio.h>
 #include <string.h>
 
@@ -50,6 +51,8 @@ struct _GskGLCompiler
 
   GArray *attrib_locations;
 
+  GskGLProgramCache *program_cache;
+
   const char *glsl_version;
 
   guint gl3 : 1;
@@ -82,6 +85,7 @@ gsk_gl_compiler_finalize (GObject *object)
   g_clear_pointer (&self->fragment_suffix, g_bytes_unref);
   g_clear_pointer (&self->vertex_source, g_bytes_unref);
   g_clear_pointer (&self->attrib_locations, g_array_unref);
+  g_clear_pointer (&self->program_cache, gsk_gl_program_cache_unref);
   g_clear_object (&self->driver);
 
   G_OBJECT_CLASS (gsk_gl_compiler_parent_class)->finalize (object);
@@ -167,6 +171,8 @@ gsk_gl_compiler_new (GskGLDriver *driver,
 
   gsk_gl_command_queue_make_current (self->driver->shared_command_queue);
 
+  self->program_cache = gsk_gl_program_cache_new (gdk_gl_context_get_current ());
+
   return g_steal_pointer (&self);
 }
 
@@ -536,6 +542,44 @@ get_shader_string (GBytes *bytes)
   return str ? str : "";
 }
 
+static char *
+compute_program_checksum (GskGLCompiler      *self,
+                          const char * const *vertex_sources,
+                          const int          *vertex_lengths,
+                          const char * const *fragment_sources,
+                          const int          *fragment_lengths,
+                          gsize               n_sources)
+{
+  GChecksum *checksum;
+  char *result;
+  gsize i;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  for (i = 0; i < n_sources; i++)
+    g_checksum_update (checksum, (const guchar *) vertex_sources[i], vertex_lengths[i]);
+  g_checksum_update (checksum, (const guchar *) "", 1);
+  for (i = 0; i < n_sources; i++)
+    g_checksum_update (checksum, (const guchar *) fragment_sources[i], fragment_lengths[i]);
+  g_checksum_update (checksum, (const guchar *) "", 1);
+
+  for (i = 0; i < self->attrib_locations->len; i++)
+    {
+      const GskGLProgramAttrib *attrib;
+      guint32 location;
+
+      attrib = &g_array_index (self->attrib_locations, GskGLProgramAttrib, i);
+      location = attrib->location;
+      g_checksum_update (checksum, (const guchar *) attrib->name, strlen (attrib->name) + 1);
+      g_checksum_update (checksum, (const guchar *) &location, sizeof (location));
+    }
+
+  result = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return result;
+}
+
 GskGLProgram *
 gsk_gl_compiler_compile (GskGLCompiler  *self,
                          const char     *name,
@@ -548,6 +592,11 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
   const char *gl3 = "";
   const char *gles = "";
   const char *gles3 = "";
+  const char *vertex_sources[11];
+  const char *fragment_sources[11];
+  int vertex_lengths[11];
+  int fragment_lengths[11];
+  char *checksum = NULL;
   int program_id;
   int vertex_id;
   int fragment_id;
@@ -580,34 +629,66 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
   if (self->gl3)
     gl3 = "#define GSK_GL3 1\n";
 
+  memcpy (vertex_sources,
+          (const char *[]) {
+            version, debug, legacy, gl3, gles, gles3, clip,
+            get_shader_string (self->all_preamble),
+            get_shader_string (self->vertex_preamble),
+            get_shader_string (self->vertex_source),
+            get_shader_string (self->vertex_suffix),
+          },
+          sizeof (vertex_sources));
+  memcpy (vertex_lengths,
+          (int[]) {
+            strlen (version),
+            strlen (debug),
+            strlen (legacy),
+            strlen (gl3),
+            strlen (gles),
+            strlen (gles3),
+            strlen (clip),
+            g_bytes_get_size (self->all_preamble),
+            g_bytes_get_size (self->vertex_preamble),
+            g_bytes_get_size (self->vertex_source),
+            g_bytes_get_size (self->vertex_suffix),
+          },
+          sizeof (vertex_lengths));
+  memcpy (fragment_sources, vertex_sources, sizeof (fragment_sources));
+  memcpy (fragment_lengths, vertex_lengths, sizeof (fragment_lengths));
+  fragment_sources[8] = get_shader_string (self->fragment_preamble);
+  fragment_sources[9] = get_shader_string (self->fragment_source);
+  fragment_sources[10] = get_shader_string (self->fragment_suffix);
+  fragment_lengths[8] = g_bytes_get_size (self->fragment_preamble);
+  fragment_lengths[9] = g_bytes_get_size (self->fragment_source);
+  fragment_lengths[10] = g_bytes_get_size (self->fragment_suffix);
+
+  if (self->program_cache)
+    {
+      checksum = compute_program_checksum (self,
+                                           vertex_sources, vertex_lengths,
+                                           fragment_sources, fragment_lengths,
+                                           G_N_ELEMENTS (vertex_sources));
+
+      program_id = glCreateProgram ();
+      if (gsk_gl_program_cache_load (self->program_cache, program_id, checksum))
+        {
+          g_free (checksum);
+          return gsk_gl_program_new (self->driver, name, program_id);
+        }
+      glDeleteProgram (program_id);
+    }
+
   vertex_id = glCreateShader (GL_VERTEX_SHADER);
   glShaderSource (vertex_id,
-                  11,
-                  (const char *[]) {
-                    version, debug, legacy, gl3, gles, gles3, clip,
-                    get_shader_string (self->all_preamble),
-                    get_shader_string (self->vertex_preamble),
-                    get_shader_string (self->vertex_source),
-                    get_shader_string (self->vertex_suffix),
-                  },
-                  (int[]) {
-                    strlen (version),
-                    strlen (debug),
-                    strlen (legacy),
-                    strlen (gl3),
-                    strlen (gles),
-                    strlen (gles3),
-                    strlen (clip),
-                    g_bytes_get_size (self->all_preamble),
-                    g_bytes_get_size (self->vertex_preamble),
-                    g_bytes_get_size (self->vertex_source),
-                    g_bytes_get_size (self->vertex_suffix),
-                  });
+                  G_N_ELEMENTS (vertex_sources),
+                  vertex_sources,
+                  vertex_lengths);
   glCompileShader (vertex_id);
 
   if (!check_shader_error (vertex_id, error))
     {
       glDeleteShader (vertex_id);
+      g_free (checksum);
       return NULL;
     }
 
@@ -615,33 +696,16 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
 
   fragment_id = glCreateShader (GL_FRAGMENT_SHADER);
   glShaderSource (fragment_id,
-                  11,
-                  (const char *[]) {
-                    version, debug, legacy, gl3, gles, gles3, clip,
-                    get_shader_string (self->all_preamble),
-                    get_shader_string (self->fragment_preamble),
-                    get_shader_string (self->fragment_source),
-                    get_shader_string (self->fragment_suffix),
-                  },
-                  (int[]) {
-                    strlen (version),
-                    strlen (debug),
-                    strlen (legacy),
-                    strlen (gl3),
-                    strlen (gles),
-                    strlen (gles3),
-                    strlen (clip),
-                    g_bytes_get_size (self->all_preamble),
-                    g_bytes_get_size (self->fragment_preamble),
-                    g_bytes_get_size (self->fragment_source),
-                    g_bytes_get_size (self->fragment_suffix),
-                  });
+                  G_N_ELEMENTS (fragment_sources),
+                  fragment_sources,
+                  fragment_lengths);
   glCompileShader (fragment_id);
 
   if (!check_shader_error (fragment_id, error))
     {
       glDeleteShader (vertex_id);
       glDeleteShader (fragment_id);
+      g_free (checksum);
       return NULL;
     }
 
@@ -659,6 +723,9 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
       glBindAttribLocation (program_id, attrib->location, attrib->name);
     }
 
+  if (self->program_cache)
+    gsk_gl_program_cache_prepare (self->program_cache, program_id);
+
   glLinkProgram (program_id);
 
   glGetProgramiv (program_id, GL_LINK_STATUS, &status);
@@ -693,11 +760,18 @@ gsk_gl_compiler_compile (GskGLCompiler  *self,
                    buffer ? buffer : "");
 
       g_free (buffer);
+      g_free (checksum);
 
       glDeleteProgram (program_id);
 
       return NULL;
     }
 
+  if (checksum)
+    {
+      gsk_gl_program_cache_save (self->program_cache, program_id, checksum);
+      g_free (checksum);
+    }
+
   return gsk_gl_program_new (self->driver, name, program_id);
 }
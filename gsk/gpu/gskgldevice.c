@@ -7,6 +7,7 @@
 #include "gskgpushaderopprivate.h"
 #include "gskglbufferprivate.h"
 #include "gskglimageprivate.h"
+#include "gskglprogramcacheprivate.h"
 
 #include "gdk/gdkdisplayprivate.h"
 #include "gdk/gdkglcontextprivate.h"
@@ -19,6 +20,7 @@ struct _GskGLDevice
   GskGpuDevice parent_instance;
 
   GHashTable *gl_programs;
+  GskGLProgramCache *program_cache;
   const char *version_string;
   GdkGLAPI api;
 
@@ -150,6 +152,7 @@ gsk_gl_device_finalize (GObject *object)
   gdk_gl_context_make_current (gdk_display_get_gl_context (gsk_gpu_device_get_display (device)));
 
   g_hash_table_unref (self->gl_programs);
+  g_clear_pointer (&self->program_cache, gsk_gl_program_cache_unref);
   glDeleteSamplers (G_N_ELEMENTS (self->sampler_ids), self->sampler_ids);
 
   G_OBJECT_CLASS (gsk_gl_device_parent_class)->finalize (object);
@@ -268,6 +271,8 @@ gsk_gl_device_get_for_display (GdkDisplay  *display,
   self->api = gdk_gl_context_get_api (context);
   gsk_gl_device_setup_samplers (self);
 
+  self->program_cache = gsk_gl_program_cache_new (context);
+
   g_object_set_data (G_OBJECT (display), "-gsk-gl-device", self);
 
   return GSK_GPU_DEVICE (self);
@@ -377,19 +382,14 @@ print_shader_info (const char *prefix,
     }
 }
 
-static GLuint
-gsk_gl_device_load_shader (GskGLDevice       *self,
-                           const char        *program_name,
-                           GLenum             shader_type,
-                           GskGpuShaderFlags  flags,
-                           GskGpuColorStates  color_states,
-                           guint32            variation,
-                           GError           **error)
+static GString *
+gsk_gl_device_create_preamble (GskGLDevice       *self,
+                               GLenum             shader_type,
+                               GskGpuShaderFlags  flags,
+                               GskGpuColorStates  color_states,
+                               guint32            variation)
 {
   GString *preamble;
-  char *resource_name;
-  GBytes *bytes;
-  GLuint shader_id;
 
   preamble = g_string_new (NULL);
 
@@ -427,18 +427,25 @@ gsk_gl_device_load_shader (GskGLDevice       *self,
 
       default:
         g_assert_not_reached ();
-        return 0;
+        break;
     }
 
   g_string_append_printf (preamble, "#define GSK_FLAGS %uu\n", flags);
   g_string_append_printf (preamble, "#define GSK_COLOR_STATES %uu\n", color_states);
   g_string_append_printf (preamble, "#define GSK_VARIATION %uu\n", variation);
 
-  resource_name = g_strconcat ("/org/gtk/libgsk/shaders/gl/", program_name, ".glsl", NULL);
-  bytes = g_resources_lookup_data (resource_name, 0, error);
-  g_free (resource_name);
-  if (bytes == NULL)
-    return 0;
+  return preamble;
+}
+
+static GLuint
+gsk_gl_device_load_shader (GskGLDevice  *self,
+                           const char   *program_name,
+                           GLenum        shader_type,
+                           GString      *preamble,
+                           GBytes       *source,
+                           GError      **error)
+{
+  GLuint shader_id;
 
   shader_id = glCreateShader (shader_type);
 
@@ -446,12 +453,12 @@ gsk_gl_device_load_shader (GskGLDevice       *self,
                   2,
                   (const char *[]) {
                     preamble->str,
-                    g_bytes_get_data (bytes, NULL),
+                    g_bytes_get_data (source, NULL),
                   },
-                  NULL);
-
-  g_bytes_unref (bytes);
-  g_string_free (preamble, TRUE);
+                  (int[]) {
+                    preamble->len,
+                    g_bytes_get_size (source),
+                  });
 
   glCompileShader (shader_id);
 
@@ -467,22 +474,22 @@ gsk_gl_device_load_shader (GskGLDevice       *self,
 }
 
 static GLuint
-gsk_gl_device_load_program (GskGLDevice               *self,
-                            const GskGpuShaderOpClass *op_class,
-                            GskGpuShaderFlags          flags,
-                            GskGpuColorStates          color_states,
-                            guint32                    variation,
-                            GError                   **error)
+gsk_gl_device_compile_program (GskGLDevice               *self,
+                               const GskGpuShaderOpClass *op_class,
+                               GString                   *vertex_preamble,
+                               GString                   *fragment_preamble,
+                               GBytes                    *source,
+                               GError                   **error)
 {
   G_GNUC_UNUSED gint64 begin_time = GDK_PROFILER_CURRENT_TIME;
   GLuint vertex_shader_id, fragment_shader_id, program_id;
   GLint link_status;
 
-  vertex_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_VERTEX_SHADER, flags, color_states, variation, error);
+  vertex_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_VERTEX_SHADER, vertex_preamble, source, error);
   if (vertex_shader_id == 0)
     return 0;
 
-  fragment_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_FRAGMENT_SHADER, flags, color_states, variation, error);
+  fragment_shader_id = gsk_gl_device_load_shader (self, op_class->shader_name, GL_FRAGMENT_SHADER, fragment_preamble, source, error);
   if (fragment_shader_id == 0)
     return 0;
 
@@ -493,6 +500,9 @@ gsk_gl_device_load_program (GskGLDevice               *self,
 
   op_class->setup_attrib_locations (program_id);
 
+  if (self->program_cache)
+    gsk_gl_program_cache_prepare (self->program_cache, program_id);
+
   glLinkProgram (program_id);
 
   glGetProgramiv (program_id, GL_LINK_STATUS, &link_status);
@@ -537,6 +547,95 @@ gsk_gl_device_load_program (GskGLDevice               *self,
   return program_id;
 }
 
+static char *
+gsk_gl_device_compute_program_checksum (const GskGpuShaderOpClass *op_class,
+                                        GString                   *vertex_preamble,
+                                        GString                   *fragment_preamble,
+                                        GBytes                    *source)
+{
+  GChecksum *checksum;
+  char *result;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  /* The name includes the attribute locations */
+  g_checksum_update (checksum, (const guchar *) op_class->shader_name, strlen (op_class->shader_name) + 1);
+  g_checksum_update (checksum, (const guchar *) vertex_preamble->str, vertex_preamble->len + 1);
+  g_checksum_update (checksum, (const guchar *) fragment_preamble->str, fragment_preamble->len + 1);
+  g_checksum_update (checksum, g_bytes_get_data (source, NULL), g_bytes_get_size (source));
+  result = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return result;
+}
+
+static GLuint
+gsk_gl_device_load_cached_program (GskGLDevice *self,
+                                   const char  *checksum)
+{
+  GLuint program_id;
+
+  program_id = glCreateProgram ();
+  if (gsk_gl_program_cache_load (self->program_cache, program_id, checksum))
+    return program_id;
+
+  glDeleteProgram (program_id);
+  return 0;
+}
+
+static GLuint
+gsk_gl_device_load_program (GskGLDevice               *self,
+                            const GskGpuShaderOpClass *op_class,
+                            GskGpuShaderFlags          flags,
+                            GskGpuColorStates          color_states,
+                            guint32                    variation,
+                            GError                   **error)
+{
+  G_GNUC_UNUSED gint64 begin_time = GDK_PROFILER_CURRENT_TIME;
+  GString *vertex_preamble, *fragment_preamble;
+  char *resource_name, *checksum;
+  GLuint program_id;
+  GBytes *source;
+
+  resource_name = g_strconcat ("/org/gtk/libgsk/shaders/gl/", op_class->shader_name, ".glsl", NULL);
+  source = g_resources_lookup_data (resource_name, 0, error);
+  g_free (resource_name);
+  if (source == NULL)
+    return 0;
+
+  vertex_preamble = gsk_gl_device_create_preamble (self, GL_VERTEX_SHADER, flags, color_states, variation);
+  fragment_preamble = gsk_gl_device_create_preamble (self, GL_FRAGMENT_SHADER, flags, color_states, variation);
+
+  if (self->program_cache)
+    {
+      checksum = gsk_gl_device_compute_program_checksum (op_class, vertex_preamble, fragment_preamble, source);
+      program_id = gsk_gl_device_load_cached_program (self, checksum);
+      if (program_id)
+        {
+          gdk_profiler_end_markf (begin_time,
+                                  "Load Program",
+                                  "name=%s id=%u",
+                                  op_class->shader_name, program_id);
+        }
+      else
+        {
+          program_id = gsk_gl_device_compile_program (self, op_class, vertex_preamble, fragment_preamble, source, error);
+          if (program_id)
+            gsk_gl_program_cache_save (self->program_cache, program_id, checksum);
+        }
+      g_free (checksum);
+    }
+  else
+    {
+      program_id = gsk_gl_device_compile_program (self, op_class, vertex_preamble, fragment_preamble, source, error);
+    }
+
+  g_string_free (vertex_preamble, TRUE);
+  g_string_free (fragment_preamble, TRUE);
+  g_bytes_unref (source);
+
+  return program_id;
+}
+
 void
 gsk_gl_device_use_program (GskGLDevice               *self,
                            const GskGpuShaderOpClass *op_class,
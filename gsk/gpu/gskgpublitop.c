@@ -43,6 +43,19 @@ gsk_gpu_blit_op_print (GskGpuOp    *op,
   gsk_gpu_print_newline (string);
 }
 
+static void
+gsk_gpu_blit_upload_op_print (GskGpuOp    *op,
+                              GskGpuFrame *frame,
+                              GString     *string,
+                              guint        indent)
+{
+  GskGpuBlitOp *self = (GskGpuBlitOp *) op;
+
+  gsk_gpu_print_op (string, indent, "blit-upload");
+  gsk_gpu_print_int_rect (string, &self->dest_rect);
+  gsk_gpu_print_newline (string);
+}
+
 #ifdef GDK_RENDERING_VULKAN
 static GskGpuOp *
 gsk_gpu_blit_op_vk_command (GskGpuOp              *op,
@@ -197,6 +210,17 @@ static const GskGpuOpClass GSK_GPU_BLIT_OP_CLASS = {
   gsk_gpu_blit_op_gl_command
 };
 
+static const GskGpuOpClass GSK_GPU_BLIT_UPLOAD_OP_CLASS = {
+  GSK_GPU_OP_SIZE (GskGpuBlitOp),
+  GSK_GPU_STAGE_UPLOAD,
+  gsk_gpu_blit_op_finish,
+  gsk_gpu_blit_upload_op_print,
+#ifdef GDK_RENDERING_VULKAN
+  gsk_gpu_blit_op_vk_command,
+#endif
+  gsk_gpu_blit_op_gl_command
+};
+
 void
 gsk_gpu_blit_op (GskGpuFrame                 *frame,
                  GskGpuImage                 *src_image,
@@ -219,3 +243,31 @@ gsk_gpu_blit_op (GskGpuFrame                 *frame,
   self->dest_rect = *dest_rect;
   self->filter = filter;
 }
+
+/*
+ * gsk_gpu_blit_upload_op:
+ *
+ * Like gsk_gpu_blit_op() with nearest filtering, but the blit happens
+ * with the uploads, before any render pass. So it can be used to move
+ * data between images while a render pass is being recorded.
+ */
+void
+gsk_gpu_blit_upload_op (GskGpuFrame                 *frame,
+                        GskGpuImage                 *src_image,
+                        GskGpuImage                 *dest_image,
+                        const cairo_rectangle_int_t *src_rect,
+                        const cairo_rectangle_int_t *dest_rect)
+{
+  GskGpuBlitOp *self;
+
+  g_assert ((gsk_gpu_image_get_flags (src_image) & GSK_GPU_IMAGE_NO_BLIT) == 0);
+  g_assert ((gsk_gpu_image_get_flags (dest_image) & GSK_GPU_IMAGE_RENDERABLE) == GSK_GPU_IMAGE_RENDERABLE);
+
+  self = (GskGpuBlitOp *) gsk_gpu_op_alloc (frame, &GSK_GPU_BLIT_UPLOAD_OP_CLASS);
+
+  self->src_image = g_object_ref (src_image);
+  self->dest_image = g_object_ref (dest_image);
+  self->src_rect = *src_rect;
+  self->dest_rect = *dest_rect;
+  self->filter = GSK_GPU_BLIT_NEAREST;
+}
@@ -15,6 +15,11 @@ void                    gsk_gpu_blit_op                                 (GskGpuF
                                                                          const cairo_rectangle_int_t    *src_rect,
                                                                          const cairo_rectangle_int_t    *dest_rect,
                                                                          GskGpuBlitFilter                filter);
+void                    gsk_gpu_blit_upload_op                          (GskGpuFrame                    *frame,
+                                                                         GskGpuImage                    *src_image,
+                                                                         GskGpuImage                    *dest_image,
+                                                                         const cairo_rectangle_int_t    *src_rect,
+                                                                         const cairo_rectangle_int_t    *dest_rect);
 
 G_END_DECLS
 
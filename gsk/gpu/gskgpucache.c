@@ -2,7 +2,9 @@
 
 #include "gskgpucacheprivate.h"
 
+#include "gskgpublitopprivate.h"
 #include "gskgpudeviceprivate.h"
+#include "gskgpudiskcacheprivate.h"
 #include "gskgpuframeprivate.h"
 #include "gskgpuimageprivate.h"
 #include "gskgpuuploadopprivate.h"
@@ -12,22 +14,33 @@
 #include "gdk/gdktextureprivate.h"
 
 #include "gsk/gskdebugprivate.h"
+#include "gsk/gskpath.h"
 #include "gsk/gskprivate.h"
-
-#define MAX_SLICES_PER_ATLAS 64
-
-#define ATLAS_SIZE 1024
-
-#define MAX_ATLAS_ITEM_SIZE 256
-
-#define MIN_ALIVE_PIXELS (ATLAS_SIZE * ATLAS_SIZE / 2)
-
-#define ATLAS_TIMEOUT_SCALE 4
-
-G_STATIC_ASSERT (MAX_ATLAS_ITEM_SIZE < ATLAS_SIZE);
-G_STATIC_ASSERT (MIN_ALIVE_PIXELS < ATLAS_SIZE * ATLAS_SIZE);
+#include "gsk/gskrectprivate.h"
+#include "gsk/gskrendernodeprivate.h"
+#include "gsk/gskstrokeprivate.h"
+
+#include <pango/pangocairo.h>
+#include <hb.h>
+
+/* The smallest slice is 4 pixels high, but glyphs are rarely that small */
+#define MIN_AVERAGE_SLICE_HEIGHT 16
+
+/* Larger path masks are not cached, but drawn every frame */
+#define MAX_PATH_MASK_SIZE 1024
+
+static const GskGpuCachePolicy default_policy = {
+  .atlas_size = 1024,
+  .max_atlas_item_size = 256,
+  .min_alive_percent = 50,
+  .atlas_timeout_scale = 4,
+  .glyph_budget = 0,
+  .texture_budget = 0,
+};
 
 typedef struct _GskGpuCachedGlyph GskGpuCachedGlyph;
+typedef struct _GskGpuCachedNode GskGpuCachedNode;
+typedef struct _GskGpuCachedPath GskGpuCachedPath;
 typedef struct _GskGpuCachedTexture GskGpuCachedTexture;
 typedef struct _GskGpuCachedTile GskGpuCachedTile;
 
@@ -44,10 +57,26 @@ struct _GskGpuCache
   GHashTable *texture_cache;
   GHashTable *ccs_texture_caches[GDK_COLOR_STATE_N_IDS];
   GHashTable *tile_cache;
+  GHashTable *node_cache;
   GHashTable *glyph_cache;
+  GHashTable *path_cache;
 
   GskGpuCachedAtlas *current_atlas;
 
+  GskGpuCachePolicy policy;
+  gsize glyph_memory;
+  gsize texture_memory;
+  gsize n_evicted;
+  gsize n_compacted_atlases;
+  gsize n_compacted_glyphs;
+
+  GskGpuDiskCache *disk_cache;
+  GHashTable *font_keys;
+  gsize disk_cache_hits;
+  gsize disk_cache_misses;
+  gsize disk_cache_reported_hits;
+  gsize disk_cache_reported_misses;
+
   /* atomic */ gsize dead_textures;
   /* atomic */ gsize dead_texture_pixels;
 };
@@ -135,6 +164,9 @@ gsk_gpu_cached_use (GskGpuCache  *self,
                     GskGpuCached *cached)
 {
   cached->timestamp = self->timestamp;
+  /* keeps the atlas from being evicted while its glyphs are used */
+  if (cached->atlas)
+    ((GskGpuCached *) cached->atlas)->timestamp = self->timestamp;
   mark_as_stale (cached, FALSE);
 }
 
@@ -159,12 +191,14 @@ struct _GskGpuCachedAtlas
 
   GskGpuImage *image;
 
+  gboolean compacting;
   gsize remaining_pixels;
   gsize n_slices;
+  gsize max_slices;
   struct {
     gsize width;
     gsize height;
-  } slices[MAX_SLICES_PER_ATLAS];
+  } *slices;
 };
 
 static void
@@ -186,10 +220,19 @@ gsk_gpu_cached_atlas_free (GskGpuCache  *cache,
     cache->current_atlas = NULL;
 
   g_object_unref (self->image);
+  g_free (self->slices);
 
   g_free (self);
 }
 
+static inline gboolean
+gsk_gpu_cached_atlas_can_compact (GskGpuCachedAtlas *self)
+{
+  GskGpuImageFlags flags = gsk_gpu_image_get_flags (self->image);
+
+  return (flags & (GSK_GPU_IMAGE_NO_BLIT | GSK_GPU_IMAGE_RENDERABLE)) == GSK_GPU_IMAGE_RENDERABLE;
+}
+
 static gboolean
 gsk_gpu_cached_atlas_should_collect (GskGpuCache  *cache,
                                      GskGpuCached *cached,
@@ -197,13 +240,31 @@ gsk_gpu_cached_atlas_should_collect (GskGpuCache  *cache,
                                      gint64        timestamp)
 {
   GskGpuCachedAtlas *self = (GskGpuCachedAtlas *) cached;
+  gsize size;
 
   if (cache->current_atlas == self &&
-      gsk_gpu_cached_is_old (cache, cached, cache_timeout * ATLAS_TIMEOUT_SCALE, timestamp) &&
+      gsk_gpu_cached_is_old (cache, cached, cache_timeout * cache->policy.atlas_timeout_scale, timestamp) &&
       cached->pixels == 0)
     return TRUE;
 
-  return cached->pixels + self->remaining_pixels < MIN_ALIVE_PIXELS;
+  size = gsk_gpu_image_get_width (self->image) * gsk_gpu_image_get_height (self->image);
+  if ((cached->pixels + self->remaining_pixels) * 100 >= size * cache->policy.min_alive_percent)
+    return FALSE;
+
+  /* Instead of throwing away the glyphs that are still in use, give them
+   * until the next GC to be copied to the current atlas.
+   */
+  if (!self->compacting && cached->pixels > 0 && gsk_gpu_cached_atlas_can_compact (self))
+    {
+      self->compacting = TRUE;
+      self->remaining_pixels = 0;
+      if (cache->current_atlas == self)
+        cache->current_atlas = NULL;
+      cache->n_compacted_atlases++;
+      return FALSE;
+    }
+
+  return TRUE;
 }
 
 static const GskGpuCachedClass GSK_GPU_CACHED_ATLAS_CLASS =
@@ -220,8 +281,10 @@ gsk_gpu_cached_atlas_new (GskGpuCache *cache)
   GskGpuCachedAtlas *self;
 
   self = gsk_gpu_cached_new (cache, &GSK_GPU_CACHED_ATLAS_CLASS);
-  self->image = gsk_gpu_device_create_atlas_image (cache->device, ATLAS_SIZE, ATLAS_SIZE);
+  self->image = gsk_gpu_device_create_atlas_image (cache->device, cache->policy.atlas_size, cache->policy.atlas_size);
   self->remaining_pixels = gsk_gpu_image_get_width (self->image) * gsk_gpu_image_get_height (self->image);
+  self->max_slices = MAX (1, gsk_gpu_image_get_height (self->image) / MIN_AVERAGE_SLICE_HEIGHT);
+  self->slices = g_malloc_n (self->max_slices, sizeof (self->slices[0]));
 
   return self;
 }
@@ -252,11 +315,14 @@ gsk_gpu_cached_atlas_allocate (GskGpuCachedAtlas *atlas,
   gsize waste, slice_waste;
   gsize best_slice;
   gsize y, best_y;
+  gsize atlas_width, atlas_height;
   gboolean can_add_slice;
 
+  atlas_width = gsk_gpu_image_get_width (atlas->image);
+  atlas_height = gsk_gpu_image_get_height (atlas->image);
   best_y = 0;
   best_slice = G_MAXSIZE;
-  can_add_slice = atlas->n_slices < MAX_SLICES_PER_ATLAS;
+  can_add_slice = atlas->n_slices < atlas->max_slices;
   if (can_add_slice)
     waste = height; /* Require less than 100% waste */
   else
@@ -264,7 +330,7 @@ gsk_gpu_cached_atlas_allocate (GskGpuCachedAtlas *atlas,
 
   for (i = 0, y = 0; i < atlas->n_slices; y += atlas->slices[i].height, i++)
     {
-      if (atlas->slices[i].height < height || ATLAS_SIZE - atlas->slices[i].width < width)
+      if (atlas->slices[i].height < height || atlas_width - atlas->slices[i].width < width)
         continue;
 
       slice_waste = atlas->slices[i].height - height;
@@ -286,12 +352,12 @@ gsk_gpu_cached_atlas_allocate (GskGpuCachedAtlas *atlas,
         return FALSE;
 
       slice_height = round_up_atlas_size (MAX (height, 4));
-      if (slice_height > ATLAS_SIZE - y)
+      if (slice_height > atlas_height - y)
         return FALSE;
 
       atlas->n_slices++;
-      if (atlas->n_slices == MAX_SLICES_PER_ATLAS)
-        slice_height = ATLAS_SIZE - y;
+      if (atlas->n_slices == atlas->max_slices)
+        slice_height = atlas_height - y;
 
       atlas->slices[i].width = 0;
       atlas->slices[i].height = slice_height;
@@ -303,7 +369,7 @@ gsk_gpu_cached_atlas_allocate (GskGpuCachedAtlas *atlas,
   *out_y = best_y;
 
   atlas->slices[best_slice].width += width;
-  g_assert (atlas->slices[best_slice].width <= ATLAS_SIZE);
+  g_assert (atlas->slices[best_slice].width <= atlas_width);
 
   atlas->remaining_pixels -= width * height;
   ((GskGpuCached *) atlas)->pixels += width * height;
@@ -339,7 +405,7 @@ gsk_gpu_cache_add_atlas_image (GskGpuCache      *self,
                                gsize            *out_x,
                                gsize            *out_y)
 {
-  if (width > MAX_ATLAS_ITEM_SIZE || height > MAX_ATLAS_ITEM_SIZE)
+  if (width > self->policy.max_atlas_item_size || height > self->policy.max_atlas_item_size)
     return NULL;
 
   gsk_gpu_cache_ensure_atlas (self, FALSE);
@@ -737,6 +803,212 @@ gsk_gpu_cache_cache_tile (GskGpuCache      *self,
   gsk_gpu_cached_use (self, (GskGpuCached *) tile);
 }
 
+/* }}} */
+/* {{{ CachedNode */
+
+/* Renderings of cacheable nodes, see gsk_container_node_new_cacheable().
+ *
+ * Nodes are identified by pointer, they are immutable and we keep
+ * a reference. So the entry is collected as soon as we hold the last
+ * reference, because then nobody will draw the node again.
+ */
+struct _GskGpuCachedNode
+{
+  GskGpuCached parent;
+
+  GskRenderNode *node;
+  float scale_x;
+  float scale_y;
+  GdkColorState *color_state;
+
+  GskGpuImage *image;
+  graphene_rect_t rect;
+};
+
+static void
+gsk_gpu_cached_node_free (GskGpuCache  *cache,
+                          GskGpuCached *cached)
+{
+  GskGpuCachedNode *self = (GskGpuCachedNode *) cached;
+
+  g_hash_table_remove (cache->node_cache, self);
+
+  gsk_render_node_unref (self->node);
+  gdk_color_state_unref (self->color_state);
+  g_object_unref (self->image);
+
+  g_free (self);
+}
+
+static gboolean
+gsk_gpu_cached_node_should_collect (GskGpuCache  *cache,
+                                    GskGpuCached *cached,
+                                    gint64        cache_timeout,
+                                    gint64        timestamp)
+{
+  GskGpuCachedNode *self = (GskGpuCachedNode *) cached;
+
+  return gsk_gpu_cached_is_old (cache, cached, cache_timeout, timestamp) ||
+         g_atomic_ref_count_compare (&self->node->ref_count, 1);
+}
+
+static const GskGpuCachedClass GSK_GPU_CACHED_NODE_CLASS =
+{
+  sizeof (GskGpuCachedNode),
+  "Node",
+  gsk_gpu_cached_node_free,
+  gsk_gpu_cached_node_should_collect
+};
+
+static guint
+gsk_gpu_cached_node_hash (gconstpointer data)
+{
+  const GskGpuCachedNode *self = data;
+
+  return g_direct_hash (self->node) ^
+         ((guint) (self->scale_x * 16) << 16) ^
+         ((guint) (self->scale_y * 16) << 24);
+}
+
+static gboolean
+gsk_gpu_cached_node_equal (gconstpointer data_a,
+                           gconstpointer data_b)
+{
+  const GskGpuCachedNode *a = data_a;
+  const GskGpuCachedNode *b = data_b;
+
+  return a->node == b->node &&
+         a->scale_x == b->scale_x &&
+         a->scale_y == b->scale_y &&
+         gdk_color_state_equal (a->color_state, b->color_state);
+}
+
+/*
+ * gsk_gpu_cache_lookup_node_image:
+ * @self: the cache
+ * @node: a cacheable node
+ * @scale: the scale the node is drawn at
+ * @color_state: the color state the node is drawn in
+ * @rect: the area of the node in node coordinates that is needed
+ * @out_image_rect: (out): the area of the node in node coordinates
+ *   that the returned image covers
+ *
+ * Looks up a rendering of @node that was added with
+ * gsk_gpu_cache_cache_node_image() and covers @rect.
+ *
+ * Returns: (transfer full) (nullable): the image covering @rect
+ **/
+GskGpuImage *
+gsk_gpu_cache_lookup_node_image (GskGpuCache           *self,
+                                 GskRenderNode         *node,
+                                 const graphene_vec2_t *scale,
+                                 GdkColorState         *color_state,
+                                 const graphene_rect_t *rect,
+                                 graphene_rect_t       *out_image_rect)
+{
+  GskGpuCachedNode *cached;
+  GskGpuCachedNode lookup = {
+    .node = node,
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+    .color_state = color_state,
+  };
+
+  if (self->node_cache == NULL)
+    return NULL;
+
+  cached = g_hash_table_lookup (self->node_cache, &lookup);
+  if (cached == NULL ||
+      !gsk_rect_contains_rect (&cached->rect, rect))
+    return NULL;
+
+  gsk_gpu_cached_use (self, (GskGpuCached *) cached);
+
+  *out_image_rect = cached->rect;
+
+  return g_object_ref (cached->image);
+}
+
+/*
+ * gsk_gpu_cache_cache_node_image:
+ * @self: the cache
+ * @node: a cacheable node
+ * @scale: the scale the node is drawn at
+ * @color_state: the color state the node is drawn in
+ * @rect: the area of the node in node coordinates that @image covers
+ * @image: the rendering of @rect
+ *
+ * Adds a rendering of @node to the cache, replacing any previous one.
+ **/
+void
+gsk_gpu_cache_cache_node_image (GskGpuCache           *self,
+                                GskRenderNode         *node,
+                                const graphene_vec2_t *scale,
+                                GdkColorState         *color_state,
+                                const graphene_rect_t *rect,
+                                GskGpuImage           *image)
+{
+  GskGpuCachedNode *cached;
+  GskGpuCachedNode lookup = {
+    .node = node,
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+    .color_state = color_state,
+  };
+
+  if (self->node_cache == NULL)
+    self->node_cache = g_hash_table_new (gsk_gpu_cached_node_hash,
+                                         gsk_gpu_cached_node_equal);
+
+  /* A rendering of a different area */
+  cached = g_hash_table_lookup (self->node_cache, &lookup);
+  if (cached)
+    gsk_gpu_cached_free (self, (GskGpuCached *) cached);
+
+  cached = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_NODE_CLASS);
+  cached->node = gsk_render_node_ref (node);
+  cached->scale_x = lookup.scale_x;
+  cached->scale_y = lookup.scale_y;
+  cached->color_state = gdk_color_state_ref (color_state);
+  cached->image = g_object_ref (image);
+  cached->rect = *rect;
+  ((GskGpuCached *) cached)->pixels = gsk_gpu_image_get_width (image) * gsk_gpu_image_get_height (image);
+
+  g_hash_table_add (self->node_cache, cached);
+
+  gsk_gpu_cached_use (self, (GskGpuCached *) cached);
+}
+
+/*
+ * gsk_gpu_cache_peek_node_image:
+ * @self: the cache
+ * @node: a cacheable node
+ *
+ * Gets a rendering of @node from the cache, for any scale and
+ * color state. This is meant for tests.
+ *
+ * Returns: (transfer none) (nullable): a cached image of @node
+ **/
+GskGpuImage *
+gsk_gpu_cache_peek_node_image (GskGpuCache   *self,
+                               GskRenderNode *node)
+{
+  GHashTableIter iter;
+  GskGpuCachedNode *cached;
+
+  if (self->node_cache == NULL)
+    return NULL;
+
+  g_hash_table_iter_init (&iter, self->node_cache);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &cached, NULL))
+    {
+      if (cached->node == node)
+        return cached->image;
+    }
+
+  return NULL;
+}
+
 /* }}} */
 /* {{{ CachedGlyph */
 
@@ -818,6 +1090,208 @@ static const GskGpuCachedClass GSK_GPU_CACHED_GLYPH_CLASS =
   gsk_gpu_cached_glyph_should_collect
 };
 
+/* Moves a glyph off an atlas that is being compacted by copying
+ * it into the current atlas, so it doesn't need to be rendered
+ * again when the old atlas goes away.
+ * Glyphs on atlases always have a 1 pixel padding.
+ */
+static void
+gsk_gpu_cached_glyph_compact (GskGpuCache       *cache,
+                              GskGpuCachedGlyph *self,
+                              GskGpuFrame       *frame)
+{
+  GskGpuCached *cached = (GskGpuCached *) self;
+  GskGpuCachedAtlas *old_atlas = cached->atlas;
+  GskGpuImage *image;
+  gsize x, y, width, height;
+
+  width = self->bounds.size.width + 2;
+  height = self->bounds.size.height + 2;
+
+  image = gsk_gpu_cache_add_atlas_image (cache, width, height, &x, &y);
+  if (image == NULL)
+    return;
+
+  g_assert (cache->current_atlas != old_atlas);
+
+  gsk_gpu_blit_upload_op (frame,
+                          self->image,
+                          image,
+                          &(cairo_rectangle_int_t) {
+                              .x = self->bounds.origin.x - 1,
+                              .y = self->bounds.origin.y - 1,
+                              .width = width,
+                              .height = height
+                          },
+                          &(cairo_rectangle_int_t) { x, y, width, height });
+
+  /* The new atlas already accounted for the pixels when allocating */
+  mark_as_stale (cached, FALSE);
+  ((GskGpuCached *) old_atlas)->pixels -= cached->pixels;
+  cached->atlas = cache->current_atlas;
+
+  g_object_unref (self->image);
+  self->image = g_object_ref (image);
+  self->bounds.origin.x = x + 1;
+  self->bounds.origin.y = y + 1;
+
+  cache->n_compacted_glyphs++;
+}
+
+/* }}} */
+/* {{{ CachedPath */
+
+/* Path masks are white and colorized when drawing, so they can be
+ * reused with any color or source.
+ *
+ * Paths are identified by pointer, they are immutable and we keep
+ * a reference. The mask depends on the position of the path relative
+ * to the pixel grid, which is rounded to quarter pixels like glyphs.
+ * Masks always have a 1 pixel padding.
+ */
+struct _GskGpuCachedPath
+{
+  GskGpuCached parent;
+
+  GskPath *path;
+  GskFillRule fill_rule;
+  gboolean is_stroke;
+  GskStroke stroke;
+  float scale_x;
+  float scale_y;
+  guint subpixel; /* x | y << 2, in quarter pixels */
+
+  GskGpuImage *image;
+  cairo_rectangle_int_t area; /* in image, without padding */
+  int x;                      /* position of area relative to the origin */
+  int y;
+};
+
+static void
+gsk_gpu_cached_path_free (GskGpuCache  *cache,
+                          GskGpuCached *cached)
+{
+  GskGpuCachedPath *self = (GskGpuCachedPath *) cached;
+
+  g_hash_table_remove (cache->path_cache, self);
+
+  gsk_path_unref (self->path);
+  gsk_stroke_clear (&self->stroke);
+  g_object_unref (self->image);
+
+  g_free (self);
+}
+
+static gboolean
+gsk_gpu_cached_path_should_collect (GskGpuCache  *cache,
+                                    GskGpuCached *cached,
+                                    gint64        cache_timeout,
+                                    gint64        timestamp)
+{
+  if (gsk_gpu_cached_is_old (cache, cached, cache_timeout, timestamp))
+    {
+      if (cached->atlas)
+        mark_as_stale (cached, TRUE);
+      else
+        return TRUE;
+    }
+
+  /* Masks in atlases are only collected when their atlas is freed */
+  return FALSE;
+}
+
+static guint
+gsk_gpu_cached_path_hash (gconstpointer data)
+{
+  const GskGpuCachedPath *path = data;
+  guint hash;
+
+  hash = GPOINTER_TO_UINT (path->path) ^
+         (path->subpixel << 24) ^
+         ((guint) (path->scale_x * 16) << 8) ^
+         ((guint) (path->scale_y * 16) << 16);
+
+  if (path->is_stroke)
+    hash ^= (guint) (path->stroke.line_width * 256) ^ (path->stroke.line_join << 28) ^ (path->stroke.line_cap << 30);
+  else
+    hash ^= path->fill_rule;
+
+  return hash;
+}
+
+static gboolean
+gsk_gpu_cached_path_equal (gconstpointer v1,
+                           gconstpointer v2)
+{
+  const GskGpuCachedPath *path1 = v1;
+  const GskGpuCachedPath *path2 = v2;
+
+  if (path1->path != path2->path ||
+      path1->is_stroke != path2->is_stroke ||
+      path1->scale_x != path2->scale_x ||
+      path1->scale_y != path2->scale_y ||
+      path1->subpixel != path2->subpixel)
+    return FALSE;
+
+  if (path1->is_stroke)
+    return gsk_stroke_equal (&path1->stroke, &path2->stroke);
+  else
+    return path1->fill_rule == path2->fill_rule;
+}
+
+static const GskGpuCachedClass GSK_GPU_CACHED_PATH_CLASS =
+{
+  sizeof (GskGpuCachedPath),
+  "Path",
+  gsk_gpu_cached_path_free,
+  gsk_gpu_cached_path_should_collect
+};
+
+static void
+gsk_gpu_cached_path_draw (gpointer  data,
+                          cairo_t  *cr)
+{
+  GskGpuCachedPath *self = data;
+
+  gsk_path_to_cairo (self->path, cr);
+  cairo_set_source_rgba (cr, 1, 1, 1, 1);
+
+  if (self->is_stroke)
+    {
+      gsk_stroke_to_cairo (&self->stroke, cr);
+      cairo_stroke (cr);
+    }
+  else
+    {
+      switch (self->fill_rule)
+        {
+        case GSK_FILL_RULE_WINDING:
+          cairo_set_fill_rule (cr, CAIRO_FILL_RULE_WINDING);
+          break;
+        case GSK_FILL_RULE_EVEN_ODD:
+          cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+          break;
+        default:
+          g_assert_not_reached ();
+          break;
+        }
+      cairo_fill (cr);
+    }
+}
+
+/* The draw function only uses the key, so it gets its own copy
+ * as the cached path may be freed before the upload happens.
+ */
+static void
+gsk_gpu_cached_path_key_free (gpointer data)
+{
+  GskGpuCachedPath *key = data;
+
+  gsk_path_unref (key->path);
+  gsk_stroke_clear (&key->stroke);
+  g_free (key);
+}
+
 /* }}} */
 /* {{{ GskGpuCache */
 
@@ -842,6 +1316,135 @@ gsk_gpu_cache_set_time (GskGpuCache *self,
   self->timestamp = timestamp;
 }
 
+/*
+ * gsk_gpu_cache_set_policy:
+ * @self: a `GskGpuCache`
+ * @policy: the new policy
+ *
+ * Sets the sizes and limits that the cache uses. Existing atlases
+ * keep their size, new glyphs will be put into a new atlas if
+ * the atlas size changes. Budgets are enforced on the next GC.
+ **/
+void
+gsk_gpu_cache_set_policy (GskGpuCache             *self,
+                          const GskGpuCachePolicy *policy)
+{
+  g_return_if_fail (policy->max_atlas_item_size < policy->atlas_size);
+  g_return_if_fail (policy->min_alive_percent < 100);
+
+  self->policy = *policy;
+
+  if (self->current_atlas &&
+      gsk_gpu_image_get_width (self->current_atlas->image) != policy->atlas_size)
+    {
+      self->current_atlas->remaining_pixels = 0;
+      self->current_atlas = NULL;
+    }
+}
+
+const GskGpuCachePolicy *
+gsk_gpu_cache_get_policy (GskGpuCache *self)
+{
+  return &self->policy;
+}
+
+static gsize
+gsk_gpu_image_get_memory (GskGpuImage *image)
+{
+  if (image == NULL)
+    return 0;
+
+  return gsk_gpu_image_get_width (image) *
+         gsk_gpu_image_get_height (image) *
+         gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (image));
+}
+
+/* Glyphs and paths on an atlas are accounted for by the atlas */
+static gsize
+gsk_gpu_cached_get_glyph_memory (GskGpuCached *cached)
+{
+  if (cached->class == &GSK_GPU_CACHED_ATLAS_CLASS)
+    return gsk_gpu_image_get_memory (((GskGpuCachedAtlas *) cached)->image);
+  else if (cached->class == &GSK_GPU_CACHED_GLYPH_CLASS && cached->atlas == NULL)
+    return gsk_gpu_image_get_memory (((GskGpuCachedGlyph *) cached)->image);
+  else if (cached->class == &GSK_GPU_CACHED_PATH_CLASS && cached->atlas == NULL)
+    return gsk_gpu_image_get_memory (((GskGpuCachedPath *) cached)->image);
+  else
+    return 0;
+}
+
+static gsize
+gsk_gpu_cached_get_texture_memory (GskGpuCached *cached)
+{
+  if (cached->class == &GSK_GPU_CACHED_TEXTURE_CLASS)
+    return gsk_gpu_image_get_memory (((GskGpuCachedTexture *) cached)->image);
+  else if (cached->class == &GSK_GPU_CACHED_TILE_CLASS)
+    return gsk_gpu_image_get_memory (((GskGpuCachedTile *) cached)->image);
+  else if (cached->class == &GSK_GPU_CACHED_NODE_CLASS)
+    return gsk_gpu_image_get_memory (((GskGpuCachedNode *) cached)->image);
+  else
+    return 0;
+}
+
+static int
+gsk_gpu_cached_compare_timestamp (gconstpointer a,
+                                  gconstpointer b)
+{
+  const GskGpuCached *cached_a = *(const GskGpuCached **) a;
+  const GskGpuCached *cached_b = *(const GskGpuCached **) b;
+
+  if (cached_a->timestamp < cached_b->timestamp)
+    return -1;
+  else if (cached_a->timestamp > cached_b->timestamp)
+    return 1;
+  else
+    return 0;
+}
+
+/* Frees the least recently used items until the memory of the
+ * items is within the budget. Items used by the last frame are
+ * never evicted, that would just cause them to be uploaded again.
+ *
+ * Returns the memory used by the remaining items.
+ */
+static gsize
+gsk_gpu_cache_evict (GskGpuCache  *self,
+                     gsize       (* get_memory) (GskGpuCached *),
+                     gsize         budget)
+{
+  GskGpuCached *cached;
+  GPtrArray *candidates;
+  gsize memory, i;
+
+  memory = 0;
+  for (cached = self->first_cached; cached != NULL; cached = cached->next)
+    memory += get_memory (cached);
+
+  if (budget == 0 || memory <= budget)
+    return memory;
+
+  candidates = g_ptr_array_new ();
+  for (cached = self->first_cached; cached != NULL; cached = cached->next)
+    {
+      if (cached->timestamp != self->timestamp && get_memory (cached) > 0)
+        g_ptr_array_add (candidates, cached);
+    }
+
+  g_ptr_array_sort (candidates, gsk_gpu_cached_compare_timestamp);
+
+  for (i = 0; i < candidates->len && memory > budget; i++)
+    {
+      cached = g_ptr_array_index (candidates, i);
+      memory -= get_memory (cached);
+      gsk_gpu_cached_free (self, cached);
+      self->n_evicted++;
+    }
+
+  g_ptr_array_unref (candidates);
+
+  return memory;
+}
+
 typedef struct
 {
   guint n_items;
@@ -874,7 +1477,8 @@ print_cache_stats (GskGpuCache *self)
         {
           double ratio;
 
-          ratio = (double) cached->pixels / (double) (ATLAS_SIZE * ATLAS_SIZE);
+          ratio = (double) cached->pixels / (double) (gsk_gpu_image_get_width (((GskGpuCachedAtlas *) cached)->image) *
+                                                      gsk_gpu_image_get_height (((GskGpuCachedAtlas *) cached)->image));
 
           if (ratios->len == 0)
             g_string_append (ratios, " (ratios ");
@@ -902,6 +1506,19 @@ print_cache_stats (GskGpuCache *self)
         g_string_append_printf (message, " (%u in hash)", g_hash_table_size (self->texture_cache));
     }
 
+  g_string_append_printf (message, "\n  Memory:      glyphs %" G_GSIZE_FORMAT " kB", self->glyph_memory / 1024);
+  if (self->policy.glyph_budget)
+    g_string_append_printf (message, " of %" G_GSIZE_FORMAT " kB", self->policy.glyph_budget / 1024);
+  g_string_append_printf (message, ", textures %" G_GSIZE_FORMAT " kB", self->texture_memory / 1024);
+  if (self->policy.texture_budget)
+    g_string_append_printf (message, " of %" G_GSIZE_FORMAT " kB", self->policy.texture_budget / 1024);
+  g_string_append_printf (message, "\n  Evicted:     %5" G_GSIZE_FORMAT " (compacted %" G_GSIZE_FORMAT " atlases, moved %" G_GSIZE_FORMAT " glyphs)",
+                          self->n_evicted, self->n_compacted_atlases, self->n_compacted_glyphs);
+
+  if (self->disk_cache)
+    g_string_append_printf (message, "\n  Disk cache:  %5" G_GSIZE_FORMAT " hits, %" G_GSIZE_FORMAT " misses",
+                            self->disk_cache_hits, self->disk_cache_misses);
+
   gdk_debug_message ("%s", message->str);
   g_string_free (message, TRUE);
   g_hash_table_unref (classes);
@@ -930,6 +1547,9 @@ gsk_gpu_cache_gc (GskGpuCache *self,
         is_empty &= cached->stale;
     }
 
+  self->glyph_memory = gsk_gpu_cache_evict (self, gsk_gpu_cached_get_glyph_memory, self->policy.glyph_budget);
+  self->texture_memory = gsk_gpu_cache_evict (self, gsk_gpu_cached_get_texture_memory, self->policy.texture_budget);
+
   g_atomic_pointer_set (&self->dead_textures, 0);
   g_atomic_pointer_set (&self->dead_texture_pixels, 0);
 
@@ -941,6 +1561,27 @@ gsk_gpu_cache_gc (GskGpuCache *self,
   return is_empty;
 }
 
+/*
+ * gsk_gpu_cache_take_disk_cache_stats:
+ * @self: a `GskGpuCache`
+ * @out_hits: (out): glyphs found in the disk cache
+ * @out_misses: (out): glyphs that had to be rendered
+ *
+ * Gets the disk cache statistics since the last call
+ * of this function.
+ **/
+void
+gsk_gpu_cache_take_disk_cache_stats (GskGpuCache *self,
+                                     gsize       *out_hits,
+                                     gsize       *out_misses)
+{
+  *out_hits = self->disk_cache_hits - self->disk_cache_reported_hits;
+  *out_misses = self->disk_cache_misses - self->disk_cache_reported_misses;
+
+  self->disk_cache_reported_hits = self->disk_cache_hits;
+  self->disk_cache_reported_misses = self->disk_cache_misses;
+}
+
 gsize
 gsk_gpu_cache_get_dead_textures (GskGpuCache *self)
 {
@@ -981,8 +1622,12 @@ gsk_gpu_cache_dispose (GObject *object)
   GskGpuCache *self = GSK_GPU_CACHE (object);
 
   gsk_gpu_cache_clear_cache (self);
+  g_clear_pointer (&self->disk_cache, gsk_gpu_disk_cache_free);
+  g_clear_pointer (&self->font_keys, g_hash_table_unref);
   g_hash_table_unref (self->glyph_cache);
+  g_hash_table_unref (self->path_cache);
   g_clear_pointer (&self->tile_cache, g_hash_table_unref);
+  g_clear_pointer (&self->node_cache, g_hash_table_unref);
   g_hash_table_unref (self->texture_cache);
 
   G_OBJECT_CLASS (gsk_gpu_cache_parent_class)->dispose (object);
@@ -1010,8 +1655,11 @@ gsk_gpu_cache_class_init (GskGpuCacheClass *klass)
 static void
 gsk_gpu_cache_init (GskGpuCache *self)
 {
+  self->policy = default_policy;
   self->glyph_cache = g_hash_table_new (gsk_gpu_cached_glyph_hash,
                                         gsk_gpu_cached_glyph_equal);
+  self->path_cache = g_hash_table_new (gsk_gpu_cached_path_hash,
+                                       gsk_gpu_cached_path_equal);
   self->texture_cache = g_hash_table_new (g_direct_hash,
                                           g_direct_equal);
 }
@@ -1057,6 +1705,139 @@ gsk_gpu_cache_cache_texture_image (GskGpuCache   *self,
   gsk_gpu_cached_use (self, (GskGpuCached *) cache);
 }
 
+/* Computes a key for the font that is stable across processes */
+static GBytes *
+gsk_gpu_cache_get_font_key (GskGpuCache *self,
+                            PangoFont   *font)
+{
+  PangoFontDescription *desc;
+  cairo_scaled_font_t *scaled_font;
+  cairo_font_options_t *options;
+  cairo_matrix_t matrix;
+  GByteArray *array;
+  hb_blob_t *blob;
+  const char *data;
+  unsigned int length;
+  GBytes *key;
+  guint64 value;
+  char *str;
+
+  key = g_hash_table_lookup (self->font_keys, font);
+  if (key)
+    return key;
+
+  array = g_byte_array_new ();
+
+  desc = pango_font_describe_with_absolute_size (font);
+  str = pango_font_description_to_string (desc);
+  g_byte_array_append (array, (const guint8 *) str, strlen (str) + 1);
+  g_free (str);
+  pango_font_description_free (desc);
+
+  scaled_font = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
+
+  options = cairo_font_options_create ();
+  cairo_scaled_font_get_font_options (scaled_font, options);
+  value = cairo_font_options_hash (options);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+  cairo_font_options_destroy (options);
+
+  /* The description doesn't include transforms of the font,
+   * like from the context's matrix */
+  cairo_scaled_font_get_font_matrix (scaled_font, &matrix);
+  g_byte_array_append (array, (const guint8 *) &matrix, sizeof (matrix));
+  cairo_scaled_font_get_ctm (scaled_font, &matrix);
+  g_byte_array_append (array, (const guint8 *) &matrix, sizeof (matrix));
+
+  /* The head table contains the revision and modification time,
+   * so updating the font file invalidates its glyphs */
+  blob = hb_face_reference_table (hb_font_get_face (pango_font_get_hb_font (font)),
+                                  HB_TAG ('h', 'e', 'a', 'd'));
+  data = hb_blob_get_data (blob, &length);
+  g_byte_array_append (array, (const guint8 *) data, length);
+  hb_blob_destroy (blob);
+
+  key = g_byte_array_free_to_bytes (array);
+  g_hash_table_insert (self->font_keys, g_object_ref (font), key);
+
+  return key;
+}
+
+/* The full key is stored with the glyph and compared on lookup,
+ * so different glyphs with the same hash can't be confused */
+static GBytes *
+gsk_gpu_cache_get_glyph_key (GskGpuCache            *self,
+                             PangoFont              *font,
+                             PangoGlyph              glyph,
+                             GskGpuGlyphLookupFlags  flags,
+                             float                   scale)
+{
+  GBytes *font_key;
+  GByteArray *array;
+  guint32 value;
+
+  font_key = gsk_gpu_cache_get_font_key (self, font);
+
+  array = g_byte_array_sized_new (g_bytes_get_size (font_key) + 3 * sizeof (guint32));
+  g_byte_array_append (array, g_bytes_get_data (font_key, NULL), g_bytes_get_size (font_key));
+  value = glyph;
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+  value = flags;
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+  g_byte_array_append (array, (const guint8 *) &scale, sizeof (scale));
+
+  return g_byte_array_free_to_bytes (array);
+}
+
+/* Uploads the glyph from the disk cache into the atlas.
+ *
+ * The disk cache only contains glyphs that were rendered into
+ * an atlas, so they always include a 1 pixel padding.
+ */
+static GskGpuCachedGlyph *
+gsk_gpu_cache_load_glyph (GskGpuCache *self,
+                          GskGpuFrame *frame,
+                          GBytes      *key)
+{
+  GskGpuCachedGlyph *cache;
+  graphene_point_t origin;
+  gsize width, height, atlas_x, atlas_y;
+  GskGpuImage *image;
+  GBytes *bytes;
+
+  bytes = gsk_gpu_disk_cache_lookup (self->disk_cache, key, &width, &height, &origin);
+  if (bytes == NULL)
+    {
+      self->disk_cache_misses++;
+      return NULL;
+    }
+
+  image = gsk_gpu_cache_add_atlas_image (self, width, height, &atlas_x, &atlas_y);
+  if (image == NULL)
+    {
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  self->disk_cache_hits++;
+
+  cache = gsk_gpu_cached_new_from_atlas (self, &GSK_GPU_CACHED_GLYPH_CLASS, self->current_atlas);
+  cache->image = g_object_ref (image);
+  cache->bounds = GRAPHENE_RECT_INIT (atlas_x + 1, atlas_y + 1, width - 2, height - 2);
+  cache->origin = GRAPHENE_POINT_INIT (origin.x - 1, origin.y - 1);
+  ((GskGpuCached *) cache)->pixels = width * height;
+
+  gsk_gpu_upload_bytes_op (frame,
+                           image,
+                           &(cairo_rectangle_int_t) { atlas_x, atlas_y, width, height },
+                           bytes,
+                           width * 4);
+
+  g_bytes_unref (bytes);
+
+  return cache;
+}
+
 GskGpuImage *
 gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
                                   GskGpuFrame            *frame,
@@ -1078,14 +1859,18 @@ gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
   graphene_rect_t rect;
   graphene_point_t origin;
   GskGpuImage *image;
-  gsize atlas_x, atlas_y, padding;
+  gsize atlas_x, atlas_y, padding, spread;
   float subpixel_x, subpixel_y;
   PangoFont *scaled_font;
   cairo_hint_metrics_t hint_metrics;
+  GBytes *disk_key = NULL;
 
   cache = g_hash_table_lookup (self->glyph_cache, &lookup);
   if (cache)
     {
+      if (((GskGpuCached *) cache)->atlas && ((GskGpuCached *) cache)->atlas->compacting)
+        gsk_gpu_cached_glyph_compact (self, cache, frame);
+
       gsk_gpu_cached_use (self, (GskGpuCached *) cache);
 
       *out_bounds = cache->bounds;
@@ -1093,6 +1878,28 @@ gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
       return cache->image;
     }
 
+  if (self->disk_cache)
+    {
+      disk_key = gsk_gpu_cache_get_glyph_key (self, font, glyph, flags, scale);
+      cache = gsk_gpu_cache_load_glyph (self, frame, disk_key);
+      if (cache)
+        {
+          g_bytes_unref (disk_key);
+
+          cache->font = g_object_ref (font);
+          cache->glyph = glyph;
+          cache->flags = flags;
+          cache->scale = scale;
+
+          g_hash_table_insert (self->glyph_cache, cache, cache);
+          gsk_gpu_cached_use (self, (GskGpuCached *) cache);
+
+          *out_bounds = cache->bounds;
+          *out_origin = cache->origin;
+          return cache->image;
+        }
+    }
+
   /* The combination of hint-style != none and hint-metrics == off
    * leads to broken rendering with some fonts.
    */
@@ -1110,7 +1917,11 @@ gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
   origin.y = floor (ink_rect.y * 1.0 / PANGO_SCALE + subpixel_y);
   rect.size.width = ceil ((ink_rect.x + ink_rect.width) * 1.0 / PANGO_SCALE + subpixel_x) - origin.x;
   rect.size.height = ceil ((ink_rect.y + ink_rect.height) * 1.0 / PANGO_SCALE + subpixel_y) - origin.y;
-  padding = 1;
+  if (flags & GSK_GPU_GLYPH_DISTANCE_FIELD)
+    spread = GSK_GPU_DISTANCE_FIELD_SPREAD;
+  else
+    spread = 0;
+  padding = spread + 1;
 
   image = gsk_gpu_cache_add_atlas_image (self,
                                          rect.size.width + 2 * padding, rect.size.height + 2 * padding,
@@ -1124,10 +1935,13 @@ gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
     }
   else
     {
-      image = gsk_gpu_device_create_upload_image (self->device, FALSE, GDK_MEMORY_DEFAULT, FALSE, rect.size.width, rect.size.height),
-      rect.origin.x = 0;
-      rect.origin.y = 0;
-      padding = 0;
+      /* Distance fields need the room to spread into */
+      if (spread == 0)
+        padding = 0;
+      image = gsk_gpu_device_create_upload_image (self->device, FALSE, GDK_MEMORY_DEFAULT, FALSE,
+                                                  rect.size.width + 2 * padding, rect.size.height + 2 * padding),
+      rect.origin.x = padding;
+      rect.origin.y = padding;
       cache = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_GLYPH_CLASS);
     }
 
@@ -1152,7 +1966,20 @@ gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
                                .height = rect.size.height + 2 * padding,
                            },
                            &GRAPHENE_POINT_INIT (cache->origin.x + padding,
-                                                 cache->origin.y + padding));
+                                                 cache->origin.y + padding),
+                           spread,
+                           padding ? self->disk_cache : NULL,
+                           disk_key);
+  g_clear_pointer (&disk_key, g_bytes_unref);
+
+  /* Distance fields are drawn including the area they spread into,
+   * this matches what gsk_gpu_cache_load_glyph() does. */
+  if (spread)
+    {
+      graphene_rect_inset (&cache->bounds, - (float) spread, - (float) spread);
+      cache->origin.x += spread;
+      cache->origin.y += spread;
+    }
 
   g_hash_table_insert (self->glyph_cache, cache, cache);
   gsk_gpu_cached_use (self, (GskGpuCached *) cache);
@@ -1165,6 +1992,135 @@ gsk_gpu_cache_lookup_glyph_image (GskGpuCache            *self,
   return cache->image;
 }
 
+/*
+ * gsk_gpu_cache_lookup_path_image:
+ * @self: a `GskGpuCache`
+ * @frame: the frame to upload the mask with
+ * @path: the path
+ * @fill_rule: the fill rule if @stroke is %NULL
+ * @stroke: (nullable): the stroke or %NULL to fill the path
+ * @scale: the scale of the node processor
+ * @offset: the offset of the node processor
+ * @bounds: the bounds of the fill or stroke node
+ * @out_rect: (out): the rectangle covered by the whole image
+ *
+ * Looks up the mask for filling or stroking a path, or draws it
+ * if it isn't cached yet. The mask is white.
+ *
+ * Returns: (transfer none) (nullable): the image containing the
+ *   mask or %NULL if the mask is too large to be cached
+ */
+GskGpuImage *
+gsk_gpu_cache_lookup_path_image (GskGpuCache            *self,
+                                 GskGpuFrame            *frame,
+                                 GskPath                *path,
+                                 GskFillRule             fill_rule,
+                                 const GskStroke        *stroke,
+                                 const graphene_vec2_t  *scale,
+                                 const graphene_point_t *offset,
+                                 const graphene_rect_t  *bounds,
+                                 graphene_rect_t        *out_rect)
+{
+  GskGpuCachedPath lookup = {
+    .path = path,
+    .fill_rule = fill_rule,
+    .is_stroke = stroke != NULL,
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+  };
+  GskGpuCachedPath *cache, *key;
+  float origin_x, origin_y, subpixel_x, subpixel_y;
+  gsize x, y, width, height;
+  GskGpuImage *image;
+
+  /* The device position of the origin, rounded to quarter pixels */
+  origin_x = floorf (offset->x * lookup.scale_x * 4 + 0.5f) / 4;
+  origin_y = floorf (offset->y * lookup.scale_y * 4 + 0.5f) / 4;
+  subpixel_x = origin_x - floorf (origin_x);
+  subpixel_y = origin_y - floorf (origin_y);
+  lookup.subpixel = ((guint) (subpixel_x * 4)) | ((guint) (subpixel_y * 4) << 2);
+  if (stroke)
+    lookup.stroke = *stroke;
+
+  cache = g_hash_table_lookup (self->path_cache, &lookup);
+  /* Compacting an atlas doesn't move paths, they are drawn again */
+  if (cache && ((GskGpuCached *) cache)->atlas && ((GskGpuCached *) cache)->atlas->compacting)
+    {
+      gsk_gpu_cached_free (self, (GskGpuCached *) cache);
+      cache = NULL;
+    }
+
+  if (cache == NULL)
+    {
+      int left, top, right, bottom;
+
+      left = floorf (bounds->origin.x * lookup.scale_x + subpixel_x);
+      top = floorf (bounds->origin.y * lookup.scale_y + subpixel_y);
+      right = ceilf ((bounds->origin.x + bounds->size.width) * lookup.scale_x + subpixel_x);
+      bottom = ceilf ((bounds->origin.y + bounds->size.height) * lookup.scale_y + subpixel_y);
+      if (right <= left || bottom <= top ||
+          right - left > MAX_PATH_MASK_SIZE || bottom - top > MAX_PATH_MASK_SIZE)
+        return NULL;
+
+      width = right - left + 2;
+      height = bottom - top + 2;
+
+      image = gsk_gpu_cache_add_atlas_image (self, width, height, &x, &y);
+      if (image)
+        {
+          cache = gsk_gpu_cached_new_from_atlas (self, &GSK_GPU_CACHED_PATH_CLASS, self->current_atlas);
+          cache->image = g_object_ref (image);
+        }
+      else
+        {
+          x = y = 0;
+          cache = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_PATH_CLASS);
+          cache->image = gsk_gpu_device_create_upload_image (self->device, FALSE, GDK_MEMORY_DEFAULT, FALSE, width, height);
+        }
+
+      cache->path = gsk_path_ref (path);
+      cache->fill_rule = fill_rule;
+      cache->is_stroke = stroke != NULL;
+      if (stroke)
+        cache->stroke = GSK_STROKE_INIT_COPY (stroke);
+      cache->scale_x = lookup.scale_x;
+      cache->scale_y = lookup.scale_y;
+      cache->subpixel = lookup.subpixel;
+      cache->area = (cairo_rectangle_int_t) { x + 1, y + 1, width - 2, height - 2 };
+      cache->x = left;
+      cache->y = top;
+      ((GskGpuCached *) cache)->pixels = width * height;
+
+      key = g_memdup2 (cache, sizeof (GskGpuCachedPath));
+      gsk_path_ref (key->path);
+      if (stroke)
+        key->stroke = GSK_STROKE_INIT_COPY (stroke);
+
+      gsk_gpu_upload_cairo_into_op (frame,
+                                    cache->image,
+                                    &(cairo_rectangle_int_t) { x, y, width, height },
+                                    scale,
+                                    &GRAPHENE_POINT_INIT (subpixel_x - left + 1,
+                                                          subpixel_y - top + 1),
+                                    GSK_GPU_CAIRO_THREADSAFE,
+                                    gsk_gpu_cached_path_draw,
+                                    key,
+                                    gsk_gpu_cached_path_key_free);
+
+      g_hash_table_insert (self->path_cache, cache, cache);
+    }
+
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache);
+
+  /* device = (user + offset) * scale */
+  *out_rect = GRAPHENE_RECT_INIT ((floorf (origin_x) + cache->x - cache->area.x) / lookup.scale_x - offset->x,
+                                  (floorf (origin_y) + cache->y - cache->area.y) / lookup.scale_y - offset->y,
+                                  gsk_gpu_image_get_width (cache->image) / lookup.scale_x,
+                                  gsk_gpu_image_get_height (cache->image) / lookup.scale_y);
+
+  return cache->image;
+}
+
 GskGpuCache *
 gsk_gpu_cache_new (GskGpuDevice *device)
 {
@@ -1172,6 +2128,9 @@ gsk_gpu_cache_new (GskGpuDevice *device)
 
   self = g_object_new (GSK_TYPE_GPU_CACHE, NULL);
   self->device = g_object_ref (device);
+  self->disk_cache = gsk_gpu_disk_cache_new_from_env ();
+  if (self->disk_cache)
+    self->font_keys = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, (GDestroyNotify) g_bytes_unref);
 
   return self;
 }
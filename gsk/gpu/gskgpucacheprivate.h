@@ -2,6 +2,8 @@
 
 #include "gskgputypesprivate.h"
 
+#include "gsktypes.h"
+
 #include <graphene.h>
 
 G_BEGIN_DECLS
@@ -9,6 +11,17 @@ G_BEGIN_DECLS
 typedef struct _GskGpuCached GskGpuCached;
 typedef struct _GskGpuCachedClass GskGpuCachedClass;
 typedef struct _GskGpuCachedAtlas GskGpuCachedAtlas;
+typedef struct _GskGpuCachePolicy GskGpuCachePolicy;
+
+struct _GskGpuCachePolicy
+{
+  gsize atlas_size;             /* width and height of glyph atlases */
+  gsize max_atlas_item_size;    /* larger glyphs get their own image */
+  guint min_alive_percent;      /* atlases with less live pixels get compacted */
+  guint atlas_timeout_scale;    /* how much longer than other items an empty atlas is kept */
+  gsize glyph_budget;           /* in bytes for atlases, glyphs and path masks, 0 for unlimited */
+  gsize texture_budget;         /* in bytes for textures and tiles, 0 for unlimited */
+};
 
 struct _GskGpuCachedClass
 {
@@ -58,12 +71,19 @@ gpointer                gsk_gpu_cached_new                              (GskGpuC
                                                                          const GskGpuCachedClass *class);
 
 GskGpuDevice *          gsk_gpu_cache_get_device                        (GskGpuCache            *self);
+void                    gsk_gpu_cache_set_policy                        (GskGpuCache            *self,
+                                                                         const GskGpuCachePolicy *policy);
+const GskGpuCachePolicy *
+                        gsk_gpu_cache_get_policy                        (GskGpuCache            *self);
 void                    gsk_gpu_cache_set_time                          (GskGpuCache            *self,
                                                                          gint64                  timestamp);
 
 gboolean                gsk_gpu_cache_gc                                (GskGpuCache            *self,
                                                                          gint64                  cache_timeout,
                                                                          gint64                  timestamp);
+void                    gsk_gpu_cache_take_disk_cache_stats             (GskGpuCache            *self,
+                                                                         gsize                  *out_hits,
+                                                                         gsize                  *out_misses);
 gsize                   gsk_gpu_cache_get_dead_textures                 (GskGpuCache            *self);
 gsize                   gsk_gpu_cache_get_dead_texture_pixels           (GskGpuCache            *self);
 GskGpuImage *           gsk_gpu_cache_get_atlas_image                   (GskGpuCache            *self);
@@ -88,6 +108,20 @@ void                    gsk_gpu_cache_cache_tile                        (GskGpuC
                                                                          gsize                   tile_id,
                                                                          GskGpuImage            *image,
                                                                          GdkColorState          *color_state);
+GskGpuImage *           gsk_gpu_cache_lookup_node_image                 (GskGpuCache            *self,
+                                                                         GskRenderNode          *node,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         GdkColorState          *color_state,
+                                                                         const graphene_rect_t  *rect,
+                                                                         graphene_rect_t        *out_image_rect);
+void                    gsk_gpu_cache_cache_node_image                  (GskGpuCache            *self,
+                                                                         GskRenderNode          *node,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         GdkColorState          *color_state,
+                                                                         const graphene_rect_t  *rect,
+                                                                         GskGpuImage            *image);
+GskGpuImage *           gsk_gpu_cache_peek_node_image                   (GskGpuCache            *self,
+                                                                         GskRenderNode          *node);
 
 typedef enum
 {
@@ -96,9 +130,19 @@ typedef enum
   GSK_GPU_GLYPH_X_OFFSET_3 = 0x3,
   GSK_GPU_GLYPH_Y_OFFSET_1 = 0x4,
   GSK_GPU_GLYPH_Y_OFFSET_2 = 0x8,
-  GSK_GPU_GLYPH_Y_OFFSET_3 = 0xC
+  GSK_GPU_GLYPH_Y_OFFSET_3 = 0xC,
+  GSK_GPU_GLYPH_DISTANCE_FIELD = 0x10
 } GskGpuGlyphLookupFlags;
 
+/* Distance field glyphs are rendered once at this size in pixels
+ * and then drawn at any scale.
+ */
+#define GSK_GPU_DISTANCE_FIELD_SIZE 64
+/* The distance in pixels at GSK_GPU_DISTANCE_FIELD_SIZE that the
+ * field covers on either side of the outline.
+ */
+#define GSK_GPU_DISTANCE_FIELD_SPREAD 8
+
 GskGpuImage *           gsk_gpu_cache_lookup_glyph_image                (GskGpuCache            *self,
                                                                          GskGpuFrame            *frame,
                                                                          PangoFont              *font,
@@ -108,6 +152,16 @@ GskGpuImage *           gsk_gpu_cache_lookup_glyph_image                (GskGpuC
                                                                          graphene_rect_t        *out_bounds,
                                                                          graphene_point_t       *out_origin);
 
+GskGpuImage *           gsk_gpu_cache_lookup_path_image                 (GskGpuCache            *self,
+                                                                         GskGpuFrame            *frame,
+                                                                         GskPath                *path,
+                                                                         GskFillRule             fill_rule,
+                                                                         const GskStroke        *stroke,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         const graphene_point_t *offset,
+                                                                         const graphene_rect_t  *bounds,
+                                                                         graphene_rect_t        *out_rect);
+
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GskGpuCache, g_object_unref)
 
@@ -8,6 +8,8 @@
 
 #include "gsk/gskdebugprivate.h"
 
+#include <math.h>
+
 #define CACHE_TIMEOUT 15  /* seconds */
 
 typedef struct _GskGpuDevicePrivate GskGpuDevicePrivate;
@@ -19,6 +21,7 @@ struct _GskGpuDevicePrivate
   gsize tile_size;
 
   GskGpuCache *cache; /* we don't own a ref, but manage the cache */
+  GskGpuCachePolicy cache_policy;
   guint cache_gc_source;
   int cache_timeout;  /* in seconds, or -1 to disable gc */
 };
@@ -143,6 +146,95 @@ static void
 gsk_gpu_device_init (GskGpuDevice *self)
 {
 }
+
+static gsize
+get_env_megabytes (const char *name)
+{
+  const char *str;
+  guint64 value;
+  GError *error = NULL;
+
+  str = g_getenv (name);
+  if (str == NULL)
+    return 0;
+
+  if (!g_ascii_string_to_unsigned (str, 10, 0, G_MAXSIZE / (1024 * 1024), &value, &error))
+    {
+      g_warning ("Failed to parse %s: %s", name, error->message);
+      g_error_free (error);
+      return 0;
+    }
+
+  return value * 1024 * 1024;
+}
+
+/* Larger displays show more glyphs and show them larger, so they
+ * would fill a 1024x1024 atlas all the time.
+ */
+static gsize
+get_default_atlas_size (GdkDisplay *display,
+                        gsize       max_image_size)
+{
+  GListModel *monitors;
+  gsize i, size, max_pixels;
+
+  monitors = gdk_display_get_monitors (display);
+  max_pixels = 0;
+  for (i = 0; i < g_list_model_get_n_items (monitors); i++)
+    {
+      GdkMonitor *monitor = g_list_model_get_item (monitors, i);
+      GdkRectangle geometry;
+      double scale;
+
+      gdk_monitor_get_geometry (monitor, &geometry);
+      scale = gdk_monitor_get_scale (monitor);
+      max_pixels = MAX (max_pixels, ceil (geometry.width * scale) * ceil (geometry.height * scale));
+
+      g_object_unref (monitor);
+    }
+
+  for (size = 1024; size * size * 4 < max_pixels && size * 2 <= max_image_size; size *= 2)
+    ;
+
+  return MIN (size, max_image_size);
+}
+
+static void
+gsk_gpu_device_setup_cache_policy (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachePolicy *policy = &priv->cache_policy;
+  const char *str;
+
+  policy->atlas_size = get_default_atlas_size (priv->display, priv->max_image_size);
+
+  str = g_getenv ("GSK_ATLAS_SIZE");
+  if (str != NULL)
+    {
+      guint64 value;
+      GError *error = NULL;
+
+      if (!g_ascii_string_to_unsigned (str, 10, 256, priv->max_image_size, &value, &error))
+        {
+          g_warning ("Failed to parse GSK_ATLAS_SIZE: %s", error->message);
+          g_error_free (error);
+        }
+      else
+        {
+          policy->atlas_size = value;
+        }
+    }
+
+  policy->max_atlas_item_size = policy->atlas_size / 4;
+  policy->min_alive_percent = 50;
+  policy->atlas_timeout_scale = 4;
+  policy->glyph_budget = get_env_megabytes ("GSK_GLYPH_BUDGET");
+  policy->texture_budget = get_env_megabytes ("GSK_TEXTURE_BUDGET");
+
+  GSK_DEBUG (CACHE, "Atlas size: %" G_GSIZE_FORMAT ", glyph budget: %" G_GSIZE_FORMAT " MB, texture budget: %" G_GSIZE_FORMAT " MB",
+             policy->atlas_size, policy->glyph_budget / (1024 * 1024), policy->texture_budget / (1024 * 1024));
+}
+
 void
 gsk_gpu_device_setup (GskGpuDevice *self,
                       GdkDisplay   *display,
@@ -183,6 +275,8 @@ gsk_gpu_device_setup (GskGpuDevice *self,
       else
         gdk_debug_message ("Cache GC timeout: %d seconds", priv->cache_timeout);
     }
+
+  gsk_gpu_device_setup_cache_policy (self);
 }
 
 GdkDisplay *
@@ -202,6 +296,7 @@ gsk_gpu_device_get_cache (GskGpuDevice *self)
     return priv->cache;
 
   priv->cache = gsk_gpu_cache_new (self);
+  gsk_gpu_cache_set_policy (priv->cache, &priv->cache_policy);
 
   return priv->cache;
 }
@@ -0,0 +1,682 @@
+#include "config.h"
+
+#include "gskgpudiskcacheprivate.h"
+
+#include "gdk/gdkprofilerprivate.h"
+
+#include "gsk/gskdebugprivate.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* The cache file is a header, followed by a table of entries sorted
+ * by the hash of their key, followed by the data. The data for each
+ * entry is the pixels, stored the way glyph uploads produce them:
+ * CAIRO_FORMAT_ARGB32 without any padding between rows, followed by
+ * the full key, padded to 4 bytes. The key is compared on lookup, so
+ * hash collisions can't return the wrong image.
+ *
+ * The file is only ever replaced atomically, so processes can keep
+ * using their mapping of an older version while a new one gets written
+ * and multiple processes can share the same file.
+ */
+
+#define MAGIC "GSKGLYPH"
+#define VERSION 2
+#define BYTE_ORDER_MARK 0x01020304
+
+/* Once the file would grow larger, we start over */
+#define MAX_FILE_SIZE (32 * 1024 * 1024)
+
+/* Seconds to wait for more glyphs before writing the file */
+#define SAVE_DELAY 2
+
+typedef struct _FileHeader FileHeader;
+typedef struct _FileEntry FileEntry;
+typedef struct _PendingEntry PendingEntry;
+typedef struct _SaveJob SaveJob;
+
+struct _FileHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_entries;
+  guint32 reserved;
+};
+
+struct _FileEntry
+{
+  guint64 hash;
+  guint32 offset;
+  guint32 key_size;
+  guint16 width;
+  guint16 height;
+  float origin_x;
+  float origin_y;
+  guint32 reserved;
+};
+
+G_STATIC_ASSERT (sizeof (FileHeader) == 24);
+G_STATIC_ASSERT (sizeof (FileEntry) == 32);
+
+struct _PendingEntry
+{
+  FileEntry entry; /* offset is unused */
+  GBytes *key;
+  GBytes *bytes;
+  gboolean saved;
+};
+
+struct _SaveJob
+{
+  char *path;
+  GArray *entries; /* PendingEntry */
+  /* atomic */ int done;
+};
+
+struct _GskGpuDiskCache
+{
+  char *path;
+
+  GBytes *file;
+  const FileEntry *entries;
+  gsize n_entries;
+
+  GMutex lock;
+  GHashTable *pending; /* GBytes key => PendingEntry, protected by lock */
+  GPtrArray *unsaved;  /* PendingEntry, protected by lock */
+  guint save_source;   /* protected by lock */
+
+  GThread *save_thread;
+  SaveJob *save_job;
+};
+
+static void
+pending_entry_free (gpointer data)
+{
+  PendingEntry *pending = data;
+
+  g_bytes_unref (pending->key);
+  g_bytes_unref (pending->bytes);
+  g_free (pending);
+}
+
+static void
+pending_entry_clear (gpointer data)
+{
+  PendingEntry *pending = data;
+
+  g_bytes_unref (pending->key);
+  g_bytes_unref (pending->bytes);
+}
+
+static int
+pending_entry_compare (gconstpointer a,
+                       gconstpointer b)
+{
+  const PendingEntry *pa = a;
+  const PendingEntry *pb = b;
+
+  if (pa->entry.hash < pb->entry.hash)
+    return -1;
+  else
+    return pa->entry.hash > pb->entry.hash;
+}
+
+/* FNV-1a, we need more than 32 bits and the result must be
+ * stable across processes and architectures.
+ */
+static guint64
+gsk_gpu_disk_cache_hash (GBytes *key)
+{
+  const guchar *data;
+  guint64 hash;
+  gsize i, size;
+
+  data = g_bytes_get_data (key, &size);
+
+  hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  for (i = 0; i < size; i++)
+    {
+      hash ^= data[i];
+      hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+  return hash;
+}
+
+static gsize
+file_entry_get_pixels_size (const FileEntry *entry)
+{
+  return (gsize) entry->width * entry->height * 4;
+}
+
+static gsize
+file_entry_get_size (const FileEntry *entry)
+{
+  /* keys are padded to keep the pixels aligned */
+  return file_entry_get_pixels_size (entry) + ((entry->key_size + 3) & ~3u);
+}
+
+static GBytes *
+gsk_gpu_disk_cache_load (const char       *path,
+                         const FileEntry **out_entries,
+                         gsize            *out_n_entries)
+{
+  GMappedFile *file;
+  GError *error = NULL;
+  const FileHeader *header;
+  const FileEntry *entries;
+  const guchar *data;
+  GBytes *bytes;
+  gsize size, i;
+
+  file = g_mapped_file_new (path, FALSE, &error);
+  if (file == NULL)
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        GSK_DEBUG (CACHE, "Failed to load glyph cache '%s': %s", path, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  bytes = g_mapped_file_get_bytes (file);
+  g_mapped_file_unref (file);
+
+  data = g_bytes_get_data (bytes, &size);
+  if (size < sizeof (FileHeader))
+    goto invalid;
+
+  header = (const FileHeader *) data;
+  if (memcmp (header->magic, MAGIC, sizeof (header->magic)) != 0 ||
+      header->version != VERSION ||
+      header->byte_order != BYTE_ORDER_MARK ||
+      header->n_entries > (size - sizeof (FileHeader)) / sizeof (FileEntry))
+    goto invalid;
+
+  entries = (const FileEntry *) (data + sizeof (FileHeader));
+  for (i = 0; i < header->n_entries; i++)
+    {
+      if (i > 0 && entries[i - 1].hash >= entries[i].hash)
+        goto invalid;
+      if (entries[i].offset > size ||
+          file_entry_get_size (&entries[i]) > size - entries[i].offset)
+        goto invalid;
+    }
+
+  *out_entries = entries;
+  *out_n_entries = header->n_entries;
+
+  return bytes;
+
+invalid:
+  GSK_DEBUG (CACHE, "Ignoring invalid glyph cache '%s'", path);
+  g_bytes_unref (bytes);
+  return NULL;
+}
+
+static const FileEntry *
+gsk_gpu_disk_cache_find (GskGpuDiskCache *self,
+                         GBytes          *key)
+{
+  const FileEntry *entry;
+  gsize start, end, mid, key_size;
+  gconstpointer key_data;
+  guint64 hash;
+
+  hash = gsk_gpu_disk_cache_hash (key);
+
+  start = 0;
+  end = self->n_entries;
+  while (start < end)
+    {
+      mid = (start + end) / 2;
+      if (self->entries[mid].hash == hash)
+        break;
+      else if (self->entries[mid].hash < hash)
+        start = mid + 1;
+      else
+        end = mid;
+    }
+  if (start >= end)
+    return NULL;
+
+  /* Check that it's the same key and not just the same hash */
+  entry = &self->entries[mid];
+  key_data = g_bytes_get_data (key, &key_size);
+  if (entry->key_size != key_size ||
+      memcmp ((const guchar *) g_bytes_get_data (self->file, NULL) + entry->offset + file_entry_get_pixels_size (entry),
+              key_data, key_size) != 0)
+    return NULL;
+
+  return entry;
+}
+
+static gpointer
+gsk_gpu_disk_cache_save_thread (gpointer data)
+{
+  SaveJob *job = data;
+  G_GNUC_UNUSED gint64 before = GDK_PROFILER_CURRENT_TIME;
+  const FileEntry *old_entries = NULL;
+  gsize n_old = 0, i, j, size, offset;
+  GError *error = NULL;
+  FileHeader *header;
+  FileEntry *entries;
+  GArray *merged;
+  guchar *buffer;
+  GBytes *old;
+  char *dir;
+
+  g_array_sort (job->entries, pending_entry_compare);
+
+  old = gsk_gpu_disk_cache_load (job->path, &old_entries, &n_old);
+
+  /* Check that everything fits, and if it doesn't, throw out the
+   * old contents. This gets rid of glyphs for fonts that are no
+   * longer in use.
+   */
+  size = sizeof (FileHeader);
+  for (i = 0; i < n_old; i++)
+    size += sizeof (FileEntry) + file_entry_get_size (&old_entries[i]);
+  for (j = 0; j < job->entries->len; j++)
+    size += sizeof (FileEntry) + file_entry_get_size (&g_array_index (job->entries, PendingEntry, j).entry);
+  if (size > MAX_FILE_SIZE)
+    {
+      GSK_DEBUG (CACHE, "Glyph cache '%s' is full, starting over", job->path);
+      n_old = 0;
+    }
+
+  /* Merge the two sorted lists. Other processes may have added the
+   * same glyphs in the meantime, we keep their version. In the unlikely
+   * case of two keys with the same hash, the old one is kept, too.
+   */
+  merged = g_array_new (FALSE, FALSE, sizeof (PendingEntry));
+  g_array_set_clear_func (merged, pending_entry_clear);
+  size = sizeof (FileHeader);
+  i = j = 0;
+  while (i < n_old || j < job->entries->len)
+    {
+      const PendingEntry *new = j < job->entries->len ? &g_array_index (job->entries, PendingEntry, j) : NULL;
+      PendingEntry entry;
+
+      if (new == NULL || (i < n_old && old_entries[i].hash <= new->entry.hash))
+        {
+          gsize pixels_size = file_entry_get_pixels_size (&old_entries[i]);
+
+          if (new && old_entries[i].hash == new->entry.hash)
+            j++;
+          entry.entry = old_entries[i];
+          entry.bytes = g_bytes_new_from_bytes (old, old_entries[i].offset, pixels_size);
+          entry.key = g_bytes_new_from_bytes (old, old_entries[i].offset + pixels_size, old_entries[i].key_size);
+          i++;
+        }
+      else
+        {
+          entry.entry = new->entry;
+          entry.bytes = g_bytes_ref (new->bytes);
+          entry.key = g_bytes_ref (new->key);
+          j++;
+        }
+
+      if (size + sizeof (FileEntry) + file_entry_get_size (&entry.entry) > MAX_FILE_SIZE)
+        {
+          g_bytes_unref (entry.bytes);
+          g_bytes_unref (entry.key);
+          continue;
+        }
+
+      size += sizeof (FileEntry) + file_entry_get_size (&entry.entry);
+      g_array_append_val (merged, entry);
+    }
+
+  buffer = g_malloc (size);
+  header = (FileHeader *) buffer;
+  memcpy (header->magic, MAGIC, sizeof (header->magic));
+  header->version = VERSION;
+  header->byte_order = BYTE_ORDER_MARK;
+  header->n_entries = merged->len;
+  header->reserved = 0;
+
+  entries = (FileEntry *) (buffer + sizeof (FileHeader));
+  offset = sizeof (FileHeader) + merged->len * sizeof (FileEntry);
+  for (i = 0; i < merged->len; i++)
+    {
+      const PendingEntry *entry = &g_array_index (merged, PendingEntry, i);
+      gsize pixels_size = file_entry_get_pixels_size (&entry->entry);
+      gsize entry_size = file_entry_get_size (&entry->entry);
+
+      entries[i] = entry->entry;
+      entries[i].offset = offset;
+      memcpy (buffer + offset, g_bytes_get_data (entry->bytes, NULL), pixels_size);
+      memcpy (buffer + offset + pixels_size, g_bytes_get_data (entry->key, NULL), entry->entry.key_size);
+      memset (buffer + offset + pixels_size + entry->entry.key_size, 0, entry_size - pixels_size - entry->entry.key_size);
+      offset += entry_size;
+    }
+  g_assert (offset == size);
+
+  dir = g_path_get_dirname (job->path);
+  if (g_mkdir_with_parents (dir, 0755) != 0)
+    {
+      GSK_DEBUG (CACHE, "Failed to create glyph cache directory '%s'", dir);
+    }
+  else if (!g_file_set_contents_full (job->path, (const char *) buffer, size,
+                                      G_FILE_SET_CONTENTS_CONSISTENT, 0644,
+                                      &error))
+    {
+      GSK_DEBUG (CACHE, "Failed to save glyph cache: %s", error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      GSK_DEBUG (CACHE, "Saved %u glyphs (%" G_GSIZE_FORMAT " bytes) to glyph cache '%s'",
+                 merged->len, size, job->path);
+    }
+
+  g_free (dir);
+  g_free (buffer);
+  g_array_unref (merged);
+  g_clear_pointer (&old, g_bytes_unref);
+
+  gdk_profiler_end_mark (before, "Save glyph cache", NULL);
+
+  g_atomic_int_set (&job->done, TRUE);
+
+  return NULL;
+}
+
+static gboolean
+pending_entry_is_saved (gpointer key,
+                        gpointer value,
+                        gpointer data)
+{
+  PendingEntry *pending = value;
+  GskGpuDiskCache *self = data;
+
+  return pending->saved && gsk_gpu_disk_cache_find (self, pending->key) != NULL;
+}
+
+/* Waits for the last save to be done and picks up the new file */
+static void
+gsk_gpu_disk_cache_finish_save (GskGpuDiskCache *self)
+{
+  const FileEntry *entries;
+  gsize n_entries;
+  GBytes *file;
+
+  if (self->save_thread == NULL)
+    return;
+
+  g_thread_join (self->save_thread);
+  self->save_thread = NULL;
+
+  g_free (self->save_job->path);
+  g_array_unref (self->save_job->entries);
+  g_clear_pointer (&self->save_job, g_free);
+
+  file = gsk_gpu_disk_cache_load (self->path, &entries, &n_entries);
+  if (file == NULL)
+    return;
+
+  /* Lookups may still hold on to the old file, but that's fine,
+   * they keep their part of the mapping alive.
+   */
+  g_clear_pointer (&self->file, g_bytes_unref);
+  self->file = file;
+  self->entries = entries;
+  self->n_entries = n_entries;
+
+  /* Drop the copies of what is in the file now */
+  g_mutex_lock (&self->lock);
+  g_hash_table_foreach_remove (self->pending, pending_entry_is_saved, self);
+  g_mutex_unlock (&self->lock);
+}
+
+static gboolean
+gsk_gpu_disk_cache_save_cb (gpointer data)
+{
+  GskGpuDiskCache *self = data;
+
+  /* Don't block the main thread, try again later */
+  if (self->save_thread && !g_atomic_int_get (&self->save_job->done))
+    return G_SOURCE_CONTINUE;
+
+  g_mutex_lock (&self->lock);
+  self->save_source = 0;
+  g_mutex_unlock (&self->lock);
+
+  gsk_gpu_disk_cache_save (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * gsk_gpu_disk_cache_save:
+ * @self: a `GskGpuDiskCache`
+ *
+ * Starts writing all glyphs that were added since the last save
+ * to disk in a thread. If a save is still in progress, this
+ * function waits for it to finish.
+ *
+ * This happens automatically a few seconds after new glyphs were
+ * added, so there is usually no need to call this function.
+ */
+void
+gsk_gpu_disk_cache_save (GskGpuDiskCache *self)
+{
+  SaveJob *job;
+  guint i;
+
+  gsk_gpu_disk_cache_finish_save (self);
+
+  g_mutex_lock (&self->lock);
+
+  g_clear_handle_id (&self->save_source, g_source_remove);
+
+  if (self->unsaved->len == 0)
+    {
+      g_mutex_unlock (&self->lock);
+      return;
+    }
+
+  job = g_new0 (SaveJob, 1);
+  job->path = g_strdup (self->path);
+  job->entries = g_array_sized_new (FALSE, FALSE, sizeof (PendingEntry), self->unsaved->len);
+  g_array_set_clear_func (job->entries, pending_entry_clear);
+  for (i = 0; i < self->unsaved->len; i++)
+    {
+      PendingEntry *pending = g_ptr_array_index (self->unsaved, i);
+      PendingEntry copy = { pending->entry, g_bytes_ref (pending->key), g_bytes_ref (pending->bytes), TRUE };
+
+      pending->saved = TRUE;
+      g_array_append_val (job->entries, copy);
+    }
+  g_ptr_array_set_size (self->unsaved, 0);
+
+  g_mutex_unlock (&self->lock);
+
+  self->save_job = job;
+  self->save_thread = g_thread_new ("gsk-glyph-cache", gsk_gpu_disk_cache_save_thread, job);
+}
+
+/*
+ * gsk_gpu_disk_cache_lookup:
+ * @self: a `GskGpuDiskCache`
+ * @key: the key to look up, compared byte by byte
+ * @out_width: (out): the width of the image
+ * @out_height: (out): the height of the image
+ * @out_origin: (out): the origin that was stored with the image
+ *
+ * Looks up a glyph image. The returned data is in
+ * CAIRO_FORMAT_ARGB32 with a stride of 4 * width.
+ *
+ * Returns: (transfer full) (nullable): the pixel data
+ **/
+GBytes *
+gsk_gpu_disk_cache_lookup (GskGpuDiskCache  *self,
+                           GBytes           *key,
+                           gsize            *out_width,
+                           gsize            *out_height,
+                           graphene_point_t *out_origin)
+{
+  const FileEntry *entry;
+  const PendingEntry *pending;
+  GBytes *result;
+
+  entry = gsk_gpu_disk_cache_find (self, key);
+  if (entry)
+    {
+      *out_width = entry->width;
+      *out_height = entry->height;
+      *out_origin = GRAPHENE_POINT_INIT (entry->origin_x, entry->origin_y);
+      return g_bytes_new_from_bytes (self->file, entry->offset, file_entry_get_pixels_size (entry));
+    }
+
+  g_mutex_lock (&self->lock);
+
+  pending = g_hash_table_lookup (self->pending, key);
+  if (pending)
+    {
+      *out_width = pending->entry.width;
+      *out_height = pending->entry.height;
+      *out_origin = GRAPHENE_POINT_INIT (pending->entry.origin_x, pending->entry.origin_y);
+      result = g_bytes_ref (pending->bytes);
+    }
+  else
+    result = NULL;
+
+  g_mutex_unlock (&self->lock);
+
+  return result;
+}
+
+/*
+ * gsk_gpu_disk_cache_add:
+ * @self: a `GskGpuDiskCache`
+ * @key: the key for the image
+ * @width: width of the image
+ * @height: height of the image
+ * @origin: origin to store with the image
+ * @data: the pixels in CAIRO_FORMAT_ARGB32
+ * @stride: rowstride of @data
+ *
+ * Adds an image to the cache, it will be written to disk
+ * with the next save.
+ *
+ * This function can be called from any thread.
+ **/
+void
+gsk_gpu_disk_cache_add (GskGpuDiskCache        *self,
+                        GBytes                 *key,
+                        gsize                   width,
+                        gsize                   height,
+                        const graphene_point_t *origin,
+                        const guchar           *data,
+                        gsize                   stride)
+{
+  PendingEntry *pending;
+  guchar *pixels;
+  gsize y;
+
+  if (width == 0 || height == 0 || width > G_MAXUINT16 || height > G_MAXUINT16 ||
+      g_bytes_get_size (key) > G_MAXUINT16)
+    return;
+
+  g_mutex_lock (&self->lock);
+
+  if (g_hash_table_contains (self->pending, key))
+    {
+      g_mutex_unlock (&self->lock);
+      return;
+    }
+
+  pixels = g_malloc (width * height * 4);
+  for (y = 0; y < height; y++)
+    memcpy (pixels + y * width * 4, data + y * stride, width * 4);
+
+  pending = g_new (PendingEntry, 1);
+  pending->entry = (FileEntry) {
+    .hash = gsk_gpu_disk_cache_hash (key),
+    .key_size = g_bytes_get_size (key),
+    .width = width,
+    .height = height,
+    .origin_x = origin->x,
+    .origin_y = origin->y,
+  };
+  pending->key = g_bytes_ref (key);
+  pending->bytes = g_bytes_new_take (pixels, width * height * 4);
+  pending->saved = FALSE;
+
+  g_hash_table_insert (self->pending, pending->key, pending);
+  g_ptr_array_add (self->unsaved, pending);
+
+  if (self->save_source == 0)
+    self->save_source = g_timeout_add_seconds (SAVE_DELAY, gsk_gpu_disk_cache_save_cb, self);
+
+  g_mutex_unlock (&self->lock);
+}
+
+GskGpuDiskCache *
+gsk_gpu_disk_cache_new (const char *path)
+{
+  GskGpuDiskCache *self;
+
+  self = g_new0 (GskGpuDiskCache, 1);
+  self->path = g_strdup (path);
+  g_mutex_init (&self->lock);
+  self->pending = g_hash_table_new_full (g_bytes_hash, g_bytes_equal, NULL, pending_entry_free);
+  self->unsaved = g_ptr_array_new ();
+
+  self->file = gsk_gpu_disk_cache_load (path, &self->entries, &self->n_entries);
+
+  GSK_DEBUG (CACHE, "Using glyph cache '%s' with %" G_GSIZE_FORMAT " glyphs", path, self->n_entries);
+
+  return self;
+}
+
+/*
+ * gsk_gpu_disk_cache_new_from_env:
+ *
+ * Creates the disk cache if it was enabled with the
+ * GSK_GLYPH_CACHE environment variable.
+ *
+ * Returns: (nullable): the disk cache
+ **/
+GskGpuDiskCache *
+gsk_gpu_disk_cache_new_from_env (void)
+{
+  GskGpuDiskCache *self;
+  const char *env;
+  char *path;
+
+  env = g_getenv ("GSK_GLYPH_CACHE");
+  if (env == NULL || env[0] == '\0' || g_str_equal (env, "0"))
+    return NULL;
+
+  if (g_path_is_absolute (env))
+    path = g_strdup (env);
+  else
+    path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "gsk-glyph-cache", NULL);
+
+  self = gsk_gpu_disk_cache_new (path);
+
+  g_free (path);
+
+  return self;
+}
+
+void
+gsk_gpu_disk_cache_free (GskGpuDiskCache *self)
+{
+  /* Write out what we have, this is our last chance */
+  gsk_gpu_disk_cache_save (self);
+  gsk_gpu_disk_cache_finish_save (self);
+
+  g_ptr_array_unref (self->unsaved);
+  g_hash_table_unref (self->pending);
+  g_mutex_clear (&self->lock);
+  g_clear_pointer (&self->file, g_bytes_unref);
+  g_free (self->path);
+
+  g_free (self);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "gskgputypesprivate.h"
+
+#include <graphene.h>
+
+G_BEGIN_DECLS
+
+GskGpuDiskCache *       gsk_gpu_disk_cache_new_from_env                 (void);
+GskGpuDiskCache *       gsk_gpu_disk_cache_new                          (const char             *path);
+void                    gsk_gpu_disk_cache_free                         (GskGpuDiskCache        *self);
+
+GBytes *                gsk_gpu_disk_cache_lookup                       (GskGpuDiskCache        *self,
+                                                                         GBytes                 *key,
+                                                                         gsize                  *out_width,
+                                                                         gsize                  *out_height,
+                                                                         graphene_point_t       *out_origin);
+void                    gsk_gpu_disk_cache_add                          (GskGpuDiskCache        *self,
+                                                                         GBytes                 *key,
+                                                                         gsize                   width,
+                                                                         gsize                   height,
+                                                                         const graphene_point_t *origin,
+                                                                         const guchar           *data,
+                                                                         gsize                   stride);
+void                    gsk_gpu_disk_cache_save                         (GskGpuDiskCache        *self);
+
+G_END_DECLS
@@ -0,0 +1,91 @@
+#include "config.h"
+
+#include "gskgpudistancefieldopprivate.h"
+
+#include "gskgpuframeprivate.h"
+#include "gskgpuprintprivate.h"
+#include "gskrectprivate.h"
+
+#include "gpu/shaders/gskgpudistancefieldinstance.h"
+
+typedef struct _GskGpuDistanceFieldOp GskGpuDistanceFieldOp;
+
+struct _GskGpuDistanceFieldOp
+{
+  GskGpuShaderOp op;
+};
+
+static void
+gsk_gpu_distance_field_op_print_instance (GskGpuShaderOp *shader,
+                                          gpointer        instance_,
+                                          GString        *string)
+{
+  GskGpuDistancefieldInstance *instance = (GskGpuDistancefieldInstance *) instance_;
+
+  gsk_gpu_print_rect (string, instance->rect);
+  gsk_gpu_print_image (string, shader->images[0]);
+  gsk_gpu_print_rect (string, instance->tex_rect);
+  gsk_gpu_print_rgba (string, instance->color);
+}
+
+static const GskGpuShaderOpClass GSK_GPU_DISTANCE_FIELD_OP_CLASS = {
+  {
+    GSK_GPU_OP_SIZE (GskGpuDistanceFieldOp),
+    GSK_GPU_STAGE_SHADER,
+    gsk_gpu_shader_op_finish,
+    gsk_gpu_shader_op_print,
+#ifdef GDK_RENDERING_VULKAN
+    gsk_gpu_shader_op_vk_command,
+#endif
+    gsk_gpu_shader_op_gl_command
+  },
+  "gskgpudistancefield",
+  gsk_gpu_distancefield_n_textures,
+  sizeof (GskGpuDistancefieldInstance),
+#ifdef GDK_RENDERING_VULKAN
+  &gsk_gpu_distancefield_info,
+#endif
+  gsk_gpu_distance_field_op_print_instance,
+  gsk_gpu_distancefield_setup_attrib_locations,
+  gsk_gpu_distancefield_setup_vao
+};
+
+/*
+ * gsk_gpu_distance_field_op:
+ * @frame: the frame
+ * @clip: the clip to use
+ * @color_states: the color states
+ * @opacity: opacity to apply
+ * @offset: offset to apply to the image
+ * @image: the distance field to draw
+ * @color: the color to fill the shape with
+ *
+ * Like gsk_gpu_colorize_op2(), but the alpha channel of the image
+ * contains a signed distance field as produced for
+ * %GSK_GPU_GLYPH_DISTANCE_FIELD glyphs. The edges are antialiased
+ * for the scale the image is drawn at.
+ */
+void
+gsk_gpu_distance_field_op (GskGpuFrame             *frame,
+                           GskGpuShaderClip         clip,
+                           GskGpuColorStates        color_states,
+                           float                    opacity,
+                           const graphene_point_t  *offset,
+                           const GskGpuShaderImage *image,
+                           const GdkColor          *color)
+{
+  GskGpuDistancefieldInstance *instance;
+
+  gsk_gpu_shader_op_alloc (frame,
+                           &GSK_GPU_DISTANCE_FIELD_OP_CLASS,
+                           color_states,
+                           0,
+                           clip,
+                           (GskGpuImage *[1]) { image->image },
+                           (GskGpuSampler[1]) { image->sampler },
+                           &instance);
+
+  gsk_gpu_rect_to_float (image->coverage ? image->coverage : image->bounds, offset, instance->rect);
+  gsk_gpu_rect_to_float (image->bounds, offset, instance->tex_rect);
+  gsk_gpu_color_to_float (color, gsk_gpu_color_states_get_alt (color_states), opacity, instance->color);
+}
@@ -739,6 +739,7 @@ gsk_gpu_frame_submit (GskGpuFrame       *self,
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
 
   gsk_gpu_frame_seal_ops (self);
+  gsk_gpu_upload_ops_rasterize (self, priv->first_op);
   gsk_gpu_frame_verbose_print (self, "start of frame");
   gsk_gpu_frame_sort_ops (self);
   gsk_gpu_frame_verbose_print (self, "after sort");
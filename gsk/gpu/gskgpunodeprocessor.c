@@ -19,6 +19,7 @@
 #include "gskgpuconvertcicpopprivate.h"
 #include "gskgpucrossfadeopprivate.h"
 #include "gskgpudeviceprivate.h"
+#include "gskgpudistancefieldopprivate.h"
 #include "gskgpuframeprivate.h"
 #include "gskgpuglobalsopprivate.h"
 #include "gskgpuimageprivate.h"
@@ -49,6 +50,8 @@
 #include "gdk/gdksubsurfaceprivate.h"
 #include "gdk/gdktextureprivate.h"
 
+#include <pango/pangocairo.h>
+
 /* the epsilon we allow pixels to be off due to rounding errors.
  * Chosen rather randomly.
  */
@@ -64,6 +67,13 @@
  */
 #define MIN_PERCENTAGE_FOR_OCCLUSION_PASS 10
 
+/* the range of font sizes in pixels for which unhinted glyphs are
+ * drawn from distance fields. Smaller glyphs look better as bitmaps,
+ * larger ones would lose their sharp corners.
+ */
+#define MIN_DISTANCE_FIELD_FONT_SIZE 48
+#define MAX_DISTANCE_FIELD_FONT_SIZE 256
+
 /* A note about coordinate systems
  *
  * The rendering code keeps track of multiple coordinate systems to optimize rendering as
@@ -934,6 +944,7 @@ gsk_gpu_node_processor_add_cairo_node (GskGpuNodeProcessor *self,
   image = gsk_gpu_upload_cairo_op (self->frame,
                                    &self->scale,
                                    &clipped_bounds,
+                                   0,
                                    (GskGpuCairoFunc) gsk_render_node_draw_fallback,
                                    gsk_render_node_ref (node),
                                    (GDestroyNotify) gsk_render_node_unref);
@@ -2350,6 +2361,7 @@ gsk_gpu_get_cairo_node_as_image (GskGpuFrame           *frame,
   result = gsk_gpu_upload_cairo_op (frame,
                                     scale,
                                     clip_bounds,
+                                    0,
                                     (GskGpuCairoFunc) gsk_render_node_draw_fallback,
                                     gsk_render_node_ref (node),
                                     (GDestroyNotify) gsk_render_node_unref);
@@ -3060,6 +3072,16 @@ gsk_gpu_node_processor_add_mask_node (GskGpuNodeProcessor *self,
   g_object_unref (mask_image);
 }
 
+static float
+gsk_gpu_font_get_size (PangoFont *font)
+{
+  cairo_matrix_t matrix;
+
+  cairo_scaled_font_get_font_matrix (pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font)), &matrix);
+
+  return sqrt (matrix.xy * matrix.xy + matrix.yy * matrix.yy);
+}
+
 static void
 gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
                                        GskRenderNode       *node)
@@ -3080,6 +3102,8 @@ gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
   GskGpuColorStates color_states;
   GdkColor color2;
   GskGpuShaderClip node_clip;
+  PangoFont *distance_field_font;
+  float distance_field_scale;
 
   if (self->opacity < 1.0 &&
       gsk_text_node_has_color_glyphs (node))
@@ -3123,6 +3147,29 @@ gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
   inv_align_scale_x = 1 / align_scale_x;
   inv_align_scale_y = 1 / align_scale_y;
 
+  /* Unhinted glyphs look the same at every size, so large ones
+   * can be drawn from a distance field that is rendered once at
+   * a fixed size. That way zooming text doesn't need to render
+   * new glyphs for every frame.
+   */
+  distance_field_font = NULL;
+  distance_field_scale = 0;
+  if (hint_style == CAIRO_HINT_STYLE_NONE)
+    {
+      float font_size = gsk_gpu_font_get_size (font);
+
+      if (font_size * scale >= MIN_DISTANCE_FIELD_FONT_SIZE &&
+          font_size * scale <= MAX_DISTANCE_FIELD_FONT_SIZE)
+        {
+          distance_field_scale = GSK_GPU_DISTANCE_FIELD_SIZE / font_size;
+          distance_field_font = gsk_reload_font (font,
+                                                 distance_field_scale,
+                                                 CAIRO_HINT_METRICS_OFF,
+                                                 CAIRO_HINT_STYLE_NONE,
+                                                 CAIRO_ANTIALIAS_GRAY);
+        }
+    }
+
   for (i = 0; i < num_glyphs; i++)
     {
       GskGpuImage *image;
@@ -3130,35 +3177,55 @@ gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
       graphene_point_t glyph_offset, glyph_origin;
       GskGpuGlyphLookupFlags flags;
       GskGpuShaderClip glyph_clip;
+      gboolean distance_field;
+      float glyph_scale;
 
       glyph_origin = GRAPHENE_POINT_INIT (offset.x + glyphs[i].geometry.x_offset * inv_pango_scale,
                                           offset.y + glyphs[i].geometry.y_offset * inv_pango_scale);
 
-      glyph_origin.x = floorf (glyph_origin.x * align_scale_x + 0.5f);
-      glyph_origin.y = floorf (glyph_origin.y * align_scale_y + 0.5f);
-      flags = (((int) glyph_origin.x & 3) | (((int) glyph_origin.y & 3) << 2)) & flags_mask;
-      glyph_origin.x *= inv_align_scale_x;
-      glyph_origin.y *= inv_align_scale_y;
+      distance_field = distance_field_font && !glyphs[i].attr.is_color;
+      if (distance_field)
+        {
+          /* Distance fields can be drawn at any offset */
+          image = gsk_gpu_cache_lookup_glyph_image (cache,
+                                                     self->frame,
+                                                     distance_field_font,
+                                                     glyphs[i].glyph,
+                                                     GSK_GPU_GLYPH_DISTANCE_FIELD,
+                                                     1.0,
+                                                     &glyph_bounds,
+                                                     &glyph_offset);
+          glyph_scale = distance_field_scale;
+        }
+      else
+        {
+          glyph_origin.x = floorf (glyph_origin.x * align_scale_x + 0.5f);
+          glyph_origin.y = floorf (glyph_origin.y * align_scale_y + 0.5f);
+          flags = (((int) glyph_origin.x & 3) | (((int) glyph_origin.y & 3) << 2)) & flags_mask;
+          glyph_origin.x *= inv_align_scale_x;
+          glyph_origin.y *= inv_align_scale_y;
+
+          image = gsk_gpu_cache_lookup_glyph_image (cache,
+                                                     self->frame,
+                                                     font,
+                                                     glyphs[i].glyph,
+                                                     flags,
+                                                     scale,
+                                                     &glyph_bounds,
+                                                     &glyph_offset);
+          glyph_scale = scale;
+        }
 
-      image = gsk_gpu_cache_lookup_glyph_image (cache,
-                                                 self->frame,
-                                                 font,
-                                                 glyphs[i].glyph,
-                                                 flags,
-                                                 scale,
-                                                 &glyph_bounds,
-                                                 &glyph_offset);
-
-      glyph_tex_rect = GRAPHENE_RECT_INIT (-glyph_bounds.origin.x / scale,
-                                           -glyph_bounds.origin.y / scale,
-                                           gsk_gpu_image_get_width (image) / scale,
-                                           gsk_gpu_image_get_height (image) / scale);
+      glyph_tex_rect = GRAPHENE_RECT_INIT (-glyph_bounds.origin.x / glyph_scale,
+                                           -glyph_bounds.origin.y / glyph_scale,
+                                           gsk_gpu_image_get_width (image) / glyph_scale,
+                                           gsk_gpu_image_get_height (image) / glyph_scale);
       glyph_bounds = GRAPHENE_RECT_INIT (0,
                                          0,
-                                         glyph_bounds.size.width / scale,
-                                         glyph_bounds.size.height / scale);
-      glyph_origin = GRAPHENE_POINT_INIT (glyph_origin.x - glyph_offset.x / scale,
-                                          glyph_origin.y - glyph_offset.y / scale);
+                                         glyph_bounds.size.width / glyph_scale,
+                                         glyph_bounds.size.height / glyph_scale);
+      glyph_origin = GRAPHENE_POINT_INIT (glyph_origin.x - glyph_offset.x / glyph_scale,
+                                          glyph_origin.y - glyph_offset.y / glyph_scale);
 
       if (node_clip == GSK_GPU_SHADER_CLIP_NONE)
         glyph_clip = GSK_GPU_SHADER_CLIP_NONE;
@@ -3175,6 +3242,19 @@ gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
                                 &glyph_bounds,
                                 &glyph_tex_rect
                             });
+      else if (distance_field)
+        gsk_gpu_distance_field_op (self->frame,
+                                   glyph_clip,
+                                   color_states,
+                                   self->opacity,
+                                   &glyph_origin,
+                                   &(GskGpuShaderImage) {
+                                       image,
+                                       GSK_GPU_SAMPLER_DEFAULT,
+                                       &glyph_bounds,
+                                       &glyph_tex_rect
+                                   },
+                                   &color2);
       else
         gsk_gpu_colorize_op2 (self->frame,
                               glyph_clip,
@@ -3192,6 +3272,7 @@ gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
       offset.x += glyphs[i].geometry.width * inv_pango_scale;
     }
 
+  g_clear_object (&distance_field_font);
   gdk_color_finish (&color2);
 }
 
@@ -3416,6 +3497,64 @@ gsk_gpu_node_processor_add_repeat_node (GskGpuNodeProcessor *self,
     }
 }
 
+/* Draws a path mask from the cache with the child of a fill or stroke node */
+static void
+gsk_gpu_node_processor_add_cached_path (GskGpuNodeProcessor   *self,
+                                        GskGpuImage           *mask_image,
+                                        const graphene_rect_t *mask_rect,
+                                        const graphene_rect_t *clip_bounds,
+                                        GskRenderNode         *child)
+{
+  GskGpuImage *source_image;
+  graphene_rect_t source_rect;
+
+  if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE)
+    {
+      gsk_gpu_colorize_op (self->frame,
+                           gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, clip_bounds),
+                           self->ccs,
+                           self->opacity,
+                           &self->offset,
+                           &(GskGpuShaderImage) {
+                               mask_image,
+                               GSK_GPU_SAMPLER_DEFAULT,
+                               clip_bounds,
+                               mask_rect,
+                           },
+                           gsk_color_node_get_color2 (child));
+      return;
+    }
+
+  source_image = gsk_gpu_node_processor_get_node_as_image (self,
+                                                           0,
+                                                           clip_bounds,
+                                                           child,
+                                                           &source_rect);
+  if (source_image == NULL)
+    return;
+
+  gsk_gpu_mask_op (self->frame,
+                   gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, clip_bounds),
+                   clip_bounds,
+                   &self->offset,
+                   self->opacity,
+                   GSK_MASK_MODE_ALPHA,
+                   &(GskGpuShaderImage) {
+                       source_image,
+                       GSK_GPU_SAMPLER_DEFAULT,
+                       NULL,
+                       &source_rect,
+                   },
+                   &(GskGpuShaderImage) {
+                       mask_image,
+                       GSK_GPU_SAMPLER_DEFAULT,
+                       NULL,
+                       mask_rect,
+                   });
+
+  g_object_unref (source_image);
+}
+
 typedef struct _FillData FillData;
 struct _FillData
 {
@@ -3461,7 +3600,7 @@ static void
 gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
                                       GskRenderNode       *node)
 {
-  graphene_rect_t clip_bounds, source_rect;
+  graphene_rect_t clip_bounds, source_rect, mask_rect;
   GskGpuImage *mask_image, *source_image;
   GskRenderNode *child;
   GdkColor color;
@@ -3472,6 +3611,21 @@ gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
 
   child = gsk_fill_node_get_child (node);
 
+  mask_image = gsk_gpu_cache_lookup_path_image (gsk_gpu_device_get_cache (gsk_gpu_frame_get_device (self->frame)),
+                                                self->frame,
+                                                gsk_fill_node_get_path (node),
+                                                gsk_fill_node_get_fill_rule (node),
+                                                NULL,
+                                                &self->scale,
+                                                &self->offset,
+                                                &node->bounds,
+                                                &mask_rect);
+  if (mask_image)
+    {
+      gsk_gpu_node_processor_add_cached_path (self, mask_image, &mask_rect, &clip_bounds, child);
+      return;
+    }
+
   if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE)
     gdk_color_init_copy (&color, gsk_color_node_get_color2 (child));
   else
@@ -3480,6 +3634,7 @@ gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
   mask_image = gsk_gpu_upload_cairo_op (self->frame,
                                         &self->scale,
                                         &clip_bounds,
+                                        GSK_GPU_CAIRO_THREADSAFE,
                                         gsk_gpu_node_processor_fill_path,
                                         g_memdup2 (&(FillData) {
                                             .path = gsk_path_ref (gsk_fill_node_get_path (node)),
@@ -3564,7 +3719,7 @@ static void
 gsk_gpu_node_processor_add_stroke_node (GskGpuNodeProcessor *self,
                                         GskRenderNode       *node)
 {
-  graphene_rect_t clip_bounds, source_rect;
+  graphene_rect_t clip_bounds, source_rect, mask_rect;
   GskGpuImage *mask_image, *source_image;
   GskRenderNode *child;
   GdkColor color;
@@ -3575,6 +3730,21 @@ gsk_gpu_node_processor_add_stroke_node (GskGpuNodeProcessor *self,
 
   child = gsk_stroke_node_get_child (node);
 
+  mask_image = gsk_gpu_cache_lookup_path_image (gsk_gpu_device_get_cache (gsk_gpu_frame_get_device (self->frame)),
+                                                self->frame,
+                                                gsk_stroke_node_get_path (node),
+                                                GSK_FILL_RULE_WINDING,
+                                                gsk_stroke_node_get_stroke (node),
+                                                &self->scale,
+                                                &self->offset,
+                                                &node->bounds,
+                                                &mask_rect);
+  if (mask_image)
+    {
+      gsk_gpu_node_processor_add_cached_path (self, mask_image, &mask_rect, &clip_bounds, child);
+      return;
+    }
+
   if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE)
     gdk_color_init_copy (&color, gsk_color_node_get_color2 (child));
   else
@@ -3583,6 +3753,7 @@ gsk_gpu_node_processor_add_stroke_node (GskGpuNodeProcessor *self,
   mask_image = gsk_gpu_upload_cairo_op (self->frame,
                                         &self->scale,
                                         &clip_bounds,
+                                        GSK_GPU_CAIRO_THREADSAFE,
                                         gsk_gpu_node_processor_stroke_path,
                                         g_memdup2 (&(StrokeData) {
                                             .path = gsk_path_ref (gsk_stroke_node_get_path (node)),
@@ -3745,6 +3916,109 @@ gsk_gpu_get_subsurface_node_as_image (GskGpuFrame           *frame,
                                     out_bounds);
 }
 
+/* Renderings of cacheable nodes that are much larger than what is
+ * visible only cover the visible part and some area around it */
+#define CACHED_NODE_MAX_AREA 4
+
+static gboolean
+gsk_gpu_node_processor_rect_is_on_grid (GskGpuNodeProcessor   *self,
+                                        const graphene_rect_t *rect)
+{
+  float x, y;
+
+  x = (rect->origin.x + self->offset.x) * graphene_vec2_get_x (&self->scale);
+  y = (rect->origin.y + self->offset.y) * graphene_vec2_get_y (&self->scale);
+
+  return fabsf (x - roundf (x)) < EPSILON &&
+         fabsf (y - roundf (y)) < EPSILON;
+}
+
+/* Draws a cacheable container from an offscreen kept in the cache,
+ * rendering it first if necessary.
+ * Returns FALSE if the node should be drawn normally, because it has
+ * not been drawn before or is too large to be cached.
+ */
+static gboolean
+gsk_gpu_node_processor_add_cached_node (GskGpuNodeProcessor *self,
+                                        GskRenderNode       *node)
+{
+  GskGpuDevice *device;
+  GskGpuCache *cache;
+  GskGpuImage *image;
+  graphene_rect_t clip, visible, rect;
+  gsize max_size;
+
+  device = gsk_gpu_frame_get_device (self->frame);
+  cache = gsk_gpu_device_get_cache (device);
+
+  gsk_gpu_node_processor_get_clip_bounds (self, &clip);
+  if (!gsk_rect_intersection (&clip, &node->bounds, &visible))
+    return TRUE;
+  gsk_rect_snap_to_grid (&visible, &self->scale, &self->offset, &visible);
+
+  image = gsk_gpu_cache_lookup_node_image (cache, node, &self->scale, self->ccs, &visible, &rect);
+  if (image != NULL &&
+      !gsk_gpu_node_processor_rect_is_on_grid (self, &rect))
+    g_clear_object (&image);
+
+  if (image == NULL)
+    {
+      /* Nodes that are only drawn once, because they change every
+       * frame, aren't worth an offscreen */
+      if (!gsk_container_node_mark_drawn (node))
+        return FALSE;
+
+      /* Render the whole node if it isn't much larger than what
+       * is visible, so the image can be reused when other parts
+       * of it become visible */
+      if (node->bounds.size.width * node->bounds.size.height >
+          CACHED_NODE_MAX_AREA * clip.size.width * clip.size.height)
+        {
+          graphene_rect_t around;
+
+          graphene_rect_inset_r (&clip,
+                                 - clip.size.width / 2,
+                                 - clip.size.height / 2,
+                                 &around);
+          if (!gsk_rect_intersection (&around, &node->bounds, &rect))
+            return FALSE;
+        }
+      else
+        {
+          rect = node->bounds;
+        }
+      gsk_rect_snap_to_grid (&rect, &self->scale, &self->offset, &rect);
+
+      max_size = gsk_gpu_device_get_max_image_size (device);
+      if (ceilf (graphene_vec2_get_x (&self->scale) * rect.size.width - EPSILON) > max_size ||
+          ceilf (graphene_vec2_get_y (&self->scale) * rect.size.height - EPSILON) > max_size)
+        return FALSE;
+
+      /* Cacheable containers have a single child */
+      image = gsk_gpu_node_processor_create_offscreen (self->frame,
+                                                       self->ccs,
+                                                       &self->scale,
+                                                       &rect,
+                                                       gsk_container_node_get_child (node, 0));
+      if (image == NULL)
+        return FALSE;
+
+      gsk_gpu_cache_cache_node_image (cache, node, &self->scale, self->ccs, &rect, image);
+    }
+
+  gsk_gpu_node_processor_sync_globals (self, 0);
+  gsk_gpu_node_processor_image_op (self,
+                                   image,
+                                   self->ccs,
+                                   GSK_GPU_SAMPLER_DEFAULT,
+                                   &rect,
+                                   &rect);
+
+  g_object_unref (image);
+
+  return TRUE;
+}
+
 static void
 gsk_gpu_node_processor_add_container_node (GskGpuNodeProcessor *self,
                                            GskRenderNode       *node)
@@ -3752,6 +4026,10 @@ gsk_gpu_node_processor_add_container_node (GskGpuNodeProcessor *self,
   GskRenderNode **children;
   guint n_children;
 
+  if (gsk_container_node_is_cacheable (node) &&
+      gsk_gpu_node_processor_add_cached_node (self, node))
+    return;
+
   if (self->opacity < 1.0 && !gsk_container_node_is_disjoint (node))
     {
       gsk_gpu_node_processor_add_without_opacity (self, node);
@@ -3773,6 +4051,10 @@ gsk_gpu_node_processor_add_first_container_node (GskGpuNodeProcessor *self,
   int i;
   guint n;
 
+  /* Let add_container_node() use the cache */
+  if (gsk_container_node_is_cacheable (node))
+    return FALSE;
+
   children = gsk_container_node_get_children (node, &n);
   if (n == 0)
     return FALSE;
@@ -3,6 +3,7 @@
 #include "gskgpurendererprivate.h"
 
 #include "gskdebugprivate.h"
+#include "gskgpucacheprivate.h"
 #include "gskgpudeviceprivate.h"
 #include "gskgpuframeprivate.h"
 #include "gskprivate.h"
@@ -44,6 +45,9 @@ struct _GskGpuRendererPrivate
   GskGpuOptimizations optimizations;
 
   GskGpuFrame *frames[GSK_GPU_MAX_FRAMES];
+
+  GQuark glyph_cache_hits;
+  GQuark glyph_cache_misses;
 };
 
 static void     gsk_gpu_renderer_dmabuf_downloader_init         (GdkDmabufDownloaderInterface   *iface);
@@ -207,6 +211,19 @@ get_render_region (GskGpuRenderer *self)
   return scaled_damage;
 }
 
+static void
+gsk_gpu_renderer_update_profiler (GskGpuRenderer *self)
+{
+  GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
+  GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
+  gsize hits, misses;
+
+  gsk_gpu_cache_take_disk_cache_stats (gsk_gpu_device_get_cache (priv->device), &hits, &misses);
+
+  gsk_profiler_counter_add (profiler, priv->glyph_cache_hits, hits);
+  gsk_profiler_counter_add (profiler, priv->glyph_cache_misses, misses);
+}
+
 static gboolean
 gsk_gpu_renderer_realize (GskRenderer  *renderer,
                           GdkDisplay   *display,
@@ -412,6 +429,8 @@ gsk_gpu_renderer_render_texture (GskRenderer           *renderer,
   gsk_gpu_frame_wait (frame);
   g_object_unref (image);
 
+  gsk_gpu_renderer_update_profiler (self);
+
   gsk_gpu_device_queue_gc (priv->device);
 
   /* check that callback setting texture was actually called, as its technically async */
@@ -474,6 +493,8 @@ gsk_gpu_renderer_render (GskRenderer          *renderer,
 
   gsk_gpu_frame_end (frame, priv->context);
 
+  gsk_gpu_renderer_update_profiler (self);
+
   gsk_gpu_device_queue_gc (priv->device);
 }
 
@@ -516,7 +537,12 @@ gsk_gpu_renderer_init (GskGpuRenderer *self)
 {
   GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
 
+  GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
+
   priv->optimizations = GSK_GPU_RENDERER_GET_CLASS (self)->optimizations;
+
+  priv->glyph_cache_hits = gsk_profiler_add_counter (profiler, "glyph-cache-hits", "Glyphs loaded from the disk cache", TRUE);
+  priv->glyph_cache_misses = gsk_profiler_add_counter (profiler, "glyph-cache-misses", "Glyphs missing from the disk cache", TRUE);
 }
 
 GdkDrawContext *
@@ -10,6 +10,7 @@ typedef struct _GskGpuCache             GskGpuCache;
 typedef struct _GskGpuClip              GskGpuClip;
 typedef guint32                         GskGpuColorStates;
 typedef struct _GskGpuDevice            GskGpuDevice;
+typedef struct _GskGpuDiskCache         GskGpuDiskCache;
 typedef struct _GskGpuFrame             GskGpuFrame;
 typedef struct _GskGpuGlobalsInstance   GskGpuGlobalsInstance;
 typedef struct _GskGpuImage             GskGpuImage;
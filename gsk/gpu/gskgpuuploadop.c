@@ -2,6 +2,7 @@
 
 #include "gskgpuuploadopprivate.h"
 
+#include "gskgpudiskcacheprivate.h"
 #include "gskgpuframeprivate.h"
 #include "gskgpuimageprivate.h"
 #include "gskgpuprintprivate.h"
@@ -14,14 +15,42 @@
 
 #include "gdk/gdkcolorstateprivate.h"
 #include "gdk/gdkglcontextprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 #include "gsk/gskdebugprivate.h"
 
+#include <pango/pangocairo.h>
+#include <math.h>
+
+/* Ops that draw with cairo can be rasterized before the commands
+ * are recorded, see gsk_gpu_upload_ops_rasterize(). They then
+ * keep the staging memory they were drawn to until the command
+ * uploads it.
+ */
+typedef struct _GskGpuUploadStaging GskGpuUploadStaging;
+
+struct _GskGpuUploadStaging
+{
+  guchar *data;
+  gsize stride;
+  gboolean owns_data;
+};
+
+static void
+gsk_gpu_upload_staging_clear (GskGpuUploadStaging *staging)
+{
+  if (staging->owns_data)
+    g_free (staging->data);
+  staging->data = NULL;
+  staging->owns_data = FALSE;
+}
+
 static GskGpuOp *
 gsk_gpu_upload_op_gl_command_with_area (GskGpuOp                    *op,
                                         GskGpuFrame                 *frame,
                                         GskGpuImage                 *image,
                                         const cairo_rectangle_int_t *area,
-                                        void           (* draw_func) (GskGpuOp *, guchar *, gsize))
+                                        void           (* draw_func) (GskGpuOp *, guchar *, gsize),
+                                        GskGpuUploadStaging         *staging)
 {
   GskGLImage *gl_image = GSK_GL_IMAGE (image);
   GdkMemoryFormat format;
@@ -31,10 +60,19 @@ gsk_gpu_upload_op_gl_command_with_area (GskGpuOp                    *op,
 
   format = gsk_gpu_image_get_format (image);
   bpp = gdk_memory_format_bytes_per_pixel (format);
-  stride = area->width * bpp;
-  data = g_malloc (area->height * stride);
 
-  draw_func (op, data, stride);
+  if (staging && staging->data)
+    {
+      stride = staging->stride;
+      data = staging->data;
+    }
+  else
+    {
+      stride = area->width * bpp;
+      data = g_malloc (area->height * stride);
+
+      draw_func (op, data, stride);
+    }
 
   gl_format = gsk_gl_image_get_gl_format (gl_image);
   gl_type = gsk_gl_image_get_gl_type (gl_image);
@@ -68,16 +106,20 @@ gsk_gpu_upload_op_gl_command_with_area (GskGpuOp                    *op,
 
   glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
 
-  g_free (data);
+  if (staging && staging->data)
+    gsk_gpu_upload_staging_clear (staging);
+  else
+    g_free (data);
 
   return op->next;
 }
 
 static GskGpuOp *
-gsk_gpu_upload_op_gl_command (GskGpuOp          *op,
-                              GskGpuFrame       *frame,
-                              GskGpuImage       *image,
-                              void (* draw_func) (GskGpuOp *, guchar *, gsize))
+gsk_gpu_upload_op_gl_command (GskGpuOp            *op,
+                              GskGpuFrame         *frame,
+                              GskGpuImage         *image,
+                              void (* draw_func) (GskGpuOp *, guchar *, gsize),
+                              GskGpuUploadStaging *staging)
 {
   return gsk_gpu_upload_op_gl_command_with_area (op,
                                                  frame,
@@ -87,7 +129,8 @@ gsk_gpu_upload_op_gl_command (GskGpuOp          *op,
                                                      gsk_gpu_image_get_width (image),
                                                      gsk_gpu_image_get_height (image)
                                                  },
-                                                 draw_func);
+                                                 draw_func,
+                                                 staging);
 }
 
 #ifdef GDK_RENDERING_VULKAN
@@ -98,17 +141,27 @@ gsk_gpu_upload_op_vk_command_with_area (GskGpuOp                    *op,
                                         GskVulkanImage              *image,
                                         const cairo_rectangle_int_t *area,
                                         void           (* draw_func) (GskGpuOp *, guchar *, gsize),
+                                        GskGpuUploadStaging         *staging,
                                         GskGpuBuffer               **buffer)
 {
   gsize stride;
   guchar *data;
 
-  stride = area->width * gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (GSK_GPU_IMAGE (image)));
-  *buffer = gsk_vulkan_buffer_new_write (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
-                                         area->height * stride);
-  data = gsk_gpu_buffer_map (*buffer);
+  if (staging && staging->data)
+    {
+      /* Already drawn into the mapped buffer */
+      stride = staging->stride;
+      gsk_gpu_upload_staging_clear (staging);
+    }
+  else
+    {
+      stride = area->width * gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (GSK_GPU_IMAGE (image)));
+      *buffer = gsk_vulkan_buffer_new_write (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
+                                             area->height * stride);
+      data = gsk_gpu_buffer_map (*buffer);
 
-  draw_func (op, data, stride);
+      draw_func (op, data, stride);
+    }
 
   gsk_gpu_buffer_unmap (*buffer, area->height * stride);
 
@@ -173,11 +226,19 @@ gsk_gpu_upload_op_vk_command (GskGpuOp              *op,
                               GskVulkanCommandState *state,
                               GskVulkanImage        *image,
                               void                 (* draw_func) (GskGpuOp *, guchar *, gsize),
+                              GskGpuUploadStaging   *staging,
                               GskGpuBuffer         **buffer)
 {
   gsize stride;
   guchar *data;
 
+  /* Already drawn into the mapped image */
+  if (staging && staging->data && *buffer == NULL)
+    {
+      gsk_gpu_upload_staging_clear (staging);
+      return op->next;
+    }
+
   data = gsk_vulkan_image_get_data (image, &stride);
   if (data)
     {
@@ -198,6 +259,7 @@ gsk_gpu_upload_op_vk_command (GskGpuOp              *op,
                                                      gsk_gpu_image_get_height (GSK_GPU_IMAGE (image)),
                                                  },
                                                  draw_func,
+                                                 staging,
                                                  buffer);
 
 }
@@ -293,6 +355,7 @@ gsk_gpu_upload_texture_op_vk_command (GskGpuOp              *op,
                                        state,
                                        GSK_VULKAN_IMAGE (self->image),
                                        gsk_gpu_upload_texture_op_draw,
+                                       NULL,
                                        &self->buffer);
 }
 #endif
@@ -307,7 +370,8 @@ gsk_gpu_upload_texture_op_gl_command (GskGpuOp          *op,
   return gsk_gpu_upload_op_gl_command (op,
                                        frame,
                                        self->image,
-                                       gsk_gpu_upload_texture_op_draw);
+                                       gsk_gpu_upload_texture_op_draw,
+                                       NULL);
 }
 
 static const GskGpuOpClass GSK_GPU_UPLOAD_TEXTURE_OP_CLASS = {
@@ -386,10 +450,12 @@ struct _GskGpuUploadCairoOp
 
   GskGpuImage *image;
   graphene_rect_t viewport;
+  GskGpuCairoFlags flags;
   GskGpuCairoFunc func;
   gpointer user_data;
   GDestroyNotify user_destroy;
 
+  GskGpuUploadStaging staging;
   GskGpuBuffer *buffer;
 };
 
@@ -401,6 +467,7 @@ gsk_gpu_upload_cairo_op_finish (GskGpuOp *op)
   g_object_unref (self->image);
   if (self->user_destroy)
     self->user_destroy (self->user_data);
+  gsk_gpu_upload_staging_clear (&self->staging);
   g_clear_object (&self->buffer);
 }
 
@@ -464,6 +531,7 @@ gsk_gpu_upload_cairo_op_vk_command (GskGpuOp              *op,
                                        state,
                                        GSK_VULKAN_IMAGE (self->image),
                                        gsk_gpu_upload_cairo_op_draw,
+                                       &self->staging,
                                        &self->buffer);
 }
 #endif
@@ -478,7 +546,8 @@ gsk_gpu_upload_cairo_op_gl_command (GskGpuOp          *op,
   return gsk_gpu_upload_op_gl_command (op,
                                        frame,
                                        self->image,
-                                       gsk_gpu_upload_cairo_op_draw);
+                                       gsk_gpu_upload_cairo_op_draw,
+                                       &self->staging);
 }
 
 static const GskGpuOpClass GSK_GPU_UPLOAD_CAIRO_OP_CLASS = {
@@ -496,6 +565,7 @@ GskGpuImage *
 gsk_gpu_upload_cairo_op (GskGpuFrame           *frame,
                          const graphene_vec2_t *scale,
                          const graphene_rect_t *viewport,
+                         GskGpuCairoFlags       flags,
                          GskGpuCairoFunc        func,
                          gpointer               user_data,
                          GDestroyNotify         user_destroy)
@@ -511,6 +581,7 @@ gsk_gpu_upload_cairo_op (GskGpuFrame           *frame,
                                                     ceil (graphene_vec2_get_x (scale) * viewport->size.width),
                                                     ceil (graphene_vec2_get_y (scale) * viewport->size.height));
   self->viewport = *viewport;
+  self->flags = flags;
   self->func = func;
   self->user_data = user_data;
   self->user_destroy = user_destroy;
@@ -518,6 +589,169 @@ gsk_gpu_upload_cairo_op (GskGpuFrame           *frame,
   return self->image;
 }
 
+typedef struct _GskGpuUploadCairoIntoOp GskGpuUploadCairoIntoOp;
+
+struct _GskGpuUploadCairoIntoOp
+{
+  GskGpuOp op;
+
+  GskGpuImage *image;
+  cairo_rectangle_int_t area;
+  graphene_vec2_t scale;
+  graphene_point_t origin;
+  GskGpuCairoFlags flags;
+  GskGpuCairoFunc func;
+  gpointer user_data;
+  GDestroyNotify user_destroy;
+
+  GskGpuUploadStaging staging;
+  GskGpuBuffer *buffer;
+};
+
+static void
+gsk_gpu_upload_cairo_into_op_finish (GskGpuOp *op)
+{
+  GskGpuUploadCairoIntoOp *self = (GskGpuUploadCairoIntoOp *) op;
+
+  g_object_unref (self->image);
+  if (self->user_destroy)
+    self->user_destroy (self->user_data);
+  gsk_gpu_upload_staging_clear (&self->staging);
+  g_clear_object (&self->buffer);
+}
+
+static void
+gsk_gpu_upload_cairo_into_op_print (GskGpuOp    *op,
+                                    GskGpuFrame *frame,
+                                    GString     *string,
+                                    guint        indent)
+{
+  GskGpuUploadCairoIntoOp *self = (GskGpuUploadCairoIntoOp *) op;
+
+  gsk_gpu_print_op (string, indent, "upload-cairo-into");
+  gsk_gpu_print_image (string, self->image);
+  gsk_gpu_print_int_rect (string, &self->area);
+  gsk_gpu_print_newline (string);
+}
+
+static void
+gsk_gpu_upload_cairo_into_op_draw (GskGpuOp *op,
+                                   guchar   *data,
+                                   gsize     stride)
+{
+  GskGpuUploadCairoIntoOp *self = (GskGpuUploadCairoIntoOp *) op;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create_for_data (data,
+                                                 CAIRO_FORMAT_ARGB32,
+                                                 self->area.width,
+                                                 self->area.height,
+                                                 stride);
+  cairo_surface_set_device_scale (surface,
+                                  graphene_vec2_get_x (&self->scale),
+                                  graphene_vec2_get_y (&self->scale));
+  cairo_surface_set_device_offset (surface, self->origin.x, self->origin.y);
+
+  cr = cairo_create (surface);
+  cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+  self->func (self->user_data, cr);
+
+  cairo_destroy (cr);
+
+  cairo_surface_finish (surface);
+  cairo_surface_destroy (surface);
+}
+
+#ifdef GDK_RENDERING_VULKAN
+static GskGpuOp *
+gsk_gpu_upload_cairo_into_op_vk_command (GskGpuOp              *op,
+                                         GskGpuFrame           *frame,
+                                         GskVulkanCommandState *state)
+{
+  GskGpuUploadCairoIntoOp *self = (GskGpuUploadCairoIntoOp *) op;
+
+  return gsk_gpu_upload_op_vk_command_with_area (op,
+                                                 frame,
+                                                 state,
+                                                 GSK_VULKAN_IMAGE (self->image),
+                                                 &self->area,
+                                                 gsk_gpu_upload_cairo_into_op_draw,
+                                                 &self->staging,
+                                                 &self->buffer);
+}
+#endif
+
+static GskGpuOp *
+gsk_gpu_upload_cairo_into_op_gl_command (GskGpuOp          *op,
+                                         GskGpuFrame       *frame,
+                                         GskGLCommandState *state)
+{
+  GskGpuUploadCairoIntoOp *self = (GskGpuUploadCairoIntoOp *) op;
+
+  return gsk_gpu_upload_op_gl_command_with_area (op,
+                                                 frame,
+                                                 self->image,
+                                                 &self->area,
+                                                 gsk_gpu_upload_cairo_into_op_draw,
+                                                 &self->staging);
+}
+
+static const GskGpuOpClass GSK_GPU_UPLOAD_CAIRO_INTO_OP_CLASS = {
+  GSK_GPU_OP_SIZE (GskGpuUploadCairoIntoOp),
+  GSK_GPU_STAGE_UPLOAD,
+  gsk_gpu_upload_cairo_into_op_finish,
+  gsk_gpu_upload_cairo_into_op_print,
+#ifdef GDK_RENDERING_VULKAN
+  gsk_gpu_upload_cairo_into_op_vk_command,
+#endif
+  gsk_gpu_upload_cairo_into_op_gl_command
+};
+
+/*
+ * gsk_gpu_upload_cairo_into_op:
+ * @frame: the frame
+ * @image: the image to draw to
+ * @area: the area of the image to draw to
+ * @scale: the device scale to draw with
+ * @origin: the position of the origin relative to @area in pixels
+ * @flags: flags for @func
+ * @func: the function to draw with
+ * @user_data: data for @func
+ * @user_destroy: (nullable): called to free @user_data
+ *
+ * Clears @area of @image and draws into it with cairo, like
+ * gsk_gpu_upload_cairo_op() does for a new image. This is used to
+ * draw into atlases.
+ */
+void
+gsk_gpu_upload_cairo_into_op (GskGpuFrame                 *frame,
+                              GskGpuImage                 *image,
+                              const cairo_rectangle_int_t *area,
+                              const graphene_vec2_t       *scale,
+                              const graphene_point_t      *origin,
+                              GskGpuCairoFlags             flags,
+                              GskGpuCairoFunc              func,
+                              gpointer                     user_data,
+                              GDestroyNotify               user_destroy)
+{
+  GskGpuUploadCairoIntoOp *self;
+
+  self = (GskGpuUploadCairoIntoOp *) gsk_gpu_op_alloc (frame, &GSK_GPU_UPLOAD_CAIRO_INTO_OP_CLASS);
+
+  self->image = g_object_ref (image);
+  self->area = *area;
+  self->scale = *scale;
+  self->origin = *origin;
+  self->flags = flags;
+  self->func = func;
+  self->user_data = user_data;
+  self->user_destroy = user_destroy;
+}
+
 typedef struct _GskGpuUploadGlyphOp GskGpuUploadGlyphOp;
 
 struct _GskGpuUploadGlyphOp
@@ -529,7 +763,14 @@ struct _GskGpuUploadGlyphOp
   PangoFont *font;
   PangoGlyph glyph;
   graphene_point_t origin;
+  guint spread;
+  GskGpuDiskCache *disk_cache;
+  GBytes *disk_key;
 
+  /* Set when drawing in a thread, where we must not use pango */
+  cairo_scaled_font_t *scaled_font;
+
+  GskGpuUploadStaging staging;
   GskGpuBuffer *buffer;
 };
 
@@ -540,7 +781,10 @@ gsk_gpu_upload_glyph_op_finish (GskGpuOp *op)
 
   g_object_unref (self->image);
   g_object_unref (self->font);
+  g_clear_pointer (&self->scaled_font, cairo_scaled_font_destroy);
+  g_clear_pointer (&self->disk_key, g_bytes_unref);
 
+  gsk_gpu_upload_staging_clear (&self->staging);
   g_clear_object (&self->buffer);
 }
 
@@ -560,12 +804,164 @@ gsk_gpu_upload_glyph_op_print (GskGpuOp    *op,
   gsk_gpu_print_op (string, indent, "upload-glyph");
   gsk_gpu_print_int_rect (string, &self->area);
   g_string_append_printf (string, "glyph %u font %s ", self->glyph, str);
+  if (self->spread)
+    g_string_append_printf (string, "spread %u ", self->spread);
   gsk_gpu_print_newline (string);
 
   g_free (str);
   pango_font_description_free (desc);
 }
 
+#define DISTANCE_FIELD_INF 1e20f
+
+/* Felzenszwalb & Huttenlocher's squared distance transform of one
+ * row or column, in place. @f, @v and @z are scratch space for
+ * @length, @length and @length + 1 items.
+ */
+static void
+distance_transform_1d (float *grid,
+                       gsize  offset,
+                       gsize  stride,
+                       gsize  length,
+                       float *f,
+                       gsize *v,
+                       float *z)
+{
+  gsize q, k, r;
+  float s;
+
+  v[0] = 0;
+  z[0] = -DISTANCE_FIELD_INF;
+  z[1] = DISTANCE_FIELD_INF;
+  f[0] = grid[offset];
+
+  for (q = 1, k = 0; q < length; q++)
+    {
+      f[q] = grid[offset + q * stride];
+
+      while (TRUE)
+        {
+          r = v[k];
+          s = (f[q] - f[r] + (float) q * q - (float) r * r) / (q - r) / 2;
+          /* z[0] is -inf, so this stops at k == 0 */
+          if (s > z[k])
+            break;
+          k--;
+        }
+
+      k++;
+      v[k] = q;
+      z[k] = s;
+      z[k + 1] = DISTANCE_FIELD_INF;
+    }
+
+  for (q = 0, k = 0; q < length; q++)
+    {
+      while (z[k + 1] < q)
+        k++;
+      r = v[k];
+      grid[offset + q * stride] = f[r] + ((float) q - r) * ((float) q - r);
+    }
+}
+
+static void
+distance_transform_2d (float *grid,
+                       gsize  width,
+                       gsize  height,
+                       float *f,
+                       gsize *v,
+                       float *z)
+{
+  gsize x, y;
+
+  for (x = 0; x < width; x++)
+    distance_transform_1d (grid, x, width, height, f, v, z);
+
+  for (y = 0; y < height; y++)
+    distance_transform_1d (grid, y * width, 1, width, f, v, z);
+}
+
+/*
+ * gsk_gpu_make_distance_field:
+ * @data: cairo ARGB32 data of a rendered glyph
+ * @stride: the stride of @data
+ * @width: the width in pixels
+ * @height: the height in pixels
+ * @spread: the largest distance in pixels that is represented
+ *
+ * Replaces the rendered glyph with a signed distance field, using
+ * the coverage of antialiased pixels to place the outline between
+ * pixels. The distance is mapped from [spread, -spread] to [0, 1]
+ * and stored in all channels, so the outline is at 0.5.
+ */
+void
+gsk_gpu_make_distance_field (guchar *data,
+                             gsize   stride,
+                             gsize   width,
+                             gsize   height,
+                             guint   spread)
+{
+  float *outer, *inner, *f, *z;
+  gsize *v;
+  gsize x, y, n;
+
+  n = MAX (width, height);
+  outer = g_new (float, width * height);
+  inner = g_new (float, width * height);
+  f = g_new (float, n);
+  z = g_new (float, n + 1);
+  v = g_new (gsize, n);
+
+  for (y = 0; y < height; y++)
+    {
+      guint32 *row = (guint32 *) (data + y * stride);
+
+      for (x = 0; x < width; x++)
+        {
+          float a = (row[x] >> 24) / 255.f;
+          float d = 0.5f - a;
+
+          if (a == 0)
+            {
+              outer[y * width + x] = DISTANCE_FIELD_INF;
+              inner[y * width + x] = 0;
+            }
+          else if (a == 1)
+            {
+              outer[y * width + x] = 0;
+              inner[y * width + x] = DISTANCE_FIELD_INF;
+            }
+          else
+            {
+              outer[y * width + x] = d > 0 ? d * d : 0;
+              inner[y * width + x] = d < 0 ? d * d : 0;
+            }
+        }
+    }
+
+  distance_transform_2d (outer, width, height, f, v, z);
+  distance_transform_2d (inner, width, height, f, v, z);
+
+  for (y = 0; y < height; y++)
+    {
+      guint32 *row = (guint32 *) (data + y * stride);
+
+      for (x = 0; x < width; x++)
+        {
+          float d = sqrtf (outer[y * width + x]) - sqrtf (inner[y * width + x]);
+          guint32 value = CLAMP (255.f * (0.5f - d / (2 * spread)) + 0.5f, 0.f, 255.f);
+
+          row[x] = value * 0x01010101;
+        }
+    }
+
+  g_free (outer);
+  g_free (inner);
+  g_free (f);
+  g_free (z);
+  g_free (v);
+}
+
 static void
 gsk_gpu_upload_glyph_op_draw (GskGpuOp *op,
                               guchar   *data,
@@ -596,26 +992,45 @@ gsk_gpu_upload_glyph_op_draw (GskGpuOp *op,
   /* Draw glyph */
   cairo_set_source_rgba (cr, 1, 1, 1, 1);
 
-  /* The pango code for drawing hex boxes uses the glyph width */
-  if (self->glyph & PANGO_GLYPH_UNKNOWN_FLAG)
-    pango_font_get_glyph_extents (self->font, self->glyph, &ink_rect, NULL);
-
-  pango_cairo_show_glyph_string (cr,
-                                 self->font,
-                                 &(PangoGlyphString) {
-                                     .num_glyphs = 1,
-                                     .glyphs = (PangoGlyphInfo[1]) { {
-                                         .glyph = self->glyph,
-                                         .geometry = {
-                                           .width = ink_rect.width,
-                                         }
-                                     } }
-                                 });
+  if (self->scaled_font)
+    {
+      /* This is what pango does for a regular glyph */
+      cairo_set_scaled_font (cr, self->scaled_font);
+      cairo_show_glyphs (cr, &(cairo_glyph_t) { self->glyph, 0, 0 }, 1);
+    }
+  else
+    {
+      /* The pango code for drawing hex boxes uses the glyph width */
+      if (self->glyph & PANGO_GLYPH_UNKNOWN_FLAG)
+        pango_font_get_glyph_extents (self->font, self->glyph, &ink_rect, NULL);
+
+      pango_cairo_show_glyph_string (cr,
+                                     self->font,
+                                     &(PangoGlyphString) {
+                                         .num_glyphs = 1,
+                                         .glyphs = (PangoGlyphInfo[1]) { {
+                                             .glyph = self->glyph,
+                                             .geometry = {
+                                               .width = ink_rect.width,
+                                             }
+                                         } }
+                                     });
+    }
 
   cairo_destroy (cr);
 
   cairo_surface_finish (surface);
   cairo_surface_destroy (surface);
+
+  if (self->spread)
+    gsk_gpu_make_distance_field (data, stride, self->area.width, self->area.height, self->spread);
+
+  if (self->disk_cache)
+    gsk_gpu_disk_cache_add (self->disk_cache,
+                            self->disk_key,
+                            self->area.width, self->area.height,
+                            &self->origin,
+                            data, stride);
 }
 
 #ifdef GDK_RENDERING_VULKAN
@@ -632,6 +1047,7 @@ gsk_gpu_upload_glyph_op_vk_command (GskGpuOp              *op,
                                                  GSK_VULKAN_IMAGE (self->image),
                                                  &self->area,
                                                  gsk_gpu_upload_glyph_op_draw,
+                                                 &self->staging,
                                                  &self->buffer);
 }
 #endif
@@ -647,7 +1063,8 @@ gsk_gpu_upload_glyph_op_gl_command (GskGpuOp          *op,
                                                  frame,
                                                  self->image,
                                                  &self->area,
-                                                 gsk_gpu_upload_glyph_op_draw);
+                                                 gsk_gpu_upload_glyph_op_draw,
+                                                 &self->staging);
 }
 
 static const GskGpuOpClass GSK_GPU_UPLOAD_GLYPH_OP_CLASS = {
@@ -667,7 +1084,10 @@ gsk_gpu_upload_glyph_op (GskGpuFrame                 *frame,
                          PangoFont                   *font,
                          PangoGlyph                   glyph,
                          const cairo_rectangle_int_t *area,
-                         const graphene_point_t      *origin)
+                         const graphene_point_t      *origin,
+                         guint                        spread,
+                         GskGpuDiskCache             *disk_cache,
+                         GBytes                      *disk_key)
 {
   GskGpuUploadGlyphOp *self;
 
@@ -678,4 +1098,300 @@ gsk_gpu_upload_glyph_op (GskGpuFrame                 *frame,
   self->font = g_object_ref (font);
   self->glyph = glyph;
   self->origin = *origin;
+  self->spread = spread;
+  self->disk_cache = disk_cache;
+  if (disk_cache)
+    self->disk_key = g_bytes_ref (disk_key);
+}
+
+typedef struct _GskGpuUploadBytesOp GskGpuUploadBytesOp;
+
+struct _GskGpuUploadBytesOp
+{
+  GskGpuOp op;
+
+  GskGpuImage *image;
+  cairo_rectangle_int_t area;
+  GBytes *bytes;
+  gsize stride;
+
+  GskGpuBuffer *buffer;
+};
+
+static void
+gsk_gpu_upload_bytes_op_finish (GskGpuOp *op)
+{
+  GskGpuUploadBytesOp *self = (GskGpuUploadBytesOp *) op;
+
+  g_object_unref (self->image);
+  g_bytes_unref (self->bytes);
+
+  g_clear_object (&self->buffer);
+}
+
+static void
+gsk_gpu_upload_bytes_op_print (GskGpuOp    *op,
+                               GskGpuFrame *frame,
+                               GString     *string,
+                               guint        indent)
+{
+  GskGpuUploadBytesOp *self = (GskGpuUploadBytesOp *) op;
+
+  gsk_gpu_print_op (string, indent, "upload-bytes");
+  gsk_gpu_print_int_rect (string, &self->area);
+  gsk_gpu_print_newline (string);
+}
+
+static void
+gsk_gpu_upload_bytes_op_draw (GskGpuOp *op,
+                              guchar   *data,
+                              gsize     stride)
+{
+  GskGpuUploadBytesOp *self = (GskGpuUploadBytesOp *) op;
+  const guchar *src;
+  gsize y, bpp;
+
+  src = g_bytes_get_data (self->bytes, NULL);
+  bpp = gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (self->image));
+
+  for (y = 0; y < self->area.height; y++)
+    memcpy (data + y * stride, src + y * self->stride, self->area.width * bpp);
+}
+
+#ifdef GDK_RENDERING_VULKAN
+static GskGpuOp *
+gsk_gpu_upload_bytes_op_vk_command (GskGpuOp              *op,
+                                    GskGpuFrame           *frame,
+                                    GskVulkanCommandState *state)
+{
+  GskGpuUploadBytesOp *self = (GskGpuUploadBytesOp *) op;
+
+  return gsk_gpu_upload_op_vk_command_with_area (op,
+                                                 frame,
+                                                 state,
+                                                 GSK_VULKAN_IMAGE (self->image),
+                                                 &self->area,
+                                                 gsk_gpu_upload_bytes_op_draw,
+                                                 NULL,
+                                                 &self->buffer);
+}
+#endif
+
+static GskGpuOp *
+gsk_gpu_upload_bytes_op_gl_command (GskGpuOp          *op,
+                                    GskGpuFrame       *frame,
+                                    GskGLCommandState *state)
+{
+  GskGpuUploadBytesOp *self = (GskGpuUploadBytesOp *) op;
+
+  return gsk_gpu_upload_op_gl_command_with_area (op,
+                                                 frame,
+                                                 self->image,
+                                                 &self->area,
+                                                 gsk_gpu_upload_bytes_op_draw,
+                                                 NULL);
+}
+
+static const GskGpuOpClass GSK_GPU_UPLOAD_BYTES_OP_CLASS = {
+  GSK_GPU_OP_SIZE (GskGpuUploadBytesOp),
+  GSK_GPU_STAGE_UPLOAD,
+  gsk_gpu_upload_bytes_op_finish,
+  gsk_gpu_upload_bytes_op_print,
+#ifdef GDK_RENDERING_VULKAN
+  gsk_gpu_upload_bytes_op_vk_command,
+#endif
+  gsk_gpu_upload_bytes_op_gl_command,
+};
+
+/*
+ * gsk_gpu_upload_bytes_op:
+ * @frame: the frame
+ * @image: the image to upload to
+ * @area: the area of the image to fill
+ * @bytes: the pixels in the format of @image
+ * @stride: rowstride of @bytes
+ *
+ * Uploads pixels that are already in the format of @image,
+ * like glyphs from the disk cache.
+ */
+void
+gsk_gpu_upload_bytes_op (GskGpuFrame                 *frame,
+                         GskGpuImage                 *image,
+                         const cairo_rectangle_int_t *area,
+                         GBytes                      *bytes,
+                         gsize                        stride)
+{
+  GskGpuUploadBytesOp *self;
+
+  g_assert (g_bytes_get_size (bytes) >= (area->height - 1) * stride +
+                                        area->width * gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (image)));
+
+  self = (GskGpuUploadBytesOp *) gsk_gpu_op_alloc (frame, &GSK_GPU_UPLOAD_BYTES_OP_CLASS);
+
+  self->image = g_object_ref (image);
+  self->area = *area;
+  self->bytes = g_bytes_ref (bytes);
+  self->stride = stride;
+}
+
+typedef struct _GskGpuRasterizeItem GskGpuRasterizeItem;
+
+struct _GskGpuRasterizeItem
+{
+  GskGpuOp *op;
+  void (* draw_func) (GskGpuOp *, guchar *, gsize);
+  GskGpuUploadStaging *staging;
+};
+
+static void
+gsk_gpu_upload_staging_prepare (GskGpuUploadStaging          *staging,
+                                GskGpuFrame                  *frame,
+                                GskGpuImage                  *image,
+                                const cairo_rectangle_int_t  *area,
+                                gboolean                      whole_image,
+                                GskGpuBuffer                **buffer)
+{
+  gsize bpp = gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (image));
+
+#ifdef GDK_RENDERING_VULKAN
+  if (GSK_IS_VULKAN_IMAGE (image))
+    {
+      if (whole_image)
+        {
+          staging->data = gsk_vulkan_image_get_data (GSK_VULKAN_IMAGE (image), &staging->stride);
+          if (staging->data)
+            return;
+        }
+
+      staging->stride = area->width * bpp;
+      *buffer = gsk_vulkan_buffer_new_write (GSK_VULKAN_DEVICE (gsk_gpu_frame_get_device (frame)),
+                                             area->height * staging->stride);
+      staging->data = gsk_gpu_buffer_map (*buffer);
+      return;
+    }
+#endif
+
+  staging->stride = area->width * bpp;
+  staging->data = g_malloc (area->height * staging->stride);
+  staging->owns_data = TRUE;
+}
+
+/* Returns FALSE if @op must be drawn on the main thread */
+static gboolean
+gsk_gpu_upload_op_prepare_rasterize (GskGpuOp            *op,
+                                     GskGpuFrame         *frame,
+                                     GskGpuRasterizeItem *item)
+{
+  item->op = op;
+
+  if (op->op_class == &GSK_GPU_UPLOAD_CAIRO_OP_CLASS)
+    {
+      GskGpuUploadCairoOp *self = (GskGpuUploadCairoOp *) op;
+
+      if ((self->flags & GSK_GPU_CAIRO_THREADSAFE) == 0)
+        return FALSE;
+
+      gsk_gpu_upload_staging_prepare (&self->staging,
+                                      frame,
+                                      self->image,
+                                      &(cairo_rectangle_int_t) {
+                                          0, 0,
+                                          gsk_gpu_image_get_width (self->image),
+                                          gsk_gpu_image_get_height (self->image)
+                                      },
+                                      TRUE,
+                                      &self->buffer);
+      item->draw_func = gsk_gpu_upload_cairo_op_draw;
+      item->staging = &self->staging;
+      return TRUE;
+    }
+  else if (op->op_class == &GSK_GPU_UPLOAD_CAIRO_INTO_OP_CLASS)
+    {
+      GskGpuUploadCairoIntoOp *self = (GskGpuUploadCairoIntoOp *) op;
+
+      if ((self->flags & GSK_GPU_CAIRO_THREADSAFE) == 0)
+        return FALSE;
+
+      gsk_gpu_upload_staging_prepare (&self->staging, frame, self->image, &self->area, FALSE, &self->buffer);
+      item->draw_func = gsk_gpu_upload_cairo_into_op_draw;
+      item->staging = &self->staging;
+      return TRUE;
+    }
+  else if (op->op_class == &GSK_GPU_UPLOAD_GLYPH_OP_CLASS)
+    {
+      GskGpuUploadGlyphOp *self = (GskGpuUploadGlyphOp *) op;
+      cairo_scaled_font_t *scaled_font;
+
+      /* Hex boxes and other special glyphs are drawn by pango,
+       * which caches things in the font without locking */
+      if (self->glyph & PANGO_GLYPH_UNKNOWN_FLAG ||
+          self->glyph == PANGO_GLYPH_EMPTY ||
+          self->glyph == PANGO_GLYPH_INVALID_INPUT)
+        return FALSE;
+
+      scaled_font = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (self->font));
+      if (scaled_font == NULL ||
+          cairo_scaled_font_status (scaled_font) != CAIRO_STATUS_SUCCESS)
+        return FALSE;
+
+      self->scaled_font = cairo_scaled_font_reference (scaled_font);
+      gsk_gpu_upload_staging_prepare (&self->staging, frame, self->image, &self->area, FALSE, &self->buffer);
+      item->draw_func = gsk_gpu_upload_glyph_op_draw;
+      item->staging = &self->staging;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gsk_gpu_upload_ops_rasterize_task (gsize    start,
+                                   gsize    end,
+                                   gpointer data)
+{
+  GskGpuRasterizeItem *items = data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    items[i].draw_func (items[i].op, items[i].staging->data, items[i].staging->stride);
+}
+
+/*
+ * gsk_gpu_upload_ops_rasterize:
+ * @frame: the frame
+ * @first: the first op of the frame
+ *
+ * Draws all upload ops that draw with cairo and can do so on any
+ * thread into staging memory, in parallel. When their commands are
+ * recorded later, they only need to copy the result.
+ *
+ * This helps frames that show lots of new glyphs or paths, where
+ * drawing them with cairo is the most expensive part.
+ */
+void
+gsk_gpu_upload_ops_rasterize (GskGpuFrame *frame,
+                              GskGpuOp    *first)
+{
+  GArray *items;
+  GskGpuOp *op;
+
+  items = g_array_new (FALSE, FALSE, sizeof (GskGpuRasterizeItem));
+
+  for (op = first; op; op = op->next)
+    {
+      GskGpuRasterizeItem item;
+
+      if (op->op_class->stage != GSK_GPU_STAGE_UPLOAD)
+        continue;
+
+      if (gsk_gpu_upload_op_prepare_rasterize (op, frame, &item))
+        g_array_append_val (items, item);
+    }
+
+  if (items->len > 1)
+    gdk_parallel_task_run (gsk_gpu_upload_ops_rasterize_task, items->data, items->len, 1);
+  else if (items->len == 1)
+    gsk_gpu_upload_ops_rasterize_task (0, 1, items->data);
+
+  g_array_unref (items);
 }
@@ -9,6 +9,15 @@ G_BEGIN_DECLS
 typedef void            (* GskGpuCairoFunc)                             (gpointer                        user_data,
                                                                          cairo_t                        *cr);
 
+/*
+ * GskGpuCairoFlags:
+ * @GSK_GPU_CAIRO_THREADSAFE: The draw function only uses cairo and
+ *   immutable data, so it can be called from any thread.
+ */
+typedef enum {
+  GSK_GPU_CAIRO_THREADSAFE = (1 << 0),
+} GskGpuCairoFlags;
+
 GskGpuImage *           gsk_gpu_upload_texture_op_try                   (GskGpuFrame                    *frame,
                                                                          gboolean                        with_mipmap,
                                                                          guint                           lod_level,
@@ -18,6 +27,17 @@ GskGpuImage *           gsk_gpu_upload_texture_op_try                   (GskGpuF
 GskGpuImage *           gsk_gpu_upload_cairo_op                         (GskGpuFrame                    *frame,
                                                                          const graphene_vec2_t          *scale,
                                                                          const graphene_rect_t          *viewport,
+                                                                         GskGpuCairoFlags                flags,
+                                                                         GskGpuCairoFunc                 func,
+                                                                         gpointer                        user_data,
+                                                                         GDestroyNotify                  user_destroy);
+
+void                    gsk_gpu_upload_cairo_into_op                    (GskGpuFrame                    *frame,
+                                                                         GskGpuImage                    *image,
+                                                                         const cairo_rectangle_int_t    *area,
+                                                                         const graphene_vec2_t          *scale,
+                                                                         const graphene_point_t         *origin,
+                                                                         GskGpuCairoFlags                flags,
                                                                          GskGpuCairoFunc                 func,
                                                                          gpointer                        user_data,
                                                                          GDestroyNotify                  user_destroy);
@@ -27,7 +47,25 @@ void                    gsk_gpu_upload_glyph_op                         (GskGpuF
                                                                          PangoFont                      *font,
                                                                          PangoGlyph                      glyph,
                                                                          const cairo_rectangle_int_t    *area,
-                                                                         const graphene_point_t         *origin);
+                                                                         const graphene_point_t         *origin,
+                                                                         guint                           spread,
+                                                                         GskGpuDiskCache                *disk_cache,
+                                                                         GBytes                         *disk_key);
+
+void                    gsk_gpu_make_distance_field                     (guchar                         *data,
+                                                                         gsize                           stride,
+                                                                         gsize                           width,
+                                                                         gsize                           height,
+                                                                         guint                           spread);
+
+void                    gsk_gpu_upload_bytes_op                         (GskGpuFrame                    *frame,
+                                                                         GskGpuImage                    *image,
+                                                                         const cairo_rectangle_int_t    *area,
+                                                                         GBytes                         *bytes,
+                                                                         gsize                           stride);
+
+void                    gsk_gpu_upload_ops_rasterize                    (GskGpuFrame                    *frame,
+                                                                         GskGpuOp                       *first);
 
 G_END_DECLS
 
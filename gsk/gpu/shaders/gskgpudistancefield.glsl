@@ -0,0 +1,52 @@
+#define GSK_N_TEXTURES 1
+
+#include "common.glsl"
+
+/* Must match GSK_GPU_DISTANCE_FIELD_SPREAD */
+#define SPREAD 8.0
+
+PASS(0) vec2 _pos;
+PASS_FLAT(1) Rect _rect;
+PASS_FLAT(2) vec4 _color;
+PASS(3) vec2 _tex_coord;
+
+
+#ifdef GSK_VERTEX_SHADER
+
+IN(0) vec4 in_rect;
+IN(1) vec4 in_color;
+IN(2) vec4 in_tex_rect;
+
+void
+run (out vec2 pos)
+{
+  Rect r = rect_from_gsk (in_rect);
+
+  pos = rect_get_position (r);
+
+  _pos = pos;
+  _rect = r;
+  _color = output_color_from_alt (in_color);
+  _tex_coord = rect_get_coord (rect_from_gsk (in_tex_rect), pos);
+}
+
+#endif
+
+
+
+#ifdef GSK_FRAGMENT_SHADER
+
+void
+run (out vec4 color,
+     out vec2 position)
+{
+  vec2 texels = fwidth (_tex_coord) * vec2 (textureSize (GSK_TEXTURE0, 0));
+  float texels_per_pixel = max (0.5 * (texels.x + texels.y), 1.0 / 64.0);
+  float distance = (texture (GSK_TEXTURE0, _tex_coord).a - 0.5) * 2.0 * SPREAD;
+  float alpha = clamp (distance / texels_per_pixel + 0.5, 0.0, 1.0) * rect_coverage (_rect, _pos);
+
+  color = output_color_alpha (_color, alpha);
+  position = _pos;
+}
+
+#endif
@@ -26,6 +26,7 @@
 #include "gdkcairoprivate.h"
 
 #include "gdkcairoprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 
 #include <math.h>
 #include <string.h>
@@ -86,10 +87,9 @@ blur_xspan (guchar *row,
    * be well predicted and there are enough different possibilities
    * that trying to write this as a series of unconditional loops
    * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
+   * to be the integer division per pixel, which is why the common
+   * sizes get their own copy of the loop below. Rows are blurred in
+   * parallel, see _boxblur().
    */
 
 #define BLUR_ROW_KERNEL(D)                                      \
@@ -161,33 +161,142 @@ blur_rows (guchar *dst_buffer,
     }
 }
 
-/* Swaps width and height.
+/* Blurring a column with the same result as blur_xspan(), but for a
+ * whole strip of columns at once. We keep one sum per column and
+ * walk down the rows, so all inner loops run over consecutive bytes
+ * and get vectorized by the compiler. This avoids transposing the
+ * image, which is what used to make vertical blurs slow.
+ *
+ * The division is done as a multiplication with the reciprocal of d,
+ * rounded up, in 8.24 fixed point. For the sums we can get, that is
+ * exact as long as d is at most MAX_RECIPROCAL_SIZE.
  */
+#define MAX_RECIPROCAL_SIZE 256
+
 static void
-flip_buffer (guchar *dst_buffer,
-             guchar *src_buffer,
-             int     width,
-             int     height)
+blur_yspan (const guchar *src,
+            gsize         src_stride,
+            guchar       *dst,
+            gsize         dst_stride,
+            int           width,
+            int           height,
+            int           d,
+            int           shift,
+            guint32      *sums)
 {
-  /* Working in blocks increases cache efficiency, compared to reading
-   * or writing an entire column at once
-   */
-#define BLOCK_SIZE 16
-
-  int i0, j0;
-
-  for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
-    for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
-      {
-        int max_j = MIN(j0 + BLOCK_SIZE, height);
-        int max_i = MIN(i0 + BLOCK_SIZE, width);
-        int i, j;
-
-        for (i = i0; i < max_i; i++)
-          for (j = j0; j < max_j; j++)
-            dst_buffer[i * height + j] = src_buffer[j * width + i];
-      }
-#undef BLOCK_SIZE
+  guint32 half = d / 2;
+  guint32 reciprocal = ((1u << 24) + d - 1) / d;
+  int offset;
+  int i, x;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  memset (sums, 0, width * sizeof (guint32));
+
+  for (i = -d + offset; i < height + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          const guchar *in = src + i * src_stride;
+
+          for (x = 0; x < width; x++)
+            sums[x] += in[x];
+        }
+
+      if (i >= offset)
+        {
+          guchar *out = dst + (i - offset) * dst_stride;
+
+          if (i >= d)
+            {
+              const guchar *in = src + (i - d) * src_stride;
+
+              for (x = 0; x < width; x++)
+                sums[x] -= in[x];
+            }
+
+          if (d <= MAX_RECIPROCAL_SIZE)
+            {
+              for (x = 0; x < width; x++)
+                out[x] = ((sums[x] + half) * reciprocal) >> 24;
+            }
+          else
+            {
+              for (x = 0; x < width; x++)
+                out[x] = (sums[x] + half) / d;
+            }
+        }
+    }
+}
+
+/* The number of pixels we want to process per chunk of a parallel task */
+#define PIXELS_PER_CHUNK (64 * 1024)
+
+/* Columns are blurred in strips that are a multiple of this wide */
+#define STRIP_WIDTH 64
+
+typedef struct
+{
+  guchar *buffer;
+  int width;
+  int height;
+  int d;
+} BlurJob;
+
+static void
+blur_rows_task (gsize    start,
+                gsize    end,
+                gpointer data)
+{
+  BlurJob *job = data;
+  guchar *tmp_buffer;
+
+  tmp_buffer = g_malloc (job->width);
+
+  blur_rows (job->buffer + start * job->width, tmp_buffer, job->width, end - start, job->d);
+
+  g_free (tmp_buffer);
+}
+
+static void
+blur_columns_task (gsize    start,
+                   gsize    end,
+                   gpointer data)
+{
+  BlurJob *job = data;
+  guchar *strip, *tmp1, *tmp2;
+  guint32 *sums;
+  int x, width, height, d;
+
+  x = start * STRIP_WIDTH;
+  width = MIN (end * STRIP_WIDTH, job->width) - x;
+  height = job->height;
+  d = job->d;
+
+  strip = job->buffer + x;
+  tmp1 = g_malloc (2 * width * height);
+  tmp2 = tmp1 + width * height;
+  sums = g_new (guint32, width);
+
+  /* See blur_rows() for why even sizes are done this way */
+  if (d % 2 == 1)
+    {
+      blur_yspan (strip, job->width, tmp1, width, width, height, d, 0, sums);
+      blur_yspan (tmp1, width, tmp2, width, width, height, d, 0, sums);
+      blur_yspan (tmp2, width, strip, job->width, width, height, d, 0, sums);
+    }
+  else
+    {
+      blur_yspan (strip, job->width, tmp1, width, width, height, d, 1, sums);
+      blur_yspan (tmp1, width, tmp2, width, width, height, d, -1, sums);
+      blur_yspan (tmp2, width, strip, job->width, width, height, d + 1, 0, sums);
+    }
+
+  g_free (sums);
+  g_free (tmp1);
 }
 
 static void
@@ -197,30 +306,33 @@ _boxblur (guchar      *buffer,
           int          radius,
           GskBlurFlags flags)
 {
-  guchar *flipped_buffer;
-  int d = get_box_filter_size (radius);
-
-  flipped_buffer = g_malloc (width * height);
+  BlurJob job = {
+    .buffer = buffer,
+    .width = width,
+    .height = height,
+    .d = get_box_filter_size (radius),
+  };
+
+  if (width == 0 || height == 0)
+    return;
 
   if (flags & GSK_BLUR_Y)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
+      gsize n_strips = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
 
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
-
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      gdk_parallel_task_run (blur_columns_task,
+                             &job,
+                             n_strips,
+                             MAX (1, PIXELS_PER_CHUNK / (STRIP_WIDTH * height)));
     }
 
   if (flags & GSK_BLUR_X)
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      gdk_parallel_task_run (blur_rows_task,
+                             &job,
+                             height,
+                             MAX (1, PIXELS_PER_CHUNK / width));
     }
-
-  g_free (flipped_buffer);
 }
 
 /*
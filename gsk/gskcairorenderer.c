@@ -23,10 +23,13 @@
 #include "gskcairorenderer.h"
 
 #include "gskdebugprivate.h"
+#include "gskrectprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeprivate.h"
+#include "gdk/gdkcairoprivate.h"
 #include "gdk/gdkcolorstateprivate.h"
 #include "gdk/gdkdrawcontextprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 #include "gdk/gdktextureprivate.h"
 
 typedef struct {
@@ -40,6 +43,9 @@ struct _GskCairoRenderer
 
   GdkCairoContext *cairo_context;
 
+  /* size of tiles in device pixels or 0 to not use tiles */
+  int tile_size;
+
   ProfileTimers profile_timers;
 };
 
@@ -72,6 +78,366 @@ gsk_cairo_renderer_unrealize (GskRenderer *renderer)
   g_clear_object (&self->cairo_context);
 }
 
+typedef struct _TileRender TileRender;
+
+struct _TileRender
+{
+  GskRenderNode *root;
+  GdkColorState *color_state;
+  GdkColorState *ccs;
+
+  /* the textures drawn by root, downloaded once for all tiles */
+  GHashTable *texture_surfaces;
+  GPtrArray *textures;
+  cairo_surface_t **surfaces;
+
+  cairo_surface_t *target;
+  double device_scale_x, device_scale_y;
+  double device_offset_x, device_offset_y;
+  cairo_matrix_t matrix;
+  cairo_rectangle_list_t *clip;
+
+  /* in device pixels */
+  cairo_rectangle_int_t extents;
+  int tile_size;
+  int n_columns;
+  int n_tiles;
+};
+
+/* Like gsk_render_node_draw_ccs(), but skips children of containers
+ * that are outside of the tile.
+ * Nodes don't draw outside their bounds, so this doesn't change the result.
+ */
+static void
+gsk_cairo_renderer_draw_culled (GskRenderNode         *node,
+                                cairo_t               *cr,
+                                GdkColorState         *ccs,
+                                const graphene_rect_t *tile)
+{
+  if (!gsk_rect_intersects (&node->bounds, tile))
+    return;
+
+  if (gsk_render_node_get_node_type (node) == GSK_CONTAINER_NODE &&
+      !GSK_DEBUG_CHECK (GEOMETRY))
+    {
+      guint i, n;
+
+      n = gsk_container_node_get_n_children (node);
+      for (i = 0; i < n; i++)
+        gsk_cairo_renderer_draw_culled (gsk_container_node_get_child (node, i), cr, ccs, tile);
+    }
+  else
+    {
+      gsk_render_node_draw_ccs (node, cr, ccs);
+    }
+}
+
+/* the size of the largest texture that texture nodes
+ * draw from a single cairo surface */
+#define MAX_TILED_TEXTURE_SIZE 16384
+
+static gboolean
+gsk_cairo_renderer_add_texture (GdkTexture *texture,
+                                GHashTable *textures)
+{
+  if (!GDK_IS_MEMORY_TEXTURE (texture) ||
+      gdk_texture_get_width (texture) > MAX_TILED_TEXTURE_SIZE ||
+      gdk_texture_get_height (texture) > MAX_TILED_TEXTURE_SIZE)
+    return FALSE;
+
+  g_hash_table_insert (textures, texture, NULL);
+
+  return TRUE;
+}
+
+/* Checks if the node can be drawn from multiple threads at once
+ * and looks the same when drawn in tiles. The textures it draws
+ * are added to @textures.
+ *
+ * Text uses pango and cairo font caches that aren't thread-safe,
+ * cairo nodes share their recording surface, textures other than
+ * memory textures need their context to download and shadows and
+ * blurs size their intermediate surfaces from the clip, so they
+ * don't line up at tile edges.
+ */
+static gboolean
+gsk_cairo_renderer_can_draw_tiled (GskRenderNode *node,
+                                   GHashTable    *textures)
+{
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        guint i, n;
+
+        n = gsk_container_node_get_n_children (node);
+        for (i = 0; i < n; i++)
+          {
+            if (!gsk_cairo_renderer_can_draw_tiled (gsk_container_node_get_child (node, i), textures))
+              return FALSE;
+          }
+        return TRUE;
+      }
+
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+    case GSK_CONIC_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+      return TRUE;
+
+    case GSK_TEXTURE_NODE:
+      return gsk_cairo_renderer_add_texture (gsk_texture_node_get_texture (node), textures);
+
+    case GSK_TEXTURE_SCALE_NODE:
+      return gsk_cairo_renderer_add_texture (gsk_texture_scale_node_get_texture (node), textures);
+
+    case GSK_TRANSFORM_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_transform_node_get_child (node), textures);
+
+    case GSK_OPACITY_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_opacity_node_get_child (node), textures);
+
+    case GSK_COLOR_MATRIX_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_color_matrix_node_get_child (node), textures);
+
+    case GSK_CLIP_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_clip_node_get_child (node), textures);
+
+    case GSK_ROUNDED_CLIP_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_rounded_clip_node_get_child (node), textures);
+
+    case GSK_FILL_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_fill_node_get_child (node), textures);
+
+    case GSK_STROKE_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_stroke_node_get_child (node), textures);
+
+    case GSK_DEBUG_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_debug_node_get_child (node), textures);
+
+    case GSK_BLEND_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_blend_node_get_bottom_child (node), textures) &&
+             gsk_cairo_renderer_can_draw_tiled (gsk_blend_node_get_top_child (node), textures);
+
+    case GSK_CROSS_FADE_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_cross_fade_node_get_start_child (node), textures) &&
+             gsk_cairo_renderer_can_draw_tiled (gsk_cross_fade_node_get_end_child (node), textures);
+
+    case GSK_MASK_NODE:
+      return gsk_cairo_renderer_can_draw_tiled (gsk_mask_node_get_source (node), textures) &&
+             gsk_cairo_renderer_can_draw_tiled (gsk_mask_node_get_mask (node), textures);
+
+    case GSK_CAIRO_NODE:
+    case GSK_TEXT_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_SHADOW_NODE:
+    case GSK_BLUR_NODE:
+    case GSK_REPEAT_NODE:
+    case GSK_GL_SHADER_NODE:
+    case GSK_SUBSURFACE_NODE:
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      return FALSE;
+    }
+}
+
+static void
+gsk_cairo_renderer_render_tile (TileRender *render,
+                                int         tile)
+{
+  cairo_rectangle_int_t area;
+  graphene_rect_t bounds;
+  double x1, y1, x2, y2;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  guchar *data;
+  int stride, i;
+
+  area.x = render->extents.x + (tile % render->n_columns) * render->tile_size;
+  area.y = render->extents.y + (tile / render->n_columns) * render->tile_size;
+  area.width = MIN (render->tile_size, render->extents.x + render->extents.width - area.x);
+  area.height = MIN (render->tile_size, render->extents.y + render->extents.height - area.y);
+
+  /* Draw straight into the target's memory, tiles don't overlap */
+  stride = cairo_image_surface_get_stride (render->target);
+  data = cairo_image_surface_get_data (render->target) + area.y * stride + area.x * 4;
+  surface = cairo_image_surface_create_for_data (data,
+                                                 cairo_image_surface_get_format (render->target),
+                                                 area.width, area.height,
+                                                 stride);
+  cairo_surface_set_device_scale (surface, render->device_scale_x, render->device_scale_y);
+  cairo_surface_set_device_offset (surface,
+                                   render->device_offset_x - area.x,
+                                   render->device_offset_y - area.y);
+
+  cr = cairo_create (surface);
+  cairo_set_matrix (cr, &render->matrix);
+
+  for (i = 0; i < render->clip->num_rectangles; i++)
+    {
+      cairo_rectangle_t *rect = &render->clip->rectangles[i];
+      cairo_rectangle (cr, rect->x, rect->y, rect->width, rect->height);
+    }
+  cairo_clip (cr);
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  graphene_rect_init (&bounds, x1, y1, x2 - x1, y2 - y1);
+
+  if (!gsk_rect_is_empty (&bounds))
+    {
+      gsk_cairo_set_texture_surfaces (cr, render->ccs, render->texture_surfaces);
+
+      if (gdk_color_state_equal (render->color_state, render->ccs))
+        {
+          gsk_cairo_renderer_draw_culled (render->root, cr, render->ccs, &bounds);
+        }
+      else
+        {
+          /* Like gsk_render_node_draw_with_color_state(),
+           * but only for the tile */
+          cairo_push_group (cr);
+          gsk_cairo_renderer_draw_culled (render->root, cr, render->ccs, &bounds);
+          gdk_cairo_surface_convert_color_state (cairo_get_group_target (cr),
+                                                 render->ccs,
+                                                 render->color_state);
+          cairo_pop_group_to_source (cr);
+          cairo_paint (cr);
+        }
+    }
+
+  cairo_destroy (cr);
+  cairo_surface_finish (surface);
+  cairo_surface_destroy (surface);
+}
+
+static void
+gsk_cairo_renderer_render_tiles (gsize    start,
+                                 gsize    end,
+                                 gpointer data)
+{
+  TileRender *render = data;
+  gsize tile;
+
+  for (tile = start; tile < end; tile++)
+    gsk_cairo_renderer_render_tile (render, tile);
+}
+
+static void
+gsk_cairo_renderer_download_textures (gsize    start,
+                                      gsize    end,
+                                      gpointer data)
+{
+  TileRender *render = data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    render->surfaces[i] = gdk_texture_download_surface (g_ptr_array_index (render->textures, i),
+                                                        render->ccs);
+}
+
+/*
+ * Splits the area to draw into tiles and draws them in parallel.
+ *
+ * This only works when drawing to image surfaces with simple transforms
+ * and for nodes that can be drawn from multiple threads, otherwise FALSE
+ * is returned and nothing is drawn.
+ */
+static gboolean
+gsk_cairo_renderer_do_render_tiled (GskCairoRenderer *self,
+                                    cairo_t          *cr,
+                                    GdkColorState    *color_state,
+                                    GskRenderNode    *root)
+{
+  TileRender render = {
+    .root = root,
+    .color_state = color_state,
+    .ccs = gdk_color_state_get_rendering_color_state (color_state),
+    .target = cairo_get_target (cr),
+    .tile_size = self->tile_size,
+  };
+  double x1, y1, x2, y2;
+  guint i;
+
+  if (cairo_surface_get_type (render.target) != CAIRO_SURFACE_TYPE_IMAGE)
+    return FALSE;
+
+  switch ((int) cairo_image_surface_get_format (render.target))
+    {
+    case CAIRO_FORMAT_ARGB32:
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_RGB30:
+      break;
+    default:
+      return FALSE;
+    }
+
+  cairo_get_matrix (cr, &render.matrix);
+  if (render.matrix.xy != 0 || render.matrix.yx != 0)
+    return FALSE;
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  cairo_user_to_device (cr, &x1, &y1);
+  cairo_user_to_device (cr, &x2, &y2);
+  render.extents.x = MAX (0, floor (MIN (x1, x2)));
+  render.extents.y = MAX (0, floor (MIN (y1, y2)));
+  render.extents.width = MIN (cairo_image_surface_get_width (render.target), ceil (MAX (x1, x2))) - render.extents.x;
+  render.extents.height = MIN (cairo_image_surface_get_height (render.target), ceil (MAX (y1, y2))) - render.extents.y;
+  if (render.extents.width <= 0 || render.extents.height <= 0)
+    return TRUE;
+
+  /* Not worth it */
+  if (render.extents.width <= render.tile_size && render.extents.height <= render.tile_size)
+    return FALSE;
+
+  render.texture_surfaces = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) cairo_surface_destroy);
+  if (!gsk_cairo_renderer_can_draw_tiled (root, render.texture_surfaces))
+    {
+      g_hash_table_unref (render.texture_surfaces);
+      return FALSE;
+    }
+
+  render.clip = cairo_copy_clip_rectangle_list (cr);
+  if (render.clip->status != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_rectangle_list_destroy (render.clip);
+      g_hash_table_unref (render.texture_surfaces);
+      return FALSE;
+    }
+
+  /* Texture nodes download their texture every time they are drawn,
+   * so do it here once instead of in every tile they touch */
+  render.textures = g_hash_table_get_keys_as_ptr_array (render.texture_surfaces);
+  render.surfaces = g_new0 (cairo_surface_t *, render.textures->len);
+  gdk_parallel_task_run (gsk_cairo_renderer_download_textures, &render, render.textures->len, 1);
+  for (i = 0; i < render.textures->len; i++)
+    g_hash_table_insert (render.texture_surfaces, g_ptr_array_index (render.textures, i), render.surfaces[i]);
+  g_clear_pointer (&render.surfaces, g_free);
+  g_clear_pointer (&render.textures, g_ptr_array_unref);
+
+  cairo_surface_get_device_scale (render.target, &render.device_scale_x, &render.device_scale_y);
+  cairo_surface_get_device_offset (render.target, &render.device_offset_x, &render.device_offset_y);
+
+  render.n_columns = (render.extents.width + render.tile_size - 1) / render.tile_size;
+  render.n_tiles = render.n_columns * ((render.extents.height + render.tile_size - 1) / render.tile_size);
+
+  cairo_surface_flush (render.target);
+
+  gdk_parallel_task_run (gsk_cairo_renderer_render_tiles, &render, render.n_tiles, 1);
+
+  cairo_surface_mark_dirty_rectangle (render.target,
+                                      render.extents.x, render.extents.y,
+                                      render.extents.width, render.extents.height);
+
+  cairo_rectangle_list_destroy (render.clip);
+  g_hash_table_unref (render.texture_surfaces);
+
+  return TRUE;
+}
+
 static void
 gsk_cairo_renderer_do_render (GskRenderer   *renderer,
                               cairo_t       *cr,
@@ -85,7 +451,9 @@ gsk_cairo_renderer_do_render (GskRenderer   *renderer,
   profiler = gsk_renderer_get_profiler (renderer);
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 
-  gsk_render_node_draw_with_color_state (root, cr, ccs);
+  if (self->tile_size <= 0 ||
+      !gsk_cairo_renderer_do_render_tiled (self, cr, ccs, root))
+    gsk_render_node_draw_with_color_state (root, cr, ccs);
 
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
   gsk_profiler_timer_set (profiler, self->profile_timers.cpu_time, cpu_time);
@@ -215,7 +583,13 @@ gsk_cairo_renderer_init (GskCairoRenderer *self)
 {
   GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
 
+  const char *tile_size;
+
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
+
+  tile_size = g_getenv ("GSK_CAIRO_TILE_SIZE");
+  if (tile_size)
+    self->tile_size = g_ascii_strtoll (tile_size, NULL, 10);
 }
 
 /**
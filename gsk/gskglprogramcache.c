@@ -0,0 +1,520 @@
+#include "config.h"
+
+#include "gskglprogramcacheprivate.h"
+
+#include "gskdebugprivate.h"
+
+#include "gdk/gdkglcontextprivate.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Linked programs are kept in one file per program, named after a
+ * checksum of everything that went into compiling them. The files
+ * live in a directory per driver, so binaries are never given to a
+ * driver that didn't create them.
+ *
+ * Files are only ever replaced atomically, so multiple processes can
+ * use the same directory.
+ *
+ * Loading a program touches its file. Once per process, files that
+ * haven't been used for MAX_AGE are removed, and the least recently
+ * used files are removed until all drivers together use less than
+ * MAX_SIZE. That also takes care of the directories of drivers that
+ * are gone.
+ */
+
+#define MAGIC "GSKGLPRG"
+#define VERSION 1
+
+#define MAX_AGE (30 * G_TIME_SPAN_DAY)
+#define MAX_SIZE (32 * 1024 * 1024)
+
+typedef struct _FileHeader FileHeader;
+typedef struct _SaveJob SaveJob;
+typedef struct _TrimFile TrimFile;
+
+struct _FileHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 format;
+  guint32 size;
+  guint32 reserved;
+};
+
+G_STATIC_ASSERT (sizeof (FileHeader) == 24);
+
+struct _SaveJob
+{
+  char *path;
+  GBytes *contents;
+};
+
+struct _TrimFile
+{
+  char *path;
+  gint64 mtime;
+  goffset size;
+};
+
+struct _GskGLProgramCache
+{
+  char *dir;
+};
+
+static const char *
+gsk_gl_program_cache_get_base_dir (void)
+{
+  static char *base_dir;
+
+  if (g_once_init_enter_pointer (&base_dir))
+    {
+      const char *env = g_getenv ("GSK_GL_PROGRAM_CACHE");
+      char *dir;
+
+      if (env && g_str_equal (env, "0"))
+        dir = g_strdup ("");
+      else if (env && g_path_is_absolute (env))
+        dir = g_strdup (env);
+      else
+        dir = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "gl-program-cache", NULL);
+
+      g_once_init_leave_pointer (&base_dir, dir);
+    }
+
+  return base_dir;
+}
+
+static char *
+gsk_gl_program_cache_get_driver_id (void)
+{
+  GChecksum *checksum;
+  const char *strings[] = {
+    (const char *) glGetString (GL_VENDOR),
+    (const char *) glGetString (GL_RENDERER),
+    (const char *) glGetString (GL_VERSION),
+    (const char *) glGetString (GL_SHADING_LANGUAGE_VERSION),
+    PACKAGE_VERSION,
+  };
+  char *result;
+  gsize i;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  for (i = 0; i < G_N_ELEMENTS (strings); i++)
+    {
+      if (strings[i])
+        g_checksum_update (checksum, (const guchar *) strings[i], -1);
+      g_checksum_update (checksum, (const guchar *) "\n", 1);
+    }
+
+  /* 128 bits are plenty to tell drivers apart */
+  result = g_strndup (g_checksum_get_string (checksum), 32);
+  g_checksum_free (checksum);
+
+  return result;
+}
+
+static void
+trim_file_clear (gpointer data)
+{
+  TrimFile *file = data;
+
+  g_free (file->path);
+}
+
+static int
+trim_file_compare (gconstpointer a,
+                   gconstpointer b)
+{
+  const TrimFile *fa = a;
+  const TrimFile *fb = b;
+
+  /* Newest first */
+  return fa->mtime > fb->mtime ? -1 : (fa->mtime < fb->mtime);
+}
+
+static void
+gsk_gl_program_cache_collect_files (const char *dir,
+                                    GArray     *files)
+{
+  const char *name;
+  GDir *gdir;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  if (gdir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (gdir)))
+    {
+      TrimFile file;
+      GStatBuf st;
+
+      file.path = g_build_filename (dir, name, NULL);
+      if (!g_file_test (file.path, G_FILE_TEST_IS_REGULAR) ||
+          g_stat (file.path, &st) != 0)
+        {
+          g_free (file.path);
+          continue;
+        }
+
+      file.mtime = (gint64) st.st_mtime * G_USEC_PER_SEC;
+      file.size = st.st_size;
+      g_array_append_val (files, file);
+    }
+
+  g_dir_close (gdir);
+}
+
+static void
+gsk_gl_program_cache_trim (GTask        *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
+{
+  const char *base_dir = task_data;
+  GPtrArray *dirs;
+  GArray *files;
+  const char *name;
+  gint64 now;
+  goffset size;
+  guint i;
+  GDir *gdir;
+
+  gdir = g_dir_open (base_dir, 0, NULL);
+  if (gdir == NULL)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  dirs = g_ptr_array_new_with_free_func (g_free);
+  files = g_array_new (FALSE, FALSE, sizeof (TrimFile));
+  g_array_set_clear_func (files, trim_file_clear);
+
+  while ((name = g_dir_read_name (gdir)))
+    {
+      char *dir = g_build_filename (base_dir, name, NULL);
+
+      if (g_file_test (dir, G_FILE_TEST_IS_DIR))
+        {
+          gsk_gl_program_cache_collect_files (dir, files);
+          g_ptr_array_add (dirs, dir);
+        }
+      else
+        g_free (dir);
+    }
+  g_dir_close (gdir);
+
+  g_array_sort (files, trim_file_compare);
+
+  now = g_get_real_time ();
+  size = 0;
+  for (i = 0; i < files->len; i++)
+    {
+      TrimFile *file = &g_array_index (files, TrimFile, i);
+
+      if (now - file->mtime < MAX_AGE && size + file->size <= MAX_SIZE)
+        {
+          size += file->size;
+          continue;
+        }
+
+      GSK_DEBUG (CACHE, "Removing unused GL program '%s'", file->path);
+      g_remove (file->path);
+    }
+
+  /* Only succeeds for directories that are empty now */
+  for (i = 0; i < dirs->len; i++)
+    g_rmdir (g_ptr_array_index (dirs, i));
+
+  g_array_unref (files);
+  g_ptr_array_unref (dirs);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/*<private>
+ * gsk_gl_program_cache_new:
+ * @context: the current GL context
+ *
+ * Creates a cache for the binaries of programs linked with @context.
+ *
+ * Returns: (nullable): a new cache or %NULL if the cache has been
+ *   disabled or the context can't provide program binaries
+ */
+GskGLProgramCache *
+gsk_gl_program_cache_new (GdkGLContext *context)
+{
+  static gsize trimmed;
+  GskGLProgramCache *self;
+  const char *base_dir;
+  char *driver_id;
+  GLint n_formats = 0;
+
+  g_assert (gdk_gl_context_get_current () == context);
+
+  base_dir = gsk_gl_program_cache_get_base_dir ();
+  if (base_dir[0] == '\0')
+    return NULL;
+
+  if (!gdk_gl_context_check_version (context, "4.1", "3.0") &&
+      !epoxy_has_gl_extension ("GL_ARB_get_program_binary"))
+    return NULL;
+
+  glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  if (n_formats <= 0)
+    return NULL;
+
+  if (g_once_init_enter (&trimmed))
+    {
+      GTask *task;
+
+      task = g_task_new (NULL, NULL, NULL, NULL);
+      g_task_set_source_tag (task, gsk_gl_program_cache_trim);
+      g_task_set_task_data (task, (gpointer) base_dir, NULL);
+      g_task_run_in_thread (task, gsk_gl_program_cache_trim);
+      g_object_unref (task);
+      g_once_init_leave (&trimmed, 1);
+    }
+
+  driver_id = gsk_gl_program_cache_get_driver_id ();
+
+  self = g_atomic_rc_box_new0 (GskGLProgramCache);
+  self->dir = g_build_filename (base_dir, driver_id, NULL);
+
+  GSK_DEBUG (CACHE, "Using GL program cache '%s'", self->dir);
+
+  g_free (driver_id);
+
+  return self;
+}
+
+static void
+gsk_gl_program_cache_clear (gpointer data)
+{
+  GskGLProgramCache *self = data;
+
+  g_free (self->dir);
+}
+
+GskGLProgramCache *
+gsk_gl_program_cache_ref (GskGLProgramCache *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+void
+gsk_gl_program_cache_unref (GskGLProgramCache *self)
+{
+  g_atomic_rc_box_release_full (self, gsk_gl_program_cache_clear);
+}
+
+/*<private>
+ * gsk_gl_program_cache_prepare:
+ * @self: a cache
+ * @program_id: a program that has not been linked yet
+ *
+ * Must be called before linking programs that are going to be saved
+ * with gsk_gl_program_cache_save().
+ */
+void
+gsk_gl_program_cache_prepare (GskGLProgramCache *self,
+                              GLuint             program_id)
+{
+  glProgramParameteri (program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+static gboolean
+gsk_gl_program_cache_validate (GBytes *bytes)
+{
+  const FileHeader *header;
+  gsize size;
+
+  header = g_bytes_get_data (bytes, &size);
+
+  return size >= sizeof (FileHeader) &&
+         memcmp (header->magic, MAGIC, 8) == 0 &&
+         header->version == VERSION &&
+         header->size == size - sizeof (FileHeader);
+}
+
+static GBytes *
+gsk_gl_program_cache_read (const char *path)
+{
+  GBytes *bytes;
+  char *data;
+  gsize size;
+
+  if (!g_file_get_contents (path, &data, &size, NULL))
+    return NULL;
+
+  bytes = g_bytes_new_take (data, size);
+  if (!gsk_gl_program_cache_validate (bytes))
+    {
+      GSK_DEBUG (CACHE, "Ignoring invalid GL program '%s'", path);
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  return bytes;
+}
+
+/*<private>
+ * gsk_gl_program_cache_lookup:
+ * @self: a cache
+ * @checksum: the checksum of the program
+ *
+ * Reads the binary of a program from disk.
+ *
+ * This function is thread-safe.
+ *
+ * Returns: (nullable): the contents to pass to gsk_gl_program_cache_load()
+ */
+GBytes *
+gsk_gl_program_cache_lookup (GskGLProgramCache *self,
+                             const char        *checksum)
+{
+  GBytes *bytes;
+  char *path;
+
+  path = g_build_filename (self->dir, checksum, NULL);
+  bytes = gsk_gl_program_cache_read (path);
+  g_free (path);
+
+  return bytes;
+}
+
+/*<private>
+ * gsk_gl_program_cache_load:
+ * @self: a cache
+ * @program_id: a new program
+ * @checksum: the checksum of the program
+ *
+ * Tries to link the program from its binary.
+ *
+ * If that fails, the file is removed and the program must be
+ * deleted. A new program must be compiled from source.
+ *
+ * Returns: %TRUE if the program was loaded successfully
+ */
+gboolean
+gsk_gl_program_cache_load (GskGLProgramCache *self,
+                           GLuint             program_id,
+                           const char        *checksum)
+{
+  const FileHeader *header;
+  GLint link_status;
+  GBytes *bytes;
+  char *path;
+
+  bytes = gsk_gl_program_cache_lookup (self, checksum);
+  if (bytes == NULL)
+    return FALSE;
+
+  header = g_bytes_get_data (bytes, NULL);
+  glProgramBinary (program_id, header->format, header + 1, header->size);
+  glGetProgramiv (program_id, GL_LINK_STATUS, &link_status);
+
+  g_bytes_unref (bytes);
+
+  path = g_build_filename (self->dir, checksum, NULL);
+
+  if (link_status == GL_FALSE)
+    {
+      /* The driver changed without telling us, don't try again */
+      GSK_DEBUG (CACHE, "Driver rejected GL program %s", checksum);
+      g_remove (path);
+      g_free (path);
+
+      return FALSE;
+    }
+
+  /* Keeps the program from being trimmed */
+  g_utime (path, NULL);
+  g_free (path);
+
+  return TRUE;
+}
+
+static void
+save_job_free (gpointer data)
+{
+  SaveJob *job = data;
+
+  g_free (job->path);
+  g_bytes_unref (job->contents);
+  g_free (job);
+}
+
+static void
+save_job_run (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+  SaveJob *job = task_data;
+  GError *error = NULL;
+  char *dir;
+
+  dir = g_path_get_dirname (job->path);
+  if (g_mkdir_with_parents (dir, 0755) != 0)
+    {
+      GSK_DEBUG (CACHE, "Failed to create GL program cache directory '%s'", dir);
+    }
+  else if (!g_file_set_contents (job->path,
+                                 g_bytes_get_data (job->contents, NULL),
+                                 g_bytes_get_size (job->contents),
+                                 &error))
+    {
+      GSK_DEBUG (CACHE, "Failed to save GL program: %s", error->message);
+      g_clear_error (&error);
+    }
+  g_free (dir);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/*<private>
+ * gsk_gl_program_cache_save:
+ * @self: a cache
+ * @program_id: a program that has been linked successfully after
+ *   calling gsk_gl_program_cache_prepare()
+ * @checksum: the checksum of the program
+ *
+ * Saves the binary of the program. The file is written in a thread.
+ */
+void
+gsk_gl_program_cache_save (GskGLProgramCache *self,
+                           GLuint             program_id,
+                           const char        *checksum)
+{
+  FileHeader *header;
+  GLint size = 0;
+  GLenum format;
+  SaveJob *job;
+  GTask *task;
+
+  glGetProgramiv (program_id, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0)
+    return;
+
+  header = g_malloc (sizeof (FileHeader) + size);
+  glGetProgramBinary (program_id, size, &size, &format, header + 1);
+
+  memcpy (header->magic, MAGIC, 8);
+  header->version = VERSION;
+  header->format = format;
+  header->size = size;
+  header->reserved = 0;
+
+  job = g_new0 (SaveJob, 1);
+  job->path = g_build_filename (self->dir, checksum, NULL);
+  job->contents = g_bytes_new_take (header, sizeof (FileHeader) + size);
+
+  task = g_task_new (NULL, NULL, NULL, NULL);
+  g_task_set_source_tag (task, gsk_gl_program_cache_save);
+  g_task_set_task_data (task, job, save_job_free);
+  g_task_run_in_thread (task, save_job_run);
+  g_object_unref (task);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <gdk/gdk.h>
+#include <epoxy/gl.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GskGLProgramCache GskGLProgramCache;
+
+GskGLProgramCache *     gsk_gl_program_cache_new                (GdkGLContext           *context);
+GskGLProgramCache *     gsk_gl_program_cache_ref                (GskGLProgramCache      *self);
+void                    gsk_gl_program_cache_unref              (GskGLProgramCache      *self);
+
+void                    gsk_gl_program_cache_prepare            (GskGLProgramCache      *self,
+                                                                 GLuint                  program_id);
+GBytes *                gsk_gl_program_cache_lookup             (GskGLProgramCache      *self,
+                                                                 const char             *checksum);
+gboolean                gsk_gl_program_cache_load               (GskGLProgramCache      *self,
+                                                                 GLuint                  program_id,
+                                                                 const char             *checksum);
+void                    gsk_gl_program_cache_save               (GskGLProgramCache      *self,
+                                                                 GLuint                  program_id,
+                                                                 const char             *checksum);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GskGLProgramCache, gsk_gl_program_cache_unref)
+
+G_END_DECLS
@@ -40,6 +40,7 @@
 
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
+#include "gskrendernodebinaryprivate.h"
 #include "gskrendernodeparserprivate.h"
 
 #include "gdk/gdkcairoprivate.h"
@@ -686,6 +687,9 @@ gsk_render_node_write_to_file (GskRenderNode *node,
  *
  * For a discussion of the supported format, see that function.
  *
+ * Data in the binary format used by GTK's debugging tools is
+ * accepted, too.
+ *
  * Returns: (nullable) (transfer full): a new `GskRenderNode`
  */
 GskRenderNode *
@@ -695,7 +699,10 @@ gsk_render_node_deserialize (GBytes            *bytes,
 {
   GskRenderNode *node = NULL;
 
-  node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
+  if (gsk_render_node_is_binary (bytes))
+    node = gsk_render_node_deserialize_binary (bytes, error_func, user_data);
+  else
+    node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
 
   return node;
 }
@@ -0,0 +1,2821 @@
+#include "config.h"
+
+#include "gskrendernodebinaryprivate.h"
+
+#include "gskglshader.h"
+#include "gskpath.h"
+#include "gskpathbuilder.h"
+#include "gskprivate.h"
+#include "gskrendernodeparserprivate.h"
+#include "gskrendernodeprivate.h"
+#include "gskstroke.h"
+#include "gsktransformprivate.h"
+
+#include "gdk/gdkcolorprivate.h"
+#include "gdk/gdkcolorstateprivate.h"
+#include "gdk/gdkmemoryformatprivate.h"
+#include <gtk/css/gtkcss.h>
+
+#include <pango/pangocairo.h>
+#include <string.h>
+
+/* The binary format is a header followed by a stream of records.
+ *
+ * Every record starts with a 32bit tag. Node records use the node type
+ * as their tag and are followed by their fields and then their children,
+ * so the tree is stored in prefix order. Everything a node refers to -
+ * textures, fonts, glyph runs, paths, ... - is stored once in a
+ * definition record right before the first node that uses it and
+ * referred to by index afterwards. Nodes that are used more than once
+ * are referred to by the index in which they finished decoding.
+ *
+ * This way a file can be written and read in a single pass.
+ *
+ * For recording traces, multiple nodes can be written as a sequence of
+ * frames with a GskRenderNodeBinaryWriter. Everything that was used by
+ * the previous frame can be referred to in the next one without being
+ * stored again, so unchanged subtrees are only stored once. Everything
+ * else is forgotten after each frame, by the writer and the reader
+ * alike.
+ *
+ * All values are stored in the byte order of the machine that wrote
+ * the file and are 4 byte aligned. Pixel data is stored uncompressed
+ * if compression doesn't help and is aligned to 16 bytes, so textures
+ * can use the data directly when the file is mapped into memory.
+ */
+
+#define MAGIC "GSKRNODE"
+#define BYTE_ORDER_MARK 0x01020304
+#define VERSION 1
+
+#define DATA_ALIGNMENT 16
+/* Don't bother compressing small things */
+#define MIN_COMPRESS_SIZE 4096
+/* The maximum compression ratio of deflate */
+#define MAX_COMPRESS_RATIO 1032
+#define MAX_DEPTH 1024
+
+typedef enum {
+  TAG_NODE_REF = 0x1000,
+  TAG_COLOR_STATE,
+  TAG_TEXTURE,
+  TAG_SURFACE,
+  TAG_FONT,
+  TAG_GLYPHS,
+  TAG_PATH,
+  TAG_SHADER,
+} Tag;
+
+typedef enum {
+  COMPRESSION_NONE,
+  COMPRESSION_ZLIB,
+} Compression;
+
+typedef enum {
+  TRANSFORM_IDENTITY,
+  TRANSFORM_TRANSLATE,
+  TRANSFORM_AFFINE,
+  TRANSFORM_STRING,
+} TransformType;
+
+typedef struct _Header Header;
+typedef struct _WriterEntry WriterEntry;
+typedef struct _WriterTable WriterTable;
+typedef struct _ReaderTable ReaderTable;
+typedef struct _GskRenderNodeBinaryWriter Writer;
+typedef struct _GskRenderNodeBinaryReader Reader;
+
+struct _Header
+{
+  char magic[8];
+  guint32 byte_order;
+  guint32 version;
+  guint32 reserved[4];
+};
+
+/* Keeps the data aligned relative to the start of the file */
+G_STATIC_ASSERT (sizeof (Header) % DATA_ALIGNMENT == 0);
+
+struct _WriterEntry
+{
+  guint32 index;
+  /* the last frame that used the entry */
+  guint32 frame;
+};
+
+struct _WriterTable
+{
+  GHashTable *entries;
+  guint32 n_entries;
+};
+
+struct _GskRenderNodeBinaryWriter
+{
+  GByteArray *data;
+  /* the fields of the current node, they are appended to
+   * data after all the definitions they need */
+  GByteArray *fields;
+
+  guint32 frame;
+
+  WriterTable nodes;
+  WriterTable color_states;
+  WriterTable textures;
+  WriterTable surfaces;
+  WriterTable fonts;
+  WriterTable glyphs;
+  WriterTable paths;
+  WriterTable shaders;
+  /* faces that have been embedded, these are never forgotten */
+  GHashTable *faces;
+
+  guint32 n_path_ops;
+};
+
+struct _ReaderTable
+{
+  GPtrArray *objects;
+  GArray *frames;
+  GDestroyNotify free_func;
+};
+
+struct _GskRenderNodeBinaryReader
+{
+  GBytes *bytes;
+  const guchar *data;
+  gsize size;
+  gsize pos;
+  guint depth;
+  GError *error;
+
+  guint32 frame;
+
+  ReaderTable nodes;
+  ReaderTable color_states;
+  ReaderTable textures;
+  ReaderTable surfaces;
+  ReaderTable fonts;
+  ReaderTable glyphs;
+  ReaderTable paths;
+  ReaderTable shaders;
+  PangoFontMap *fontmap;
+};
+
+/* {{{ Compression */
+
+static GBytes *
+compress_data (const guchar *data,
+               gsize         size)
+{
+  GConverter *compressor;
+  GConverterResult result;
+  gsize max_size, n_read, n_written, in_pos, out_pos;
+  guchar *out;
+
+  /* Only keep the compressed data if it is a good bit smaller */
+  max_size = size / 4 * 3;
+  out = g_malloc (max_size);
+  compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, 1));
+
+  in_pos = out_pos = 0;
+  do
+    {
+      result = g_converter_convert (compressor,
+                                    data + in_pos, size - in_pos,
+                                    out + out_pos, max_size - out_pos,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &n_read, &n_written,
+                                    NULL);
+      in_pos += n_read;
+      out_pos += n_written;
+    }
+  while (result == G_CONVERTER_CONVERTED && out_pos < max_size);
+
+  g_object_unref (compressor);
+
+  if (result != G_CONVERTER_FINISHED)
+    {
+      g_free (out);
+      return NULL;
+    }
+
+  return g_bytes_new_take (out, out_pos);
+}
+
+static GBytes *
+decompress_data (const guchar *data,
+                 gsize         size,
+                 gsize         uncompressed_size)
+{
+  GConverter *decompressor;
+  GConverterResult result;
+  gsize n_read, n_written, in_pos, out_pos;
+  guchar *out;
+
+  if (uncompressed_size == 0 || uncompressed_size / MAX_COMPRESS_RATIO > size)
+    return NULL;
+
+  out = g_try_malloc (uncompressed_size);
+  if (out == NULL)
+    return NULL;
+
+  decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+
+  in_pos = out_pos = 0;
+  do
+    {
+      result = g_converter_convert (decompressor,
+                                    data + in_pos, size - in_pos,
+                                    out + out_pos, uncompressed_size - out_pos,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &n_read, &n_written,
+                                    NULL);
+      in_pos += n_read;
+      out_pos += n_written;
+    }
+  while (result == G_CONVERTER_CONVERTED && out_pos < uncompressed_size);
+
+  g_object_unref (decompressor);
+
+  if (result != G_CONVERTER_FINISHED || out_pos != uncompressed_size)
+    {
+      g_free (out);
+      return NULL;
+    }
+
+  return g_bytes_new_take (out, uncompressed_size);
+}
+
+/* }}} */
+/* {{{ Writing */
+
+static void
+write_uint (GByteArray *array,
+            guint32     value)
+{
+  g_byte_array_append (array, (guchar *) &value, sizeof (value));
+}
+
+static void
+write_uint64 (GByteArray *array,
+              guint64     value)
+{
+  g_byte_array_append (array, (guchar *) &value, sizeof (value));
+}
+
+static void
+write_floats (GByteArray  *array,
+              const float *values,
+              gsize        n_values)
+{
+  g_byte_array_append (array, (guchar *) values, n_values * sizeof (float));
+}
+
+static void
+write_float (GByteArray *array,
+             float       value)
+{
+  write_floats (array, &value, 1);
+}
+
+static void
+write_padding (GByteArray *array,
+               gsize       alignment)
+{
+  static const guchar zeros[DATA_ALIGNMENT] = { 0, };
+
+  if (array->len % alignment)
+    g_byte_array_append (array, zeros, alignment - array->len % alignment);
+}
+
+static void
+write_chunk (GByteArray *array,
+             const void *data,
+             gsize       size)
+{
+  write_uint (array, size);
+  g_byte_array_append (array, data, size);
+  write_padding (array, 4);
+}
+
+static void
+write_string (GByteArray *array,
+              const char *string)
+{
+  if (string)
+    write_chunk (array, string, strlen (string));
+  else
+    write_uint (array, G_MAXUINT32);
+}
+
+static void
+write_point (GByteArray             *array,
+             const graphene_point_t *point)
+{
+  write_floats (array, (const float[2]) { point->x, point->y }, 2);
+}
+
+static void
+write_rect (GByteArray            *array,
+            const graphene_rect_t *rect)
+{
+  write_floats (array,
+                (const float[4]) { rect->origin.x, rect->origin.y,
+                                   rect->size.width, rect->size.height },
+                4);
+}
+
+static void
+write_rounded_rect (GByteArray           *array,
+                    const GskRoundedRect *rect)
+{
+  gsize i;
+
+  write_rect (array, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    write_floats (array, (const float[2]) { rect->corner[i].width, rect->corner[i].height }, 2);
+}
+
+/* Large data is written to the main stream only, so its alignment
+ * is relative to the start of the file.
+ */
+static void
+write_data (Writer       *writer,
+            const guchar *data,
+            gsize         size)
+{
+  GBytes *compressed = NULL;
+  const guchar *stored;
+  gsize stored_size;
+
+  if (size >= MIN_COMPRESS_SIZE)
+    compressed = compress_data (data, size);
+
+  if (compressed)
+    {
+      stored = g_bytes_get_data (compressed, &stored_size);
+      write_uint (writer->data, COMPRESSION_ZLIB);
+    }
+  else
+    {
+      stored = data;
+      stored_size = size;
+      write_uint (writer->data, COMPRESSION_NONE);
+    }
+
+  write_uint64 (writer->data, size);
+  write_uint64 (writer->data, stored_size);
+  write_padding (writer->data, DATA_ALIGNMENT);
+  g_byte_array_append (writer->data, stored, stored_size);
+  write_padding (writer->data, 4);
+
+  g_clear_pointer (&compressed, g_bytes_unref);
+}
+
+static void
+writer_table_init (WriterTable    *table,
+                   GHashFunc       hash_func,
+                   GEqualFunc      equal_func,
+                   GDestroyNotify  key_free_func)
+{
+  table->entries = g_hash_table_new_full (hash_func, equal_func, key_free_func, g_free);
+  table->n_entries = 0;
+}
+
+static gboolean
+writer_entry_is_unused (gpointer key,
+                        gpointer value,
+                        gpointer frame)
+{
+  WriterEntry *entry = value;
+
+  return entry->frame != GPOINTER_TO_UINT (frame);
+}
+
+/* Forget everything that the current frame didn't use */
+static void
+writer_table_prune (Writer      *writer,
+                    WriterTable *table)
+{
+  g_hash_table_foreach_remove (table->entries,
+                               writer_entry_is_unused,
+                               GUINT_TO_POINTER (writer->frame));
+}
+
+static gboolean
+writer_lookup (Writer        *writer,
+               WriterTable   *table,
+               gconstpointer  key,
+               guint32       *out_index)
+{
+  WriterEntry *entry;
+
+  entry = g_hash_table_lookup (table->entries, key);
+  if (entry == NULL)
+    return FALSE;
+
+  entry->frame = writer->frame;
+  *out_index = entry->index;
+  return TRUE;
+}
+
+/* Takes ownership of key */
+static guint32
+writer_insert (Writer      *writer,
+               WriterTable *table,
+               gpointer     key)
+{
+  WriterEntry *entry;
+
+  entry = g_new (WriterEntry, 1);
+  entry->index = table->n_entries++;
+  entry->frame = writer->frame;
+  g_hash_table_insert (table->entries, key, entry);
+
+  return entry->index;
+}
+
+static guint32
+writer_add_color_state (Writer        *writer,
+                        GdkColorState *color_state)
+{
+  const GdkCicp *cicp;
+  guint32 index;
+
+  if (GDK_IS_DEFAULT_COLOR_STATE (color_state))
+    return GDK_DEFAULT_COLOR_STATE_ID (color_state);
+
+  if (!writer_lookup (writer, &writer->color_states, color_state, &index))
+    {
+      cicp = gdk_color_state_get_cicp (color_state);
+
+      write_uint (writer->data, TAG_COLOR_STATE);
+      write_uint (writer->data, cicp->color_primaries);
+      write_uint (writer->data, cicp->transfer_function);
+      write_uint (writer->data, cicp->matrix_coefficients);
+      write_uint (writer->data, cicp->range);
+
+      index = writer_insert (writer, &writer->color_states, gdk_color_state_ref (color_state));
+    }
+
+  return GDK_COLOR_STATE_N_IDS + index;
+}
+
+static void
+write_color (Writer         *writer,
+             const GdkColor *color)
+{
+  write_uint (writer->fields, writer_add_color_state (writer, color->color_state));
+  write_floats (writer->fields, color->values, 4);
+}
+
+static void
+write_stops (Writer              *writer,
+             const GskColorStop2 *stops,
+             gsize                n_stops)
+{
+  gsize i;
+
+  write_uint (writer->fields, n_stops);
+  for (i = 0; i < n_stops; i++)
+    {
+      write_float (writer->fields, stops[i].offset);
+      write_color (writer, &stops[i].color);
+    }
+}
+
+static guint32
+writer_add_texture (Writer     *writer,
+                    GdkTexture *texture)
+{
+  GdkTextureDownloader *downloader;
+  GdkColorState *color_state;
+  GdkMemoryFormat format;
+  guint32 index, color_state_index;
+  GBytes *bytes;
+  gsize stride;
+
+  if (writer_lookup (writer, &writer->textures, texture, &index))
+    return index;
+
+  format = gdk_texture_get_format (texture);
+  color_state = gdk_texture_get_color_state (texture);
+  color_state_index = writer_add_color_state (writer, color_state);
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, format);
+  gdk_texture_downloader_set_color_state (downloader, color_state);
+  bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+  gdk_texture_downloader_free (downloader);
+
+  write_uint (writer->data, TAG_TEXTURE);
+  write_uint (writer->data, gdk_texture_get_width (texture));
+  write_uint (writer->data, gdk_texture_get_height (texture));
+  write_uint (writer->data, format);
+  write_uint (writer->data, color_state_index);
+  write_uint (writer->data, stride);
+  write_data (writer, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+
+  g_bytes_unref (bytes);
+
+  return writer_insert (writer, &writer->textures, g_object_ref (texture));
+}
+
+/* The pixels of a cairo node are stored for the integer area
+ * covering its bounds.
+ */
+static void
+get_surface_area (const graphene_rect_t *bounds,
+                  cairo_rectangle_int_t *area)
+{
+  area->x = floorf (bounds->origin.x);
+  area->y = floorf (bounds->origin.y);
+  area->width = ceilf (bounds->origin.x + bounds->size.width) - area->x;
+  area->height = ceilf (bounds->origin.y + bounds->size.height) - area->y;
+}
+
+static guint32
+writer_add_surface (Writer                *writer,
+                    cairo_surface_t       *surface,
+                    const graphene_rect_t *bounds)
+{
+  cairo_rectangle_int_t area;
+  cairo_surface_t *image;
+  guint32 index;
+  cairo_t *cr;
+
+  if (writer_lookup (writer, &writer->surfaces, surface, &index))
+    return index;
+
+  get_surface_area (bounds, &area);
+  image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, area.width, area.height);
+  cr = cairo_create (image);
+  cairo_set_source_surface (cr, surface, - area.x, - area.y);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (image);
+
+  write_uint (writer->data, TAG_SURFACE);
+  write_uint (writer->data, area.width);
+  write_uint (writer->data, area.height);
+  write_uint (writer->data, cairo_image_surface_get_stride (image));
+  write_data (writer,
+              cairo_image_surface_get_data (image),
+              (gsize) cairo_image_surface_get_stride (image) * area.height);
+
+  cairo_surface_destroy (image);
+
+  return writer_insert (writer, &writer->surfaces, cairo_surface_reference (surface));
+}
+
+static guint32
+writer_add_font (Writer    *writer,
+                 PangoFont *font)
+{
+  PangoFontDescription *desc;
+  cairo_scaled_font_t *scaled_font;
+  cairo_font_options_t *options;
+  cairo_hint_style_t hint_style;
+  hb_face_t *face;
+  gboolean embed;
+  guint32 index;
+  char *s;
+
+  if (writer_lookup (writer, &writer->fonts, font, &index))
+    return index;
+
+  desc = pango_font_describe_with_absolute_size (font);
+  s = pango_font_description_to_string (desc);
+  pango_font_description_free (desc);
+
+  scaled_font = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
+  options = cairo_font_options_create ();
+  cairo_scaled_font_get_font_options (scaled_font, options);
+
+  /* medium and full are identical in the absence of subpixel modes */
+  hint_style = cairo_font_options_get_hint_style (options);
+  if (hint_style == CAIRO_HINT_STYLE_MEDIUM)
+    hint_style = CAIRO_HINT_STYLE_FULL;
+
+  /* Like the text format, only embed fonts that were embedded
+   * in the first place, and only once.
+   */
+  face = hb_font_get_face (pango_font_get_hb_font (font));
+  embed = g_object_get_data (G_OBJECT (pango_font_get_font_map (font)), "font-files") != NULL &&
+          !g_hash_table_contains (writer->faces, face);
+
+  write_uint (writer->data, TAG_FONT);
+  write_string (writer->data, s);
+  write_uint (writer->data, hint_style);
+  write_uint (writer->data, cairo_font_options_get_antialias (options));
+  write_uint (writer->data, cairo_font_options_get_hint_metrics (options));
+  write_uint (writer->data, embed);
+  if (embed)
+    {
+      hb_blob_t *blob;
+      const char *data;
+      unsigned int length;
+
+      blob = hb_face_reference_blob (face);
+      data = hb_blob_get_data (blob, &length);
+      write_data (writer, (const guchar *) data, length);
+      hb_blob_destroy (blob);
+
+      g_hash_table_add (writer->faces, hb_face_reference (face));
+    }
+
+  cairo_font_options_destroy (options);
+  g_free (s);
+
+  return writer_insert (writer, &writer->fonts, g_object_ref (font));
+}
+
+static guint32
+writer_add_glyphs (Writer        *writer,
+                   GskRenderNode *node)
+{
+  const PangoGlyphInfo *glyphs;
+  GByteArray *array;
+  GBytes *bytes;
+  guint32 index;
+  guint i, n_glyphs;
+
+  glyphs = gsk_text_node_get_glyphs (node, &n_glyphs);
+
+  array = g_byte_array_sized_new (4 + 20 * n_glyphs);
+  write_uint (array, n_glyphs);
+  for (i = 0; i < n_glyphs; i++)
+    {
+      write_uint (array, glyphs[i].glyph);
+      write_uint (array, glyphs[i].geometry.width);
+      write_uint (array, glyphs[i].geometry.x_offset);
+      write_uint (array, glyphs[i].geometry.y_offset);
+      write_uint (array, (glyphs[i].attr.is_cluster_start ? 1 : 0) |
+                         (glyphs[i].attr.is_color ? 2 : 0));
+    }
+  bytes = g_byte_array_free_to_bytes (array);
+
+  if (writer_lookup (writer, &writer->glyphs, bytes, &index))
+    {
+      g_bytes_unref (bytes);
+      return index;
+    }
+
+  write_uint (writer->data, TAG_GLYPHS);
+  g_byte_array_append (writer->data,
+                       g_bytes_get_data (bytes, NULL),
+                       g_bytes_get_size (bytes));
+
+  return writer_insert (writer, &writer->glyphs, bytes);
+}
+
+static gboolean
+write_path_operation (GskPathOperation        op,
+                      const graphene_point_t *pts,
+                      gsize                   n_pts,
+                      float                   weight,
+                      gpointer                user_data)
+{
+  Writer *writer = user_data;
+  gsize i;
+
+  write_uint (writer->data, op);
+  switch (op)
+    {
+    case GSK_PATH_MOVE:
+      write_point (writer->data, &pts[0]);
+      break;
+
+    case GSK_PATH_CLOSE:
+      break;
+
+    case GSK_PATH_LINE:
+    case GSK_PATH_QUAD:
+    case GSK_PATH_CUBIC:
+      for (i = 1; i < n_pts; i++)
+        write_point (writer->data, &pts[i]);
+      break;
+
+    case GSK_PATH_CONIC:
+      write_point (writer->data, &pts[1]);
+      write_point (writer->data, &pts[2]);
+      write_float (writer->data, weight);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  writer->n_path_ops++;
+
+  return TRUE;
+}
+
+static guint32
+writer_add_path (Writer  *writer,
+                 GskPath *path)
+{
+  guint32 index;
+  gsize pos;
+
+  if (writer_lookup (writer, &writer->paths, path, &index))
+    return index;
+
+  write_uint (writer->data, TAG_PATH);
+  pos = writer->data->len;
+  write_uint (writer->data, 0);
+
+  writer->n_path_ops = 0;
+  gsk_path_foreach (path,
+                    GSK_PATH_FOREACH_ALLOW_QUAD |
+                    GSK_PATH_FOREACH_ALLOW_CUBIC |
+                    GSK_PATH_FOREACH_ALLOW_CONIC,
+                    write_path_operation,
+                    writer);
+  memcpy (writer->data->data + pos, &writer->n_path_ops, sizeof (guint32));
+
+  return writer_insert (writer, &writer->paths, gsk_path_ref (path));
+}
+
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+static guint32
+writer_add_shader (Writer      *writer,
+                   GskGLShader *shader)
+{
+  GBytes *source;
+  guint32 index;
+
+  if (writer_lookup (writer, &writer->shaders, shader, &index))
+    return index;
+
+  source = gsk_gl_shader_get_source (shader);
+
+  write_uint (writer->data, TAG_SHADER);
+  write_chunk (writer->data,
+               g_bytes_get_data (source, NULL),
+               g_bytes_get_size (source));
+
+  return writer_insert (writer, &writer->shaders, g_object_ref (shader));
+}
+G_GNUC_END_IGNORE_DEPRECATIONS
+
+static void
+write_transform (Writer       *writer,
+                 GskTransform *transform)
+{
+  float dx, dy, scale_x, scale_y;
+  char *s;
+
+  switch (gsk_transform_get_fine_category (transform))
+    {
+    case GSK_FINE_TRANSFORM_CATEGORY_IDENTITY:
+      write_uint (writer->fields, TRANSFORM_IDENTITY);
+      break;
+
+    case GSK_FINE_TRANSFORM_CATEGORY_2D_TRANSLATE:
+      gsk_transform_to_translate (transform, &dx, &dy);
+      write_uint (writer->fields, TRANSFORM_TRANSLATE);
+      write_floats (writer->fields, (const float[2]) { dx, dy }, 2);
+      break;
+
+    case GSK_FINE_TRANSFORM_CATEGORY_2D_AFFINE:
+    case GSK_FINE_TRANSFORM_CATEGORY_2D_NEGATIVE_AFFINE:
+      gsk_transform_to_affine (transform, &scale_x, &scale_y, &dx, &dy);
+      write_uint (writer->fields, TRANSFORM_AFFINE);
+      write_floats (writer->fields, (const float[4]) { scale_x, scale_y, dx, dy }, 4);
+      break;
+
+    case GSK_FINE_TRANSFORM_CATEGORY_UNKNOWN:
+    case GSK_FINE_TRANSFORM_CATEGORY_ANY:
+    case GSK_FINE_TRANSFORM_CATEGORY_3D:
+    case GSK_FINE_TRANSFORM_CATEGORY_2D:
+    case GSK_FINE_TRANSFORM_CATEGORY_2D_DIHEDRAL:
+    default:
+      /* The string keeps the individual steps, and with them the category */
+      s = gsk_transform_to_string (transform);
+      write_uint (writer->fields, TRANSFORM_STRING);
+      write_string (writer->fields, s);
+      g_free (s);
+      break;
+    }
+}
+
+static void
+write_stroke (Writer          *writer,
+              const GskStroke *stroke)
+{
+  const float *dash;
+  gsize n_dash;
+
+  dash = gsk_stroke_get_dash (stroke, &n_dash);
+
+  write_float (writer->fields, gsk_stroke_get_line_width (stroke));
+  write_uint (writer->fields, gsk_stroke_get_line_cap (stroke));
+  write_uint (writer->fields, gsk_stroke_get_line_join (stroke));
+  write_float (writer->fields, gsk_stroke_get_miter_limit (stroke));
+  write_uint (writer->fields, n_dash);
+  write_floats (writer->fields, dash, n_dash);
+  write_float (writer->fields, gsk_stroke_get_dash_offset (stroke));
+}
+
+static void write_node (Writer        *writer,
+                        GskRenderNode *node);
+
+/* Writes the fields of the node and returns its children */
+static GskRenderNode **
+write_node_fields (Writer        *writer,
+                   GskRenderNode *node,
+                   gsize         *n_children)
+{
+  GskRenderNode **children;
+  GByteArray *fields = writer->fields;
+  gsize i;
+
+  children = g_new (GskRenderNode *, 2);
+  *n_children = 0;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        guint n;
+
+        g_free (children);
+        children = g_memdup2 (gsk_container_node_get_children (node, &n), n * sizeof (GskRenderNode *));
+        *n_children = n;
+        write_uint (fields, n);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = gsk_cairo_node_get_surface (node);
+
+        write_rect (fields, &node->bounds);
+        if (surface)
+          write_uint (fields, writer_add_surface (writer, surface, &node->bounds));
+        else
+          write_uint (fields, G_MAXUINT32);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      write_rect (fields, &node->bounds);
+      write_color (writer, gsk_color_node_get_color2 (node));
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      write_rect (fields, &node->bounds);
+      write_point (fields, gsk_linear_gradient_node_get_start (node));
+      write_point (fields, gsk_linear_gradient_node_get_end (node));
+      write_uint (fields, writer_add_color_state (writer, gsk_linear_gradient_node_get_interpolation_color_state (node)));
+      write_uint (fields, gsk_linear_gradient_node_get_hue_interpolation (node));
+      write_stops (writer,
+                   gsk_linear_gradient_node_get_color_stops2 (node),
+                   gsk_linear_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+      write_rect (fields, &node->bounds);
+      write_point (fields, gsk_radial_gradient_node_get_center (node));
+      write_float (fields, gsk_radial_gradient_node_get_hradius (node));
+      write_float (fields, gsk_radial_gradient_node_get_vradius (node));
+      write_float (fields, gsk_radial_gradient_node_get_start (node));
+      write_float (fields, gsk_radial_gradient_node_get_end (node));
+      write_uint (fields, writer_add_color_state (writer, gsk_radial_gradient_node_get_interpolation_color_state (node)));
+      write_uint (fields, gsk_radial_gradient_node_get_hue_interpolation (node));
+      write_stops (writer,
+                   gsk_radial_gradient_node_get_color_stops2 (node),
+                   gsk_radial_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_CONIC_GRADIENT_NODE:
+      write_rect (fields, &node->bounds);
+      write_point (fields, gsk_conic_gradient_node_get_center (node));
+      write_float (fields, gsk_conic_gradient_node_get_rotation (node));
+      write_uint (fields, writer_add_color_state (writer, gsk_conic_gradient_node_get_interpolation_color_state (node)));
+      write_uint (fields, gsk_conic_gradient_node_get_hue_interpolation (node));
+      write_stops (writer,
+                   gsk_conic_gradient_node_get_color_stops2 (node),
+                   gsk_conic_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_BORDER_NODE:
+      write_rounded_rect (fields, gsk_border_node_get_outline (node));
+      write_floats (fields, gsk_border_node_get_widths (node), 4);
+      for (i = 0; i < 4; i++)
+        write_color (writer, &gsk_border_node_get_colors2 (node)[i]);
+      break;
+
+    case GSK_TEXTURE_NODE:
+      write_rect (fields, &node->bounds);
+      write_uint (fields, writer_add_texture (writer, gsk_texture_node_get_texture (node)));
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      write_rounded_rect (fields, gsk_inset_shadow_node_get_outline (node));
+      write_color (writer, gsk_inset_shadow_node_get_color2 (node));
+      write_point (fields, gsk_inset_shadow_node_get_offset (node));
+      write_float (fields, gsk_inset_shadow_node_get_spread (node));
+      write_float (fields, gsk_inset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      write_rounded_rect (fields, gsk_outset_shadow_node_get_outline (node));
+      write_color (writer, gsk_outset_shadow_node_get_color2 (node));
+      write_point (fields, gsk_outset_shadow_node_get_offset (node));
+      write_float (fields, gsk_outset_shadow_node_get_spread (node));
+      write_float (fields, gsk_outset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      write_transform (writer, gsk_transform_node_get_transform (node));
+      children[(*n_children)++] = gsk_transform_node_get_child (node);
+      break;
+
+    case GSK_OPACITY_NODE:
+      write_float (fields, gsk_opacity_node_get_opacity (node));
+      children[(*n_children)++] = gsk_opacity_node_get_child (node);
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        float values[16];
+
+        graphene_matrix_to_float (gsk_color_matrix_node_get_color_matrix (node), values);
+        write_floats (fields, values, 16);
+        graphene_vec4_to_float (gsk_color_matrix_node_get_color_offset (node), values);
+        write_floats (fields, values, 4);
+        children[(*n_children)++] = gsk_color_matrix_node_get_child (node);
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      write_rect (fields, &node->bounds);
+      write_rect (fields, gsk_repeat_node_get_child_bounds (node));
+      children[(*n_children)++] = gsk_repeat_node_get_child (node);
+      break;
+
+    case GSK_CLIP_NODE:
+      write_rect (fields, gsk_clip_node_get_clip (node));
+      children[(*n_children)++] = gsk_clip_node_get_child (node);
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      write_rounded_rect (fields, gsk_rounded_clip_node_get_clip (node));
+      children[(*n_children)++] = gsk_rounded_clip_node_get_child (node);
+      break;
+
+    case GSK_SHADOW_NODE:
+      write_uint (fields, gsk_shadow_node_get_n_shadows (node));
+      for (i = 0; i < gsk_shadow_node_get_n_shadows (node); i++)
+        {
+          const GskShadow2 *shadow = gsk_shadow_node_get_shadow2 (node, i);
+
+          write_color (writer, &shadow->color);
+          write_point (fields, &shadow->offset);
+          write_float (fields, shadow->radius);
+        }
+      children[(*n_children)++] = gsk_shadow_node_get_child (node);
+      break;
+
+    case GSK_BLEND_NODE:
+      write_uint (fields, gsk_blend_node_get_blend_mode (node));
+      children[(*n_children)++] = gsk_blend_node_get_bottom_child (node);
+      children[(*n_children)++] = gsk_blend_node_get_top_child (node);
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      write_float (fields, gsk_cross_fade_node_get_progress (node));
+      children[(*n_children)++] = gsk_cross_fade_node_get_start_child (node);
+      children[(*n_children)++] = gsk_cross_fade_node_get_end_child (node);
+      break;
+
+    case GSK_TEXT_NODE:
+      write_uint (fields, writer_add_font (writer, gsk_text_node_get_font (node)));
+      write_uint (fields, writer_add_glyphs (writer, node));
+      write_color (writer, gsk_text_node_get_color2 (node));
+      write_point (fields, gsk_text_node_get_offset (node));
+      break;
+
+    case GSK_BLUR_NODE:
+      write_float (fields, gsk_blur_node_get_radius (node));
+      children[(*n_children)++] = gsk_blur_node_get_child (node);
+      break;
+
+    case GSK_DEBUG_NODE:
+      write_string (fields, gsk_debug_node_get_message (node));
+      children[(*n_children)++] = gsk_debug_node_get_child (node);
+      break;
+
+    case GSK_GL_SHADER_NODE:
+      {
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+        GBytes *args = gsk_gl_shader_node_get_args (node);
+        guint n = gsk_gl_shader_node_get_n_children (node);
+
+        write_rect (fields, &node->bounds);
+        write_uint (fields, writer_add_shader (writer, gsk_gl_shader_node_get_shader (node)));
+        write_chunk (fields, g_bytes_get_data (args, NULL), g_bytes_get_size (args));
+        write_uint (fields, n);
+
+        g_free (children);
+        children = g_new (GskRenderNode *, MAX (n, 1));
+        for (i = 0; i < n; i++)
+          children[(*n_children)++] = gsk_gl_shader_node_get_child (node, i);
+G_GNUC_END_IGNORE_DEPRECATIONS
+      }
+      break;
+
+    case GSK_TEXTURE_SCALE_NODE:
+      write_rect (fields, &node->bounds);
+      write_uint (fields, gsk_texture_scale_node_get_filter (node));
+      write_uint (fields, writer_add_texture (writer, gsk_texture_scale_node_get_texture (node)));
+      break;
+
+    case GSK_MASK_NODE:
+      write_uint (fields, gsk_mask_node_get_mask_mode (node));
+      children[(*n_children)++] = gsk_mask_node_get_source (node);
+      children[(*n_children)++] = gsk_mask_node_get_mask (node);
+      break;
+
+    case GSK_FILL_NODE:
+      write_uint (fields, writer_add_path (writer, gsk_fill_node_get_path (node)));
+      write_uint (fields, gsk_fill_node_get_fill_rule (node));
+      children[(*n_children)++] = gsk_fill_node_get_child (node);
+      break;
+
+    case GSK_STROKE_NODE:
+      write_uint (fields, writer_add_path (writer, gsk_stroke_node_get_path (node)));
+      write_stroke (writer, gsk_stroke_node_get_stroke (node));
+      children[(*n_children)++] = gsk_stroke_node_get_child (node);
+      break;
+
+    case GSK_SUBSURFACE_NODE:
+      children[(*n_children)++] = gsk_subsurface_node_get_child (node);
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+    }
+
+  return children;
+}
+
+static void
+write_node (Writer        *writer,
+            GskRenderNode *node)
+{
+  GskRenderNode **children;
+  gsize i, n_children;
+  guint32 index;
+
+  if (writer_lookup (writer, &writer->nodes, node, &index))
+    {
+      write_uint (writer->data, TAG_NODE_REF);
+      write_uint (writer->data, index);
+      return;
+    }
+
+  /* This writes the definitions the node needs to the data
+   * and the fields of the node to the side, so they can
+   * follow the definitions.
+   */
+  children = write_node_fields (writer, node, &n_children);
+
+  write_uint (writer->data, gsk_render_node_get_node_type (node));
+  g_byte_array_append (writer->data, writer->fields->data, writer->fields->len);
+  g_byte_array_set_size (writer->fields, 0);
+
+  for (i = 0; i < n_children; i++)
+    write_node (writer, children[i]);
+
+  g_free (children);
+
+  /* The reader adds nodes when they are done, so do the same */
+  writer_insert (writer, &writer->nodes, gsk_render_node_ref (node));
+}
+
+/*<private>
+ * gsk_render_node_binary_writer_new:
+ *
+ * Creates a writer for storing a sequence of nodes, such as the
+ * frames of a recording.
+ *
+ * Returns: (transfer full): a new writer
+ */
+GskRenderNodeBinaryWriter *
+gsk_render_node_binary_writer_new (void)
+{
+  Writer *writer;
+
+  writer = g_new0 (Writer, 1);
+  writer->data = g_byte_array_new ();
+  writer->fields = g_byte_array_new ();
+  writer_table_init (&writer->nodes, NULL, NULL, (GDestroyNotify) gsk_render_node_unref);
+  writer_table_init (&writer->color_states, NULL, NULL, (GDestroyNotify) gdk_color_state_unref);
+  writer_table_init (&writer->textures, NULL, NULL, g_object_unref);
+  writer_table_init (&writer->surfaces, NULL, NULL, (GDestroyNotify) cairo_surface_destroy);
+  writer_table_init (&writer->fonts, NULL, NULL, g_object_unref);
+  writer_table_init (&writer->glyphs, g_bytes_hash, g_bytes_equal, (GDestroyNotify) g_bytes_unref);
+  writer_table_init (&writer->paths, NULL, NULL, (GDestroyNotify) gsk_path_unref);
+  writer_table_init (&writer->shaders, NULL, NULL, g_object_unref);
+  writer->faces = g_hash_table_new_full (NULL, NULL, (GDestroyNotify) hb_face_destroy, NULL);
+
+  return writer;
+}
+
+void
+gsk_render_node_binary_writer_free (GskRenderNodeBinaryWriter *writer)
+{
+  g_byte_array_unref (writer->data);
+  g_byte_array_unref (writer->fields);
+  g_hash_table_unref (writer->nodes.entries);
+  g_hash_table_unref (writer->color_states.entries);
+  g_hash_table_unref (writer->textures.entries);
+  g_hash_table_unref (writer->surfaces.entries);
+  g_hash_table_unref (writer->fonts.entries);
+  g_hash_table_unref (writer->glyphs.entries);
+  g_hash_table_unref (writer->paths.entries);
+  g_hash_table_unref (writer->shaders.entries);
+  g_hash_table_unref (writer->faces);
+  g_free (writer);
+}
+
+/*<private>
+ * gsk_render_node_binary_writer_write:
+ * @writer: a writer
+ * @node: the node to store
+ *
+ * Stores the next node of the sequence.
+ *
+ * The result can only be read by a `GskRenderNodeBinaryReader` that
+ * has read all the previous results of @writer. The data is aligned
+ * so that it can be used in place if it is stored at a 16 byte
+ * boundary.
+ *
+ * Returns: (transfer full): the data for @node
+ */
+GBytes *
+gsk_render_node_binary_writer_write (GskRenderNodeBinaryWriter *writer,
+                                     GskRenderNode             *node)
+{
+  GBytes *result;
+
+  writer->frame++;
+
+  write_node (writer, node);
+
+  writer_table_prune (writer, &writer->nodes);
+  writer_table_prune (writer, &writer->color_states);
+  writer_table_prune (writer, &writer->textures);
+  writer_table_prune (writer, &writer->surfaces);
+  writer_table_prune (writer, &writer->fonts);
+  writer_table_prune (writer, &writer->glyphs);
+  writer_table_prune (writer, &writer->paths);
+  writer_table_prune (writer, &writer->shaders);
+
+  result = g_byte_array_free_to_bytes (writer->data);
+  writer->data = g_byte_array_new ();
+
+  return result;
+}
+
+/*<private>
+ * gsk_render_node_serialize_binary:
+ * @node: a `GskRenderNode`
+ *
+ * Serializes @node into the binary format.
+ *
+ * This is much faster to write and read than the text format
+ * produced by gsk_render_node_serialize(), but it can only be read
+ * on machines with the same byte order.
+ *
+ * gsk_render_node_deserialize() accepts both formats.
+ *
+ * Returns: (transfer full): the serialized node
+ */
+GBytes *
+gsk_render_node_serialize_binary (GskRenderNode *node)
+{
+  Header header = {
+    .magic = MAGIC,
+    .byte_order = BYTE_ORDER_MARK,
+    .version = VERSION,
+  };
+  GskRenderNodeBinaryWriter *writer;
+  GBytes *result;
+
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
+
+  writer = gsk_render_node_binary_writer_new ();
+
+  g_byte_array_append (writer->data, (guchar *) &header, sizeof (header));
+  result = gsk_render_node_binary_writer_write (writer, node);
+
+  gsk_render_node_binary_writer_free (writer);
+
+  return result;
+}
+
+/* }}} */
+/* {{{ Reading */
+
+static void G_GNUC_PRINTF (2, 3)
+reader_error (Reader     *reader,
+              const char *format,
+              ...)
+{
+  va_list args;
+
+  if (reader->error)
+    return;
+
+  va_start (args, format);
+  reader->error = g_error_new_valist (GTK_CSS_PARSER_ERROR,
+                                      GTK_CSS_PARSER_ERROR_SYNTAX,
+                                      format,
+                                      args);
+  va_end (args);
+}
+
+/* All read functions return 0 after an error, so callers
+ * only need to check for errors before using what they read.
+ */
+static gboolean
+reader_ensure (Reader *reader,
+               gsize   size)
+{
+  if (reader->error)
+    return FALSE;
+
+  if (reader->size - reader->pos < size)
+    {
+      reader_error (reader, "Unexpected end of data");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static guint32
+read_uint (Reader *reader)
+{
+  guint32 value;
+
+  if (!reader_ensure (reader, sizeof (value)))
+    return 0;
+
+  memcpy (&value, reader->data + reader->pos, sizeof (value));
+  reader->pos += sizeof (value);
+
+  return value;
+}
+
+static guint64
+read_uint64 (Reader *reader)
+{
+  guint64 value;
+
+  if (!reader_ensure (reader, sizeof (value)))
+    return 0;
+
+  memcpy (&value, reader->data + reader->pos, sizeof (value));
+  reader->pos += sizeof (value);
+
+  return value;
+}
+
+static void
+read_floats (Reader *reader,
+             float  *values,
+             gsize   n_values)
+{
+  if (!reader_ensure (reader, n_values * sizeof (float)))
+    {
+      memset (values, 0, n_values * sizeof (float));
+      return;
+    }
+
+  memcpy (values, reader->data + reader->pos, n_values * sizeof (float));
+  reader->pos += n_values * sizeof (float);
+}
+
+static float
+read_float (Reader *reader)
+{
+  float value;
+
+  read_floats (reader, &value, 1);
+
+  return value;
+}
+
+static guint32
+read_enum (Reader     *reader,
+           guint32     n_values,
+           const char *name)
+{
+  guint32 value = read_uint (reader);
+
+  if (value >= n_values)
+    {
+      reader_error (reader, "Invalid %s %u", name, value);
+      return 0;
+    }
+
+  return value;
+}
+
+/* Reads the number of elements that follow and makes sure
+ * there is enough data for them.
+ */
+static guint32
+read_count (Reader *reader,
+            gsize   element_size)
+{
+  guint32 count = read_uint (reader);
+
+  if (!reader_ensure (reader, count * element_size))
+    return 0;
+
+  return count;
+}
+
+static void
+read_padding (Reader *reader,
+              gsize   alignment)
+{
+  if (reader->pos % alignment)
+    reader_ensure (reader, alignment - reader->pos % alignment);
+
+  if (!reader->error && reader->pos % alignment)
+    reader->pos += alignment - reader->pos % alignment;
+}
+
+static const guchar *
+read_chunk (Reader *reader,
+            gsize  *size)
+{
+  const guchar *data;
+
+  *size = read_count (reader, 1);
+  if (reader->error)
+    return NULL;
+
+  data = reader->data + reader->pos;
+  reader->pos += *size;
+  read_padding (reader, 4);
+
+  return data;
+}
+
+static char *
+read_string (Reader *reader)
+{
+  const guchar *data;
+  gsize size;
+
+  if (reader_ensure (reader, 4) &&
+      memcmp (reader->data + reader->pos, &(guint32) { G_MAXUINT32 }, 4) == 0)
+    {
+      reader->pos += 4;
+      return NULL;
+    }
+
+  data = read_chunk (reader, &size);
+  if (data == NULL)
+    return NULL;
+
+  return g_strndup ((const char *) data, size);
+}
+
+static void
+read_point (Reader           *reader,
+            graphene_point_t *point)
+{
+  float values[2];
+
+  read_floats (reader, values, 2);
+  *point = GRAPHENE_POINT_INIT (values[0], values[1]);
+}
+
+static void
+read_rect (Reader          *reader,
+           graphene_rect_t *rect)
+{
+  float values[4];
+
+  read_floats (reader, values, 4);
+  *rect = GRAPHENE_RECT_INIT (values[0], values[1], values[2], values[3]);
+}
+
+static void
+read_rounded_rect (Reader         *reader,
+                   GskRoundedRect *rect)
+{
+  float values[8];
+  gsize i;
+
+  read_rect (reader, &rect->bounds);
+  read_floats (reader, values, 8);
+  for (i = 0; i < 4; i++)
+    rect->corner[i] = GRAPHENE_SIZE_INIT (values[2 * i], values[2 * i + 1]);
+}
+
+static void
+reader_table_init (ReaderTable    *table,
+                   GDestroyNotify  free_func)
+{
+  table->objects = g_ptr_array_new ();
+  table->frames = g_array_new (FALSE, FALSE, sizeof (guint32));
+  table->free_func = free_func;
+}
+
+static void
+reader_table_clear (ReaderTable *table)
+{
+  guint i;
+
+  for (i = 0; i < table->objects->len; i++)
+    {
+      gpointer object = g_ptr_array_index (table->objects, i);
+
+      if (object)
+        table->free_func (object);
+    }
+
+  g_ptr_array_unref (table->objects);
+  g_array_unref (table->frames);
+}
+
+/* Forget everything the current frame didn't use, like the writer.
+ * The indexes stay valid, so the slots are kept around.
+ */
+static void
+reader_table_prune (Reader      *reader,
+                    ReaderTable *table)
+{
+  guint i;
+
+  for (i = 0; i < table->objects->len; i++)
+    {
+      gpointer object = g_ptr_array_index (table->objects, i);
+
+      if (object && g_array_index (table->frames, guint32, i) != reader->frame)
+        {
+          table->free_func (object);
+          g_ptr_array_index (table->objects, i) = NULL;
+        }
+    }
+}
+
+/* Takes ownership of object */
+static void
+reader_table_add (Reader      *reader,
+                  ReaderTable *table,
+                  gpointer     object)
+{
+  g_ptr_array_add (table->objects, object);
+  g_array_append_val (table->frames, reader->frame);
+}
+
+static gpointer
+lookup_index (Reader      *reader,
+              ReaderTable *table,
+              guint32      index,
+              const char  *name)
+{
+  if (index >= table->objects->len || g_ptr_array_index (table->objects, index) == NULL)
+    {
+      reader_error (reader, "Invalid %s index %u", name, index);
+      return NULL;
+    }
+
+  g_array_index (table->frames, guint32, index) = reader->frame;
+
+  return g_ptr_array_index (table->objects, index);
+}
+
+static gpointer
+read_index (Reader      *reader,
+            ReaderTable *table,
+            const char  *name)
+{
+  guint32 index = read_uint (reader);
+
+  if (reader->error)
+    return NULL;
+
+  return lookup_index (reader, table, index, name);
+}
+
+/* Returns a new reference to the data, uncompressing it if necessary */
+static GBytes *
+read_data (Reader *reader)
+{
+  Compression compression;
+  guint64 size, stored_size;
+  GBytes *bytes;
+
+  compression = read_uint (reader);
+  size = read_uint64 (reader);
+  stored_size = read_uint64 (reader);
+  read_padding (reader, DATA_ALIGNMENT);
+  if (!reader_ensure (reader, stored_size))
+    return NULL;
+
+  switch (compression)
+    {
+    case COMPRESSION_NONE:
+      if (size != stored_size)
+        {
+          reader_error (reader, "Invalid data size");
+          return NULL;
+        }
+      bytes = g_bytes_new_from_bytes (reader->bytes, reader->pos, size);
+      break;
+
+    case COMPRESSION_ZLIB:
+      bytes = decompress_data (reader->data + reader->pos, stored_size, size);
+      if (bytes == NULL)
+        {
+          reader_error (reader, "Corrupt compressed data");
+          return NULL;
+        }
+      break;
+
+    default:
+      reader_error (reader, "Unknown compression %u", compression);
+      return NULL;
+    }
+
+  reader->pos += stored_size;
+  read_padding (reader, 4);
+
+  return bytes;
+}
+
+static GdkColorState *
+read_color_state (Reader *reader)
+{
+  guint32 id = read_uint (reader);
+
+  if (reader->error)
+    return NULL;
+
+  if (id < GDK_COLOR_STATE_N_IDS)
+    return gdk_color_state_get_by_id (id);
+
+  return lookup_index (reader, &reader->color_states, id - GDK_COLOR_STATE_N_IDS, "color state");
+}
+
+/* Colors must be cleared with gdk_color_finish() */
+static void
+read_color (Reader   *reader,
+            GdkColor *color)
+{
+  GdkColorState *color_state;
+  float values[4];
+
+  color_state = read_color_state (reader);
+  read_floats (reader, values, 4);
+
+  gdk_color_init (color, color_state ? color_state : GDK_COLOR_STATE_SRGB, values);
+}
+
+static GskColorStop2 *
+read_stops (Reader *reader,
+            gsize  *n_stops)
+{
+  GskColorStop2 *stops;
+  gsize i;
+
+  *n_stops = read_count (reader, 24);
+  if (reader->error)
+    return NULL;
+
+  if (*n_stops < 2)
+    {
+      reader_error (reader, "Gradients need at least 2 color stops");
+      return NULL;
+    }
+
+  stops = g_new (GskColorStop2, *n_stops);
+  for (i = 0; i < *n_stops; i++)
+    {
+      stops[i].offset = read_float (reader);
+      read_color (reader, &stops[i].color);
+    }
+
+  return stops;
+}
+
+static void
+free_stops (GskColorStop2 *stops,
+            gsize          n_stops)
+{
+  gsize i;
+
+  for (i = 0; i < n_stops; i++)
+    gdk_color_finish (&stops[i].color);
+  g_free (stops);
+}
+
+static void
+read_color_state_definition (Reader *reader)
+{
+  GdkColorState *color_state;
+  GError *error = NULL;
+  GdkCicp cicp;
+
+  cicp.color_primaries = read_uint (reader);
+  cicp.transfer_function = read_uint (reader);
+  cicp.matrix_coefficients = read_uint (reader);
+  cicp.range = read_enum (reader, GDK_CICP_RANGE_FULL + 1, "cicp range");
+  if (reader->error)
+    return;
+
+  color_state = gdk_color_state_new_for_cicp (&cicp, &error);
+  if (color_state == NULL)
+    {
+      reader_error (reader, "%s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  reader_table_add (reader, &reader->color_states, color_state);
+}
+
+static void
+read_texture_definition (Reader *reader)
+{
+  GdkMemoryTextureBuilder *builder;
+  GdkColorState *color_state;
+  GdkMemoryFormat format;
+  guint32 width, height, stride;
+  GBytes *bytes;
+
+  width = read_uint (reader);
+  height = read_uint (reader);
+  format = read_enum (reader, GDK_MEMORY_N_FORMATS, "memory format");
+  color_state = read_color_state (reader);
+  stride = read_uint (reader);
+  bytes = read_data (reader);
+  if (bytes == NULL)
+    return;
+
+  if (width == 0 || height == 0 ||
+      width > G_MAXINT || height > G_MAXINT ||
+      stride / gdk_memory_format_bytes_per_pixel (format) < width ||
+      g_bytes_get_size (bytes) < gdk_memory_format_min_buffer_size (format, stride, width, height))
+    {
+      reader_error (reader, "Invalid texture data");
+      g_bytes_unref (bytes);
+      return;
+    }
+
+  builder = gdk_memory_texture_builder_new ();
+  gdk_memory_texture_builder_set_bytes (builder, bytes);
+  gdk_memory_texture_builder_set_stride (builder, stride);
+  gdk_memory_texture_builder_set_width (builder, width);
+  gdk_memory_texture_builder_set_height (builder, height);
+  gdk_memory_texture_builder_set_format (builder, format);
+  gdk_memory_texture_builder_set_color_state (builder, color_state);
+
+  reader_table_add (reader, &reader->textures, gdk_memory_texture_builder_build (builder));
+
+  g_object_unref (builder);
+  g_bytes_unref (bytes);
+}
+
+static void
+read_surface_definition (Reader *reader)
+{
+  static const cairo_user_data_key_t bytes_key;
+  cairo_surface_t *surface;
+  guint32 width, height, stride;
+  GBytes *bytes;
+
+  width = read_uint (reader);
+  height = read_uint (reader);
+  stride = read_uint (reader);
+  bytes = read_data (reader);
+  if (bytes == NULL)
+    return;
+
+  if (width > G_MAXINT || height > G_MAXINT ||
+      stride != cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, width) ||
+      g_bytes_get_size (bytes) != (gsize) stride * height)
+    {
+      reader_error (reader, "Invalid surface data");
+      g_bytes_unref (bytes);
+      return;
+    }
+
+  /* The data is only ever read from */
+  surface = cairo_image_surface_create_for_data ((guchar *) g_bytes_get_data (bytes, NULL),
+                                                 CAIRO_FORMAT_ARGB32,
+                                                 width, height,
+                                                 stride);
+  cairo_surface_set_user_data (surface, &bytes_key, bytes, (cairo_destroy_func_t) g_bytes_unref);
+
+  reader_table_add (reader, &reader->surfaces, surface);
+}
+
+static void
+read_font_definition (Reader *reader)
+{
+  cairo_hint_style_t hint_style;
+  cairo_antialias_t antialias;
+  cairo_hint_metrics_t hint_metrics;
+  PangoFont *font = NULL;
+  gboolean embedded;
+  char *name;
+
+  name = read_string (reader);
+  hint_style = read_enum (reader, CAIRO_HINT_STYLE_FULL + 1, "hint style");
+  antialias = read_enum (reader, CAIRO_ANTIALIAS_BEST + 1, "antialias");
+  hint_metrics = read_enum (reader, CAIRO_HINT_METRICS_ON + 1, "hint metrics");
+  embedded = read_uint (reader);
+  if (name == NULL)
+    reader_error (reader, "Missing font name");
+
+  if (embedded && !reader->error)
+    {
+      GError *error = NULL;
+      GBytes *bytes;
+
+      bytes = read_data (reader);
+      if (bytes && !gsk_render_node_parser_add_font (&reader->fontmap, bytes, &error))
+        {
+          reader_error (reader, "%s", error->message);
+          g_error_free (error);
+        }
+      g_clear_pointer (&bytes, g_bytes_unref);
+    }
+
+  if (reader->error)
+    {
+      g_free (name);
+      return;
+    }
+
+  if (reader->fontmap)
+    font = gsk_render_node_parser_load_font (reader->fontmap, name, FALSE);
+  if (font == NULL)
+    font = gsk_render_node_parser_load_font (pango_cairo_font_map_get_default (), name, TRUE);
+
+  if (font == NULL)
+    {
+      reader_error (reader, "The font \"%s\" does not exist", name);
+      g_free (name);
+      return;
+    }
+
+  reader_table_add (reader, &reader->fonts, gsk_reload_font (font, 1.0, hint_metrics, hint_style, antialias));
+
+  g_object_unref (font);
+  g_free (name);
+}
+
+static void
+read_glyphs_definition (Reader *reader)
+{
+  PangoGlyphString *glyphs;
+  guint32 i, n_glyphs, flags;
+
+  n_glyphs = read_count (reader, 20);
+  if (reader->error)
+    return;
+
+  glyphs = pango_glyph_string_new ();
+  pango_glyph_string_set_size (glyphs, n_glyphs);
+  for (i = 0; i < n_glyphs; i++)
+    {
+      PangoGlyphInfo *info = &glyphs->glyphs[i];
+
+      info->glyph = read_uint (reader);
+      info->geometry.width = (gint32) read_uint (reader);
+      info->geometry.x_offset = (gint32) read_uint (reader);
+      info->geometry.y_offset = (gint32) read_uint (reader);
+      flags = read_uint (reader);
+      info->attr.is_cluster_start = (flags & 1) ? 1 : 0;
+      info->attr.is_color = (flags & 2) ? 1 : 0;
+    }
+
+  reader_table_add (reader, &reader->glyphs, glyphs);
+}
+
+static void
+read_path_definition (Reader *reader)
+{
+  GskPathBuilder *builder;
+  graphene_point_t pts[3];
+  guint32 i, n_ops;
+  float weight;
+
+  n_ops = read_count (reader, 4);
+  if (reader->error)
+    return;
+
+  builder = gsk_path_builder_new ();
+  for (i = 0; i < n_ops && !reader->error; i++)
+    {
+      switch (read_uint (reader))
+        {
+        case GSK_PATH_MOVE:
+          read_point (reader, &pts[0]);
+          gsk_path_builder_move_to (builder, pts[0].x, pts[0].y);
+          break;
+
+        case GSK_PATH_CLOSE:
+          gsk_path_builder_close (builder);
+          break;
+
+        case GSK_PATH_LINE:
+          read_point (reader, &pts[0]);
+          gsk_path_builder_line_to (builder, pts[0].x, pts[0].y);
+          break;
+
+        case GSK_PATH_QUAD:
+          read_point (reader, &pts[0]);
+          read_point (reader, &pts[1]);
+          gsk_path_builder_quad_to (builder, pts[0].x, pts[0].y, pts[1].x, pts[1].y);
+          break;
+
+        case GSK_PATH_CUBIC:
+          read_point (reader, &pts[0]);
+          read_point (reader, &pts[1]);
+          read_point (reader, &pts[2]);
+          gsk_path_builder_cubic_to (builder,
+                                     pts[0].x, pts[0].y,
+                                     pts[1].x, pts[1].y,
+                                     pts[2].x, pts[2].y);
+          break;
+
+        case GSK_PATH_CONIC:
+          read_point (reader, &pts[0]);
+          read_point (reader, &pts[1]);
+          weight = read_float (reader);
+          if (!(weight > 0))
+            {
+              reader_error (reader, "Invalid conic weight");
+              break;
+            }
+          gsk_path_builder_conic_to (builder, pts[0].x, pts[0].y, pts[1].x, pts[1].y, weight);
+          break;
+
+        default:
+          reader_error (reader, "Invalid path operation");
+          break;
+        }
+    }
+
+  if (reader->error)
+    {
+      gsk_path_builder_unref (builder);
+      return;
+    }
+
+  reader_table_add (reader, &reader->paths, gsk_path_builder_free_to_path (builder));
+}
+
+static void
+read_shader_definition (Reader *reader)
+{
+  const guchar *data;
+  GBytes *source;
+  gsize size;
+
+  data = read_chunk (reader, &size);
+  if (reader->error)
+    return;
+
+  source = g_bytes_new (data, size);
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  reader_table_add (reader, &reader->shaders, gsk_gl_shader_new_from_bytes (source));
+G_GNUC_END_IGNORE_DEPRECATIONS
+  g_bytes_unref (source);
+}
+
+static GskTransform *
+read_transform (Reader *reader)
+{
+  GskTransform *transform = NULL;
+  float values[4];
+  char *s;
+
+  switch (read_uint (reader))
+    {
+    case TRANSFORM_IDENTITY:
+      break;
+
+    case TRANSFORM_TRANSLATE:
+      read_floats (reader, values, 2);
+      transform = gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (values[0], values[1]));
+      break;
+
+    case TRANSFORM_AFFINE:
+      read_floats (reader, values, 4);
+      transform = gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (values[2], values[3]));
+      transform = gsk_transform_scale (transform, values[0], values[1]);
+      break;
+
+    case TRANSFORM_STRING:
+      s = read_string (reader);
+      if (s == NULL || !gsk_transform_parse (s, &transform))
+        reader_error (reader, "Invalid transform");
+      g_free (s);
+      break;
+
+    default:
+      reader_error (reader, "Invalid transform");
+      break;
+    }
+
+  if (reader->error)
+    g_clear_pointer (&transform, gsk_transform_unref);
+
+  return transform;
+}
+
+static GskStroke *
+read_stroke (Reader *reader)
+{
+  GskStroke *stroke;
+  float line_width, miter_limit, dash_offset;
+  GskLineCap line_cap;
+  GskLineJoin line_join;
+  float *dash;
+  gsize n_dash;
+
+  line_width = read_float (reader);
+  line_cap = read_enum (reader, GSK_LINE_CAP_SQUARE + 1, "line cap");
+  line_join = read_enum (reader, GSK_LINE_JOIN_BEVEL + 1, "line join");
+  miter_limit = read_float (reader);
+  n_dash = read_count (reader, sizeof (float));
+  dash = g_new (float, MAX (n_dash, 1));
+  read_floats (reader, dash, n_dash);
+  dash_offset = read_float (reader);
+
+  if (reader->error)
+    {
+      g_free (dash);
+      return NULL;
+    }
+
+  stroke = gsk_stroke_new (MAX (line_width, 0));
+  gsk_stroke_set_line_cap (stroke, line_cap);
+  gsk_stroke_set_line_join (stroke, line_join);
+  gsk_stroke_set_miter_limit (stroke, MAX (miter_limit, 0));
+  gsk_stroke_set_dash (stroke, dash, n_dash);
+  gsk_stroke_set_dash_offset (stroke, dash_offset);
+
+  g_free (dash);
+
+  return stroke;
+}
+
+static GskRenderNode *read_node (Reader *reader);
+
+static gboolean
+read_children (Reader         *reader,
+               GskRenderNode **children,
+               gsize           n_children)
+{
+  gsize i;
+
+  for (i = 0; i < n_children; i++)
+    {
+      children[i] = read_node (reader);
+      if (children[i] == NULL)
+        {
+          while (i-- > 0)
+            gsk_render_node_unref (children[i]);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+static void
+clear_children (GskRenderNode **children,
+                gsize           n_children)
+{
+  gsize i;
+
+  for (i = 0; i < n_children; i++)
+    gsk_render_node_unref (children[i]);
+}
+
+static GskRenderNode *
+read_node_contents (Reader            *reader,
+                    GskRenderNodeType  node_type)
+{
+  GskRenderNode *result = NULL;
+  GskRenderNode *children[2];
+
+  switch (node_type)
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **nodes;
+        guint32 n;
+
+        n = read_count (reader, 4);
+        if (reader->error)
+          return NULL;
+
+        nodes = g_new (GskRenderNode *, MAX (n, 1));
+        if (read_children (reader, nodes, n))
+          {
+            result = gsk_container_node_new (nodes, n);
+            clear_children (nodes, n);
+          }
+        g_free (nodes);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        graphene_rect_t bounds;
+        cairo_surface_t *surface = NULL;
+
+        read_rect (reader, &bounds);
+        if (reader_ensure (reader, 4) &&
+            memcmp (reader->data + reader->pos, &(guint32) { G_MAXUINT32 }, 4) == 0)
+          reader->pos += 4;
+        else
+          surface = read_index (reader, &reader->surfaces, "surface");
+        if (reader->error)
+          return NULL;
+
+        result = gsk_cairo_node_new (&bounds);
+        if (surface)
+          {
+            cairo_rectangle_int_t area;
+            cairo_t *cr;
+
+            get_surface_area (&bounds, &area);
+            cr = gsk_cairo_node_get_draw_context (result);
+            cairo_set_source_surface (cr, surface, area.x, area.y);
+            cairo_paint (cr);
+            cairo_destroy (cr);
+          }
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkColor color;
+
+        read_rect (reader, &bounds);
+        read_color (reader, &color);
+        if (!reader->error)
+          result = gsk_color_node_new2 (&color, &bounds);
+        gdk_color_finish (&color);
+      }
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t start, end;
+        GdkColorState *interpolation;
+        GskHueInterpolation hue_interpolation;
+        GskColorStop2 *stops;
+        gsize n_stops;
+
+        read_rect (reader, &bounds);
+        read_point (reader, &start);
+        read_point (reader, &end);
+        interpolation = read_color_state (reader);
+        hue_interpolation = read_enum (reader, GSK_HUE_INTERPOLATION_DECREASING + 1, "hue interpolation");
+        stops = read_stops (reader, &n_stops);
+        if (stops == NULL)
+          return NULL;
+
+        if (reader->error)
+          ;
+        else if (node_type == GSK_LINEAR_GRADIENT_NODE)
+          result = gsk_linear_gradient_node_new2 (&bounds, &start, &end,
+                                                  interpolation, hue_interpolation,
+                                                  stops, n_stops);
+        else
+          result = gsk_repeating_linear_gradient_node_new2 (&bounds, &start, &end,
+                                                            interpolation, hue_interpolation,
+                                                            stops, n_stops);
+        free_stops (stops, n_stops);
+      }
+      break;
+
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t center;
+        float hradius, vradius, start, end;
+        GdkColorState *interpolation;
+        GskHueInterpolation hue_interpolation;
+        GskColorStop2 *stops;
+        gsize n_stops;
+
+        read_rect (reader, &bounds);
+        read_point (reader, &center);
+        hradius = read_float (reader);
+        vradius = read_float (reader);
+        start = read_float (reader);
+        end = read_float (reader);
+        interpolation = read_color_state (reader);
+        hue_interpolation = read_enum (reader, GSK_HUE_INTERPOLATION_DECREASING + 1, "hue interpolation");
+        stops = read_stops (reader, &n_stops);
+        if (stops == NULL)
+          return NULL;
+
+        if (!reader->error && (!(hradius > 0) || !(vradius > 0) || !(start >= 0) || !(end > start)))
+          reader_error (reader, "Invalid radial gradient");
+
+        if (reader->error)
+          ;
+        else if (node_type == GSK_RADIAL_GRADIENT_NODE)
+          result = gsk_radial_gradient_node_new2 (&bounds, &center,
+                                                  hradius, vradius, start, end,
+                                                  interpolation, hue_interpolation,
+                                                  stops, n_stops);
+        else
+          result = gsk_repeating_radial_gradient_node_new2 (&bounds, &center,
+                                                            hradius, vradius, start, end,
+                                                            interpolation, hue_interpolation,
+                                                            stops, n_stops);
+        free_stops (stops, n_stops);
+      }
+      break;
+
+    case GSK_CONIC_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t center;
+        float rotation;
+        GdkColorState *interpolation;
+        GskHueInterpolation hue_interpolation;
+        GskColorStop2 *stops;
+        gsize n_stops;
+
+        read_rect (reader, &bounds);
+        read_point (reader, &center);
+        rotation = read_float (reader);
+        interpolation = read_color_state (reader);
+        hue_interpolation = read_enum (reader, GSK_HUE_INTERPOLATION_DECREASING + 1, "hue interpolation");
+        stops = read_stops (reader, &n_stops);
+        if (stops == NULL)
+          return NULL;
+
+        if (!reader->error)
+          result = gsk_conic_gradient_node_new2 (&bounds, &center, rotation,
+                                                 interpolation, hue_interpolation,
+                                                 stops, n_stops);
+        free_stops (stops, n_stops);
+      }
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        GskRoundedRect outline;
+        float widths[4];
+        GdkColor colors[4];
+        gsize i;
+
+        read_rounded_rect (reader, &outline);
+        read_floats (reader, widths, 4);
+        for (i = 0; i < 4; i++)
+          read_color (reader, &colors[i]);
+        if (!reader->error)
+          result = gsk_border_node_new2 (&outline, widths, colors);
+        for (i = 0; i < 4; i++)
+          gdk_color_finish (&colors[i]);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkTexture *texture;
+
+        read_rect (reader, &bounds);
+        texture = read_index (reader, &reader->textures, "texture");
+        if (!reader->error)
+          result = gsk_texture_node_new (texture, &bounds);
+      }
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        GskRoundedRect outline;
+        GdkColor color;
+        graphene_point_t offset;
+        float spread, blur_radius;
+
+        read_rounded_rect (reader, &outline);
+        read_color (reader, &color);
+        read_point (reader, &offset);
+        spread = read_float (reader);
+        blur_radius = read_float (reader);
+        if (!reader->error && !(blur_radius >= 0))
+          reader_error (reader, "Invalid blur radius");
+
+        if (reader->error)
+          ;
+        else if (node_type == GSK_INSET_SHADOW_NODE)
+          result = gsk_inset_shadow_node_new2 (&outline, &color, &offset, spread, blur_radius);
+        else
+          result = gsk_outset_shadow_node_new2 (&outline, &color, &offset, spread, blur_radius);
+        gdk_color_finish (&color);
+      }
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskTransform *transform;
+
+        transform = read_transform (reader);
+        if (reader->error)
+          return NULL;
+
+        if (read_children (reader, children, 1))
+          {
+            result = gsk_transform_node_new (children[0], transform);
+            clear_children (children, 1);
+          }
+        gsk_transform_unref (transform);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        float opacity;
+
+        opacity = read_float (reader);
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_opacity_node_new (children[0], opacity);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        graphene_matrix_t matrix;
+        graphene_vec4_t offset;
+        float values[16];
+
+        read_floats (reader, values, 16);
+        graphene_matrix_init_from_float (&matrix, values);
+        read_floats (reader, values, 4);
+        graphene_vec4_init_from_float (&offset, values);
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_color_matrix_node_new (children[0], &matrix, &offset);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        graphene_rect_t bounds, child_bounds;
+
+        read_rect (reader, &bounds);
+        read_rect (reader, &child_bounds);
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_repeat_node_new (&bounds, children[0], &child_bounds);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      {
+        graphene_rect_t clip;
+
+        read_rect (reader, &clip);
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_clip_node_new (children[0], &clip);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        GskRoundedRect clip;
+
+        read_rounded_rect (reader, &clip);
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_rounded_clip_node_new (children[0], &clip);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        GskShadow2 *shadows;
+        gsize i, n_shadows;
+
+        n_shadows = read_count (reader, 32);
+        if (!reader->error && n_shadows == 0)
+          reader_error (reader, "Shadow nodes need at least one shadow");
+        if (reader->error)
+          return NULL;
+
+        shadows = g_new (GskShadow2, n_shadows);
+        for (i = 0; i < n_shadows; i++)
+          {
+            read_color (reader, &shadows[i].color);
+            read_point (reader, &shadows[i].offset);
+            shadows[i].radius = read_float (reader);
+          }
+
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_shadow_node_new2 (children[0], shadows, n_shadows);
+            clear_children (children, 1);
+          }
+
+        for (i = 0; i < n_shadows; i++)
+          gdk_color_finish (&shadows[i].color);
+        g_free (shadows);
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        GskBlendMode mode;
+
+        mode = read_enum (reader, GSK_BLEND_MODE_LUMINOSITY + 1, "blend mode");
+        if (!reader->error && read_children (reader, children, 2))
+          {
+            result = gsk_blend_node_new (children[0], children[1], mode);
+            clear_children (children, 2);
+          }
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        float progress;
+
+        progress = read_float (reader);
+        if (!reader->error && read_children (reader, children, 2))
+          {
+            result = gsk_cross_fade_node_new (children[0], children[1], progress);
+            clear_children (children, 2);
+          }
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        PangoFont *font;
+        PangoGlyphString *glyphs;
+        GdkColor color;
+        graphene_point_t offset;
+
+        font = read_index (reader, &reader->fonts, "font");
+        glyphs = read_index (reader, &reader->glyphs, "glyphs");
+        read_color (reader, &color);
+        read_point (reader, &offset);
+        if (!reader->error)
+          {
+            result = gsk_text_node_new2 (font, glyphs, &color, &offset);
+            if (result == NULL)
+              reader_error (reader, "Glyphs result in empty text");
+          }
+        gdk_color_finish (&color);
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      {
+        float radius;
+
+        radius = read_float (reader);
+        if (!reader->error && !(radius >= 0))
+          reader_error (reader, "Invalid blur radius");
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_blur_node_new (children[0], radius);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_DEBUG_NODE:
+      {
+        char *message;
+
+        message = read_string (reader);
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_debug_node_new (children[0], g_steal_pointer (&message));
+            clear_children (children, 1);
+          }
+        g_free (message);
+      }
+      break;
+
+    case GSK_GL_SHADER_NODE:
+      {
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+        graphene_rect_t bounds;
+        GskGLShader *shader;
+        GskRenderNode **nodes;
+        const guchar *data;
+        GBytes *args;
+        gsize size;
+        guint32 n;
+
+        read_rect (reader, &bounds);
+        shader = read_index (reader, &reader->shaders, "shader");
+        data = read_chunk (reader, &size);
+        n = read_count (reader, 4);
+        if (!reader->error && size != gsk_gl_shader_get_args_size (shader))
+          reader_error (reader, "Wrong size of shader arguments");
+        if (reader->error)
+          return NULL;
+
+        args = g_bytes_new (data, size);
+        nodes = g_new (GskRenderNode *, MAX (n, 1));
+        if (read_children (reader, nodes, n))
+          {
+            result = gsk_gl_shader_node_new (shader, &bounds, args, nodes, n);
+            clear_children (nodes, n);
+          }
+        g_free (nodes);
+        g_bytes_unref (args);
+G_GNUC_END_IGNORE_DEPRECATIONS
+      }
+      break;
+
+    case GSK_TEXTURE_SCALE_NODE:
+      {
+        graphene_rect_t bounds;
+        GskScalingFilter filter;
+        GdkTexture *texture;
+
+        read_rect (reader, &bounds);
+        filter = read_enum (reader, GSK_SCALING_FILTER_TRILINEAR + 1, "scaling filter");
+        texture = read_index (reader, &reader->textures, "texture");
+        if (!reader->error)
+          result = gsk_texture_scale_node_new (texture, &bounds, filter);
+      }
+      break;
+
+    case GSK_MASK_NODE:
+      {
+        GskMaskMode mode;
+
+        mode = read_enum (reader, GSK_MASK_MODE_INVERTED_LUMINANCE + 1, "mask mode");
+        if (!reader->error && read_children (reader, children, 2))
+          {
+            result = gsk_mask_node_new (children[0], children[1], mode);
+            clear_children (children, 2);
+          }
+      }
+      break;
+
+    case GSK_FILL_NODE:
+      {
+        GskPath *path;
+        GskFillRule fill_rule;
+
+        path = read_index (reader, &reader->paths, "path");
+        fill_rule = read_enum (reader, GSK_FILL_RULE_EVEN_ODD + 1, "fill rule");
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_fill_node_new (children[0], path, fill_rule);
+            clear_children (children, 1);
+          }
+      }
+      break;
+
+    case GSK_STROKE_NODE:
+      {
+        GskPath *path;
+        GskStroke *stroke;
+
+        path = read_index (reader, &reader->paths, "path");
+        stroke = read_stroke (reader);
+        if (stroke == NULL)
+          return NULL;
+
+        if (!reader->error && read_children (reader, children, 1))
+          {
+            result = gsk_stroke_node_new (children[0], path, stroke);
+            clear_children (children, 1);
+          }
+        gsk_stroke_free (stroke);
+      }
+      break;
+
+    case GSK_SUBSURFACE_NODE:
+      if (read_children (reader, children, 1))
+        {
+          result = gsk_subsurface_node_new (children[0], NULL);
+          clear_children (children, 1);
+        }
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      reader_error (reader, "Invalid node type %u", node_type);
+      break;
+    }
+
+  return result;
+}
+
+static GskRenderNode *
+read_node (Reader *reader)
+{
+  GskRenderNode *node;
+  guint32 tag;
+
+  /* Read the definitions the node needs */
+  while (TRUE)
+    {
+      tag = read_uint (reader);
+      if (reader->error)
+        return NULL;
+
+      switch (tag)
+        {
+        case TAG_NODE_REF:
+          node = read_index (reader, &reader->nodes, "node");
+          return node ? gsk_render_node_ref (node) : NULL;
+
+        case TAG_COLOR_STATE:
+          read_color_state_definition (reader);
+          break;
+
+        case TAG_TEXTURE:
+          read_texture_definition (reader);
+          break;
+
+        case TAG_SURFACE:
+          read_surface_definition (reader);
+          break;
+
+        case TAG_FONT:
+          read_font_definition (reader);
+          break;
+
+        case TAG_GLYPHS:
+          read_glyphs_definition (reader);
+          break;
+
+        case TAG_PATH:
+          read_path_definition (reader);
+          break;
+
+        case TAG_SHADER:
+          read_shader_definition (reader);
+          break;
+
+        default:
+          goto node;
+        }
+
+      if (reader->error)
+        return NULL;
+    }
+
+node:
+  if (reader->depth >= MAX_DEPTH)
+    {
+      reader_error (reader, "Nodes are nested too deeply");
+      return NULL;
+    }
+
+  reader->depth++;
+  node = read_node_contents (reader, tag);
+  reader->depth--;
+
+  if (reader->error)
+    {
+      g_clear_pointer (&node, gsk_render_node_unref);
+      return NULL;
+    }
+
+  reader_table_add (reader, &reader->nodes, gsk_render_node_ref (node));
+
+  return node;
+}
+
+/*<private>
+ * gsk_render_node_is_binary:
+ * @bytes: serialized render node data
+ *
+ * Checks if @bytes contain a node in the binary format.
+ *
+ * Returns: %TRUE if @bytes should be read with
+ *   gsk_render_node_deserialize_binary()
+ */
+gboolean
+gsk_render_node_is_binary (GBytes *bytes)
+{
+  const guchar *data;
+  gsize size;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  return size >= strlen (MAGIC) && memcmp (data, MAGIC, strlen (MAGIC)) == 0;
+}
+
+/*<private>
+ * gsk_render_node_binary_reader_new:
+ *
+ * Creates a reader for a sequence of nodes written with
+ * a `GskRenderNodeBinaryWriter`.
+ *
+ * Returns: (transfer full): a new reader
+ */
+GskRenderNodeBinaryReader *
+gsk_render_node_binary_reader_new (void)
+{
+  Reader *reader;
+
+  reader = g_new0 (Reader, 1);
+  reader_table_init (&reader->nodes, (GDestroyNotify) gsk_render_node_unref);
+  reader_table_init (&reader->color_states, (GDestroyNotify) gdk_color_state_unref);
+  reader_table_init (&reader->textures, g_object_unref);
+  reader_table_init (&reader->surfaces, (GDestroyNotify) cairo_surface_destroy);
+  reader_table_init (&reader->fonts, g_object_unref);
+  reader_table_init (&reader->glyphs, (GDestroyNotify) pango_glyph_string_free);
+  reader_table_init (&reader->paths, (GDestroyNotify) gsk_path_unref);
+  reader_table_init (&reader->shaders, g_object_unref);
+
+  return reader;
+}
+
+void
+gsk_render_node_binary_reader_free (GskRenderNodeBinaryReader *reader)
+{
+  reader_table_clear (&reader->nodes);
+  reader_table_clear (&reader->color_states);
+  reader_table_clear (&reader->textures);
+  reader_table_clear (&reader->surfaces);
+  reader_table_clear (&reader->fonts);
+  reader_table_clear (&reader->glyphs);
+  reader_table_clear (&reader->paths);
+  reader_table_clear (&reader->shaders);
+  g_clear_object (&reader->fontmap);
+  g_clear_error (&reader->error);
+  g_free (reader);
+}
+
+/* Reads the node starting at offset, which must be the rest of bytes */
+static GskRenderNode *
+reader_read_frame (Reader *reader,
+                   GBytes *bytes,
+                   gsize   offset)
+{
+  GskRenderNode *node;
+
+  reader->bytes = bytes;
+  reader->data = g_bytes_get_data (bytes, &reader->size);
+  reader->pos = offset;
+  reader->frame++;
+
+  node = read_node (reader);
+  if (node && reader->pos != reader->size)
+    {
+      reader_error (reader, "Unexpected data after the node");
+      g_clear_pointer (&node, gsk_render_node_unref);
+    }
+
+  reader_table_prune (reader, &reader->nodes);
+  reader_table_prune (reader, &reader->color_states);
+  reader_table_prune (reader, &reader->textures);
+  reader_table_prune (reader, &reader->surfaces);
+  reader_table_prune (reader, &reader->fonts);
+  reader_table_prune (reader, &reader->glyphs);
+  reader_table_prune (reader, &reader->paths);
+  reader_table_prune (reader, &reader->shaders);
+
+  reader->bytes = NULL;
+  reader->data = NULL;
+
+  return node;
+}
+
+/*<private>
+ * gsk_render_node_binary_reader_read:
+ * @reader: a reader
+ * @bytes: the data returned by gsk_render_node_binary_writer_write()
+ * @error: return location for an error
+ *
+ * Reads the next node of the sequence.
+ *
+ * After an error, the reader can't be used anymore.
+ *
+ * Returns: (nullable) (transfer full): the node or %NULL on error
+ */
+GskRenderNode *
+gsk_render_node_binary_reader_read (GskRenderNodeBinaryReader  *reader,
+                                    GBytes                     *bytes,
+                                    GError                    **error)
+{
+  GskRenderNode *node;
+
+  if (reader->error)
+    {
+      g_set_error_literal (error, GTK_CSS_PARSER_ERROR, GTK_CSS_PARSER_ERROR_FAILED,
+                           "A previous node could not be read");
+      return NULL;
+    }
+
+  node = reader_read_frame (reader, bytes, 0);
+  if (node == NULL)
+    g_propagate_error (error, g_error_copy (reader->error));
+
+  return node;
+}
+
+/*<private>
+ * gsk_render_node_deserialize_binary:
+ * @bytes: the data produced by gsk_render_node_serialize_binary()
+ * @error_func: (nullable): callback on errors
+ * @user_data: user data for @error_func
+ *
+ * Loads a node from the binary format.
+ *
+ * Unlike the text format, errors are not recovered from.
+ *
+ * Returns: (nullable) (transfer full): the node or %NULL on error
+ */
+GskRenderNode *
+gsk_render_node_deserialize_binary (GBytes            *bytes,
+                                    GskParseErrorFunc  error_func,
+                                    gpointer           user_data)
+{
+  GskRenderNodeBinaryReader *reader;
+  GskRenderNode *node = NULL;
+  const guchar *data;
+  Header header;
+  gsize size;
+
+  reader = gsk_render_node_binary_reader_new ();
+  data = g_bytes_get_data (bytes, &size);
+
+  if (size < sizeof (Header))
+    {
+      reader_error (reader, "Unexpected end of data");
+      goto out;
+    }
+
+  memcpy (&header, data, sizeof (Header));
+  reader->pos = sizeof (Header);
+
+  if (memcmp (header.magic, MAGIC, strlen (MAGIC)) != 0)
+    reader_error (reader, "Not a binary render node file");
+  else if (header.byte_order != BYTE_ORDER_MARK)
+    reader_error (reader, "The file was written on a machine with a different byte order");
+  else if (header.version != VERSION)
+    reader_error (reader, "Unsupported version %u", header.version);
+  else
+    node = reader_read_frame (reader, bytes, sizeof (Header));
+
+out:
+  if (reader->error)
+    {
+      GskParseLocation location = {
+        .bytes = reader->pos,
+        .chars = reader->pos,
+        .line_bytes = reader->pos,
+        .line_chars = reader->pos,
+      };
+
+      if (error_func)
+        error_func (&location, &location, reader->error, user_data);
+    }
+
+  gsk_render_node_binary_reader_free (reader);
+
+  return node;
+}
+
+/* }}} */
+/* vim:set foldmethod=marker: */
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "gskrendernode.h"
+
+G_BEGIN_DECLS
+
+#define GSK_RENDER_NODE_BINARY_MIME_TYPE "application/x-gtk-render-node-binary"
+
+typedef struct _GskRenderNodeBinaryWriter GskRenderNodeBinaryWriter;
+typedef struct _GskRenderNodeBinaryReader GskRenderNodeBinaryReader;
+
+gboolean        gsk_render_node_is_binary               (GBytes            *bytes);
+
+GBytes *        gsk_render_node_serialize_binary        (GskRenderNode     *node);
+GskRenderNode * gsk_render_node_deserialize_binary      (GBytes            *bytes,
+                                                         GskParseErrorFunc  error_func,
+                                                         gpointer           user_data);
+
+GskRenderNodeBinaryWriter *
+                gsk_render_node_binary_writer_new       (void);
+void            gsk_render_node_binary_writer_free      (GskRenderNodeBinaryWriter  *writer);
+GBytes *        gsk_render_node_binary_writer_write     (GskRenderNodeBinaryWriter  *writer,
+                                                         GskRenderNode              *node);
+
+GskRenderNodeBinaryReader *
+                gsk_render_node_binary_reader_new       (void);
+void            gsk_render_node_binary_reader_free      (GskRenderNodeBinaryReader  *reader);
+GskRenderNode * gsk_render_node_binary_reader_read      (GskRenderNodeBinaryReader  *reader,
+                                                         GBytes                     *bytes,
+                                                         GError                    **error);
+
+G_END_DECLS
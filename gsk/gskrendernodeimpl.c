@@ -28,6 +28,7 @@
 #include "gskpathprivate.h"
 #include "gskrectprivate.h"
 #include "gskrendererprivate.h"
+#include "gskrendernodebinaryprivate.h"
 #include "gskroundedrectprivate.h"
 #include "gskstrokeprivate.h"
 #include "gsktransformprivate.h"
@@ -2714,6 +2715,71 @@ gsk_texture_node_finalize (GskRenderNode *node)
   parent_class->finalize (node);
 }
 
+static const cairo_user_data_key_t texture_surfaces_key;
+
+typedef struct _TextureSurfaces TextureSurfaces;
+
+struct _TextureSurfaces
+{
+  GdkColorState *ccs;
+  GHashTable *surfaces;
+};
+
+static void
+texture_surfaces_free (gpointer data)
+{
+  TextureSurfaces *self = data;
+
+  gdk_color_state_unref (self->ccs);
+  g_hash_table_unref (self->surfaces);
+  g_free (self);
+}
+
+/*< private >
+ * gsk_cairo_set_texture_surfaces:
+ * @cr: a cairo context
+ * @ccs: the color state the surfaces were downloaded in
+ * @surfaces: a hash table mapping `GdkTexture`s to image surfaces
+ *
+ * Makes texture nodes that are drawn to @cr in @ccs draw from the
+ * given surfaces instead of downloading their texture each time.
+ *
+ * This allows drawing a node in many pieces while downloading its
+ * textures only once. The hash table must not change while @cr uses it.
+ */
+void
+gsk_cairo_set_texture_surfaces (cairo_t       *cr,
+                                GdkColorState *ccs,
+                                GHashTable    *surfaces)
+{
+  TextureSurfaces *self;
+
+  self = g_new (TextureSurfaces, 1);
+  self->ccs = gdk_color_state_ref (ccs);
+  self->surfaces = g_hash_table_ref (surfaces);
+
+  cairo_set_user_data (cr, &texture_surfaces_key, self, texture_surfaces_free);
+}
+
+static cairo_surface_t *
+gsk_texture_download_surface (cairo_t       *cr,
+                              GdkTexture    *texture,
+                              GdkColorState *ccs)
+{
+  TextureSurfaces *texture_surfaces;
+
+  texture_surfaces = cairo_get_user_data (cr, &texture_surfaces_key);
+  if (texture_surfaces && gdk_color_state_equal (texture_surfaces->ccs, ccs))
+    {
+      cairo_surface_t *surface = g_hash_table_lookup (texture_surfaces->surfaces, texture);
+
+      if (surface)
+        return cairo_surface_reference (surface);
+    }
+
+  return gdk_texture_download_surface (texture, ccs);
+}
+
 static void
 gsk_texture_node_draw_oversized (GskRenderNode *node,
                                  cairo_t       *cr,
@@ -2797,7 +2863,7 @@ gsk_texture_node_draw (GskRenderNode *node,
       return;
     }
 
-  surface = gdk_texture_download_surface (self->texture, ccs);
+  surface = gsk_texture_download_surface (cr, self->texture, ccs);
   pattern = cairo_pattern_create_for_surface (surface);
   cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
 
@@ -2976,7 +3042,7 @@ gsk_texture_scale_node_draw (GskRenderNode *node,
   cairo_surface_set_device_offset (surface2, -clip_rect.origin.x, -clip_rect.origin.y);
   cr2 = cairo_create (surface2);
 
-  surface = gdk_texture_download_surface (self->texture, ccs);
+  surface = gsk_texture_download_surface (cr, self->texture, ccs);
   pattern = cairo_pattern_create_for_surface (surface);
   cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
 
@@ -4381,6 +4447,8 @@ struct _GskContainerNode
   GskRenderNode render_node;
 
   gboolean disjoint;
+  gboolean cacheable;
+  int drawn; /* atomic, only used if cacheable */
   graphene_rect_t opaque; /* Can be 0 0 0 0 to mean no opacity */
   guint n_children;
   GskRenderNode **children;
@@ -4676,6 +4744,68 @@ gsk_container_node_is_disjoint (const GskRenderNode *node)
   return self->disjoint;
 }
 
+/*< private>
+ * gsk_container_node_new_cacheable:
+ * @child: the child node
+ *
+ * Creates a container node for @child that is marked as
+ * cacheable.
+ *
+ * Renderers may keep the rendering of such a node around and
+ * reuse it for as long as the same node is drawn again, so this
+ * should be used for content that is expected to not change
+ * while the things around it do.
+ *
+ * Returns: (transfer full): a new `GskRenderNode`
+ */
+GskRenderNode *
+gsk_container_node_new_cacheable (GskRenderNode *child)
+{
+  GskRenderNode *node;
+
+  node = gsk_container_node_new (&child, 1);
+  ((GskContainerNode *) node)->cacheable = TRUE;
+
+  return node;
+}
+
+/*< private>
+ * gsk_container_node_is_cacheable:
+ * @node: a container `GskRenderNode`
+ *
+ * Returns whether the node was created with
+ * gsk_container_node_new_cacheable().
+ *
+ * Returns: `TRUE` if the node may be cached
+ */
+gboolean
+gsk_container_node_is_cacheable (const GskRenderNode *node)
+{
+  const GskContainerNode *self = (const GskContainerNode *) node;
+
+  return self->cacheable;
+}
+
+/*< private>
+ * gsk_container_node_mark_drawn:
+ * @node: a cacheable container `GskRenderNode`
+ *
+ * Records that a renderer drew the node.
+ *
+ * Renderers use this to only cache nodes that are drawn more
+ * than once. As the node itself keeps track, a new node can't
+ * be mistaken for an old one that had the same address.
+ *
+ * Returns: `TRUE` if the node was drawn before
+ */
+gboolean
+gsk_container_node_mark_drawn (GskRenderNode *node)
+{
+  GskContainerNode *self = (GskContainerNode *) node;
+
+  return !g_atomic_int_compare_and_exchange (&self->drawn, FALSE, TRUE);
+}
+
 /* }}} */
 /* {{{ GSK_TRANSFORM_NODE */
 
@@ -9043,6 +9173,20 @@ gsk_render_node_content_serializer (GdkContentSerializer *serializer)
   gsk_render_node_serialize_bytes (serializer, bytes);
 }
 
+static void
+gsk_render_node_binary_content_serializer (GdkContentSerializer *serializer)
+{
+  const GValue *value;
+  GskRenderNode *node;
+  GBytes *bytes;
+
+  value = gdk_content_serializer_get_value (serializer);
+  node = gsk_value_get_render_node (value);
+  bytes = gsk_render_node_serialize_binary (node);
+
+  gsk_render_node_serialize_bytes (serializer, bytes);
+}
+
 static void
 gsk_render_node_content_deserializer_finish (GObject      *source,
                                              GAsyncResult *result,
@@ -9099,6 +9243,11 @@ gsk_render_node_init_content_serializers (void)
                                    gsk_render_node_content_serializer,
                                    NULL,
                                    NULL);
+  gdk_content_register_serializer (GSK_TYPE_RENDER_NODE,
+                                   GSK_RENDER_NODE_BINARY_MIME_TYPE,
+                                   gsk_render_node_binary_content_serializer,
+                                   NULL,
+                                   NULL);
   gdk_content_register_serializer (GSK_TYPE_RENDER_NODE,
                                    "text/plain;charset=utf-8",
                                    gsk_render_node_content_serializer,
@@ -9128,6 +9277,12 @@ gsk_render_node_init_content_serializers (void)
                                      gsk_render_node_content_deserializer,
                                      NULL,
                                      NULL);
+  /* gsk_render_node_deserialize() detects the format */
+  gdk_content_register_deserializer (GSK_RENDER_NODE_BINARY_MIME_TYPE,
+                                     GSK_TYPE_RENDER_NODE,
+                                     gsk_render_node_content_deserializer,
+                                     NULL,
+                                     NULL);
 }
 
 /*< private >
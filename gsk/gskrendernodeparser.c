@@ -1045,10 +1045,20 @@ parse_mask_mode (GtkCssParser *parser,
   return FALSE;
 }
 
-static PangoFont *
-font_from_string (PangoFontMap *fontmap,
-                  const char   *string,
-                  gboolean      allow_fallback)
+/*<private>
+ * gsk_render_node_parser_load_font:
+ * @fontmap: the fontmap to use
+ * @string: a font description
+ * @allow_fallback: whether to accept a font from a different family
+ *
+ * Loads the font described by @string from @fontmap.
+ *
+ * Returns: (nullable) (transfer full): the font
+ */
+PangoFont *
+gsk_render_node_parser_load_font (PangoFontMap *fontmap,
+                                  const char   *string,
+                                  gboolean      allow_fallback)
 {
   PangoFontDescription *desc;
   PangoContext *ctx;
@@ -1150,44 +1160,44 @@ delete_file (gpointer data)
 #endif
 
 static void
-ensure_fontmap (Context *context)
+ensure_fontmap (PangoFontMap **fontmap)
 {
-  if (context->fontmap)
+  if (*fontmap)
     return;
 
-  context->fontmap = pango_cairo_font_map_new ();
+  *fontmap = pango_cairo_font_map_new ();
 
 #ifdef HAVE_PANGOFT
-  if (PANGO_IS_FC_FONT_MAP (context->fontmap))
+  if (PANGO_IS_FC_FONT_MAP (*fontmap))
     {
       FcConfig *config;
       GPtrArray *files;
 
       config = FcConfigCreate ();
-      pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (context->fontmap), config);
+      pango_fc_font_map_set_config (PANGO_FC_FONT_MAP (*fontmap), config);
       FcConfigDestroy (config);
 
       files = g_ptr_array_new_with_free_func (delete_file);
 
-      g_object_set_data_full (G_OBJECT (context->fontmap), "font-files", files, (GDestroyNotify) g_ptr_array_unref);
+      g_object_set_data_full (G_OBJECT (*fontmap), "font-files", files, (GDestroyNotify) g_ptr_array_unref);
     }
 #endif
 }
 
 static gboolean
-add_font_from_file (Context     *context,
-                    const char  *path,
-                    GError     **error)
+add_font_from_file (PangoFontMap **fontmap,
+                    const char    *path,
+                    GError       **error)
 {
-  ensure_fontmap (context);
+  ensure_fontmap (fontmap);
 
 #ifdef HAVE_PANGOFT
-  if (PANGO_IS_FC_FONT_MAP (context->fontmap))
+  if (PANGO_IS_FC_FONT_MAP (*fontmap))
     {
       FcConfig *config;
       GPtrArray *files;
 
-      config = pango_fc_font_map_get_config (PANGO_FC_FONT_MAP (context->fontmap));
+      config = pango_fc_font_map_get_config (PANGO_FC_FONT_MAP (*fontmap));
 
       if (!FcConfigAppFontAddFile (config, (FcChar8 *) path))
         {
@@ -1198,21 +1208,21 @@ add_font_from_file (Context     *context,
           return FALSE;
         }
 
-      files = (GPtrArray *) g_object_get_data (G_OBJECT (context->fontmap), "font-files");
+      files = (GPtrArray *) g_object_get_data (G_OBJECT (*fontmap), "font-files");
       g_ptr_array_add (files, g_strdup (path));
 
-      pango_fc_font_map_config_changed (PANGO_FC_FONT_MAP (context->fontmap));
+      pango_fc_font_map_config_changed (PANGO_FC_FONT_MAP (*fontmap));
 
       return TRUE;
     }
   else
 #endif
 #ifdef HAVE_PANGOWIN32
-  if (g_type_is_a (G_OBJECT_TYPE (context->fontmap), g_type_from_name ("PangoWin32FontMap")))
+  if (g_type_is_a (G_OBJECT_TYPE (*fontmap), g_type_from_name ("PangoWin32FontMap")))
     {
       gboolean result;
 
-      result = pango_win32_font_map_add_font_file (context->fontmap, path, error);
+      result = pango_win32_font_map_add_font_file (*fontmap, path, error);
       g_remove (path);
       return result;
     }
@@ -1223,15 +1233,25 @@ add_font_from_file (Context     *context,
       g_set_error (error,
                    GTK_CSS_PARSER_ERROR,
                    GTK_CSS_PARSER_ERROR_FAILED,
-                   "Custom fonts are not implemented for %s", G_OBJECT_TYPE_NAME (context->fontmap));
+                   "Custom fonts are not implemented for %s", G_OBJECT_TYPE_NAME (*fontmap));
       return FALSE;
     }
 }
 
-static gboolean
-add_font_from_bytes (Context  *context,
-                     GBytes   *bytes,
-                     GError  **error)
+/*<private>
+ * gsk_render_node_parser_add_font:
+ * @fontmap: (inout): the fontmap for custom fonts, created on demand
+ * @bytes: the contents of a font file
+ * @error: return location for an error
+ *
+ * Makes the fonts in @bytes available in @fontmap.
+ *
+ * Returns: %TRUE if the fonts were added
+ */
+gboolean
+gsk_render_node_parser_add_font (PangoFontMap **fontmap,
+                                 GBytes        *bytes,
+                                 GError       **error)
 {
   GFile *file;
   GIOStream *iostream;
@@ -1254,7 +1274,7 @@ add_font_from_bytes (Context  *context,
   g_io_stream_close (iostream, NULL, NULL);
   g_object_unref (iostream);
 
-  result = add_font_from_file (context, g_file_peek_path (file), error);
+  result = add_font_from_file (fontmap, g_file_peek_path (file), error);
 
   g_object_unref (file);
 
@@ -1305,7 +1325,7 @@ parse_font (GtkCssParser *parser,
           g_free (url);
           if (bytes != NULL)
             {
-              success = add_font_from_bytes (context, bytes, &error);
+              success = gsk_render_node_parser_add_font (&context->fontmap, bytes, &error);
               g_bytes_unref (bytes);
             }
 
@@ -1320,7 +1340,7 @@ parse_font (GtkCssParser *parser,
 
       if (success)
         {
-          font = font_from_string (context->fontmap, font_name, FALSE);
+          font = gsk_render_node_parser_load_font (context->fontmap, font_name, FALSE);
           if (!font)
             {
               gtk_css_parser_error (parser,
@@ -1335,10 +1355,10 @@ parse_font (GtkCssParser *parser,
   else
     {
       if (context->fontmap)
-        font = font_from_string (context->fontmap, font_name, FALSE);
+        font = gsk_render_node_parser_load_font (context->fontmap, font_name, FALSE);
 
       if (!font)
-        font = font_from_string (pango_cairo_font_map_get_default (), font_name, TRUE);
+        font = gsk_render_node_parser_load_font (pango_cairo_font_map_get_default (), font_name, TRUE);
 
       if (!font)
         gtk_css_parser_error_value (parser, "The font \"%s\" does not exist", font_name);
@@ -2736,7 +2756,7 @@ parse_text_node (GtkCssParser *parser,
 
   if (font == NULL)
     {
-      font = font_from_string (pango_cairo_font_map_get_default (), "Cantarell 15px", TRUE);
+      font = gsk_render_node_parser_load_font (pango_cairo_font_map_get_default (), "Cantarell 15px", TRUE);
       g_assert (font);
     }
 
@@ -6,3 +6,10 @@
 GskRenderNode * gsk_render_node_deserialize_from_bytes  (GBytes            *bytes,
                                                          GskParseErrorFunc  error_func,
                                                          gpointer           user_data);
+
+PangoFont *     gsk_render_node_parser_load_font        (PangoFontMap      *fontmap,
+                                                         const char        *string,
+                                                         gboolean           allow_fallback);
+gboolean        gsk_render_node_parser_add_font         (PangoFontMap     **fontmap,
+                                                         GBytes            *bytes,
+                                                         GError           **error);
@@ -93,6 +93,9 @@ void            gsk_render_node_draw_with_color_state   (GskRenderNode
                                                          GdkColorState               *color_state);
 void            gsk_render_node_draw_fallback           (GskRenderNode               *node,
                                                          cairo_t                     *cr);
+void            gsk_cairo_set_texture_surfaces          (cairo_t                     *cr,
+                                                         GdkColorState               *ccs,
+                                                         GHashTable                  *surfaces);
 
 bool            gsk_border_node_get_uniform             (const GskRenderNode         *self) G_GNUC_PURE;
 bool            gsk_border_node_get_uniform_color       (const GskRenderNode         *self) G_GNUC_PURE;
@@ -113,6 +116,9 @@ GdkMemoryDepth  gsk_render_node_get_preferred_depth     (const GskRenderNode
 gboolean        gsk_render_node_is_hdr                  (const GskRenderNode         *node) G_GNUC_PURE;
 
 gboolean        gsk_container_node_is_disjoint          (const GskRenderNode         *node) G_GNUC_PURE;
+GskRenderNode * gsk_container_node_new_cacheable        (GskRenderNode               *child);
+gboolean        gsk_container_node_is_cacheable         (const GskRenderNode         *node) G_GNUC_PURE;
+gboolean        gsk_container_node_mark_drawn           (GskRenderNode               *node);
 
 gboolean        gsk_render_node_use_offscreen_for_opacity (const GskRenderNode       *node) G_GNUC_PURE;
 
@@ -21,6 +21,8 @@
 
 #include "gtkboolfilter.h"
 
+#include "gtkfilterprivate.h"
+
 #include "gtktypebuiltins.h"
 
 /**
@@ -70,6 +72,83 @@ gtk_bool_filter_match (GtkFilter *filter,
   return result;
 }
 
+typedef struct _GtkBoolFilterKeys GtkBoolFilterKeys;
+struct _GtkBoolFilterKeys
+{
+  GtkFilterKeys keys;
+
+  GtkExpression *expression;
+  gboolean invert;
+};
+
+static void
+gtk_bool_filter_keys_free (GtkFilterKeys *keys)
+{
+  GtkBoolFilterKeys *self = (GtkBoolFilterKeys *) keys;
+
+  g_clear_pointer (&self->expression, gtk_expression_unref);
+  g_free (self);
+}
+
+static gboolean
+gtk_bool_filter_keys_match (GtkFilterKeys *keys,
+                            gconstpointer  key_memory)
+{
+  GtkBoolFilterKeys *self = (GtkBoolFilterKeys *) keys;
+  const guchar *key = key_memory;
+
+  /* 2 means the expression could not be evaluated */
+  if (*key > 1)
+    return FALSE;
+
+  return self->invert ? !*key : *key;
+}
+
+static void
+gtk_bool_filter_keys_init_key (GtkFilterKeys *keys,
+                               gpointer       item,
+                               gpointer       key_memory)
+{
+  GtkBoolFilterKeys *self = (GtkBoolFilterKeys *) keys;
+  guchar *key = key_memory;
+  GValue value = G_VALUE_INIT;
+
+  if (self->expression == NULL ||
+      !gtk_expression_evaluate (self->expression, item, &value))
+    {
+      *key = 2;
+      return;
+    }
+
+  *key = g_value_get_boolean (&value) ? 1 : 0;
+  g_value_unset (&value);
+}
+
+static const GtkFilterKeysClass GTK_BOOL_FILTER_KEYS_CLASS =
+{
+  gtk_bool_filter_keys_free,
+  gtk_bool_filter_keys_match,
+  gtk_bool_filter_keys_init_key,
+  NULL
+};
+
+static GtkFilterKeys *
+gtk_bool_filter_keys_new (GtkBoolFilter *self)
+{
+  GtkBoolFilterKeys *result;
+
+  result = gtk_filter_keys_new (GtkBoolFilterKeys,
+                                &GTK_BOOL_FILTER_KEYS_CLASS,
+                                sizeof (guchar),
+                                G_ALIGNOF (guchar));
+
+  if (self->expression)
+    result->expression = gtk_expression_ref (self->expression);
+  result->invert = self->invert;
+
+  return (GtkFilterKeys *) result;
+}
+
 static GtkFilterMatch
 gtk_bool_filter_get_strictness (GtkFilter *filter)
 {
@@ -177,6 +256,9 @@ gtk_bool_filter_class_init (GtkBoolFilterClass *class)
 static void
 gtk_bool_filter_init (GtkBoolFilter *self)
 {
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                GTK_FILTER_CHANGE_DIFFERENT,
+                                gtk_bool_filter_keys_new (self));
 }
 
 /**
@@ -242,7 +324,9 @@ gtk_bool_filter_set_expression (GtkBoolFilter *self,
   if (expression)
     self->expression = gtk_expression_ref (expression);
 
-  gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_DIFFERENT);
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                GTK_FILTER_CHANGE_DIFFERENT,
+                                gtk_bool_filter_keys_new (self));
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_EXPRESSION]);
 }
@@ -281,7 +365,9 @@ gtk_bool_filter_set_invert (GtkBoolFilter *self,
 
   self->invert = invert;
 
-  gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_DIFFERENT);
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                GTK_FILTER_CHANGE_DIFFERENT,
+                                gtk_bool_filter_keys_new (self));
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_INVERT]);
 }
@@ -478,6 +478,13 @@ gtk_column_view_column_measure (GtkColumnViewColumn *self,
 
       for (cell = self->first_cell; cell; cell = gtk_column_view_cell_widget_get_next (cell))
         {
+          GtkWidget *row = gtk_widget_get_parent (GTK_WIDGET (cell));
+
+          /* Rows in the list item manager's pool keep their cells,
+           * but are unbound and not part of the view */
+          if (gtk_widget_get_parent (row) == NULL)
+            continue;
+
           gtk_widget_measure (GTK_WIDGET (cell),
                               GTK_ORIENTATION_HORIZONTAL,
                               -1,
@@ -527,6 +534,8 @@ gtk_column_view_column_create_cells (GtkColumnViewColumn *self)
     return;
 
   list = gtk_column_view_get_list_view (GTK_COLUMN_VIEW (self->view));
+  /* Rows that are not in the list would miss the new cell */
+  gtk_list_item_manager_clear_pool (gtk_list_base_get_manager (GTK_LIST_BASE (list)));
   for (row = gtk_widget_get_first_child (GTK_WIDGET (list));
        row != NULL;
        row = gtk_widget_get_next_sibling (row))
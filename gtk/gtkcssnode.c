@@ -24,9 +24,11 @@
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkmarshalers.h"
 #include "gtksettingsprivate.h"
+#include "gtkstyleproviderprivate.h"
 #include "gtktypebuiltins.h"
 #include "gtkprivate.h"
 #include "gdkprofilerprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
 
 /*
  * CSS nodes are the backbone of the GtkStyleContext implementation and
@@ -355,6 +357,278 @@ store_in_global_parent_cache (GtkCssNode                  *node,
                                                  style);
 }
 
+static gboolean
+gtk_css_style_needs_recreation (GtkCssStyle  *style,
+                                GtkCssChange  change)
+{
+  gtk_internal_return_val_if_fail (GTK_IS_CSS_STATIC_STYLE (style), TRUE);
+
+  /* Try to avoid invalidating if we can */
+  if (change & GTK_CSS_RADICAL_CHANGE)
+    return TRUE;
+
+  if (gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (style)) & change)
+    return TRUE;
+  else
+    return FALSE;
+}
+
+/* When a lot of nodes need new styles, like after a theme change,
+ * gtk_css_node_validate() matches the selectors for all of them in
+ * threads before walking the tree, and gtk_css_node_create_style()
+ * then only needs to compute the values.
+ *
+ * Which nodes need new styles is only known during the walk, as it
+ * depends on how the styles of their parents and siblings change, so
+ * we match for all nodes that may need it. Styles are still created
+ * and style changes are emitted on the main thread, in tree order.
+ *
+ * If anything that affects matching changes during the walk, because
+ * a style-changed handler changed the tree, the remaining matches are
+ * dropped and the walk continues as usual.
+ */
+
+/* The minimum number of nodes to match in parallel */
+#define PARALLEL_MATCH_MIN_NODES 512
+
+typedef struct _GtkCssNodeMatch GtkCssNodeMatch;
+typedef struct _GtkCssNodeMatches GtkCssNodeMatches;
+
+struct _GtkCssNodeMatch
+{
+  GtkCssNode *node;
+  GtkStyleProvider *provider;
+  gboolean compute_change;
+
+  /* Results */
+  GtkCssChange change;
+  guint n_values;
+  guint *ids;
+  GtkCssLookupValue *values;
+  GHashTable *custom_values;
+};
+
+struct _GtkCssNodeMatches
+{
+  GArray *matches;
+  GHashTable *nodes;
+  guint generation;
+};
+
+static GtkCssNodeMatches *current_matches;
+
+/* Incremented whenever something that matching depends on changes */
+static guint match_generation;
+
+static void
+gtk_css_node_match_clear (gpointer data)
+{
+  GtkCssNodeMatch *match = data;
+
+  g_free (match->ids);
+  g_free (match->values);
+  g_clear_pointer (&match->custom_values, g_hash_table_unref);
+}
+
+/* Mirrors gtk_css_node_validate_internal() and the change propagation
+ * of gtk_css_node_do_ensure_style() to find the nodes that may need a
+ * new static style, assuming that the style of every node changes.
+ */
+static void
+gtk_css_node_collect_matches (GtkCssNode   *cssnode,
+                              GtkCssChange  change,
+                              GArray       *matches)
+{
+  GtkCssChange child_change, sibling_change;
+  GtkCssNode *child;
+  gboolean recreate;
+
+  if (!cssnode->invalid)
+    change &= ~GTK_CSS_CHANGE_TIMESTAMP;
+  change |= cssnode->pending_changes;
+
+  if (!cssnode->invalid && change == 0)
+    return;
+
+  recreate = (cssnode->style_is_invalid || change != 0) &&
+             gtk_css_style_needs_recreation (GTK_CSS_STYLE (gtk_css_style_get_static_style (cssnode->style)), change);
+
+  if (recreate)
+    {
+      GtkCssNodeMatch match = { 0, };
+
+      match.node = cssnode;
+      match.provider = gtk_css_node_get_style_provider (cssnode);
+      match.compute_change = (change & GTK_CSS_CHANGE_NEEDS_RECOMPUTE) ||
+                             gtk_css_static_style_get_change (gtk_css_style_get_static_style (cssnode->style)) == 0;
+      g_array_append_val (matches, match);
+    }
+
+  child_change = _gtk_css_change_for_child (change);
+  if (recreate)
+    child_change |= GTK_CSS_CHANGE_PARENT_STYLE;
+
+  sibling_change = 0;
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (!child->visible)
+        continue;
+
+      gtk_css_node_collect_matches (child, child_change | sibling_change, matches);
+      sibling_change |= _gtk_css_change_for_sibling (child->pending_changes);
+    }
+}
+
+static void
+gtk_css_node_match_add_ancestors (GtkCssNode             *cssnode,
+                                  GtkCountingBloomFilter *filter)
+{
+  for (; cssnode; cssnode = cssnode->parent)
+    gtk_css_node_declaration_add_bloom_hashes (cssnode->decl, filter);
+}
+
+/* This runs in a thread, it must only read the tree */
+static void
+gtk_css_node_match_range (gsize    start,
+                          gsize    end,
+                          gpointer data)
+{
+  GtkCssNodeMatch *matches = data;
+  GtkCountingBloomFilter filter = GTK_COUNTING_BLOOM_FILTER_INIT;
+  GtkCssNode *filter_parent = NULL;
+  GtkCssLookup lookup;
+  gsize i;
+  guint id;
+
+  for (i = start; i < end; i++)
+    {
+      GtkCssNodeMatch *match = &matches[i];
+
+      /* Consecutive matches are mostly siblings, so the filter
+       * rarely needs to be rebuilt */
+      if (i == start || match->node->parent != filter_parent)
+        {
+          memset (&filter, 0, sizeof (filter));
+          filter_parent = match->node->parent;
+          gtk_css_node_match_add_ancestors (filter_parent, &filter);
+        }
+
+      _gtk_css_lookup_init (&lookup);
+      gtk_style_provider_lookup (match->provider,
+                                 &filter,
+                                 match->node,
+                                 &lookup,
+                                 match->compute_change ? &match->change : NULL);
+
+      match->n_values = 0;
+      for (id = 0; id < GTK_CSS_PROPERTY_N_PROPERTIES; id++)
+        {
+          if (lookup.values[id].value)
+            match->n_values++;
+        }
+
+      match->ids = g_new (guint, match->n_values);
+      match->values = g_new (GtkCssLookupValue, match->n_values);
+      match->n_values = 0;
+      for (id = 0; id < GTK_CSS_PROPERTY_N_PROPERTIES; id++)
+        {
+          if (lookup.values[id].value)
+            {
+              match->ids[match->n_values] = id;
+              match->values[match->n_values] = lookup.values[id];
+              match->n_values++;
+            }
+        }
+
+      match->custom_values = g_steal_pointer (&lookup.custom_values);
+      _gtk_css_lookup_destroy (&lookup);
+    }
+}
+
+static GtkCssNodeMatches *
+gtk_css_node_match_all (GtkCssNode *cssnode)
+{
+  GtkCssNodeMatches *result;
+  GArray *matches;
+  guint i;
+
+  matches = g_array_new (FALSE, FALSE, sizeof (GtkCssNodeMatch));
+  g_array_set_clear_func (matches, gtk_css_node_match_clear);
+
+  gtk_css_node_collect_matches (cssnode, 0, matches);
+
+  if (matches->len < PARALLEL_MATCH_MIN_NODES)
+    {
+      g_array_unref (matches);
+      return NULL;
+    }
+
+  gdk_parallel_task_run (gtk_css_node_match_range, matches->data, matches->len, 32);
+
+  result = g_new (GtkCssNodeMatches, 1);
+  result->matches = matches;
+  result->nodes = g_hash_table_new (NULL, NULL);
+  result->generation = match_generation;
+
+  for (i = 0; i < matches->len; i++)
+    {
+      GtkCssNodeMatch *match = &g_array_index (matches, GtkCssNodeMatch, i);
+
+      g_hash_table_insert (result->nodes, match->node, match);
+    }
+
+  return result;
+}
+
+static void
+gtk_css_node_matches_free (GtkCssNodeMatches *matches)
+{
+  g_hash_table_unref (matches->nodes);
+  g_array_unref (matches->matches);
+  g_free (matches);
+}
+
+static GtkCssStyle *
+gtk_css_node_create_style_from_match (GtkCssNode   *cssnode,
+                                      GtkCssChange  style_change)
+{
+  GtkCssNodeMatch *match;
+  GtkCssStyle *style;
+  GtkCssLookup lookup;
+  guint i;
+
+  if (current_matches == NULL ||
+      current_matches->generation != match_generation)
+    return NULL;
+
+  match = g_hash_table_lookup (current_matches->nodes, cssnode);
+  if (match == NULL)
+    return NULL;
+
+  /* Each match is only used once */
+  g_hash_table_remove (current_matches->nodes, cssnode);
+
+  if (match->provider != gtk_css_node_get_style_provider (cssnode) ||
+      (style_change == 0 && !match->compute_change))
+    return NULL;
+
+  _gtk_css_lookup_init (&lookup);
+  for (i = 0; i < match->n_values; i++)
+    _gtk_css_lookup_set (&lookup, match->ids[i], match->values[i].section, match->values[i].value);
+  lookup.custom_values = g_steal_pointer (&match->custom_values);
+
+  style = gtk_css_static_style_new_for_lookup (match->provider,
+                                               &lookup,
+                                               cssnode,
+                                               style_change ? style_change : match->change);
+
+  _gtk_css_lookup_destroy (&lookup);
+
+  return style;
+}
+
 static GtkCssStyle *
 gtk_css_node_create_style (GtkCssNode                   *cssnode,
                            const GtkCountingBloomFilter *filter,
@@ -382,10 +656,12 @@ gtk_css_node_create_style (GtkCssNode                   *cssnode,
       style_change = gtk_css_static_style_get_change (gtk_css_style_get_static_style (cssnode->style));
     }
 
-  style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                            filter,
-                                            cssnode,
-                                            style_change);
+  style = gtk_css_node_create_style_from_match (cssnode, style_change);
+  if (style == NULL)
+    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
+                                              filter,
+                                              cssnode,
+                                              style_change);
 
   store_in_global_parent_cache (cssnode, decl, style);
 
@@ -398,22 +674,6 @@ should_create_transitions (GtkCssChange change)
   return (change & GTK_CSS_CHANGE_ANIMATIONS) == 0;
 }
 
-static gboolean
-gtk_css_style_needs_recreation (GtkCssStyle  *style,
-                                GtkCssChange  change)
-{
-  gtk_internal_return_val_if_fail (GTK_IS_CSS_STATIC_STYLE (style), TRUE);
-
-  /* Try to avoid invalidating if we can */
-  if (change & GTK_CSS_RADICAL_CHANGE)
-    return TRUE;
-
-  if (gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (style)) & change)
-    return TRUE;
-  else
-    return FALSE;
-}
-
 static GtkCssStyle *
 gtk_css_node_real_update_style (GtkCssNode                   *cssnode,
                                 const GtkCountingBloomFilter *filter,
@@ -698,6 +958,8 @@ gtk_css_node_reposition (GtkCssNode *node,
   old_parent = node->parent;
   old_previous = node->previous_sibling;
 
+  match_generation++;
+
   /* Take a reference here so the whole function has a reference */
   g_object_ref (node);
 
@@ -1024,6 +1286,7 @@ gtk_css_node_set_visible (GtkCssNode *cssnode,
     return;
 
   cssnode->visible = visible;
+  match_generation++;
   g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_VISIBLE]);
 
   if (cssnode->invalid)
@@ -1087,6 +1350,7 @@ gtk_css_node_set_name (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_set_name (&cssnode->decl, name))
     {
+      match_generation++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_NAME);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_NAME]);
     }
@@ -1104,6 +1368,7 @@ gtk_css_node_set_id (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_set_id (&cssnode->decl, id))
     {
+      match_generation++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ID);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_ID]);
     }
@@ -1128,6 +1393,8 @@ gtk_css_node_set_state (GtkCssNode    *cssnode,
       GtkStateFlags states = old_state ^ state_flags;
       GtkCssChange change = 0;
 
+      match_generation++;
+
       if (states & GTK_STATE_FLAG_PRELIGHT)
         change |= GTK_CSS_CHANGE_HOVER;
       if (states & GTK_STATE_FLAG_INSENSITIVE)
@@ -1158,6 +1425,7 @@ gtk_css_node_clear_classes (GtkCssNode *cssnode)
 {
   if (gtk_css_node_declaration_clear_classes (&cssnode->decl))
     {
+      match_generation++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1209,6 +1477,7 @@ gtk_css_node_add_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_add_class (&cssnode->decl, style_class))
     {
+      match_generation++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
       return TRUE;
@@ -1223,6 +1492,7 @@ gtk_css_node_remove_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_remove_class (&cssnode->decl, style_class))
     {
+      match_generation++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
       return TRUE;
@@ -1256,6 +1526,7 @@ gtk_css_node_invalidate_style_provider (GtkCssNode *cssnode)
 {
   GtkCssNode *child;
 
+  match_generation++;
   gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
 
   for (child = cssnode->first_child;
@@ -1359,6 +1630,7 @@ void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
   GtkCountingBloomFilter filter = GTK_COUNTING_BLOOM_FILTER_INIT;
+  GtkCssNodeMatches *matches, *saved_matches;
   gint64 timestamp;
   gint64 before G_GNUC_UNUSED;
 
@@ -1368,8 +1640,20 @@ gtk_css_node_validate (GtkCssNode *cssnode)
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
+  matches = gtk_css_node_match_all (cssnode);
+
+  if (GDK_PROFILER_IS_RUNNING && matches)
+    gdk_profiler_end_markf (before, "Match CSS", "%u nodes", matches->matches->len);
+
+  /* Style changed handlers may validate other trees */
+  saved_matches = current_matches;
+  current_matches = matches;
+
   gtk_css_node_validate_internal (cssnode, &filter, timestamp);
 
+  current_matches = saved_matches;
+  g_clear_pointer (&matches, gtk_css_node_matches_free);
+
   if (GDK_PROFILER_IS_RUNNING)
     {
       gdk_profiler_end_mark (before,  "Validate CSS", "");
@@ -103,6 +103,7 @@ struct _GtkCssProviderClass
 typedef struct GtkCssRuleset GtkCssRuleset;
 typedef struct _GtkCssScanner GtkCssScanner;
 typedef struct _PropertyValue PropertyValue;
+typedef struct _ImportInfo ImportInfo;
 typedef enum ParserScope ParserScope;
 typedef enum ParserSymbol ParserSymbol;
 
@@ -112,6 +113,12 @@ struct _PropertyValue {
   GtkCssSection       *section;
 };
 
+/* A file that was loaded with @import, for the stylesheet cache */
+struct _ImportInfo {
+  char *uri;
+  char *key;
+};
+
 struct GtkCssRuleset
 {
   GtkCssSelector *selector;
@@ -141,6 +148,9 @@ struct _GtkCssProviderPrivate
   GResource *resource;
   char *path;
   GBytes *bytes; /* *no* reference */
+
+  GPtrArray *imports; /* ImportInfo */
+  guint uncacheable : 1;
 };
 
 enum {
@@ -163,6 +173,17 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                 GtkCssScanner  *scanner,
                                 GFile          *file,
                                 GBytes         *bytes);
+static char *    gtk_css_provider_get_cache_key (GFile          *file,
+                                                 GBytes         *bytes);
+static void      gtk_css_provider_add_import    (GtkCssProvider *self,
+                                                 GFile          *file,
+                                                 GBytes         *bytes);
+static gboolean  gtk_css_provider_load_cache    (GtkCssProvider *self,
+                                                 GFile          *file,
+                                                 const char     *key);
+static void      gtk_css_provider_save_cache    (GtkCssProvider *self,
+                                                 GFile          *file,
+                                                 const char     *key);
 
 G_DEFINE_TYPE_EXTENDED (GtkCssProvider, gtk_css_provider, G_TYPE_OBJECT, 0,
                         G_ADD_PRIVATE (GtkCssProvider)
@@ -391,8 +412,12 @@ gtk_css_scanner_parser_error (GtkCssParser         *parser,
                               gpointer              user_data)
 {
   GtkCssScanner *scanner = user_data;
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkCssSection *section;
 
+  /* We want to report errors and warnings every time */
+  priv->uncacheable = TRUE;
+
   section = gtk_css_section_new_with_bytes (gtk_css_parser_get_file (parser),
                                             gtk_css_parser_get_bytes (parser),
                                             start,
@@ -442,6 +467,16 @@ gtk_css_scanner_would_recurse (GtkCssScanner *scanner,
   return FALSE;
 }
 
+static void
+import_info_free (gpointer data)
+{
+  ImportInfo *info = data;
+
+  g_free (info->uri);
+  g_free (info->key);
+  g_free (info);
+}
+
 static void
 gtk_css_provider_init (GtkCssProvider *css_provider)
 {
@@ -455,6 +490,7 @@ gtk_css_provider_init (GtkCssProvider *css_provider)
   priv->keyframes = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            (GDestroyNotify) g_free,
                                            (GDestroyNotify) _gtk_css_keyframes_unref);
+  priv->imports = g_ptr_array_new_with_free_func (import_info_free);
 }
 
 static void
@@ -613,6 +649,7 @@ gtk_css_provider_finalize (GObject *object)
 
   g_hash_table_destroy (priv->symbolic_colors);
   g_hash_table_destroy (priv->keyframes);
+  g_ptr_array_unref (priv->imports);
 
   if (priv->resource)
     {
@@ -692,6 +729,9 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
   g_array_set_size (priv->rulesets, 0);
   _gtk_css_selector_tree_free (priv->tree);
   priv->tree = NULL;
+
+  g_ptr_array_set_size (priv->imports, 0);
+  priv->uncacheable = FALSE;
 }
 
 static gboolean
@@ -892,10 +932,14 @@ parse_declaration (GtkCssScanner *scanner,
   /* This is a custom property */
   if (name[0] == '-' && name[1] == '-')
     {
+      GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
       GtkCssVariableValue *value;
       GtkCssLocation start_location;
       GtkCssSection *section;
 
+      /* The stylesheet cache can't store token streams */
+      priv->uncacheable = TRUE;
+
       if (!gtk_css_parser_try_token (scanner->parser, GTK_CSS_TOKEN_COLON))
         {
           gtk_css_parser_error_syntax (scanner->parser, "Expected ':'");
@@ -947,9 +991,12 @@ parse_declaration (GtkCssScanner *scanner,
 
       if (gtk_css_parser_has_references (scanner->parser))
         {
+          GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
           GtkCssLocation start_location;
           GtkCssVariableValue *var_value;
 
+          priv->uncacheable = TRUE;
+
           gtk_css_parser_skip_whitespace (scanner->parser);
 
           if (gtk_keep_css_sections)
@@ -1248,20 +1295,34 @@ gtk_css_provider_load_internal (GtkCssProvider *self,
 
   if (bytes)
     {
-      GtkCssScanner *scanner;
+      char *cache_key = NULL;
+
+      if (parent == NULL)
+        cache_key = gtk_css_provider_get_cache_key (file, bytes);
+      else
+        gtk_css_provider_add_import (self, file, bytes);
 
-      scanner = gtk_css_scanner_new (self,
-                                     parent,
-                                     file,
-                                     bytes);
+      if (cache_key == NULL || !gtk_css_provider_load_cache (self, file, cache_key))
+        {
+          GtkCssScanner *scanner;
 
-      parse_stylesheet (scanner);
+          scanner = gtk_css_scanner_new (self,
+                                         parent,
+                                         file,
+                                         bytes);
 
-      gtk_css_scanner_destroy (scanner);
+          parse_stylesheet (scanner);
 
-      if (parent == NULL)
-        gtk_css_provider_postprocess (self);
+          gtk_css_scanner_destroy (scanner);
+
+          if (parent == NULL)
+            gtk_css_provider_postprocess (self);
 
+          if (cache_key)
+            gtk_css_provider_save_cache (self, file, cache_key);
+        }
+
+      g_free (cache_key);
       g_bytes_unref (bytes);
     }
 
@@ -1830,3 +1891,771 @@ gtk_css_provider_to_string (GtkCssProvider *provider)
 
   return g_string_free (str, FALSE);
 }
+
+/* Stylesheet cache
+ *
+ * When enabled with the GTK_CSS_CACHE environment variable, stylesheets
+ * loaded from files are saved to a cache file after parsing, named after
+ * a checksum of their location and contents. When the same stylesheet is
+ * loaded again, the rulesets and the selector tree are recreated from
+ * the cache file instead of parsing it.
+ *
+ * Property values are kept in their printed form, but every distinct
+ * value is stored and parsed only once. Values are only cached if
+ * parsing them again gives the same value.
+ *
+ * Stylesheets with errors, warnings or custom properties aren't cached.
+ */
+
+#define CACHE_MAGIC "GTKCSS\0\0"
+#define CACHE_VERSION 1
+#define CACHE_BYTE_ORDER 0x01020304
+#define CACHE_GTK_VERSION (GTK_MAJOR_VERSION << 16 | GTK_MINOR_VERSION << 8 | GTK_MICRO_VERSION)
+#define CACHE_KEY_LENGTH 64 /* hex SHA-256 */
+
+typedef struct _CacheSection CacheSection;
+typedef struct _CacheHeader CacheHeader;
+typedef struct _CacheDependency CacheDependency;
+typedef struct _CacheRuleset CacheRuleset;
+typedef struct _CacheWriter CacheWriter;
+typedef struct _CacheReader CacheReader;
+typedef struct _CacheSaveJob CacheSaveJob;
+
+struct _CacheSection
+{
+  guint32 offset;
+  guint32 n_items;
+};
+
+struct _CacheHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 gtk_version;
+  guint32 pointer_size;
+  char key[CACHE_KEY_LENGTH];
+  guint32 at_rules;           /* string with the @define-color and @keyframes rules */
+  guint32 values_text;        /* string with all values, each followed by ';' */
+  CacheSection strings;       /* char, string ids are offsets */
+  CacheSection dependencies;  /* CacheDependency */
+  CacheSection values;        /* guint32, string id of the property name */
+  CacheSection styles;        /* guint32, index into values */
+  CacheSection rulesets;      /* CacheRuleset */
+  CacheSection tree;          /* guint32, see gtk_css_selector_tree_save() */
+};
+
+/* A file loaded with @import */
+struct _CacheDependency
+{
+  guint32 uri;
+  char key[CACHE_KEY_LENGTH];
+};
+
+struct _CacheRuleset
+{
+  guint32 first_style;
+  guint32 n_styles;
+  guint32 selector_match; /* offset into the tree */
+};
+
+G_STATIC_ASSERT (sizeof (CacheHeader) == 144);
+G_STATIC_ASSERT (sizeof (CacheDependency) == 68);
+G_STATIC_ASSERT (sizeof (CacheRuleset) == 12);
+
+struct _CacheWriter
+{
+  GString *strings;
+  GHashTable *string_ids;
+  GArray *rulesets;
+};
+
+struct _CacheReader
+{
+  const guint8 *data;
+  gsize size;
+  const char *strings;
+  gsize strings_size;
+  GArray *rulesets;
+};
+
+struct _CacheSaveJob
+{
+  char *path;
+  GBytes *bytes;
+};
+
+static const char *
+gtk_css_provider_get_cache_dir (void)
+{
+  static char *cache_dir = NULL;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      const char *env = g_getenv ("GTK_CSS_CACHE");
+
+      if (env != NULL && env[0] != '\0' && !g_str_equal (env, "0"))
+        {
+          if (g_path_is_absolute (env))
+            cache_dir = g_strdup (env);
+          else
+            cache_dir = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css-cache", NULL);
+        }
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return cache_dir;
+}
+
+static gboolean
+gtk_css_provider_cache_enabled (void)
+{
+#ifdef VERIFY_TREE
+  /* The cache does not keep the selectors */
+  return FALSE;
+#else
+  /* The cache does not keep sections */
+  return !gtk_keep_css_sections && gtk_css_provider_get_cache_dir () != NULL;
+#endif
+}
+
+static char *
+gtk_css_provider_compute_key (GFile  *file,
+                              GBytes *bytes)
+{
+  GChecksum *checksum;
+  gconstpointer data;
+  char *uri, *result;
+  gsize size;
+
+  uri = g_file_get_uri (file);
+  data = g_bytes_get_data (bytes, &size);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) uri, strlen (uri) + 1);
+  g_checksum_update (checksum, data, size);
+  result = g_strdup (g_checksum_get_string (checksum));
+
+  g_checksum_free (checksum);
+  g_free (uri);
+
+  return result;
+}
+
+static char *
+gtk_css_provider_get_cache_key (GFile  *file,
+                                GBytes *bytes)
+{
+  if (file == NULL || !gtk_css_provider_cache_enabled ())
+    return NULL;
+
+  return gtk_css_provider_compute_key (file, bytes);
+}
+
+static char *
+gtk_css_provider_get_cache_path (const char *key)
+{
+  char *filename, *path;
+
+  filename = g_strconcat (key, ".cache", NULL);
+  path = g_build_filename (gtk_css_provider_get_cache_dir (), filename, NULL);
+  g_free (filename);
+
+  return path;
+}
+
+static void
+gtk_css_provider_add_import (GtkCssProvider *self,
+                             GFile          *file,
+                             GBytes         *bytes)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (self);
+  ImportInfo *info;
+
+  if (file == NULL || !gtk_css_provider_cache_enabled ())
+    return;
+
+  info = g_new (ImportInfo, 1);
+  info->uri = g_file_get_uri (file);
+  info->key = gtk_css_provider_compute_key (file, bytes);
+
+  g_ptr_array_add (priv->imports, info);
+}
+
+static void
+cache_parser_error (GtkCssParser         *parser,
+                    const GtkCssLocation *start,
+                    const GtkCssLocation *end,
+                    const GError         *error,
+                    gpointer              user_data)
+{
+  gboolean *failed = user_data;
+
+  *failed = TRUE;
+}
+
+/* Parses the values_text of the cache */
+static GtkCssValue **
+gtk_css_provider_parse_cached_values (GFile                *file,
+                                      GBytes               *text,
+                                      GtkCssStyleProperty **properties,
+                                      gsize                 n_values)
+{
+  GtkCssParser *parser;
+  GtkCssValue **values;
+  gboolean failed = FALSE;
+  gsize i;
+
+  values = g_new0 (GtkCssValue *, n_values);
+  parser = gtk_css_parser_new_for_bytes (text, file, cache_parser_error, &failed, NULL);
+
+  for (i = 0; i < n_values && !failed; i++)
+    {
+      gtk_css_parser_start_semicolon_block (parser, GTK_CSS_TOKEN_EOF);
+
+      values[i] = _gtk_style_property_parse_value (GTK_STYLE_PROPERTY (properties[i]), parser);
+      if (values[i] == NULL || !gtk_css_parser_has_token (parser, GTK_CSS_TOKEN_EOF))
+        failed = TRUE;
+
+      gtk_css_parser_end_block (parser);
+    }
+
+  if (!gtk_css_parser_has_token (parser, GTK_CSS_TOKEN_EOF))
+    failed = TRUE;
+
+  gtk_css_parser_unref (parser);
+
+  if (failed)
+    {
+      for (i = 0; i < n_values; i++)
+        g_clear_pointer (&values[i], gtk_css_value_unref);
+      g_free (values);
+      return NULL;
+    }
+
+  return values;
+}
+
+static guint32
+cache_writer_add_string (const char *string,
+                         gpointer    data)
+{
+  CacheWriter *writer = data;
+  gpointer id;
+
+  if (g_hash_table_lookup_extended (writer->string_ids, string, NULL, &id))
+    return GPOINTER_TO_UINT (id);
+
+  id = GUINT_TO_POINTER (writer->strings->len);
+  g_hash_table_insert (writer->string_ids, g_strdup (string), id);
+  g_string_append_len (writer->strings, string, strlen (string) + 1);
+
+  return GPOINTER_TO_UINT (id);
+}
+
+static guint32
+cache_writer_add_match (gpointer match,
+                        gpointer data)
+{
+  CacheWriter *writer = data;
+
+  return (GtkCssRuleset *) match - (GtkCssRuleset *) writer->rulesets->data;
+}
+
+static void
+cache_append_section (GByteArray    *result,
+                      CacheSection  *section,
+                      gconstpointer  data,
+                      gsize          item_size,
+                      gsize          n_items)
+{
+  static const guint8 padding[4] = { 0, };
+
+  g_byte_array_append (result, padding, (4 - result->len % 4) % 4);
+
+  section->offset = result->len;
+  section->n_items = n_items;
+  g_byte_array_append (result, data, item_size * n_items);
+}
+
+static void
+cache_save_job_free (gpointer data)
+{
+  CacheSaveJob *job = data;
+
+  g_free (job->path);
+  g_bytes_unref (job->bytes);
+  g_free (job);
+}
+
+static void
+save_cache_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+  CacheSaveJob *job = task_data;
+  GError *error = NULL;
+  char *dir;
+
+  dir = g_path_get_dirname (job->path);
+
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      GTK_DEBUG (CSS, "Failed to create CSS cache directory '%s'", dir);
+    }
+  else if (!g_file_set_contents_full (job->path,
+                                      g_bytes_get_data (job->bytes, NULL),
+                                      g_bytes_get_size (job->bytes),
+                                      G_FILE_SET_CONTENTS_CONSISTENT,
+                                      0600,
+                                      &error))
+    {
+      GTK_DEBUG (CSS, "Failed to save CSS cache: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (dir);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+gtk_css_provider_save_cache (GtkCssProvider *self,
+                             GFile          *file,
+                             const char     *key)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (self);
+  CacheWriter writer;
+  CacheHeader header = { { 0, }, };
+  CacheSaveJob *job;
+  GString *at_rules, *values_text, *value_string;
+  GHashTable *value_ids, *first_styles;
+  GPtrArray *values, *properties;
+  GArray *value_props, *styles, *rulesets, *dependencies, *tree;
+  GtkCssValue **parsed;
+  GByteArray *result;
+  GBytes *text;
+  GTask *task;
+  gboolean valid;
+  guint i, j;
+
+  if (priv->uncacheable)
+    {
+      GTK_DEBUG (CSS, "Not caching %s, it has errors or custom properties", g_file_peek_path (file));
+      return;
+    }
+
+  writer.strings = g_string_new ("");
+  writer.string_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  writer.rulesets = priv->rulesets;
+
+  at_rules = g_string_new ("");
+  gtk_css_provider_print_colors (priv->symbolic_colors, at_rules);
+  gtk_css_provider_print_keyframes (priv->keyframes, at_rules);
+  header.at_rules = cache_writer_add_string (at_rules->str, &writer);
+  g_string_free (at_rules, TRUE);
+
+  values_text = g_string_new ("");
+  value_string = g_string_new ("");
+  value_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  first_styles = g_hash_table_new (NULL, NULL);
+  values = g_ptr_array_new ();
+  properties = g_ptr_array_new ();
+  value_props = g_array_new (FALSE, FALSE, sizeof (guint32));
+  styles = g_array_new (FALSE, FALSE, sizeof (guint32));
+  rulesets = g_array_new (FALSE, FALSE, sizeof (CacheRuleset));
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      CacheRuleset cache_ruleset;
+      gpointer first_style;
+
+      /* Rulesets from the same block share their styles */
+      if (g_hash_table_lookup_extended (first_styles, ruleset->styles, NULL, &first_style))
+        {
+          cache_ruleset.first_style = GPOINTER_TO_UINT (first_style);
+        }
+      else
+        {
+          cache_ruleset.first_style = styles->len;
+          g_hash_table_insert (first_styles, ruleset->styles, GUINT_TO_POINTER (styles->len));
+
+          for (j = 0; j < ruleset->n_styles; j++)
+            {
+              PropertyValue *style = &ruleset->styles[j];
+              const char *name = _gtk_style_property_get_name (GTK_STYLE_PROPERTY (style->property));
+              gpointer id;
+              guint32 value_id;
+
+              g_string_assign (value_string, name);
+              g_string_append_c (value_string, ':');
+              gtk_css_value_print (style->value, value_string);
+
+              if (!g_hash_table_lookup_extended (value_ids, value_string->str, NULL, &id))
+                {
+                  guint32 name_id = cache_writer_add_string (name, &writer);
+
+                  id = GUINT_TO_POINTER (values->len);
+                  g_hash_table_insert (value_ids, g_strdup (value_string->str), id);
+                  g_ptr_array_add (values, style->value);
+                  g_ptr_array_add (properties, style->property);
+                  g_array_append_val (value_props, name_id);
+                  g_string_append (values_text, value_string->str + strlen (name) + 1);
+                  g_string_append (values_text, ";\n");
+                }
+
+              value_id = GPOINTER_TO_UINT (id);
+              g_array_append_val (styles, value_id);
+            }
+        }
+
+      cache_ruleset.n_styles = ruleset->n_styles;
+      cache_ruleset.selector_match = (guint8 *) ruleset->selector_match - (guint8 *) priv->tree;
+      g_array_append_val (rulesets, cache_ruleset);
+    }
+
+  /* Make sure we get the same values back */
+  text = g_bytes_new (values_text->str, values_text->len);
+  parsed = gtk_css_provider_parse_cached_values (file,
+                                                 text,
+                                                 (GtkCssStyleProperty **) properties->pdata,
+                                                 values->len);
+  g_bytes_unref (text);
+
+  valid = parsed != NULL;
+  for (i = 0; i < values->len; i++)
+    {
+      if (parsed && !gtk_css_value_equal (g_ptr_array_index (values, i), parsed[i]))
+        {
+          char *s = gtk_css_value_to_string (g_ptr_array_index (values, i));
+          GTK_DEBUG (CSS, "Not caching %s, value '%s' does not survive printing",
+                     g_file_peek_path (file), s);
+          g_free (s);
+          valid = FALSE;
+          break;
+        }
+    }
+  if (parsed)
+    {
+      for (i = 0; i < values->len; i++)
+        gtk_css_value_unref (parsed[i]);
+      g_free (parsed);
+    }
+
+  if (valid)
+    {
+      header.values_text = cache_writer_add_string (values_text->str, &writer);
+
+      dependencies = g_array_new (FALSE, FALSE, sizeof (CacheDependency));
+      for (i = 0; i < priv->imports->len; i++)
+        {
+          ImportInfo *info = g_ptr_array_index (priv->imports, i);
+          CacheDependency dependency;
+
+          dependency.uri = cache_writer_add_string (info->uri, &writer);
+          memcpy (dependency.key, info->key, CACHE_KEY_LENGTH);
+          g_array_append_val (dependencies, dependency);
+        }
+
+      tree = g_array_new (FALSE, FALSE, sizeof (guint32));
+      gtk_css_selector_tree_save (priv->tree,
+                                  tree,
+                                  cache_writer_add_string,
+                                  cache_writer_add_match,
+                                  &writer);
+
+      result = g_byte_array_new ();
+      g_byte_array_set_size (result, sizeof (CacheHeader));
+      cache_append_section (result, &header.strings, writer.strings->str, 1, writer.strings->len);
+      cache_append_section (result, &header.dependencies, dependencies->data, sizeof (CacheDependency), dependencies->len);
+      cache_append_section (result, &header.values, value_props->data, sizeof (guint32), value_props->len);
+      cache_append_section (result, &header.styles, styles->data, sizeof (guint32), styles->len);
+      cache_append_section (result, &header.rulesets, rulesets->data, sizeof (CacheRuleset), rulesets->len);
+      cache_append_section (result, &header.tree, tree->data, sizeof (guint32), tree->len);
+
+      memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+      header.version = CACHE_VERSION;
+      header.byte_order = CACHE_BYTE_ORDER;
+      header.gtk_version = CACHE_GTK_VERSION;
+      header.pointer_size = sizeof (gpointer);
+      memcpy (header.key, key, CACHE_KEY_LENGTH);
+      memcpy (result->data, &header, sizeof (CacheHeader));
+
+      /* Writing the file may take a while */
+      job = g_new (CacheSaveJob, 1);
+      job->path = gtk_css_provider_get_cache_path (key);
+      job->bytes = g_byte_array_free_to_bytes (result);
+
+      GTK_DEBUG (CSS, "Saving %s to CSS cache '%s' (%u rulesets, %u values)",
+                 g_file_peek_path (file), job->path, rulesets->len, values->len);
+
+      task = g_task_new (NULL, NULL, NULL, NULL);
+      g_task_set_source_tag (task, gtk_css_provider_save_cache);
+      g_task_set_task_data (task, job, cache_save_job_free);
+      g_task_run_in_thread (task, save_cache_thread);
+      g_object_unref (task);
+
+      g_array_unref (tree);
+      g_array_unref (dependencies);
+    }
+
+  g_array_unref (rulesets);
+  g_array_unref (styles);
+  g_array_unref (value_props);
+  g_ptr_array_unref (properties);
+  g_ptr_array_unref (values);
+  g_hash_table_unref (first_styles);
+  g_hash_table_unref (value_ids);
+  g_string_free (value_string, TRUE);
+  g_string_free (values_text, TRUE);
+  g_hash_table_unref (writer.string_ids);
+  g_string_free (writer.strings, TRUE);
+}
+
+static gconstpointer
+cache_reader_get_section (CacheReader        *reader,
+                          const CacheSection *section,
+                          gsize               item_size)
+{
+  if (section->offset % 4 != 0 ||
+      section->offset > reader->size ||
+      section->n_items > (reader->size - section->offset) / item_size)
+    return NULL;
+
+  return reader->data + section->offset;
+}
+
+static const char *
+cache_reader_get_string (guint32  id,
+                         gpointer data)
+{
+  CacheReader *reader = data;
+
+  if (id >= reader->strings_size)
+    return NULL;
+
+  return reader->strings + id;
+}
+
+static gpointer
+cache_reader_get_match (guint32  id,
+                        gpointer data)
+{
+  CacheReader *reader = data;
+
+  if (id >= reader->rulesets->len)
+    return NULL;
+
+  return &g_array_index (reader->rulesets, GtkCssRuleset, id);
+}
+
+static gboolean
+cache_check_dependency (CacheReader           *reader,
+                        const CacheDependency *dependency)
+{
+  const char *uri;
+  GFile *file;
+  GBytes *bytes;
+  char *key;
+  gboolean unchanged;
+
+  uri = cache_reader_get_string (dependency->uri, reader);
+  if (uri == NULL)
+    return FALSE;
+
+  file = g_file_new_for_uri (uri);
+  bytes = g_file_load_bytes (file, NULL, NULL, NULL);
+  if (bytes)
+    {
+      key = gtk_css_provider_compute_key (file, bytes);
+      unchanged = memcmp (key, dependency->key, CACHE_KEY_LENGTH) == 0;
+      g_free (key);
+      g_bytes_unref (bytes);
+    }
+  else
+    unchanged = FALSE;
+
+  g_object_unref (file);
+
+  return unchanged;
+}
+
+static gboolean
+gtk_css_provider_load_cache (GtkCssProvider *self,
+                             GFile          *file,
+                             const char     *key)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (self);
+  const CacheHeader *header;
+  const CacheDependency *dependencies;
+  const CacheRuleset *rulesets;
+  const guint32 *value_props, *styles, *tree;
+  const char *at_rules, *values_text;
+  GtkCssStyleProperty **properties = NULL;
+  GtkCssValue **values = NULL;
+  GtkCssScanner *scanner;
+  GMappedFile *mapped;
+  CacheReader reader;
+  GBytes *bytes, *text;
+  gsize n_values, tree_size, i, j;
+  gboolean result = FALSE;
+  char *path;
+
+  path = gtk_css_provider_get_cache_path (key);
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  if (mapped == NULL)
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+
+  reader.data = g_bytes_get_data (bytes, &reader.size);
+  reader.rulesets = priv->rulesets;
+  header = (const CacheHeader *) reader.data;
+
+  if (reader.size < sizeof (CacheHeader) ||
+      memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+      header->version != CACHE_VERSION ||
+      header->byte_order != CACHE_BYTE_ORDER ||
+      header->gtk_version != CACHE_GTK_VERSION ||
+      header->pointer_size != sizeof (gpointer) ||
+      memcmp (header->key, key, CACHE_KEY_LENGTH) != 0)
+    goto out;
+
+  reader.strings = cache_reader_get_section (&reader, &header->strings, 1);
+  reader.strings_size = header->strings.n_items;
+  dependencies = cache_reader_get_section (&reader, &header->dependencies, sizeof (CacheDependency));
+  value_props = cache_reader_get_section (&reader, &header->values, sizeof (guint32));
+  styles = cache_reader_get_section (&reader, &header->styles, sizeof (guint32));
+  rulesets = cache_reader_get_section (&reader, &header->rulesets, sizeof (CacheRuleset));
+  tree = cache_reader_get_section (&reader, &header->tree, sizeof (guint32));
+
+  if (reader.strings == NULL || dependencies == NULL || value_props == NULL ||
+      styles == NULL || rulesets == NULL || tree == NULL ||
+      reader.strings_size == 0 || reader.strings[reader.strings_size - 1] != '\0')
+    goto out;
+
+  for (i = 0; i < header->dependencies.n_items; i++)
+    {
+      if (!cache_check_dependency (&reader, &dependencies[i]))
+        {
+          GTK_DEBUG (CSS, "Imports of %s changed, not using CSS cache", g_file_peek_path (file));
+          goto out;
+        }
+    }
+
+  n_values = header->values.n_items;
+  properties = g_new (GtkCssStyleProperty *, n_values);
+  for (i = 0; i < n_values; i++)
+    {
+      const char *name = cache_reader_get_string (value_props[i], &reader);
+      GtkStyleProperty *property = name ? _gtk_style_property_lookup (name) : NULL;
+
+      if (!GTK_IS_CSS_STYLE_PROPERTY (property))
+        goto out;
+
+      properties[i] = GTK_CSS_STYLE_PROPERTY (property);
+    }
+
+  at_rules = cache_reader_get_string (header->at_rules, &reader);
+  values_text = cache_reader_get_string (header->values_text, &reader);
+  if (at_rules == NULL || values_text == NULL)
+    goto out;
+
+  text = g_bytes_new_from_bytes (bytes, (const guint8 *) values_text - reader.data, strlen (values_text));
+  values = gtk_css_provider_parse_cached_values (file, text, properties, n_values);
+  g_bytes_unref (text);
+  if (values == NULL)
+    goto out;
+
+  /* @define-color and @keyframes are parsed the normal way */
+  text = g_bytes_new_from_bytes (bytes, (const guint8 *) at_rules - reader.data, strlen (at_rules));
+  scanner = gtk_css_scanner_new (self, NULL, file, text);
+  parse_stylesheet (scanner);
+  gtk_css_scanner_destroy (scanner);
+  g_bytes_unref (text);
+  if (priv->uncacheable)
+    goto out;
+
+  /* The tree points to the rulesets, so they need to exist first */
+  g_array_set_size (priv->rulesets, header->rulesets.n_items);
+  memset (priv->rulesets->data, 0, sizeof (GtkCssRuleset) * priv->rulesets->len);
+
+  if (!gtk_css_selector_tree_load (tree,
+                                   header->tree.n_items,
+                                   cache_reader_get_string,
+                                   cache_reader_get_match,
+                                   &reader,
+                                   &priv->tree,
+                                   &tree_size))
+    goto out;
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      const CacheRuleset *cache_ruleset = &rulesets[i];
+
+      if (cache_ruleset->first_style > header->styles.n_items ||
+          cache_ruleset->n_styles > header->styles.n_items - cache_ruleset->first_style ||
+          cache_ruleset->selector_match >= tree_size)
+        goto out;
+
+      ruleset->selector_match = (GtkCssSelectorTree *) ((guint8 *) priv->tree + cache_ruleset->selector_match);
+      ruleset->n_styles = cache_ruleset->n_styles;
+
+      /* Share the styles with the previous ruleset, like css_provider_commit() does */
+      if (i > 0 && cache_ruleset->first_style == rulesets[i - 1].first_style)
+        {
+          GtkCssRuleset *previous = &g_array_index (priv->rulesets, GtkCssRuleset, i - 1);
+
+          if (ruleset->n_styles != previous->n_styles)
+            goto out;
+
+          ruleset->styles = previous->styles;
+          continue;
+        }
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          if (styles[cache_ruleset->first_style + j] >= n_values)
+            goto out;
+        }
+
+      ruleset->owns_styles = TRUE;
+      ruleset->styles = g_new (PropertyValue, ruleset->n_styles);
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          guint32 value = styles[cache_ruleset->first_style + j];
+
+          ruleset->styles[j].property = properties[value];
+          ruleset->styles[j].value = gtk_css_value_ref (values[value]);
+          ruleset->styles[j].section = NULL;
+        }
+    }
+
+  GTK_DEBUG (CSS, "Loaded %s from CSS cache '%s'", g_file_peek_path (file), path);
+  result = TRUE;
+
+out:
+  if (values)
+    {
+      for (i = 0; i < n_values; i++)
+        gtk_css_value_unref (values[i]);
+      g_free (values);
+    }
+  g_free (properties);
+  g_bytes_unref (bytes);
+  g_free (path);
+
+  if (!result)
+    gtk_css_provider_reset (self);
+
+  return result;
+}
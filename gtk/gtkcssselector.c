@@ -2368,3 +2368,296 @@ _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder)
 
   return tree;
 }
+
+/* Serialization
+ *
+ * A tree is saved as a list of guint32: the size of the tree in bytes,
+ * the number of nodes and the number of match lists, followed by
+ * N_NODE_WORDS for every node:
+ *   offset, class, 2 words of data, parent, previous, sibling and matches
+ *   offsets
+ * and for every match list:
+ *   offset, number of matches, the matches
+ * Names are stored with save_string() and matches with save_match().
+ *
+ * The memory layout of the tree is kept as is, so the result is only
+ * valid for the same build of GTK on the same architecture.
+ */
+
+#define N_NODE_WORDS 8
+
+static const GtkCssSelectorClass *selector_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_ROOT,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_ROOT,
+};
+
+#define SELECTOR_DATA_SIZE (sizeof (GtkCssSelector) - sizeof (gpointer))
+G_STATIC_ASSERT (SELECTOR_DATA_SIZE <= 2 * sizeof (guint32));
+
+/* The selectors whose data is a GQuark */
+static gboolean
+gtk_css_selector_class_has_quark (const GtkCssSelectorClass *class)
+{
+  return class == &GTK_CSS_SELECTOR_NAME ||
+         class == &GTK_CSS_SELECTOR_NOT_NAME ||
+         class == &GTK_CSS_SELECTOR_CLASS ||
+         class == &GTK_CSS_SELECTOR_NOT_CLASS ||
+         class == &GTK_CSS_SELECTOR_ID ||
+         class == &GTK_CSS_SELECTOR_NOT_ID;
+}
+
+static void
+gtk_css_selector_tree_collect (const GtkCssSelectorTree *tree,
+                               GPtrArray                *nodes)
+{
+  while (tree != NULL)
+    {
+      g_ptr_array_add (nodes, (gpointer) tree);
+      gtk_css_selector_tree_collect (gtk_css_selector_tree_get_previous (tree), nodes);
+      tree = gtk_css_selector_tree_get_sibling (tree);
+    }
+}
+
+void
+gtk_css_selector_tree_save (const GtkCssSelectorTree     *tree,
+                            GArray                       *words,
+                            GtkCssSelectorSaveStringFunc  save_string,
+                            GtkCssSelectorSaveMatchFunc   save_match,
+                            gpointer                      data)
+{
+  GPtrArray *nodes;
+  guint header, n_matches, i, j;
+  gsize size;
+
+  header = words->len;
+  g_array_set_size (words, header + 3);
+
+  nodes = g_ptr_array_new ();
+  gtk_css_selector_tree_collect (tree, nodes);
+
+  size = 0;
+  for (i = 0; i < nodes->len; i++)
+    {
+      const GtkCssSelectorTree *node = g_ptr_array_index (nodes, i);
+      guint32 node_words[N_NODE_WORDS] = { 0, };
+      guint class_index;
+
+      for (class_index = 0; class_index < G_N_ELEMENTS (selector_classes); class_index++)
+        {
+          if (selector_classes[class_index] == node->selector.class)
+            break;
+        }
+      g_assert (class_index < G_N_ELEMENTS (selector_classes));
+
+      node_words[0] = (const guint8 *) node - (const guint8 *) tree;
+      node_words[1] = class_index;
+      if (gtk_css_selector_class_has_quark (node->selector.class))
+        node_words[2] = save_string (g_quark_to_string (node->selector.name.name), data);
+      else
+        memcpy (&node_words[2], (const guint8 *) &node->selector + sizeof (gpointer), SELECTOR_DATA_SIZE);
+      node_words[4] = node->parent_offset;
+      node_words[5] = node->previous_offset;
+      node_words[6] = node->sibling_offset;
+      node_words[7] = node->matches_offset;
+
+      g_array_append_vals (words, node_words, N_NODE_WORDS);
+
+      size = MAX (size, node_words[0] + sizeof (GtkCssSelectorTree));
+    }
+
+  n_matches = 0;
+  for (i = 0; i < nodes->len; i++)
+    {
+      const GtkCssSelectorTree *node = g_ptr_array_index (nodes, i);
+      gpointer *matches = gtk_css_selector_tree_get_matches (node);
+      guint32 offset, n;
+
+      if (matches == NULL)
+        continue;
+
+      for (n = 0; matches[n]; n++)
+        ;
+
+      offset = (const guint8 *) matches - (const guint8 *) tree;
+      g_array_append_val (words, offset);
+      g_array_append_val (words, n);
+      for (j = 0; j < n; j++)
+        {
+          guint32 id = save_match (matches[j], data);
+          g_array_append_val (words, id);
+        }
+
+      size = MAX (size, offset + (n + 1) * sizeof (gpointer));
+      n_matches++;
+    }
+
+  g_array_index (words, guint32, header) = size;
+  g_array_index (words, guint32, header + 1) = nodes->len;
+  g_array_index (words, guint32, header + 2) = n_matches;
+
+  g_ptr_array_unref (nodes);
+}
+
+static gboolean
+gtk_css_selector_tree_check_offset (gsize  size,
+                                    gsize  node_offset,
+                                    gint32 offset,
+                                    gsize  needed)
+{
+  gint64 target;
+
+  if (offset == GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+    return TRUE;
+
+  target = (gint64) node_offset + offset;
+
+  return target >= 0 && (guint64) target + needed <= size;
+}
+
+/*
+ * gtk_css_selector_tree_load:
+ * @words: the data written by gtk_css_selector_tree_save()
+ * @n_words: the number of words in @words
+ * @load_string: function to look up the strings from save_string()
+ * @load_match: function to look up the matches from save_match()
+ * @data: data for the functions
+ * @out_tree: (out) (transfer full): the tree, %NULL if it is empty
+ * @out_size: (out): size of the tree in bytes
+ *
+ * Recreates a tree saved with gtk_css_selector_tree_save().
+ *
+ * Returns: %FALSE if the data is invalid
+ */
+gboolean
+gtk_css_selector_tree_load (const guint32                *words,
+                            gsize                         n_words,
+                            GtkCssSelectorLoadStringFunc  load_string,
+                            GtkCssSelectorLoadMatchFunc   load_match,
+                            gpointer                      data,
+                            GtkCssSelectorTree          **out_tree,
+                            gsize                        *out_size)
+{
+  guint8 *tree;
+  gsize size, n_nodes, n_matches, pos, i, j;
+
+  if (n_words < 3)
+    return FALSE;
+
+  size = words[0];
+  n_nodes = words[1];
+  n_matches = words[2];
+  pos = 3;
+
+  if (n_nodes > (n_words - pos) / N_NODE_WORDS)
+    return FALSE;
+
+  if (size == 0)
+    {
+      if (n_nodes != 0 || n_matches != 0 || n_words != pos)
+        return FALSE;
+
+      *out_tree = NULL;
+      *out_size = 0;
+      return TRUE;
+    }
+
+  /* The extra NULL terminates the last match list */
+  tree = g_malloc0 (size + sizeof (gpointer));
+
+  for (i = 0; i < n_nodes; i++, pos += N_NODE_WORDS)
+    {
+      const guint32 *node_words = words + pos;
+      const GtkCssSelectorClass *class;
+      GtkCssSelectorTree *node;
+      gsize offset = node_words[0];
+
+      if (offset % G_ALIGNOF (GtkCssSelectorTree) != 0 ||
+          offset + sizeof (GtkCssSelectorTree) > size ||
+          node_words[1] >= G_N_ELEMENTS (selector_classes))
+        goto fail;
+
+      node = (GtkCssSelectorTree *) (tree + offset);
+      class = selector_classes[node_words[1]];
+
+      node->selector.class = class;
+      if (gtk_css_selector_class_has_quark (class))
+        {
+          const char *name = load_string (node_words[2], data);
+
+          if (name == NULL)
+            goto fail;
+
+          node->selector.name.name = g_quark_from_string (name);
+        }
+      else
+        memcpy ((guint8 *) &node->selector + sizeof (gpointer), &node_words[2], SELECTOR_DATA_SIZE);
+
+      node->parent_offset = node_words[4];
+      node->previous_offset = node_words[5];
+      node->sibling_offset = node_words[6];
+      node->matches_offset = node_words[7];
+
+      if (!gtk_css_selector_tree_check_offset (size, offset, node->parent_offset, sizeof (GtkCssSelectorTree)) ||
+          !gtk_css_selector_tree_check_offset (size, offset, node->previous_offset, sizeof (GtkCssSelectorTree)) ||
+          !gtk_css_selector_tree_check_offset (size, offset, node->sibling_offset, sizeof (GtkCssSelectorTree)) ||
+          !gtk_css_selector_tree_check_offset (size, offset, node->matches_offset, sizeof (gpointer)))
+        goto fail;
+    }
+
+  for (i = 0; i < n_matches; i++)
+    {
+      gpointer *matches;
+      gsize offset, n;
+
+      if (n_words - pos < 2)
+        goto fail;
+
+      offset = words[pos];
+      n = words[pos + 1];
+      pos += 2;
+
+      if (n > n_words - pos ||
+          n >= size / sizeof (gpointer) ||
+          offset % G_ALIGNOF (gpointer) != 0 ||
+          offset + (n + 1) * sizeof (gpointer) > size)
+        goto fail;
+
+      matches = (gpointer *) (tree + offset);
+      for (j = 0; j < n; j++)
+        {
+          matches[j] = load_match (words[pos + j], data);
+          if (matches[j] == NULL)
+            goto fail;
+        }
+      matches[n] = NULL;
+
+      pos += n;
+    }
+
+  if (pos != n_words)
+    goto fail;
+
+  *out_tree = (GtkCssSelectorTree *) tree;
+  *out_size = size;
+  return TRUE;
+
+fail:
+  g_free (tree);
+  return FALSE;
+}
@@ -70,5 +70,27 @@ void                       _gtk_css_selector_tree_builder_add   (GtkCssSelectorT
 GtkCssSelectorTree *       _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder);
 void                       _gtk_css_selector_tree_builder_free  (GtkCssSelectorTreeBuilder *builder);
 
+typedef guint32       (* GtkCssSelectorSaveStringFunc)  (const char   *string,
+                                                         gpointer      data);
+typedef guint32       (* GtkCssSelectorSaveMatchFunc)   (gpointer      match,
+                                                         gpointer      data);
+typedef const char *  (* GtkCssSelectorLoadStringFunc)  (guint32       id,
+                                                         gpointer      data);
+typedef gpointer      (* GtkCssSelectorLoadMatchFunc)   (guint32       id,
+                                                         gpointer      data);
+
+void                       gtk_css_selector_tree_save           (const GtkCssSelectorTree     *tree,
+                                                                 GArray                       *words,
+                                                                 GtkCssSelectorSaveStringFunc  save_string,
+                                                                 GtkCssSelectorSaveMatchFunc   save_match,
+                                                                 gpointer                      data);
+gboolean                   gtk_css_selector_tree_load           (const guint32                *words,
+                                                                 gsize                         n_words,
+                                                                 GtkCssSelectorLoadStringFunc  load_string,
+                                                                 GtkCssSelectorLoadMatchFunc   load_match,
+                                                                 gpointer                      data,
+                                                                 GtkCssSelectorTree          **out_tree,
+                                                                 gsize                        *out_size);
+
 G_END_DECLS
 
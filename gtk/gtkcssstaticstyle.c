@@ -992,9 +992,8 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
                                   GtkCssNode                   *node,
                                   GtkCssChange                  change)
 {
-  GtkCssStaticStyle *result;
+  GtkCssStyle *result;
   GtkCssLookup lookup;
-  GtkCssNode *parent;
 
   _gtk_css_lookup_init (&lookup);
 
@@ -1005,6 +1004,34 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
                                &lookup,
                                change == 0 ? &change : NULL);
 
+  result = gtk_css_static_style_new_for_lookup (provider, &lookup, node, change);
+
+  _gtk_css_lookup_destroy (&lookup);
+
+  return result;
+}
+
+/*
+ * gtk_css_static_style_new_for_lookup:
+ * @provider: the style provider
+ * @lookup: the result of gtk_style_provider_lookup() for @node
+ * @node: (nullable): the node
+ * @change: the change flags from the lookup
+ *
+ * Like gtk_css_static_style_new_compute(), but with a lookup that
+ * has already been done. This allows doing the lookup in a thread.
+ *
+ * Returns: (transfer full): the new style
+ */
+GtkCssStyle *
+gtk_css_static_style_new_for_lookup (GtkStyleProvider *provider,
+                                     GtkCssLookup     *lookup,
+                                     GtkCssNode       *node,
+                                     GtkCssChange      change)
+{
+  GtkCssStaticStyle *result;
+  GtkCssNode *parent;
+
   result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
 
   result->change = change;
@@ -1014,13 +1041,11 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
   else
     parent = NULL;
 
-  gtk_css_lookup_resolve (&lookup,
+  gtk_css_lookup_resolve (lookup,
                           provider,
                           result,
                           parent ? gtk_css_node_get_style (parent) : NULL);
 
-  _gtk_css_lookup_destroy (&lookup);
-
   return GTK_CSS_STYLE (result);
 }
 
@@ -34,6 +34,9 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
 
+/* gtkcsslookupprivate.h includes this header */
+struct _GtkCssLookup;
+
 
 struct _GtkCssStaticStyle
 {
@@ -57,6 +60,10 @@ GtkCssStyle *           gtk_css_static_style_new_compute        (GtkStyleProvide
                                                                  const GtkCountingBloomFilter   *filter,
                                                                  GtkCssNode                     *node,
                                                                  GtkCssChange                    change);
+GtkCssStyle *           gtk_css_static_style_new_for_lookup     (GtkStyleProvider               *provider,
+                                                                 struct _GtkCssLookup           *lookup,
+                                                                 GtkCssNode                     *node,
+                                                                 GtkCssChange                    change);
 GtkCssChange            gtk_css_static_style_get_change         (GtkCssStaticStyle              *style);
 
 G_END_DECLS
@@ -48,11 +48,23 @@
  * This means you do not need access to the `GtkDirectoryList`, but can access
  * the `GFile` directly from the `GFileInfo` when operating with a `GtkListView`
  * or similar.
+ *
+ * If [property@Gtk.DirectoryList:recursive] is set, the list also contains
+ * the contents of all subdirectories. They are enumerated in parallel.
  */
 
 /* random number that everyone else seems to use, too */
 #define FILES_PER_QUERY 100
 
+/* How many directories we enumerate at the same time in recursive mode */
+#define MAX_ENUMERATIONS 8
+
+/* Loaded files are announced at most once per frame */
+#define FLUSH_INTERVAL_MS 16
+
+/* How much main thread time we want to spend per batch of files */
+#define BATCH_TIME_BUDGET (4 * G_TIME_SPAN_MILLISECOND)
+
 enum {
   PROP_0,
   PROP_ATTRIBUTES,
@@ -63,6 +75,7 @@ enum {
   PROP_LOADING,
   PROP_MONITORED,
   PROP_N_ITEMS,
+  PROP_RECURSIVE,
 
   NUM_PROPERTIES
 };
@@ -94,12 +107,29 @@ struct _GtkDirectoryList
   GFile *file;
   GFileMonitor *monitor;
   gboolean monitored;
+  gboolean recursive;
   int io_priority;
 
   GCancellable *cancellable;
+  char *query_attributes;
   GError *error; /* Error while loading */
-  GSequence *items; /* Use GPtrArray or GListStore here? */
+  GPtrArray *items;
   GQueue events;
+
+  GQueue directories; /* GFiles waiting to be enumerated */
+  guint n_enumerations;
+
+  /* Files that have been loaded, but items-changed has not
+   * been emitted for yet */
+  GPtrArray *pending;
+  guint flush_id;
+
+  /* Batch sizes adapt to the time we spend on each file. The time
+   * is collected while loading and announcing files, the files are
+   * counted when they are announced */
+  guint files_per_query;
+  gint64 batch_time;
+  guint batch_files;
 };
 
 struct _GtkDirectoryListClass
@@ -120,7 +150,7 @@ gtk_directory_list_get_n_items (GListModel *list)
 {
   GtkDirectoryList *self = GTK_DIRECTORY_LIST (list);
 
-  return g_sequence_get_length (self->items);
+  return self->items->len;
 }
 
 static gpointer
@@ -128,14 +158,11 @@ gtk_directory_list_get_item (GListModel *list,
                              guint       position)
 {
   GtkDirectoryList *self = GTK_DIRECTORY_LIST (list);
-  GSequenceIter *iter;
-
-  iter = g_sequence_get_iter_at_pos (self->items, position);
 
-  if (g_sequence_iter_is_end (iter))
+  if (position >= self->items->len)
     return NULL;
   else
-    return g_object_ref (g_sequence_get (iter));
+    return g_object_ref (g_ptr_array_index (self->items, position));
 }
 
 static void
@@ -174,6 +201,10 @@ gtk_directory_list_set_property (GObject      *object,
       gtk_directory_list_set_monitored (self, g_value_get_boolean (value));
       break;
 
+    case PROP_RECURSIVE:
+      gtk_directory_list_set_recursive (self, g_value_get_boolean (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -219,7 +250,11 @@ gtk_directory_list_get_property (GObject     *object,
       break;
 
     case PROP_N_ITEMS:
-      g_value_set_uint (value, g_sequence_get_length (self->items));
+      g_value_set_uint (value, self->items->len);
+      break;
+
+    case PROP_RECURSIVE:
+      g_value_set_boolean (value, gtk_directory_list_get_recursive (self));
       break;
 
     default:
@@ -236,6 +271,9 @@ gtk_directory_list_stop_loading (GtkDirectoryList *self)
 
   g_cancellable_cancel (self->cancellable);
   g_clear_object (&self->cancellable);
+  g_clear_pointer (&self->query_attributes, g_free);
+  g_queue_clear_full (&self->directories, g_object_unref);
+  self->n_enumerations = 0;
   return TRUE;
 }
 
@@ -265,7 +303,9 @@ gtk_directory_list_dispose (GObject *object)
   g_clear_pointer (&self->attributes, g_free);
 
   g_clear_error (&self->error);
-  g_clear_pointer (&self->items, g_sequence_free);
+  g_clear_handle_id (&self->flush_id, g_source_remove);
+  g_clear_pointer (&self->pending, g_ptr_array_unref);
+  g_clear_pointer (&self->items, g_ptr_array_unref);
 
   g_queue_foreach (&self->events, (GFunc) free_queued_event, NULL);
   g_queue_clear (&self->events);
@@ -354,6 +394,18 @@ gtk_directory_list_class_init (GtkDirectoryListClass *class)
                             TRUE,
                             GTK_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
 
+  /**
+   * GtkDirectoryList:recursive:
+   *
+   * %TRUE if the contents of subdirectories are loaded, too.
+   *
+   * Since: 4.18
+   */
+  properties[PROP_RECURSIVE] =
+      g_param_spec_boolean ("recursive", NULL, NULL,
+                            FALSE,
+                            GTK_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
   /**
    * GtkDirectoryList:n-items:
    *
@@ -372,10 +424,13 @@ gtk_directory_list_class_init (GtkDirectoryListClass *class)
 static void
 gtk_directory_list_init (GtkDirectoryList *self)
 {
-  self->items = g_sequence_new (g_object_unref);
+  self->items = g_ptr_array_new_with_free_func (g_object_unref);
+  self->pending = g_ptr_array_new_with_free_func (g_object_unref);
   self->io_priority = G_PRIORITY_DEFAULT;
   self->monitored = TRUE;
+  self->files_per_query = FILES_PER_QUERY;
   g_queue_init (&self->events);
+  g_queue_init (&self->directories);
 }
 
 /**
@@ -407,11 +462,13 @@ gtk_directory_list_clear_items (GtkDirectoryList *self)
 {
   guint n_items;
 
-  n_items = g_sequence_get_length (self->items);
+  g_clear_handle_id (&self->flush_id, g_source_remove);
+  g_ptr_array_set_size (self->pending, 0);
+
+  n_items = self->items->len;
   if (n_items > 0)
     {
-      g_sequence_remove_range (g_sequence_get_begin_iter (self->items),
-                               g_sequence_get_end_iter (self->items));
+      g_ptr_array_set_size (self->items, 0);
 
       g_list_model_items_changed (G_LIST_MODEL (self), 0, n_items, 0);
       g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
@@ -424,6 +481,74 @@ gtk_directory_list_clear_items (GtkDirectoryList *self)
     }
 }
 
+static guint
+gtk_directory_list_get_max_files_per_query (GtkDirectoryList *self)
+{
+  return g_file_is_native (self->file) ? 50 * FILES_PER_QUERY : FILES_PER_QUERY;
+}
+
+/* Announces all pending files with a single items-changed, and
+ * picks the size of the next batches so that loading them takes
+ * about BATCH_TIME_BUDGET of main thread time.
+ */
+static void
+gtk_directory_list_flush (GtkDirectoryList *self)
+{
+  guint position, n;
+  gint64 start;
+
+  g_clear_handle_id (&self->flush_id, g_source_remove);
+
+  n = self->pending->len;
+  if (n == 0)
+    return;
+
+  start = g_get_monotonic_time ();
+
+  position = self->items->len;
+  g_ptr_array_extend_and_steal (self->items, self->pending);
+  self->pending = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_list_model_items_changed (G_LIST_MODEL (self), position, 0, n);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
+
+  self->batch_time += g_get_monotonic_time () - start;
+  self->batch_files += n;
+
+  if (self->file && self->batch_time > 0)
+    {
+      gint64 per_file = MAX (1, self->batch_time / self->batch_files);
+
+      self->files_per_query = CLAMP (BATCH_TIME_BUDGET / per_file,
+                                     FILES_PER_QUERY,
+                                     gtk_directory_list_get_max_files_per_query (self));
+    }
+
+  self->batch_time = 0;
+  self->batch_files = 0;
+}
+
+static gboolean
+gtk_directory_list_flush_cb (gpointer data)
+{
+  GtkDirectoryList *self = data;
+
+  self->flush_id = 0;
+  gtk_directory_list_flush (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtk_directory_list_queue_flush (GtkDirectoryList *self)
+{
+  if (self->flush_id != 0)
+    return;
+
+  self->flush_id = g_timeout_add (FLUSH_INTERVAL_MS, gtk_directory_list_flush_cb, self);
+  gdk_source_set_static_name_by_id (self->flush_id, "[gtk] gtk_directory_list_flush_cb");
+}
+
 static void
 gtk_directory_list_enumerator_closed_cb (GObject      *source,
                                          GAsyncResult *res,
@@ -432,6 +557,68 @@ gtk_directory_list_enumerator_closed_cb (GObject      *source,
   g_file_enumerator_close_finish (G_FILE_ENUMERATOR (source), res, NULL);
 }
 
+static void gtk_directory_list_got_enumerator_cb (GObject      *source,
+                                                  GAsyncResult *res,
+                                                  gpointer      user_data);
+
+static void
+gtk_directory_list_enumerate_directories (GtkDirectoryList *self)
+{
+  while (self->n_enumerations < MAX_ENUMERATIONS &&
+         !g_queue_is_empty (&self->directories))
+    {
+      GFile *directory = g_queue_pop_head (&self->directories);
+
+      self->n_enumerations++;
+      g_file_enumerate_children_async (directory,
+                                       self->query_attributes,
+                                       G_FILE_QUERY_INFO_NONE,
+                                       self->io_priority,
+                                       self->cancellable,
+                                       gtk_directory_list_got_enumerator_cb,
+                                       self);
+      g_object_unref (directory);
+    }
+}
+
+/* Called when enumerating a directory is done. In recursive mode,
+ * errors only end the enumeration of the directory they happen in,
+ * and the first one is reported.
+ */
+static void
+gtk_directory_list_enumeration_done (GtkDirectoryList *self,
+                                     GError           *error)
+{
+  g_assert (self->n_enumerations > 0);
+
+  self->n_enumerations--;
+  gtk_directory_list_enumerate_directories (self);
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  if (error)
+    {
+      if (self->error == NULL)
+        {
+          self->error = error;
+          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_ERROR]);
+        }
+      else
+        g_error_free (error);
+    }
+
+  if (self->n_enumerations == 0)
+    {
+      gtk_directory_list_flush (self);
+
+      g_clear_object (&self->cancellable);
+      g_clear_pointer (&self->query_attributes, g_free);
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LOADING]);
+    }
+
+  g_object_thaw_notify (G_OBJECT (self));
+}
+
 static void
 gtk_directory_list_got_files_cb (GObject      *source,
                                  GAsyncResult *res,
@@ -441,7 +628,7 @@ gtk_directory_list_got_files_cb (GObject      *source,
   GFileEnumerator *enumerator = G_FILE_ENUMERATOR (source);
   GError *error = NULL;
   GList *l, *files;
-  guint n;
+  gint64 start;
 
   files = g_file_enumerator_next_files_finish (enumerator, res, &error);
 
@@ -459,22 +646,12 @@ gtk_directory_list_got_files_cb (GObject      *source,
                                      gtk_directory_list_enumerator_closed_cb,
                                      NULL);
 
-      g_object_freeze_notify (G_OBJECT (self));
-
-      g_clear_object (&self->cancellable);
-      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LOADING]);
-
-      if (error)
-        {
-          self->error = error;
-          g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_ERROR]);
-        }
-
-      g_object_thaw_notify (G_OBJECT (self));
+      gtk_directory_list_enumeration_done (self, error);
       return;
     }
 
-  n = 0;
+  start = g_get_monotonic_time ();
+
   for (l = files; l; l = l->next)
     {
       GFileInfo *info;
@@ -483,24 +660,28 @@ gtk_directory_list_got_files_cb (GObject      *source,
       info = l->data;
       file = g_file_enumerator_get_child (enumerator, info);
       g_file_info_set_attribute_object (info, "standard::file", G_OBJECT (file));
+
+      if (self->recursive &&
+          g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
+          !g_file_info_get_is_symlink (info))
+        g_queue_push_tail (&self->directories, g_object_ref (file));
+
       g_object_unref (file);
-      g_sequence_append (self->items, info);
-      n++;
+      g_ptr_array_add (self->pending, info);
     }
   g_list_free (files);
 
+  self->batch_time += g_get_monotonic_time () - start;
+
   g_file_enumerator_next_files_async (enumerator,
-                                      g_file_is_native (self->file) ? 50 * FILES_PER_QUERY : FILES_PER_QUERY,
+                                      self->files_per_query,
                                       self->io_priority,
                                       self->cancellable,
                                       gtk_directory_list_got_files_cb,
                                       self);
 
-  if (n > 0)
-    {
-      g_list_model_items_changed (G_LIST_MODEL (self), g_sequence_get_length (self->items) - n, 0, n);
-      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
-    }
+  gtk_directory_list_enumerate_directories (self);
+  gtk_directory_list_queue_flush (self);
 }
 
 static void
@@ -522,17 +703,12 @@ gtk_directory_list_got_enumerator_cb (GObject      *source,
           return;
         }
 
-      g_object_freeze_notify (G_OBJECT (self));
-      self->error = error;
-      g_clear_object (&self->cancellable);
-      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LOADING]);
-      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_ERROR]);
-      g_object_thaw_notify (G_OBJECT (self));
+      gtk_directory_list_enumeration_done (self, error);
       return;
     }
 
   g_file_enumerator_next_files_async (enumerator,
-                                      g_file_is_native (file) ? 50 * FILES_PER_QUERY : FILES_PER_QUERY,
+                                      self->files_per_query,
                                       self->io_priority,
                                       self->cancellable,
                                       gtk_directory_list_got_files_cb,
@@ -544,7 +720,6 @@ static void
 gtk_directory_list_start_loading (GtkDirectoryList *self)
 {
   gboolean was_loading;
-  char *glib_apis_suck;
 
   was_loading = gtk_directory_list_stop_loading (self);
   gtk_directory_list_clear_items (self);
@@ -556,39 +731,54 @@ gtk_directory_list_start_loading (GtkDirectoryList *self)
       return;
     }
 
-  glib_apis_suck = g_strconcat ("standard::name,", self->attributes, NULL);
+  /* We need the name for g_file_enumerator_get_child() and
+   * the type to find subdirectories */
+  if (self->recursive)
+    self->query_attributes = g_strconcat ("standard::name,standard::type,standard::is-symlink,", self->attributes, NULL);
+  else
+    self->query_attributes = g_strconcat ("standard::name,", self->attributes, NULL);
+
   self->cancellable = g_cancellable_new ();
-  g_file_enumerate_children_async (self->file,
-                                   glib_apis_suck,
-                                   G_FILE_QUERY_INFO_NONE,
-                                   self->io_priority,
-                                   self->cancellable,
-                                   gtk_directory_list_got_enumerator_cb,
-                                   self);
-  g_free (glib_apis_suck);
+  self->files_per_query = FILES_PER_QUERY;
+  self->batch_time = 0;
+  self->batch_files = 0;
+
+  g_queue_push_tail (&self->directories, g_object_ref (self->file));
+  gtk_directory_list_enumerate_directories (self);
 
   if (!was_loading)
     g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LOADING]);
 }
 
-static GSequenceIter *
-find_file (GSequence *sequence,
-           GFile     *file)
+static gboolean
+find_file (GPtrArray *items,
+           GFile     *file,
+           guint     *position)
 {
-  GSequenceIter *iter;
+  guint i;
 
-  for (iter = g_sequence_get_begin_iter (sequence);
-       !g_sequence_iter_is_end (iter);
-       iter = g_sequence_iter_next (iter))
+  for (i = 0; i < items->len; i++)
     {
-      GFileInfo *item = G_FILE_INFO (g_sequence_get (iter));
+      GFileInfo *item = G_FILE_INFO (g_ptr_array_index (items, i));
       GFile *f = G_FILE (g_file_info_get_attribute_object (item, "standard::file"));
 
       if (g_file_equal (f, file))
-        return iter;
+        {
+          *position = i;
+          return TRUE;
+        }
     }
 
-  return NULL;
+  return FALSE;
+}
+
+static void
+replace_item (GPtrArray *items,
+              guint      position,
+              GFileInfo *info)
+{
+  g_object_unref (g_ptr_array_index (items, position));
+  g_ptr_array_index (items, position) = g_object_ref (info);
 }
 
 static gboolean
@@ -597,7 +787,6 @@ handle_event (QueuedEvent *event)
   GtkDirectoryList *self = event->list;
   GFile *file = event->file;
   GFileInfo *info = event->info;
-  GSequenceIter *iter;
   unsigned int position;
 
   switch ((int)event->event)
@@ -609,17 +798,15 @@ handle_event (QueuedEvent *event)
 
       g_file_info_set_attribute_object (info, "standard::file", G_OBJECT (file));
 
-      iter = find_file (self->items, file);
-      if (iter)
+      if (find_file (self->items, file, &position))
         {
-          position = g_sequence_iter_get_position (iter);
-          g_sequence_set (iter, g_object_ref (info));
+          replace_item (self->items, position, info);
           g_list_model_items_changed (G_LIST_MODEL (self), position, 1, 1);
         }
       else
         {
-          position = g_sequence_get_length (self->items);
-          g_sequence_append (self->items, g_object_ref (info));
+          position = self->items->len;
+          g_ptr_array_add (self->items, g_object_ref (info));
           g_list_model_items_changed (G_LIST_MODEL (self), position, 0, 1);
           g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
         }
@@ -627,11 +814,9 @@ handle_event (QueuedEvent *event)
 
     case G_FILE_MONITOR_EVENT_MOVED_OUT:
     case G_FILE_MONITOR_EVENT_DELETED:
-      iter = find_file (self->items, file);
-      if (iter)
+      if (find_file (self->items, file, &position))
         {
-          position = g_sequence_iter_get_position (iter);
-          g_sequence_remove (iter);
+          g_ptr_array_remove_index (self->items, position);
           g_list_model_items_changed (G_LIST_MODEL (self), position, 1, 0);
           g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
         }
@@ -643,11 +828,9 @@ handle_event (QueuedEvent *event)
 
       g_file_info_set_attribute_object (info, "standard::file", G_OBJECT (file));
 
-      iter = find_file (self->items, file);
-      if (iter)
+      if (find_file (self->items, file, &position))
         {
-          position = g_sequence_iter_get_position (iter);
-          g_sequence_set (iter, g_object_ref (info));
+          replace_item (self->items, position, info);
           g_list_model_items_changed (G_LIST_MODEL (self), position, 1, 1);
         }
       break;
@@ -664,6 +847,9 @@ handle_events (GtkDirectoryList *self)
 {
   QueuedEvent *event;
 
+  /* Events may refer to files we loaded but did not announce yet */
+  gtk_directory_list_flush (self);
+
   do
     {
       event = g_queue_peek_tail (&self->events);
@@ -1046,3 +1232,63 @@ gtk_directory_list_get_monitored (GtkDirectoryList *self)
 
   return self->monitored;
 }
+
+/**
+ * gtk_directory_list_set_recursive:
+ * @self: a `GtkDirectoryList`
+ * @recursive: %TRUE to load the contents of subdirectories
+ *
+ * Sets whether the directory list will also contain the contents
+ * of all subdirectories of [property@Gtk.DirectoryList:file].
+ *
+ * Subdirectories are enumerated in parallel, so files from different
+ * directories appear in the list in no particular order. Symbolic
+ * links to directories are not followed.
+ *
+ * An error in a subdirectory does not stop loading the others.
+ * The first error is available via [method@Gtk.DirectoryList.get_error].
+ *
+ * Only the toplevel directory is monitored for changes.
+ *
+ * Changing this property reloads the directory.
+ *
+ * Since: 4.18
+ */
+void
+gtk_directory_list_set_recursive (GtkDirectoryList *self,
+                                  gboolean          recursive)
+{
+  g_return_if_fail (GTK_IS_DIRECTORY_LIST (self));
+
+  if (self->recursive == recursive)
+    return;
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  self->recursive = recursive;
+
+  gtk_directory_list_start_loading (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_RECURSIVE]);
+
+  g_object_thaw_notify (G_OBJECT (self));
+}
+
+/**
+ * gtk_directory_list_get_recursive:
+ * @self: a `GtkDirectoryList`
+ *
+ * Returns whether the directory list contains the contents
+ * of subdirectories.
+ *
+ * Returns: %TRUE if subdirectories are loaded
+ *
+ * Since: 4.18
+ */
+gboolean
+gtk_directory_list_get_recursive (GtkDirectoryList *self)
+{
+  g_return_val_if_fail (GTK_IS_DIRECTORY_LIST (self), FALSE);
+
+  return self->recursive;
+}
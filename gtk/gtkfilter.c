@@ -19,7 +19,7 @@
 
 #include "config.h"
 
-#include "gtkfilter.h"
+#include "gtkfilterprivate.h"
 
 #include "gtktypebuiltins.h"
 #include "gtkprivate.h"
@@ -47,12 +47,19 @@
  * also possible to subclass `GtkFilter` and provide one's own filter.
  */
 
+typedef struct _GtkFilterPrivate GtkFilterPrivate;
+
+struct _GtkFilterPrivate
+{
+  GtkFilterKeys *keys;
+};
+
 enum {
   CHANGED,
   LAST_SIGNAL
 };
 
-G_DEFINE_TYPE (GtkFilter, gtk_filter, G_TYPE_OBJECT)
+G_DEFINE_TYPE_WITH_PRIVATE (GtkFilter, gtk_filter, G_TYPE_OBJECT)
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
@@ -71,11 +78,24 @@ gtk_filter_default_get_strictness (GtkFilter *self)
   return GTK_FILTER_MATCH_SOME;
 }
 
+static void
+gtk_filter_dispose (GObject *object)
+{
+  GtkFilter *self = GTK_FILTER (object);
+  GtkFilterPrivate *priv = gtk_filter_get_instance_private (self);
+
+  g_clear_pointer (&priv->keys, gtk_filter_keys_unref);
+
+  G_OBJECT_CLASS (gtk_filter_parent_class)->dispose (object);
+}
+
 static void
 gtk_filter_class_init (GtkFilterClass *class)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (class);
 
+  gobject_class->dispose = gtk_filter_dispose;
+
   class->match = gtk_filter_default_match;
   class->get_strictness = gtk_filter_default_get_strictness;
 
@@ -185,3 +205,55 @@ gtk_filter_changed (GtkFilter       *self,
   g_signal_emit (self, signals[CHANGED], 0, change);
 }
 
+/*<private>
+ * gtk_filter_get_keys:
+ * @self: a `GtkFilter`
+ *
+ * Gets keys that can be used to match items from other threads.
+ *
+ * Filters only have keys when all they look at can be taken out of
+ * the items in advance, so that matching doesn't need to call into
+ * the filter or the items. The keys can change every time
+ * [signal@Gtk.Filter::changed] is emitted.
+ *
+ * Returns: (nullable) (transfer full): the keys or %NULL if the
+ *   filter must be matched with gtk_filter_match()
+ */
+GtkFilterKeys *
+gtk_filter_get_keys (GtkFilter *self)
+{
+  GtkFilterPrivate *priv = gtk_filter_get_instance_private (self);
+
+  g_return_val_if_fail (GTK_IS_FILTER (self), NULL);
+
+  if (priv->keys == NULL)
+    return NULL;
+
+  return gtk_filter_keys_ref (priv->keys);
+}
+
+/*<private>
+ * gtk_filter_changed_with_keys:
+ * @self: a `GtkFilter`
+ * @change: How the filter changed
+ * @keys: (nullable) (transfer full): New keys to use
+ *
+ * Updates the filter's keys to @keys and then calls gtk_filter_changed().
+ *
+ * This function should also be called in your_filter_init() to initialize
+ * the keys to use with your filter.
+ */
+void
+gtk_filter_changed_with_keys (GtkFilter       *self,
+                              GtkFilterChange  change,
+                              GtkFilterKeys   *keys)
+{
+  GtkFilterPrivate *priv = gtk_filter_get_instance_private (self);
+
+  g_return_if_fail (GTK_IS_FILTER (self));
+
+  g_clear_pointer (&priv->keys, gtk_filter_keys_unref);
+  priv->keys = keys;
+
+  gtk_filter_changed (self, change);
+}
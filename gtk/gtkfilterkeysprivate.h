@@ -0,0 +1,88 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gdk/gdk.h>
+#include <gtk/gtkfilter.h>
+
+typedef struct _GtkFilterKeys GtkFilterKeys;
+typedef struct _GtkFilterKeysClass GtkFilterKeysClass;
+
+/* Filter keys split gtk_filter_match() into a part that looks at the
+ * item and a part that only looks at what was taken out of the item.
+ * Keys must be initialized and cleared in the main thread, but they
+ * can be matched from any thread.
+ */
+struct _GtkFilterKeys
+{
+  const GtkFilterKeysClass *klass;
+  int ref_count;
+
+  gsize key_size;
+  gsize key_align; /* must be power of 2 */
+};
+
+struct _GtkFilterKeysClass
+{
+  void                  (* free)                                (GtkFilterKeys          *self);
+
+  gboolean              (* match_key)                           (GtkFilterKeys          *self,
+                                                                 gconstpointer           key_memory);
+
+  void                  (* init_key)                            (GtkFilterKeys          *self,
+                                                                 gpointer                item,
+                                                                 gpointer                key_memory);
+  void                  (* clear_key)                           (GtkFilterKeys          *self,
+                                                                 gpointer                key_memory);
+};
+
+GtkFilterKeys *         gtk_filter_keys_alloc                   (const GtkFilterKeysClass *klass,
+                                                                 gsize                   size,
+                                                                 gsize                   key_size,
+                                                                 gsize                   key_align);
+#define gtk_filter_keys_new(_name, _klass, _key_size, _key_align) \
+    ((_name *) gtk_filter_keys_alloc ((_klass), sizeof (_name), (_key_size), (_key_align)))
+GtkFilterKeys *         gtk_filter_keys_ref                     (GtkFilterKeys          *self);
+void                    gtk_filter_keys_unref                   (GtkFilterKeys          *self);
+
+gsize                   gtk_filter_keys_get_key_size            (GtkFilterKeys          *self);
+gsize                   gtk_filter_keys_get_key_align           (GtkFilterKeys          *self);
+gboolean                gtk_filter_keys_needs_clear_key         (GtkFilterKeys          *self);
+
+#define GTK_FILTER_KEYS_ALIGN(_size,_align) (((_size) + (_align) - 1) & ~((_align) - 1))
+
+static inline gboolean
+gtk_filter_keys_match (GtkFilterKeys *self,
+                       gconstpointer  key_memory)
+{
+  return self->klass->match_key (self, key_memory);
+}
+
+static inline void
+gtk_filter_keys_init_key (GtkFilterKeys *self,
+                          gpointer       item,
+                          gpointer       key_memory)
+{
+  self->klass->init_key (self, item, key_memory);
+}
+
+static inline void
+gtk_filter_keys_clear_key (GtkFilterKeys *self,
+                           gpointer       key_memory)
+{
+  if (self->klass->clear_key)
+    self->klass->clear_key (self, key_memory);
+}
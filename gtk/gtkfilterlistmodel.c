@@ -22,9 +22,24 @@
 #include "gtkfilterlistmodel.h"
 
 #include "gtkbitset.h"
+#include "gtkfilterprivate.h"
 #include "gtkprivate.h"
 #include "gtksectionmodelprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
+
+/* The minimum number of items to filter with multiple threads
+ *
+ * When the filter has keys, the keys of large numbers of items are
+ * created in the main thread and then matched in parallel. When
+ * incremental, the keys are created step by step and the matching
+ * runs in a thread, with a single ::items-changed() signal when it
+ * is done.
+ */
+#define GTK_FILTER_PARALLEL_MIN_ITEMS (16 * 1024)
+/* The number of items matched by a single task */
+#define GTK_FILTER_PARALLEL_SHARD_SIZE (4 * 1024)
+
 /**
  * GtkFilterListModel:
  *
@@ -41,6 +56,27 @@
  * `GtkFilterListModel` passes through sections from the underlying model.
  */
 
+typedef struct _FilterJob FilterJob;
+
+struct _FilterJob
+{
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+
+  GCancellable *cancellable;
+  GtkFilterKeys *keys; /* released on the main thread by filter_job_release_keys() */
+  GtkBitset *items; /* the pending items when the job was created */
+  guint *positions; /* the same items as an array */
+  guint n_items;
+  guint n_keys; /* number of keys that have been initialized */
+  gsize key_stride;
+  char *key_memory;
+
+  GtkBitset **shards; /* the matches of every GTK_FILTER_PARALLEL_SHARD_SIZE items */
+  guint n_shards;
+};
+
 enum {
   PROP_0,
   PROP_FILTER,
@@ -64,6 +100,7 @@ struct _GtkFilterListModel
   GtkBitset *matches; /* NULL if strictness != GTK_FILTER_MATCH_SOME */
   GtkBitset *pending; /* not yet filtered items or NULL if all filtered */
   guint pending_cb; /* idle callback handle */
+  FilterJob *filter_job; /* NULL or parallel filtering of some of the pending items */
 };
 
 struct _GtkFilterListModelClass
@@ -250,6 +287,219 @@ gtk_filter_list_model_run_filter_on_item (GtkFilterListModel *self,
   return visible;
 }
 
+/* Keys may only be used on the main thread once the job is done,
+ * so this must be called before the job is freed.
+ */
+static void
+filter_job_release_keys (FilterJob *job)
+{
+  guint i;
+
+  if (job->keys == NULL)
+    return;
+
+  if (gtk_filter_keys_needs_clear_key (job->keys))
+    {
+      for (i = 0; i < job->n_keys; i++)
+        gtk_filter_keys_clear_key (job->keys, job->key_memory + i * job->key_stride);
+    }
+
+  g_clear_pointer (&job->keys, gtk_filter_keys_unref);
+}
+
+/* This is the task data of the job's thread, so it may be called
+ * from any thread. */
+static void
+filter_job_free (gpointer data)
+{
+  FilterJob *job = data;
+  guint i;
+
+  g_assert (job->keys == NULL);
+
+  for (i = 0; i < job->n_shards; i++)
+    g_clear_pointer (&job->shards[i], gtk_bitset_unref);
+
+  g_mutex_clear (&job->lock);
+  g_cond_clear (&job->cond);
+  g_object_unref (job->cancellable);
+  gtk_bitset_unref (job->items);
+  g_free (job->positions);
+  g_free (job->key_memory);
+  g_free (job->shards);
+  g_free (job);
+}
+
+static FilterJob *
+filter_job_new (GtkBitset     *items,
+                GtkFilterKeys *keys)
+{
+  GtkBitsetIter iter;
+  FilterJob *job;
+  guint i, pos;
+  gboolean more;
+
+  job = g_new0 (FilterJob, 1);
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->cond);
+  job->cancellable = g_cancellable_new ();
+  job->keys = keys;
+  job->items = gtk_bitset_copy (items);
+  job->n_items = gtk_bitset_get_size (items);
+  job->positions = g_new (guint, job->n_items);
+  for (i = 0, more = gtk_bitset_iter_init_first (&iter, items, &pos);
+       more;
+       i++, more = gtk_bitset_iter_next (&iter, &pos))
+    job->positions[i] = pos;
+  job->key_stride = GTK_FILTER_KEYS_ALIGN (gtk_filter_keys_get_key_size (keys),
+                                           gtk_filter_keys_get_key_align (keys));
+  job->key_memory = g_malloc_n (job->n_items, MAX (job->key_stride, 1));
+  job->n_shards = (job->n_items + GTK_FILTER_PARALLEL_SHARD_SIZE - 1) / GTK_FILTER_PARALLEL_SHARD_SIZE;
+  job->shards = g_new0 (GtkBitset *, job->n_shards);
+
+  return job;
+}
+
+/* Keys must be created in the main thread.
+ * Returns TRUE once all keys exist. */
+static gboolean
+filter_job_init_keys (FilterJob  *job,
+                      GListModel *model,
+                      guint       n_steps)
+{
+  guint end;
+
+  end = job->n_items - job->n_keys > n_steps ? job->n_keys + n_steps : job->n_items;
+
+  for (; job->n_keys < end; job->n_keys++)
+    {
+      gpointer item = g_list_model_get_item (model, job->positions[job->n_keys]);
+      gtk_filter_keys_init_key (job->keys, item, job->key_memory + job->n_keys * job->key_stride);
+      g_object_unref (item);
+    }
+
+  return job->n_keys == job->n_items;
+}
+
+static void
+filter_job_match_shards (gsize    start,
+                         gsize    end,
+                         gpointer data)
+{
+  FilterJob *job = data;
+  gsize shard, i, last;
+
+  for (shard = start; shard < end; shard++)
+    {
+      if (g_cancellable_is_cancelled (job->cancellable))
+        return;
+
+      job->shards[shard] = gtk_bitset_new_empty ();
+      last = MIN ((shard + 1) * GTK_FILTER_PARALLEL_SHARD_SIZE, job->n_items);
+      for (i = shard * GTK_FILTER_PARALLEL_SHARD_SIZE; i < last; i++)
+        {
+          if (gtk_filter_keys_match (job->keys, job->key_memory + i * job->key_stride))
+            gtk_bitset_add (job->shards[shard], job->positions[i]);
+        }
+    }
+}
+
+static void
+filter_job_match (FilterJob *job)
+{
+  gdk_parallel_task_run (filter_job_match_shards, job, job->n_shards, 1);
+}
+
+static void
+filter_job_wait (FilterJob *job)
+{
+  g_mutex_lock (&job->lock);
+  while (!job->done)
+    g_cond_wait (&job->cond, &job->lock);
+  g_mutex_unlock (&job->lock);
+}
+
+static void
+filter_job_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+  FilterJob *job = task_data;
+
+  filter_job_match (job);
+
+  g_mutex_lock (&job->lock);
+  job->done = TRUE;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/* Adds the matches of a finished job and removes its items from pending */
+static void
+gtk_filter_list_model_merge_filter_job (GtkFilterListModel *self,
+                                        FilterJob          *job)
+{
+  guint i;
+
+  for (i = 0; i < job->n_shards; i++)
+    gtk_bitset_union (self->matches, job->shards[i]);
+
+  gtk_bitset_subtract (self->pending, job->items);
+  if (gtk_bitset_is_empty (self->pending))
+    g_clear_pointer (&self->pending, gtk_bitset_unref);
+}
+
+static GtkFilterKeys *
+gtk_filter_list_model_get_parallel_keys (GtkFilterListModel *self)
+{
+  if (self->pending == NULL ||
+      gtk_bitset_get_size (self->pending) < GTK_FILTER_PARALLEL_MIN_ITEMS)
+    return NULL;
+
+  return gtk_filter_get_keys (self->filter);
+}
+
+static void
+gtk_filter_list_model_run_filter_parallel (GtkFilterListModel *self,
+                                           GtkFilterKeys      *keys)
+{
+  FilterJob *job;
+
+  job = filter_job_new (self->pending, keys);
+  filter_job_init_keys (job, self->model, G_MAXUINT);
+  filter_job_match (job);
+  filter_job_release_keys (job);
+  gtk_filter_list_model_merge_filter_job (self, job);
+  filter_job_free (job);
+}
+
+static void
+gtk_filter_list_model_stop_filter_job (GtkFilterListModel *self)
+{
+  FilterJob *job = g_steal_pointer (&self->filter_job);
+
+  if (job == NULL)
+    return;
+
+  if (job->n_keys < job->n_items)
+    {
+      /* Still creating keys, the thread hasn't been started */
+      filter_job_release_keys (job);
+      filter_job_free (job);
+    }
+  else
+    {
+      /* The job uses the keys, so wait for it to notice. The task
+       * frees the job. */
+      g_cancellable_cancel (job->cancellable);
+      filter_job_wait (job);
+      filter_job_release_keys (job);
+    }
+}
+
 static void
 gtk_filter_list_model_run_filter (GtkFilterListModel *self,
                                   guint               n_steps)
@@ -263,6 +513,21 @@ gtk_filter_list_model_run_filter (GtkFilterListModel *self,
   if (self->pending == NULL)
     return;
 
+  if (n_steps == G_MAXUINT)
+    {
+      GtkFilterKeys *keys;
+
+      gtk_filter_list_model_stop_filter_job (self);
+
+      keys = gtk_filter_list_model_get_parallel_keys (self);
+      if (keys)
+        {
+          gtk_filter_list_model_run_filter_parallel (self, keys);
+          g_assert (self->pending == NULL);
+          return;
+        }
+    }
+
   for (i = 0, more = gtk_bitset_iter_init_first (&iter, self->pending, &pos);
        i < n_steps && more;
        i++, more = gtk_bitset_iter_next (&iter, &pos))
@@ -282,6 +547,7 @@ gtk_filter_list_model_stop_filtering (GtkFilterListModel *self)
 {
   gboolean notify_pending = self->pending != NULL;
 
+  gtk_filter_list_model_stop_filter_job (self);
   g_clear_pointer (&self->pending, gtk_bitset_unref);
   g_clear_handle_id (&self->pending_cb, g_source_remove);
 
@@ -316,12 +582,100 @@ gtk_filter_list_model_emit_items_changed_for_changes (GtkFilterListModel *self,
   gtk_bitset_unref (old);
 }
 
+static gboolean gtk_filter_list_model_run_filter_cb (gpointer data);
+
+static void
+gtk_filter_list_model_ensure_filtering (GtkFilterListModel *self)
+{
+  if (self->pending_cb || self->filter_job)
+    return;
+
+  self->pending_cb = g_idle_add (gtk_filter_list_model_run_filter_cb, self);
+  gdk_source_set_static_name_by_id (self->pending_cb, "[gtk] gtk_filter_list_model_run_filter_cb");
+}
+
+/* Stops the job when its items or keys are no longer valid */
+static void
+gtk_filter_list_model_cancel_filter_job (GtkFilterListModel *self)
+{
+  if (self->filter_job == NULL)
+    return;
+
+  gtk_filter_list_model_stop_filter_job (self);
+  /* The job's items are still pending */
+  gtk_filter_list_model_ensure_filtering (self);
+}
+
+static void
+filter_job_done (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      data)
+{
+  GtkFilterListModel *self = GTK_FILTER_LIST_MODEL (source);
+  FilterJob *job = g_task_get_task_data (G_TASK (result));
+  GtkBitset *old;
+
+  /* The job may have been stopped already */
+  if (self->filter_job != job)
+    return;
+
+  self->filter_job = NULL;
+  filter_job_release_keys (job);
+  old = gtk_bitset_copy (self->matches);
+  gtk_filter_list_model_merge_filter_job (self, job);
+
+  if (self->pending == NULL)
+    gtk_filter_list_model_stop_filtering (self);
+  else
+    gtk_filter_list_model_ensure_filtering (self);
+
+  gtk_filter_list_model_emit_items_changed_for_changes (self, old);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+}
+
+/* Returns TRUE if the job is still creating keys */
+static gboolean
+gtk_filter_list_model_run_filter_job (GtkFilterListModel *self)
+{
+  FilterJob *job = self->filter_job;
+  GTask *task;
+
+  if (!filter_job_init_keys (job, self->model, 4096))
+    return TRUE;
+
+  task = g_task_new (self, NULL, filter_job_done, NULL);
+  g_task_set_source_tag (task, gtk_filter_list_model_run_filter_job);
+  g_task_set_task_data (task, job, filter_job_free);
+  g_task_run_in_thread (task, filter_job_thread);
+  g_object_unref (task);
+
+  return FALSE;
+}
+
 static gboolean
 gtk_filter_list_model_run_filter_cb (gpointer data)
 {
   GtkFilterListModel *self = data;
   GtkBitset *old;
 
+  if (self->filter_job == NULL)
+    {
+      GtkFilterKeys *keys = gtk_filter_list_model_get_parallel_keys (self);
+
+      if (keys)
+        self->filter_job = filter_job_new (self->pending, keys);
+    }
+
+  if (self->filter_job)
+    {
+      if (gtk_filter_list_model_run_filter_job (self))
+        return G_SOURCE_CONTINUE;
+
+      /* The rest happens in a thread */
+      self->pending_cb = 0;
+      return G_SOURCE_REMOVE;
+    }
+
   old = gtk_bitset_copy (self->matches);
   gtk_filter_list_model_run_filter (self, 512);
 
@@ -364,8 +718,7 @@ gtk_filter_list_model_start_filtering (GtkFilterListModel *self,
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
   g_assert (self->pending_cb == 0);
-  self->pending_cb = g_idle_add (gtk_filter_list_model_run_filter_cb, self);
-  gdk_source_set_static_name_by_id (self->pending_cb, "[gtk] gtk_filter_list_model_run_filter_cb");
+  gtk_filter_list_model_ensure_filtering (self);
 }
 
 static void
@@ -395,6 +748,10 @@ gtk_filter_list_model_items_changed_cb (GListModel         *model,
       g_assert_not_reached ();
     }
 
+  /* Appending doesn't move the items of the job */
+  if (self->filter_job && position <= gtk_bitset_get_maximum (self->filter_job->items))
+    gtk_filter_list_model_cancel_filter_job (self);
+
   if (removed > 0)
     filter_removed = gtk_bitset_get_size_in_range (self->matches, position, position + removed - 1);
   else
@@ -508,6 +865,9 @@ gtk_filter_list_model_refilter (GtkFilterListModel *self,
 {
   GtkFilterMatch new_strictness;
 
+  /* The job uses the old keys */
+  gtk_filter_list_model_cancel_filter_job (self);
+
   if (self->model == NULL)
     new_strictness = GTK_FILTER_MATCH_NONE;
   else if (self->filter == NULL)
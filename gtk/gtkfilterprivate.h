@@ -0,0 +1,11 @@
+#pragma once
+
+#include <gtk/gtkfilter.h>
+
+#include "gtk/gtkfilterkeysprivate.h"
+
+GtkFilterKeys *         gtk_filter_get_keys                     (GtkFilter              *self);
+
+void                    gtk_filter_changed_with_keys            (GtkFilter              *self,
+                                                                 GtkFilterChange         change,
+                                                                 GtkFilterKeys          *keys);
@@ -280,6 +280,8 @@ gtk_grid_view_update_factories_with (GtkGridView        *self,
 {
   GtkListTile *tile;
 
+  gtk_list_item_manager_clear_pool (self->item_manager);
+
   for (tile = gtk_list_item_manager_get_first (self->item_manager);
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
@@ -1473,6 +1475,8 @@ gtk_grid_view_set_single_click_activate (GtkGridView *self,
 
   self->single_click_activate = single_click_activate;
 
+  gtk_list_item_manager_clear_pool (self->item_manager);
+
   for (tile = gtk_list_item_manager_get_first (self->item_manager);
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
@@ -33,6 +33,7 @@
 #include "gtklistitemwidgetprivate.h"
 #include "gtkmultiselection.h"
 #include "gtkorientable.h"
+#include "gtkprivate.h"
 #include "gtkscrollable.h"
 #include "gtkscrollinfoprivate.h"
 #include "gtksingleselection.h"
@@ -47,6 +48,13 @@
  */
 #define GTK_LIST_BASE_CHILD_MAX_OVERDRAW 10
 
+/* When scrolling, prepare widgets for the items that will come into
+ * view within this time, so they don't need to be bound during a frame.
+ */
+#define GTK_LIST_BASE_OVERSCAN_TIME 0.25
+/* Scrolling is considered finished when no scroll happened for this long */
+#define GTK_LIST_BASE_OVERSCAN_SETTLE_MSEC 150
+
 typedef struct _RubberbandData RubberbandData;
 
 struct _RubberbandData
@@ -82,6 +90,12 @@ struct _GtkListBasePrivate
   GtkListItemTracker *selected;
   /* the item that has input focus */
   GtkListItemTracker *focus;
+  /* extra items in the scroll direction, see gtk_list_base_update_overscan() */
+  GtkListItemTracker *overscan;
+  guint overscan_id;
+  gint64 scroll_time;
+  double scroll_value;
+  double scroll_velocity;
 
   gboolean enable_rubberband;
   GtkGesture *drag_gesture;
@@ -179,6 +193,123 @@ gtk_list_base_get_adjustment_values (GtkListBase    *self,
     *page_size = ps;
 }
 
+static void
+gtk_list_base_get_anchor_range (GtkListBase *self,
+                                double       anchor_align_along,
+                                guint       *n_before,
+                                guint       *n_after)
+{
+  GtkListBasePrivate *priv = gtk_list_base_get_instance_private (self);
+  guint items_before;
+
+  items_before = round (priv->center_widgets * CLAMP (anchor_align_along, 0, 1));
+
+  *n_before = items_before + priv->above_below_widgets;
+  *n_after = priv->center_widgets - items_before + priv->above_below_widgets;
+}
+
+static gboolean
+gtk_list_base_update_overscan (gpointer data)
+{
+  GtkListBase *self = data;
+  GtkListBasePrivate *priv = gtk_list_base_get_instance_private (self);
+  guint anchor_pos, n_items, n_overscan, n_before, n_after;
+  int size;
+
+  priv->overscan_id = 0;
+
+  if (g_get_monotonic_time () - priv->scroll_time > GTK_LIST_BASE_OVERSCAN_SETTLE_MSEC * 1000)
+    priv->scroll_velocity = 0;
+
+  anchor_pos = gtk_list_item_tracker_get_position (priv->item_manager, priv->anchor);
+  n_items = gtk_list_base_get_n_items (self);
+  gtk_list_base_get_adjustment_values (self, priv->orientation, NULL, &size, NULL);
+
+  /* Estimate how many items will scroll into view soon, using the
+   * average item size. Never prepare more than a screenful. */
+  if (anchor_pos == GTK_INVALID_LIST_POSITION || n_items == 0 || size <= 0)
+    n_overscan = 0;
+  else
+    n_overscan = MIN (fabs (priv->scroll_velocity) * GTK_LIST_BASE_OVERSCAN_TIME * n_items / size,
+                      priv->center_widgets);
+
+  if (n_overscan == 0)
+    {
+      /* Release the widgets. They end up in the item manager's
+       * pool, so they are still around for the next scroll. */
+      if (priv->overscan)
+        {
+          gtk_list_item_tracker_free (priv->item_manager, priv->overscan);
+          priv->overscan = NULL;
+        }
+      return G_SOURCE_REMOVE;
+    }
+
+  gtk_list_base_get_anchor_range (self, priv->anchor_align_along, &n_before, &n_after);
+  if (priv->scroll_velocity > 0)
+    {
+      n_before = 0;
+      n_after += n_overscan;
+    }
+  else
+    {
+      n_before += n_overscan;
+      n_after = 0;
+    }
+
+  if (priv->overscan == NULL)
+    priv->overscan = gtk_list_item_tracker_new (priv->item_manager);
+  gtk_list_item_tracker_set_position (priv->item_manager,
+                                      priv->overscan,
+                                      anchor_pos,
+                                      n_before,
+                                      n_after);
+
+  /* check again when scrolling might have stopped */
+  priv->overscan_id = g_timeout_add_full (G_PRIORITY_LOW,
+                                          GTK_LIST_BASE_OVERSCAN_SETTLE_MSEC,
+                                          gtk_list_base_update_overscan,
+                                          self,
+                                          NULL);
+  gdk_source_set_static_name_by_id (priv->overscan_id, "[gtk] gtk_list_base_update_overscan");
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtk_list_base_update_scroll_velocity (GtkListBase *self)
+{
+  GtkListBasePrivate *priv = gtk_list_base_get_instance_private (self);
+  gint64 now;
+  int value;
+
+  now = g_get_monotonic_time ();
+  gtk_list_base_get_adjustment_values (self, priv->orientation, &value, NULL, NULL);
+
+  if (now - priv->scroll_time > GTK_LIST_BASE_OVERSCAN_SETTLE_MSEC * 1000)
+    {
+      priv->scroll_velocity = 0;
+    }
+  else if (now > priv->scroll_time)
+    {
+      double velocity = (value - priv->scroll_value) * G_USEC_PER_SEC / (now - priv->scroll_time);
+
+      /* smooth out uneven scroll events */
+      priv->scroll_velocity = (priv->scroll_velocity + velocity) / 2;
+    }
+
+  priv->scroll_time = now;
+  priv->scroll_value = value;
+
+  /* Bind the new widgets when idle instead of in the middle of a frame */
+  g_clear_handle_id (&priv->overscan_id, g_source_remove);
+  priv->overscan_id = g_idle_add_full (G_PRIORITY_LOW,
+                                       gtk_list_base_update_overscan,
+                                       self,
+                                       NULL);
+  gdk_source_set_static_name_by_id (priv->overscan_id, "[gtk] gtk_list_base_update_overscan");
+}
+
 static void
 gtk_list_base_adjustment_value_changed_cb (GtkAdjustment *adjustment,
                                            GtkListBase   *self)
@@ -190,6 +321,9 @@ gtk_list_base_adjustment_value_changed_cb (GtkAdjustment *adjustment,
   GtkPackType side_across, side_along;
   guint pos;
 
+  if (adjustment == priv->adjustment[priv->orientation])
+    gtk_list_base_update_scroll_velocity (self);
+
   gtk_list_base_get_adjustment_values (self, OPPOSITE_ORIENTATION (priv->orientation), &area.x, &total_size, &area.width);
   if (total_size == area.width)
     align_across = 0.5;
@@ -681,6 +815,12 @@ gtk_list_base_dispose (GObject *object)
       gtk_list_item_tracker_free (priv->item_manager, priv->focus);
       priv->focus = NULL;
     }
+  if (priv->overscan)
+    {
+      gtk_list_item_tracker_free (priv->item_manager, priv->overscan);
+      priv->overscan = NULL;
+    }
+  g_clear_handle_id (&priv->overscan_id, g_source_remove);
   g_clear_object (&priv->item_manager);
 
   g_clear_object (&priv->model);
@@ -2234,14 +2374,14 @@ gtk_list_base_set_anchor (GtkListBase *self,
                           GtkPackType  anchor_side_along)
 {
   GtkListBasePrivate *priv = gtk_list_base_get_instance_private (self);
-  guint items_before;
+  guint n_before, n_after;
 
-  items_before = round (priv->center_widgets * CLAMP (anchor_align_along, 0, 1));
+  gtk_list_base_get_anchor_range (self, anchor_align_along, &n_before, &n_after);
   gtk_list_item_tracker_set_position (priv->item_manager,
                                       priv->anchor,
                                       anchor_pos,
-                                      items_before + priv->above_below_widgets,
-                                      priv->center_widgets - items_before + priv->above_below_widgets);
+                                      n_before,
+                                      n_after);
 
   priv->anchor_align_across = anchor_align_across;
   priv->anchor_side_across = anchor_side_across;
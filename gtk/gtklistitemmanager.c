@@ -23,9 +23,13 @@
 
 #include "gtklistitembaseprivate.h"
 #include "gtklistitemwidgetprivate.h"
+#include "gtkprivate.h"
 #include "gtksectionmodel.h"
 #include "gtkwidgetprivate.h"
 
+/* How long unused widgets are kept in the pool */
+#define GTK_LIST_ITEM_MANAGER_POOL_TIMEOUT 5
+
 typedef struct _GtkListItemChange GtkListItemChange;
 
 struct _GtkListItemManager
@@ -39,6 +43,12 @@ struct _GtkListItemManager
   GtkRbTree *items;
   GSList *trackers;
 
+  /* unbound item widgets that survived a change, see
+   * gtk_list_item_change_finish() */
+  GQueue pool;
+  guint pool_timeout_id;
+  gboolean pool_used;
+
   GtkListTile * (* split_func) (GtkWidget *, GtkListTile *, guint);
   GtkListItemBase * (* create_widget) (GtkWidget *);
   void (* prepare_section) (GtkWidget *, GtkListTile *, guint);
@@ -60,6 +70,7 @@ struct _GtkListItemTracker
 
 struct _GtkListItemChange
 {
+  GtkListItemManager *manager;
   GHashTable *deleted_items;
   GQueue recycled_items;
   GQueue recycled_headers;
@@ -67,25 +78,128 @@ struct _GtkListItemChange
 
 G_DEFINE_TYPE (GtkListItemManager, gtk_list_item_manager, G_TYPE_OBJECT)
 
+static guint
+gtk_list_item_manager_get_pool_limit (GtkListItemManager *self)
+{
+  GSList *l;
+  guint limit = 0;
+
+  /* Keep at most as many spare widgets as there are widgets
+   * requested by the trackers, so the pool follows the size
+   * of the view and any overscan. */
+  for (l = self->trackers; l; l = l->next)
+    {
+      GtkListItemTracker *tracker = l->data;
+
+      if (tracker->position == GTK_INVALID_LIST_POSITION)
+        continue;
+
+      limit += tracker->n_before + tracker->n_after + 1;
+    }
+
+  return limit;
+}
+
+static gboolean
+gtk_list_item_manager_pool_timeout_cb (gpointer data)
+{
+  GtkListItemManager *self = data;
+
+  if (self->pool_used)
+    {
+      self->pool_used = FALSE;
+      return G_SOURCE_CONTINUE;
+    }
+
+  self->pool_timeout_id = 0;
+  gtk_list_item_manager_clear_pool (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtk_list_item_manager_pool_widget (GtkListItemManager *self,
+                                   GtkWidget          *widget,
+                                   guint               limit)
+{
+  if (self->pool.length >= limit)
+    {
+      gtk_widget_unparent (widget);
+      return;
+    }
+
+  /* Unbind it, but keep the factory's setup around */
+  gtk_list_item_base_update (GTK_LIST_ITEM_BASE (widget), GTK_INVALID_LIST_POSITION, NULL, FALSE);
+  g_queue_push_tail (&self->pool, g_object_ref (widget));
+  gtk_widget_unparent (widget);
+}
+
+static GtkListItemBase *
+gtk_list_item_manager_pop_pool (GtkListItemManager *self)
+{
+  GtkWidget *widget;
+
+  widget = g_queue_pop_head (&self->pool);
+  if (widget == NULL)
+    return NULL;
+
+  self->pool_used = TRUE;
+
+  /* Hand the pool's reference over to the parent */
+  gtk_widget_set_parent (widget, self->widget);
+  g_object_unref (widget);
+
+  return GTK_LIST_ITEM_BASE (widget);
+}
+
 static void
-gtk_list_item_change_init (GtkListItemChange *change)
+gtk_list_item_change_init (GtkListItemChange  *change,
+                           GtkListItemManager *manager)
 {
+  change->manager = manager;
   change->deleted_items = NULL;
   g_queue_init (&change->recycled_items);
   g_queue_init (&change->recycled_headers);
 }
 
+/*
+ * Widgets that were not reused during the change are not destroyed,
+ * but moved into the manager's pool, so a later change can rebind
+ * them instead of creating new ones via the factory. This matters when
+ * scrolling quickly, where every change releases widgets at one end and
+ * needs them at the other, and when replacing the model.
+ */
 static void
 gtk_list_item_change_finish (GtkListItemChange *change)
 {
+  GtkListItemManager *self = change->manager;
   GtkWidget *widget;
+  guint limit;
+
+  limit = gtk_list_item_manager_get_pool_limit (self);
 
-  g_clear_pointer (&change->deleted_items, g_hash_table_destroy);
+  if (change->deleted_items)
+    {
+      GHashTableIter iter;
+
+      g_hash_table_iter_init (&iter, change->deleted_items);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &widget))
+        gtk_list_item_manager_pool_widget (self, widget, limit);
+      g_clear_pointer (&change->deleted_items, g_hash_table_destroy);
+    }
 
   while ((widget = g_queue_pop_head (&change->recycled_items)))
-    gtk_widget_unparent (widget);
+    gtk_list_item_manager_pool_widget (self, widget, limit);
   while ((widget = g_queue_pop_head (&change->recycled_headers)))
     gtk_widget_unparent (widget);
+
+  if (self->pool.length > 0 && self->pool_timeout_id == 0)
+    {
+      self->pool_timeout_id = g_timeout_add_seconds (GTK_LIST_ITEM_MANAGER_POOL_TIMEOUT,
+                                                     gtk_list_item_manager_pool_timeout_cb,
+                                                     self);
+      gdk_source_set_static_name_by_id (self->pool_timeout_id, "[gtk] gtk_list_item_manager_pool_timeout_cb");
+    }
 }
 
 static void
@@ -111,12 +225,18 @@ static void
 gtk_list_item_change_release (GtkListItemChange *change,
                               GtkListItemBase   *widget)
 {
+  gpointer item = gtk_list_item_base_get_item (widget);
+  GtkListItemBase *other;
+
   if (change->deleted_items == NULL)
-    change->deleted_items = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) gtk_widget_unparent);
+    change->deleted_items = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-  if (!g_hash_table_replace (change->deleted_items, gtk_list_item_base_get_item (GTK_LIST_ITEM_BASE (widget)), widget))
+  other = g_hash_table_lookup (change->deleted_items, item);
+  g_hash_table_insert (change->deleted_items, item, widget);
+  if (other)
     {
       g_warning ("Duplicate item detected in list. Picking one randomly.");
+      gtk_list_item_change_recycle (change, other);
     }
 }
 
@@ -146,7 +266,7 @@ gtk_list_item_change_get (GtkListItemChange *change,
   if (result)
     return result;
 
-  return NULL;
+  return gtk_list_item_manager_pop_pool (change->manager);
 }
 
 static GtkListHeaderBase *
@@ -1449,7 +1569,7 @@ gtk_list_item_manager_model_items_changed_cb (GListModel         *model,
   GSList *l;
   guint n_items;
 
-  gtk_list_item_change_init (&change);
+  gtk_list_item_change_init (&change, self);
   n_items = g_list_model_get_n_items (G_LIST_MODEL (self->model));
 
   gtk_list_item_manager_remove_items (self, &change, position, removed);
@@ -1618,7 +1738,7 @@ gtk_list_item_manager_model_sections_changed_cb (GListModel         *model,
   if (!gtk_list_item_manager_has_sections (self))
     return;
 
-  gtk_list_item_change_init (&change);
+  gtk_list_item_change_init (&change, self);
 
   tile = gtk_list_item_manager_get_nth (self, position, &offset);
   header = gtk_list_tile_get_header (self, tile);
@@ -1711,7 +1831,7 @@ gtk_list_item_manager_clear_model (GtkListItemManager *self)
   if (self->model == NULL)
     return;
 
-  gtk_list_item_change_init (&change);
+  gtk_list_item_change_init (&change, self);
   gtk_list_item_manager_remove_items (self, &change, 0, g_list_model_get_n_items (G_LIST_MODEL (self->model)));
   gtk_list_item_change_finish (&change);
   for (l = self->trackers; l; l = l->next)
@@ -1741,6 +1861,7 @@ gtk_list_item_manager_dispose (GObject *object)
   GtkListItemManager *self = GTK_LIST_ITEM_MANAGER (object);
 
   gtk_list_item_manager_clear_model (self);
+  gtk_list_item_manager_clear_pool (self);
 
   g_clear_pointer (&self->items, gtk_rb_tree_unref);
 
@@ -1758,6 +1879,29 @@ gtk_list_item_manager_class_init (GtkListItemManagerClass *klass)
 static void
 gtk_list_item_manager_init (GtkListItemManager *self)
 {
+  g_queue_init (&self->pool);
+}
+
+/*<private>
+ * gtk_list_item_manager_clear_pool:
+ * @self: a `GtkListItemManager`
+ *
+ * Destroys all unused widgets kept around for reuse.
+ *
+ * This must be called whenever the widget changes the setup of
+ * its item widgets, like the factory, because only the widgets in
+ * the list are updated in that case.
+ */
+void
+gtk_list_item_manager_clear_pool (GtkListItemManager *self)
+{
+  GtkWidget *widget;
+
+  while ((widget = g_queue_pop_head (&self->pool)))
+    g_object_unref (widget);
+
+  g_clear_handle_id (&self->pool_timeout_id, g_source_remove);
+  self->pool_used = FALSE;
 }
 
 void
@@ -1792,7 +1936,7 @@ gtk_list_item_manager_set_model (GtkListItemManager *self,
                           G_CALLBACK (gtk_list_item_manager_model_sections_changed_cb),
                           self);
 
-      gtk_list_item_change_init (&change);
+      gtk_list_item_change_init (&change, self);
       gtk_list_item_manager_add_items (self, &change, 0, g_list_model_get_n_items (G_LIST_MODEL (model)));
       gtk_list_item_manager_ensure_items (self, &change, G_MAXUINT, 0);
       gtk_list_item_change_finish (&change);
@@ -1822,7 +1966,7 @@ gtk_list_item_manager_set_has_sections (GtkListItemManager *self,
 
   self->has_sections = has_sections;
 
-  gtk_list_item_change_init (&change);
+  gtk_list_item_change_init (&change, self);
 
   if (had_sections && !gtk_list_item_manager_has_sections (self))
     {
@@ -1903,7 +2047,7 @@ gtk_list_item_tracker_free (GtkListItemManager *self,
 
   g_free (tracker);
 
-  gtk_list_item_change_init (&change);
+  gtk_list_item_change_init (&change, self);
   gtk_list_item_manager_ensure_items (self, &change, G_MAXUINT, 0);
   gtk_list_item_change_finish (&change);
 
@@ -1934,7 +2078,7 @@ gtk_list_item_tracker_set_position (GtkListItemManager *self,
   tracker->n_before = n_before;
   tracker->n_after = n_after;
 
-  gtk_list_item_change_init (&change);
+  gtk_list_item_change_init (&change, self);
   gtk_list_item_manager_ensure_items (self, &change, G_MAXUINT, 0);
   gtk_list_item_change_finish (&change);
 
@@ -225,6 +225,8 @@ gtk_list_view_update_factories_with (GtkListView        *self,
 {
   GtkListTile *tile;
 
+  gtk_list_item_manager_clear_pool (self->item_manager);
+
   for (tile = gtk_list_item_manager_get_first (self->item_manager);
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
@@ -1254,6 +1256,8 @@ gtk_list_view_set_single_click_activate (GtkListView *self,
 
   self->single_click_activate = single_click_activate;
 
+  gtk_list_item_manager_clear_pool (self->item_manager);
+
   for (tile = gtk_list_item_manager_get_first (self->item_manager);
        tile != NULL;
        tile = gtk_rb_tree_node_get_next (tile))
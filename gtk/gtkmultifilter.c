@@ -22,6 +22,7 @@
 #include "gtkmultifilter.h"
 
 #include "gtkbuildable.h"
+#include "gtkfilterprivate.h"
 #include "gtktypebuiltins.h"
 
 #define GDK_ARRAY_TYPE_NAME GtkFilters
@@ -68,6 +69,25 @@ struct _GtkMultiFilterClass
 
   GtkFilterChange addition_change;
   GtkFilterChange removal_change;
+  gboolean match_any; /* for the keys */
+};
+
+typedef struct _GtkMultiFilterKey GtkMultiFilterKey;
+typedef struct _GtkMultiFilterKeys GtkMultiFilterKeys;
+
+struct _GtkMultiFilterKey
+{
+  gsize offset;
+  GtkFilterKeys *keys;
+};
+
+struct _GtkMultiFilterKeys
+{
+  GtkFilterKeys parent_keys;
+
+  gboolean match_any;
+  guint n_keys;
+  GtkMultiFilterKey keys[];
 };
 
 enum {
@@ -80,6 +100,106 @@ enum {
 
 static GParamSpec *properties[N_PROPS] = { NULL, };
 
+static void
+gtk_multi_filter_keys_free (GtkFilterKeys *keys)
+{
+  GtkMultiFilterKeys *self = (GtkMultiFilterKeys *) keys;
+  gsize i;
+
+  for (i = 0; i < self->n_keys; i++)
+    gtk_filter_keys_unref (self->keys[i].keys);
+
+  g_free (self);
+}
+
+static gboolean
+gtk_multi_filter_keys_match (GtkFilterKeys *keys,
+                             gconstpointer  key_memory)
+{
+  GtkMultiFilterKeys *self = (GtkMultiFilterKeys *) keys;
+  const char *key = key_memory;
+  gsize i;
+
+  for (i = 0; i < self->n_keys; i++)
+    {
+      if (gtk_filter_keys_match (self->keys[i].keys, key + self->keys[i].offset) == self->match_any)
+        return self->match_any;
+    }
+
+  return !self->match_any;
+}
+
+static void
+gtk_multi_filter_keys_init_key (GtkFilterKeys *keys,
+                                gpointer       item,
+                                gpointer       key_memory)
+{
+  GtkMultiFilterKeys *self = (GtkMultiFilterKeys *) keys;
+  char *key = key_memory;
+  gsize i;
+
+  for (i = 0; i < self->n_keys; i++)
+    gtk_filter_keys_init_key (self->keys[i].keys, item, key + self->keys[i].offset);
+}
+
+static void
+gtk_multi_filter_keys_clear_key (GtkFilterKeys *keys,
+                                 gpointer       key_memory)
+{
+  GtkMultiFilterKeys *self = (GtkMultiFilterKeys *) keys;
+  char *key = key_memory;
+  gsize i;
+
+  for (i = 0; i < self->n_keys; i++)
+    gtk_filter_keys_clear_key (self->keys[i].keys, key + self->keys[i].offset);
+}
+
+static const GtkFilterKeysClass GTK_MULTI_FILTER_KEYS_CLASS =
+{
+  gtk_multi_filter_keys_free,
+  gtk_multi_filter_keys_match,
+  gtk_multi_filter_keys_init_key,
+  gtk_multi_filter_keys_clear_key,
+};
+
+/* Returns NULL unless all the filters have keys */
+static GtkFilterKeys *
+gtk_multi_filter_keys_new (GtkMultiFilter *self)
+{
+  GtkMultiFilterKeys *result;
+  GtkFilterKeys *keys;
+  gsize i;
+
+  if (gtk_filters_get_size (&self->filters) == 1)
+    return gtk_filter_get_keys (gtk_filters_get (&self->filters, 0));
+
+  keys = gtk_filter_keys_alloc (&GTK_MULTI_FILTER_KEYS_CLASS,
+                                sizeof (GtkMultiFilterKeys) + gtk_filters_get_size (&self->filters) * sizeof (GtkMultiFilterKey),
+                                0, 1);
+  result = (GtkMultiFilterKeys *) keys;
+
+  result->match_any = GTK_MULTI_FILTER_GET_CLASS (self)->match_any;
+  for (i = 0; i < gtk_filters_get_size (&self->filters); i++)
+    {
+      GtkFilterKeys *child_keys = gtk_filter_get_keys (gtk_filters_get (&self->filters, i));
+
+      if (child_keys == NULL)
+        {
+          gtk_filter_keys_unref (keys);
+          return NULL;
+        }
+
+      result->keys[i].keys = child_keys;
+      result->n_keys++;
+      result->keys[i].offset = GTK_FILTER_KEYS_ALIGN (keys->key_size, gtk_filter_keys_get_key_align (child_keys));
+      keys->key_size = result->keys[i].offset + GTK_FILTER_KEYS_ALIGN (gtk_filter_keys_get_key_size (child_keys),
+                                                                       gtk_filter_keys_get_key_align (child_keys));
+      keys->key_align = MAX (keys->key_align, gtk_filter_keys_get_key_align (child_keys));
+    }
+
+  return keys;
+}
+
 static GType
 gtk_multi_filter_get_item_type (GListModel *list)
 {
@@ -145,7 +265,9 @@ gtk_multi_filter_changed_cb (GtkFilter       *filter,
                              GtkFilterChange  change,
                              GtkMultiFilter  *self)
 {
-  gtk_filter_changed (GTK_FILTER (self), change);
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                change,
+                                gtk_multi_filter_keys_new (self));
 }
 
 static void
@@ -249,8 +371,9 @@ gtk_multi_filter_append (GtkMultiFilter *self,
   g_list_model_items_changed (G_LIST_MODEL (self), gtk_filters_get_size (&self->filters) - 1, 0, 1);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
 
-  gtk_filter_changed (GTK_FILTER (self),
-                      GTK_MULTI_FILTER_GET_CLASS (self)->addition_change);
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                GTK_MULTI_FILTER_GET_CLASS (self)->addition_change,
+                                gtk_multi_filter_keys_new (self));
 }
 
 /**
@@ -281,8 +404,9 @@ gtk_multi_filter_remove (GtkMultiFilter *self,
   g_list_model_items_changed (G_LIST_MODEL (self), position, 1, 0);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
 
-  gtk_filter_changed (GTK_FILTER (self),
-                      GTK_MULTI_FILTER_GET_CLASS (self)->removal_change);
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                GTK_MULTI_FILTER_GET_CLASS (self)->removal_change,
+                                gtk_multi_filter_keys_new (self));
 }
 
 /*** ANY FILTER ***/
@@ -354,6 +478,7 @@ gtk_any_filter_class_init (GtkAnyFilterClass *class)
 
   multi_filter_class->addition_change = GTK_FILTER_CHANGE_LESS_STRICT;
   multi_filter_class->removal_change = GTK_FILTER_CHANGE_MORE_STRICT;
+  multi_filter_class->match_any = TRUE;
 
   filter_class->match = gtk_any_filter_match;
   filter_class->get_strictness = gtk_any_filter_get_strictness;
@@ -452,6 +577,7 @@ gtk_every_filter_class_init (GtkEveryFilterClass *class)
 
   multi_filter_class->addition_change = GTK_FILTER_CHANGE_MORE_STRICT;
   multi_filter_class->removal_change = GTK_FILTER_CHANGE_LESS_STRICT;
+  multi_filter_class->match_any = FALSE;
 
   filter_class->match = gtk_every_filter_match;
   filter_class->get_strictness = gtk_every_filter_get_strictness;
@@ -326,6 +326,8 @@ gtk_numeric_sort_keys_new (GtkNumericSorter *self)
     }
 
   result->expression = gtk_expression_ref (self->expression);
+  /* Keys are plain numbers */
+  result->keys.thread_safe = TRUE;
 
   return (GtkSortKeys *) result;
 }
@@ -95,6 +95,24 @@ gtk_sort_keys_needs_clear_key (GtkSortKeys *self)
   return self->klass->clear_key != NULL;
 }
 
+/*<private>
+ * gtk_sort_keys_is_thread_safe:
+ * @self: a `GtkSortKeys`
+ *
+ * Checks if keys can be compared from other threads.
+ *
+ * This is the case when comparing only looks at the keys,
+ * and doesn't call into the sorter or the items.
+ * Keys must always be initialized and cleared in the main thread.
+ *
+ * Returns: %TRUE if comparing keys is thread-safe
+ **/
+gboolean
+gtk_sort_keys_is_thread_safe (GtkSortKeys *self)
+{
+  return self->thread_safe;
+}
+
 static void
 gtk_equal_sort_keys_free (GtkSortKeys *keys)
 {
@@ -143,8 +161,13 @@ static const GtkSortKeysClass GTK_EQUAL_SORT_KEYS_CLASS =
 GtkSortKeys *
 gtk_sort_keys_new_equal (void)
 {
-  return gtk_sort_keys_new (GtkSortKeys,
-                            &GTK_EQUAL_SORT_KEYS_CLASS,
-                            0, 1);
+  GtkSortKeys *result;
+
+  result = gtk_sort_keys_new (GtkSortKeys,
+                              &GTK_EQUAL_SORT_KEYS_CLASS,
+                              0, 1);
+  result->thread_safe = TRUE;
+
+  return result;
 }
 
@@ -31,6 +31,7 @@ struct _GtkSortKeys
 
   gsize key_size;
   gsize key_align; /* must be power of 2 */
+  gboolean thread_safe; /* key_compare() may be called from any thread */
 };
 
 struct _GtkSortKeysClass
@@ -66,6 +67,7 @@ GCompareDataFunc        gtk_sort_keys_get_key_compare_func      (GtkSortKeys
 gboolean                gtk_sort_keys_is_compatible             (GtkSortKeys            *self,
                                                                  GtkSortKeys            *other);
 gboolean                gtk_sort_keys_needs_clear_key           (GtkSortKeys            *self);
+gboolean                gtk_sort_keys_is_thread_safe            (GtkSortKeys            *self);
 
 #define GTK_SORT_KEYS_ALIGN(_size,_align) (((_size) + (_align) - 1) & ~((_align) - 1))
 static inline int
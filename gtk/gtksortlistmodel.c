@@ -53,6 +53,16 @@
  */
 #define GTK_SORT_STEP_TIME_US (1000) /* 1 millisecond */
 
+/* The minimum number of items to sort with multiple threads
+ *
+ * When the sort keys can be compared from any thread, large lists are
+ * sorted with gtk_tim_sort_parallel() instead of being sorted step by
+ * step. Keys are still created in the main thread. When incremental,
+ * that happens step by step as usual, and the sort runs in a thread
+ * with a single ::items-changed() signal when it is done.
+ */
+#define GTK_SORT_PARALLEL_MIN_ITEMS (32 * 1024)
+
 /**
  * GtkSortListModel:
  *
@@ -84,6 +94,21 @@
  * inside their sections.
  */
 
+typedef struct _SortJob SortJob;
+
+struct _SortJob
+{
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+  guint progress; /* steps of gtk_tim_sort_parallel(), updated atomically */
+
+  GCancellable *cancellable;
+  gpointer *positions;
+  gsize n_items;
+  GtkSortKeys *sort_keys; /* owned by the model, which waits for the job before changing them */
+};
+
 enum {
   PROP_0,
   PROP_INCREMENTAL,
@@ -108,6 +133,8 @@ struct _GtkSortListModel
 
   GtkTimSort sort; /* ongoing sort operation */
   guint sort_cb; /* 0 or current ongoing sort callback */
+  gboolean sort_in_parallel; /* sort with gtk_tim_sort_parallel() once all keys exist */
+  SortJob *sort_job; /* NULL or sort running in a thread */
 
   guint n_items;
   GtkSortKeys *sort_keys;
@@ -325,7 +352,7 @@ gtk_sort_list_model_get_section (GtkSectionModel *model,
    * The fast path is O(log N) and will be used for I guess
    * 99% of cases.
    */
-  if (self->sort_cb)
+  if (self->sort_cb || self->sort_job)
     gtk_sort_list_model_get_section_unsorted (self, position, out_start, out_end);
   else
     gtk_sort_list_model_get_section_sorted (self, position, out_start, out_end);
@@ -344,13 +371,179 @@ G_DEFINE_TYPE_WITH_CODE (GtkSortListModel, gtk_sort_list_model, G_TYPE_OBJECT,
 static gboolean
 gtk_sort_list_model_is_sorting (GtkSortListModel *self)
 {
-  return self->sort_cb != 0;
+  return self->sort_cb != 0 || self->sort_job != NULL;
+}
+
+static void
+sort_job_free (gpointer data)
+{
+  SortJob *job = data;
+
+  g_mutex_clear (&job->lock);
+  g_cond_clear (&job->cond);
+  g_object_unref (job->cancellable);
+  g_free (job->positions);
+  g_free (job);
+}
+
+static void
+sort_job_wait (SortJob *job)
+{
+  g_mutex_lock (&job->lock);
+  while (!job->done)
+    g_cond_wait (&job->cond, &job->lock);
+  g_mutex_unlock (&job->lock);
+}
+
+static int sort_func (gconstpointer a,
+                      gconstpointer b,
+                      gpointer      data);
+
+static void
+sort_job_thread (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+  SortJob *job = task_data;
+
+  gtk_tim_sort_parallel (job->positions,
+                         job->n_items,
+                         sizeof (gpointer),
+                         sort_func,
+                         job->sort_keys,
+                         job->cancellable,
+                         &job->progress);
+
+  g_mutex_lock (&job->lock);
+  job->done = TRUE;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/* Replaces the positions with @sorted and returns the range that changed */
+static void
+gtk_sort_list_model_set_positions (GtkSortListModel *self,
+                                   gpointer         *sorted,
+                                   guint            *out_position,
+                                   guint            *out_n_items)
+{
+  guint start, end;
+
+  for (start = 0; start < self->n_items; start++)
+    {
+      if (self->positions[start] != sorted[start])
+        break;
+    }
+  for (end = self->n_items; end > start; end--)
+    {
+      if (self->positions[end - 1] != sorted[end - 1])
+        break;
+    }
+
+  g_free (self->positions);
+  self->positions = sorted;
+
+  *out_position = end > start ? start : 0;
+  *out_n_items = end - start;
+}
+
+static void
+gtk_sort_list_model_sort_parallel (GtkSortListModel *self,
+                                   guint            *out_position,
+                                   guint            *out_n_items)
+{
+  gpointer *sorted;
+
+  sorted = g_memdup2 (self->positions, sizeof (gpointer) * self->n_items);
+  gtk_tim_sort_parallel (sorted, self->n_items, sizeof (gpointer), sort_func, self->sort_keys, NULL, NULL);
+
+  gtk_sort_list_model_set_positions (self, sorted, out_position, out_n_items);
+}
+
+static void
+gtk_sort_list_model_finish_sort_job (GtkSortListModel *self,
+                                     guint            *out_position,
+                                     guint            *out_n_items)
+{
+  SortJob *job = g_steal_pointer (&self->sort_job);
+
+  sort_job_wait (job);
+  gtk_sort_list_model_set_positions (self, g_steal_pointer (&job->positions), out_position, out_n_items);
+  gtk_tim_sort_finish (&self->sort);
+}
+
+static void
+sort_job_done (GObject      *source,
+               GAsyncResult *result,
+               gpointer      data)
+{
+  GtkSortListModel *self = GTK_SORT_LIST_MODEL (source);
+  guint pos, n_items;
+
+  /* The job may have been stopped or finished already */
+  if (self->sort_job != g_task_get_task_data (G_TASK (result)))
+    return;
+
+  gtk_sort_list_model_finish_sort_job (self, &pos, &n_items);
+
+  if (n_items)
+    g_list_model_items_changed (G_LIST_MODEL (self), pos, n_items, n_items);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+}
+
+static void
+gtk_sort_list_model_start_sort_job (GtkSortListModel *self)
+{
+  SortJob *job;
+  GTask *task;
+
+  g_assert (self->sort_job == NULL);
+
+  job = g_new0 (SortJob, 1);
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->cond);
+  job->cancellable = g_cancellable_new ();
+  job->positions = g_memdup2 (self->positions, sizeof (gpointer) * self->n_items);
+  job->n_items = self->n_items;
+  job->sort_keys = self->sort_keys;
+
+  self->sort_job = job;
+
+  task = g_task_new (self, NULL, sort_job_done, NULL);
+  g_task_set_source_tag (task, gtk_sort_list_model_start_sort_job);
+  g_task_set_task_data (task, job, sort_job_free);
+  g_task_run_in_thread (task, sort_job_thread);
+  g_object_unref (task);
+}
+
+static void
+gtk_sort_list_model_stop_sort_job (GtkSortListModel *self)
+{
+  SortJob *job = g_steal_pointer (&self->sort_job);
+
+  /* The job uses the keys, so wait for it to notice */
+  g_cancellable_cancel (job->cancellable);
+  sort_job_wait (job);
 }
 
 static void
 gtk_sort_list_model_stop_sorting (GtkSortListModel *self,
                                   gsize            *runs)
 {
+  if (self->sort_job)
+    {
+      /* Nothing has been sorted yet */
+      gtk_sort_list_model_stop_sort_job (self);
+      if (runs)
+        runs[0] = 0;
+      gtk_tim_sort_finish (&self->sort);
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+      return;
+    }
+
   if (self->sort_cb == 0)
     {
       if (runs)
@@ -407,6 +600,21 @@ gtk_sort_list_model_sort_step (GtkSortListModel *self,
       gtk_bitset_remove_all (self->missing_keys);
     }
 
+  if (self->sort_in_parallel)
+    {
+      if (finish)
+        {
+          gtk_sort_list_model_sort_parallel (self, out_position, out_n_items);
+        }
+      else
+        {
+          gtk_sort_list_model_start_sort_job (self);
+          *out_position = 0;
+          *out_n_items = 0;
+        }
+      return TRUE;
+    }
+
   end_change = self->positions;
   start_change = self->positions + self->n_items;
 
@@ -448,6 +656,14 @@ gtk_sort_list_model_sort_cb (gpointer data)
       if (n_items)
         g_list_model_items_changed (G_LIST_MODEL (self), pos, n_items, n_items);
       g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+
+      if (self->sort_job)
+        {
+          /* The rest happens in a thread */
+          self->sort_cb = 0;
+          return G_SOURCE_REMOVE;
+        }
+
       return G_SOURCE_CONTINUE;
     }
 
@@ -476,6 +692,12 @@ gtk_sort_list_model_start_sorting (GtkSortListModel *self,
                                    gsize            *runs)
 {
   g_assert (self->sort_cb == 0);
+  g_assert (self->sort_job == NULL);
+
+  /* The parallel sort can't make use of runs, so only use it when sorting from scratch */
+  self->sort_in_parallel = (runs == NULL || runs[0] == 0) &&
+                           self->n_items >= GTK_SORT_PARALLEL_MIN_ITEMS &&
+                           gtk_sort_keys_is_thread_safe (self->sort_keys);
 
   gtk_tim_sort_init (&self->sort,
                      self->positions,
@@ -502,6 +724,13 @@ gtk_sort_list_model_finish_sorting (GtkSortListModel *self,
                                     guint            *pos,
                                     guint            *n_items)
 {
+  if (self->sort_job)
+    {
+      gtk_sort_list_model_finish_sort_job (self, pos, n_items);
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PENDING]);
+      return;
+    }
+
   gtk_tim_sort_set_max_merge_size (&self->sort, 0);
 
   gtk_sort_list_model_sort_step (self, TRUE, pos, n_items);
@@ -1380,6 +1609,15 @@ gtk_sort_list_model_get_pending (GtkSortListModel *self)
 {
   g_return_val_if_fail (GTK_IS_SORT_LIST_MODEL (self), FALSE);
 
+  /* Keys were all created before the job started, so that half is done */
+  if (self->sort_job)
+    {
+      guint n_steps = gtk_tim_sort_parallel_get_n_steps (self->sort_job->n_items);
+      guint progress = g_atomic_int_get (&self->sort_job->progress);
+
+      return (self->n_items - (guint64) self->n_items * MIN (progress, n_steps) / n_steps) / 2;
+    }
+
   if (self->sort_cb == 0)
     return 0;
 
@@ -21,6 +21,9 @@
 
 #include "gtkstringfilter.h"
 
+#include "gtkfilterprivate.h"
+#include "gtkstringkeycacheprivate.h"
+
 #include "gtktypebuiltins.h"
 
 /**
@@ -52,6 +55,8 @@ struct _GtkStringFilter
   GtkStringFilterMatchMode match_mode;
 
   GtkExpression *expression;
+
+  GtkStringKeyCache *cache;
 };
 
 enum {
@@ -68,8 +73,8 @@ G_DEFINE_TYPE (GtkStringFilter, gtk_string_filter, GTK_TYPE_FILTER)
 static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
 
 static char *
-gtk_string_filter_prepare (GtkStringFilter *self,
-                           const char      *s)
+gtk_string_filter_prepare (gboolean    ignore_case,
+                           const char *s)
 {
   char *tmp;
   char *result;
@@ -79,7 +84,7 @@ gtk_string_filter_prepare (GtkStringFilter *self,
 
   tmp = g_utf8_normalize (s, -1, G_NORMALIZE_ALL);
 
-  if (!self->ignore_case)
+  if (!ignore_case)
     return tmp;
 
   result = g_utf8_casefold (tmp, -1);
@@ -97,52 +102,189 @@ gtk_string_filter_has_search (GtkStringFilter *self)
   return self->search_prepared != NULL;
 }
 
+static GtkStringKeyKind
+gtk_string_filter_get_key_kind (gboolean ignore_case)
+{
+  return ignore_case ? GTK_STRING_KEY_NORMALIZE_CASEFOLD : GTK_STRING_KEY_NORMALIZE;
+}
+
+/* Doesn't look at the filter, so it can be used from other threads.
+ * @prepared is the string as returned by gtk_string_filter_prepare().
+ */
 static gboolean
-gtk_string_filter_match (GtkFilter *filter,
-                         gpointer   item)
+gtk_string_filter_match_prepared (const char               *search_prepared,
+                                  GtkStringFilterMatchMode  match_mode,
+                                  const char               *prepared)
 {
-  GtkStringFilter *self = GTK_STRING_FILTER (filter);
-  GValue value = G_VALUE_INIT;
-  char *prepared;
-  const char *s;
   gboolean result;
 
-  if (!gtk_string_filter_has_search (self))
-    return TRUE;
-
-  if (self->expression == NULL ||
-      !gtk_expression_evaluate (self->expression, item, &value))
-    return FALSE;
-  s = g_value_get_string (&value);
-  prepared = gtk_string_filter_prepare (self, s);
-  if (prepared == NULL)
+  if (prepared == NULL || prepared[0] == '\0')
     return FALSE;
 
-  switch (self->match_mode)
+  switch (match_mode)
     {
     case GTK_STRING_FILTER_MATCH_MODE_EXACT:
-      result = strcmp (prepared, self->search_prepared) == 0;
+      result = strcmp (prepared, search_prepared) == 0;
       break;
     case GTK_STRING_FILTER_MATCH_MODE_SUBSTRING:
-      result = strstr (prepared, self->search_prepared) != NULL;
+      result = strstr (prepared, search_prepared) != NULL;
       break;
     case GTK_STRING_FILTER_MATCH_MODE_PREFIX:
-      result = g_str_has_prefix (prepared, self->search_prepared);
+      result = g_str_has_prefix (prepared, search_prepared);
       break;
     default:
       g_assert_not_reached ();
     }
 
 #if 0
-  g_print ("%s (%s) %s %s (%s)\n", s, prepared, result ? "==" : "!=", self->search, self->search_prepared);
+  g_print ("%s %s %s\n", prepared, result ? "==" : "!=", search_prepared);
 #endif
 
-  g_free (prepared);
+  return result;
+}
+
+static gboolean
+gtk_string_filter_match (GtkFilter *filter,
+                         gpointer   item)
+{
+  GtkStringFilter *self = GTK_STRING_FILTER (filter);
+  GValue value = G_VALUE_INIT;
+  GtkStringKey *key;
+  gboolean result;
+
+  if (!gtk_string_filter_has_search (self))
+    return TRUE;
+
+  if (self->expression == NULL ||
+      !gtk_expression_evaluate (self->expression, item, &value))
+    return FALSE;
+
+  if (self->cache == NULL)
+    self->cache = gtk_string_key_cache_get ();
+
+  result = gtk_string_filter_match_prepared (self->search_prepared,
+                                             self->match_mode,
+                                             gtk_string_key_cache_lookup (self->cache,
+                                                                          g_value_get_string (&value),
+                                                                          gtk_string_filter_get_key_kind (self->ignore_case),
+                                                                          &key));
+
+  gtk_string_key_unref (key);
   g_value_unset (&value);
 
   return result;
 }
 
+/* The contents of the key memory */
+typedef struct _GtkStringFilterKey GtkStringFilterKey;
+struct _GtkStringFilterKey
+{
+  const char *prepared;
+  GtkStringKey *key; /* keeps prepared alive */
+};
+
+typedef struct _GtkStringFilterKeys GtkStringFilterKeys;
+struct _GtkStringFilterKeys
+{
+  GtkFilterKeys keys;
+
+  GtkStringKeyCache *cache;
+  GtkExpression *expression;
+  char *search_prepared;
+  gboolean ignore_case;
+  GtkStringFilterMatchMode match_mode;
+};
+
+static void
+gtk_string_filter_keys_free (GtkFilterKeys *keys)
+{
+  GtkStringFilterKeys *self = (GtkStringFilterKeys *) keys;
+
+  g_clear_pointer (&self->expression, gtk_expression_unref);
+  gtk_string_key_cache_unref (self->cache);
+  g_free (self->search_prepared);
+  g_free (self);
+}
+
+static gboolean
+gtk_string_filter_keys_match (GtkFilterKeys *keys,
+                              gconstpointer  key_memory)
+{
+  GtkStringFilterKeys *self = (GtkStringFilterKeys *) keys;
+  const char *prepared = ((const GtkStringFilterKey *) key_memory)->prepared;
+
+  if (self->search_prepared == NULL)
+    return TRUE;
+
+  return gtk_string_filter_match_prepared (self->search_prepared,
+                                           self->match_mode,
+                                           prepared);
+}
+
+static void
+gtk_string_filter_keys_init_key (GtkFilterKeys *keys,
+                                 gpointer       item,
+                                 gpointer       key_memory)
+{
+  GtkStringFilterKeys *self = (GtkStringFilterKeys *) keys;
+  GtkStringFilterKey *key = key_memory;
+  GValue value = G_VALUE_INIT;
+
+  if (self->search_prepared == NULL ||
+      self->expression == NULL ||
+      !gtk_expression_evaluate (self->expression, item, &value))
+    {
+      key->prepared = NULL;
+      key->key = NULL;
+      return;
+    }
+
+  /* Normalizing is the expensive part of matching, so do it here
+   * where the cache remembers it for the next search */
+  key->prepared = gtk_string_key_cache_lookup (self->cache,
+                                               g_value_get_string (&value),
+                                               gtk_string_filter_get_key_kind (self->ignore_case),
+                                               &key->key);
+  g_value_unset (&value);
+}
+
+static void
+gtk_string_filter_keys_clear_key (GtkFilterKeys *keys,
+                                  gpointer       key_memory)
+{
+  GtkStringFilterKey *key = key_memory;
+
+  gtk_string_key_unref (key->key);
+}
+
+static const GtkFilterKeysClass GTK_STRING_FILTER_KEYS_CLASS =
+{
+  gtk_string_filter_keys_free,
+  gtk_string_filter_keys_match,
+  gtk_string_filter_keys_init_key,
+  gtk_string_filter_keys_clear_key,
+};
+
+static GtkFilterKeys *
+gtk_string_filter_keys_new (GtkStringFilter *self)
+{
+  GtkStringFilterKeys *result;
+
+  result = gtk_filter_keys_new (GtkStringFilterKeys,
+                                &GTK_STRING_FILTER_KEYS_CLASS,
+                                sizeof (GtkStringFilterKey),
+                                G_ALIGNOF (GtkStringFilterKey));
+
+  result->cache = gtk_string_key_cache_get ();
+  if (self->expression)
+    result->expression = gtk_expression_ref (self->expression);
+  result->search_prepared = g_strdup (self->search_prepared);
+  result->ignore_case = self->ignore_case;
+  result->match_mode = self->match_mode;
+
+  return (GtkFilterKeys *) result;
+}
+
 static GtkFilterMatch
 gtk_string_filter_get_strictness (GtkFilter *filter)
 {
@@ -229,6 +371,7 @@ gtk_string_filter_dispose (GObject *object)
   g_clear_pointer (&self->search, g_free);
   g_clear_pointer (&self->search_prepared, g_free);
   g_clear_pointer (&self->expression, gtk_expression_unref);
+  g_clear_pointer (&self->cache, gtk_string_key_cache_unref);
 
   G_OBJECT_CLASS (gtk_string_filter_parent_class)->dispose (object);
 }
@@ -295,6 +438,10 @@ gtk_string_filter_init (GtkStringFilter *self)
 {
   self->ignore_case = TRUE;
   self->match_mode = GTK_STRING_FILTER_MATCH_MODE_SUBSTRING;
+
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                GTK_FILTER_CHANGE_DIFFERENT,
+                                gtk_string_filter_keys_new (self));
 }
 
 /**
@@ -372,9 +519,11 @@ gtk_string_filter_set_search (GtkStringFilter *self,
   g_free (self->search_prepared);
 
   self->search = g_strdup (search);
-  self->search_prepared = gtk_string_filter_prepare (self, search);
+  self->search_prepared = gtk_string_filter_prepare (self->ignore_case, search);
 
-  gtk_filter_changed (GTK_FILTER (self), change);
+  gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                change,
+                                gtk_string_filter_keys_new (self));
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SEARCH]);
 }
@@ -420,7 +569,9 @@ gtk_string_filter_set_expression (GtkStringFilter *self,
   self->expression = gtk_expression_ref (expression);
 
   if (gtk_string_filter_has_search (self))
-    gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_DIFFERENT);
+    gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                  GTK_FILTER_CHANGE_DIFFERENT,
+                                  gtk_string_filter_keys_new (self));
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_EXPRESSION]);
 }
@@ -462,8 +613,10 @@ gtk_string_filter_set_ignore_case (GtkStringFilter *self,
   if (self->search)
     {
       g_free (self->search_prepared);
-      self->search_prepared = gtk_string_filter_prepare (self, self->search);
-      gtk_filter_changed (GTK_FILTER (self), ignore_case ? GTK_FILTER_CHANGE_LESS_STRICT : GTK_FILTER_CHANGE_MORE_STRICT);
+      self->search_prepared = gtk_string_filter_prepare (self->ignore_case, self->search);
+      gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                    ignore_case ? GTK_FILTER_CHANGE_LESS_STRICT : GTK_FILTER_CHANGE_MORE_STRICT,
+                                    gtk_string_filter_keys_new (self));
     }
 
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_IGNORE_CASE]);
@@ -511,18 +664,26 @@ gtk_string_filter_set_match_mode (GtkStringFilter *self,
       switch (old_mode)
         {
         case GTK_STRING_FILTER_MATCH_MODE_EXACT:
-          gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_LESS_STRICT);
+          gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                        GTK_FILTER_CHANGE_LESS_STRICT,
+                                        gtk_string_filter_keys_new (self));
           break;
 
         case GTK_STRING_FILTER_MATCH_MODE_SUBSTRING:
-          gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_MORE_STRICT);
+          gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                        GTK_FILTER_CHANGE_MORE_STRICT,
+                                        gtk_string_filter_keys_new (self));
           break;
 
         case GTK_STRING_FILTER_MATCH_MODE_PREFIX:
           if (mode == GTK_STRING_FILTER_MATCH_MODE_SUBSTRING)
-            gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_LESS_STRICT);
+            gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                          GTK_FILTER_CHANGE_LESS_STRICT,
+                                          gtk_string_filter_keys_new (self));
           else
-            gtk_filter_changed (GTK_FILTER (self), GTK_FILTER_CHANGE_MORE_STRICT);
+            gtk_filter_changed_with_keys (GTK_FILTER (self),
+                                          GTK_FILTER_CHANGE_MORE_STRICT,
+                                          gtk_string_filter_keys_new (self));
           break;
 
         default:
@@ -0,0 +1,356 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtkstringkeycacheprivate.h"
+
+#include <string.h>
+
+/* The string key cache remembers the casefolded, normalized and
+ * collation keys that string sorters and filters compute for the
+ * strings they get from items.
+ *
+ * Entries are looked up by the string itself, not by the item it
+ * came from. So items that change produce a different string and
+ * items with the same string share their keys. As the same strings
+ * give the same keys, keys can be compared by pointer before
+ * comparing them with strcmp().
+ *
+ * Every entry is a GtkStringKey, which is referenced by the cache
+ * and by everyone using its keys, so keys stay valid after the cache
+ * dropped the entry and can be read from any thread. References must
+ * only be dropped on the main thread.
+ *
+ * The cache keeps its entries in least recently used order and drops
+ * the oldest ones once their keys take up more than the size limit.
+ * Sorters and filters hold the keys of the items of their model and
+ * release them when the model removes the items, which makes those
+ * entries the first to be dropped.
+ */
+
+#define MAX_CACHE_SIZE (16 * 1024 * 1024)
+
+struct _GtkStringKey
+{
+  grefcount ref_count;
+  GtkStringKeyCache *cache; /* NULL once the cache dropped the key */
+  GList link; /* in the cache's LRU list */
+  gsize size;
+
+  char *keys[GTK_STRING_KEY_N_KINDS]; /* keys[GTK_STRING_KEY_NONE] is the string */
+};
+
+struct _GtkStringKeyCache
+{
+  gatomicrefcount ref_count;
+
+  GHashTable *entries; /* string => GtkStringKey */
+  GQueue lru; /* most recently used first */
+  gsize size;
+  gsize max_size;
+};
+
+static GtkStringKeyCache *current_cache;
+
+/*<private>
+ * gtk_string_key_cache_new:
+ * @max_size: the number of bytes to keep keys for
+ *
+ * Creates a new cache. Use gtk_string_key_cache_get() to get the
+ * cache that is shared by all sorters and filters.
+ *
+ * Returns: (transfer full): a new cache
+ */
+GtkStringKeyCache *
+gtk_string_key_cache_new (gsize max_size)
+{
+  GtkStringKeyCache *self;
+
+  self = g_new0 (GtkStringKeyCache, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  self->entries = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&self->lru);
+  self->max_size = max_size;
+
+  return self;
+}
+
+/*<private>
+ * gtk_string_key_cache_get:
+ *
+ * Gets the cache that is shared by all sorters and filters.
+ *
+ * Returns: (transfer full): the cache
+ */
+GtkStringKeyCache *
+gtk_string_key_cache_get (void)
+{
+  if (current_cache)
+    return gtk_string_key_cache_ref (current_cache);
+
+  current_cache = gtk_string_key_cache_new (MAX_CACHE_SIZE);
+
+  return current_cache;
+}
+
+GtkStringKeyCache *
+gtk_string_key_cache_ref (GtkStringKeyCache *self)
+{
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+static void
+gtk_string_key_free (GtkStringKey *key)
+{
+  guint i;
+
+  for (i = 0; i < GTK_STRING_KEY_N_KINDS; i++)
+    g_free (key->keys[i]);
+
+  g_free (key);
+}
+
+/* Drops the cache's reference to @key */
+static void
+gtk_string_key_cache_remove (GtkStringKeyCache *self,
+                             GtkStringKey      *key)
+{
+  g_hash_table_remove (self->entries, key->keys[GTK_STRING_KEY_NONE]);
+  g_queue_unlink (&self->lru, &key->link);
+  self->size -= key->size;
+  key->cache = NULL;
+
+  gtk_string_key_unref (key);
+}
+
+void
+gtk_string_key_cache_unref (GtkStringKeyCache *self)
+{
+  if (!g_atomic_ref_count_dec (&self->ref_count))
+    return;
+
+  if (current_cache == self)
+    current_cache = NULL;
+
+  while (self->lru.head)
+    gtk_string_key_cache_remove (self, self->lru.head->data);
+
+  g_hash_table_unref (self->entries);
+  g_free (self);
+}
+
+/*<private>
+ * gtk_string_key_cache_get_size:
+ * @self: a `GtkStringKeyCache`
+ *
+ * Gets the number of bytes used by the keys in the cache.
+ *
+ * Returns: the size of the cache
+ */
+gsize
+gtk_string_key_cache_get_size (GtkStringKeyCache *self)
+{
+  return self->size;
+}
+
+/* Drops the least recently used keys, but never @keep */
+static void
+gtk_string_key_cache_trim (GtkStringKeyCache *self,
+                           GtkStringKey      *keep)
+{
+  while (self->size > self->max_size &&
+         self->lru.tail &&
+         self->lru.tail->data != keep)
+    gtk_string_key_cache_remove (self, self->lru.tail->data);
+}
+
+static void
+gtk_string_key_cache_add_key (GtkStringKeyCache *self,
+                              GtkStringKey      *key,
+                              GtkStringKeyKind   kind,
+                              char              *string)
+{
+  gsize size;
+
+  /* Invalid UTF-8 makes the conversion functions fail */
+  if (string == NULL)
+    string = g_strdup ("");
+
+  size = strlen (string) + 1;
+  key->keys[kind] = string;
+  key->size += size;
+  self->size += size;
+}
+
+static const char *
+gtk_string_key_cache_get_key (GtkStringKeyCache *self,
+                              GtkStringKey      *key,
+                              GtkStringKeyKind   kind)
+{
+  const char *s;
+  char *result;
+
+  if (key->keys[kind])
+    return key->keys[kind];
+
+  switch (kind)
+    {
+    case GTK_STRING_KEY_CASEFOLD:
+      result = g_utf8_casefold (key->keys[GTK_STRING_KEY_NONE], -1);
+      break;
+
+    case GTK_STRING_KEY_COLLATE:
+      result = g_utf8_collate_key (key->keys[GTK_STRING_KEY_NONE], -1);
+      break;
+
+    case GTK_STRING_KEY_COLLATE_CASEFOLD:
+      s = gtk_string_key_cache_get_key (self, key, GTK_STRING_KEY_CASEFOLD);
+      result = g_utf8_collate_key (s, -1);
+      break;
+
+    case GTK_STRING_KEY_FILENAME:
+      result = g_utf8_collate_key_for_filename (key->keys[GTK_STRING_KEY_NONE], -1);
+      break;
+
+    case GTK_STRING_KEY_FILENAME_CASEFOLD:
+      s = gtk_string_key_cache_get_key (self, key, GTK_STRING_KEY_CASEFOLD);
+      result = g_utf8_collate_key_for_filename (s, -1);
+      break;
+
+    case GTK_STRING_KEY_NORMALIZE:
+      result = g_utf8_normalize (key->keys[GTK_STRING_KEY_NONE], -1, G_NORMALIZE_ALL);
+      break;
+
+    case GTK_STRING_KEY_NORMALIZE_CASEFOLD:
+      s = gtk_string_key_cache_get_key (self, key, GTK_STRING_KEY_NORMALIZE);
+      result = g_utf8_casefold (s, -1);
+      break;
+
+    case GTK_STRING_KEY_NONE:
+    default:
+      g_assert_not_reached ();
+      return NULL;
+    }
+
+  gtk_string_key_cache_add_key (self, key, kind, result);
+
+  return key->keys[kind];
+}
+
+/*<private>
+ * gtk_string_key_cache_lookup:
+ * @self: a `GtkStringKeyCache`
+ * @string: (nullable): the string to get a key for
+ * @kind: the kind of key
+ * @out_key: (out) (transfer full) (nullable): return location for
+ *   the entry that owns the key
+ *
+ * Gets the key for @string, computing it if necessary.
+ *
+ * The key stays valid until the reference in @out_key is dropped
+ * with gtk_string_key_unref() or gtk_string_key_release().
+ *
+ * Returns: (nullable) (transfer none): the key
+ */
+const char *
+gtk_string_key_cache_lookup (GtkStringKeyCache  *self,
+                             const char         *string,
+                             GtkStringKeyKind    kind,
+                             GtkStringKey      **out_key)
+{
+  GtkStringKey *key;
+  const char *result;
+
+  if (string == NULL)
+    {
+      *out_key = NULL;
+      return NULL;
+    }
+
+  key = g_hash_table_lookup (self->entries, string);
+  if (key)
+    {
+      g_queue_unlink (&self->lru, &key->link);
+    }
+  else
+    {
+      key = g_new0 (GtkStringKey, 1);
+      g_ref_count_init (&key->ref_count);
+      key->cache = self;
+      key->link.data = key;
+      key->size = sizeof (GtkStringKey);
+      self->size += sizeof (GtkStringKey);
+      gtk_string_key_cache_add_key (self, key, GTK_STRING_KEY_NONE, g_strdup (string));
+      g_hash_table_insert (self->entries, key->keys[GTK_STRING_KEY_NONE], key);
+    }
+  g_queue_push_head_link (&self->lru, &key->link);
+
+  result = gtk_string_key_cache_get_key (self, key, kind);
+
+  gtk_string_key_cache_trim (self, key);
+
+  g_ref_count_inc (&key->ref_count);
+  *out_key = key;
+
+  return result;
+}
+
+/*<private>
+ * gtk_string_key_unref:
+ * @key: (nullable): a key returned by gtk_string_key_cache_lookup()
+ *
+ * Drops a reference to @key.
+ *
+ * This must be called on the main thread.
+ */
+void
+gtk_string_key_unref (GtkStringKey *key)
+{
+  if (key == NULL)
+    return;
+
+  if (g_ref_count_dec (&key->ref_count))
+    gtk_string_key_free (key);
+}
+
+/*<private>
+ * gtk_string_key_release:
+ * @key: (nullable): a key returned by gtk_string_key_cache_lookup()
+ *
+ * Drops a reference to @key that was held for an item that
+ * went away.
+ *
+ * If nobody else uses @key, it becomes the first key that the
+ * cache drops when it needs space.
+ *
+ * This must be called on the main thread.
+ */
+void
+gtk_string_key_release (GtkStringKey *key)
+{
+  if (key == NULL)
+    return;
+
+  if (key->cache && g_ref_count_compare (&key->ref_count, 2))
+    {
+      g_queue_unlink (&key->cache->lru, &key->link);
+      g_queue_push_tail_link (&key->cache->lru, &key->link);
+    }
+
+  gtk_string_key_unref (key);
+}
@@ -0,0 +1,53 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  GTK_STRING_KEY_NONE,
+  GTK_STRING_KEY_CASEFOLD,
+  GTK_STRING_KEY_COLLATE,
+  GTK_STRING_KEY_COLLATE_CASEFOLD,
+  GTK_STRING_KEY_FILENAME,
+  GTK_STRING_KEY_FILENAME_CASEFOLD,
+  GTK_STRING_KEY_NORMALIZE,
+  GTK_STRING_KEY_NORMALIZE_CASEFOLD,
+} GtkStringKeyKind;
+
+#define GTK_STRING_KEY_N_KINDS (GTK_STRING_KEY_NORMALIZE_CASEFOLD + 1)
+
+typedef struct _GtkStringKeyCache GtkStringKeyCache;
+typedef struct _GtkStringKey GtkStringKey;
+
+GtkStringKeyCache *     gtk_string_key_cache_new                (gsize                   max_size);
+GtkStringKeyCache *     gtk_string_key_cache_get                (void);
+GtkStringKeyCache *     gtk_string_key_cache_ref                (GtkStringKeyCache      *self);
+void                    gtk_string_key_cache_unref              (GtkStringKeyCache      *self);
+
+gsize                   gtk_string_key_cache_get_size           (GtkStringKeyCache      *self);
+
+const char *            gtk_string_key_cache_lookup             (GtkStringKeyCache      *self,
+                                                                 const char             *string,
+                                                                 GtkStringKeyKind        kind,
+                                                                 GtkStringKey          **out_key);
+
+void                    gtk_string_key_unref                    (GtkStringKey           *key);
+void                    gtk_string_key_release                  (GtkStringKey           *key);
+
+G_END_DECLS
@@ -22,8 +22,11 @@
 #include "gtkstringsorter.h"
 
 #include "gtksorterprivate.h"
+#include "gtkstringkeycacheprivate.h"
 #include "gtktypebuiltins.h"
 
+#include <string.h>
+
 /**
  * GtkStringSorter:
  *
@@ -45,6 +48,8 @@ struct _GtkStringSorter
   GtkCollation collation;
 
   GtkExpression *expression;
+
+  GtkStringKeyCache *cache;
 };
 
 enum {
@@ -59,84 +64,89 @@ G_DEFINE_TYPE (GtkStringSorter, gtk_string_sorter, GTK_TYPE_SORTER)
 
 static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
 
-static char *
-gtk_string_sorter_get_key (GtkExpression *expression,
-                           gboolean       ignore_case,
-                           GtkCollation   collation,
-                           gpointer       item1)
+static GtkStringKeyKind
+gtk_string_sorter_get_key_kind (gboolean     ignore_case,
+                                GtkCollation collation)
 {
-  GValue value = G_VALUE_INIT;
-  const char *string;
-  char *s;
-  char *key;
-
-  if (expression == NULL)
-    return NULL;
-
-  if (!gtk_expression_evaluate (expression, item1, &value))
-    return NULL;
-
-  string = g_value_get_string (&value);
-  if (string == NULL)
-    {
-      g_value_unset (&value);
-      return NULL;
-    }
-
-  if (ignore_case)
-    s = g_utf8_casefold (string, -1);
-  else
-    s = (char *) string;
-
   switch (collation)
     {
     case GTK_COLLATION_NONE:
-      if (ignore_case)
-        key = g_steal_pointer (&s);
-      else
-        key = g_strdup (s);
-      break;
+      return ignore_case ? GTK_STRING_KEY_CASEFOLD : GTK_STRING_KEY_NONE;
 
     case GTK_COLLATION_UNICODE:
-      key = g_utf8_collate_key (s, -1);
-      break;
+      return ignore_case ? GTK_STRING_KEY_COLLATE_CASEFOLD : GTK_STRING_KEY_COLLATE;
 
     case GTK_COLLATION_FILENAME:
-      key = g_utf8_collate_key_for_filename (s, -1);
-      break;
+      return ignore_case ? GTK_STRING_KEY_FILENAME_CASEFOLD : GTK_STRING_KEY_FILENAME;
 
     default:
       g_assert_not_reached ();
-      break;
+      return GTK_STRING_KEY_NONE;
     }
+}
 
-  if (s != string)
-    g_free (s);
+/* The result is valid as long as out_key is referenced */
+static const char *
+gtk_string_sorter_get_key (GtkStringKeyCache  *cache,
+                           GtkExpression      *expression,
+                           GtkStringKeyKind    kind,
+                           gpointer            item1,
+                           GtkStringKey      **out_key)
+{
+  GValue value = G_VALUE_INIT;
+  const char *key;
+
+  *out_key = NULL;
+
+  if (expression == NULL)
+    return NULL;
+
+  if (!gtk_expression_evaluate (expression, item1, &value))
+    return NULL;
+
+  key = gtk_string_key_cache_lookup (cache, g_value_get_string (&value), kind, out_key);
 
   g_value_unset (&value);
 
   return key;
 }
 
+static int
+gtk_string_sorter_compare_keys (const char *s1,
+                                const char *s2)
+{
+  /* The cache hands out the same key for the same string */
+  if (s1 == s2)
+    return 0;
+
+  return g_strcmp0 (s1, s2);
+}
+
 static GtkOrdering
 gtk_string_sorter_compare (GtkSorter *sorter,
                            gpointer   item1,
                            gpointer   item2)
 {
   GtkStringSorter *self = GTK_STRING_SORTER (sorter);
-  char *s1, *s2;
+  GtkStringKeyKind kind;
+  GtkStringKey *key1, *key2;
+  const char *s1, *s2;
   GtkOrdering result;
 
   if (self->expression == NULL)
     return GTK_ORDERING_EQUAL;
 
-  s1 = gtk_string_sorter_get_key (self->expression, self->ignore_case, self->collation, item1);
-  s2 = gtk_string_sorter_get_key (self->expression, self->ignore_case, self->collation, item2);
+  if (self->cache == NULL)
+    self->cache = gtk_string_key_cache_get ();
+
+  kind = gtk_string_sorter_get_key_kind (self->ignore_case, self->collation);
+  s1 = gtk_string_sorter_get_key (self->cache, self->expression, kind, item1, &key1);
+  s2 = gtk_string_sorter_get_key (self->cache, self->expression, kind, item2, &key2);
 
-  result = gtk_ordering_from_cmpfunc (g_strcmp0 (s1, s2));
+  result = gtk_ordering_from_cmpfunc (gtk_string_sorter_compare_keys (s1, s2));
 
-  g_free (s1);
-  g_free (s2);
+  gtk_string_key_unref (key1);
+  gtk_string_key_unref (key2);
 
   return result;
 }
@@ -152,11 +162,20 @@ gtk_string_sorter_get_order (GtkSorter *sorter)
   return GTK_SORTER_ORDER_PARTIAL;
 }
 
+/* The contents of the key memory */
+typedef struct _GtkStringSorterKey GtkStringSorterKey;
+struct _GtkStringSorterKey
+{
+  const char *string;
+  GtkStringKey *key; /* keeps the string alive */
+};
+
 typedef struct _GtkStringSortKeys GtkStringSortKeys;
 struct _GtkStringSortKeys
 {
   GtkSortKeys keys;
 
+  GtkStringKeyCache *cache;
   GtkExpression *expression;
   gboolean ignore_case;
   GtkCollation collation;
@@ -168,6 +187,7 @@ gtk_string_sort_keys_free (GtkSortKeys *keys)
   GtkStringSortKeys *self = (GtkStringSortKeys *) keys;
 
   gtk_expression_unref (self->expression);
+  gtk_string_key_cache_unref (self->cache);
   g_free (self);
 }
 
@@ -176,11 +196,13 @@ gtk_string_sort_keys_compare (gconstpointer a,
                               gconstpointer b,
                               gpointer      unused)
 {
-  const char *sa = *(const char **) a;
-  const char *sb = *(const char **) b;
+  const char *sa = ((const GtkStringSorterKey *) a)->string;
+  const char *sb = ((const GtkStringSorterKey *) b)->string;
 
-  if (sa == NULL)
-    return sb == NULL ? GTK_ORDERING_EQUAL : GTK_ORDERING_LARGER;
+  if (sa == sb)
+    return GTK_ORDERING_EQUAL;
+  else if (sa == NULL)
+    return GTK_ORDERING_LARGER;
   else if (sb == NULL)
     return GTK_ORDERING_SMALLER;
 
@@ -191,7 +213,13 @@ static gboolean
 gtk_string_sort_keys_is_compatible (GtkSortKeys *keys,
                                     GtkSortKeys *other)
 {
-  return FALSE;
+  GtkStringSortKeys *self = (GtkStringSortKeys *) keys;
+  GtkStringSortKeys *compare = (GtkStringSortKeys *) other;
+
+  return keys->klass == other->klass &&
+         self->expression == compare->expression &&
+         self->ignore_case == compare->ignore_case &&
+         self->collation == compare->collation;
 }
 
 static void
@@ -200,18 +228,23 @@ gtk_string_sort_keys_init_key (GtkSortKeys *keys,
                                gpointer     key_memory)
 {
   GtkStringSortKeys *self = (GtkStringSortKeys *) keys;
-  char **key = (char **) key_memory;
+  GtkStringSorterKey *key = key_memory;
 
-  *key = gtk_string_sorter_get_key (self->expression, self->ignore_case, self->collation, item);
+  key->string = gtk_string_sorter_get_key (self->cache,
+                                           self->expression,
+                                           gtk_string_sorter_get_key_kind (self->ignore_case, self->collation),
+                                           item,
+                                           &key->key);
 }
 
 static void
 gtk_string_sort_keys_clear_key (GtkSortKeys *keys,
                                 gpointer     key_memory)
 {
-  char **key = (char **) key_memory;
+  GtkStringSorterKey *key = key_memory;
 
-  g_free (*key);
+  /* The item is gone, so the cache can drop its string first */
+  gtk_string_key_release (key->key);
 }
 
 static const GtkSortKeysClass GTK_STRING_SORT_KEYS_CLASS =
@@ -220,7 +253,7 @@ static const GtkSortKeysClass GTK_STRING_SORT_KEYS_CLASS =
   gtk_string_sort_keys_compare,
   gtk_string_sort_keys_is_compatible,
   gtk_string_sort_keys_init_key,
-  gtk_string_sort_keys_clear_key,
+  gtk_string_sort_keys_clear_key
 };
 
 static GtkSortKeys *
@@ -233,12 +266,15 @@ gtk_string_sort_keys_new (GtkStringSorter *self)
 
   result = gtk_sort_keys_new (GtkStringSortKeys,
                               &GTK_STRING_SORT_KEYS_CLASS,
-                              sizeof (char *),
-                              G_ALIGNOF (char *));
+                              sizeof (GtkStringSorterKey),
+                              G_ALIGNOF (GtkStringSorterKey));
 
+  result->cache = gtk_string_key_cache_get ();
   result->expression = gtk_expression_ref (self->expression);
   result->ignore_case = self->ignore_case;
   result->collation = self->collation;
+  /* Comparing only reads the strings */
+  result->keys.thread_safe = TRUE;
 
   return (GtkSortKeys *) result;
 }
@@ -305,6 +341,7 @@ gtk_string_sorter_dispose (GObject *object)
   GtkStringSorter *self = GTK_STRING_SORTER (object);
 
   g_clear_pointer (&self->expression, gtk_expression_unref);
+  g_clear_pointer (&self->cache, gtk_string_key_cache_unref);
 
   G_OBJECT_CLASS (gtk_string_sorter_parent_class)->dispose (object);
 }
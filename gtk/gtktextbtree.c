@@ -5432,6 +5432,85 @@ _gtk_text_btree_validate_line (GtkTextBTree     *tree,
     }
 }
 
+/**
+ * _gtk_text_btree_update_line_size:
+ * @tree: a GtkTextBTree
+ * @line: a line whose line data has been changed
+ * @view_id: view ID of the line data
+ *
+ * Propagates a change to the size or validity stored in the line
+ * data of @line up through the entire tree. Unlike
+ * _gtk_text_btree_validate_line() this doesn't wrap the line, so it
+ * can be used when the size has been computed elsewhere.
+ *
+ * All lines that share a parent node with @line are accounted for,
+ * so when updating many adjacent lines it is enough to call this
+ * once per parent node.
+ **/
+void
+_gtk_text_btree_update_line_size (GtkTextBTree *tree,
+                                  GtkTextLine  *line,
+                                  gpointer      view_id)
+{
+  g_return_if_fail (tree != NULL);
+  g_return_if_fail (line != NULL);
+
+  gtk_text_btree_node_check_valid_upward (line->parent, view_id);
+}
+
+/**
+ * _gtk_text_btree_get_first_invalid_line:
+ * @tree: a GtkTextBTree
+ * @view_id: view ID for the view
+ *
+ * Finds the first line that has not been validated for the view.
+ *
+ * Returns: (nullable): the first invalid line, or %NULL if the tree
+ *   is valid
+ **/
+GtkTextLine *
+_gtk_text_btree_get_first_invalid_line (GtkTextBTree *tree,
+                                        gpointer      view_id)
+{
+  GtkTextBTreeNode *node;
+  GtkTextLine *line;
+  NodeData *nd;
+
+  g_return_val_if_fail (tree != NULL, NULL);
+
+  node = tree->root_node;
+  nd = node_data_find (node->node_data, view_id);
+  if (nd && nd->valid)
+    return NULL;
+
+  while (node->level > 0)
+    {
+      GtkTextBTreeNode *child;
+
+      for (child = node->children.node; child; child = child->next)
+        {
+          nd = node_data_find (child->node_data, view_id);
+          if (nd == NULL || !nd->valid)
+            break;
+        }
+
+      if (child == NULL)
+        return NULL;
+
+      node = child;
+    }
+
+  for (line = node->children.line; line; line = line->next)
+    {
+      GtkTextLineData *ld = _gtk_text_line_get_data (line, view_id);
+
+      if (ld == NULL || !ld->valid)
+        return line;
+    }
+
+  return NULL;
+}
+
 static void
 gtk_text_btree_node_remove_view (BTreeView *view, GtkTextBTreeNode *node, gpointer view_id)
 {
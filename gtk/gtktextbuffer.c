@@ -33,6 +33,7 @@
 #include "gtktextbufferprivate.h"
 #include "gtktextbtreeprivate.h"
 #include "gtktextiterprivate.h"
+#include "gtktextsearchindexprivate.h"
 #include "gtktexttagprivate.h"
 #include "gtktexttagtableprivate.h"
 #include "gtkpangoprivate.h"
@@ -68,6 +69,8 @@ struct _GtkTextBufferPrivate
 
   GtkTextHistory *history;
 
+  GtkTextSearchIndex *search_index;
+
   GArray *commit_funcs;
   guint last_commit_handler;
 
@@ -1150,6 +1153,8 @@ gtk_text_buffer_finalize (GObject *object)
 
   g_clear_object (&buffer->priv->history);
 
+  g_clear_pointer (&priv->search_index, gtk_text_search_index_free);
+
   if (priv->tag_table)
     {
       _gtk_text_tag_table_remove_buffer (priv->tag_table, buffer);
@@ -1257,9 +1262,13 @@ gtk_text_buffer_real_insert_text (GtkTextBuffer *buffer,
                                   const char    *text,
                                   int            len)
 {
+  int line;
+
   g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
   g_return_if_fail (iter != NULL);
 
+  line = gtk_text_iter_get_line (iter);
+
   gtk_text_history_text_inserted (buffer->priv->history,
                                   gtk_text_iter_get_offset (iter),
                                   text,
@@ -1289,6 +1298,11 @@ gtk_text_buffer_real_insert_text (GtkTextBuffer *buffer,
                                      position, n_chars);
     }
 
+  if (buffer->priv->search_index)
+    gtk_text_search_index_lines_changed (buffer->priv->search_index,
+                                         line, 1,
+                                         gtk_text_iter_get_line (iter) - line + 1);
+
   g_signal_emit (buffer, signals[CHANGED], 0);
   g_object_notify_by_pspec (G_OBJECT (buffer), text_buffer_props[PROP_CURSOR_POSITION]);
 }
@@ -2018,11 +2032,15 @@ gtk_text_buffer_real_delete_range (GtkTextBuffer *buffer,
                                    GtkTextIter   *end)
 {
   gboolean has_selection;
+  int first_line, last_line;
 
   g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
   g_return_if_fail (start != NULL);
   g_return_if_fail (end != NULL);
 
+  first_line = MIN (gtk_text_iter_get_line (start), gtk_text_iter_get_line (end));
+  last_line = MAX (gtk_text_iter_get_line (start), gtk_text_iter_get_line (end));
+
   if (gtk_text_history_get_enabled (buffer->priv->history))
     {
       GtkTextIter sel_begin, sel_end;
@@ -2076,6 +2094,10 @@ gtk_text_buffer_real_delete_range (GtkTextBuffer *buffer,
       buffer->priv->in_commit_notify = FALSE;
     }
 
+  if (buffer->priv->search_index)
+    gtk_text_search_index_lines_changed (buffer->priv->search_index,
+                                         first_line, last_line - first_line + 1, 1);
+
   /* may have deleted the selection... */
   update_selection_clipboards (buffer);
 
@@ -2370,8 +2392,13 @@ gtk_text_buffer_real_insert_paintable (GtkTextBuffer *buffer,
                                        GtkTextIter   *iter,
                                        GdkPaintable  *paintable)
 {
+  int line = gtk_text_iter_get_line (iter);
+
   _gtk_text_btree_insert_paintable (iter, paintable);
 
+  if (buffer->priv->search_index)
+    gtk_text_search_index_lines_changed (buffer->priv->search_index, line, 1, 1);
+
   g_signal_emit (buffer, signals[CHANGED], 0);
 }
 
@@ -2414,8 +2441,13 @@ gtk_text_buffer_real_insert_anchor (GtkTextBuffer      *buffer,
                                     GtkTextIter        *iter,
                                     GtkTextChildAnchor *anchor)
 {
+  int line = gtk_text_iter_get_line (iter);
+
   _gtk_text_btree_insert_child_anchor (iter, anchor);
 
+  if (buffer->priv->search_index)
+    gtk_text_search_index_lines_changed (buffer->priv->search_index, line, 1, 1);
+
   g_signal_emit (buffer, signals[CHANGED], 0);
 }
 
@@ -5976,3 +6008,82 @@ gtk_text_buffer_commit_notify (GtkTextBuffer            *buffer,
 
   buffer->priv->in_commit_notify = FALSE;
 }
+
+/**
+ * gtk_text_buffer_search_async:
+ * @buffer: a `GtkTextBuffer`
+ * @str: a search string
+ * @flags: flags affecting how the search is done
+ * @cancellable: (nullable): a `GCancellable`
+ * @callback: (scope async): a callback to call when the search is done
+ * @user_data: data to pass to @callback
+ *
+ * Searches the whole buffer for all non-overlapping matches of @str.
+ *
+ * Matches are found the same way as by [method@Gtk.TextIter.forward_search],
+ * but the search happens in a thread, so it does not block the application
+ * even for large buffers. The results describe the buffer at the time
+ * this function is called. Changes made to the buffer while the search
+ * is running are not taken into account.
+ *
+ * The buffer keeps an index of its contents after the first search,
+ * so repeated searches are much faster than the first one.
+ *
+ * %GTK_TEXT_SEARCH_VISIBLE_ONLY is not supported and makes the search
+ * fail with %G_IO_ERROR_NOT_SUPPORTED.
+ *
+ * Since: 4.18
+ */
+void
+gtk_text_buffer_search_async (GtkTextBuffer       *buffer,
+                              const char          *str,
+                              GtkTextSearchFlags   flags,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (str != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  if (buffer->priv->search_index == NULL)
+    buffer->priv->search_index = gtk_text_search_index_new (buffer);
+
+  gtk_text_search_index_search_async (buffer->priv->search_index,
+                                      str, flags,
+                                      cancellable,
+                                      callback, user_data);
+}
+
+/**
+ * gtk_text_buffer_search_finish:
+ * @buffer: a `GtkTextBuffer`
+ * @result: the `GAsyncResult`
+ * @offsets: (out) (array length=n_offsets) (transfer full) (optional): return
+ *   location for the character offsets of the matches
+ * @n_offsets: (out) (optional): return location for the length of @offsets
+ * @error: return location for an error
+ *
+ * Finishes a search started with [method@Gtk.TextBuffer.search_async].
+ *
+ * The offsets come in pairs of the start and end of each match,
+ * in the order the matches appear in the buffer. Use
+ * [method@Gtk.TextBuffer.get_iter_at_offset] to turn them into iters.
+ *
+ * Returns: %TRUE if the search succeeded
+ *
+ * Since: 4.18
+ */
+gboolean
+gtk_text_buffer_search_finish (GtkTextBuffer  *buffer,
+                               GAsyncResult   *result,
+                               int           **offsets,
+                               gsize          *n_offsets,
+                               GError        **error)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, buffer), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return gtk_text_search_index_search_finish (result, offsets, n_offsets, error);
+}
@@ -518,6 +518,20 @@ GDK_AVAILABLE_IN_4_16
 void            gtk_text_buffer_remove_commit_notify      (GtkTextBuffer             *buffer,
                                                            guint                      commit_notify_handler);
 
+GDK_AVAILABLE_IN_4_18
+void            gtk_text_buffer_search_async              (GtkTextBuffer             *buffer,
+                                                           const char                *str,
+                                                           GtkTextSearchFlags         flags,
+                                                           GCancellable              *cancellable,
+                                                           GAsyncReadyCallback        callback,
+                                                           gpointer                   user_data);
+GDK_AVAILABLE_IN_4_18
+gboolean        gtk_text_buffer_search_finish             (GtkTextBuffer             *buffer,
+                                                           GAsyncResult              *result,
+                                                           int                      **offsets,
+                                                           gsize                     *n_offsets,
+                                                           GError                   **error);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GtkTextBuffer, g_object_unref)
 
 G_END_DECLS
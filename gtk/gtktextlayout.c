@@ -99,6 +99,7 @@
 #define GTK_TEXT_LAYOUT_GET_PRIVATE(o)  ((GtkTextLayoutPrivate *) gtk_text_layout_get_instance_private ((o)))
 
 typedef struct _GtkTextLayoutPrivate GtkTextLayoutPrivate;
+typedef struct _MeasureJob MeasureJob;
 
 struct _GtkTextLayoutPrivate
 {
@@ -109,6 +110,12 @@ struct _GtkTextLayoutPrivate
 
   /* Cache for GtkTextLineDisplay to reduce overhead creating layouts */
   GtkTextLineDisplayCache *cache;
+
+  /* Background validation, see gtk_text_layout_set_validate_in_background() */
+  MeasureJob *measure_job;
+  guint measure_idle;
+  guint measure_generation;
+  guint validate_in_background : 1;
 };
 
 static void gtk_text_layout_invalidated     (GtkTextLayout     *layout);
@@ -125,6 +132,12 @@ static void gtk_text_layout_emit_changed           (GtkTextLayout     *layout,
 
 static void gtk_text_layout_invalidate_all (GtkTextLayout *layout);
 
+static void gtk_text_layout_cancel_measure     (GtkTextLayout     *layout);
+static void gtk_text_layout_start_measure_job  (GtkTextLayout     *layout);
+static void gtk_text_layout_estimate_lines     (GtkTextLayout     *layout,
+                                                GtkTextLine       *line,
+                                                GtkTextLine       *last_line);
+
 static PangoAttribute *gtk_text_attr_appearance_new (const GtkTextAppearance *appearance);
 
 static void gtk_text_layout_after_mark_set_handler     (GtkTextBuffer     *buffer,
@@ -193,6 +206,8 @@ gtk_text_layout_dispose (GObject *object)
   GtkTextLayout *layout = GTK_TEXT_LAYOUT (object);
   GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
 
+  gtk_text_layout_set_validate_in_background (layout, FALSE);
+
   g_clear_pointer (&priv->cache, gtk_text_line_display_cache_free);
 
   gtk_text_layout_set_buffer (layout, NULL);
@@ -299,12 +314,16 @@ void
 gtk_text_layout_set_buffer (GtkTextLayout *layout,
                             GtkTextBuffer *buffer)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
   g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
   g_return_if_fail (buffer == NULL || GTK_IS_TEXT_BUFFER (buffer));
 
   if (layout->buffer == buffer)
     return;
 
+  gtk_text_layout_cancel_measure (layout);
+
   if (layout->buffer)
     {
       _gtk_text_btree_remove_view (_gtk_text_buffer_get_btree (layout->buffer),
@@ -358,6 +377,9 @@ gtk_text_layout_set_buffer (GtkTextLayout *layout,
                         G_CALLBACK (gtk_text_layout_before_buffer_delete_range), layout);
 
       gtk_text_layout_update_cursor_line (layout);
+
+      if (priv->validate_in_background)
+        gtk_text_layout_estimate_lines (layout, NULL, NULL);
     }
 }
 
@@ -711,7 +733,10 @@ gtk_text_layout_invalidate_cursor_line (GtkTextLayout *layout,
       gtk_text_layout_invalidate_cache (layout, priv->cursor_line, cursors_only);
 
       if (!cursors_only)
-        _gtk_text_line_invalidate_wrap (priv->cursor_line, line_data);
+        {
+          gtk_text_layout_cancel_measure (layout);
+          _gtk_text_line_invalidate_wrap (priv->cursor_line, line_data);
+        }
 
       gtk_text_layout_invalidated (layout);
     }
@@ -736,11 +761,14 @@ gtk_text_layout_invalidate (GtkTextLayout     *layout,
 			    const GtkTextIter *start,
 			    const GtkTextIter *end)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
   GtkTextLine *line;
   GtkTextLine *last_line;
 
   g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
 
+  gtk_text_layout_cancel_measure (layout);
+
   /* Because we may be invalidating a mark, it's entirely possible
    * that gtk_text_iter_equal (start, end) in which case we
    * should still invalidate the line they are both on. i.e.
@@ -771,6 +799,12 @@ gtk_text_layout_invalidate (GtkTextLayout     *layout,
       line = _gtk_text_line_next_excluding_last (line);
     }
 
+  /* New lines have no line data yet */
+  if (priv->validate_in_background)
+    gtk_text_layout_estimate_lines (layout,
+                                    _gtk_text_iter_get_text_line (start),
+                                    last_line);
+
   gtk_text_layout_invalidated (layout);
 }
 
@@ -803,6 +837,7 @@ gtk_text_layout_free_line_data (GtkTextLayout   *layout,
                                 GtkTextLine     *line,
                                 GtkTextLineData *line_data)
 {
+  gtk_text_layout_cancel_measure (layout);
   gtk_text_layout_invalidate_cache (layout, line, FALSE);
 
   g_free (line_data);
@@ -979,16 +1014,27 @@ gtk_text_layout_validate_yrange (GtkTextLayout *layout,
  *
  * Validate regions of a `GtkTextLayout`. The ::changed signal will
  * be emitted for each region validated.
+ *
+ * If the layout validates in the background, this starts validation
+ * if necessary and returns right away.
  **/
 void
 gtk_text_layout_validate (GtkTextLayout *layout,
                           int            max_pixels)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
   GtkTextBTree *btree;
   int y, old_height, new_height;
 
   g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
 
+  if (priv->validate_in_background &&
+      gtk_text_layout_can_measure_in_thread (layout))
+    {
+      gtk_text_layout_start_measure_job (layout);
+      return;
+    }
+
   btree = _gtk_text_buffer_get_btree (layout->buffer);
   while (max_pixels > 0 &&
          _gtk_text_btree_validate (btree,
@@ -1002,6 +1048,18 @@ gtk_text_layout_validate (GtkTextLayout *layout,
     }
 }
 
+static void
+get_display_ink (GtkTextLineDisplay *display,
+                 int                *top_ink,
+                 int                *bottom_ink)
+{
+  PangoRectangle ink_rect, logical_rect;
+
+  pango_layout_get_pixel_extents (display->layout, &ink_rect, &logical_rect);
+  *top_ink = MAX (0, logical_rect.x - ink_rect.x);
+  *bottom_ink = MAX (0, logical_rect.x + logical_rect.width - ink_rect.x - ink_rect.width);
+}
+
 GtkTextLineData *
 gtk_text_layout_wrap (GtkTextLayout   *layout,
                       GtkTextLine     *line,
@@ -1009,7 +1067,6 @@ gtk_text_layout_wrap (GtkTextLayout   *layout,
                       GtkTextLineData *line_data)
 {
   GtkTextLineDisplay *display;
-  PangoRectangle ink_rect, logical_rect;
 
   g_return_val_if_fail (GTK_IS_TEXT_LAYOUT (layout), NULL);
   g_return_val_if_fail (line != NULL, NULL);
@@ -1024,9 +1081,7 @@ gtk_text_layout_wrap (GtkTextLayout   *layout,
   line_data->width = display->width;
   line_data->height = display->height;
   line_data->valid = TRUE;
-  pango_layout_get_pixel_extents (display->layout, &ink_rect, &logical_rect);
-  line_data->top_ink = MAX (0, logical_rect.x - ink_rect.x);
-  line_data->bottom_ink = MAX (0, logical_rect.x + logical_rect.width - ink_rect.x - ink_rect.width);
+  get_display_ink (display, &line_data->top_ink, &line_data->bottom_ink);
   gtk_text_line_display_unref (display);
 
   return line_data;
@@ -1122,6 +1177,8 @@ totally_invisible_line (GtkTextLayout *layout,
 
 static void
 set_para_values (GtkTextLayout      *layout,
+                 PangoContext       *ltr_context,
+                 PangoContext       *rtl_context,
                  PangoDirection      base_dir,
                  GtkTextAttributes  *style,
                  GtkTextLineDisplay *display)
@@ -1158,9 +1215,9 @@ set_para_values (GtkTextLayout      *layout,
     }
 
   if (display->direction == GTK_TEXT_DIR_RTL)
-    display->layout = pango_layout_new (layout->rtl_context);
+    display->layout = pango_layout_new (rtl_context);
   else
-    display->layout = pango_layout_new (layout->ltr_context);
+    display->layout = pango_layout_new (ltr_context);
 
   switch (style->justification)
     {
@@ -2203,10 +2260,53 @@ tags_array_toggle_tag (GPtrArray  *array,
   return array;
 }
 
-GtkTextLineDisplay *
-gtk_text_layout_create_display (GtkTextLayout *layout,
-                                GtkTextLine   *line,
-                                gboolean       size_only)
+static void
+gtk_text_line_display_update_size (GtkTextLineDisplay *display,
+                                   int                 h_padding)
+{
+  PangoRectangle extents;
+  int text_pixel_width;
+
+  pango_layout_get_extents (display->layout, NULL, &extents);
+
+  text_pixel_width = PIXEL_BOUND (extents.width);
+
+  display->width = text_pixel_width + display->left_margin + display->right_margin + h_padding;
+  display->height += PANGO_PIXELS (extents.height);
+
+  /* If we aren't wrapping, we need to do the alignment of each
+   * paragraph ourselves.
+   */
+  if (pango_layout_get_width (display->layout) < 0)
+    {
+      int excess = display->total_width - text_pixel_width;
+
+      switch (pango_layout_get_alignment (display->layout))
+        {
+        case PANGO_ALIGN_LEFT:
+        default:
+          break;
+        case PANGO_ALIGN_CENTER:
+          display->x_offset += excess / 2;
+          break;
+        case PANGO_ALIGN_RIGHT:
+          display->x_offset += excess;
+          break;
+        }
+    }
+}
+
+/* With @measure set to %FALSE, the PangoLayout of the display is
+ * set up but never used, so it can be measured in another thread
+ * when it has been created with contexts that are not shared.
+ */
+static GtkTextLineDisplay *
+gtk_text_layout_create_display_full (GtkTextLayout *layout,
+                                     GtkTextLine   *line,
+                                     gboolean       size_only,
+                                     PangoContext  *ltr_context,
+                                     PangoContext  *rtl_context,
+                                     gboolean       measure)
 {
   GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
   GtkTextLineDisplay *display;
@@ -2214,10 +2314,8 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
   GtkTextIter iter;
   GtkTextAttributes *style;
   char *text;
-  int text_pixel_width;
   PangoAttrList *attrs;
   int text_allocated, layout_byte_offset;
-  PangoRectangle extents;
   gboolean para_values_set = FALSE;
   GSList *cursor_byte_offsets = NULL;
   GSList *cursor_segs = NULL;
@@ -2226,8 +2324,6 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
   PangoDirection base_dir;
   GPtrArray *tags;
   gboolean initial_toggle_segments;
-  int h_margin;
-  int h_padding;
   PangoAttribute *last_font_attr = NULL;
   PangoAttribute *last_scale_attr = NULL;
   PangoAttribute *last_fallback_attr = NULL;
@@ -2248,7 +2344,7 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
    */
   if (totally_invisible_line (layout, line, &iter))
     {
-      display->layout = pango_layout_new (layout->ltr_context);
+      display->layout = pango_layout_new (ltr_context);
       return g_steal_pointer (&display);
     }
 
@@ -2295,7 +2391,7 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
            */
           if (!para_values_set)
             {
-              set_para_values (layout, base_dir, style, display);
+              set_para_values (layout, ltr_context, rtl_context, base_dir, style, display);
               para_values_set = TRUE;
             }
 
@@ -2460,7 +2556,7 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
   if (!para_values_set)
     {
       style = get_style (layout, tags);
-      set_para_values (layout, base_dir, style, display);
+      set_para_values (layout, ltr_context, rtl_context, base_dir, style, display);
       release_style (layout, style);
     }
 
@@ -2505,36 +2601,8 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
   g_slist_free (cursor_byte_offsets);
   g_slist_free (cursor_segs);
 
-  pango_layout_get_extents (display->layout, NULL, &extents);
-
-  text_pixel_width = PIXEL_BOUND (extents.width);
-
-  h_margin = display->left_margin + display->right_margin;
-  h_padding = layout->left_padding + layout->right_padding;
-
-  display->width = text_pixel_width + h_margin + h_padding;
-  display->height += PANGO_PIXELS (extents.height);
-
-  /* If we aren't wrapping, we need to do the alignment of each
-   * paragraph ourselves.
-   */
-  if (pango_layout_get_width (display->layout) < 0)
-    {
-      int excess = display->total_width - text_pixel_width;
-
-      switch (pango_layout_get_alignment (display->layout))
-        {
-        case PANGO_ALIGN_LEFT:
-        default:
-          break;
-        case PANGO_ALIGN_CENTER:
-          display->x_offset += excess / 2;
-          break;
-        case PANGO_ALIGN_RIGHT:
-          display->x_offset += excess;
-          break;
-        }
-    }
+  if (measure)
+    gtk_text_line_display_update_size (display, layout->left_padding + layout->right_padding);
 
   g_free (text);
   pango_attr_list_unref (attrs);
@@ -2549,6 +2617,17 @@ gtk_text_layout_create_display (GtkTextLayout *layout,
   return g_steal_pointer (&display);
 }
 
+GtkTextLineDisplay *
+gtk_text_layout_create_display (GtkTextLayout *layout,
+                                GtkTextLine   *line,
+                                gboolean       size_only)
+{
+  return gtk_text_layout_create_display_full (layout, line, size_only,
+                                              layout->ltr_context,
+                                              layout->rtl_context,
+                                              TRUE);
+}
+
 GtkTextLineDisplay *
 gtk_text_layout_get_line_display (GtkTextLayout *layout,
                                   GtkTextLine   *line,
@@ -2559,6 +2638,575 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   return gtk_text_line_display_cache_get (priv->cache, layout, line, size_only);
 }
 
+/*
+ * Background validation
+ *
+ * Creating the PangoLayouts for a paragraph needs the btree, so it
+ * has to happen on the main thread, but shaping the text is where
+ * the time goes and it only needs the PangoLayout. So for batches of
+ * invalid lines we set up the layouts on the main thread, using
+ * private copies of our contexts, measure them in a thread and then
+ * store the results in the line data.
+ *
+ * Font maps are not thread-safe, so the copies of the contexts use a
+ * font map that belongs to the job while it runs. Those are kept in
+ * a pool on the main thread, so their fonts are reused by later jobs.
+ * Only the default font map can be recreated like that, layouts with
+ * a custom font map are validated on the main thread.
+ *
+ * Any change that might invalidate the lines of a batch bumps
+ * measure_generation and the results of older batches are dropped.
+ *
+ * Lines that have not been measured yet get an estimated height, so
+ * the size of the layout is roughly right from the start.
+ */
+
+/* Limits for the lines of a batch */
+#define MEASURE_MAX_LINES 1024
+#define MEASURE_MAX_BYTES (256 * 1024)
+
+typedef struct
+{
+  GtkTextLine *line;
+  GtkTextLineDisplay *display;
+  int width;
+  int height;
+  int top_ink;
+  int bottom_ink;
+} MeasureLine;
+
+struct _MeasureJob
+{
+  GtkTextLayout *layout; /* weak */
+  guint generation;
+  GCancellable *cancellable;
+  PangoFontMap *font_map;
+  int h_padding;
+  GArray *lines;
+  guint n_measured;
+};
+
+static void
+measure_line_clear (gpointer data)
+{
+  MeasureLine *ml = data;
+
+  gtk_text_line_display_unref (ml->display);
+}
+
+/* Font maps that no job uses, only accessed on the main thread */
+static GPtrArray *measure_font_maps;
+static guint measure_font_maps_serial;
+
+static PangoFontMap *
+measure_font_map_get (void)
+{
+  guint serial;
+
+  /* Font configuration changes bump the serial of the default font
+   * map, older font maps would still use the old configuration */
+  serial = pango_font_map_get_serial (pango_cairo_font_map_get_default ());
+  if (measure_font_maps && serial != measure_font_maps_serial)
+    g_ptr_array_set_size (measure_font_maps, 0);
+  measure_font_maps_serial = serial;
+
+  if (measure_font_maps && measure_font_maps->len > 0)
+    return g_ptr_array_steal_index_fast (measure_font_maps, measure_font_maps->len - 1);
+
+  return pango_cairo_font_map_new ();
+}
+
+static void
+measure_font_map_put (PangoFontMap *font_map)
+{
+  if (measure_font_maps == NULL)
+    measure_font_maps = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_ptr_array_add (measure_font_maps, font_map);
+}
+
+/* Must only be called on the main thread once the job is done */
+static void
+measure_job_free (MeasureJob *job)
+{
+  g_clear_weak_pointer (&job->layout);
+  g_object_unref (job->cancellable);
+  g_array_unref (job->lines);
+  measure_font_map_put (job->font_map);
+  g_free (job);
+}
+
+static void
+measure_job_run (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+  MeasureJob *job = task_data;
+  guint i;
+
+  for (i = 0; i < job->lines->len; i++)
+    {
+      MeasureLine *ml = &g_array_index (job->lines, MeasureLine, i);
+
+      if (g_cancellable_is_cancelled (cancellable))
+        break;
+
+      gtk_text_line_display_update_size (ml->display, job->h_padding);
+      ml->width = ml->display->width;
+      ml->height = ml->display->height;
+      get_display_ink (ml->display, &ml->top_ink, &ml->bottom_ink);
+    }
+
+  job->n_measured = i;
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static PangoContext *
+copy_context (PangoContext *context,
+              PangoFontMap *font_map)
+{
+  PangoContext *copy;
+
+  copy = pango_font_map_create_context (font_map);
+  pango_context_set_font_description (copy, pango_context_get_font_description (context));
+  pango_context_set_language (copy, pango_context_get_language (context));
+  pango_context_set_base_dir (copy, pango_context_get_base_dir (context));
+  pango_context_set_base_gravity (copy, pango_context_get_base_gravity (context));
+  pango_context_set_gravity_hint (copy, pango_context_get_gravity_hint (context));
+  pango_context_set_matrix (copy, pango_context_get_matrix (context));
+  pango_context_set_round_glyph_positions (copy, pango_context_get_round_glyph_positions (context));
+  pango_cairo_context_set_font_options (copy, pango_cairo_context_get_font_options (context));
+  pango_cairo_context_set_resolution (copy, pango_cairo_context_get_resolution (context));
+
+  return copy;
+}
+
+static gboolean
+gtk_text_layout_can_measure_in_thread (GtkTextLayout *layout)
+{
+  PangoFontMap *default_font_map = pango_cairo_font_map_get_default ();
+
+  return layout->ltr_context != NULL &&
+         layout->rtl_context != NULL &&
+         pango_context_get_font_map (layout->ltr_context) == default_font_map &&
+         pango_context_get_font_map (layout->rtl_context) == default_font_map;
+}
+
+/* Lines that need anything but their size measured are
+ * validated on the main thread.
+ */
+static gboolean
+gtk_text_layout_can_measure_line (GtkTextLayout *layout,
+                                  GtkTextLine   *line)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+  GtkTextLineSegment *seg;
+  GtkTextIter iter;
+
+  if (line == priv->cursor_line)
+    return FALSE;
+
+  for (seg = line->segments; seg; seg = seg->next)
+    {
+      if (seg->type == &gtk_text_child_type)
+        return FALSE;
+
+      if ((seg->type == &gtk_text_right_mark_type ||
+           seg->type == &gtk_text_left_mark_type) &&
+          (seg->body.mark.visible ||
+           _gtk_text_btree_mark_is_insert (btree, seg->body.mark.obj)))
+        return FALSE;
+    }
+
+  /* Those are cheap anyway */
+  if (totally_invisible_line (layout, line, &iter))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+gtk_text_layout_validate_line_now (GtkTextLayout *layout,
+                                   GtkTextLine   *line)
+{
+  GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+  GtkTextLineData *line_data;
+  int old_height, new_height;
+
+  line_data = _gtk_text_line_get_data (line, layout);
+  old_height = line_data ? line_data->height : 0;
+
+  _gtk_text_btree_validate_line (btree, line, layout);
+
+  line_data = _gtk_text_line_get_data (line, layout);
+  new_height = line_data ? line_data->height : 0;
+
+  update_layout_size (layout);
+  gtk_text_layout_emit_changed (layout,
+                                _gtk_text_btree_find_line_top (btree, line, layout),
+                                old_height, new_height);
+}
+
+static void
+gtk_text_layout_commit_measure_job (GtkTextLayout *layout,
+                                    MeasureJob    *job)
+{
+  GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+  GtkTextLine *run_start = NULL;
+  GtkTextLine *prev = NULL;
+  int old_height = 0;
+  int new_height = 0;
+  guint i;
+
+  for (i = 0; i <= job->n_measured; i++)
+    {
+      MeasureLine *ml = i < job->n_measured ? &g_array_index (job->lines, MeasureLine, i) : NULL;
+      GtkTextLineData *line_data;
+
+      /* Emit ::changed for each run of adjacent lines */
+      if (prev &&
+          (ml == NULL || ml->line != _gtk_text_line_next_excluding_last (prev)))
+        {
+          _gtk_text_btree_update_line_size (btree, prev, layout);
+          update_layout_size (layout);
+          gtk_text_layout_emit_changed (layout,
+                                        _gtk_text_btree_find_line_top (btree, run_start, layout),
+                                        old_height, new_height);
+          run_start = NULL;
+          prev = NULL;
+          old_height = 0;
+          new_height = 0;
+        }
+
+      if (ml == NULL)
+        break;
+
+      if (prev && prev->parent != ml->line->parent)
+        _gtk_text_btree_update_line_size (btree, prev, layout);
+
+      line_data = _gtk_text_line_get_data (ml->line, layout);
+      if (line_data == NULL)
+        {
+          line_data = _gtk_text_line_data_new (layout, ml->line);
+          _gtk_text_line_add_data (ml->line, line_data);
+        }
+
+      old_height += line_data->height;
+
+      /* Lines may have been validated on the main thread meanwhile,
+       * with the same result.
+       */
+      if (!line_data->valid)
+        {
+          line_data->width = ml->width;
+          line_data->height = ml->height;
+          line_data->top_ink = ml->top_ink;
+          line_data->bottom_ink = ml->bottom_ink;
+          line_data->valid = TRUE;
+        }
+
+      new_height += line_data->height;
+
+      if (run_start == NULL)
+        run_start = ml->line;
+      prev = ml->line;
+    }
+}
+
+static gboolean
+measure_idle_cb (gpointer data)
+{
+  GtkTextLayout *layout = data;
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  priv->measure_idle = 0;
+
+  gtk_text_layout_start_measure_job (layout);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+measure_job_done (GObject      *source,
+                  GAsyncResult *result,
+                  gpointer      data)
+{
+  MeasureJob *job = data;
+  GtkTextLayout *layout = job->layout;
+  GtkTextLayoutPrivate *priv;
+
+  if (layout == NULL)
+    {
+      measure_job_free (job);
+      return;
+    }
+
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_assert (priv->measure_job == job);
+  priv->measure_job = NULL;
+
+  if (job->generation == priv->measure_generation)
+    gtk_text_layout_commit_measure_job (layout, job);
+
+  measure_job_free (job);
+
+  /* Leave room for redraws before preparing the next batch */
+  if (priv->measure_idle == 0)
+    {
+      priv->measure_idle = g_idle_add_full (GTK_TEXT_VIEW_PRIORITY_VALIDATE,
+                                            measure_idle_cb, layout, NULL);
+      gdk_source_set_static_name_by_id (priv->measure_idle, "[gtk] text layout measure");
+    }
+}
+
+static void
+gtk_text_layout_start_measure_job (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  PangoContext *ltr_context, *rtl_context;
+  GtkTextBTree *btree;
+  MeasureJob *job;
+  GtkTextLine *line;
+  GTask *task;
+  gsize n_bytes;
+
+  if (priv->measure_job != NULL ||
+      layout->buffer == NULL ||
+      !gtk_text_layout_can_measure_in_thread (layout))
+    return;
+
+  g_clear_handle_id (&priv->measure_idle, g_source_remove);
+
+  btree = _gtk_text_buffer_get_btree (layout->buffer);
+
+  job = g_new0 (MeasureJob, 1);
+  g_set_weak_pointer (&job->layout, layout);
+  job->generation = priv->measure_generation;
+  job->cancellable = g_cancellable_new ();
+  job->font_map = measure_font_map_get ();
+  job->h_padding = layout->left_padding + layout->right_padding;
+  job->lines = g_array_new (FALSE, FALSE, sizeof (MeasureLine));
+  g_array_set_clear_func (job->lines, measure_line_clear);
+
+  /* Validating lines below emits ::changed, don't start another job
+   * from a handler */
+  priv->measure_job = job;
+
+  ltr_context = copy_context (layout->ltr_context, job->font_map);
+  rtl_context = copy_context (layout->rtl_context, job->font_map);
+
+  /* Every round either queues or validates the first invalid line,
+   * so this terminates.
+   */
+  while (job->lines->len == 0 &&
+         (line = _gtk_text_btree_get_first_invalid_line (btree, layout)) != NULL)
+    {
+      guint n_scanned = 0;
+
+      n_bytes = 0;
+
+      while (line &&
+             job->lines->len < MEASURE_MAX_LINES &&
+             n_scanned < 4 * MEASURE_MAX_LINES &&
+             n_bytes < MEASURE_MAX_BYTES)
+        {
+          GtkTextLineData *line_data = _gtk_text_line_get_data (line, layout);
+
+          if (line_data == NULL || !line_data->valid)
+            {
+              if (gtk_text_layout_can_measure_line (layout, line))
+                {
+                  MeasureLine ml = { line, };
+
+                  ml.display = gtk_text_layout_create_display_full (layout, line, TRUE,
+                                                                    ltr_context, rtl_context,
+                                                                    FALSE);
+                  g_array_append_val (job->lines, ml);
+                  n_bytes += _gtk_text_line_byte_count (line);
+                }
+              else
+                {
+                  gtk_text_layout_validate_line_now (layout, line);
+                }
+            }
+
+          n_scanned++;
+          line = _gtk_text_line_next_excluding_last (line);
+        }
+    }
+
+  g_object_unref (ltr_context);
+  g_object_unref (rtl_context);
+
+  if (job->lines->len == 0)
+    {
+      priv->measure_job = NULL;
+      measure_job_free (job);
+      return;
+    }
+
+  task = g_task_new (NULL, job->cancellable, measure_job_done, job);
+  g_task_set_source_tag (task, gtk_text_layout_start_measure_job);
+  g_task_set_task_data (task, job, NULL);
+  g_task_run_in_thread (task, measure_job_run);
+  g_object_unref (task);
+}
+
+/* Invalidates the batch that is being measured */
+static void
+gtk_text_layout_cancel_measure (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  priv->measure_generation++;
+
+  if (priv->measure_job)
+    g_cancellable_cancel (priv->measure_job->cancellable);
+}
+
+static int
+gtk_text_layout_get_estimated_line_height (GtkTextLayout *layout)
+{
+  PangoFontMetrics *metrics;
+  int height;
+
+  if (layout->ltr_context == NULL || layout->default_style == NULL)
+    return 0;
+
+  metrics = pango_context_get_metrics (layout->ltr_context,
+                                       layout->default_style->font,
+                                       NULL);
+  height = PIXEL_BOUND (pango_font_metrics_get_height (metrics));
+  pango_font_metrics_unref (metrics);
+
+  return height +
+         layout->default_style->pixels_above_lines +
+         layout->default_style->pixels_below_lines;
+}
+
+/* Gives lines without line data an estimated height until they
+ * are validated. Passing %NULL for @line and @last_line estimates
+ * all lines.
+ */
+static void
+gtk_text_layout_estimate_lines (GtkTextLayout *layout,
+                                GtkTextLine   *line,
+                                GtkTextLine   *last_line)
+{
+  GtkTextBTree *btree;
+  GtkTextLine *prev = NULL;
+  int height;
+
+  if (layout->buffer == NULL)
+    return;
+
+  height = gtk_text_layout_get_estimated_line_height (layout);
+  if (height <= 0)
+    return;
+
+  btree = _gtk_text_buffer_get_btree (layout->buffer);
+  if (line == NULL)
+    line = _gtk_text_btree_get_line_no_last (btree, 0, NULL);
+
+  while (line)
+    {
+      if (_gtk_text_line_get_data (line, layout) == NULL)
+        {
+          GtkTextLineData *line_data;
+
+          line_data = _gtk_text_line_data_new (layout, line);
+          line_data->height = height;
+          _gtk_text_line_add_data (line, line_data);
+
+          if (prev && prev->parent != line->parent)
+            _gtk_text_btree_update_line_size (btree, prev, layout);
+          prev = line;
+        }
+
+      if (line == last_line)
+        break;
+
+      line = _gtk_text_line_next_excluding_last (line);
+    }
+
+  if (prev)
+    {
+      _gtk_text_btree_update_line_size (btree, prev, layout);
+      update_layout_size (layout);
+    }
+}
+
+/**
+ * gtk_text_layout_set_validate_in_background:
+ * @layout: a `GtkTextLayout`
+ * @validate_in_background: whether to validate in the background
+ *
+ * Sets whether gtk_text_layout_validate() measures lines in a thread.
+ *
+ * In that mode, lines that have not been validated yet contribute
+ * an estimated height to the size of the layout. The ::changed signal
+ * is emitted as batches of lines are validated, until the layout is
+ * valid.
+ *
+ * Layouts that use a custom font map are still validated on the
+ * main thread.
+ */
+void
+gtk_text_layout_set_validate_in_background (GtkTextLayout *layout,
+                                            gboolean       validate_in_background)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  validate_in_background = !!validate_in_background;
+  if (priv->validate_in_background == validate_in_background)
+    return;
+
+  priv->validate_in_background = validate_in_background;
+
+  if (validate_in_background)
+    {
+      gtk_text_layout_estimate_lines (layout, NULL, NULL);
+    }
+  else
+    {
+      g_clear_handle_id (&priv->measure_idle, g_source_remove);
+
+      if (priv->measure_job)
+        {
+          /* The batch is dropped when it comes back */
+          g_cancellable_cancel (priv->measure_job->cancellable);
+          g_clear_weak_pointer (&priv->measure_job->layout);
+          priv->measure_job = NULL;
+        }
+    }
+}
+
+/**
+ * gtk_text_layout_get_validate_in_background:
+ * @layout: a `GtkTextLayout`
+ *
+ * Returns whether gtk_text_layout_validate() measures lines in a
+ * thread, and the layout keeps validating on its own.
+ *
+ * Returns: %TRUE if lines are validated in the background
+ */
+gboolean
+gtk_text_layout_get_validate_in_background (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_return_val_if_fail (GTK_IS_TEXT_LAYOUT (layout), FALSE);
+
+  return priv->validate_in_background &&
+         gtk_text_layout_can_measure_in_thread (layout);
+}
+
 static void
 gtk_text_line_display_finalize (GtkTextLineDisplay *display)
 {
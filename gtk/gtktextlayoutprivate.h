@@ -290,6 +290,9 @@ void     gtk_text_layout_validate_yrange (GtkTextLayout *layout,
                                           int            y1_);
 void     gtk_text_layout_validate        (GtkTextLayout *layout,
                                           int            max_pixels);
+void     gtk_text_layout_set_validate_in_background (GtkTextLayout *layout,
+                                                     gboolean       validate_in_background);
+gboolean gtk_text_layout_get_validate_in_background (GtkTextLayout *layout);
 
 GtkTextLineData* gtk_text_layout_wrap  (GtkTextLayout   *layout,
                                         GtkTextLine     *line,
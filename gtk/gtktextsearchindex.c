@@ -0,0 +1,778 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtktextsearchindexprivate.h"
+
+#include <string.h>
+
+/* The index keeps a copy of the text of the buffer, split into
+ * immutable chunks of whole lines, so it can be searched in a thread
+ * while the buffer keeps changing.
+ *
+ * Edits only mark the chunks covering the changed lines as dirty.
+ * Dirty chunks are read back from the buffer when the next search
+ * starts, so a burst of edits costs one update.
+ *
+ * The first search that looks at a chunk also computes its casefolded
+ * text and a bloom filter of the trigrams in it. Searches for strings
+ * with at least one trigram skip all chunks whose filter doesn't have
+ * all of them, so short searches in large buffers only look at a
+ * few chunks.
+ *
+ * Matches can only span chunks if the search string contains a line
+ * separator. Those searches don't use the filters and look at the
+ * following chunks as well.
+ */
+
+#define CHUNK_SIZE 4096
+#define FILTER_BITS 4096
+
+/* U+FFFC, which stands for paintables and child anchors */
+#define OBJECT_CHAR "\xEF\xBF\xBC"
+#define OBJECT_CHAR_LEN 3
+
+typedef struct _ChunkIndex ChunkIndex;
+typedef struct _Chunk Chunk;
+typedef struct _Entry Entry;
+typedef struct _SearchJob SearchJob;
+
+struct _ChunkIndex
+{
+  guint32 filter[FILTER_BITS / 32];
+  gsize folded_len;
+  char folded[];
+};
+
+struct _Chunk
+{
+  char *text;
+  gsize len;
+  guint n_chars;
+  guint has_objects : 1;
+
+  ChunkIndex *index; /* (atomic) */
+};
+
+struct _Entry
+{
+  guint n_lines;
+  Chunk *chunk; /* NULL if the lines need to be read again */
+};
+
+struct _GtkTextSearchIndex
+{
+  GtkTextBuffer *buffer;
+  GArray *entries;
+};
+
+struct _SearchJob
+{
+  GPtrArray *chunks;
+  char *needle;
+  char *filter_needle;
+  gboolean case_insensitive;
+  gboolean text_only;
+  gboolean multiline;
+  GArray *offsets;
+};
+
+static void
+chunk_clear (gpointer data)
+{
+  Chunk *chunk = data;
+
+  g_free (chunk->text);
+  g_free (chunk->index);
+}
+
+static Chunk *
+chunk_new (const char *text,
+           gsize       len)
+{
+  Chunk *chunk;
+
+  chunk = g_atomic_rc_box_new0 (Chunk);
+  chunk->text = g_strndup (text, len);
+  chunk->len = len;
+  chunk->n_chars = g_utf8_strlen (text, len);
+  chunk->has_objects = g_strstr_len (text, len, OBJECT_CHAR) != NULL;
+
+  return chunk;
+}
+
+static Chunk *
+chunk_ref (Chunk *chunk)
+{
+  return g_atomic_rc_box_acquire (chunk);
+}
+
+static void
+chunk_unref (gpointer chunk)
+{
+  g_atomic_rc_box_release_full (chunk, chunk_clear);
+}
+
+static inline gboolean
+is_object_char (const char *p)
+{
+  return memcmp (p, OBJECT_CHAR, OBJECT_CHAR_LEN) == 0;
+}
+
+/* Folds a single character the way gtk_text_iter_forward_search()
+ * folds lines, minus the reordering of combining marks: casefolding
+ * followed by canonical decomposition, so compatibility characters
+ * like ligatures and fullwidth forms stay distinct.
+ */
+static void
+append_folded_char (GString    *out,
+                    const char *p,
+                    const char *next)
+{
+  char *folded, *normalized;
+
+  if ((guchar) *p < 0x80)
+    {
+      g_string_append_c (out, g_ascii_tolower (*p));
+      return;
+    }
+
+  folded = g_utf8_casefold (p, next - p);
+  normalized = g_utf8_normalize (folded, -1, G_NORMALIZE_NFD);
+  if (normalized)
+    g_string_append (out, normalized);
+  else
+    g_string_append_len (out, p, next - p);
+
+  g_free (normalized);
+  g_free (folded);
+}
+
+/* Converts @text to what is searched for the given flags */
+static char *
+prepare_text (const char *text,
+              gsize       len,
+              gboolean    case_insensitive,
+              gboolean    text_only)
+{
+  const char *p, *end;
+  GString *result;
+
+  result = g_string_sized_new (len);
+
+  end = text + len;
+  for (p = text; p < end; p = g_utf8_next_char (p))
+    {
+      if (text_only && is_object_char (p))
+        continue;
+
+      if (case_insensitive)
+        append_folded_char (result, p, g_utf8_next_char (p));
+      else
+        g_string_append_len (result, p, g_utf8_next_char (p) - p);
+    }
+
+  return g_string_free (result, FALSE);
+}
+
+static inline guint
+trigram_hash (const char *p)
+{
+  guint32 h;
+
+  h = (guchar) p[0] * 0x9E3779B1u ^ (guchar) p[1] * 0x85EBCA77u ^ (guchar) p[2] * 0xC2B2AE3Du;
+
+  return h >> (32 - 12);
+}
+
+G_STATIC_ASSERT (FILTER_BITS == 1 << 12);
+
+static ChunkIndex *
+chunk_get_index (Chunk *chunk)
+{
+  ChunkIndex *index;
+  char *folded;
+  gsize len, i;
+
+  index = g_atomic_pointer_get (&chunk->index);
+  if (index)
+    return index;
+
+  folded = prepare_text (chunk->text, chunk->len, TRUE, FALSE);
+  len = strlen (folded);
+
+  index = g_malloc0 (sizeof (ChunkIndex) + len + 1);
+  index->folded_len = len;
+  memcpy (index->folded, folded, len + 1);
+  g_free (folded);
+
+  /* Search strings are stripped of U+FFFC for the filter, so the
+   * filter must not have trigrams containing it */
+  if (chunk->has_objects)
+    folded = prepare_text (index->folded, len, FALSE, TRUE);
+  else
+    folded = index->folded;
+
+  len = strlen (folded);
+  for (i = 0; i + 3 <= len; i++)
+    {
+      guint h = trigram_hash (folded + i);
+      index->filter[h / 32] |= 1u << (h % 32);
+    }
+
+  if (folded != index->folded)
+    g_free (folded);
+
+  /* Another search may have been faster */
+  if (!g_atomic_pointer_compare_and_exchange (&chunk->index, NULL, index))
+    {
+      g_free (index);
+      index = g_atomic_pointer_get (&chunk->index);
+    }
+
+  return index;
+}
+
+/*<private>
+ * gtk_text_search_index_new:
+ * @buffer: the buffer to index
+ *
+ * Creates a search index for @buffer. The buffer must call
+ * gtk_text_search_index_lines_changed() for all changes.
+ *
+ * Returns: (transfer full): a new search index
+ */
+GtkTextSearchIndex *
+gtk_text_search_index_new (GtkTextBuffer *buffer)
+{
+  GtkTextSearchIndex *self;
+  Entry entry;
+
+  self = g_new0 (GtkTextSearchIndex, 1);
+  self->buffer = buffer;
+  self->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+
+  entry.n_lines = gtk_text_buffer_get_line_count (buffer);
+  entry.chunk = NULL;
+  g_array_append_val (self->entries, entry);
+
+  return self;
+}
+
+void
+gtk_text_search_index_free (GtkTextSearchIndex *self)
+{
+  guint i;
+
+  for (i = 0; i < self->entries->len; i++)
+    {
+      Entry *entry = &g_array_index (self->entries, Entry, i);
+
+      g_clear_pointer (&entry->chunk, chunk_unref);
+    }
+
+  g_array_unref (self->entries);
+  g_free (self);
+}
+
+/*<private>
+ * gtk_text_search_index_lines_changed:
+ * @self: a search index
+ * @first_line: the first line that changed
+ * @n_removed: the number of lines that have been replaced
+ * @n_added: the number of lines that replaced them
+ *
+ * Tells the index that lines of the buffer have changed.
+ */
+void
+gtk_text_search_index_lines_changed (GtkTextSearchIndex *self,
+                                     guint               first_line,
+                                     guint               n_removed,
+                                     guint               n_added)
+{
+  guint first, last, line, i, n_lines;
+  Entry entry;
+
+  g_assert (n_removed > 0);
+
+  /* Find the entries covering the removed lines */
+  line = 0;
+  for (first = 0; first < self->entries->len; first++)
+    {
+      Entry *e = &g_array_index (self->entries, Entry, first);
+
+      if (first_line < line + e->n_lines)
+        break;
+      line += e->n_lines;
+    }
+  g_assert (first < self->entries->len);
+
+  n_lines = 0;
+  for (last = first; last < self->entries->len; last++)
+    {
+      Entry *e = &g_array_index (self->entries, Entry, last);
+
+      n_lines += e->n_lines;
+      g_clear_pointer (&e->chunk, chunk_unref);
+
+      if (first_line + n_removed <= line + n_lines)
+        break;
+    }
+  g_assert (last < self->entries->len);
+
+  entry.n_lines = n_lines - n_removed + n_added;
+  entry.chunk = NULL;
+
+  /* Merge with dirty neighbours, to keep the number of entries down */
+  if (first > 0 && g_array_index (self->entries, Entry, first - 1).chunk == NULL)
+    {
+      first--;
+      entry.n_lines += g_array_index (self->entries, Entry, first).n_lines;
+    }
+  if (last + 1 < self->entries->len && g_array_index (self->entries, Entry, last + 1).chunk == NULL)
+    {
+      last++;
+      entry.n_lines += g_array_index (self->entries, Entry, last).n_lines;
+    }
+
+  for (i = first; i <= last; i++)
+    g_assert (g_array_index (self->entries, Entry, i).chunk == NULL);
+
+  g_array_remove_range (self->entries, first, last - first + 1);
+  g_array_insert_val (self->entries, first, entry);
+}
+
+/* Reads the lines of a dirty entry from the buffer and replaces
+ * it with entries for chunks of about CHUNK_SIZE bytes.
+ */
+static void
+gtk_text_search_index_update_entry (GtkTextSearchIndex *self,
+                                    guint               pos,
+                                    guint               first_line)
+{
+  GtkTextIter start, end;
+  GArray *entries;
+  guint n_lines, lines_done, lines_in_chunk;
+  gsize len, p, chunk_start;
+  char *text;
+
+  n_lines = g_array_index (self->entries, Entry, pos).n_lines;
+
+  gtk_text_buffer_get_iter_at_line (self->buffer, &start, first_line);
+  if (first_line + n_lines < (guint) gtk_text_buffer_get_line_count (self->buffer))
+    gtk_text_buffer_get_iter_at_line (self->buffer, &end, first_line + n_lines);
+  else
+    gtk_text_buffer_get_end_iter (self->buffer, &end);
+
+  text = gtk_text_iter_get_slice (&start, &end);
+  len = strlen (text);
+
+  entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+
+  /* Split the text where the btree splits lines */
+  p = 0;
+  chunk_start = 0;
+  lines_done = 0;
+  lines_in_chunk = 0;
+  while (p < len)
+    {
+      int delimiter, next;
+
+      pango_find_paragraph_boundary (text + p, len - p, &delimiter, &next);
+      p += next;
+      lines_in_chunk++;
+
+      if (p - chunk_start >= CHUNK_SIZE && lines_done + lines_in_chunk < n_lines)
+        {
+          Entry entry = { lines_in_chunk, chunk_new (text + chunk_start, p - chunk_start) };
+
+          g_array_append_val (entries, entry);
+          lines_done += lines_in_chunk;
+          lines_in_chunk = 0;
+          chunk_start = p;
+        }
+    }
+
+  /* The last line of the buffer may be empty */
+  if (lines_done < n_lines)
+    {
+      Entry entry = { n_lines - lines_done, chunk_new (text + chunk_start, len - chunk_start) };
+
+      g_array_append_val (entries, entry);
+    }
+
+  g_free (text);
+
+  g_array_remove_index (self->entries, pos);
+  g_array_insert_vals (self->entries, pos, entries->data, entries->len);
+  g_array_unref (entries);
+}
+
+static GPtrArray *
+gtk_text_search_index_snapshot (GtkTextSearchIndex *self)
+{
+  GPtrArray *chunks;
+  guint i, line;
+
+  line = 0;
+  for (i = 0; i < self->entries->len; i++)
+    {
+      Entry *entry = &g_array_index (self->entries, Entry, i);
+
+      /* This replaces the entry with clean ones, starting at @i */
+      if (entry->chunk == NULL)
+        gtk_text_search_index_update_entry (self, i, line);
+
+      line += g_array_index (self->entries, Entry, i).n_lines;
+    }
+
+  g_assert (line == (guint) gtk_text_buffer_get_line_count (self->buffer));
+
+  chunks = g_ptr_array_new_full (self->entries->len, chunk_unref);
+  for (i = 0; i < self->entries->len; i++)
+    g_ptr_array_add (chunks, chunk_ref (g_array_index (self->entries, Entry, i).chunk));
+
+  return chunks;
+}
+
+static void
+search_job_free (gpointer data)
+{
+  SearchJob *job = data;
+
+  g_ptr_array_unref (job->chunks);
+  g_free (job->needle);
+  g_free (job->filter_needle);
+  g_clear_pointer (&job->offsets, g_array_unref);
+  g_free (job);
+}
+
+/* The text of a chunk as it is searched */
+static void
+append_haystack (SearchJob *job,
+                 Chunk     *chunk,
+                 GString   *haystack)
+{
+  const char *text;
+  gsize len;
+
+  if (job->case_insensitive)
+    {
+      ChunkIndex *index = chunk_get_index (chunk);
+
+      text = index->folded;
+      len = index->folded_len;
+    }
+  else
+    {
+      text = chunk->text;
+      len = chunk->len;
+    }
+
+  if (job->text_only && chunk->has_objects)
+    {
+      char *stripped = prepare_text (text, len, FALSE, TRUE);
+      g_string_append (haystack, stripped);
+      g_free (stripped);
+    }
+  else
+    {
+      g_string_append_len (haystack, text, len);
+    }
+}
+
+/* The number of bytes the character at @p has in the haystack */
+static gsize
+haystack_char_len (SearchJob  *job,
+                   const char *p,
+                   GString    *scratch)
+{
+  const char *next = g_utf8_next_char (p);
+
+  if (job->text_only && is_object_char (p))
+    return 0;
+
+  if (!job->case_insensitive)
+    return next - p;
+
+  g_string_truncate (scratch, 0);
+  append_folded_char (scratch, p, next);
+
+  return scratch->len;
+}
+
+/* Turns the byte positions of matches in the haystack made from the
+ * chunks starting at @first into character offsets in the buffer.
+ * @positions alternates between start and end of matches.
+ */
+static void
+map_positions (SearchJob *job,
+               guint      first,
+               guint      char_offset,
+               GArray    *positions,
+               GArray    *offsets)
+{
+  GString *scratch;
+  gsize h = 0;
+  guint i, k = 0;
+
+  scratch = g_string_new (NULL);
+
+  for (i = first; i < job->chunks->len && k < positions->len; i++)
+    {
+      Chunk *chunk = g_ptr_array_index (job->chunks, i);
+      const char *p, *end;
+
+      end = chunk->text + chunk->len;
+      for (p = chunk->text; p < end && k < positions->len; p = g_utf8_next_char (p))
+        {
+          gsize char_len = haystack_char_len (job, p, scratch);
+
+          while (k < positions->len)
+            {
+              gsize pos = g_array_index (positions, gsize, k);
+              int offset;
+
+              /* Starts are at the character that contains them,
+               * ends are after the last character */
+              if (k % 2 == 0 && pos < h + char_len)
+                offset = char_offset;
+              else if (k % 2 == 1 && pos <= h)
+                offset = char_offset;
+              else
+                break;
+
+              g_array_append_val (offsets, offset);
+              k++;
+            }
+
+          h += char_len;
+          char_offset++;
+        }
+    }
+
+  /* Matches that end at the end of the buffer */
+  for (; k < positions->len; k++)
+    {
+      int offset = char_offset;
+
+      g_assert (k % 2 == 1);
+      g_array_append_val (offsets, offset);
+    }
+
+  g_string_free (scratch, TRUE);
+}
+
+static void
+search_job_run (GTask        *task,
+                gpointer      source_object,
+                gpointer      task_data,
+                GCancellable *cancellable)
+{
+  SearchJob *job = task_data;
+  GArray *trigrams, *positions;
+  GString *haystack;
+  gsize needle_len;
+  guint char_offset, skip_until;
+  guint i;
+
+  job->offsets = g_array_new (FALSE, FALSE, sizeof (int));
+
+  needle_len = strlen (job->needle);
+  if (needle_len == 0)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  trigrams = g_array_new (FALSE, FALSE, sizeof (guint));
+  if (!job->multiline)
+    {
+      gsize filter_len = strlen (job->filter_needle);
+
+      for (i = 0; i + 3 <= filter_len; i++)
+        {
+          guint h = trigram_hash (job->filter_needle + i);
+          g_array_append_val (trigrams, h);
+        }
+    }
+
+  haystack = g_string_new (NULL);
+  positions = g_array_new (FALSE, FALSE, sizeof (gsize));
+  char_offset = 0;
+  skip_until = 0;
+
+  for (i = 0; i < job->chunks->len; i++)
+    {
+      Chunk *chunk = g_ptr_array_index (job->chunks, i);
+      const char *p, *match;
+      gsize first_len;
+      guint j, k;
+
+      if (g_task_return_error_if_cancelled (task))
+        goto out;
+
+      if (trigrams->len > 0)
+        {
+          ChunkIndex *index = chunk_get_index (chunk);
+
+          for (k = 0; k < trigrams->len; k++)
+            {
+              guint h = g_array_index (trigrams, guint, k);
+
+              if ((index->filter[h / 32] & (1u << (h % 32))) == 0)
+                break;
+            }
+
+          if (k < trigrams->len)
+            {
+              char_offset += chunk->n_chars;
+              continue;
+            }
+        }
+
+      g_string_truncate (haystack, 0);
+      append_haystack (job, chunk, haystack);
+      first_len = haystack->len;
+
+      /* Only needles with line separators can extend into the next chunks */
+      for (j = i + 1; job->multiline && j < job->chunks->len && haystack->len - first_len < needle_len - 1; j++)
+        append_haystack (job, g_ptr_array_index (job->chunks, j), haystack);
+
+      g_array_set_size (positions, 0);
+      p = haystack->str;
+      while ((match = strstr (p, job->needle)) != NULL &&
+             (gsize) (match - haystack->str) < first_len)
+        {
+          gsize start = match - haystack->str;
+          gsize end = start + needle_len;
+
+          g_array_append_val (positions, start);
+          g_array_append_val (positions, end);
+          p = match + needle_len;
+        }
+
+      if (positions->len > 0)
+        {
+          guint n = job->offsets->len;
+
+          map_positions (job, i, char_offset, positions, job->offsets);
+
+          /* Drop matches that overlap one from the previous chunk */
+          while (n < job->offsets->len &&
+                 g_array_index (job->offsets, int, n) < (int) skip_until)
+            g_array_remove_range (job->offsets, n, 2);
+
+          if (n < job->offsets->len)
+            skip_until = g_array_index (job->offsets, int, job->offsets->len - 1);
+        }
+
+      char_offset += chunk->n_chars;
+    }
+
+  g_task_return_boolean (task, TRUE);
+
+out:
+  g_array_unref (positions);
+  g_string_free (haystack, TRUE);
+  g_array_unref (trigrams);
+}
+
+static gboolean
+has_line_separator (const char *s)
+{
+  for (; *s; s = g_utf8_next_char (s))
+    {
+      if (*s == '\n' || *s == '\r' || g_utf8_get_char (s) == 0x2029)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*<private>
+ * gtk_text_search_index_search_async:
+ * @self: a search index
+ * @str: the string to search for
+ * @flags: flags for the search
+ * @cancellable: (nullable): a `GCancellable`
+ * @callback: called when the search is done
+ * @user_data: data for @callback
+ *
+ * Updates the index and then searches it in a thread for all
+ * non-overlapping matches of @str.
+ *
+ * %GTK_TEXT_SEARCH_VISIBLE_ONLY is not supported, because the
+ * visibility of text depends on tags.
+ */
+void
+gtk_text_search_index_search_async (GtkTextSearchIndex  *self,
+                                    const char          *str,
+                                    GtkTextSearchFlags   flags,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+  SearchJob *job;
+  GTask *task;
+
+  task = g_task_new (self->buffer, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtk_text_search_index_search_async);
+
+  if (flags & GTK_TEXT_SEARCH_VISIBLE_ONLY)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                               "Searching only visible text is not supported");
+      g_object_unref (task);
+      return;
+    }
+
+  job = g_new0 (SearchJob, 1);
+  job->case_insensitive = (flags & GTK_TEXT_SEARCH_CASE_INSENSITIVE) != 0;
+  job->text_only = (flags & GTK_TEXT_SEARCH_TEXT_ONLY) != 0;
+  job->needle = prepare_text (str, strlen (str), job->case_insensitive, job->text_only);
+  job->filter_needle = prepare_text (str, strlen (str), TRUE, TRUE);
+  job->multiline = has_line_separator (str);
+  job->chunks = gtk_text_search_index_snapshot (self);
+
+  g_task_set_task_data (task, job, search_job_free);
+  g_task_run_in_thread (task, search_job_run);
+  g_object_unref (task);
+}
+
+gboolean
+gtk_text_search_index_search_finish (GAsyncResult  *result,
+                                     int          **offsets,
+                                     gsize         *n_offsets,
+                                     GError       **error)
+{
+  SearchJob *job;
+
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gtk_text_search_index_search_async, FALSE);
+
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return FALSE;
+
+  job = g_task_get_task_data (G_TASK (result));
+
+  if (n_offsets)
+    *n_offsets = job->offsets->len;
+
+  if (offsets)
+    *offsets = (int *) g_array_free (g_steal_pointer (&job->offsets), FALSE);
+
+  return TRUE;
+}
@@ -0,0 +1,43 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "gtktextbuffer.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GtkTextSearchIndex GtkTextSearchIndex;
+
+GtkTextSearchIndex *    gtk_text_search_index_new               (GtkTextBuffer          *buffer);
+void                    gtk_text_search_index_free              (GtkTextSearchIndex     *self);
+
+void                    gtk_text_search_index_lines_changed     (GtkTextSearchIndex     *self,
+                                                                 guint                   first_line,
+                                                                 guint                   n_removed,
+                                                                 guint                   n_added);
+
+void                    gtk_text_search_index_search_async      (GtkTextSearchIndex     *self,
+                                                                 const char             *str,
+                                                                 GtkTextSearchFlags      flags,
+                                                                 GCancellable           *cancellable,
+                                                                 GAsyncReadyCallback     callback,
+                                                                 gpointer                user_data);
+gboolean                gtk_text_search_index_search_finish     (GAsyncResult           *result,
+                                                                 int                   **offsets,
+                                                                 gsize                  *n_offsets,
+                                                                 GError                **error);
+
+G_END_DECLS
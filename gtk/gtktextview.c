@@ -5056,7 +5056,9 @@ incremental_validate_callback (gpointer data)
 
   gtk_text_view_update_adjustments (text_view);
 
-  if (gtk_text_layout_is_valid (text_view->priv->layout))
+  /* In the background, the layout keeps going on its own */
+  if (gtk_text_layout_is_valid (text_view->priv->layout) ||
+      gtk_text_layout_get_validate_in_background (text_view->priv->layout))
     {
       text_view->priv->incremental_validate_idle = 0;
       result = FALSE;
@@ -8245,6 +8247,11 @@ gtk_text_view_ensure_layout (GtkTextView *text_view)
 
       gtk_text_attributes_unref (style);
 
+      /* Keep large buffers from blocking the main thread. The lines
+       * that are onscreen are still validated right away.
+       */
+      gtk_text_layout_set_validate_in_background (priv->layout, TRUE);
+
       /* Set layout for all anchored children */
 
       iter = priv->anchored_children.head;
@@ -77,6 +77,7 @@
 #include "gdk/gdkmonitorprivate.h"
 #include "gsk/gskdebugprivate.h"
 #include "gsk/gskrendererprivate.h"
+#include "gsk/gskrendernodeprivate.h"
 
 #include <cairo-gobject.h>
 #include <locale.h>
@@ -534,6 +535,7 @@ enum {
   PROP_TOOLTIP_TEXT,
   PROP_OPACITY,
   PROP_OVERFLOW,
+  PROP_CACHE_RENDERING,
   PROP_HALIGN,
   PROP_VALIGN,
   PROP_MARGIN_START,
@@ -1023,6 +1025,9 @@ gtk_widget_set_property (GObject      *object,
     case PROP_OVERFLOW:
       gtk_widget_set_overflow (widget, g_value_get_enum (value));
       break;
+    case PROP_CACHE_RENDERING:
+      gtk_widget_set_cache_rendering (widget, g_value_get_boolean (value));
+      break;
     case PROP_CSS_NAME:
       if (g_value_get_string (value) != NULL)
         gtk_css_node_set_name (priv->cssnode, g_quark_from_string (g_value_get_string (value)));
@@ -1154,6 +1159,9 @@ gtk_widget_get_property (GObject    *object,
     case PROP_OVERFLOW:
       g_value_set_enum (value, gtk_widget_get_overflow (widget));
       break;
+    case PROP_CACHE_RENDERING:
+      g_value_set_boolean (value, gtk_widget_get_cache_rendering (widget));
+      break;
     case PROP_SCALE_FACTOR:
       g_value_set_int (value, gtk_widget_get_scale_factor (widget));
       break;
@@ -1595,6 +1603,21 @@ gtk_widget_class_init (GtkWidgetClass *klass)
                          GTK_OVERFLOW_VISIBLE,
                          GTK_PARAM_READWRITE|G_PARAM_EXPLICIT_NOTIFY);
 
+  /**
+   * GtkWidget:cache-rendering:
+   *
+   * Whether the renderer should keep the rendering of the widget
+   * around between frames.
+   *
+   * See [method@Gtk.Widget.set_cache_rendering].
+   *
+   * Since: 4.18
+   */
+  widget_props[PROP_CACHE_RENDERING] =
+      g_param_spec_boolean ("cache-rendering", NULL, NULL,
+                            FALSE,
+                            GTK_PARAM_READWRITE|G_PARAM_EXPLICIT_NOTIFY);
+
   /**
    * GtkWidget:scale-factor:
    *
@@ -10734,6 +10757,68 @@ gtk_widget_get_overflow (GtkWidget *widget)
   return priv->overflow;
 }
 
+/**
+ * gtk_widget_set_cache_rendering:
+ * @widget: a `GtkWidget`
+ * @cache_rendering: whether to cache the rendering of @widget
+ *
+ * Hints that the contents of @widget rarely change while things
+ * around it, like overlays drawn on top of it, do.
+ *
+ * Renderers may then keep the rendering of @widget around and reuse
+ * it as long as the widget does not need to be redrawn, instead of
+ * drawing it again every frame. This is similar to the `will-change`
+ * property in CSS.
+ *
+ * This costs memory for every widget using it, and any redraw of the
+ * widget or one of its children throws away the cached rendering. So
+ * it should only be used for widgets with contents that are expensive
+ * to draw, like maps or complex documents.
+ *
+ * Since: 4.18
+ */
+void
+gtk_widget_set_cache_rendering (GtkWidget *widget,
+                                gboolean   cache_rendering)
+{
+  GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
+
+  g_return_if_fail (GTK_IS_WIDGET (widget));
+
+  cache_rendering = !!cache_rendering;
+
+  if (priv->cache_rendering == cache_rendering)
+    return;
+
+  priv->cache_rendering = cache_rendering;
+
+  gtk_widget_queue_draw (widget);
+
+  g_object_notify_by_pspec (G_OBJECT (widget), widget_props[PROP_CACHE_RENDERING]);
+}
+
+/**
+ * gtk_widget_get_cache_rendering:
+ * @widget: a `GtkWidget`
+ *
+ * Returns whether the rendering of @widget may be cached.
+ *
+ * See [method@Gtk.Widget.set_cache_rendering].
+ *
+ * Returns: %TRUE if the rendering may be cached
+ *
+ * Since: 4.18
+ */
+gboolean
+gtk_widget_get_cache_rendering (GtkWidget *widget)
+{
+  GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
+
+  g_return_val_if_fail (GTK_IS_WIDGET (widget), FALSE);
+
+  return priv->cache_rendering;
+}
+
 void
 gtk_widget_set_has_focus (GtkWidget *widget,
                           gboolean   has_focus)
@@ -11876,6 +11961,7 @@ gtk_widget_create_render_node (GtkWidget   *widget,
   GtkCssValue *filter_value;
   double css_opacity, opacity;
   GtkCssStyle *style;
+  GskRenderNode *node;
 
   style = gtk_css_node_get_style (priv->cssnode);
 
@@ -11921,7 +12007,16 @@ gtk_widget_create_render_node (GtkWidget   *widget,
 
   gtk_snapshot_pop (snapshot);
 
-  return gtk_snapshot_pop_collect (snapshot);
+  node = gtk_snapshot_pop_collect (snapshot);
+
+  if (node && priv->cache_rendering)
+    {
+      GskRenderNode *cacheable = gsk_container_node_new_cacheable (node);
+      gsk_render_node_unref (node);
+      node = cacheable;
+    }
+
+  return node;
 }
 
 static void
@@ -529,6 +529,11 @@ void         gtk_widget_set_overflow      (GtkWidget           *widget,
                                            GtkOverflow          overflow);
 GDK_AVAILABLE_IN_ALL
 GtkOverflow  gtk_widget_get_overflow      (GtkWidget           *widget);
+GDK_AVAILABLE_IN_4_18
+void         gtk_widget_set_cache_rendering (GtkWidget         *widget,
+                                             gboolean           cache_rendering);
+GDK_AVAILABLE_IN_4_18
+gboolean     gtk_widget_get_cache_rendering (GtkWidget         *widget);
 
 GDK_AVAILABLE_IN_ALL
 GtkWidget*   gtk_widget_get_ancestor    (GtkWidget      *widget,
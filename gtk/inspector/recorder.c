@@ -43,6 +43,7 @@
 #include <gtk/gtkcolumnview.h>
 #include <gtk/gtkcolumnviewcolumn.h>
 #include <gsk/gskrendererprivate.h>
+#include <gsk/gskrendernodebinaryprivate.h>
 #include <gsk/gskrendernodeprivate.h>
 #include <gsk/gskroundedrectprivate.h>
 #include <gsk/gsktransformprivate.h>
@@ -65,6 +66,7 @@
 #include "recording.h"
 #include "renderrecording.h"
 #include "startrecording.h"
+#include "trace.h"
 #include "eventrecording.h"
 #include "recorderrow.h"
 
@@ -2019,7 +2021,15 @@ render_node_save_response (GObject *source,
   file = gtk_file_dialog_save_finish (dialog, result, &error);
   if (file)
     {
-      GBytes *bytes = gsk_render_node_serialize (node);
+      char *basename = g_file_get_basename (file);
+      GBytes *bytes;
+
+      /* Large recordings are a lot faster to save and load in binary */
+      if (g_str_has_suffix (basename, ".bnode"))
+        bytes = gsk_render_node_serialize_binary (node);
+      else
+        bytes = gsk_render_node_serialize (node);
+      g_free (basename);
 
       if (!g_file_replace_contents (file,
                                     g_bytes_get_data (bytes, NULL),
@@ -2056,6 +2066,8 @@ render_node_save (GtkButton            *button,
 {
   GskRenderNode *node;
   GtkFileDialog *dialog;
+  GtkFileFilter *filter;
+  GListStore *filters;
   char *filename, *nodename;
 
   node = get_selected_node (recorder);
@@ -2065,13 +2077,27 @@ render_node_save (GtkButton            *button,
   nodename = node_name (node);
   filename = g_strdup_printf ("%s.node", nodename);
 
+  filters = g_list_store_new (GTK_TYPE_FILE_FILTER);
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("Render nodes"));
+  gtk_file_filter_add_suffix (filter, "node");
+  g_list_store_append (filters, filter);
+  g_object_unref (filter);
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("Binary render nodes"));
+  gtk_file_filter_add_suffix (filter, "bnode");
+  g_list_store_append (filters, filter);
+  g_object_unref (filter);
+
   dialog = gtk_file_dialog_new ();
   gtk_file_dialog_set_initial_name (dialog, filename);
+  gtk_file_dialog_set_filters (dialog, G_LIST_MODEL (filters));
   gtk_file_dialog_save (dialog,
                         GTK_WINDOW (gtk_widget_get_root (GTK_WIDGET (recorder))),
                         NULL,
                         render_node_save_response, node);
   g_object_unref (dialog);
+  g_object_unref (filters);
   g_free (filename);
   g_free (nodename);
 }
@@ -2091,6 +2117,80 @@ render_node_clip (GtkButton            *button,
   gdk_clipboard_set (clipboard, GSK_TYPE_RENDER_NODE, node);
 }
 
+static void
+trace_open_response (GObject      *source,
+                     GAsyncResult *result,
+                     gpointer      data)
+{
+  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
+  GtkInspectorRecorder *recorder = data;
+  GPtrArray *recordings;
+  GtkInspectorRecording *start;
+  GFile *file;
+  GError *error = NULL;
+
+  file = gtk_file_dialog_open_finish (dialog, result, &error);
+  if (file == NULL)
+    {
+      g_error_free (error);
+      g_object_unref (recorder);
+      return;
+    }
+
+  recordings = gtk_inspector_trace_load (file, &error);
+  if (recordings == NULL)
+    {
+      GtkAlertDialog *alert;
+
+      alert = gtk_alert_dialog_new (_("Loading trace failed"));
+      gtk_alert_dialog_set_detail (alert, error->message);
+      gtk_alert_dialog_show (alert, GTK_WINDOW (gtk_widget_get_root (GTK_WIDGET (recorder))));
+      g_object_unref (alert);
+      g_error_free (error);
+    }
+  else
+    {
+      /* Show the trace like a recording that started with it */
+      start = gtk_inspector_start_recording_new ();
+      g_list_store_append (G_LIST_STORE (recorder->recordings), start);
+      g_object_unref (start);
+      g_list_store_splice (G_LIST_STORE (recorder->recordings),
+                           g_list_model_get_n_items (recorder->recordings),
+                           0,
+                           recordings->pdata,
+                           recordings->len);
+      g_ptr_array_unref (recordings);
+    }
+
+  g_object_unref (file);
+  g_object_unref (recorder);
+}
+
+static void
+trace_open (GtkButton            *button,
+            GtkInspectorRecorder *recorder)
+{
+  GtkFileDialog *dialog;
+  GtkFileFilter *filter;
+  GListStore *filters;
+
+  filters = g_list_store_new (GTK_TYPE_FILE_FILTER);
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("Traces"));
+  gtk_file_filter_add_suffix (filter, "trace");
+  g_list_store_append (filters, filter);
+  g_object_unref (filter);
+
+  dialog = gtk_file_dialog_new ();
+  gtk_file_dialog_set_filters (dialog, G_LIST_MODEL (filters));
+  gtk_file_dialog_open (dialog,
+                        GTK_WINDOW (gtk_widget_get_root (GTK_WIDGET (recorder))),
+                        NULL,
+                        trace_open_response, g_object_ref (recorder));
+  g_object_unref (dialog);
+  g_object_unref (filters);
+}
+
 static void
 toggle_dark_mode (GtkToggleButton *button,
                   GParamSpec      *pspec,
@@ -2382,6 +2482,7 @@ gtk_inspector_recorder_class_init (GtkInspectorRecorderClass *klass)
   gtk_widget_class_bind_template_callback (widget_class, recording_selected);
   gtk_widget_class_bind_template_callback (widget_class, render_node_save);
   gtk_widget_class_bind_template_callback (widget_class, render_node_clip);
+  gtk_widget_class_bind_template_callback (widget_class, trace_open);
   //gtk_widget_class_bind_template_callback (widget_class, node_property_activated);
   gtk_widget_class_bind_template_callback (widget_class, toggle_dark_mode);
 
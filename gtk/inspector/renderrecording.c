@@ -72,7 +72,8 @@ gtk_inspector_render_recording_new (gint64                timestamp,
                             "timestamp", timestamp,
                             NULL);
 
-  collect_profiler_info (recording, profiler);
+  if (profiler)
+    collect_profiler_info (recording, profiler);
   recording->area = *area;
   recording->clip_region = cairo_region_copy (clip_region);
   recording->node = gsk_render_node_ref (node);
@@ -22,6 +22,7 @@
 #include "graphdata.h"
 #include "graphrenderer.h"
 
+#include "gtkgrid.h"
 #include "gtklabel.h"
 #include "gtksearchbar.h"
 #include "gtkstack.h"
@@ -36,6 +37,10 @@
 #include "gtknumericsorter.h"
 #include "gtksortlistmodel.h"
 #include "gtksearchentry.h"
+#include "gtkwindow.h"
+#include "gtkprivate.h"
+
+#include "gdk/gdkframeclockprivate.h"
 
 #include <glib/gi18n-lib.h>
 
@@ -229,6 +234,17 @@ type_data_update (TypeData *data,
 
 /* }}} */
 
+static const struct {
+  GdkEventType event_type;
+  const char *name;
+} latency_types[] = {
+  { GDK_KEY_PRESS, N_("Key press") },
+  { GDK_BUTTON_PRESS, N_("Button press") },
+  { GDK_MOTION_NOTIFY, N_("Motion") },
+  { GDK_SCROLL, N_("Scroll") },
+  { GDK_TOUCH_UPDATE, N_("Touch") },
+};
+
 enum
 {
   PROP_0,
@@ -247,6 +263,10 @@ struct _GtkInspectorStatisticsPrivate
   guint update_source_id;
   GtkWidget *search_entry;
   GtkWidget *search_bar;
+  GtkWidget *latency_grid;
+  GtkWidget *latency_labels[G_N_ELEMENTS (latency_types)][4];
+  guint latency_source_id;
+  GdkDisplay *display;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtkInspectorStatistics, gtk_inspector_statistics, GTK_TYPE_BOX)
@@ -307,6 +327,81 @@ update_type_counts (gpointer data)
   return TRUE;
 }
 
+static void
+set_latency_label (GtkWidget *label,
+                   gint64     latency)
+{
+  char *text;
+
+  text = g_strdup_printf ("%.1f ms", latency / 1000.);
+  gtk_label_set_text (GTK_LABEL (label), text);
+  g_free (text);
+}
+
+/* Combines the latencies of all frame clocks of the inspected display */
+static gboolean
+update_input_latency (gpointer data)
+{
+  GtkInspectorStatistics *sl = data;
+  GdkInputLatency latency[G_N_ELEMENTS (latency_types)] = { { 0, }, };
+  GListModel *toplevels;
+  GHashTable *clocks;
+  guint i, j;
+
+  if (sl->priv->display == NULL)
+    return G_SOURCE_CONTINUE;
+
+  clocks = g_hash_table_new (NULL, NULL);
+  toplevels = gtk_window_get_toplevels ();
+  for (i = 0; i < g_list_model_get_n_items (toplevels); i++)
+    {
+      GtkWidget *window = g_list_model_get_item (toplevels, i);
+      GdkFrameClock *clock;
+
+      g_object_unref (window);
+
+      if (gtk_widget_get_display (window) != sl->priv->display)
+        continue;
+
+      clock = gtk_widget_get_frame_clock (window);
+      if (clock == NULL || !g_hash_table_add (clocks, clock))
+        continue;
+
+      for (j = 0; j < G_N_ELEMENTS (latency_types); j++)
+        {
+          const GdkInputLatency *clock_latency;
+
+          clock_latency = _gdk_frame_clock_get_input_latency (clock, latency_types[j].event_type);
+          if (clock_latency)
+            _gdk_input_latency_add (&latency[j], clock_latency);
+        }
+    }
+  g_hash_table_unref (clocks);
+
+  for (j = 0; j < G_N_ELEMENTS (latency_types); j++)
+    {
+      char *text;
+
+      text = g_strdup_printf ("%u", latency[j].n_events);
+      gtk_label_set_text (GTK_LABEL (sl->priv->latency_labels[j][0]), text);
+      g_free (text);
+
+      if (latency[j].n_events == 0)
+        {
+          gtk_label_set_text (GTK_LABEL (sl->priv->latency_labels[j][1]), "");
+          gtk_label_set_text (GTK_LABEL (sl->priv->latency_labels[j][2]), "");
+          gtk_label_set_text (GTK_LABEL (sl->priv->latency_labels[j][3]), "");
+          continue;
+        }
+
+      set_latency_label (sl->priv->latency_labels[j][1], _gdk_input_latency_get_percentile (&latency[j], 50));
+      set_latency_label (sl->priv->latency_labels[j][2], _gdk_input_latency_get_percentile (&latency[j], 95));
+      set_latency_label (sl->priv->latency_labels[j][3], latency[j].max);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
 static void
 toggle_record (GtkToggleButton        *button,
                GtkInspectorStatistics *sl)
@@ -403,6 +498,28 @@ unroot (GtkWidget *widget)
   GTK_WIDGET_CLASS (gtk_inspector_statistics_parent_class)->unroot (widget);
 }
 
+static void
+map (GtkWidget *widget)
+{
+  GtkInspectorStatistics *sl = GTK_INSPECTOR_STATISTICS (widget);
+
+  GTK_WIDGET_CLASS (gtk_inspector_statistics_parent_class)->map (widget);
+
+  sl->priv->latency_source_id = g_timeout_add_seconds (1, update_input_latency, sl);
+  gdk_source_set_static_name_by_id (sl->priv->latency_source_id, "[gtk] update_input_latency");
+  update_input_latency (sl);
+}
+
+static void
+unmap (GtkWidget *widget)
+{
+  GtkInspectorStatistics *sl = GTK_INSPECTOR_STATISTICS (widget);
+
+  g_clear_handle_id (&sl->priv->latency_source_id, g_source_remove);
+
+  GTK_WIDGET_CLASS (gtk_inspector_statistics_parent_class)->unmap (widget);
+}
+
 static void
 setup_label (GtkSignalListItemFactory *factory,
              GtkListItem              *list_item)
@@ -690,9 +807,27 @@ gtk_inspector_statistics_init (GtkInspectorStatistics *sl)
   GtkListItemFactory *factory;
   GtkSorter *sorter;
   GtkSortListModel *sort_model;
+  guint i, j;
 
   sl->priv = gtk_inspector_statistics_get_instance_private (sl);
   gtk_widget_init_template (GTK_WIDGET (sl));
+
+  for (i = 0; i < G_N_ELEMENTS (latency_types); i++)
+    {
+      GtkWidget *label;
+
+      label = gtk_label_new (_(latency_types[i].name));
+      gtk_label_set_xalign (GTK_LABEL (label), 0.);
+      gtk_grid_attach (GTK_GRID (sl->priv->latency_grid), label, 0, i + 1, 1, 1);
+
+      for (j = 0; j < 4; j++)
+        {
+          label = gtk_label_new (NULL);
+          gtk_label_set_xalign (GTK_LABEL (label), 1.);
+          gtk_grid_attach (GTK_GRID (sl->priv->latency_grid), label, j + 1, i + 1, 1, 1);
+          sl->priv->latency_labels[i][j] = label;
+        }
+    }
   sl->priv->types = g_hash_table_new (NULL, NULL);
 
   sl->priv->data = g_list_store_new (type_data_get_type ());
@@ -883,6 +1018,8 @@ gtk_inspector_statistics_class_init (GtkInspectorStatisticsClass *klass)
 
   widget_class->root = root;
   widget_class->unroot = unroot;
+  widget_class->map = map;
+  widget_class->unmap = unmap;
 
   g_object_class_install_property (object_class, PROP_BUTTON,
       g_param_spec_object ("button", NULL, NULL,
@@ -894,7 +1031,15 @@ gtk_inspector_statistics_class_init (GtkInspectorStatisticsClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, search_entry);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, search_bar);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, excuse);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorStatistics, latency_grid);
   gtk_widget_class_bind_template_callback (widget_class, search_changed);
 }
 
+void
+gtk_inspector_statistics_set_display (GtkInspectorStatistics *sl,
+                                      GdkDisplay             *display)
+{
+  sl->priv->display = display;
+}
+
 /* vim:set foldmethod=marker: */
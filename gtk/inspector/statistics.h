@@ -43,6 +43,8 @@ typedef struct _GtkInspectorStatisticsClass
 G_BEGIN_DECLS
 
 GType      gtk_inspector_statistics_get_type   (void);
+void       gtk_inspector_statistics_set_display (GtkInspectorStatistics *sl,
+                                                 GdkDisplay             *display);
 
 G_END_DECLS
 
@@ -5,4 +5,9 @@ N_("Self 2");
 N_("Cumulative 2");
 N_("Self");
 N_("Cumulative");
+N_("Input Latency");
+N_("Events");
+N_("Median");
+N_("95%");
+N_("Maximum");
 N_("Enable statistics with GOBJECT_DEBUG=instance-count");
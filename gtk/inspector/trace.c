@@ -0,0 +1,560 @@
+#include "config.h"
+
+#include "trace.h"
+
+#include "eventrecording.h"
+#include "renderrecording.h"
+
+#include "gdkeventsprivate.h"
+#include "gsk/gskrendernodebinaryprivate.h"
+
+#include <glib/gi18n-lib.h>
+#include <string.h>
+
+/* A trace is a stream of frames and events that is written to disk
+ * while the application is running, so recording doesn't keep
+ * everything in memory like the recorder does.
+ *
+ * The file starts with a header, followed by records. Every record
+ * starts with a RecordHeader and is padded to 16 bytes, so textures
+ * in the render nodes can be used in place when the file is mapped.
+ *
+ * Frames contain the node in the binary node format. The nodes of
+ * each surface are written as a sequence, so subtrees that didn't
+ * change since the previous frame are only referenced.
+ */
+
+#define MAGIC "GTKTRACE"
+#define VERSION 1
+#define ALIGNMENT 16
+
+typedef enum {
+  RECORD_FRAME = 1,
+  RECORD_EVENT,
+} RecordType;
+
+typedef enum {
+  EVENT_HAS_POSITION = 1 << 0,
+  EVENT_SCROLL_STOP = 1 << 1,
+} EventFlags;
+
+typedef struct _FileHeader FileHeader;
+typedef struct _RecordHeader RecordHeader;
+typedef struct _FrameRecord FrameRecord;
+typedef struct _EventRecord EventRecord;
+typedef struct _Trace Trace;
+typedef struct _TraceSurface TraceSurface;
+
+struct _FileHeader
+{
+  char magic[8];
+  guint32 version;
+  guint32 reserved;
+};
+
+struct _RecordHeader
+{
+  guint32 type;
+  guint32 reserved;
+  guint64 size;
+};
+
+struct _FrameRecord
+{
+  gint64 timestamp;
+  guint32 surface;
+  gint32 width;
+  gint32 height;
+  guint32 n_rects;
+  /* followed by n_rects cairo_rectangle_int_t, padding
+   * and the node */
+};
+
+struct _EventRecord
+{
+  gint64 timestamp;
+  guint64 sequence;
+  guint32 type;
+  guint32 time;
+  guint32 state;
+  guint32 flags;
+  /* the button, keyval or scroll direction */
+  guint32 detail;
+  /* the keycode or scroll unit */
+  guint32 detail2;
+  double x, y;
+  double dx, dy;
+};
+
+G_STATIC_ASSERT (sizeof (FileHeader) % ALIGNMENT == 0);
+G_STATIC_ASSERT (sizeof (RecordHeader) % ALIGNMENT == 0);
+
+struct _TraceSurface
+{
+  guint32 id;
+  GskRenderNodeBinaryWriter *writer;
+};
+
+struct _Trace
+{
+  GOutputStream *stream;
+  gint64 start_time;
+  GHashTable *surfaces;
+  guint32 n_surfaces;
+};
+
+static Trace *trace;
+
+static void
+trace_surface_free (gpointer data)
+{
+  TraceSurface *surface = data;
+
+  gsk_render_node_binary_writer_free (surface->writer);
+  g_free (surface);
+}
+
+static void
+trace_surface_destroyed (gpointer  data,
+                         GObject  *surface)
+{
+  if (trace)
+    g_hash_table_remove (trace->surfaces, surface);
+}
+
+static void
+trace_forget_surface (gpointer key,
+                      gpointer value,
+                      gpointer data)
+{
+  g_object_weak_unref (key, trace_surface_destroyed, NULL);
+}
+
+static void
+trace_write_record (RecordType  type,
+                    GBytes     *header,
+                    GBytes     *data)
+{
+  static const guchar zeros[ALIGNMENT] = { 0, };
+  RecordHeader record;
+  gsize size;
+  GError *error = NULL;
+
+  size = g_bytes_get_size (header) + (data ? g_bytes_get_size (data) : 0);
+  record.type = type;
+  record.reserved = 0;
+  record.size = size;
+
+  if (!g_output_stream_write_all (trace->stream, &record, sizeof (record), NULL, NULL, &error) ||
+      !g_output_stream_write_all (trace->stream,
+                                  g_bytes_get_data (header, NULL), g_bytes_get_size (header),
+                                  NULL, NULL, &error) ||
+      (data && !g_output_stream_write_all (trace->stream,
+                                           g_bytes_get_data (data, NULL), g_bytes_get_size (data),
+                                           NULL, NULL, &error)) ||
+      (size % ALIGNMENT && !g_output_stream_write_all (trace->stream,
+                                                       zeros, ALIGNMENT - size % ALIGNMENT,
+                                                       NULL, NULL, &error)))
+    {
+      g_warning ("Stopping trace: %s", error->message);
+      g_error_free (error);
+      gtk_inspector_trace_stop ();
+    }
+}
+
+/*<private>
+ * gtk_inspector_trace_start:
+ * @filename: the file to write the trace to
+ * @error: return location for an error
+ *
+ * Starts writing all frames and input events of the application
+ * to @filename, which can be loaded in the recorder of the inspector.
+ *
+ * Traces can also be started with the `GTK_INSPECTOR_TRACE`
+ * environment variable.
+ *
+ * Returns: %TRUE if the trace was started
+ */
+gboolean
+gtk_inspector_trace_start (const char  *filename,
+                           GError     **error)
+{
+  FileHeader header = { .magic = MAGIC, .version = VERSION };
+  GFileOutputStream *file_stream;
+  GFile *file;
+
+  gtk_inspector_trace_stop ();
+
+  file = g_file_new_for_path (filename);
+  file_stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+  g_object_unref (file);
+  if (file_stream == NULL)
+    return FALSE;
+
+  trace = g_new0 (Trace, 1);
+  trace->stream = g_buffered_output_stream_new_sized (G_OUTPUT_STREAM (file_stream), 1024 * 1024);
+  trace->start_time = g_get_monotonic_time ();
+  trace->surfaces = g_hash_table_new_full (NULL, NULL, NULL, trace_surface_free);
+  g_object_unref (file_stream);
+
+  if (!g_output_stream_write_all (trace->stream, &header, sizeof (header), NULL, NULL, error))
+    {
+      gtk_inspector_trace_stop ();
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+void
+gtk_inspector_trace_stop (void)
+{
+  if (trace == NULL)
+    return;
+
+  g_hash_table_foreach (trace->surfaces, trace_forget_surface, NULL);
+  g_hash_table_unref (trace->surfaces);
+  g_output_stream_close (trace->stream, NULL, NULL);
+  g_object_unref (trace->stream);
+  g_clear_pointer (&trace, g_free);
+}
+
+static void
+trace_stop_at_exit (void)
+{
+  gtk_inspector_trace_stop ();
+}
+
+gboolean
+gtk_inspector_trace_is_active (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      const char *filename = g_getenv ("GTK_INSPECTOR_TRACE");
+
+      if (filename && filename[0])
+        {
+          GError *error = NULL;
+
+          if (gtk_inspector_trace_start (filename, &error))
+            atexit (trace_stop_at_exit);
+          else
+            {
+              g_warning ("Failed to start trace: %s", error->message);
+              g_error_free (error);
+            }
+        }
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return trace != NULL;
+}
+
+void
+gtk_inspector_trace_record_render (GtkWidget            *widget,
+                                   GdkSurface           *surface,
+                                   const cairo_region_t *region,
+                                   GskRenderNode        *node)
+{
+  TraceSurface *trace_surface;
+  FrameRecord *record;
+  GByteArray *header;
+  GBytes *header_bytes, *data;
+  int i, n_rects;
+
+  if (!gtk_inspector_trace_is_active ())
+    return;
+
+  trace_surface = g_hash_table_lookup (trace->surfaces, surface);
+  if (trace_surface == NULL)
+    {
+      trace_surface = g_new (TraceSurface, 1);
+      trace_surface->id = trace->n_surfaces++;
+      trace_surface->writer = gsk_render_node_binary_writer_new ();
+      g_hash_table_insert (trace->surfaces, surface, trace_surface);
+      g_object_weak_ref (G_OBJECT (surface), trace_surface_destroyed, NULL);
+    }
+
+  n_rects = cairo_region_num_rectangles (region);
+  header = g_byte_array_sized_new (sizeof (FrameRecord) + n_rects * sizeof (cairo_rectangle_int_t) + ALIGNMENT);
+  g_byte_array_set_size (header, sizeof (FrameRecord));
+  record = (FrameRecord *) header->data;
+  record->timestamp = g_get_monotonic_time () - trace->start_time;
+  record->surface = trace_surface->id;
+  record->width = gdk_surface_get_width (surface);
+  record->height = gdk_surface_get_height (surface);
+  record->n_rects = n_rects;
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (region, i, &rect);
+      g_byte_array_append (header, (guchar *) &rect, sizeof (rect));
+    }
+
+  /* The node needs to be aligned, too */
+  if (header->len % ALIGNMENT)
+    g_byte_array_set_size (header, header->len + ALIGNMENT - header->len % ALIGNMENT);
+
+  header_bytes = g_byte_array_free_to_bytes (header);
+  data = gsk_render_node_binary_writer_write (trace_surface->writer, node);
+
+  trace_write_record (RECORD_FRAME, header_bytes, data);
+
+  g_bytes_unref (header_bytes);
+  g_bytes_unref (data);
+}
+
+void
+gtk_inspector_trace_record_event (GdkEvent *event)
+{
+  EventRecord record = { 0, };
+  GBytes *bytes;
+  double x, y;
+
+  if (!gtk_inspector_trace_is_active ())
+    return;
+
+  record.timestamp = g_get_monotonic_time () - trace->start_time;
+  record.type = gdk_event_get_event_type (event);
+  record.time = gdk_event_get_time (event);
+  record.state = gdk_event_get_modifier_state (event);
+  record.sequence = GPOINTER_TO_SIZE (gdk_event_get_event_sequence (event));
+
+  if (gdk_event_get_position (event, &x, &y))
+    {
+      record.flags |= EVENT_HAS_POSITION;
+      record.x = x;
+      record.y = y;
+    }
+
+  switch ((int) record.type)
+    {
+    case GDK_BUTTON_PRESS:
+    case GDK_BUTTON_RELEASE:
+      record.detail = gdk_button_event_get_button (event);
+      break;
+
+    case GDK_KEY_PRESS:
+    case GDK_KEY_RELEASE:
+      record.detail = gdk_key_event_get_keyval (event);
+      record.detail2 = gdk_key_event_get_keycode (event);
+      break;
+
+    case GDK_SCROLL:
+      record.detail = gdk_scroll_event_get_direction (event);
+      record.detail2 = gdk_scroll_event_get_unit (event);
+      gdk_scroll_event_get_deltas (event, &record.dx, &record.dy);
+      if (gdk_scroll_event_is_stop (event))
+        record.flags |= EVENT_SCROLL_STOP;
+      break;
+
+    case GDK_MOTION_NOTIFY:
+    case GDK_TOUCH_BEGIN:
+    case GDK_TOUCH_UPDATE:
+    case GDK_TOUCH_END:
+    case GDK_TOUCH_CANCEL:
+      break;
+
+    default:
+      /* Only input events that can be recreated when loading */
+      return;
+    }
+
+  bytes = g_bytes_new (&record, sizeof (record));
+  trace_write_record (RECORD_EVENT, bytes, NULL);
+  g_bytes_unref (bytes);
+}
+
+static GdkEvent *
+create_event (const EventRecord *record)
+{
+  GdkEventSequence *sequence = GSIZE_TO_POINTER (record->sequence);
+  GdkTranslatedKey translated = { 0, };
+
+  switch (record->type)
+    {
+    case GDK_BUTTON_PRESS:
+    case GDK_BUTTON_RELEASE:
+      return gdk_button_event_new (record->type, NULL, NULL, NULL,
+                                   record->time, record->state,
+                                   record->detail,
+                                   record->x, record->y,
+                                   NULL);
+
+    case GDK_MOTION_NOTIFY:
+      return gdk_motion_event_new (NULL, NULL, NULL,
+                                   record->time, record->state,
+                                   record->x, record->y,
+                                   NULL);
+
+    case GDK_KEY_PRESS:
+    case GDK_KEY_RELEASE:
+      translated.keyval = record->detail;
+      return gdk_key_event_new (record->type, NULL, NULL,
+                                record->time, record->detail2, record->state,
+                                FALSE, &translated, &translated, NULL);
+
+    case GDK_SCROLL:
+      if (record->detail != GDK_SCROLL_SMOOTH)
+        return gdk_scroll_event_new_discrete (NULL, NULL, NULL,
+                                              record->time, record->state,
+                                              record->detail);
+      return gdk_scroll_event_new (NULL, NULL, NULL,
+                                   record->time, record->state,
+                                   record->dx, record->dy,
+                                   (record->flags & EVENT_SCROLL_STOP) != 0,
+                                   record->detail2 == GDK_SCROLL_UNIT_SURFACE ? GDK_SCROLL_UNIT_SURFACE
+                                                                              : GDK_SCROLL_UNIT_WHEEL);
+
+    case GDK_TOUCH_BEGIN:
+    case GDK_TOUCH_UPDATE:
+    case GDK_TOUCH_END:
+    case GDK_TOUCH_CANCEL:
+      return gdk_touch_event_new (record->type, sequence, NULL, NULL,
+                                  record->time, record->state,
+                                  record->x, record->y,
+                                  NULL, FALSE);
+
+    default:
+      return NULL;
+    }
+}
+
+static void
+reader_free (gpointer data)
+{
+  gsk_render_node_binary_reader_free (data);
+}
+
+/*<private>
+ * gtk_inspector_trace_load:
+ * @file: a trace written with gtk_inspector_trace_start()
+ * @error: return location for an error
+ *
+ * Loads the frames and events of a trace as recordings.
+ *
+ * Returns: (transfer container): the recordings
+ */
+GPtrArray *
+gtk_inspector_trace_load (GFile   *file,
+                          GError **error)
+{
+  GPtrArray *recordings;
+  GHashTable *readers;
+  GMappedFile *mapped;
+  const guchar *data;
+  GBytes *bytes;
+  gsize size, pos;
+  char *path;
+
+  path = g_file_get_path (file);
+  if (path == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, _("Traces must be local files"));
+      return NULL;
+    }
+
+  mapped = g_mapped_file_new (path, FALSE, error);
+  g_free (path);
+  if (mapped == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+  data = g_bytes_get_data (bytes, &size);
+
+  if (size < sizeof (FileHeader) ||
+      memcmp (((const FileHeader *) data)->magic, MAGIC, 8) != 0 ||
+      ((const FileHeader *) data)->version != VERSION)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Not a trace file"));
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  recordings = g_ptr_array_new_with_free_func (g_object_unref);
+  readers = g_hash_table_new_full (NULL, NULL, NULL, reader_free);
+
+  /* A trace that was not stopped properly may be cut off at the
+   * end, so just load what's there.
+   */
+  for (pos = sizeof (FileHeader);
+       size - pos >= sizeof (RecordHeader);
+       pos += sizeof (RecordHeader) + (((const RecordHeader *) (data + pos))->size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+    {
+      const RecordHeader *header = (const RecordHeader *) (data + pos);
+      const guchar *record_data = data + pos + sizeof (RecordHeader);
+      gsize record_size = header->size;
+
+      if (record_size > size - pos - sizeof (RecordHeader))
+        break;
+
+      if (header->type == RECORD_FRAME && record_size >= sizeof (FrameRecord))
+        {
+          const FrameRecord *frame = (const FrameRecord *) record_data;
+          GskRenderNodeBinaryReader *reader;
+          GtkInspectorRecording *recording;
+          cairo_region_t *region;
+          GskRenderNode *node;
+          GBytes *node_bytes;
+          gsize offset;
+          GError *read_error = NULL;
+
+          offset = sizeof (FrameRecord) + (gsize) frame->n_rects * sizeof (cairo_rectangle_int_t);
+          offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+          if (frame->n_rects > record_size || offset > record_size)
+            break;
+
+          reader = g_hash_table_lookup (readers, GUINT_TO_POINTER (frame->surface));
+          if (reader == NULL)
+            {
+              reader = gsk_render_node_binary_reader_new ();
+              g_hash_table_insert (readers, GUINT_TO_POINTER (frame->surface), reader);
+            }
+
+          node_bytes = g_bytes_new_from_bytes (bytes, pos + sizeof (RecordHeader) + offset, record_size - offset);
+          node = gsk_render_node_binary_reader_read (reader, node_bytes, &read_error);
+          g_bytes_unref (node_bytes);
+
+          if (node == NULL)
+            {
+              g_warning ("Failed to load frame: %s", read_error->message);
+              g_error_free (read_error);
+              continue;
+            }
+
+          region = cairo_region_create_rectangles ((const cairo_rectangle_int_t *) (frame + 1), frame->n_rects);
+          recording = gtk_inspector_render_recording_new (frame->timestamp,
+                                                          NULL,
+                                                          &(GdkRectangle) { 0, 0, frame->width, frame->height },
+                                                          region,
+                                                          node);
+          g_ptr_array_add (recordings, recording);
+
+          cairo_region_destroy (region);
+          gsk_render_node_unref (node);
+        }
+      else if (header->type == RECORD_EVENT && record_size >= sizeof (EventRecord))
+        {
+          const EventRecord *record = (const EventRecord *) record_data;
+          GdkEvent *event;
+
+          event = create_event (record);
+          if (event)
+            {
+              g_ptr_array_add (recordings, gtk_inspector_event_recording_new (record->timestamp, event));
+              gdk_event_unref (event);
+            }
+        }
+    }
+
+  g_hash_table_unref (readers);
+  g_bytes_unref (bytes);
+
+  return recordings;
+}
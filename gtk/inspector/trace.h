@@ -0,0 +1,21 @@
+#pragma once
+
+#include <gtk/gtkwidget.h>
+
+G_BEGIN_DECLS
+
+gboolean        gtk_inspector_trace_start               (const char             *filename,
+                                                         GError                **error);
+void            gtk_inspector_trace_stop                (void);
+gboolean        gtk_inspector_trace_is_active           (void);
+
+void            gtk_inspector_trace_record_render       (GtkWidget              *widget,
+                                                         GdkSurface             *surface,
+                                                         const cairo_region_t   *region,
+                                                         GskRenderNode          *node);
+void            gtk_inspector_trace_record_event        (GdkEvent               *event);
+
+GPtrArray *     gtk_inspector_trace_load                (GFile                  *file,
+                                                         GError                **error);
+
+G_END_DECLS
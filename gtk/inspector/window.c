@@ -44,10 +44,12 @@
 #include "misc-info.h"
 #include "magnifier.h"
 #include "recorder.h"
+#include "trace.h"
 #include "tree-data.h"
 #include "visual.h"
 #include "general.h"
 #include "logs.h"
+#include "statistics.h"
 
 #include "gdkdebugprivate.h"
 #include "gdkmarshalers.h"
@@ -297,6 +299,7 @@ gtk_inspector_window_constructed (GObject *object)
   gtk_inspector_general_set_display (GTK_INSPECTOR_GENERAL (iw->general), iw->inspected_display);
   gtk_inspector_clipboard_set_display (GTK_INSPECTOR_CLIPBOARD (iw->clipboard), iw->inspected_display);
   gtk_inspector_logs_set_display (GTK_INSPECTOR_LOGS (iw->logs), iw->inspected_display);
+  gtk_inspector_statistics_set_display (GTK_INSPECTOR_STATISTICS (iw->statistics), iw->inspected_display);
   gtk_inspector_css_node_tree_set_display (GTK_INSPECTOR_CSS_NODE_TREE (iw->widget_css_node_tree), iw->inspected_display);
 }
 
@@ -678,6 +681,7 @@ gtk_inspector_window_class_init (GtkInspectorWindowClass *klass)
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorWindow, general);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorWindow, clipboard);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorWindow, logs);
+  gtk_widget_class_bind_template_child (widget_class, GtkInspectorWindow, statistics);
 
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorWindow, go_up_button);
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorWindow, go_down_button);
@@ -810,11 +814,15 @@ gtk_inspector_prepare_render (GtkWidget            *widget,
   GtkInspectorWindow *iw;
 
   iw = gtk_inspector_window_get_for_display (gtk_widget_get_display (widget));
-  if (iw == NULL)
-    return root;
 
   /* sanity check for single-display GDK backends */
-  if (GTK_WIDGET (iw) == widget)
+  if (iw && GTK_WIDGET (iw) == widget)
+    return root;
+
+  if (gtk_inspector_trace_is_active ())
+    gtk_inspector_trace_record_render (widget, surface, region, root);
+
+  if (iw == NULL)
     return root;
 
   gtk_inspector_recorder_record_render (GTK_INSPECTOR_RECORDER (iw->widget_recorder),
@@ -877,6 +885,9 @@ gtk_inspector_handle_event (GdkEvent *event)
   GtkInspectorWindow *iw;
   gboolean handled = FALSE;
 
+  if (gtk_inspector_trace_is_active ())
+    gtk_inspector_trace_record_event (event);
+
   if (!any_inspector_window_constructed)
     return FALSE;
 
@@ -6,6 +6,10 @@
 
 #include "gtktimsortprivate.h"
 
+#include "gdk/gdkparalleltaskprivate.h"
+
+#include <string.h>
+
 /*
  * This is the minimum sized sequence that will be merged.  Shorter
  * sequences will be lengthened by calling binarySort.  If the entire
@@ -374,3 +378,250 @@ gtk_tim_sort_step (GtkTimSort    *self,
   return result;
 }
 
+/*
+ * Parallel sorting
+ *
+ * The array is split into runs of PARALLEL_RUN_SIZE elements that are
+ * sorted with gtk_tim_sort() in parallel. Then pairs of runs are merged
+ * until a single run is left. The merges are split into pieces of
+ * PARALLEL_MERGE_SIZE elements of output, so that the last merges are
+ * done in parallel, too.
+ */
+
+#define PARALLEL_RUN_SIZE (8 * 1024)
+#define PARALLEL_MERGE_SIZE (8 * 1024)
+
+G_STATIC_ASSERT (PARALLEL_RUN_SIZE % PARALLEL_MERGE_SIZE == 0);
+
+typedef struct _GtkTimSortParallel GtkTimSortParallel;
+
+struct _GtkTimSortParallel
+{
+  gsize element_size;
+  GCompareDataFunc compare_func;
+  gpointer data;
+  GCancellable *cancellable;
+  guint *progress;
+
+  gsize size;
+  guint8 *src;
+  guint8 *dest;
+  gsize run_size;
+};
+
+static void
+gtk_tim_sort_parallel_sort_runs (gsize    start,
+                                 gsize    end,
+                                 gpointer data)
+{
+  GtkTimSortParallel *sort = data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    {
+      gsize offset = i * PARALLEL_RUN_SIZE;
+
+      if (g_cancellable_is_cancelled (sort->cancellable))
+        return;
+
+      gtk_tim_sort (sort->src + offset * sort->element_size,
+                    MIN (PARALLEL_RUN_SIZE, sort->size - offset),
+                    sort->element_size,
+                    sort->compare_func,
+                    sort->data);
+
+      if (sort->progress)
+        g_atomic_int_inc (sort->progress);
+    }
+}
+
+/* Returns how many elements of a are among the first k elements
+ * of the merge of a and b. Elements of a go first if they compare
+ * equal, which keeps the sort stable.
+ */
+static gsize
+gtk_tim_sort_parallel_split (GtkTimSortParallel *sort,
+                             const guint8       *a,
+                             gsize               n_a,
+                             const guint8       *b,
+                             gsize               n_b,
+                             gsize               k)
+{
+  gsize lo, hi, i;
+
+  lo = k > n_b ? k - n_b : 0;
+  hi = MIN (k, n_a);
+
+  while (lo < hi)
+    {
+      i = lo + (hi - lo) / 2;
+
+      if (sort->compare_func (a + i * sort->element_size,
+                              b + (k - i - 1) * sort->element_size,
+                              sort->data) <= 0)
+        lo = i + 1;
+      else
+        hi = i;
+    }
+
+  return lo;
+}
+
+static void
+gtk_tim_sort_parallel_merge (gsize    start,
+                             gsize    end,
+                             gpointer data)
+{
+  GtkTimSortParallel *sort = data;
+  gsize es = sort->element_size;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    {
+      gsize out_start, out_end, base, n_a, n_b, a_start, a_end, b_start, b_end;
+      const guint8 *a, *b;
+      guint8 *out;
+
+      if (g_cancellable_is_cancelled (sort->cancellable))
+        return;
+
+      out_start = i * PARALLEL_MERGE_SIZE;
+      out_end = MIN (out_start + PARALLEL_MERGE_SIZE, sort->size);
+
+      /* Pieces never cross pairs, as pairs are a multiple of the piece size */
+      base = out_start - out_start % (2 * sort->run_size);
+      n_a = MIN (sort->run_size, sort->size - base);
+      n_b = MIN (sort->run_size, sort->size - base - n_a);
+      a = sort->src + base * es;
+      b = a + n_a * es;
+
+      a_start = gtk_tim_sort_parallel_split (sort, a, n_a, b, n_b, out_start - base);
+      b_start = out_start - base - a_start;
+      a_end = gtk_tim_sort_parallel_split (sort, a, n_a, b, n_b, out_end - base);
+      b_end = out_end - base - a_end;
+
+      out = sort->dest + out_start * es;
+      while (a_start < a_end && b_start < b_end)
+        {
+          if (sort->compare_func (a + a_start * es, b + b_start * es, sort->data) <= 0)
+            memcpy (out, a + a_start++ * es, es);
+          else
+            memcpy (out, b + b_start++ * es, es);
+          out += es;
+        }
+      memcpy (out, a + a_start * es, (a_end - a_start) * es);
+      out += (a_end - a_start) * es;
+      memcpy (out, b + b_start * es, (b_end - b_start) * es);
+
+      if (sort->progress)
+        g_atomic_int_inc (sort->progress);
+    }
+}
+
+/*<private>
+ * gtk_tim_sort_parallel_get_n_steps:
+ * @size: number of elements in the array
+ *
+ * Returns the number of steps gtk_tim_sort_parallel() takes to sort
+ * an array of @size elements, see its @progress argument.
+ *
+ * Returns: the number of steps
+ **/
+guint
+gtk_tim_sort_parallel_get_n_steps (gsize size)
+{
+  gsize run_size;
+  guint n_steps;
+
+  if (size <= PARALLEL_RUN_SIZE)
+    return 1;
+
+  n_steps = (size + PARALLEL_RUN_SIZE - 1) / PARALLEL_RUN_SIZE;
+  for (run_size = PARALLEL_RUN_SIZE; run_size < size; run_size *= 2)
+    n_steps += (size + PARALLEL_MERGE_SIZE - 1) / PARALLEL_MERGE_SIZE;
+
+  return n_steps;
+}
+
+/*<private>
+ * gtk_tim_sort_parallel:
+ * @base: the array to sort
+ * @size: number of elements in the array
+ * @element_size: size of an element
+ * @compare_func: the function to compare elements with. It is called
+ *   from multiple threads at the same time.
+ * @user_data: data for @compare_func
+ * @cancellable: (nullable): a `GCancellable` to stop sorting
+ * @progress: (nullable): location of a counter that is atomically
+ *   incremented for every step that is done
+ *
+ * Sorts the array like gtk_tim_sort(), but uses multiple threads.
+ *
+ * This is meant for large arrays, the parallel sort is not incremental
+ * and does not take advantage of runs that are already sorted.
+ *
+ * The total number of steps is returned by
+ * gtk_tim_sort_parallel_get_n_steps(), so another thread can use
+ * @progress to see how far the sort is.
+ *
+ * If the sort is cancelled, the contents of @base are undefined.
+ *
+ * Returns: %FALSE if the sort was cancelled
+ **/
+gboolean
+gtk_tim_sort_parallel (gpointer          base,
+                       gsize             size,
+                       gsize             element_size,
+                       GCompareDataFunc  compare_func,
+                       gpointer          user_data,
+                       GCancellable     *cancellable,
+                       guint            *progress)
+{
+  GtkTimSortParallel sort;
+  guint8 *tmp;
+
+  if (size <= PARALLEL_RUN_SIZE)
+    {
+      gtk_tim_sort (base, size, element_size, compare_func, user_data);
+      if (progress)
+        g_atomic_int_inc (progress);
+      return TRUE;
+    }
+
+  tmp = g_malloc_n (size, element_size);
+
+  sort.element_size = element_size;
+  sort.compare_func = compare_func;
+  sort.data = user_data;
+  sort.cancellable = cancellable;
+  sort.progress = progress;
+  sort.size = size;
+  sort.src = base;
+  sort.dest = tmp;
+
+  gdk_parallel_task_run (gtk_tim_sort_parallel_sort_runs,
+                         &sort,
+                         (size + PARALLEL_RUN_SIZE - 1) / PARALLEL_RUN_SIZE,
+                         1);
+
+  for (sort.run_size = PARALLEL_RUN_SIZE; sort.run_size < size; sort.run_size *= 2)
+    {
+      guint8 *swap;
+
+      gdk_parallel_task_run (gtk_tim_sort_parallel_merge,
+                             &sort,
+                             (size + PARALLEL_MERGE_SIZE - 1) / PARALLEL_MERGE_SIZE,
+                             1);
+
+      swap = sort.src;
+      sort.src = sort.dest;
+      sort.dest = swap;
+    }
+
+  if (sort.src != base)
+    memcpy (base, sort.src, size * element_size);
+
+  g_free (tmp);
+
+  return !g_cancellable_is_cancelled (cancellable);
+}
@@ -117,4 +117,12 @@ void            gtk_tim_sort                                    (gpointer
                                                                  gsize                   element_size,
                                                                  GCompareDataFunc        compare_func,
                                                                  gpointer                user_data);
+gboolean        gtk_tim_sort_parallel                           (gpointer                base,
+                                                                 gsize                   size,
+                                                                 gsize                   element_size,
+                                                                 GCompareDataFunc        compare_func,
+                                                                 gpointer                user_data,
+                                                                 GCancellable           *cancellable,
+                                                                 guint                  *progress);
+guint           gtk_tim_sort_parallel_get_n_steps               (gsize                   size);
 
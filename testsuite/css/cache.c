@@ -0,0 +1,311 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+/* Tests for the stylesheet cache that is enabled with GTK_CSS_CACHE.
+ * Every stylesheet loaded from a file is compared against the same
+ * stylesheet loaded from a string, which never uses the cache.
+ */
+
+static char *cache_dir;
+static char *data_dir;
+
+static const char *stylesheet =
+  "@define-color accent #3584e4;\n"
+  "@keyframes spin { from { transform: rotate(0deg); } to { transform: rotate(360deg); } }\n"
+  "window { background-color: @accent; color: rgba(0,0,0,0.8); }\n"
+  "button.suggested-action:hover:not(:disabled) > label { font-weight: bold; padding: 2px 4px; }\n"
+  "#main box.horizontal + entry, list row:selected { border: 1px solid rgba(53,132,228,0.3); border-radius: 6px; }\n"
+  "spinner:checked { animation: spin 1s linear infinite; }\n"
+  "scale trough highlight { background-image: linear-gradient(to right, red, blue); box-shadow: inset 0 1px 2px black; }\n"
+  "popover.menu modelbutton:focus-visible ~ separator { margin: 3px; transition: opacity 200ms ease-in-out; }\n"
+  "*:backdrop label:dir(rtl) { font-family: \"Cantarell\", sans-serif; font-size: 11pt; opacity: 0.5; }\n";
+
+static void
+parsing_error_cb (GtkCssProvider *provider,
+                  GtkCssSection  *section,
+                  const GError   *error)
+{
+  g_error ("Unexpected CSS error: %s", error->message);
+}
+
+static GtkCssProvider *
+create_provider (void)
+{
+  GtkCssProvider *provider;
+
+  provider = gtk_css_provider_new ();
+  g_signal_connect (provider, "parsing-error", G_CALLBACK (parsing_error_cb), NULL);
+
+  return provider;
+}
+
+static char *
+write_file (const char *name,
+            const char *contents)
+{
+  GError *error = NULL;
+  char *path;
+
+  path = g_build_filename (data_dir, name, NULL);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+
+  return path;
+}
+
+/* Mirrors the key computation in gtkcssprovider.c */
+static char *
+get_cache_path (const char *path)
+{
+  GChecksum *checksum;
+  GFile *file;
+  char *uri, *contents, *filename, *result;
+  gsize length;
+
+  g_assert_true (g_file_get_contents (path, &contents, &length, NULL));
+  file = g_file_new_for_path (path);
+  uri = g_file_get_uri (file);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) uri, strlen (uri) + 1);
+  g_checksum_update (checksum, (const guchar *) contents, length);
+  filename = g_strconcat (g_checksum_get_string (checksum), ".cache", NULL);
+  result = g_build_filename (cache_dir, filename, NULL);
+
+  g_free (filename);
+  g_checksum_free (checksum);
+  g_free (uri);
+  g_object_unref (file);
+  g_free (contents);
+
+  return result;
+}
+
+/* The cache is written in a thread */
+static void
+wait_for_file (const char *path)
+{
+  guint i;
+
+  for (i = 0; i < 500 && !g_file_test (path, G_FILE_TEST_EXISTS); i++)
+    {
+      while (g_main_context_iteration (NULL, FALSE));
+      g_usleep (10 * 1000);
+    }
+
+  g_assert_true (g_file_test (path, G_FILE_TEST_EXISTS));
+}
+
+static char *
+load_path_to_string (const char *path)
+{
+  GtkCssProvider *provider;
+  char *result;
+
+  provider = create_provider ();
+  gtk_css_provider_load_from_path (provider, path);
+  result = gtk_css_provider_to_string (provider);
+  g_object_unref (provider);
+
+  return result;
+}
+
+static char *
+load_string_to_string (const char *string)
+{
+  GtkCssProvider *provider;
+  char *result;
+
+  provider = create_provider ();
+  gtk_css_provider_load_from_string (provider, string);
+  result = gtk_css_provider_to_string (provider);
+  g_object_unref (provider);
+
+  return result;
+}
+
+static void
+test_cache_roundtrip (void)
+{
+  char *path, *cache_path, *expected, *fresh, *cached;
+
+  path = write_file ("roundtrip.css", stylesheet);
+  cache_path = get_cache_path (path);
+  g_assert_false (g_file_test (cache_path, G_FILE_TEST_EXISTS));
+
+  expected = load_string_to_string (stylesheet);
+
+  fresh = load_path_to_string (path);
+  g_assert_cmpstr (fresh, ==, expected);
+
+  wait_for_file (cache_path);
+
+  cached = load_path_to_string (path);
+  g_assert_cmpstr (cached, ==, expected);
+
+  g_free (cached);
+  g_free (fresh);
+  g_free (expected);
+  g_free (cache_path);
+  g_free (path);
+}
+
+/* Put the cache of one stylesheet in place of another's to check
+ * that loading really comes from the cache
+ */
+static void
+test_cache_used (void)
+{
+  const char *other = "label { color: red; }\n";
+  char *path, *cache_path, *other_path, *other_cache_path;
+  char *contents, *expected, *result;
+  GError *error = NULL;
+  gsize length;
+
+  other_path = write_file ("used-other.css", other);
+  other_cache_path = get_cache_path (other_path);
+  g_free (load_path_to_string (other_path));
+  wait_for_file (other_cache_path);
+
+  path = write_file ("used.css", stylesheet);
+  cache_path = get_cache_path (path);
+
+  g_file_get_contents (other_cache_path, &contents, &length, &error);
+  g_assert_no_error (error);
+  /* The key follows the magic, version, byte order, GTK version
+   * and pointer size in the header */
+  g_assert_cmpuint (length, >, 24 + 64);
+  memcpy (contents + 24, strrchr (cache_path, G_DIR_SEPARATOR) + 1, 64);
+  g_file_set_contents (cache_path, contents, length, &error);
+  g_assert_no_error (error);
+
+  expected = load_string_to_string (other);
+  result = load_path_to_string (path);
+  g_assert_cmpstr (result, ==, expected);
+
+  g_free (result);
+  g_free (expected);
+  g_free (contents);
+  g_free (cache_path);
+  g_free (path);
+  g_free (other_cache_path);
+  g_free (other_path);
+}
+
+static void
+test_cache_source_changed (void)
+{
+  const char *changed = "window { background-color: green; }\n";
+  char *path, *cache_path, *expected, *result;
+
+  path = write_file ("source.css", stylesheet);
+  cache_path = get_cache_path (path);
+  g_free (load_path_to_string (path));
+  wait_for_file (cache_path);
+
+  g_free (write_file ("source.css", changed));
+
+  expected = load_string_to_string (changed);
+  result = load_path_to_string (path);
+  g_assert_cmpstr (result, ==, expected);
+
+  g_free (result);
+  g_free (expected);
+  g_free (cache_path);
+  g_free (path);
+}
+
+static void
+test_cache_import_changed (void)
+{
+  const char *imported_before = "label { color: red; }\n";
+  const char *imported_after = "label { color: blue; margin: 1px; }\n";
+  const char *main_css = "@import url(\"imported.css\");\nbox { padding: 3px; }\n";
+  char *path, *cache_path, *imported_path, *imported_uri;
+  char *string, *expected, *result;
+  GFile *file;
+
+  imported_path = write_file ("imported.css", imported_before);
+  file = g_file_new_for_path (imported_path);
+  imported_uri = g_file_get_uri (file);
+  g_object_unref (file);
+  string = g_strdup_printf ("@import url(\"%s\");\nbox { padding: 3px; }\n", imported_uri);
+
+  path = write_file ("importing.css", main_css);
+  cache_path = get_cache_path (path);
+
+  expected = load_string_to_string (string);
+  result = load_path_to_string (path);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+  g_free (expected);
+
+  wait_for_file (cache_path);
+
+  /* Unchanged imports use the cache */
+  expected = load_string_to_string (string);
+  result = load_path_to_string (path);
+  g_assert_cmpstr (result, ==, expected);
+  g_free (result);
+  g_free (expected);
+
+  g_free (write_file ("imported.css", imported_after));
+
+  expected = load_string_to_string (string);
+  result = load_path_to_string (path);
+  g_assert_cmpstr (result, ==, expected);
+  g_assert_nonnull (strstr (result, "margin"));
+  g_free (result);
+  g_free (expected);
+
+  g_free (string);
+  g_free (imported_uri);
+  g_free (imported_path);
+  g_free (cache_path);
+  g_free (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  int result;
+
+  cache_dir = g_dir_make_tmp ("gtk-css-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  data_dir = g_dir_make_tmp ("gtk-css-data-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  /* Must be set before the first stylesheet is loaded */
+  g_setenv ("GTK_CSS_CACHE", cache_dir, TRUE);
+  g_unsetenv ("GTK_CSS_DEBUG");
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/css/cache/roundtrip", test_cache_roundtrip);
+  g_test_add_func ("/css/cache/used", test_cache_used);
+  g_test_add_func ("/css/cache/source-changed", test_cache_source_changed);
+  g_test_add_func ("/css/cache/import-changed", test_cache_import_changed);
+
+  result = g_test_run ();
+
+  g_free (data_dir);
+  g_free (cache_dir);
+
+  return result;
+}
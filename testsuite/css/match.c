@@ -0,0 +1,217 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include "gtk/gtkcssnodeprivate.h"
+#include "gtk/gtkcssstyleprivate.h"
+
+/* Validating a tree where many nodes need new styles matches the
+ * selectors for all of them in parallel first. These tests build the
+ * same tree twice: once validated in one go, which takes the parallel
+ * path, and once validated after every small change, which stays below
+ * the threshold, and compare the resulting styles.
+ */
+
+/* More than the 512 nodes that are matched in parallel */
+#define N_BOXES 40
+#define N_CHILDREN 20
+
+static const char *css =
+  "box { color: red; padding: 1px; }\n"
+  "box.odd { color: blue; }\n"
+  "box:first-child { margin: 2px; }\n"
+  "box:last-child > label { font-weight: bold; }\n"
+  "box > label { color: green; }\n"
+  "box > label:nth-child(3n+1) { padding: 4px; }\n"
+  "box > label:last-child { border-top: 1px solid black; }\n"
+  "label.a + label { margin-left: 5px; }\n"
+  "label.a ~ label.b { opacity: 0.5; }\n"
+  "box.odd label.b { background-color: yellow; }\n"
+  "box:hover > label { color: purple; }\n"
+  "box:hover label.a { font-size: 20px; }\n"
+  "*:not(.a):not(.b) { letter-spacing: 1px; }\n";
+
+static GtkCssNode *
+create_node (GtkCssNode *parent,
+             const char *name)
+{
+  GtkCssNode *node;
+
+  node = gtk_css_node_new ();
+  gtk_css_node_set_name (node, g_quark_from_static_string (name));
+  if (parent)
+    {
+      gtk_css_node_set_parent (node, parent);
+      g_object_unref (node);
+    }
+
+  return node;
+}
+
+static void
+add_label (GtkCssNode *box,
+           guint       i)
+{
+  GtkCssNode *label;
+
+  label = create_node (box, "label");
+  if (i % 4 == 0)
+    gtk_css_node_add_class (label, g_quark_from_static_string ("a"));
+  if (i % 3 == 2)
+    gtk_css_node_add_class (label, g_quark_from_static_string ("b"));
+}
+
+static GtkCssNode *
+add_box (GtkCssNode *root,
+         guint       i)
+{
+  GtkCssNode *box;
+
+  box = create_node (root, "box");
+  if (i % 2)
+    gtk_css_node_add_class (box, g_quark_from_static_string ("odd"));
+
+  return box;
+}
+
+static GtkCssNode *
+create_tree_at_once (void)
+{
+  GtkCssNode *root, *box;
+  guint i, j;
+
+  root = create_node (NULL, "window");
+
+  for (i = 0; i < N_BOXES; i++)
+    {
+      box = add_box (root, i);
+      for (j = 0; j < N_CHILDREN; j++)
+        add_label (box, j);
+    }
+
+  gtk_css_node_validate (root);
+
+  return root;
+}
+
+static GtkCssNode *
+create_tree_incrementally (void)
+{
+  GtkCssNode *root, *box;
+  guint i, j;
+
+  root = create_node (NULL, "window");
+  gtk_css_node_validate (root);
+
+  for (i = 0; i < N_BOXES; i++)
+    {
+      box = add_box (root, i);
+      gtk_css_node_validate (root);
+      for (j = 0; j < N_CHILDREN; j++)
+        {
+          add_label (box, j);
+          gtk_css_node_validate (root);
+        }
+    }
+
+  return root;
+}
+
+static void
+assert_styles_equal (GtkCssNode *node1,
+                     GtkCssNode *node2)
+{
+  GtkCssNode *child1, *child2;
+  char *style1, *style2;
+
+  style1 = gtk_css_style_to_string (gtk_css_node_get_style (node1));
+  style2 = gtk_css_style_to_string (gtk_css_node_get_style (node2));
+  g_assert_cmpstr (style1, ==, style2);
+  g_free (style1);
+  g_free (style2);
+
+  for (child1 = gtk_css_node_get_first_child (node1), child2 = gtk_css_node_get_first_child (node2);
+       child1 && child2;
+       child1 = gtk_css_node_get_next_sibling (child1), child2 = gtk_css_node_get_next_sibling (child2))
+    assert_styles_equal (child1, child2);
+
+  g_assert_null (child1);
+  g_assert_null (child2);
+}
+
+static void
+test_match_new_tree (void)
+{
+  GtkCssNode *parallel, *serial;
+
+  parallel = create_tree_at_once ();
+  serial = create_tree_incrementally ();
+
+  assert_styles_equal (parallel, serial);
+
+  g_object_unref (serial);
+  g_object_unref (parallel);
+}
+
+static void
+test_match_state_change (void)
+{
+  GtkCssNode *parallel, *serial, *box;
+
+  parallel = create_tree_at_once ();
+  serial = create_tree_incrementally ();
+
+  /* Changes the style of every label at once */
+  for (box = gtk_css_node_get_first_child (parallel);
+       box;
+       box = gtk_css_node_get_next_sibling (box))
+    gtk_css_node_set_state (box, GTK_STATE_FLAG_PRELIGHT);
+  gtk_css_node_validate (parallel);
+
+  for (box = gtk_css_node_get_first_child (serial);
+       box;
+       box = gtk_css_node_get_next_sibling (box))
+    {
+      gtk_css_node_set_state (box, GTK_STATE_FLAG_PRELIGHT);
+      gtk_css_node_validate (serial);
+    }
+
+  assert_styles_equal (parallel, serial);
+
+  g_object_unref (serial);
+  g_object_unref (parallel);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GtkCssProvider *provider;
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_string (provider, css);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+  g_object_unref (provider);
+
+  g_test_add_func ("/css/match/new-tree", test_match_new_tree);
+  g_test_add_func ("/css/match/state-change", test_match_state_change);
+
+  return g_test_run ();
+}
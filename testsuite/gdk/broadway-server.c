@@ -0,0 +1,119 @@
+#include <gtk.h>
+
+#include "gdk/broadway/broadway-server.h"
+#include "gdk/broadway/broadway-output.h"
+
+#include <gio/gunixoutputstream.h>
+#include <glib-unix.h>
+#include <unistd.h>
+
+/* Normally provided by broadwayd */
+void
+broadway_events_got_input (BroadwayInputMsg *message,
+                           gint32            client_id)
+{
+}
+
+#define COLOR_NODE(id) BROADWAY_NODE_COLOR, (id), 0, 0, 0, 0, 0xff0000ff
+
+static void
+update_nodes (BroadwayServer *server,
+              guint32         surface,
+              guint32        *data,
+              gsize           len)
+{
+  GHashTable *textures;
+
+  textures = g_hash_table_new (NULL, NULL);
+  broadway_server_surface_update_nodes (server, surface, data, len, textures);
+  g_hash_table_unref (textures);
+}
+
+static gsize
+drain (int fd)
+{
+  char buffer[4096];
+  gsize total = 0;
+  gssize n;
+
+  do
+    {
+      while ((n = read (fd, buffer, sizeof (buffer))) > 0)
+        total += n;
+    }
+  while (g_main_context_iteration (NULL, FALSE));
+
+  while ((n = read (fd, buffer, sizeof (buffer))) > 0)
+    total += n;
+
+  return total;
+}
+
+/* While the output is congested, node updates are not sent, but the
+ * client may reuse nodes from them in its next update already.
+ */
+static void
+test_congested_reuse (void)
+{
+  guint32 first[] = { BROADWAY_NODE_CONTAINER, 1, 1, COLOR_NODE (2) };
+  guint32 second[] = { BROADWAY_NODE_CONTAINER, 3, 1, COLOR_NODE (4) };
+  guint32 third[] = { BROADWAY_NODE_CONTAINER, 5, 2, BROADWAY_NODE_REUSE, 4, COLOR_NODE (6) };
+  guint32 fourth[] = { BROADWAY_NODE_CONTAINER, 7, 2, BROADWAY_NODE_REUSE, 4, BROADWAY_NODE_REUSE, 6 };
+  BroadwayServer *server;
+  GOutputStream *stream;
+  GError *error = NULL;
+  GBytes *bytes;
+  guint32 surface;
+  int fds[2];
+  gsize size;
+
+  g_assert_true (g_unix_open_pipe (fds, FD_CLOEXEC, &error));
+  g_assert_no_error (error);
+  g_assert_true (g_unix_set_fd_nonblocking (fds[0], TRUE, &error));
+  g_assert_true (g_unix_set_fd_nonblocking (fds[1], TRUE, &error));
+  g_assert_no_error (error);
+
+  server = g_object_new (BROADWAY_TYPE_SERVER, NULL);
+  stream = g_unix_output_stream_new (fds[1], TRUE);
+  broadway_server_set_output (server, broadway_output_new (stream, 0));
+  g_object_unref (stream);
+
+  surface = broadway_server_new_surface (server, 1, 0, 0, 100, 100);
+
+  update_nodes (server, surface, first, G_N_ELEMENTS (first));
+  broadway_server_flush (server);
+  drain (fds[0]);
+
+  /* Queue up more than the pipe takes, so the output gets congested */
+  size = 4 * 1024 * 1024;
+  bytes = g_bytes_new_take (g_malloc0 (size), size);
+  broadway_server_upload_texture (server, 0, bytes);
+  g_bytes_unref (bytes);
+  broadway_server_flush (server);
+
+  update_nodes (server, surface, second, G_N_ELEMENTS (second));
+  broadway_server_flush (server);
+  update_nodes (server, surface, third, G_N_ELEMENTS (third));
+  broadway_server_flush (server);
+
+  /* Sends the skipped nodes once the output drained */
+  g_assert_cmpuint (drain (fds[0]), >, size);
+
+  update_nodes (server, surface, fourth, G_N_ELEMENTS (fourth));
+  broadway_server_flush (server);
+  g_assert_cmpuint (drain (fds[0]), >, 0);
+
+  broadway_server_destroy_surface (server, surface, FALSE);
+  g_object_unref (server);
+  close (fds[0]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/broadway/server/congested-reuse", test_congested_reuse);
+
+  return g_test_run ();
+}
@@ -0,0 +1,188 @@
+#include <gtk.h>
+
+#include "gdk/gdkeventsprivate.h"
+#include "gdk/gdkframeclockidleprivate.h"
+
+static void
+test_percentiles (void)
+{
+  GdkInputLatency latency = { 0, };
+  int i;
+
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 50), ==, 0);
+
+  /* 1ms, 2ms, ... 100ms, slightly below the bucket boundary */
+  for (i = 1; i <= 100; i++)
+    _gdk_input_latency_add_sample (&latency, i * 1000 - 1);
+
+  g_assert_cmpuint (latency.n_events, ==, 100);
+  g_assert_cmpint (latency.max, ==, 99999);
+
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 0), ==, 1000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 1), ==, 1000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 50), ==, 50000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 95), ==, 95000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 100), ==, 99999);
+}
+
+static void
+test_overflow (void)
+{
+  GdkInputLatency latency = { 0, };
+
+  _gdk_input_latency_add_sample (&latency, 500);
+  _gdk_input_latency_add_sample (&latency, 5 * G_USEC_PER_SEC);
+
+  g_assert_cmpuint (latency.buckets[0], ==, 1);
+  g_assert_cmpuint (latency.buckets[GDK_INPUT_LATENCY_N_BUCKETS - 1], ==, 1);
+
+  /* Latencies beyond the last bucket are only tracked by the maximum */
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 50), ==, 1000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&latency, 100), ==, 5 * G_USEC_PER_SEC);
+}
+
+static void
+test_combine (void)
+{
+  GdkInputLatency a = { 0, }, b = { 0, }, sum = { 0, };
+  int i;
+
+  for (i = 0; i < 10; i++)
+    _gdk_input_latency_add_sample (&a, 4000);
+  for (i = 0; i < 30; i++)
+    _gdk_input_latency_add_sample (&b, 20000);
+
+  _gdk_input_latency_add (&sum, &a);
+  _gdk_input_latency_add (&sum, &b);
+
+  g_assert_cmpuint (sum.n_events, ==, 40);
+  g_assert_cmpint (sum.max, ==, 20000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&sum, 25), ==, 5000);
+  g_assert_cmpint (_gdk_input_latency_get_percentile (&sum, 50), ==, 20000);
+}
+
+static void
+test_frame_clock (void)
+{
+  GdkFrameClock *clock;
+  guint n_events = 1;
+
+  clock = g_object_new (GDK_TYPE_FRAME_CLOCK_IDLE, NULL);
+
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_KEY_PRESS, 50, &n_events), ==, 0);
+  g_assert_cmpuint (n_events, ==, 0);
+
+  gdk_frame_clock_reset_input_latency (clock);
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_MOTION_NOTIFY, 100, NULL), ==, 0);
+
+  g_object_unref (clock);
+}
+
+/* Dispatches @event like gdk_surface_handle_event() does,
+ * with a handler that may cause a new frame */
+static void
+dispatch_event (GdkFrameClock *clock,
+                GdkEvent      *event,
+                gboolean       update)
+{
+  _gdk_frame_clock_begin_input (clock, event);
+  if (update)
+    _gdk_frame_clock_note_update (clock);
+  _gdk_frame_clock_end_input (clock);
+}
+
+static void
+test_frame_clock_latency (void)
+{
+  GdkFrameClock *clock;
+  GdkFrameTimings *timings;
+  GdkEvent *button, *motion;
+  gint64 now;
+  guint n_events;
+
+  clock = g_object_new (GDK_TYPE_FRAME_CLOCK_IDLE, NULL);
+  now = g_get_monotonic_time ();
+
+  button = gdk_button_event_new (GDK_BUTTON_PRESS, NULL, NULL, NULL, GDK_CURRENT_TIME, 0, 1, 0, 0, NULL);
+  button->receive_time = now;
+  motion = gdk_motion_event_new (NULL, NULL, NULL, GDK_CURRENT_TIME, 0, 0, 0, NULL);
+  motion->receive_time = now;
+
+  _gdk_frame_clock_begin_frame (clock, now);
+
+  /* Events that don't change anything aren't tracked */
+  dispatch_event (clock, motion, FALSE);
+  g_assert_false (_gdk_frame_clock_is_tracking_input (clock));
+
+  dispatch_event (clock, button, TRUE);
+  g_assert_true (_gdk_frame_clock_is_tracking_input (clock));
+
+  /* Events dispatched while handling another one belong to it */
+  _gdk_frame_clock_begin_input (clock, button);
+  dispatch_event (clock, motion, TRUE);
+  _gdk_frame_clock_end_input (clock);
+
+  /* Painting assigns the events to this frame */
+  _gdk_frame_clock_emit_paint (clock);
+  timings = gdk_frame_clock_get_current_timings (clock);
+
+  /* The frame isn't presented yet */
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_BUTTON_PRESS, 50, &n_events), ==, 0);
+  g_assert_cmpuint (n_events, ==, 0);
+  g_assert_true (_gdk_frame_clock_is_tracking_input (clock));
+
+  timings->presentation_time = now + 12345;
+  timings->complete = TRUE;
+
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_BUTTON_PRESS, 50, &n_events), ==, 12345);
+  g_assert_cmpuint (n_events, ==, 2);
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_MOTION_NOTIFY, 50, &n_events), ==, 0);
+  g_assert_cmpuint (n_events, ==, 0);
+  g_assert_false (_gdk_frame_clock_is_tracking_input (clock));
+
+  /* Without a presentation time, the drawn time is used. The
+   * next frame collects the latency */
+  _gdk_frame_clock_begin_frame (clock, now + 16000);
+  dispatch_event (clock, motion, TRUE);
+  _gdk_frame_clock_emit_paint (clock);
+  timings = gdk_frame_clock_get_current_timings (clock);
+  timings->drawn_time = now + 30000;
+  timings->complete = TRUE;
+
+  _gdk_frame_clock_begin_frame (clock, now + 32000);
+  g_assert_false (_gdk_frame_clock_is_tracking_input (clock));
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_MOTION_NOTIFY, 100, &n_events), ==, 30000);
+  g_assert_cmpuint (n_events, ==, 1);
+
+  /* Inputs that were not painted yet survive a reset */
+  dispatch_event (clock, button, TRUE);
+  gdk_frame_clock_reset_input_latency (clock);
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_BUTTON_PRESS, 50, &n_events), ==, 0);
+  g_assert_cmpuint (n_events, ==, 0);
+
+  _gdk_frame_clock_emit_paint (clock);
+  timings = gdk_frame_clock_get_current_timings (clock);
+  timings->presentation_time = now + 40000;
+  timings->complete = TRUE;
+
+  g_assert_cmpint (gdk_frame_clock_get_input_latency (clock, GDK_BUTTON_PRESS, 50, &n_events), ==, 40000);
+  g_assert_cmpuint (n_events, ==, 1);
+
+  gdk_event_unref (motion);
+  gdk_event_unref (button);
+  g_object_unref (clock);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/inputlatency/percentiles", test_percentiles);
+  g_test_add_func ("/inputlatency/overflow", test_overflow);
+  g_test_add_func ("/inputlatency/combine", test_combine);
+  g_test_add_func ("/inputlatency/frame-clock", test_frame_clock);
+  g_test_add_func ("/inputlatency/frame-clock/latency", test_frame_clock_latency);
+
+  return g_test_run ();
+}
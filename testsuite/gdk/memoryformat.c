@@ -1,5 +1,7 @@
 #include <gdk/gdk.h>
 #include <gdk/gdkmemoryformatprivate.h>
+#include <gdk/gdkmemoryformatsimdprivate.h>
+#include "gsk/gl/fp16private.h"
 
 static void
 test_depth_merge (void)
@@ -14,12 +16,144 @@ test_depth_merge (void)
     }
 }
 
+static gsize
+fast_conversion_src_bpp (GdkMemoryFastConversion conversion)
+{
+  switch (conversion)
+    {
+    case GDK_MEMORY_FAST_R8G8B8_TO_R8G8B8A8:
+    case GDK_MEMORY_FAST_R8G8B8_TO_B8G8R8A8:
+    case GDK_MEMORY_FAST_R8G8B8_TO_A8R8G8B8:
+    case GDK_MEMORY_FAST_R8G8B8_TO_A8B8G8R8:
+      return 3;
+    default:
+      return 4;
+    }
+}
+
+static void
+compare_fast_conversion (GdkMemoryFastConversionFunc  expected,
+                         GdkMemoryFastConversionFunc  func,
+                         const guchar                *src,
+                         gsize                        n,
+                         gsize                        offset)
+{
+  guchar *dest1, *dest2;
+  gsize size = 4 * n + 8;
+
+  /* pad on both sides to catch out-of-bounds writes */
+  dest1 = g_malloc (size);
+  dest2 = g_malloc (size);
+  memset (dest1, 0x55, size);
+  memset (dest2, 0x55, size);
+
+  expected (dest1 + offset, src, n);
+  func (dest2 + offset, src, n);
+
+  g_assert_cmpmem (dest1, size, dest2, size);
+
+  g_free (dest1);
+  g_free (dest2);
+}
+
+static void
+test_simd_fast_conversion (gconstpointer data)
+{
+  GdkMemoryFastConversion conversion = GPOINTER_TO_UINT (data);
+  GdkMemoryFastConversionFunc scalar;
+  gsize bpp = fast_conversion_src_bpp (conversion);
+  guint32 i;
+
+  scalar = gdk_memory_fast_conversion_get_func (conversion, GDK_MEMORY_SIMD_NONE);
+
+  for (GdkMemorySimd simd = 1; simd & GDK_MEMORY_SIMD_ALL; simd <<= 1)
+    {
+      GdkMemoryFastConversionFunc func;
+      guchar *src;
+
+      if (!(gdk_memory_simd_get_supported () & simd))
+        continue;
+
+      func = gdk_memory_fast_conversion_get_func (conversion, simd);
+      if (func == scalar)
+        continue;
+
+      if (g_test_verbose ())
+        g_test_message ("testing %s", gdk_memory_simd_get_name (simd));
+
+      /* every color/alpha combination */
+      src = g_malloc (65536 * bpp);
+      for (i = 0; i < 65536; i++)
+        {
+          src[bpp * i] = i & 0xFF;
+          src[bpp * i + 1] = i >> 8;
+          src[bpp * i + 2] = 255 - (i & 0xFF);
+          if (bpp == 4)
+            src[bpp * i + 3] = i >> 8;
+        }
+      compare_fast_conversion (scalar, func, src, 65536, 0);
+      g_free (src);
+
+      /* all the remainder sizes and unaligned pointers */
+      src = g_malloc (bpp * 200 + 3);
+      for (i = 0; i < bpp * 200 + 3; i++)
+        src[i] = g_test_rand_int_range (0, 256);
+      for (gsize n = 0; n < 200; n++)
+        for (gsize offset = 0; offset < 4; offset++)
+          compare_fast_conversion (scalar, func, src + offset, n, offset);
+      g_free (src);
+    }
+}
+
+static void
+test_simd_fp16 (void)
+{
+  guint16 *half, *half_simd, *half_scalar;
+  float *f_simd, *f_scalar;
+  gsize i, n;
+
+  half = g_new (guint16, 65536);
+  half_simd = g_new (guint16, 65536);
+  half_scalar = g_new (guint16, 65536);
+  f_simd = g_new (float, 65536);
+  f_scalar = g_new (float, 65536);
+
+  /* Only compare finite values, the scalar code doesn't do inf or nan */
+  for (i = 0, n = 0; i < 65536; i++)
+    {
+      if ((i & 0x7C00) != 0x7C00)
+        half[n++] = i;
+    }
+
+  half_to_float (half, f_simd, n);
+  half_to_float_c (half, f_scalar, n);
+  g_assert_cmpmem (f_simd, n * sizeof (float), f_scalar, n * sizeof (float));
+
+  /* Rounding differs between implementations, so only compare exact values */
+  float_to_half (f_scalar, half_simd, n);
+  float_to_half_c (f_scalar, half_scalar, n);
+  g_assert_cmpmem (half_simd, n * sizeof (guint16), half_scalar, n * sizeof (guint16));
+
+  g_free (half);
+  g_free (half_simd);
+  g_free (half_scalar);
+  g_free (f_simd);
+  g_free (f_scalar);
+}
+
 int
 main (int argc, char *argv[])
 {
   (g_test_init) (&argc, &argv, NULL);
 
   g_test_add_func ("/depth/merge", test_depth_merge);
+  for (GdkMemoryFastConversion conversion = 0; conversion < GDK_MEMORY_N_FAST_CONVERSIONS; conversion++)
+    {
+      char *name = g_strdup_printf ("/simd/fast-conversion/%u", conversion);
+      g_test_add_data_func (name, GUINT_TO_POINTER (conversion), test_simd_fast_conversion);
+      g_free (name);
+    }
+  g_test_add_func ("/simd/fp16", test_simd_fp16);
 
   return g_test_run ();
 }
@@ -0,0 +1,122 @@
+#include <gtk.h>
+
+#include "gdk/gdkparalleltaskprivate.h"
+
+typedef struct {
+  int *counts;
+  gsize chunk_size;
+  GThread *thread;
+  gboolean other_thread;
+} CountData;
+
+static void
+count_items (gsize    start,
+             gsize    end,
+             gpointer data)
+{
+  CountData *count = data;
+  gsize i;
+
+  g_assert_cmpuint (start, <, end);
+  g_assert_cmpuint (end - start, <=, count->chunk_size);
+
+  if (g_thread_self () != count->thread)
+    count->other_thread = TRUE;
+
+  for (i = start; i < end; i++)
+    g_atomic_int_inc (&count->counts[i]);
+}
+
+static void
+test_coverage (void)
+{
+  gsize n_items, chunk_size, i;
+
+  for (n_items = 0; n_items < 2000; n_items += g_test_rand_int_range (1, 200))
+    {
+      for (chunk_size = 1; chunk_size < 100; chunk_size += g_test_rand_int_range (1, 20))
+        {
+          CountData count = {
+            .counts = g_new0 (int, n_items),
+            .chunk_size = chunk_size,
+            .thread = g_thread_self (),
+          };
+
+          gdk_parallel_task_run (count_items, &count, n_items, chunk_size);
+
+          for (i = 0; i < n_items; i++)
+            g_assert_cmpint (count.counts[i], ==, 1);
+
+          g_free (count.counts);
+        }
+    }
+}
+
+static void
+test_inline (void)
+{
+  CountData count = {
+    .counts = g_new0 (int, 100),
+    .chunk_size = 100,
+    .thread = g_thread_self (),
+  };
+
+  gdk_parallel_task_run (count_items, &count, 100, 100);
+
+  g_assert_false (count.other_thread);
+  g_assert_cmpint (count.counts[0], ==, 1);
+  g_assert_cmpint (count.counts[99], ==, 1);
+
+  g_free (count.counts);
+}
+
+#define N_OUTER 64
+#define N_INNER 256
+
+static void
+run_nested (gsize    start,
+            gsize    end,
+            gpointer data)
+{
+  int *counts = data;
+  gsize i;
+
+  for (i = start; i < end; i++)
+    {
+      CountData count = {
+        .counts = counts + i * N_INNER,
+        .chunk_size = 7,
+        .thread = g_thread_self (),
+      };
+
+      gdk_parallel_task_run (count_items, &count, N_INNER, 7);
+    }
+}
+
+static void
+test_nested (void)
+{
+  int *counts;
+  gsize i;
+
+  counts = g_new0 (int, N_OUTER * N_INNER);
+
+  gdk_parallel_task_run (run_nested, counts, N_OUTER, 1);
+
+  for (i = 0; i < N_OUTER * N_INNER; i++)
+    g_assert_cmpint (counts[i], ==, 1);
+
+  g_free (counts);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/paralleltask/coverage", test_coverage);
+  g_test_add_func ("/paralleltask/inline", test_inline);
+  g_test_add_func ("/paralleltask/nested", test_nested);
+
+  return g_test_run ();
+}
@@ -0,0 +1,339 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "gsk/gskrendernodeprivate.h"
+#include "gsk/gpu/gskgpucacheprivate.h"
+#include "gsk/gpu/gskgpudeviceprivate.h"
+#include "gsk/gpu/gskgpuimageprivate.h"
+#include "gsk/gpu/gskgpurendererprivate.h"
+
+/* The GPU renderers draw cacheable containers from an offscreen once
+ * the same node is drawn again. These tests check that this looks
+ * the same as drawing a plain container, and that the offscreen is
+ * only created when it is reused.
+ */
+
+typedef struct {
+  const char *name;
+  GskRenderer * (* create) (void);
+} RendererInfo;
+
+static const RendererInfo renderers[] = {
+#ifdef GDK_RENDERING_GL
+  { "ngl", gsk_ngl_renderer_new },
+#else
+  { "ngl", NULL },
+#endif
+#ifdef GDK_RENDERING_VULKAN
+  { "vulkan", gsk_vulkan_renderer_new },
+#else
+  { "vulkan", NULL },
+#endif
+};
+
+static GskRenderer *
+create_renderer (gconstpointer data)
+{
+  const RendererInfo *info = data;
+  GskRenderer *renderer;
+  GError *error = NULL;
+
+  if (info->create == NULL)
+    {
+      g_test_skip_printf ("%s renderer not supported", info->name);
+      return NULL;
+    }
+
+  renderer = info->create ();
+  if (!gsk_renderer_realize_for_display (renderer, gdk_display_get_default (), &error))
+    {
+      g_test_skip_printf ("%s not available: %s", G_OBJECT_TYPE_NAME (renderer), error->message);
+      g_clear_error (&error);
+      g_object_unref (renderer);
+      return NULL;
+    }
+
+  return renderer;
+}
+
+static GskGpuCache *
+get_cache (GskRenderer *renderer)
+{
+  return gsk_gpu_device_get_cache (gsk_gpu_renderer_get_device (GSK_GPU_RENDERER (renderer)));
+}
+
+static GskRenderNode *
+create_content (const graphene_rect_t *bounds,
+                float                  hue)
+{
+  GskRenderNode *nodes[3];
+  GskRenderNode *node;
+  GskColorStop stops[] = {
+    { 0.0, { hue, 0.2, 0.4, 1.0 } },
+    { 1.0, { 0.8, hue, 0.2, 0.6 } },
+  };
+  graphene_rect_t inner;
+
+  nodes[0] = gsk_color_node_new (&(GdkRGBA) { 0.9, 0.9, hue, 1.0 }, bounds);
+  graphene_rect_inset_r (bounds, bounds->size.width / 8, bounds->size.height / 8, &inner);
+  nodes[1] = gsk_linear_gradient_node_new (&inner,
+                                           &inner.origin,
+                                           &GRAPHENE_POINT_INIT (inner.origin.x + inner.size.width,
+                                                                 inner.origin.y + inner.size.height),
+                                           stops, G_N_ELEMENTS (stops));
+  nodes[2] = gsk_color_node_new (&(GdkRGBA) { 0.0, 0.0, 1.0, 0.5 },
+                                 &GRAPHENE_RECT_INIT (bounds->origin.x + 3, bounds->origin.y + 5, 17, 11));
+
+  node = gsk_container_node_new (nodes, G_N_ELEMENTS (nodes));
+
+  for (guint i = 0; i < G_N_ELEMENTS (nodes); i++)
+    gsk_render_node_unref (nodes[i]);
+
+  return node;
+}
+
+static guchar *
+download (GdkTexture *texture)
+{
+  GdkTextureDownloader *downloader;
+  guchar *data;
+
+  data = g_malloc (gdk_texture_get_width (texture) * gdk_texture_get_height (texture) * 4);
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED);
+  gdk_texture_downloader_download_into (downloader, data, gdk_texture_get_width (texture) * 4);
+  gdk_texture_downloader_free (downloader);
+
+  return data;
+}
+
+static void
+assert_textures_equal (GdkTexture *texture1,
+                       GdkTexture *texture2)
+{
+  guchar *data1, *data2;
+  gsize i, size;
+
+  g_assert_cmpint (gdk_texture_get_width (texture1), ==, gdk_texture_get_width (texture2));
+  g_assert_cmpint (gdk_texture_get_height (texture1), ==, gdk_texture_get_height (texture2));
+
+  data1 = download (texture1);
+  data2 = download (texture2);
+  size = gdk_texture_get_width (texture1) * gdk_texture_get_height (texture1) * 4;
+
+  for (i = 0; i < size; i++)
+    g_assert_cmpint (ABS (data1[i] - data2[i]), <=, 1);
+
+  g_free (data2);
+  g_free (data1);
+}
+
+/* Draws both nodes inside the same parent, like a widget would be */
+static GdkTexture *
+render (GskRenderer           *renderer,
+        GskRenderNode         *node,
+        const graphene_rect_t *viewport)
+{
+  GskRenderNode *nodes[2];
+  GskRenderNode *root;
+  GdkTexture *texture;
+
+  nodes[0] = gsk_color_node_new (&(GdkRGBA) { 1.0, 1.0, 1.0, 1.0 }, viewport);
+  nodes[1] = gsk_transform_node_new (node, gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (10, 20)));
+  root = gsk_container_node_new (nodes, 2);
+
+  texture = gsk_renderer_render_texture (renderer, root, viewport);
+
+  gsk_render_node_unref (root);
+  gsk_render_node_unref (nodes[1]);
+  gsk_render_node_unref (nodes[0]);
+
+  return texture;
+}
+
+static void
+test_same_rendering (gconstpointer data)
+{
+  GskRenderer *renderer;
+  GskRenderNode *content, *plain, *cacheable;
+  graphene_rect_t viewport = GRAPHENE_RECT_INIT (0, 0, 200, 150);
+  guint i;
+
+  renderer = create_renderer (data);
+  if (renderer == NULL)
+    return;
+
+  content = create_content (&GRAPHENE_RECT_INIT (0, 0, 120, 90), 0.3);
+  plain = gsk_container_node_new (&content, 1);
+  cacheable = gsk_container_node_new_cacheable (content);
+
+  /* The first time is drawn directly, the next ones from the cache */
+  for (i = 0; i < 3; i++)
+    {
+      GdkTexture *expected, *result;
+
+      expected = render (renderer, plain, &viewport);
+      result = render (renderer, cacheable, &viewport);
+      assert_textures_equal (expected, result);
+      g_object_unref (result);
+      g_object_unref (expected);
+    }
+
+  gsk_render_node_unref (cacheable);
+  gsk_render_node_unref (plain);
+  gsk_render_node_unref (content);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+static void
+test_reuse (gconstpointer data)
+{
+  GskRenderer *renderer;
+  GskRenderNode *content, *cacheable;
+  graphene_rect_t viewport = GRAPHENE_RECT_INIT (0, 0, 200, 150);
+  GskGpuImage *image;
+
+  renderer = create_renderer (data);
+  if (renderer == NULL)
+    return;
+
+  content = create_content (&GRAPHENE_RECT_INIT (0, 0, 120, 90), 0.3);
+  cacheable = gsk_container_node_new_cacheable (content);
+
+  /* Nodes that are only drawn once don't get an offscreen */
+  g_object_unref (render (renderer, cacheable, &viewport));
+  g_assert_null (gsk_gpu_cache_peek_node_image (get_cache (renderer), cacheable));
+
+  g_object_unref (render (renderer, cacheable, &viewport));
+  image = gsk_gpu_cache_peek_node_image (get_cache (renderer), cacheable);
+  g_assert_nonnull (image);
+  g_assert_cmpuint (gsk_gpu_image_get_width (image), ==, 120);
+  g_assert_cmpuint (gsk_gpu_image_get_height (image), ==, 90);
+
+  g_object_unref (render (renderer, cacheable, &viewport));
+  g_assert_true (gsk_gpu_cache_peek_node_image (get_cache (renderer), cacheable) == image);
+
+  gsk_render_node_unref (cacheable);
+  gsk_render_node_unref (content);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* Nodes that change every frame are never cached */
+static void
+test_changing (gconstpointer data)
+{
+  GskRenderer *renderer;
+  graphene_rect_t viewport = GRAPHENE_RECT_INIT (0, 0, 200, 150);
+  guint i;
+
+  renderer = create_renderer (data);
+  if (renderer == NULL)
+    return;
+
+  for (i = 0; i < 10; i++)
+    {
+      GskRenderNode *content, *cacheable;
+
+      content = create_content (&GRAPHENE_RECT_INIT (0, 0, 120, 90), i / 10.);
+      cacheable = gsk_container_node_new_cacheable (content);
+
+      g_object_unref (render (renderer, cacheable, &viewport));
+      g_assert_null (gsk_gpu_cache_peek_node_image (get_cache (renderer), cacheable));
+
+      gsk_render_node_unref (cacheable);
+      gsk_render_node_unref (content);
+    }
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+/* Offscreens for nodes that are much larger than the viewport
+ * only cover the area around the visible part */
+static void
+test_large (gconstpointer data)
+{
+  GskRenderer *renderer;
+  GskRenderNode *content, *plain, *cacheable;
+  graphene_rect_t viewport = GRAPHENE_RECT_INIT (0, 0, 200, 150);
+  GskGpuImage *image;
+  guint i;
+
+  renderer = create_renderer (data);
+  if (renderer == NULL)
+    return;
+
+  content = create_content (&GRAPHENE_RECT_INIT (-1000, -1000, 3000, 3000), 0.6);
+  plain = gsk_container_node_new (&content, 1);
+  cacheable = gsk_container_node_new_cacheable (content);
+
+  for (i = 0; i < 3; i++)
+    {
+      GdkTexture *expected, *result;
+
+      expected = render (renderer, plain, &viewport);
+      result = render (renderer, cacheable, &viewport);
+      assert_textures_equal (expected, result);
+      g_object_unref (result);
+      g_object_unref (expected);
+    }
+
+  image = gsk_gpu_cache_peek_node_image (get_cache (renderer), cacheable);
+  g_assert_nonnull (image);
+  g_assert_cmpuint (gsk_gpu_image_get_width (image), <=, 2 * viewport.size.width + 1);
+  g_assert_cmpuint (gsk_gpu_image_get_height (image), <=, 2 * viewport.size.height + 1);
+
+  gsk_render_node_unref (cacheable);
+  gsk_render_node_unref (plain);
+  gsk_render_node_unref (content);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
+static void
+add_test (const RendererInfo *info,
+          const char         *name,
+          GTestDataFunc       func)
+{
+  char *path;
+
+  path = g_strdup_printf ("/cached-node/%s/%s", info->name, name);
+  g_test_add_data_func (path, info, func);
+  g_free (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  guint i;
+
+  (g_test_init) (&argc, &argv, NULL);
+  gtk_init ();
+
+  for (i = 0; i < G_N_ELEMENTS (renderers); i++)
+    {
+      add_test (&renderers[i], "same-rendering", test_same_rendering);
+      add_test (&renderers[i], "reuse", test_reuse);
+      add_test (&renderers[i], "changing", test_changing);
+      add_test (&renderers[i], "large", test_large);
+    }
+
+  return g_test_run ();
+}
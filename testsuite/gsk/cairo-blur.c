@@ -0,0 +1,241 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <math.h>
+#include <string.h>
+
+#include "gsk/gskcairoblurprivate.h"
+
+/* A straightforward copy of the blur as it was before it got
+ * optimized, to check that the result did not change.
+ */
+
+#define GAUSSIAN_SCALE_FACTOR ((3.0 * sqrt(2 * G_PI) / 4))
+
+static void
+reference_blur_xspan (guchar *row,
+                      guchar *tmp_buffer,
+                      int     row_width,
+                      int     d,
+                      int     shift)
+{
+  int offset;
+  int sum = 0;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = -d + offset; i < row_width + offset; i++)
+    {
+      if (i >= 0 && i < row_width)
+        sum += row[i];
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            sum -= row[i - d];
+
+          tmp_buffer[i - offset] = (sum + d / 2) / d;
+        }
+    }
+
+  memcpy (row, tmp_buffer, row_width);
+}
+
+static void
+reference_blur_rows (guchar *buffer,
+                     int     width,
+                     int     height,
+                     int     d)
+{
+  guchar *tmp_buffer;
+  int i;
+
+  tmp_buffer = g_malloc (width);
+
+  for (i = 0; i < height; i++)
+    {
+      guchar *row = buffer + i * width;
+
+      if (d % 2 == 1)
+        {
+          reference_blur_xspan (row, tmp_buffer, width, d, 0);
+          reference_blur_xspan (row, tmp_buffer, width, d, 0);
+          reference_blur_xspan (row, tmp_buffer, width, d, 0);
+        }
+      else
+        {
+          reference_blur_xspan (row, tmp_buffer, width, d, 1);
+          reference_blur_xspan (row, tmp_buffer, width, d, -1);
+          reference_blur_xspan (row, tmp_buffer, width, d + 1, 0);
+        }
+    }
+
+  g_free (tmp_buffer);
+}
+
+static void
+flip_buffer (guchar *dst,
+             guchar *src,
+             int     width,
+             int     height)
+{
+  int i, j;
+
+  for (i = 0; i < width; i++)
+    for (j = 0; j < height; j++)
+      dst[i * height + j] = src[j * width + i];
+}
+
+static void
+reference_blur (guchar       *buffer,
+                int           width,
+                int           height,
+                int           radius,
+                GskBlurFlags  flags)
+{
+  int d = (int) (GAUSSIAN_SCALE_FACTOR * radius);
+  guchar *flipped;
+
+  if (radius <= 1)
+    return;
+
+  flipped = g_malloc (width * height);
+
+  if (flags & GSK_BLUR_Y)
+    {
+      flip_buffer (flipped, buffer, width, height);
+      reference_blur_rows (flipped, height, width, d);
+      flip_buffer (buffer, flipped, height, width);
+    }
+
+  if (flags & GSK_BLUR_X)
+    reference_blur_rows (buffer, width, height, d);
+
+  g_free (flipped);
+}
+
+static cairo_surface_t *
+create_random_surface (int width,
+                       int height)
+{
+  cairo_surface_t *surface;
+  guchar *data;
+  int stride, x, y;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  /* Mostly empty with some solid shapes, like a shadow mask,
+   * plus some noise to catch rounding differences */
+  for (y = 0; y < height; y++)
+    for (x = 0; x < stride; x++)
+      {
+        if (x > width / 4 && x < 3 * width / 4 && y > height / 4 && y < 3 * height / 4)
+          data[y * stride + x] = 255;
+        else
+          data[y * stride + x] = g_test_rand_int_range (0, 16) == 0 ? g_test_rand_int_range (0, 256) : 0;
+      }
+
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static void
+check_blur (int          width,
+            int          height,
+            int          radius,
+            GskBlurFlags flags)
+{
+  cairo_surface_t *surface;
+  guchar *expected;
+  int stride;
+
+  surface = create_random_surface (width, height);
+  stride = cairo_image_surface_get_stride (surface);
+
+  expected = g_memdup2 (cairo_image_surface_get_data (surface), stride * height);
+  reference_blur (expected, stride, height, radius, flags);
+
+  gsk_cairo_blur_surface (surface, radius, flags);
+
+  g_assert_cmpmem (cairo_image_surface_get_data (surface), stride * height,
+                   expected, stride * height);
+
+  g_free (expected);
+  cairo_surface_destroy (surface);
+}
+
+static void
+test_blur_accuracy (void)
+{
+  /* Covers the unrolled sizes, odd and even sizes and
+   * sizes that are too large for the reciprocal */
+  const int radii[] = { 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 20, 33, 100, 136, 137, 300 };
+  const GskBlurFlags flags[] = { GSK_BLUR_X, GSK_BLUR_Y, GSK_BLUR_X | GSK_BLUR_Y };
+  gsize i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (radii); i++)
+    for (j = 0; j < G_N_ELEMENTS (flags); j++)
+      {
+        check_blur (g_test_rand_int_range (1, 300), g_test_rand_int_range (1, 300), radii[i], flags[j]);
+        check_blur (1000, 700, radii[i], flags[j]);
+      }
+}
+
+static void
+test_blur_performance (void)
+{
+  const int radii[] = { 4, 10, 50 };
+  cairo_surface_t *surface;
+  guint n = g_test_perf () ? 50 : 1;
+  gsize i;
+  guint j;
+
+  surface = create_random_surface (2000, 2000);
+
+  for (i = 0; i < G_N_ELEMENTS (radii); i++)
+    {
+      double elapsed;
+
+      g_test_timer_start ();
+
+      for (j = 0; j < n; j++)
+        gsk_cairo_blur_surface (surface, radii[i], GSK_BLUR_X | GSK_BLUR_Y);
+
+      elapsed = g_test_timer_elapsed ();
+      if (g_test_perf ())
+        g_test_minimized_result (elapsed / n, "blurring 2000x2000 with radius %d: %gsec", radii[i], elapsed / n);
+    }
+
+  cairo_surface_destroy (surface);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cairo-blur/accuracy", test_blur_accuracy);
+  g_test_add_func ("/cairo-blur/performance", test_blur_performance);
+
+  return g_test_run ();
+}
@@ -0,0 +1,213 @@
+#include <gtk/gtk.h>
+
+static GdkTexture *
+create_texture (int width,
+                int height)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *data;
+  int x, y;
+
+  data = g_malloc (width * height * 4);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        guchar *pixel = data + (y * width + x) * 4;
+
+        pixel[0] = x * 255 / width;
+        pixel[1] = y * 255 / height;
+        pixel[2] = (x + y) % 2 ? 255 : 0;
+        pixel[3] = 128 + (x * y) % 128;
+      }
+
+  bytes = g_bytes_new_take (data, width * height * 4);
+  texture = gdk_memory_texture_new (width, height, GDK_MEMORY_R8G8B8A8, bytes, width * 4);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+static GskRenderNode *
+create_test_node (gboolean unsafe)
+{
+  GskRenderNode *children[64], *container, *node;
+  GskRoundedRect rounded;
+  GdkTexture *texture;
+  gsize i, n = 0;
+
+  children[n++] = gsk_color_node_new (&(GdkRGBA) { 1, 1, 1, 1 }, &GRAPHENE_RECT_INIT (0, 0, 301, 203));
+
+  for (i = 0; i < 40; i++)
+    {
+      children[n++] = gsk_color_node_new (&(GdkRGBA) { i / 40.f, 0.5, 1 - i / 40.f, 0.7 },
+                                          &GRAPHENE_RECT_INIT ((i * 37) % 280 + 0.5, (i * 23) % 180 + 0.3, 17.7, 13.1));
+    }
+
+  gsk_rounded_rect_init_from_rect (&rounded, &GRAPHENE_RECT_INIT (40, 30, 200, 120), 24);
+  children[n++] = gsk_border_node_new (&rounded,
+                                       (float[4]) { 3, 5, 7, 9 },
+                                       (GdkRGBA[4]) { { 0, 0, 0, 1 }, { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, 0, 1, 0.5 } });
+
+  gsk_rounded_rect_init_from_rect (&rounded, &GRAPHENE_RECT_INIT (100, 70, 120, 90), 30);
+  node = gsk_color_node_new (&(GdkRGBA) { 1, 0.5, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 301, 203));
+  children[n++] = gsk_rounded_clip_node_new (node, &rounded);
+  gsk_render_node_unref (node);
+
+  /* The same texture twice, spread over many tiles */
+  texture = create_texture (37, 23);
+  children[n++] = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (30.5, 20.25, 150, 90));
+  node = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 0, 150, 90));
+  children[n++] = gsk_transform_node_new (node, gsk_transform_translate (NULL, &GRAPHENE_POINT_INIT (140, 100)));
+  gsk_render_node_unref (node);
+  g_object_unref (texture);
+
+  /* These can't be drawn in tiles, so the renderer must not try */
+  if (unsafe)
+    {
+      PangoFontMap *fontmap;
+      PangoContext *context;
+      PangoLayout *layout;
+      PangoLayoutRun *run;
+      GskShadow shadow = { { 0, 0, 0, 0.8 }, 3, 4, 6 };
+      cairo_t *cr;
+
+      fontmap = pango_cairo_font_map_get_default ();
+      context = pango_font_map_create_context (fontmap);
+      layout = pango_layout_new (context);
+      pango_layout_set_text (layout, "Tiled text rendering", -1);
+      run = pango_layout_get_line_readonly (layout, 0)->runs->data;
+
+      node = gsk_text_node_new (run->item->analysis.font,
+                                run->glyphs,
+                                &(GdkRGBA) { 0, 0, 0, 1 },
+                                &GRAPHENE_POINT_INIT (20, 100));
+      children[n++] = gsk_shadow_node_new (node, &shadow, 1);
+      gsk_render_node_unref (node);
+
+      g_object_unref (layout);
+      g_object_unref (context);
+
+      node = gsk_cairo_node_new (&GRAPHENE_RECT_INIT (150, 20, 120, 150));
+      cr = gsk_cairo_node_get_draw_context (node);
+      cairo_set_source_rgba (cr, 0.2, 0.4, 0.6, 0.9);
+      cairo_arc (cr, 210, 95, 60, 0, 2 * G_PI);
+      cairo_fill (cr);
+      cairo_destroy (cr);
+      children[n++] = node;
+
+      gsk_rounded_rect_init_from_rect (&rounded, &GRAPHENE_RECT_INIT (60, 40, 100, 60), 10);
+      children[n++] = gsk_outset_shadow_node_new (&rounded, &(GdkRGBA) { 0, 0, 0, 0.5 }, 2, 3, 4, 12);
+      children[n++] = gsk_inset_shadow_node_new (&rounded, &(GdkRGBA) { 0, 0.5, 0, 0.5 }, 1, 2, 3, 8);
+
+      node = gsk_color_node_new (&(GdkRGBA) { 1, 0, 1, 1 }, &GRAPHENE_RECT_INIT (120, 120, 60, 40));
+      children[n++] = gsk_blur_node_new (node, 10);
+      gsk_render_node_unref (node);
+    }
+
+  g_assert_cmpuint (n, <=, G_N_ELEMENTS (children));
+
+  container = gsk_container_node_new (children, n);
+  for (i = 0; i < n; i++)
+    gsk_render_node_unref (children[i]);
+
+  node = gsk_transform_node_new (container, gsk_transform_scale (NULL, 1.5, 1.5));
+  children[0] = container;
+  children[1] = node;
+  container = gsk_container_node_new (children, 2);
+  gsk_render_node_unref (children[0]);
+  gsk_render_node_unref (children[1]);
+
+  return container;
+}
+
+static GBytes *
+render_node (GskRenderNode         *node,
+             const char            *tile_size,
+             const graphene_rect_t *viewport)
+{
+  GskRenderer *renderer;
+  GdkTextureDownloader *downloader;
+  GdkTexture *texture;
+  GBytes *bytes;
+  gsize stride;
+
+  if (tile_size)
+    g_setenv ("GSK_CAIRO_TILE_SIZE", tile_size, TRUE);
+  else
+    g_unsetenv ("GSK_CAIRO_TILE_SIZE");
+
+  renderer = gsk_cairo_renderer_new ();
+  g_assert_true (gsk_renderer_realize (renderer, NULL, NULL));
+
+  texture = gsk_renderer_render_texture (renderer, node, viewport);
+
+  downloader = gdk_texture_downloader_new (texture);
+  bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+  gdk_texture_downloader_free (downloader);
+
+  g_object_unref (texture);
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+
+  return bytes;
+}
+
+static void
+check_tiles_identical (gboolean unsafe)
+{
+  const char *tile_sizes[] = { "3", "7", "32", "64", "256" };
+  const graphene_rect_t viewports[] = {
+    GRAPHENE_RECT_INIT (0, 0, 460, 310),
+    GRAPHENE_RECT_INIT (-13, 17, 333, 111),
+  };
+  GskRenderNode *node;
+  gsize i, j;
+
+  node = create_test_node (unsafe);
+
+  for (i = 0; i < G_N_ELEMENTS (viewports); i++)
+    {
+      GBytes *expected = render_node (node, NULL, &viewports[i]);
+
+      for (j = 0; j < G_N_ELEMENTS (tile_sizes); j++)
+        {
+          GBytes *tiled = render_node (node, tile_sizes[j], &viewports[i]);
+
+          g_assert_cmpmem (g_bytes_get_data (expected, NULL), g_bytes_get_size (expected),
+                           g_bytes_get_data (tiled, NULL), g_bytes_get_size (tiled));
+
+          g_bytes_unref (tiled);
+        }
+
+      g_bytes_unref (expected);
+    }
+
+  gsk_render_node_unref (node);
+}
+
+static void
+test_tiles_identical (void)
+{
+  check_tiles_identical (FALSE);
+}
+
+/* Text, cairo, shadow and blur nodes are not thread-safe or
+ * depend on the clip, so these must fall back to drawing in one go.
+ */
+static void
+test_tiles_fallback (void)
+{
+  check_tiles_identical (TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cairo/tiles/identical", test_tiles_identical);
+  g_test_add_func ("/cairo/tiles/fallback", test_tiles_fallback);
+
+  return g_test_run ();
+}
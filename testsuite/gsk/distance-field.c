@@ -0,0 +1,226 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include <gtk/gtk.h>
+
+#include "gsk/gpu/gskgpuuploadopprivate.h"
+
+/* Large glyphs are drawn from signed distance fields that are made
+ * from their cairo rendering. These tests check the distance field
+ * against distances computed the slow way.
+ */
+
+#define SPREAD 8
+
+static guint32
+encode_distance (float distance)
+{
+  return CLAMP (255.f * (0.5f - distance / (2 * SPREAD)) + 0.5f, 0.f, 255.f);
+}
+
+static guint32 *
+create_pixels (gsize width,
+               gsize height)
+{
+  return g_new0 (guint32, width * height);
+}
+
+static void
+set_alpha (guint32 *pixels,
+           gsize    width,
+           gsize    x,
+           gsize    y,
+           guint8   alpha)
+{
+  pixels[y * width + x] = alpha * 0x01010101;
+}
+
+static guint8
+get_alpha (guint32 *pixels,
+           gsize    width,
+           gsize    x,
+           gsize    y)
+{
+  return pixels[y * width + x] >> 24;
+}
+
+static void
+make_distance_field (guint32 *pixels,
+                     gsize    width,
+                     gsize    height)
+{
+  gsize i;
+
+  gsk_gpu_make_distance_field ((guchar *) pixels, width * sizeof (guint32), width, height, SPREAD);
+
+  /* All channels hold the distance */
+  for (i = 0; i < width * height; i++)
+    g_assert_cmphex (pixels[i], ==, (pixels[i] & 0xFF) * 0x01010101);
+}
+
+/* For shapes without antialiasing, the distance to the outline is the
+ * distance to the nearest pixel on the other side of it */
+static void
+test_binary (void)
+{
+  const gsize width = 48, height = 40;
+  guint32 *pixels, *field;
+  gsize x, y, qx, qy;
+
+  pixels = create_pixels (width, height);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        gboolean in_disc = (x - 15.f) * (x - 15.f) + (y - 20.f) * (y - 20.f) < 11 * 11;
+        gboolean in_bar = x >= 30 && x < 34 && y >= 4 && y < 36;
+
+        if (in_disc || in_bar)
+          set_alpha (pixels, width, x, y, 255);
+      }
+
+  field = g_memdup2 (pixels, width * height * sizeof (guint32));
+  make_distance_field (field, width, height);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        guint8 alpha = get_alpha (pixels, width, x, y);
+        float nearest = G_MAXFLOAT;
+        float distance;
+
+        for (qy = 0; qy < height; qy++)
+          for (qx = 0; qx < width; qx++)
+            {
+              float dx = (float) qx - x;
+              float dy = (float) qy - y;
+
+              if (get_alpha (pixels, width, qx, qy) != alpha)
+                nearest = MIN (nearest, dx * dx + dy * dy);
+            }
+
+        distance = alpha ? - sqrtf (nearest) : sqrtf (nearest);
+
+        g_assert_cmpint (ABS ((int) (field[y * width + x] & 0xFF) - (int) encode_distance (distance)), <=, 1);
+      }
+
+  g_free (field);
+  g_free (pixels);
+}
+
+/* Antialiased pixels move the outline between pixels */
+static void
+test_coverage (void)
+{
+  const gsize width = 24, height = 4;
+  const guint8 coverage[] = { 255, 192, 128, 64, 0 };
+  guint32 *pixels;
+  gsize x, y, i;
+
+  for (i = 0; i < G_N_ELEMENTS (coverage); i++)
+    {
+      float a = coverage[i] / 255.f;
+
+      /* A vertical edge in column 12 */
+      pixels = create_pixels (width, height);
+      for (y = 0; y < height; y++)
+        {
+          for (x = 0; x < 12; x++)
+            set_alpha (pixels, width, x, y, 255);
+          set_alpha (pixels, width, 12, y, coverage[i]);
+        }
+
+      make_distance_field (pixels, width, height);
+
+      for (y = 0; y < height; y++)
+        {
+          guint32 *row = pixels + y * width;
+
+          /* The outline is where the coverage puts it */
+          if (coverage[i] > 0 && coverage[i] < 255)
+            g_assert_cmpint (ABS ((int) (row[12] & 0xFF) - (int) encode_distance (0.5f - a)), <=, 1);
+
+          /* Inside is above 0.5, outside below */
+          for (x = 0; x < 12; x++)
+            g_assert_cmpuint (row[x] & 0xFF, >, 128);
+          for (x = 13; x < width; x++)
+            g_assert_cmpuint (row[x] & 0xFF, <, 128);
+
+          /* and the distance grows away from the outline, up to
+           * the spread */
+          for (x = 1; x < width; x++)
+            {
+              if ((row[x - 1] & 0xFF) < 255 && (row[x] & 0xFF) > 0)
+                g_assert_cmpuint (row[x - 1] & 0xFF, >, row[x] & 0xFF);
+            }
+        }
+
+      g_free (pixels);
+    }
+}
+
+/* A circle rendered by cairo, like glyph outlines are, gives the
+ * distance to the actual circle within a fraction of a pixel */
+static void
+test_circle (void)
+{
+  const int size = 64;
+  const float cx = 32.4f, cy = 31.7f, radius = 20.3f;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  guint32 *pixels;
+  int x, y, stride;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, size, size);
+  cr = cairo_create (surface);
+  cairo_arc (cr, cx, cy, radius, 0, 2 * G_PI);
+  cairo_fill (cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+
+  stride = cairo_image_surface_get_stride (surface);
+  g_assert_cmpint (stride, ==, size * 4);
+  pixels = (guint32 *) cairo_image_surface_get_data (surface);
+
+  make_distance_field (pixels, size, size);
+
+  for (y = 0; y < size; y++)
+    for (x = 0; x < size; x++)
+      {
+        float dx = x + 0.5f - cx;
+        float dy = y + 0.5f - cy;
+        float distance = sqrtf (dx * dx + dy * dy) - radius;
+
+        /* Within 3/4 of a pixel */
+        g_assert_cmpint (ABS ((int) (pixels[y * size + x] & 0xFF) - (int) encode_distance (distance)),
+                         <=,
+                         255 * 3 / 4 / (2 * SPREAD) + 1);
+      }
+
+  cairo_surface_destroy (surface);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (g_test_init) (&argc, &argv, NULL);
+
+  g_test_add_func ("/distance-field/binary", test_binary);
+  g_test_add_func ("/distance-field/coverage", test_coverage);
+  g_test_add_func ("/distance-field/circle", test_circle);
+
+  return g_test_run ();
+}
@@ -0,0 +1,279 @@
+#include <gtk/gtk.h>
+#include "gsk/gskrendernodebinaryprivate.h"
+
+static void
+count_errors (const GskParseLocation *start,
+              const GskParseLocation *end,
+              const GError           *error,
+              gpointer                user_data)
+{
+  guint *n_errors = user_data;
+
+  (*n_errors)++;
+}
+
+static void
+test_roundtrip (gconstpointer data)
+{
+  GFile *file = (GFile *) data;
+  GskRenderNode *node, *node2;
+  GBytes *bytes, *binary, *text, *text2;
+  GError *error = NULL;
+  guint n_errors = 0;
+
+  bytes = g_file_load_bytes (file, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  node = gsk_render_node_deserialize (bytes, NULL, NULL);
+  g_bytes_unref (bytes);
+  if (node == NULL)
+    {
+      g_test_skip ("file does not contain a node");
+      return;
+    }
+
+  binary = gsk_render_node_serialize_binary (node);
+  g_assert_true (gsk_render_node_is_binary (binary));
+
+  node2 = gsk_render_node_deserialize (binary, count_errors, &n_errors);
+  g_assert_cmpuint (n_errors, ==, 0);
+  g_assert_nonnull (node2);
+
+  text = gsk_render_node_serialize (node);
+  text2 = gsk_render_node_serialize (node2);
+  g_assert_cmpstr (g_bytes_get_data (text, NULL), ==, g_bytes_get_data (text2, NULL));
+
+  g_bytes_unref (text2);
+  g_bytes_unref (text);
+  gsk_render_node_unref (node2);
+  g_bytes_unref (binary);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_shared_nodes (void)
+{
+  GskRenderNode *color, *container, *node;
+  GskRenderNode *children[3];
+  GBytes *binary;
+
+  color = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+  children[0] = color;
+  children[1] = gsk_opacity_node_new (color, 0.5);
+  children[2] = color;
+  container = gsk_container_node_new (children, 3);
+
+  binary = gsk_render_node_serialize_binary (container);
+  node = gsk_render_node_deserialize (binary, NULL, NULL);
+  g_assert_nonnull (node);
+
+  /* The color node is only stored once */
+  g_assert_true (gsk_container_node_get_child (node, 0) == gsk_container_node_get_child (node, 2));
+  g_assert_true (gsk_container_node_get_child (node, 0) ==
+                 gsk_opacity_node_get_child (gsk_container_node_get_child (node, 1)));
+
+  gsk_render_node_unref (node);
+  g_bytes_unref (binary);
+  gsk_render_node_unref (container);
+  gsk_render_node_unref (children[1]);
+  gsk_render_node_unref (color);
+}
+
+static void
+test_truncated (void)
+{
+  GskRenderNode *children[2], *node;
+  GskPathBuilder *builder;
+  GskPath *path;
+  GBytes *binary, *truncated;
+  gsize i, size;
+
+  builder = gsk_path_builder_new ();
+  gsk_path_builder_add_circle (builder, &GRAPHENE_POINT_INIT (5, 5), 5);
+  path = gsk_path_builder_free_to_path (builder);
+
+  children[0] = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+  children[1] = gsk_fill_node_new (children[0], path, GSK_FILL_RULE_WINDING);
+  node = gsk_container_node_new (children, 2);
+
+  binary = gsk_render_node_serialize_binary (node);
+  size = g_bytes_get_size (binary);
+
+  for (i = 0; i < size; i += 4)
+    {
+      GskRenderNode *result;
+      guint n_errors = 0;
+
+      truncated = g_bytes_new_from_bytes (binary, 0, i);
+      result = gsk_render_node_deserialize_binary (truncated, count_errors, &n_errors);
+      g_assert_null (result);
+      g_assert_cmpuint (n_errors, ==, 1);
+      g_bytes_unref (truncated);
+    }
+
+  g_bytes_unref (binary);
+  gsk_render_node_unref (node);
+  gsk_render_node_unref (children[1]);
+  gsk_render_node_unref (children[0]);
+  gsk_path_unref (path);
+}
+
+static GskRenderNode *
+create_frame (GskRenderNode *shared,
+              float          red)
+{
+  GskRenderNode *children[2], *frame;
+  guint n_children = 0;
+
+  if (shared)
+    children[n_children++] = gsk_render_node_ref (shared);
+  children[n_children++] = gsk_color_node_new (&(GdkRGBA) { red, 0, 0, 1 }, &GRAPHENE_RECT_INIT (20, 0, 10, 10));
+  frame = gsk_container_node_new (children, n_children);
+
+  while (n_children-- > 0)
+    gsk_render_node_unref (children[n_children]);
+
+  return frame;
+}
+
+static void
+assert_nodes_equal (GskRenderNode *node1,
+                    GskRenderNode *node2)
+{
+  GBytes *text1, *text2;
+
+  text1 = gsk_render_node_serialize (node1);
+  text2 = gsk_render_node_serialize (node2);
+  g_assert_cmpstr (g_bytes_get_data (text1, NULL), ==, g_bytes_get_data (text2, NULL));
+  g_bytes_unref (text2);
+  g_bytes_unref (text1);
+}
+
+/* Writes a sequence of frames that share a subtree and reads it back */
+static void
+test_stream_roundtrip (void)
+{
+  static const guchar pixels[] = { 0xff, 0x00, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff,
+                                   0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+  GskRenderNodeBinaryWriter *writer;
+  GskRenderNodeBinaryReader *reader, *late_reader;
+  GskRenderNode *children[3], *shared, *frames[4], *read[4];
+  GskPathBuilder *builder;
+  GdkTexture *texture;
+  GBytes *bytes, *data[4];
+  GError *error = NULL;
+  GskPath *path;
+  guint i;
+
+  bytes = g_bytes_new_static (pixels, sizeof (pixels));
+  texture = gdk_memory_texture_new (2, 2, GDK_MEMORY_R8G8B8A8, bytes, 8);
+  g_bytes_unref (bytes);
+
+  builder = gsk_path_builder_new ();
+  gsk_path_builder_add_circle (builder, &GRAPHENE_POINT_INIT (5, 5), 5);
+  path = gsk_path_builder_free_to_path (builder);
+
+  children[0] = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+  children[1] = gsk_color_node_new (&(GdkRGBA) { 0, 0, 1, 1 }, &GRAPHENE_RECT_INIT (0, 10, 10, 10));
+  children[2] = gsk_fill_node_new (children[1], path, GSK_FILL_RULE_WINDING);
+  shared = gsk_container_node_new (children, 3);
+
+  /* The shared subtree is dropped in the third frame, so the
+   * fourth one needs to write it again */
+  frames[0] = create_frame (shared, 0.25);
+  frames[1] = create_frame (shared, 0.5);
+  frames[2] = create_frame (NULL, 0.75);
+  frames[3] = create_frame (shared, 1.0);
+
+  writer = gsk_render_node_binary_writer_new ();
+  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+    data[i] = gsk_render_node_binary_writer_write (writer, frames[i]);
+  gsk_render_node_binary_writer_free (writer);
+
+  /* Unchanged subtrees are only referenced */
+  g_assert_cmpuint (g_bytes_get_size (data[1]), <, g_bytes_get_size (data[0]));
+  g_assert_cmpuint (g_bytes_get_size (data[3]), >, g_bytes_get_size (data[2]));
+
+  reader = gsk_render_node_binary_reader_new ();
+  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+    {
+      read[i] = gsk_render_node_binary_reader_read (reader, data[i], &error);
+      g_assert_no_error (error);
+      g_assert_nonnull (read[i]);
+      assert_nodes_equal (frames[i], read[i]);
+    }
+  gsk_render_node_binary_reader_free (reader);
+
+  /* Shared subtrees are shared after reading, too */
+  g_assert_true (gsk_container_node_get_child (read[0], 0) == gsk_container_node_get_child (read[1], 0));
+  g_assert_true (gsk_container_node_get_child (read[1], 0) != gsk_container_node_get_child (read[3], 0));
+
+  /* Frames can't be read without the ones before them */
+  late_reader = gsk_render_node_binary_reader_new ();
+  g_assert_null (gsk_render_node_binary_reader_read (late_reader, data[1], &error));
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+  gsk_render_node_binary_reader_free (late_reader);
+
+  for (i = 0; i < G_N_ELEMENTS (frames); i++)
+    {
+      gsk_render_node_unref (read[i]);
+      g_bytes_unref (data[i]);
+      gsk_render_node_unref (frames[i]);
+    }
+  gsk_render_node_unref (shared);
+  for (i = 0; i < G_N_ELEMENTS (children); i++)
+    gsk_render_node_unref (children[i]);
+  gsk_path_unref (path);
+  g_object_unref (texture);
+}
+
+static void
+add_roundtrip_tests (void)
+{
+  GFileEnumerator *enumerator;
+  GFileInfo *info;
+  GFile *dir;
+  GError *error = NULL;
+
+  dir = g_file_new_for_path (g_test_get_filename (G_TEST_DIST, "nodeparser", NULL));
+  enumerator = g_file_enumerate_children (dir, G_FILE_ATTRIBUTE_STANDARD_NAME, 0, NULL, &error);
+  g_assert_no_error (error);
+
+  while ((info = g_file_enumerator_next_file (enumerator, NULL, &error)))
+    {
+      const char *filename = g_file_info_get_name (info);
+
+      if (g_str_has_suffix (filename, ".node") &&
+          !g_str_has_suffix (filename, ".ref.node"))
+        {
+          char *test_name = g_strconcat ("/serialize-binary/roundtrip/", filename, NULL);
+
+          g_test_add_data_func_full (test_name,
+                                     g_file_get_child (dir, filename),
+                                     test_roundtrip,
+                                     g_object_unref);
+          g_free (test_name);
+        }
+
+      g_object_unref (info);
+    }
+
+  g_assert_no_error (error);
+  g_object_unref (enumerator);
+  g_object_unref (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (g_test_init) (&argc, &argv, NULL);
+  gtk_init ();
+
+  g_test_add_func ("/serialize-binary/shared-nodes", test_shared_nodes);
+  g_test_add_func ("/serialize-binary/truncated", test_truncated);
+  g_test_add_func ("/serialize-binary/stream", test_stream_roundtrip);
+  add_roundtrip_tests ();
+
+  return g_test_run ();
+}
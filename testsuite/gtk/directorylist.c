@@ -0,0 +1,300 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+typedef struct {
+  GPtrArray *expected; /* relative paths of the files in the tree */
+  char *path;
+  GFile *root;
+} Tree;
+
+static void
+tree_add_file (Tree       *tree,
+               const char *relative_path)
+{
+  GError *error = NULL;
+  char *path;
+
+  path = g_build_filename (tree->path, relative_path, NULL);
+  g_file_set_contents (path, "", 0, &error);
+  g_assert_no_error (error);
+  g_free (path);
+
+  g_ptr_array_add (tree->expected, g_strdup (relative_path));
+}
+
+static void
+tree_add_directory (Tree       *tree,
+                    const char *relative_path)
+{
+  char *path;
+
+  path = g_build_filename (tree->path, relative_path, NULL);
+  g_assert_cmpint (g_mkdir (path, 0755), ==, 0);
+  g_free (path);
+
+  g_ptr_array_add (tree->expected, g_strdup (relative_path));
+}
+
+static Tree *
+tree_new (void)
+{
+  GError *error = NULL;
+  Tree *tree;
+
+  tree = g_new0 (Tree, 1);
+  tree->expected = g_ptr_array_new_with_free_func (g_free);
+  tree->path = g_dir_make_tmp ("gtk-directorylist-XXXXXX", &error);
+  g_assert_no_error (error);
+  tree->root = g_file_new_for_path (tree->path);
+
+  return tree;
+}
+
+static gboolean
+remove_recursively (GFile *file)
+{
+  GFileEnumerator *enumerator;
+  GFileInfo *info;
+  GFile *child;
+
+  enumerator = g_file_enumerate_children (file, "standard::name,standard::type",
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          NULL, NULL);
+  if (enumerator)
+    {
+      while (g_file_enumerator_iterate (enumerator, &info, &child, NULL, NULL) && info)
+        {
+          if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+            remove_recursively (child);
+          else
+            g_file_delete (child, NULL, NULL);
+        }
+      g_object_unref (enumerator);
+    }
+
+  return g_file_delete (file, NULL, NULL);
+}
+
+static void
+tree_free (Tree *tree)
+{
+  g_assert_true (remove_recursively (tree->root));
+  g_object_unref (tree->root);
+  g_free (tree->path);
+  g_ptr_array_unref (tree->expected);
+  g_free (tree);
+}
+
+static int
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static void
+wait_for_loading (GtkDirectoryList *list)
+{
+  while (gtk_directory_list_is_loading (list))
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_no_error (gtk_directory_list_get_error (list));
+}
+
+static void
+assert_list_matches_tree (GtkDirectoryList *list,
+                          Tree             *tree)
+{
+  GPtrArray *found;
+  guint i;
+
+  found = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; i < g_list_model_get_n_items (G_LIST_MODEL (list)); i++)
+    {
+      GFileInfo *info = g_list_model_get_item (G_LIST_MODEL (list), i);
+      GFile *file = G_FILE (g_file_info_get_attribute_object (info, "standard::file"));
+
+      g_ptr_array_add (found, g_file_get_relative_path (tree->root, file));
+      g_object_unref (info);
+    }
+
+  g_ptr_array_sort (found, compare_strings);
+  g_ptr_array_sort (tree->expected, compare_strings);
+
+  g_assert_cmpuint (found->len, ==, tree->expected->len);
+  for (i = 0; i < found->len; i++)
+    g_assert_cmpstr (g_ptr_array_index (found, i), ==, g_ptr_array_index (tree->expected, i));
+
+  g_ptr_array_unref (found);
+}
+
+typedef struct {
+  guint n_changed;
+  guint n_items;
+} Changes;
+
+/* Loading only ever appends items */
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  Changes    *changes)
+{
+  g_assert_cmpuint (position, ==, changes->n_items);
+  g_assert_cmpuint (removed, ==, 0);
+  g_assert_cmpuint (added, >, 0);
+
+  changes->n_changed++;
+  changes->n_items += added;
+  g_assert_cmpuint (changes->n_items, ==, g_list_model_get_n_items (model));
+}
+
+static void
+test_recursive (void)
+{
+  GtkDirectoryList *list;
+  Tree *tree;
+  GFile *link;
+  char *path;
+
+  tree = tree_new ();
+  tree_add_file (tree, "file");
+  tree_add_directory (tree, "a");
+  tree_add_file (tree, "a/1");
+  tree_add_file (tree, "a/2");
+  tree_add_directory (tree, "a/empty");
+  tree_add_directory (tree, "b");
+  tree_add_directory (tree, "b/c");
+  tree_add_directory (tree, "b/c/d");
+  tree_add_file (tree, "b/c/d/3");
+
+  /* Symlinks to directories are listed, but not followed */
+  path = g_build_filename (tree->path, "b", "link", NULL);
+  link = g_file_new_for_path (path);
+  if (g_file_make_symbolic_link (link, "../a", NULL, NULL))
+    g_ptr_array_add (tree->expected, g_strdup ("b/link"));
+  g_object_unref (link);
+  g_free (path);
+
+  list = gtk_directory_list_new ("standard::name", tree->root);
+  g_assert_false (gtk_directory_list_get_recursive (list));
+  wait_for_loading (list);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (list)), ==, 3);
+
+  /* Changing the property reloads */
+  gtk_directory_list_set_recursive (list, TRUE);
+  g_assert_true (gtk_directory_list_is_loading (list));
+  wait_for_loading (list);
+  assert_list_matches_tree (list, tree);
+
+  gtk_directory_list_set_recursive (list, FALSE);
+  wait_for_loading (list);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (list)), ==, 3);
+
+  g_object_unref (list);
+  tree_free (tree);
+}
+
+#define N_FILES 1000
+#define N_DIRECTORIES 50
+
+/* Files that are loaded together are announced together */
+static void
+test_coalesce (void)
+{
+  GtkDirectoryList *list;
+  Changes changes = { 0, };
+  Tree *tree;
+  guint i;
+
+  tree = tree_new ();
+  for (i = 0; i < N_FILES; i++)
+    {
+      char *name = g_strdup_printf ("file%u", i);
+      tree_add_file (tree, name);
+      g_free (name);
+    }
+
+  list = gtk_directory_list_new ("standard::name", NULL);
+  g_signal_connect (list, "items-changed", G_CALLBACK (items_changed_cb), &changes);
+  gtk_directory_list_set_file (list, tree->root);
+  wait_for_loading (list);
+
+  assert_list_matches_tree (list, tree);
+  g_assert_cmpuint (changes.n_items, ==, N_FILES);
+  /* Each query returns at least 100 files */
+  g_assert_cmpuint (changes.n_changed, <=, N_FILES / 100);
+
+  g_object_unref (list);
+  tree_free (tree);
+}
+
+static void
+test_coalesce_recursive (void)
+{
+  GtkDirectoryList *list;
+  Changes changes = { 0, };
+  Tree *tree;
+  guint i, j;
+
+  tree = tree_new ();
+  for (i = 0; i < N_DIRECTORIES; i++)
+    {
+      char *name = g_strdup_printf ("dir%u", i);
+      tree_add_directory (tree, name);
+      g_free (name);
+
+      for (j = 0; j < 5; j++)
+        {
+          name = g_strdup_printf ("dir%u/file%u", i, j);
+          tree_add_file (tree, name);
+          g_free (name);
+        }
+    }
+
+  list = gtk_directory_list_new ("standard::name", NULL);
+  gtk_directory_list_set_recursive (list, TRUE);
+  g_signal_connect (list, "items-changed", G_CALLBACK (items_changed_cb), &changes);
+  gtk_directory_list_set_file (list, tree->root);
+  wait_for_loading (list);
+
+  assert_list_matches_tree (list, tree);
+  g_assert_cmpuint (changes.n_items, ==, tree->expected->len);
+  /* Never more than one announcement per directory */
+  g_assert_cmpuint (changes.n_changed, <=, N_DIRECTORIES + 1);
+
+  g_object_unref (list);
+  tree_free (tree);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (g_test_init) (&argc, &argv, NULL);
+  setlocale (LC_ALL, "C");
+
+  g_test_add_func ("/directorylist/recursive", test_recursive);
+  g_test_add_func ("/directorylist/coalesce", test_coalesce);
+  g_test_add_func ("/directorylist/coalesce-recursive", test_coalesce_recursive);
+
+  return g_test_run ();
+}
@@ -18,6 +18,7 @@
  */
 
 #include <locale.h>
+#include <string.h>
 
 #include <gtk/gtk.h>
 
@@ -561,6 +562,100 @@ test_sections (void)
   g_object_unref (sorted);
 }
 
+static void
+inc_counter (gpointer data)
+{
+  guint *counter = data;
+
+  *counter += 1;
+}
+
+static guint
+count_matches (guint       n,
+               const char *search)
+{
+  guint i, result = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      char *s = g_strdup_printf ("Item %u", i);
+      if (strstr (s, search))
+        result++;
+      g_free (s);
+    }
+
+  return result;
+}
+
+static void
+check_matches (GListModel *model,
+               const char *search)
+{
+  guint i;
+
+  for (i = 0; i < g_list_model_get_n_items (model); i++)
+    {
+      GtkStringObject *item = g_list_model_get_item (model, i);
+      g_assert_nonnull (strstr (gtk_string_object_get_string (item), search));
+      g_object_unref (item);
+    }
+}
+
+static void
+test_parallel (void)
+{
+  const guint n = 50000;
+  GtkFilterListModel *model;
+  GtkStringFilter *filter;
+  GtkStringList *list;
+  GtkFilter *every;
+  guint i, n_changes;
+
+  list = gtk_string_list_new (NULL);
+  for (i = 0; i < n; i++)
+    {
+      char *s = g_strdup_printf ("Item %u", i);
+      gtk_string_list_take (list, s);
+    }
+
+  filter = gtk_string_filter_new (gtk_property_expression_new (GTK_TYPE_STRING_OBJECT, NULL, "string"));
+  every = GTK_FILTER (gtk_every_filter_new ());
+  gtk_multi_filter_append (GTK_MULTI_FILTER (every), g_object_ref (GTK_FILTER (filter)));
+  model = gtk_filter_list_model_new (G_LIST_MODEL (list), every);
+
+  gtk_string_filter_set_search (filter, "7");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, count_matches (n, "7"));
+  check_matches (G_LIST_MODEL (model), "7");
+
+  gtk_string_filter_set_search (filter, "77");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, count_matches (n, "77"));
+  check_matches (G_LIST_MODEL (model), "77");
+
+  gtk_filter_list_model_set_incremental (model, TRUE);
+  n_changes = 0;
+  g_signal_connect_swapped (model, "items-changed", G_CALLBACK (inc_counter), &n_changes);
+
+  gtk_string_filter_set_search (filter, "1");
+  while (gtk_filter_list_model_get_pending (model) > 0)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, count_matches (n, "1"));
+  check_matches (G_LIST_MODEL (model), "1");
+  /* the items are matched at once */
+  g_assert_cmpuint (n_changes, ==, 2);
+
+  /* Adding items while filtering */
+  gtk_string_filter_set_search (filter, "Item 2");
+  gtk_string_list_splice (list, 0, 1, (const char *[]) { "Item 2", NULL });
+  while (gtk_filter_list_model_get_pending (model) > 0)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, count_matches (n, "Item 2") + 1);
+  check_matches (G_LIST_MODEL (model), "Item 2");
+
+  g_object_unref (model);
+  g_object_unref (filter);
+  g_object_unref (list);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -577,6 +672,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/filterlistmodel/empty", test_empty);
   g_test_add_func ("/filterlistmodel/add_remove_item", test_add_remove_item);
   g_test_add_func ("/filterlistmodel/sections", test_sections);
+  g_test_add_func ("/filterlistmodel/parallel", test_parallel);
 
   return g_test_run ();
 }
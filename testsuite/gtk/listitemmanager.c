@@ -322,9 +322,13 @@ prepare_simple (GtkWidget   *widget,
 {
 }
 
+static guint n_created_items;
+
 static GtkListItemBase *
 create_simple_item (GtkWidget *widget)
 {
+  n_created_items++;
+
   return g_object_new (GTK_TYPE_LIST_ITEM_BASE, NULL);
 }
 
@@ -378,6 +382,61 @@ test_create_with_items (void)
   gtk_window_destroy (GTK_WINDOW (widget));
 }
 
+static void
+test_pool (void)
+{
+  GListModel *source;
+  GtkNoSelection *selection;
+  GtkListItemManager *items;
+  GtkListItemTracker *tracker;
+  GtkWidget *widget;
+
+  widget = gtk_window_new ();
+  items = gtk_list_item_manager_new (widget,
+                                     split_simple,
+                                     create_simple_item,
+                                     prepare_simple,
+                                     create_simple_header);
+  g_object_set_data_full (G_OBJECT (widget), "the-items", items, g_object_unref);
+  tracker = gtk_list_item_tracker_new (items);
+
+  n_created_items = 0;
+  source = create_source_model (20, 50);
+  selection = gtk_no_selection_new (source);
+  gtk_list_item_manager_set_model (items, GTK_SELECTION_MODEL (selection));
+  gtk_list_item_tracker_set_position (items, tracker, 0, 0, 9);
+  check_list_item_manager (items, widget, &tracker, 1);
+  g_assert_cmpuint (n_created_items, ==, 10);
+  g_object_unref (selection);
+
+  /* Replacing the model reuses the widgets */
+  source = create_source_model (20, 50);
+  selection = gtk_no_selection_new (source);
+  gtk_list_item_manager_set_model (items, GTK_SELECTION_MODEL (selection));
+  gtk_list_item_tracker_set_position (items, tracker, 0, 0, 9);
+  check_list_item_manager (items, widget, &tracker, 1);
+  g_assert_cmpuint (n_created_items, ==, 10);
+
+  /* So does moving the tracker far away */
+  gtk_list_item_tracker_set_position (items, tracker, 19, 9, 0);
+  check_list_item_manager (items, widget, &tracker, 1);
+  gtk_list_item_tracker_set_position (items, tracker, 0, 0, 9);
+  check_list_item_manager (items, widget, &tracker, 1);
+  g_assert_cmpuint (n_created_items, ==, 10);
+
+  /* but not once the pool is gone */
+  gtk_list_item_manager_set_model (items, NULL);
+  gtk_list_item_manager_clear_pool (items);
+  gtk_list_item_manager_set_model (items, GTK_SELECTION_MODEL (selection));
+  gtk_list_item_tracker_set_position (items, tracker, 0, 0, 9);
+  check_list_item_manager (items, widget, &tracker, 1);
+  g_assert_cmpuint (n_created_items, ==, 20);
+
+  gtk_list_item_tracker_free (items, tracker);
+  g_object_unref (selection);
+  gtk_window_destroy (GTK_WINDOW (widget));
+}
+
 #define N_TRACKERS 3
 #define N_WIDGETS_PER_TRACKER 10
 #define N_RUNS 500
@@ -560,6 +619,7 @@ main (int argc, char *argv[])
 
   g_test_add_func ("/listitemmanager/create", test_create);
   g_test_add_func ("/listitemmanager/create_with_items", test_create_with_items);
+  g_test_add_func ("/listitemmanager/pool", test_pool);
   g_test_add_func ("/listitemmanager/exhaustive", test_exhaustive);
 
   return g_test_run ();
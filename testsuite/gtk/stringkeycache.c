@@ -0,0 +1,257 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+
+#include <gtk/gtk.h>
+
+#include "gtk/gtkstringkeycacheprivate.h"
+
+/* Returns the size of a cache with a single key of @kind for "a" */
+static gsize
+get_entry_size (GtkStringKeyKind kind)
+{
+  GtkStringKeyCache *cache;
+  GtkStringKey *key;
+  gsize size;
+
+  cache = gtk_string_key_cache_new (G_MAXSIZE);
+  gtk_string_key_cache_lookup (cache, "a", kind, &key);
+  size = gtk_string_key_cache_get_size (cache);
+  gtk_string_key_unref (key);
+  gtk_string_key_cache_unref (cache);
+
+  return size;
+}
+
+static void
+test_hit (void)
+{
+  GtkStringKeyCache *cache;
+  GtkStringKey *key1, *key2, *key3, *key4;
+  const char *s1, *s2, *s3, *s4;
+  gsize size;
+
+  cache = gtk_string_key_cache_new (G_MAXSIZE);
+
+  s1 = gtk_string_key_cache_lookup (cache, "Hello", GTK_STRING_KEY_CASEFOLD, &key1);
+  g_assert_cmpstr (s1, ==, "hello");
+  size = gtk_string_key_cache_get_size (cache);
+
+  /* The same string gives the same key */
+  s2 = gtk_string_key_cache_lookup (cache, "Hello", GTK_STRING_KEY_CASEFOLD, &key2);
+  g_assert_true (s1 == s2);
+  g_assert_true (key1 == key2);
+  g_assert_cmpuint (gtk_string_key_cache_get_size (cache), ==, size);
+
+  /* Other kinds of keys are kept with the string */
+  s3 = gtk_string_key_cache_lookup (cache, "Hello", GTK_STRING_KEY_NORMALIZE_CASEFOLD, &key3);
+  g_assert_cmpstr (s3, ==, "hello");
+  g_assert_true (s3 != s1);
+  g_assert_true (key3 == key1);
+  g_assert_cmpuint (gtk_string_key_cache_get_size (cache), >, size);
+
+  /* Different strings don't share keys, even if the keys are equal */
+  s4 = gtk_string_key_cache_lookup (cache, "hello", GTK_STRING_KEY_CASEFOLD, &key4);
+  g_assert_cmpstr (s4, ==, s1);
+  g_assert_true (s4 != s1);
+  g_assert_true (key4 != key1);
+
+  g_assert_null (gtk_string_key_cache_lookup (cache, NULL, GTK_STRING_KEY_CASEFOLD, &key4));
+  g_assert_null (key4);
+
+  gtk_string_key_unref (key3);
+  gtk_string_key_unref (key2);
+  gtk_string_key_unref (key1);
+  gtk_string_key_cache_unref (cache);
+}
+
+static void
+test_eviction (void)
+{
+  GtkStringKeyCache *cache;
+  GtkStringKey *first, *recent, *key, *again;
+  const char *first_string, *recent_string, *s;
+  gsize max_size;
+  guint i;
+
+  max_size = 4096;
+  cache = gtk_string_key_cache_new (max_size);
+
+  first_string = gtk_string_key_cache_lookup (cache, "First", GTK_STRING_KEY_COLLATE_CASEFOLD, &first);
+  recent_string = gtk_string_key_cache_lookup (cache, "Recent", GTK_STRING_KEY_COLLATE_CASEFOLD, &recent);
+
+  for (i = 0; i < 1000; i++)
+    {
+      char *string = g_strdup_printf ("String %u", i);
+
+      gtk_string_key_cache_lookup (cache, string, GTK_STRING_KEY_COLLATE_CASEFOLD, &key);
+      gtk_string_key_unref (key);
+      g_free (string);
+
+      g_assert_cmpuint (gtk_string_key_cache_get_size (cache), <=, max_size);
+
+      /* Recently used keys are kept */
+      s = gtk_string_key_cache_lookup (cache, "Recent", GTK_STRING_KEY_COLLATE_CASEFOLD, &key);
+      g_assert_true (s == recent_string);
+      g_assert_true (key == recent);
+      gtk_string_key_unref (key);
+    }
+
+  /* Keys that are still referenced stay valid after the cache
+   * dropped them */
+  s = gtk_string_key_cache_lookup (cache, "First", GTK_STRING_KEY_COLLATE_CASEFOLD, &again);
+  g_assert_true (again != first);
+  g_assert_cmpstr (s, ==, first_string);
+
+  gtk_string_key_unref (again);
+  gtk_string_key_unref (recent);
+  gtk_string_key_unref (first);
+
+  /* Keys can outlive the cache */
+  s = gtk_string_key_cache_lookup (cache, "Last", GTK_STRING_KEY_CASEFOLD, &key);
+  gtk_string_key_cache_unref (cache);
+  g_assert_cmpstr (s, ==, "last");
+  gtk_string_key_unref (key);
+}
+
+/* Fills a cache with room for 3 keys with a, b and c, drops c
+ * and adds d, which makes the cache drop one key */
+static GtkStringKeyCache *
+fill_cache (GtkStringKey **keys,
+            gboolean       release)
+{
+  GtkStringKeyCache *cache;
+  const char *strings[] = { "a", "b", "c", "d" };
+  guint i;
+
+  cache = gtk_string_key_cache_new (3 * get_entry_size (GTK_STRING_KEY_NONE));
+
+  for (i = 0; i < 3; i++)
+    gtk_string_key_cache_lookup (cache, strings[i], GTK_STRING_KEY_NONE, &keys[i]);
+
+  if (release)
+    gtk_string_key_release (keys[2]);
+  else
+    gtk_string_key_unref (keys[2]);
+  keys[2] = NULL;
+
+  gtk_string_key_cache_lookup (cache, strings[3], GTK_STRING_KEY_NONE, &keys[3]);
+
+  return cache;
+}
+
+static gboolean
+is_cached (GtkStringKeyCache *cache,
+           const char        *string,
+           GtkStringKey      *held)
+{
+  GtkStringKey *key;
+
+  /* As held is referenced, a new key can't have the same address */
+  gtk_string_key_cache_lookup (cache, string, GTK_STRING_KEY_NONE, &key);
+  gtk_string_key_unref (key);
+
+  return key == held;
+}
+
+static void
+test_invalidation (void)
+{
+  GtkStringKeyCache *cache;
+  GtkStringKey *keys[4];
+
+  /* Without releasing, the least recently used key goes */
+  cache = fill_cache (keys, FALSE);
+  g_assert_false (is_cached (cache, "a", keys[0]));
+  gtk_string_key_unref (keys[0]);
+  gtk_string_key_unref (keys[1]);
+  gtk_string_key_unref (keys[3]);
+  gtk_string_key_cache_unref (cache);
+
+  /* Keys of items that went away go first */
+  cache = fill_cache (keys, TRUE);
+  g_assert_true (is_cached (cache, "a", keys[0]));
+  g_assert_true (is_cached (cache, "b", keys[1]));
+  g_assert_true (is_cached (cache, "d", keys[3]));
+  g_assert_cmpuint (gtk_string_key_cache_get_size (cache), ==, 3 * get_entry_size (GTK_STRING_KEY_NONE));
+  gtk_string_key_unref (keys[0]);
+  gtk_string_key_unref (keys[1]);
+  gtk_string_key_unref (keys[3]);
+  gtk_string_key_cache_unref (cache);
+}
+
+static char *
+get_folded (GListModel *model,
+            guint       position)
+{
+  GtkStringObject *item;
+  char *result;
+
+  item = g_list_model_get_item (model, position);
+  result = g_utf8_casefold (gtk_string_object_get_string (item), -1);
+  g_object_unref (item);
+
+  return result;
+}
+
+/* Removing items from a sorted model releases their keys,
+ * and sorting keeps working with the keys of the new items */
+static void
+test_sort_list_model (void)
+{
+  GtkStringList *list;
+  GtkSortListModel *model;
+  GtkSorter *sorter;
+  char *prev, *folded;
+  guint i;
+
+  list = gtk_string_list_new ((const char *[]) { "c", "B", "a", "D", NULL });
+  sorter = GTK_SORTER (gtk_string_sorter_new (gtk_property_expression_new (GTK_TYPE_STRING_OBJECT, NULL, "string")));
+  model = gtk_sort_list_model_new (G_LIST_MODEL (g_object_ref (list)), sorter);
+
+  gtk_string_list_remove (list, 2);
+  gtk_string_list_splice (list, 0, 1, (const char *[]) { "e", "A", NULL });
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 4);
+
+  prev = get_folded (G_LIST_MODEL (model), 0);
+  g_assert_cmpstr (prev, ==, "a");
+  for (i = 1; i < g_list_model_get_n_items (G_LIST_MODEL (model)); i++)
+    {
+      folded = get_folded (G_LIST_MODEL (model), i);
+      g_assert_cmpint (g_utf8_collate (prev, folded), <=, 0);
+      g_free (prev);
+      prev = folded;
+    }
+  g_assert_cmpstr (prev, ==, "e");
+  g_free (prev);
+
+  g_object_unref (model);
+  g_object_unref (list);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (g_test_init) (&argc, &argv, NULL);
+  setlocale (LC_ALL, "C");
+
+  g_test_add_func ("/stringkeycache/hit", test_hit);
+  g_test_add_func ("/stringkeycache/eviction", test_eviction);
+  g_test_add_func ("/stringkeycache/invalidation", test_invalidation);
+  g_test_add_func ("/stringkeycache/sort-list-model", test_sort_list_model);
+
+  return g_test_run ();
+}
@@ -1921,6 +1921,149 @@ test_serialize_wrap_mode (void)
   g_assert_finalize_object (buffer);
 }
 
+static void
+search_done (GObject      *source,
+             GAsyncResult *result,
+             gpointer      data)
+{
+  GArray *offsets = data;
+  GError *error = NULL;
+  int *matches;
+  gsize n_matches;
+  int done = -1;
+
+  g_assert_true (gtk_text_buffer_search_finish (GTK_TEXT_BUFFER (source), result,
+                                                &matches, &n_matches, &error));
+  g_assert_no_error (error);
+
+  g_array_append_vals (offsets, matches, n_matches);
+  g_array_append_val (offsets, done);
+  g_free (matches);
+}
+
+static void
+check_search (GtkTextBuffer      *buffer,
+              const char         *str,
+              GtkTextSearchFlags  flags)
+{
+  GArray *offsets, *expected;
+  GtkTextIter iter, match_start, match_end;
+
+  expected = g_array_new (FALSE, FALSE, sizeof (int));
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  while (gtk_text_iter_forward_search (&iter, str, flags, &match_start, &match_end, NULL))
+    {
+      int start = gtk_text_iter_get_offset (&match_start);
+      int end = gtk_text_iter_get_offset (&match_end);
+
+      g_array_append_val (expected, start);
+      g_array_append_val (expected, end);
+      iter = match_end;
+    }
+
+  offsets = g_array_new (FALSE, FALSE, sizeof (int));
+  gtk_text_buffer_search_async (buffer, str, flags, NULL, search_done, offsets);
+  while (offsets->len == 0 || g_array_index (offsets, int, offsets->len - 1) != -1)
+    g_main_context_iteration (NULL, TRUE);
+  g_array_set_size (offsets, offsets->len - 1);
+
+  g_assert_cmpmem (offsets->data, offsets->len * sizeof (int),
+                   expected->data, expected->len * sizeof (int));
+
+  g_array_unref (offsets);
+  g_array_unref (expected);
+}
+
+static void
+test_search_async (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter start, end;
+  GdkPaintable *paintable;
+  GString *text;
+  int i;
+
+  buffer = gtk_text_buffer_new (NULL);
+
+  /* Enough lines for the index to use several chunks */
+  text = g_string_new (NULL);
+  for (i = 0; i < 2000; i++)
+    g_string_append_printf (text, "Line %d of the Text, with some WÖRDS\n", i);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  check_search (buffer, "text", 0);
+  check_search (buffer, "Text", 0);
+  check_search (buffer, "text", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "wörds", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "1999 of", 0);
+  check_search (buffer, "WÖRDS\nLine 10", 0);
+  check_search (buffer, "not there", 0);
+
+  /* Edits must be picked up by the next search */
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 1000);
+  gtk_text_buffer_insert (buffer, &start, "more text\nand another line\n", -1);
+  check_search (buffer, "text", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "another", 0);
+
+  paintable = gdk_paintable_new_empty (10, 10);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &start, 10, 4);
+  gtk_text_buffer_insert_paintable (buffer, &start, paintable);
+  g_object_unref (paintable);
+  check_search (buffer, "Line 10 of", GTK_TEXT_SEARCH_TEXT_ONLY);
+  check_search (buffer, "Line 10 of", 0);
+
+  /* Join lines across chunks */
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &start, 300, 10);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 700, 10);
+  gtk_text_buffer_delete (buffer, &start, &end);
+  check_search (buffer, "Line 30", 0);
+  check_search (buffer, "the text", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+
+  gtk_text_buffer_set_text (buffer, "", -1);
+  check_search (buffer, "Line", 0);
+
+  g_object_unref (buffer);
+}
+
+/* Case insensitive searches must fold the text the same way
+ * gtk_text_iter_forward_search() does
+ */
+static void
+test_search_async_folding (void)
+{
+  GtkTextBuffer *buffer;
+  GString *text;
+  int i;
+
+  buffer = gtk_text_buffer_new (NULL);
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 500; i++)
+    g_string_append (text,
+                     "The \357\254\201nal final FINAL, "        /* U+FB01 LATIN SMALL LIGATURE FI */
+                     "\357\274\246\357\274\265\357\274\254\357\274\254 full, " /* FULLWIDTH FULL */
+                     "\357\275\201 a A, "                       /* U+FF41 FULLWIDTH LATIN SMALL LETTER A */
+                     "Stra\303\237e STRASSE, "                   /* U+00DF LATIN SMALL LETTER SHARP S */
+                     "caf\303\251 cafe\314\201 CAF\303\211\n"); /* composed and decomposed e acute */
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  check_search (buffer, "\357\254\201nal", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "final", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "FINAL", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "\357\274\246\357\274\265\357\274\254\357\274\254", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "full", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "\357\275\201", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "a,", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "stra\303\237e", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "strasse", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "caf\303\251", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+  check_search (buffer, "cafe\314\201", GTK_TEXT_SEARCH_CASE_INSENSITIVE);
+
+  g_object_unref (buffer);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -1949,6 +2092,8 @@ main (int argc, char** argv)
   g_test_add_func ("/TextBuffer/Undo 4", test_undo4);
   g_test_add_func ("/TextBuffer/Undo 5", test_undo5);
   g_test_add_func ("/TextBuffer/Serialize wrap-mode", test_serialize_wrap_mode);
+  g_test_add_func ("/TextBuffer/Search async", test_search_async);
+  g_test_add_func ("/TextBuffer/Search async folding", test_search_async_folding);
 
   return g_test_run();
 }
@@ -0,0 +1,278 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "gtk/gtktextlayoutprivate.h"
+
+/* Layouts that validate in the background measure batches of lines
+ * in a thread. These tests check that they end up with the same line
+ * sizes as layouts that validate on the main thread.
+ */
+
+#define N_LINES 4000
+
+static const char *words[] = {
+  "lorem", "ipsum", "dolor", "sit", "amet", "Grüße", "ﬁnal", "日本語",
+  "עברית", "العربية", "\t", "consectetur", "adipiscing", "elit",
+};
+
+static GtkTextBuffer *
+create_buffer (void)
+{
+  GtkTextBuffer *buffer;
+  GString *text;
+  GRand *rand;
+  guint i, j, n_words;
+
+  rand = g_rand_new_with_seed (42);
+  text = g_string_new (NULL);
+
+  for (i = 0; i < N_LINES; i++)
+    {
+      /* Mostly short lines, and some that wrap a lot */
+      n_words = g_rand_int_range (rand, 0, 10);
+      if (i % 17 == 0)
+        n_words *= 20;
+
+      for (j = 0; j < n_words; j++)
+        {
+          if (j > 0)
+            g_string_append_c (text, ' ');
+          g_string_append (text, words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))]);
+        }
+      g_string_append_c (text, '\n');
+    }
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+
+  g_string_free (text, TRUE);
+  g_rand_free (rand);
+
+  return buffer;
+}
+
+static GtkTextLayout *
+create_layout (GtkTextBuffer *buffer,
+               PangoFontMap  *font_map)
+{
+  GtkTextLayout *layout;
+  GtkTextAttributes *style;
+  PangoContext *ltr_context, *rtl_context;
+
+  layout = gtk_text_layout_new ();
+  gtk_text_layout_set_buffer (layout, buffer);
+
+  ltr_context = pango_font_map_create_context (font_map);
+  rtl_context = pango_font_map_create_context (font_map);
+  pango_context_set_base_dir (ltr_context, PANGO_DIRECTION_LTR);
+  pango_context_set_base_dir (rtl_context, PANGO_DIRECTION_RTL);
+  gtk_text_layout_set_contexts (layout, ltr_context, rtl_context);
+  g_object_unref (ltr_context);
+  g_object_unref (rtl_context);
+
+  style = gtk_text_attributes_new ();
+  style->font = pango_font_description_from_string ("Sans 11");
+  style->wrap_mode = GTK_WRAP_WORD_CHAR;
+  style->pixels_below_lines = 2;
+  gtk_text_layout_set_default_style (layout, style);
+  gtk_text_attributes_unref (style);
+
+  gtk_text_layout_set_screen_width (layout, 300);
+
+  return layout;
+}
+
+static void
+changed_cb (GtkTextLayout *layout,
+            int            y,
+            int            old_height,
+            int            new_height,
+            gpointer       data)
+{
+  guint *n_changed = data;
+
+  (*n_changed)++;
+}
+
+static void
+wait_for_valid (GtkTextLayout *layout)
+{
+  gint64 end_time;
+
+  end_time = g_get_monotonic_time () + 30 * G_TIME_SPAN_SECOND;
+
+  gtk_text_layout_validate (layout, 2000);
+
+  while (!gtk_text_layout_is_valid (layout))
+    {
+      g_assert_cmpint (g_get_monotonic_time (), <, end_time);
+      g_main_context_iteration (NULL, TRUE);
+    }
+}
+
+static void
+assert_layouts_equal (GtkTextLayout *layout1,
+                      GtkTextLayout *layout2)
+{
+  GtkTextIter iter1, iter2;
+  int width1, height1, width2, height2;
+  int y1, y2;
+
+  gtk_text_layout_get_size (layout1, &width1, &height1);
+  gtk_text_layout_get_size (layout2, &width2, &height2);
+  g_assert_cmpint (width1, ==, width2);
+  g_assert_cmpint (height1, ==, height2);
+
+  gtk_text_buffer_get_start_iter (layout1->buffer, &iter1);
+  gtk_text_buffer_get_start_iter (layout2->buffer, &iter2);
+
+  do
+    {
+      g_assert_cmpint (gtk_text_iter_get_line (&iter1), ==, gtk_text_iter_get_line (&iter2));
+
+      gtk_text_layout_get_line_yrange (layout1, &iter1, &y1, &height1);
+      gtk_text_layout_get_line_yrange (layout2, &iter2, &y2, &height2);
+      g_assert_cmpint (y1, ==, y2);
+      g_assert_cmpint (height1, ==, height2);
+    }
+  while (gtk_text_iter_forward_line (&iter1) &&
+         gtk_text_iter_forward_line (&iter2));
+}
+
+static void
+test_background_sizes (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *sync, *async;
+  guint n_changed = 0;
+
+  buffer = create_buffer ();
+
+  sync = create_layout (buffer, pango_cairo_font_map_get_default ());
+  gtk_text_layout_validate (sync, G_MAXINT);
+  g_assert_true (gtk_text_layout_is_valid (sync));
+
+  async = create_layout (buffer, pango_cairo_font_map_get_default ());
+  g_signal_connect (async, "changed", G_CALLBACK (changed_cb), &n_changed);
+  gtk_text_layout_set_validate_in_background (async, TRUE);
+  g_assert_true (gtk_text_layout_get_validate_in_background (async));
+
+  /* Starts a job and returns right away */
+  gtk_text_layout_validate (async, G_MAXINT);
+  g_assert_false (gtk_text_layout_is_valid (async));
+
+  wait_for_valid (async);
+  g_assert_cmpuint (n_changed, >, 1);
+
+  assert_layouts_equal (sync, async);
+
+  g_object_unref (async);
+  g_object_unref (sync);
+  g_object_unref (buffer);
+}
+
+/* Batches that are measured while the buffer changes are dropped */
+static void
+test_background_edit (void)
+{
+  GtkTextBuffer *buffer, *sync_buffer;
+  GtkTextLayout *sync, *async;
+  GtkTextIter start, end;
+  char *text;
+  guint i;
+
+  buffer = create_buffer ();
+  async = create_layout (buffer, pango_cairo_font_map_get_default ());
+  gtk_text_layout_set_validate_in_background (async, TRUE);
+  gtk_text_layout_validate (async, 2000);
+
+  for (i = 0; i < 20; i++)
+    {
+      gtk_text_buffer_get_iter_at_line (buffer, &start, (i * 997) % N_LINES);
+      if (i % 2)
+        {
+          gtk_text_buffer_insert (buffer, &start, "inserted text that is long enough to wrap at least once\n", -1);
+        }
+      else
+        {
+          end = start;
+          gtk_text_iter_forward_lines (&end, 3);
+          gtk_text_buffer_delete (buffer, &start, &end);
+        }
+
+      g_main_context_iteration (NULL, FALSE);
+    }
+
+  wait_for_valid (async);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+  sync_buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (sync_buffer, text, -1);
+  sync = create_layout (sync_buffer, pango_cairo_font_map_get_default ());
+  gtk_text_layout_validate (sync, G_MAXINT);
+
+  assert_layouts_equal (sync, async);
+
+  g_object_unref (sync);
+  g_object_unref (sync_buffer);
+  g_free (text);
+  g_object_unref (async);
+  g_object_unref (buffer);
+}
+
+/* Custom font maps can't be used in a thread, so those layouts
+ * validate on the main thread */
+static void
+test_background_custom_font_map (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *sync, *async;
+  PangoFontMap *font_map;
+
+  buffer = create_buffer ();
+  font_map = pango_cairo_font_map_new ();
+
+  sync = create_layout (buffer, font_map);
+  gtk_text_layout_validate (sync, G_MAXINT);
+
+  async = create_layout (buffer, font_map);
+  gtk_text_layout_set_validate_in_background (async, TRUE);
+  g_assert_false (gtk_text_layout_get_validate_in_background (async));
+
+  gtk_text_layout_validate (async, G_MAXINT);
+  g_assert_true (gtk_text_layout_is_valid (async));
+
+  assert_layouts_equal (sync, async);
+
+  g_object_unref (async);
+  g_object_unref (sync);
+  g_object_unref (font_map);
+  g_object_unref (buffer);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/textlayout/background/sizes", test_background_sizes);
+  g_test_add_func ("/textlayout/background/edit", test_background_edit);
+  g_test_add_func ("/textlayout/background/custom-font-map", test_background_custom_font_map);
+
+  return g_test_run ();
+}
@@ -238,6 +238,118 @@ test_steps (void)
   g_free (a);
 }
 
+typedef struct
+{
+  int key;
+  guint index;
+} StableItem;
+
+static int
+compare_stable_item (gconstpointer a,
+                     gconstpointer b,
+                     gpointer      unused)
+{
+  const StableItem *ia = a;
+  const StableItem *ib = b;
+
+  return ia->key < ib->key ? -1 : (ia->key > ib->key);
+}
+
+static void
+run_parallel_comparison (gpointer         a,
+                         gsize            n,
+                         gsize            element_size,
+                         GCompareDataFunc compare_func)
+{
+  gint64 start, mid, end;
+  guint progress = 0;
+  gpointer b;
+
+  b = g_memdup2 (a, element_size * n);
+
+  start = g_get_monotonic_time ();
+  g_assert_true (gtk_tim_sort_parallel (a, n, element_size, compare_func, NULL, NULL, &progress));
+  mid = g_get_monotonic_time ();
+  gtk_tim_sort (b, n, element_size, compare_func, NULL);
+  end = g_get_monotonic_time ();
+
+  g_test_message ("%zu items in %uus vs %uus (%u%%)",
+                  n,
+                  (guint) (mid - start),
+                  (guint) (end - mid),
+                  (guint) (100 * (mid - start) / MAX (1, end - mid)));
+  g_assert_cmpmem (a, element_size * n, b, element_size * n);
+  g_assert_cmpuint (progress, ==, gtk_tim_sort_parallel_get_n_steps (n));
+
+  g_free (b);
+}
+
+static void
+test_parallel_sizes (void)
+{
+  /* Around the sizes of runs and merges */
+  const gsize sizes[] = { 0, 1, 2, 8191, 8192, 8193, 16383, 16384, 16385,
+                          3 * 8192 + 17, 5 * 8192, 7 * 8192 + 1 };
+  int *a;
+  gsize i, s;
+
+  for (s = 0; s < G_N_ELEMENTS (sizes); s++)
+    {
+      a = g_new (int, MAX (sizes[s], 1));
+      for (i = 0; i < sizes[s]; i++)
+        a[i] = g_test_rand_int ();
+
+      run_parallel_comparison (a, sizes[s], sizeof (int), compare_int);
+
+      g_free (a);
+    }
+}
+
+static void
+test_parallel_huge (void)
+{
+  int *a;
+  gsize i, n;
+
+  n = g_test_rand_int_range (2 * 1000 * 1000, 5 * 1000 * 1000);
+
+  a = g_new (int, n);
+  for (i = 0; i < n; i++)
+    a[i] = g_test_rand_int ();
+
+  run_parallel_comparison (a, n, sizeof (int), compare_int);
+
+  g_free (a);
+}
+
+static void
+test_parallel_stable (void)
+{
+  StableItem *a;
+  gsize i, n;
+
+  n = g_test_rand_int_range (200 * 1000, 1000 * 1000);
+
+  /* Few keys, so that merges see lots of equal elements */
+  a = g_new (StableItem, n);
+  for (i = 0; i < n; i++)
+    {
+      a[i].key = g_test_rand_int_range (0, 100);
+      a[i].index = i;
+    }
+
+  run_parallel_comparison (a, n, sizeof (StableItem), compare_stable_item);
+
+  for (i = 1; i < n; i++)
+    {
+      g_assert_cmpint (a[i - 1].key, <=, a[i].key);
+      if (a[i - 1].key == a[i].key)
+        g_assert_cmpuint (a[i - 1].index, <, a[i].index);
+    }
+
+  g_free (a);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -250,6 +362,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/timsort/pointers", test_pointers);
   g_test_add_func ("/timsort/pointers/huge", test_pointers_huge);
   g_test_add_func ("/timsort/steps", test_steps);
+  g_test_add_func ("/timsort/parallel/sizes", test_parallel_sizes);
+  g_test_add_func ("/timsort/parallel/huge", test_parallel_huge);
+  g_test_add_func ("/timsort/parallel/stable", test_parallel_stable);
 
   return g_test_run ();
 }
@@ -22,6 +22,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
+
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
 
 #include <glib/gi18n-lib.h>
 #include <glib/gprintf.h>
@@ -29,58 +34,619 @@
 #include <gtk/gtk.h>
 #include "gtk-rendernode-tool.h"
 
+typedef enum {
+  PHASE_RENDER,
+  PHASE_DOWNLOAD,
+  PHASE_TOTAL,
+  N_PHASES
+} Phase;
+
+static const char *phase_names[N_PHASES] = {
+  "render",
+  "download",
+  "total",
+};
+
+typedef enum {
+  FORMAT_TEXT,
+  FORMAT_CSV,
+  FORMAT_JSON,
+} Format;
+
+typedef struct
+{
+  gint64 min;
+  gint64 median;
+  gint64 p95;
+  gint64 p99;
+  double mean;
+  double stddev;
+} Stats;
+
+typedef struct
+{
+  char *file;
+  char *renderer;
+  guint runs;
+  gboolean valid[N_PHASES];
+  Stats stats[N_PHASES];
+} Result;
+
+static void
+result_free (gpointer data)
+{
+  Result *result = data;
+
+  g_free (result->file);
+  g_free (result->renderer);
+  g_free (result);
+}
+
+static int
+compare_durations (gconstpointer a,
+                   gconstpointer b)
+{
+  gint64 da = *(const gint64 *) a;
+  gint64 db = *(const gint64 *) b;
+
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+/* nearest-rank percentile of sorted values */
+static gint64
+percentile (const gint64 *values,
+            guint         n_values,
+            guint         percent)
+{
+  guint rank = (n_values * percent + 99) / 100;
+
+  return values[MAX (rank, 1) - 1];
+}
+
+static void
+compute_stats (gint64 *durations,
+               guint   n_durations,
+               Stats  *stats)
+{
+  double sum, sum_sq;
+  guint i;
+
+  qsort (durations, n_durations, sizeof (gint64), compare_durations);
+
+  sum = 0;
+  for (i = 0; i < n_durations; i++)
+    sum += durations[i];
+
+  stats->mean = sum / n_durations;
+
+  sum_sq = 0;
+  for (i = 0; i < n_durations; i++)
+    sum_sq += (durations[i] - stats->mean) * (durations[i] - stats->mean);
+
+  stats->stddev = n_durations > 1 ? sqrt (sum_sq / (n_durations - 1)) : 0;
+  stats->min = durations[0];
+  stats->median = percentile (durations, n_durations, 50);
+  stats->p95 = percentile (durations, n_durations, 95);
+  stats->p99 = percentile (durations, n_durations, 99);
+}
+
 static void
-benchmark_node (GskRenderNode *node,
+download_texture (GdkTexture *texture)
+{
+  GdkTextureDownloader *downloader;
+  GBytes *bytes;
+  gsize stride;
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, gdk_texture_get_format (texture));
+  gdk_texture_downloader_set_color_state (downloader, gdk_texture_get_color_state (texture));
+  bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+  g_bytes_unref (bytes);
+  gdk_texture_downloader_free (downloader);
+}
+
+static Result *
+benchmark_node (const char    *filename,
+                GskRenderNode *node,
                 const char    *renderer_name,
+                guint          warmup,
                 guint          runs,
                 gboolean       download)
 {
   GError *error = NULL;
   GskRenderer *renderer;
-  guint i;
+  gint64 *durations[N_PHASES];
+  Result *result;
+  guint i, p;
 
   renderer = create_renderer (renderer_name, &error);
   if (renderer == NULL)
     {
       g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderer_name, error->message);
       g_clear_error (&error);
-      return;
+      return NULL;
     }
 
-  for (i = 0; i < runs; i++)
+  for (p = 0; p < N_PHASES; p++)
+    durations[p] = g_new (gint64, runs);
+
+  /* The first runs fill glyph, texture and shader caches, so they are
+   * not representative of the steady state of an application.
+   */
+  for (i = 0; i < warmup + runs; i++)
     {
       GdkTexture *texture;
-      gint64 start_time, end_time, duration;
+      gint64 start_time, render_time, end_time;
 
       start_time = g_get_monotonic_time ();
 
+      /* This includes processing the nodes, uploading and submitting
+       * the commands, but not waiting for the GPU to finish.
+       */
       texture = gsk_renderer_render_texture (renderer, node, NULL);
+
+      render_time = g_get_monotonic_time ();
+
       if (download)
-        {
-          GdkTextureDownloader *downloader;
-          GBytes *bytes;
-          gsize stride;
-
-          downloader = gdk_texture_downloader_new (texture);
-          gdk_texture_downloader_set_format (downloader, gdk_texture_get_format (texture));
-          gdk_texture_downloader_set_color_state (downloader, gdk_texture_get_color_state (texture));
-          bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
-          g_bytes_unref (bytes);
-          gdk_texture_downloader_free (downloader);
-        }
+        download_texture (texture);
 
       end_time = g_get_monotonic_time ();
 
-      duration = end_time - start_time;
-      g_print ("%s\t%lld.%03ds\n",
-               renderer_name,
-               (long long) duration / G_USEC_PER_SEC,
-               (int) ((duration * 1000 / G_USEC_PER_SEC) % 1000)); 
       g_object_unref (texture);
+
+      if (i < warmup)
+        continue;
+
+      durations[PHASE_RENDER][i - warmup] = render_time - start_time;
+      durations[PHASE_DOWNLOAD][i - warmup] = end_time - render_time;
+      durations[PHASE_TOTAL][i - warmup] = end_time - start_time;
     }
 
   gsk_renderer_unrealize (renderer);
   g_object_unref (renderer);
+
+  result = g_new0 (Result, 1);
+  result->file = g_strdup (filename);
+  result->renderer = g_strdup (renderer_name);
+  result->runs = runs;
+
+  for (p = 0; p < N_PHASES; p++)
+    {
+      result->valid[p] = p != PHASE_DOWNLOAD || download;
+      if (result->valid[p])
+        compute_stats (durations[p], runs, &result->stats[p]);
+      g_free (durations[p]);
+    }
+
+  return result;
+}
+
+static Result *
+benchmark_deserialize (const char *filename,
+                       guint       warmup,
+                       guint       runs)
+{
+  GBytes *bytes;
+  gint64 *durations;
+  Result *result;
+  guint i;
+
+  bytes = load_file_bytes (filename);
+  durations = g_new (gint64, runs);
+
+  for (i = 0; i < warmup + runs; i++)
+    {
+      GskRenderNode *node;
+      gint64 start_time, end_time;
+
+      start_time = g_get_monotonic_time ();
+
+      node = gsk_render_node_deserialize (bytes, NULL, NULL);
+
+      end_time = g_get_monotonic_time ();
+
+      g_clear_pointer (&node, gsk_render_node_unref);
+
+      if (i >= warmup)
+        durations[i - warmup] = end_time - start_time;
+    }
+
+  result = g_new0 (Result, 1);
+  result->file = g_strdup (filename);
+  result->renderer = g_strdup ("deserialize");
+  result->runs = runs;
+  result->valid[PHASE_TOTAL] = TRUE;
+  compute_stats (durations, runs, &result->stats[PHASE_TOTAL]);
+
+  g_free (durations);
+  g_bytes_unref (bytes);
+
+  return result;
+}
+
+static gsize
+get_peak_memory (void)
+{
+#ifdef G_OS_UNIX
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return (gsize) usage.ru_maxrss * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+static void
+print_duration (GString *string,
+                double   usec)
+{
+  g_string_append_printf (string, "%.3fms", usec / 1000.);
+}
+
+static void
+print_text (GPtrArray *results,
+            gsize      peak_memory)
+{
+  GString *string = g_string_new (NULL);
+  guint i, p;
+
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+
+      if (i == 0 || strcmp (result->file, ((Result *) g_ptr_array_index (results, i - 1))->file) != 0)
+        g_string_append_printf (string, "%s\n", result->file);
+
+      for (p = 0; p < N_PHASES; p++)
+        {
+          const Stats *stats = &result->stats[p];
+
+          if (!result->valid[p])
+            continue;
+
+          g_string_append_printf (string, "  %-12s %-9s min ", result->renderer, phase_names[p]);
+          print_duration (string, stats->min);
+          g_string_append (string, " median ");
+          print_duration (string, stats->median);
+          g_string_append (string, " p95 ");
+          print_duration (string, stats->p95);
+          g_string_append (string, " p99 ");
+          print_duration (string, stats->p99);
+          g_string_append (string, " stddev ");
+          print_duration (string, stats->stddev);
+          g_string_append_c (string, '\n');
+        }
+    }
+
+  if (peak_memory)
+    {
+      char *size = g_format_size (peak_memory);
+      g_string_append_printf (string, "%s %s\n", _("Peak memory:"), size);
+      g_free (size);
+    }
+
+  g_print ("%s", string->str);
+  g_string_free (string, TRUE);
+}
+
+#define CSV_HEADER "file,renderer,phase,runs,min,median,p95,p99,mean,stddev"
+
+/* Quotes fields as described in RFC 4180 */
+static void
+append_csv_field (GString    *string,
+                  const char *s)
+{
+  if (strpbrk (s, ",\"\r\n") == NULL)
+    {
+      g_string_append (string, s);
+      return;
+    }
+
+  g_string_append_c (string, '"');
+  for (; *s; s++)
+    {
+      if (*s == '"')
+        g_string_append_c (string, '"');
+      g_string_append_c (string, *s);
+    }
+  g_string_append_c (string, '"');
+}
+
+/* Parses the record at *data and moves *data to the next one.
+ * Returns NULL at the end of the data.
+ */
+static char **
+parse_csv_record (const char **data)
+{
+  const char *s = *data;
+  GPtrArray *fields;
+  GString *field;
+
+  if (*s == '\0')
+    return NULL;
+
+  fields = g_ptr_array_new ();
+  field = g_string_new (NULL);
+
+  while (TRUE)
+    {
+      if (*s == '"')
+        {
+          for (s++; *s; s++)
+            {
+              if (*s == '"')
+                {
+                  if (s[1] != '"')
+                    {
+                      s++;
+                      break;
+                    }
+                  s++;
+                }
+              g_string_append_c (field, *s);
+            }
+        }
+
+      for (; *s && *s != ',' && *s != '\n'; s++)
+        {
+          if (*s != '\r')
+            g_string_append_c (field, *s);
+        }
+
+      g_ptr_array_add (fields, g_string_free (field, FALSE));
+
+      if (*s != ',')
+        break;
+
+      s++;
+      field = g_string_new (NULL);
+    }
+
+  if (*s == '\n')
+    s++;
+  *data = s;
+
+  g_ptr_array_add (fields, NULL);
+
+  return (char **) g_ptr_array_free (fields, FALSE);
+}
+
+/* Machine-readable output must not depend on the locale */
+static void
+append_double (GString *string,
+               double   value)
+{
+  char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append (string, g_ascii_formatd (buf, sizeof (buf), "%.1f", value));
+}
+
+static void
+print_csv (GPtrArray *results)
+{
+  GString *string = g_string_new (CSV_HEADER "\n");
+  guint i, p;
+
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+
+      for (p = 0; p < N_PHASES; p++)
+        {
+          const Stats *stats = &result->stats[p];
+
+          if (!result->valid[p])
+            continue;
+
+          append_csv_field (string, result->file);
+          g_string_append_c (string, ',');
+          append_csv_field (string, result->renderer);
+          g_string_append_printf (string,
+                                  ",%s,%u,%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",",
+                                  phase_names[p], result->runs,
+                                  stats->min, stats->median, stats->p95, stats->p99);
+          append_double (string, stats->mean);
+          g_string_append_c (string, ',');
+          append_double (string, stats->stddev);
+          g_string_append_c (string, '\n');
+        }
+    }
+
+  g_print ("%s", string->str);
+  g_string_free (string, TRUE);
+}
+
+static void
+append_json_string (GString    *string,
+                    const char *s)
+{
+  g_string_append_c (string, '"');
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_printf (string, "\\%c", *s);
+      else if ((guchar) *s < 0x20)
+        g_string_append_printf (string, "\\u%04x", *s);
+      else
+        g_string_append_c (string, *s);
+    }
+  g_string_append_c (string, '"');
+}
+
+static void
+print_json (GPtrArray *results,
+            gsize      peak_memory)
+{
+  GString *string = g_string_new ("{\n  \"results\": [");
+  guint i, p;
+
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+      gboolean first = TRUE;
+
+      g_string_append (string, i > 0 ? ",\n    { \"file\": " : "\n    { \"file\": ");
+      append_json_string (string, result->file);
+      g_string_append (string, ", \"renderer\": ");
+      append_json_string (string, result->renderer);
+      g_string_append_printf (string, ", \"runs\": %u,\n      \"phases\": {", result->runs);
+
+      for (p = 0; p < N_PHASES; p++)
+        {
+          const Stats *stats = &result->stats[p];
+
+          if (!result->valid[p])
+            continue;
+
+          g_string_append_printf (string,
+                                  "%s\n        \"%s\": { \"min\": %" G_GINT64_FORMAT ", \"median\": %" G_GINT64_FORMAT ", "
+                                  "\"p95\": %" G_GINT64_FORMAT ", \"p99\": %" G_GINT64_FORMAT ", "
+                                  "\"mean\": ",
+                                  first ? "" : ",",
+                                  phase_names[p],
+                                  stats->min, stats->median, stats->p95, stats->p99);
+          append_double (string, stats->mean);
+          g_string_append (string, ", \"stddev\": ");
+          append_double (string, stats->stddev);
+          g_string_append (string, " }");
+          first = FALSE;
+        }
+
+      g_string_append (string, "\n      }\n    }");
+    }
+
+  g_string_append_printf (string, "\n  ],\n  \"peak-memory\": %" G_GSIZE_FORMAT "\n}\n", peak_memory);
+
+  g_print ("%s", string->str);
+  g_string_free (string, TRUE);
+}
+
+/* Loads the median total times from a CSV file written by a
+ * previous run, keyed by "file,renderer".
+ */
+static GHashTable *
+load_baseline (const char *filename)
+{
+  GHashTable *baseline;
+  GError *error = NULL;
+  const char *data;
+  char *contents, *header;
+  char **fields;
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      g_printerr (_("Failed to load baseline: %s\n"), error->message);
+      exit (1);
+    }
+
+  data = contents;
+  fields = parse_csv_record (&data);
+  header = fields ? g_strjoinv (",", fields) : NULL;
+  if (header == NULL || !g_str_equal (header, CSV_HEADER))
+    {
+      g_printerr (_("%s is not a benchmark result in CSV format\n"), filename);
+      exit (1);
+    }
+  g_free (header);
+  g_strfreev (fields);
+
+  baseline = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  while ((fields = parse_csv_record (&data)))
+    {
+      if (g_strv_length (fields) == 10 && g_str_equal (fields[2], "total"))
+        {
+          gint64 *median = g_new (gint64, 1);
+
+          *median = g_ascii_strtoll (fields[5], NULL, 10);
+          g_hash_table_insert (baseline, g_strconcat (fields[0], ",", fields[1], NULL), median);
+        }
+
+      g_strfreev (fields);
+    }
+
+  g_free (contents);
+
+  return baseline;
+}
+
+static gboolean
+check_regression (const char *what,
+                  const char *reference,
+                  gint64      old_median,
+                  gint64      new_median,
+                  double      threshold)
+{
+  double change;
+
+  if (old_median <= 0)
+    return FALSE;
+
+  change = 100. * (new_median - old_median) / old_median;
+  if (change <= threshold)
+    return FALSE;
+
+  g_printerr (_("Regression: %s is %.1f%% slower than %s (%.3fms vs %.3fms)\n"),
+              what, change, reference,
+              new_median / 1000., old_median / 1000.);
+
+  return TRUE;
+}
+
+/* Compares against a previous run, or the second renderer against
+ * the first one. Returns the number of regressions.
+ */
+static guint
+compare_results (GPtrArray  *results,
+                 GHashTable *baseline,
+                 double      threshold)
+{
+  guint i, regressions = 0;
+
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+      char *what = g_strconcat (result->file, ",", result->renderer, NULL);
+
+      if (baseline)
+        {
+          gint64 *median = g_hash_table_lookup (baseline, what);
+
+          if (median &&
+              check_regression (what, _("baseline"), *median, result->stats[PHASE_TOTAL].median, threshold))
+            regressions++;
+        }
+      else if (i + 1 < results->len)
+        {
+          Result *other = g_ptr_array_index (results, i + 1);
+
+          if (!g_str_equal (result->file, other->file))
+            {
+              g_free (what);
+              continue;
+            }
+
+          g_free (what);
+          what = g_strconcat (other->file, ",", other->renderer, NULL);
+          if (check_regression (what, result->renderer,
+                                result->stats[PHASE_TOTAL].median,
+                                other->stats[PHASE_TOTAL].median,
+                                threshold))
+            regressions++;
+          i++;
+        }
+
+      g_free (what);
+    }
+
+  return regressions;
 }
 
 void
@@ -90,18 +656,33 @@ do_benchmark (int          *argc,
   GOptionContext *context;
   char **filenames = NULL;
   char **renderers = NULL;
+  char *format_name = NULL;
+  char *baseline_file = NULL;
   gboolean nodownload = FALSE;
+  gboolean deserialize = FALSE;
+  gboolean compare = FALSE;
+  double threshold = 10;
   int runs = 3;
+  int warmup = 1;
   const GOptionEntry entries[] = {
     { "renderer", 0, 0, G_OPTION_ARG_STRING_ARRAY, &renderers, N_("Add renderer to benchmark"), N_("RENDERER") },
     { "runs", 0, 0, G_OPTION_ARG_INT, &runs, N_("Number of runs with each renderer"), N_("RUNS") },
+    { "warmup", 0, 0, G_OPTION_ARG_INT, &warmup, N_("Number of runs to do before measuring"), N_("RUNS") },
     { "no-download", 0, 0, G_OPTION_ARG_NONE, &nodownload, N_("Don’t download result/wait for GPU to finish"), NULL },
+    { "deserialize", 0, 0, G_OPTION_ARG_NONE, &deserialize, N_("Benchmark loading the file instead of rendering"), NULL },
+    { "format", 0, 0, G_OPTION_ARG_STRING, &format_name, N_("Output format (text, csv or json)"), N_("FORMAT") },
+    { "compare", 0, 0, G_OPTION_ARG_NONE, &compare, N_("Compare two renderers"), NULL },
+    { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &baseline_file, N_("Compare with results saved in CSV format"), N_("FILE") },
+    { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &threshold, N_("Percentage of slowdown to report as regression"), N_("PERCENT") },
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE…") },
     { NULL, }
   };
-  GskRenderNode *node;
+  GHashTable *baseline = NULL;
+  GPtrArray *results;
+  Format format;
   GError *error = NULL;
-  gsize i;
+  gsize i, j;
+  guint regressions = 0;
 
   if (gdk_display_get_default () == NULL)
     {
@@ -113,7 +694,7 @@ do_benchmark (int          *argc,
   context = g_option_context_new (NULL);
   g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
   g_option_context_add_main_entries (context, entries, NULL);
-  g_option_context_set_summary (context, _("Benchmark rendering of a .node file."));
+  g_option_context_set_summary (context, _("Benchmark rendering of .node files."));
 
   if (!g_option_context_parse (context, argc, (char ***)argv, &error))
     {
@@ -130,24 +711,94 @@ do_benchmark (int          *argc,
       exit (1);
     }
 
-  if (g_strv_length (filenames) > 1)
+  if (runs < 1 || warmup < 0)
+    {
+      g_printerr (_("Invalid number of runs\n"));
+      exit (1);
+    }
+
+  if (format_name == NULL || g_str_equal (format_name, "text"))
+    format = FORMAT_TEXT;
+  else if (g_str_equal (format_name, "csv"))
+    format = FORMAT_CSV;
+  else if (g_str_equal (format_name, "json"))
+    format = FORMAT_JSON;
+  else
     {
-      g_printerr (_("Can only benchmark a single .node file\n"));
+      g_printerr (_("Not an output format: %s\nPossible values:\n  text\n  csv\n  json\n"), format_name);
       exit (1);
     }
 
+  if (compare && (renderers == NULL || g_strv_length (renderers) != 2))
+    {
+      g_printerr (_("Comparing needs exactly two renderers\n"));
+      exit (1);
+    }
+
+  if (compare && baseline_file)
+    {
+      g_printerr (_("Can't specify both --compare and --baseline\n"));
+      exit (1);
+    }
+
+  if (baseline_file)
+    baseline = load_baseline (baseline_file);
+
   if (renderers == NULL || renderers[0] == NULL)
     renderers = g_strdupv ((char **) (const char *[]) { "gl", "ngl", "vulkan", "cairo", NULL });
-  
-  node = load_node_file (filenames[0]);
 
-  for (i = 0; renderers[i] != NULL; i++)
+  results = g_ptr_array_new_with_free_func (result_free);
+
+  for (i = 0; filenames[i] != NULL; i++)
+    {
+      GskRenderNode *node;
+
+      if (deserialize)
+        {
+          g_ptr_array_add (results, benchmark_deserialize (filenames[i], warmup, runs));
+          continue;
+        }
+
+      node = load_node_file (filenames[i]);
+      if (node == NULL)
+        continue;
+
+      for (j = 0; renderers[j] != NULL; j++)
+        {
+          Result *result = benchmark_node (filenames[i], node, renderers[j], warmup, runs, !nodownload);
+
+          if (result)
+            g_ptr_array_add (results, result);
+        }
+
+      gsk_render_node_unref (node);
+    }
+
+  switch (format)
     {
-      benchmark_node (node, renderers[i], runs, !nodownload);
+    case FORMAT_TEXT:
+      print_text (results, get_peak_memory ());
+      break;
+    case FORMAT_CSV:
+      print_csv (results);
+      break;
+    case FORMAT_JSON:
+      print_json (results, get_peak_memory ());
+      break;
+    default:
+      g_assert_not_reached ();
     }
 
-  gsk_render_node_unref (node);
+  if (compare || baseline)
+    regressions = compare_results (results, baseline, threshold);
 
+  g_clear_pointer (&baseline, g_hash_table_unref);
+  g_ptr_array_unref (results);
   g_strfreev (filenames);
   g_strfreev (renderers);
+  g_free (format_name);
+  g_free (baseline_file);
+
+  if (regressions > 0)
+    exit (1);
 }
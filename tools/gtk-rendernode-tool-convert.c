@@ -0,0 +1,163 @@
+/*
+ * GTK is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * GTK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GTK; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gi18n-lib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "gtk-rendernode-tool.h"
+
+#define TEXT_MIME_TYPE "application/x-gtk-render-node"
+#define BINARY_MIME_TYPE "application/x-gtk-render-node-binary"
+
+typedef struct
+{
+  gboolean done;
+  GError *error;
+} SerializeData;
+
+static void
+serialize_done (GObject      *source,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  SerializeData *data = user_data;
+
+  gdk_content_serialize_finish (result, &data->error);
+  data->done = TRUE;
+
+  g_main_context_wakeup (NULL);
+}
+
+static void
+convert_node (const char *input,
+              const char *output,
+              const char *mime_type)
+{
+  GskRenderNode *node;
+  GOutputStream *stream;
+  GValue value = G_VALUE_INIT;
+  SerializeData data = { FALSE, NULL };
+  GError *error = NULL;
+  GFile *file;
+
+  node = load_node_file (input);
+  if (node == NULL)
+    exit (1);
+
+  file = g_file_new_for_commandline_arg (output);
+  stream = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
+  g_object_unref (file);
+  if (stream == NULL)
+    {
+      g_printerr (_("Failed to save %s: %s\n"), output, error->message);
+      exit (1);
+    }
+
+  /* The formats are private to GSK, go through the content
+   * serializers to get at them */
+  g_value_init (&value, GSK_TYPE_RENDER_NODE);
+  gsk_value_take_render_node (&value, node);
+
+  gdk_content_serialize_async (stream,
+                               mime_type,
+                               &value,
+                               G_PRIORITY_DEFAULT,
+                               NULL,
+                               serialize_done,
+                               &data);
+
+  while (!data.done)
+    g_main_context_iteration (NULL, TRUE);
+
+  if (data.error == NULL)
+    g_output_stream_close (stream, NULL, &data.error);
+
+  if (data.error)
+    {
+      g_printerr (_("Failed to save %s: %s\n"), output, data.error->message);
+      exit (1);
+    }
+
+  g_value_unset (&value);
+  g_object_unref (stream);
+}
+
+void
+do_convert (int          *argc,
+            const char ***argv)
+{
+  GOptionContext *context;
+  char **filenames = NULL;
+  char *format = NULL;
+  const GOptionEntry entries[] = {
+    { "format", 0, 0, G_OPTION_ARG_STRING, &format, N_("Format to use (text or binary)"), N_("FORMAT") },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE…") },
+    { NULL, }
+  };
+  const char *mime_type;
+  GError *error = NULL;
+
+  g_set_prgname ("gtk4-rendernode-tool convert");
+  context = g_option_context_new (NULL);
+  g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_set_summary (context, _("Convert a .node file to a different format."));
+
+  if (!g_option_context_parse (context, argc, (char ***)argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  g_option_context_free (context);
+
+  if (filenames == NULL)
+    {
+      g_printerr (_("No .node file specified\n"));
+      exit (1);
+    }
+
+  if (g_strv_length (filenames) != 2)
+    {
+      g_printerr (_("Can only accept a single .node file and output file\n"));
+      exit (1);
+    }
+
+  if (format == NULL)
+    mime_type = g_str_has_suffix (filenames[1], ".bnode") ? BINARY_MIME_TYPE : TEXT_MIME_TYPE;
+  else if (g_str_equal (format, "text"))
+    mime_type = TEXT_MIME_TYPE;
+  else if (g_str_equal (format, "binary"))
+    mime_type = BINARY_MIME_TYPE;
+  else
+    {
+      g_printerr (_("Not a node file format: %s\nPossible values:\n  text\n  binary\n"), format);
+      exit (1);
+    }
+
+  convert_node (filenames[0], filenames[1], mime_type);
+
+  g_free (format);
+  g_strfreev (filenames);
+}
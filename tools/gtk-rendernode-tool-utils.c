@@ -56,14 +56,34 @@ deserialize_error_func (const GskParseLocation *start,
   g_string_free (string, TRUE);
 }
 
-GskRenderNode *
-load_node_file (const char *filename)
+GBytes *
+load_file_bytes (const char *filename)
 {
   GFile *file;
   GBytes *bytes;
   GError *error = NULL;
+  char *path;
 
   file = g_file_new_for_commandline_arg (filename);
+
+  /* Map local files, so binary node files can use the texture
+   * data in place */
+  path = g_file_get_path (file);
+  if (path)
+    {
+      GMappedFile *mapped;
+
+      mapped = g_mapped_file_new (path, FALSE, NULL);
+      g_free (path);
+      if (mapped)
+        {
+          bytes = g_mapped_file_get_bytes (mapped);
+          g_mapped_file_unref (mapped);
+          g_object_unref (file);
+          return bytes;
+        }
+    }
+
   bytes = g_file_load_bytes (file, NULL, NULL, &error);
   g_object_unref (file);
 
@@ -74,7 +94,20 @@ load_node_file (const char *filename)
       exit (1);
     }
 
-  return gsk_render_node_deserialize (bytes, deserialize_error_func, NULL);
+  return bytes;
+}
+
+GskRenderNode *
+load_node_file (const char *filename)
+{
+  GskRenderNode *node;
+  GBytes *bytes;
+
+  bytes = load_file_bytes (filename);
+  node = gsk_render_node_deserialize (bytes, deserialize_error_func, NULL);
+  g_bytes_unref (bytes);
+
+  return node;
 }
 
 /* keep in sync with gsk/gskrenderer.c */